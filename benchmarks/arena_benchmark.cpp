@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/arena.h>
+
+#include <random>
+#include <vector>
+
+#include <dispenso/parallel_for.h>
+
+#include "thread_benchmark_common.h"
+
+// Each simulated request allocates kAllocsPerRequest temporaries of assorted small sizes, and frees
+// them all once it is done.
+constexpr size_t kAllocsPerRequest = 1000;
+constexpr size_t kNumRequests = 1000;
+
+const std::vector<size_t>& getSizes() {
+  static const std::vector<size_t> sizes = []() {
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<size_t> dist(8, 256);
+    std::vector<size_t> s(kAllocsPerRequest);
+    for (auto& size : s) {
+      size = dist(rng);
+    }
+    return s;
+  }();
+  return sizes;
+}
+
+void BM_malloc_request(benchmark::State& state) {
+  const auto& sizes = getSizes();
+  std::vector<void*> ptrs(kAllocsPerRequest);
+  for (auto UNUSED_VAR : state) {
+    for (size_t i = 0; i < kAllocsPerRequest; ++i) {
+      ptrs[i] = ::malloc(sizes[i]);
+      benchmark::DoNotOptimize(ptrs[i]);
+    }
+    for (void* p : ptrs) {
+      ::free(p);
+    }
+  }
+}
+
+#if defined(DISPENSO_HAS_MEMORY_RESOURCE)
+void BM_pmr_monotonic_request(benchmark::State& state) {
+  const auto& sizes = getSizes();
+  std::pmr::monotonic_buffer_resource resource;
+  for (auto UNUSED_VAR : state) {
+    for (size_t i = 0; i < kAllocsPerRequest; ++i) {
+      benchmark::DoNotOptimize(resource.allocate(sizes[i]));
+    }
+    resource.release();
+  }
+}
+#endif // DISPENSO_HAS_MEMORY_RESOURCE
+
+void BM_dispenso_arena_request(benchmark::State& state) {
+  const auto& sizes = getSizes();
+  dispenso::Arena arena;
+  for (auto UNUSED_VAR : state) {
+    for (size_t i = 0; i < kAllocsPerRequest; ++i) {
+      benchmark::DoNotOptimize(arena.allocate(sizes[i]));
+    }
+    arena.reset();
+  }
+}
+
+// Many requests served in parallel, all allocating from the same allocator.
+void BM_malloc_parallel_requests(benchmark::State& state) {
+  const int numThreads = state.range(0) - 1;
+  dispenso::ThreadPool pool(numThreads);
+  const auto& sizes = getSizes();
+  for (auto UNUSED_VAR : state) {
+    dispenso::TaskSet tasks(pool);
+    dispenso::parallel_for(tasks, size_t{0}, kNumRequests, [&sizes](size_t) {
+      void* ptrs[kAllocsPerRequest];
+      for (size_t i = 0; i < kAllocsPerRequest; ++i) {
+        ptrs[i] = ::malloc(sizes[i]);
+        benchmark::DoNotOptimize(ptrs[i]);
+      }
+      for (void* p : ptrs) {
+        ::free(p);
+      }
+    });
+  }
+}
+
+void BM_dispenso_concurrent_arena_parallel_requests(benchmark::State& state) {
+  const int numThreads = state.range(0) - 1;
+  dispenso::ThreadPool pool(numThreads);
+  const auto& sizes = getSizes();
+  dispenso::ConcurrentArena arena;
+  for (auto UNUSED_VAR : state) {
+    dispenso::TaskSet tasks(pool);
+    dispenso::parallel_for(tasks, size_t{0}, kNumRequests, [&sizes, &arena](size_t) {
+      for (size_t i = 0; i < kAllocsPerRequest; ++i) {
+        benchmark::DoNotOptimize(arena.allocate(sizes[i]));
+      }
+    });
+    arena.reset();
+  }
+}
+
+static void CustomArguments(benchmark::internal::Benchmark* b) {
+  for (int i : benchmarkThreads()) {
+    b->Arg(i);
+  }
+}
+
+BENCHMARK(BM_malloc_request);
+#if defined(DISPENSO_HAS_MEMORY_RESOURCE)
+BENCHMARK(BM_pmr_monotonic_request);
+#endif // DISPENSO_HAS_MEMORY_RESOURCE
+BENCHMARK(BM_dispenso_arena_request);
+
+BENCHMARK(BM_malloc_parallel_requests)->Apply(CustomArguments)->UseRealTime();
+BENCHMARK(BM_dispenso_concurrent_arena_parallel_requests)->Apply(CustomArguments)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+// Reads a file in blocks and checksums each block, either with blocking pread calls inside
+// parallel_for or with dispenso::AsyncIo reads whose continuations run on the pool.
+
+#if !defined(_WIN32)
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <dispenso/async_io.h>
+#include <dispenso/parallel_for.h>
+
+#include "thread_benchmark_common.h"
+
+constexpr size_t kBlockSize = 1 << 16;
+constexpr size_t kBlocks = 256;
+
+struct BlockFile {
+  BlockFile() : file(std::tmpfile()), fd(fileno(file)) {
+    std::string block(kBlockSize, '\0');
+    for (size_t i = 0; i < kBlockSize; ++i) {
+      block[i] = static_cast<char>(i * 31);
+    }
+    for (size_t b = 0; b < kBlocks; ++b) {
+      if (pwrite(fd, block.data(), kBlockSize, static_cast<off_t>(b * kBlockSize)) < 0) {
+        std::abort();
+      }
+    }
+  }
+  ~BlockFile() {
+    std::fclose(file);
+  }
+  FILE* file;
+  int fd;
+};
+
+BlockFile& blockFile() {
+  static BlockFile file;
+  return file;
+}
+
+uint64_t checksum(const char* data, size_t size) {
+  uint64_t sum = 0;
+  for (size_t i = 0; i < size; ++i) {
+    sum = sum * 131 + static_cast<unsigned char>(data[i]);
+  }
+  return sum;
+}
+
+void BM_blocking_pread(benchmark::State& state) {
+  dispenso::ThreadPool pool(state.range(0));
+  int fd = blockFile().fd;
+  std::vector<uint64_t> sums(kBlocks);
+  for (auto UNUSED_VAR : state) {
+    dispenso::TaskSet tasks(pool);
+    dispenso::parallel_for(tasks, 0, kBlocks, [fd, &sums](size_t b) {
+      std::vector<char> buffer(kBlockSize);
+      ssize_t got = pread(fd, buffer.data(), kBlockSize, static_cast<off_t>(b * kBlockSize));
+      sums[b] = checksum(buffer.data(), got < 0 ? 0 : static_cast<size_t>(got));
+    });
+  }
+  benchmark::DoNotOptimize(sums.data());
+}
+
+void BM_async_io(benchmark::State& state) {
+  dispenso::ThreadPool pool(state.range(0));
+  dispenso::AsyncIo io(pool, kBlockSize);
+  int fd = blockFile().fd;
+  std::vector<uint64_t> sums(kBlocks);
+  std::vector<dispenso::Future<void>> done;
+  done.reserve(kBlocks);
+  for (auto UNUSED_VAR : state) {
+    done.clear();
+    for (size_t b = 0; b < kBlocks; ++b) {
+      done.push_back(io.read(fd, b * kBlockSize, kBlockSize)
+                         .then(
+                             [&sums, b](dispenso::Future<dispenso::IoBuffer>&& f) {
+                               const auto& buffer = f.get();
+                               sums[b] = checksum(buffer.data(), buffer.size());
+                             },
+                             pool));
+    }
+    for (auto& d : done) {
+      d.wait();
+    }
+  }
+  state.counters["io_uring"] = io.usingIoUring();
+  benchmark::DoNotOptimize(sums.data());
+}
+
+static void CustomArguments(benchmark::internal::Benchmark* b) {
+  for (int s : benchmarkThreads()) {
+    b->Arg(s);
+  }
+}
+
+BENCHMARK(BM_blocking_pread)->Apply(CustomArguments)->UseRealTime();
+BENCHMARK(BM_async_io)->Apply(CustomArguments)->UseRealTime();
+
+#endif // !_WIN32
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+// Phase-synchronous loops on dedicated threads, comparing dispenso::Barrier against std::barrier
+// (when built as C++20) and a mutex/condition_variable barrier.
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if __cplusplus >= 202002L && defined(__has_include)
+#if __has_include(<barrier>)
+#include <barrier>
+#define BENCHMARK_HAS_STD_BARRIER 1
+#endif // has <barrier>
+#endif // C++20
+
+#include <dispenso/barrier.h>
+
+#include "thread_benchmark_common.h"
+
+constexpr int kPhases = 1000;
+// A little work per phase, so that arrival times vary as in a real simulation step.
+constexpr int kWorkPerPhase = 200;
+
+class CvBarrier {
+ public:
+  explicit CvBarrier(ptrdiff_t expected) : expected_(expected), remaining_(expected) {}
+
+  void arriveAndWait() {
+    std::unique_lock<std::mutex> lk(mtx_);
+    size_t phase = phase_;
+    if (--remaining_ == 0) {
+      remaining_ = expected_;
+      ++phase_;
+      cv_.notify_all();
+    } else {
+      cv_.wait(lk, [this, phase]() { return phase_ != phase; });
+    }
+  }
+
+ private:
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  const ptrdiff_t expected_;
+  ptrdiff_t remaining_;
+  size_t phase_ = 0;
+};
+
+struct DispensoBarrier : dispenso::Barrier {
+  explicit DispensoBarrier(ptrdiff_t expected) : dispenso::Barrier(expected) {}
+};
+
+#if defined(BENCHMARK_HAS_STD_BARRIER)
+struct StdBarrier : std::barrier<> {
+  explicit StdBarrier(ptrdiff_t expected) : std::barrier<>(expected) {}
+  void arriveAndWait() {
+    arrive_and_wait();
+  }
+};
+#endif // BENCHMARK_HAS_STD_BARRIER
+
+template <typename BarrierT>
+void BM_barrier(benchmark::State& state) {
+  const int numThreads = state.range(0);
+  int64_t sum = 0;
+  for (auto UNUSED_VAR : state) {
+    BarrierT barrier(numThreads);
+    std::vector<int64_t> sums(numThreads);
+    auto body = [&barrier, &sums](int t) {
+      int64_t local = 0;
+      for (int p = 0; p < kPhases; ++p) {
+        for (int i = 0; i < kWorkPerPhase * (1 + (t + p) % 3); ++i) {
+          local += i ^ p;
+          benchmark::DoNotOptimize(local);
+        }
+        barrier.arriveAndWait();
+      }
+      sums[t] = local;
+    };
+    std::vector<std::thread> threads;
+    for (int t = 1; t < numThreads; ++t) {
+      threads.emplace_back(body, t);
+    }
+    body(0);
+    for (auto& t : threads) {
+      t.join();
+    }
+    for (int64_t s : sums) {
+      sum += s;
+    }
+  }
+  benchmark::DoNotOptimize(sum);
+}
+
+static void CustomArguments(benchmark::internal::Benchmark* b) {
+  for (int s : benchmarkThreads()) {
+    b->Arg(s);
+  }
+}
+
+BENCHMARK_TEMPLATE(BM_barrier, CvBarrier)->Apply(CustomArguments)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_barrier, DispensoBarrier)->Apply(CustomArguments)->UseRealTime();
+#if defined(BENCHMARK_HAS_STD_BARRIER)
+BENCHMARK_TEMPLATE(BM_barrier, StdBarrier)->Apply(CustomArguments)->UseRealTime();
+#endif // BENCHMARK_HAS_STD_BARRIER
@@ -0,0 +1,299 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+// Level-synchronous breadth first search over a power-law (R-MAT) graph.  Vertex degrees span
+// several orders of magnitude, so equal chunks of a frontier carry very unequal work, and load
+// balancing matters far more than in uniform loops.
+
+#include <atomic>
+#include <memory>
+#include <random>
+#include <unordered_map>
+
+#include <dispenso/parallel_for.h>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#if !defined(BENCHMARK_WITHOUT_TBB)
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
+#include "tbb/task_scheduler_init.h"
+#endif // !BENCHMARK_WITHOUT_TBB
+
+#include "thread_benchmark_common.h"
+
+static constexpr uint32_t kSeed = 8;
+static constexpr int kSmallScale = 14;
+static constexpr int kLargeScale = 19;
+static constexpr int kEdgeFactor = 8;
+
+// Neighbors found by one chunk are buffered and appended to the next frontier in batches.
+static constexpr size_t kBatch = 256;
+
+struct CsrGraph {
+  std::vector<uint32_t> offsets;
+  std::vector<uint32_t> neighbors;
+  uint32_t source;
+
+  uint32_t numVertices() const {
+    return static_cast<uint32_t>(offsets.size() - 1);
+  }
+};
+
+// An undirected R-MAT graph with 2^scale vertices, using the Graph500 partition probabilities.
+// The raw engine output is used directly, so the graph is the same on every platform.
+CsrGraph makeGraph(int scale) {
+  const uint32_t numVertices = uint32_t{1} << scale;
+  const size_t numEdges = size_t{numVertices} * kEdgeFactor;
+  std::mt19937 rng(kSeed);
+  auto uniform = [&rng]() { return rng() / 4294967296.0; };
+
+  std::vector<std::pair<uint32_t, uint32_t>> edges;
+  edges.reserve(numEdges);
+  for (size_t e = 0; e < numEdges; ++e) {
+    uint32_t u = 0;
+    uint32_t v = 0;
+    for (int bit = 0; bit < scale; ++bit) {
+      const double r = uniform();
+      u = (u << 1) | (r >= 0.76);
+      v = (v << 1) | (r >= 0.57 && (r < 0.76 || r >= 0.95));
+    }
+    if (u != v) {
+      edges.emplace_back(u, v);
+    }
+  }
+
+  CsrGraph graph;
+  graph.offsets.assign(numVertices + 1, 0);
+  for (auto& e : edges) {
+    ++graph.offsets[e.first + 1];
+    ++graph.offsets[e.second + 1];
+  }
+  for (uint32_t i = 0; i < numVertices; ++i) {
+    graph.offsets[i + 1] += graph.offsets[i];
+  }
+  graph.neighbors.resize(graph.offsets.back());
+  std::vector<uint32_t> fill(graph.offsets.begin(), graph.offsets.end() - 1);
+  for (auto& e : edges) {
+    graph.neighbors[fill[e.first]++] = e.second;
+    graph.neighbors[fill[e.second]++] = e.first;
+  }
+
+  // Start from the highest degree vertex, which is in the giant component.
+  graph.source = 0;
+  for (uint32_t i = 0; i < numVertices; ++i) {
+    if (graph.offsets[i + 1] - graph.offsets[i] >
+        graph.offsets[graph.source + 1] - graph.offsets[graph.source]) {
+      graph.source = i;
+    }
+  }
+  return graph;
+}
+
+const CsrGraph& getGraph(int scale) {
+  static std::unordered_map<int, CsrGraph> graphs;
+  auto it = graphs.find(scale);
+  if (it != graphs.end()) {
+    return it->second;
+  }
+  return graphs.emplace(scale, makeGraph(scale)).first->second;
+}
+
+std::vector<int32_t> serialBfs(const CsrGraph& graph) {
+  std::vector<int32_t> depth(graph.numVertices(), -1);
+  std::vector<uint32_t> frontier = {graph.source};
+  std::vector<uint32_t> next;
+  depth[graph.source] = 0;
+  for (int32_t level = 0; !frontier.empty(); ++level) {
+    next.clear();
+    for (uint32_t u : frontier) {
+      for (uint32_t e = graph.offsets[u]; e < graph.offsets[u + 1]; ++e) {
+        const uint32_t v = graph.neighbors[e];
+        if (depth[v] < 0) {
+          depth[v] = level + 1;
+          next.push_back(v);
+        }
+      }
+    }
+    frontier.swap(next);
+  }
+  return depth;
+}
+
+// The shared state of a parallel search.  Frontiers are preallocated, since each vertex is claimed
+// by exactly one thread, and so enters exactly one frontier, once.
+class ParallelBfs {
+ public:
+  explicit ParallelBfs(const CsrGraph& graph)
+      : graph_(graph),
+        depth_(new std::atomic<int32_t>[graph.numVertices()]),
+        frontier_(graph.numVertices()),
+        next_(graph.numVertices()) {}
+
+  // Runs the search, calling expandLevel(numFrontier) once per level; it must call
+  // expand(begin, end) over [0, numFrontier), in parallel.
+  template <typename ExpandLevel>
+  void run(ExpandLevel&& expandLevel) {
+    for (uint32_t i = 0; i < graph_.numVertices(); ++i) {
+      depth_[i].store(-1, std::memory_order_relaxed);
+    }
+    depth_[graph_.source].store(0, std::memory_order_relaxed);
+    frontier_[0] = graph_.source;
+    size_t numFrontier = 1;
+    for (level_ = 0; numFrontier; ++level_) {
+      nextSize_.store(0, std::memory_order_relaxed);
+      expandLevel(numFrontier);
+      numFrontier = nextSize_.load(std::memory_order_relaxed);
+      frontier_.swap(next_);
+    }
+  }
+
+  void expand(size_t begin, size_t end) {
+    uint32_t batch[kBatch];
+    size_t count = 0;
+    for (size_t i = begin; i < end; ++i) {
+      const uint32_t u = frontier_[i];
+      for (uint32_t e = graph_.offsets[u]; e < graph_.offsets[u + 1]; ++e) {
+        const uint32_t v = graph_.neighbors[e];
+        int32_t unvisited = -1;
+        if (depth_[v].load(std::memory_order_relaxed) < 0 &&
+            depth_[v].compare_exchange_strong(
+                unvisited, level_ + 1, std::memory_order_relaxed)) {
+          batch[count++] = v;
+          if (count == kBatch) {
+            flush(batch, count);
+            count = 0;
+          }
+        }
+      }
+    }
+    flush(batch, count);
+  }
+
+  void check() const {
+    const std::vector<int32_t> expected = serialBfs(graph_);
+    for (uint32_t i = 0; i < graph_.numVertices(); ++i) {
+      if (depth_[i].load(std::memory_order_relaxed) != expected[i]) {
+        std::cerr << "FAIL! vertex " << i << " at depth " << depth_[i].load() << " vs "
+                  << expected[i] << std::endl;
+        abort();
+      }
+    }
+  }
+
+ private:
+  void flush(const uint32_t* batch, size_t count) {
+    if (count) {
+      const size_t at = nextSize_.fetch_add(count, std::memory_order_relaxed);
+      std::copy(batch, batch + count, next_.begin() + at);
+    }
+  }
+
+  const CsrGraph& graph_;
+  std::unique_ptr<std::atomic<int32_t>[]> depth_;
+  std::vector<uint32_t> frontier_;
+  std::vector<uint32_t> next_;
+  std::atomic<size_t> nextSize_{0};
+  int32_t level_ = 0;
+};
+
+template <int scale>
+void BM_serial(benchmark::State& state) {
+  const CsrGraph& graph = getGraph(scale);
+  std::vector<int32_t> depth;
+  for (auto UNUSED_VAR : state) {
+    depth = serialBfs(graph);
+  }
+  benchmark::DoNotOptimize(depth.data());
+}
+
+void runDispenso(benchmark::State& state, dispenso::ParForChunking chunking) {
+  const int num_threads = state.range(0) - 1;
+  const CsrGraph& graph = getGraph(state.range(1));
+  dispenso::ThreadPool pool(num_threads);
+  ParallelBfs bfs(graph);
+  for (auto UNUSED_VAR : state) {
+    bfs.run([&](size_t numFrontier) {
+      dispenso::TaskSet tasks(pool);
+      dispenso::parallel_for(
+          tasks,
+          dispenso::makeChunkedRange(size_t{0}, numFrontier, chunking),
+          [&bfs](size_t begin, size_t end) { bfs.expand(begin, end); });
+    });
+  }
+  bfs.check();
+}
+
+void BM_dispenso(benchmark::State& state) {
+  runDispenso(state, dispenso::ParForChunking::kAuto);
+}
+
+void BM_dispenso_static(benchmark::State& state) {
+  runDispenso(state, dispenso::ParForChunking::kStatic);
+}
+
+#if defined(_OPENMP)
+void BM_omp(benchmark::State& state) {
+  const int num_threads = state.range(0);
+  const CsrGraph& graph = getGraph(state.range(1));
+  omp_set_num_threads(num_threads);
+  ParallelBfs bfs(graph);
+  for (auto UNUSED_VAR : state) {
+    bfs.run([&bfs](size_t numFrontier) {
+      const int64_t numChunks = static_cast<int64_t>((numFrontier + 63) / 64);
+#pragma omp parallel for schedule(dynamic)
+      for (int64_t c = 0; c < numChunks; ++c) {
+        const size_t begin = static_cast<size_t>(c) * 64;
+        bfs.expand(begin, std::min(begin + 64, numFrontier));
+      }
+    });
+  }
+  bfs.check();
+}
+#endif /*defined(_OPENMP)*/
+
+#if !defined(BENCHMARK_WITHOUT_TBB)
+void BM_tbb(benchmark::State& state) {
+  const int num_threads = state.range(0);
+  const CsrGraph& graph = getGraph(state.range(1));
+  ParallelBfs bfs(graph);
+  for (auto UNUSED_VAR : state) {
+    tbb::task_scheduler_init initsched(num_threads);
+    bfs.run([&bfs](size_t numFrontier) {
+      tbb::parallel_for(
+          tbb::blocked_range<size_t>(0, numFrontier),
+          [&bfs](const tbb::blocked_range<size_t>& r) { bfs.expand(r.begin(), r.end()); });
+    });
+  }
+  bfs.check();
+}
+#endif // !BENCHMARK_WITHOUT_TBB
+
+static void CustomArguments(benchmark::internal::Benchmark* b) {
+  for (int j : {kSmallScale, kLargeScale}) {
+    for (int i : benchmarkThreads()) {
+      b->Args({i, j});
+    }
+  }
+}
+
+BENCHMARK_TEMPLATE(BM_serial, kSmallScale)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_serial, kLargeScale)->UseRealTime();
+
+#if defined(_OPENMP)
+BENCHMARK(BM_omp)->Apply(CustomArguments)->UseRealTime();
+#endif // OPENMP
+#if !defined(BENCHMARK_WITHOUT_TBB)
+BENCHMARK(BM_tbb)->Apply(CustomArguments)->UseRealTime();
+#endif // !BENCHMARK_WITHOUT_TBB
+
+BENCHMARK(BM_dispenso)->Apply(CustomArguments)->UseRealTime();
+BENCHMARK(BM_dispenso_static)->Apply(CustomArguments)->UseRealTime();
+
+BENCHMARK_MAIN();
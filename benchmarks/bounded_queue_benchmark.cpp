@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <concurrentqueue.h>
+#include <dispenso/bounded_queue.h>
+
+#include "thread_benchmark_common.h"
+
+constexpr int64_t kNumItems = 1 << 20;
+constexpr size_t kCapacity = 1024;
+
+// A bounded queue built from a std::deque, a mutex, and condition variables, as the baseline.
+class LockedQueue {
+ public:
+  void push(int64_t value) {
+    std::unique_lock<std::mutex> lk(mtx_);
+    notFull_.wait(lk, [this]() { return items_.size() < kCapacity; });
+    items_.push_back(value);
+    notEmpty_.notify_one();
+  }
+  bool pop(int64_t& value) {
+    std::unique_lock<std::mutex> lk(mtx_);
+    notEmpty_.wait(lk, [this]() { return !items_.empty() || closed_; });
+    if (items_.empty()) {
+      return false;
+    }
+    value = items_.front();
+    items_.pop_front();
+    notFull_.notify_one();
+    return true;
+  }
+  void close() {
+    std::lock_guard<std::mutex> lk(mtx_);
+    closed_ = true;
+    notEmpty_.notify_all();
+  }
+
+ private:
+  std::mutex mtx_;
+  std::condition_variable notFull_;
+  std::condition_variable notEmpty_;
+  std::deque<int64_t> items_;
+  bool closed_ = false;
+};
+
+class DispensoQueue {
+ public:
+  void push(int64_t value) {
+    queue_.push(value);
+  }
+  bool pop(int64_t& value) {
+    return queue_.pop(value);
+  }
+  void close() {
+    queue_.close();
+  }
+
+ private:
+  dispenso::BoundedQueue<int64_t> queue_{kCapacity};
+};
+
+// moodycamel's queue is unbounded and non-blocking; consumers spin with yield.
+class MoodycamelQueue {
+ public:
+  void push(int64_t value) {
+    queue_.enqueue(value);
+  }
+  bool pop(int64_t& value) {
+    while (!queue_.try_dequeue(value)) {
+      if (closed_.load(std::memory_order_acquire)) {
+        return queue_.try_dequeue(value);
+      }
+      std::this_thread::yield();
+    }
+    return true;
+  }
+  void close() {
+    closed_.store(true, std::memory_order_release);
+  }
+
+ private:
+  moodycamel::ConcurrentQueue<int64_t> queue_;
+  std::atomic<bool> closed_{false};
+};
+
+// Half of the threads produce, and half consume, kNumItems in total.
+template <typename Queue>
+void producerConsumerImpl(benchmark::State& state) {
+  const int numProducers = std::max(1, static_cast<int>(state.range(0)) / 2);
+  const int numConsumers = std::max(1, static_cast<int>(state.range(0)) - numProducers);
+  const int64_t perProducer = kNumItems / numProducers;
+
+  int64_t sum = 0;
+  for (auto UNUSED_VAR : state) {
+    Queue queue;
+    std::atomic<int64_t> total(0);
+    std::vector<std::thread> consumers;
+    for (int c = 0; c < numConsumers; ++c) {
+      consumers.emplace_back([&queue, &total]() {
+        int64_t value;
+        int64_t local = 0;
+        while (queue.pop(value)) {
+          local += value;
+        }
+        total.fetch_add(local, std::memory_order_relaxed);
+      });
+    }
+    std::vector<std::thread> producers;
+    for (int p = 0; p < numProducers; ++p) {
+      producers.emplace_back([&queue, perProducer]() {
+        for (int64_t i = 0; i < perProducer; ++i) {
+          queue.push(i);
+        }
+      });
+    }
+    for (auto& t : producers) {
+      t.join();
+    }
+    queue.close();
+    for (auto& t : consumers) {
+      t.join();
+    }
+    sum = total.load();
+  }
+  if (sum != numProducers * (perProducer * (perProducer - 1) / 2)) {
+    std::cerr << "Wrong sum" << std::endl;
+    abort();
+  }
+  state.SetItemsProcessed(state.iterations() * numProducers * perProducer);
+}
+
+void BM_locked_queue(benchmark::State& state) {
+  producerConsumerImpl<LockedQueue>(state);
+}
+
+void BM_moodycamel_queue(benchmark::State& state) {
+  producerConsumerImpl<MoodycamelQueue>(state);
+}
+
+void BM_dispenso_bounded_queue(benchmark::State& state) {
+  producerConsumerImpl<DispensoQueue>(state);
+}
+
+// At least one producer and one consumer.
+static void CustomArguments(benchmark::internal::Benchmark* b) {
+  b->Arg(2);
+  for (int i : benchmarkThreads()) {
+    if (i > 2) {
+      b->Arg(i);
+    }
+  }
+}
+
+BENCHMARK(BM_locked_queue)->Apply(CustomArguments)->UseRealTime();
+BENCHMARK(BM_moodycamel_queue)->Apply(CustomArguments)->UseRealTime();
+BENCHMARK(BM_dispenso_bounded_queue)->Apply(CustomArguments)->UseRealTime();
+
+BENCHMARK_MAIN();
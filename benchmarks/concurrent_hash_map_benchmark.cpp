@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <mutex>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#if !defined(BENCHMARK_WITHOUT_TBB)
+#include "tbb/concurrent_unordered_map.h"
+#endif // !BENCHMARK_WITHOUT_TBB
+
+#if !defined(BENCHMARK_WITHOUT_FOLLY)
+#include <folly/concurrency/ConcurrentHashMap.h>
+#endif // !BENCHMARK_WITHOUT_FOLLY
+
+#include <dispenso/concurrent_hash_map.h>
+#include <dispenso/parallel_for.h>
+
+#include "thread_benchmark_common.h"
+
+constexpr size_t kLength = (1 << 20);
+
+const std::vector<int64_t>& getKeys() {
+  static const std::vector<int64_t> keys = []() {
+    std::mt19937_64 rng(5);
+    std::vector<int64_t> k(kLength);
+    for (auto& key : k) {
+      key = static_cast<int64_t>(rng() >> 1);
+    }
+    return k;
+  }();
+  return keys;
+}
+
+// A std::unordered_map behind a single mutex, as the baseline.
+struct LockedStdMap {
+  bool insert(int64_t key, int64_t value) {
+    std::lock_guard<std::mutex> lk(mtx);
+    return map.emplace(key, value).second;
+  }
+  bool contains(int64_t key) {
+    std::lock_guard<std::mutex> lk(mtx);
+    return map.find(key) != map.end();
+  }
+  std::mutex mtx;
+  std::unordered_map<int64_t, int64_t> map;
+};
+
+struct DispensoMap {
+  bool insert(int64_t key, int64_t value) {
+    return map.insert({key, value}).second;
+  }
+  bool contains(int64_t key) {
+    return map.find(key) != nullptr;
+  }
+  dispenso::ConcurrentHashMap<int64_t, int64_t> map;
+};
+
+#if !defined(BENCHMARK_WITHOUT_TBB)
+struct TbbMap {
+  bool insert(int64_t key, int64_t value) {
+    return map.insert({key, value}).second;
+  }
+  bool contains(int64_t key) {
+    return map.find(key) != map.end();
+  }
+  tbb::concurrent_unordered_map<int64_t, int64_t> map;
+};
+#endif // !BENCHMARK_WITHOUT_TBB
+
+#if !defined(BENCHMARK_WITHOUT_FOLLY)
+struct FollyMap {
+  bool insert(int64_t key, int64_t value) {
+    return map.insert(key, value).second;
+  }
+  bool contains(int64_t key) {
+    return map.find(key) != map.cend();
+  }
+  folly::ConcurrentHashMap<int64_t, int64_t> map;
+};
+#endif // !BENCHMARK_WITHOUT_FOLLY
+
+template <typename Map>
+void serialInsertImpl(benchmark::State& state) {
+  const auto& keys = getKeys();
+  for (auto UNUSED_VAR : state) {
+    Map map;
+    for (size_t i = 0; i < kLength; ++i) {
+      map.insert(keys[i], static_cast<int64_t>(i));
+    }
+  }
+}
+
+template <typename Map>
+void parallelInsertImpl(benchmark::State& state) {
+  const int numThreads = state.range(0) - 1;
+  dispenso::ThreadPool pool(numThreads);
+  const auto& keys = getKeys();
+  for (auto UNUSED_VAR : state) {
+    Map map;
+    dispenso::TaskSet tasks(pool);
+    dispenso::parallel_for(tasks, size_t{0}, kLength, [&map, &keys](size_t i) {
+      map.insert(keys[i], static_cast<int64_t>(i));
+    });
+  }
+}
+
+template <typename Map>
+void parallelFindImpl(benchmark::State& state) {
+  const int numThreads = state.range(0) - 1;
+  dispenso::ThreadPool pool(numThreads);
+  const auto& keys = getKeys();
+  Map map;
+  // Only half of the keys are present, so that both hits and misses are measured.
+  for (size_t i = 0; i < kLength; i += 2) {
+    map.insert(keys[i], static_cast<int64_t>(i));
+  }
+  std::atomic<size_t> found(0);
+  for (auto UNUSED_VAR : state) {
+    dispenso::TaskSet tasks(pool);
+    dispenso::parallel_for(
+        tasks,
+        dispenso::makeChunkedRange(size_t{0}, kLength, dispenso::ParForChunking::kAuto),
+        [&map, &keys, &found](size_t b, size_t e) {
+          size_t count = 0;
+          for (size_t i = b; i < e; ++i) {
+            count += map.contains(keys[i]);
+          }
+          found.fetch_add(count, std::memory_order_relaxed);
+        });
+  }
+  if (found.load() != state.iterations() * (kLength / 2)) {
+    std::cerr << "Wrong number of keys found" << std::endl;
+    abort();
+  }
+}
+
+void BM_std_serial_insert(benchmark::State& state) {
+  serialInsertImpl<LockedStdMap>(state);
+}
+
+#if !defined(BENCHMARK_WITHOUT_TBB)
+void BM_tbb_serial_insert(benchmark::State& state) {
+  serialInsertImpl<TbbMap>(state);
+}
+#endif // !BENCHMARK_WITHOUT_TBB
+
+#if !defined(BENCHMARK_WITHOUT_FOLLY)
+void BM_folly_serial_insert(benchmark::State& state) {
+  serialInsertImpl<FollyMap>(state);
+}
+#endif // !BENCHMARK_WITHOUT_FOLLY
+
+void BM_dispenso_serial_insert(benchmark::State& state) {
+  serialInsertImpl<DispensoMap>(state);
+}
+
+void BM_std_parallel_insert(benchmark::State& state) {
+  parallelInsertImpl<LockedStdMap>(state);
+}
+
+#if !defined(BENCHMARK_WITHOUT_TBB)
+void BM_tbb_parallel_insert(benchmark::State& state) {
+  parallelInsertImpl<TbbMap>(state);
+}
+#endif // !BENCHMARK_WITHOUT_TBB
+
+#if !defined(BENCHMARK_WITHOUT_FOLLY)
+void BM_folly_parallel_insert(benchmark::State& state) {
+  parallelInsertImpl<FollyMap>(state);
+}
+#endif // !BENCHMARK_WITHOUT_FOLLY
+
+void BM_dispenso_parallel_insert(benchmark::State& state) {
+  parallelInsertImpl<DispensoMap>(state);
+}
+
+void BM_std_parallel_find(benchmark::State& state) {
+  parallelFindImpl<LockedStdMap>(state);
+}
+
+#if !defined(BENCHMARK_WITHOUT_TBB)
+void BM_tbb_parallel_find(benchmark::State& state) {
+  parallelFindImpl<TbbMap>(state);
+}
+#endif // !BENCHMARK_WITHOUT_TBB
+
+#if !defined(BENCHMARK_WITHOUT_FOLLY)
+void BM_folly_parallel_find(benchmark::State& state) {
+  parallelFindImpl<FollyMap>(state);
+}
+#endif // !BENCHMARK_WITHOUT_FOLLY
+
+void BM_dispenso_parallel_find(benchmark::State& state) {
+  parallelFindImpl<DispensoMap>(state);
+}
+
+static void CustomArguments(benchmark::internal::Benchmark* b) {
+  for (int i : benchmarkThreads()) {
+    b->Arg(i);
+  }
+}
+
+BENCHMARK(BM_std_serial_insert);
+#if !defined(BENCHMARK_WITHOUT_TBB)
+BENCHMARK(BM_tbb_serial_insert);
+#endif // !BENCHMARK_WITHOUT_TBB
+#if !defined(BENCHMARK_WITHOUT_FOLLY)
+BENCHMARK(BM_folly_serial_insert);
+#endif // !BENCHMARK_WITHOUT_FOLLY
+BENCHMARK(BM_dispenso_serial_insert);
+
+BENCHMARK(BM_std_parallel_insert)->Apply(CustomArguments)->UseRealTime();
+#if !defined(BENCHMARK_WITHOUT_TBB)
+BENCHMARK(BM_tbb_parallel_insert)->Apply(CustomArguments)->UseRealTime();
+#endif // !BENCHMARK_WITHOUT_TBB
+#if !defined(BENCHMARK_WITHOUT_FOLLY)
+BENCHMARK(BM_folly_parallel_insert)->Apply(CustomArguments)->UseRealTime();
+#endif // !BENCHMARK_WITHOUT_FOLLY
+BENCHMARK(BM_dispenso_parallel_insert)->Apply(CustomArguments)->UseRealTime();
+
+BENCHMARK(BM_std_parallel_find)->Apply(CustomArguments)->UseRealTime();
+#if !defined(BENCHMARK_WITHOUT_TBB)
+BENCHMARK(BM_tbb_parallel_find)->Apply(CustomArguments)->UseRealTime();
+#endif // !BENCHMARK_WITHOUT_TBB
+#if !defined(BENCHMARK_WITHOUT_FOLLY)
+BENCHMARK(BM_folly_parallel_find)->Apply(CustomArguments)->UseRealTime();
+#endif // !BENCHMARK_WITHOUT_FOLLY
+BENCHMARK(BM_dispenso_parallel_find)->Apply(CustomArguments)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+// Many threads appending small groups to a ConcurrentObjectArena, either each through the shared
+// grow_by or through a per-thread Reservation.
+
+#include <thread>
+#include <vector>
+
+#include <dispenso/concurrent_object_arena.h>
+
+#include "thread_benchmark_common.h"
+
+constexpr size_t kAppendsPerThread = 100000;
+constexpr size_t kGroup = 2;
+constexpr size_t kBufferSize = 256;
+
+template <typename Append>
+void runThreads(int numThreads, Append append) {
+  std::vector<std::thread> threads;
+  for (int t = 1; t < numThreads; ++t) {
+    threads.emplace_back(append);
+  }
+  append();
+  for (auto& t : threads) {
+    t.join();
+  }
+}
+
+void BM_grow_by(benchmark::State& state) {
+  const int numThreads = static_cast<int>(state.range(0));
+  for (auto UNUSED_VAR : state) {
+    dispenso::ConcurrentObjectArena<int> arena(kBufferSize);
+    runThreads(numThreads, [&arena]() {
+      for (size_t i = 0; i < kAppendsPerThread; ++i) {
+        size_t p = arena.grow_by(kGroup);
+        arena[p] = static_cast<int>(i);
+      }
+    });
+    benchmark::DoNotOptimize(arena.size());
+  }
+}
+
+void BM_reservation(benchmark::State& state) {
+  const int numThreads = static_cast<int>(state.range(0));
+  for (auto UNUSED_VAR : state) {
+    dispenso::ConcurrentObjectArena<int> arena(kBufferSize);
+    runThreads(numThreads, [&arena]() {
+      dispenso::ConcurrentObjectArena<int>::Reservation reservation(arena);
+      for (size_t i = 0; i < kAppendsPerThread; ++i) {
+        size_t p = reservation.grow_by(kGroup);
+        arena[p] = static_cast<int>(i);
+      }
+    });
+    benchmark::DoNotOptimize(arena.size());
+  }
+}
+
+static void CustomArguments(benchmark::internal::Benchmark* b) {
+  for (int s : benchmarkThreads()) {
+    b->Arg(s);
+  }
+}
+
+BENCHMARK(BM_grow_by)->Apply(CustomArguments)->UseRealTime();
+BENCHMARK(BM_reservation)->Apply(CustomArguments)->UseRealTime();
@@ -7,7 +7,9 @@
 
 #include <deque>
 #include <iostream>
+#include <numeric>
 #include <random>
+#include <string>
 #include <vector>
 
 #include <benchmark/benchmark.h>
@@ -185,6 +187,50 @@ void BM_dispenso_iterate(benchmark::State& state) {
   iterateImpl(state, []() { return dispenso::ConcurrentVector<int>(); });
 }
 
+void BM_dispenso_iterate_segments(benchmark::State& state) {
+  dispenso::ConcurrentVector<int> values;
+  for (size_t i = 0; i < kLength; ++i) {
+    values.push_back(i);
+  }
+  int64_t sum;
+  for (auto UNUSED_VAR : state) {
+    sum = 0;
+    for (auto seg : values.segments()) {
+      for (int i : seg) {
+        sum += i;
+      }
+    }
+  }
+
+  checkIotaSum(sum);
+}
+
+// Copying a built vector out to contiguous storage, serially through iterators, and in parallel.
+void BM_dispenso_copy_out_serial(benchmark::State& state) {
+  dispenso::ConcurrentVector<int> values;
+  for (size_t i = 0; i < kLength; ++i) {
+    values.push_back(i);
+  }
+  std::vector<int> out(kLength);
+  for (auto UNUSED_VAR : state) {
+    std::copy(values.begin(), values.end(), out.begin());
+  }
+  checkIotaSum(std::accumulate(out.begin(), out.end(), int64_t{0}));
+}
+
+void BM_dispenso_copy_out_parallel(benchmark::State& state) {
+  dispenso::ConcurrentVector<int> values;
+  for (size_t i = 0; i < kLength; ++i) {
+    values.push_back(i);
+  }
+  std::vector<int> out(kLength);
+  dispenso::TaskSet tasks(dispenso::globalThreadPool());
+  for (auto UNUSED_VAR : state) {
+    values.copyToContiguous(out.data(), tasks);
+  }
+  checkIotaSum(std::accumulate(out.begin(), out.end(), int64_t{0}));
+}
+
 template <typename T>
 struct ReverseWrapper {
   T& iterable;
@@ -706,6 +752,29 @@ void BM_dispenso_parallel_grow_by_max(benchmark::State& state) {
       });
 }
 
+// Construction and destruction of non-trivial elements, serially or in parallel bucket by bucket.
+const std::string& longString() {
+  static const std::string str(64, 'x');
+  return str;
+}
+
+void BM_dispenso_fill_and_clear_serial(benchmark::State& state) {
+  for (auto UNUSED_VAR : state) {
+    dispenso::ConcurrentVector<std::string> c;
+    c.grow_by(kLength, longString());
+    c.clear();
+  }
+}
+
+void BM_dispenso_fill_and_clear_parallel(benchmark::State& state) {
+  dispenso::TaskSet tasks(dispenso::globalThreadPool());
+  for (auto UNUSED_VAR : state) {
+    dispenso::ConcurrentVector<std::string> c;
+    c.grow_by(kLength, longString(), tasks);
+    c.clear(tasks);
+  }
+}
+
 BENCHMARK(BM_std_push_back_serial);
 BENCHMARK(BM_deque_push_back_serial);
 #if !defined(BENCHMARK_WITHOUT_TBB)
@@ -735,6 +804,9 @@ BENCHMARK(BM_deque_iterate);
 BENCHMARK(BM_tbb_iterate);
 #endif // !BENCHMARK_WITHOUT_TBB
 BENCHMARK(BM_dispenso_iterate);
+BENCHMARK(BM_dispenso_iterate_segments);
+BENCHMARK(BM_dispenso_copy_out_serial)->UseRealTime();
+BENCHMARK(BM_dispenso_copy_out_parallel)->UseRealTime();
 
 BENCHMARK(BM_std_iterate_reverse);
 BENCHMARK(BM_deque_iterate_reverse);
@@ -805,4 +877,7 @@ BENCHMARK(BM_tbb_parallel_grow_by_max);
 #endif // !BENCHMARK_WITHOUT_TBB
 BENCHMARK(BM_dispenso_parallel_grow_by_max);
 
+BENCHMARK(BM_dispenso_fill_and_clear_serial)->UseRealTime();
+BENCHMARK(BM_dispenso_fill_and_clear_parallel)->UseRealTime();
+
 BENCHMARK_MAIN();
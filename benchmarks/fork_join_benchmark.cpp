@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/fork_join.h>
+#include <dispenso/task_set.h>
+
+#if !defined(BENCHMARK_WITHOUT_TBB)
+#include "tbb/task_group.h"
+#include "tbb/task_scheduler_init.h"
+#endif // !BENCHMARK_WITHOUT_TBB
+
+#include "thread_benchmark_common.h"
+
+// Naive recursive fibonacci: nearly all of the work is task overhead.
+constexpr int kFibN = 28;
+constexpr int kSerialCutoff = 12;
+
+uint64_t serialFib(int n) {
+  return n < 2 ? static_cast<uint64_t>(n) : serialFib(n - 1) + serialFib(n - 2);
+}
+
+void checkResult(uint64_t result) {
+  if (result != serialFib(kFibN)) {
+    std::cerr << "FAIL! " << result << std::endl;
+    abort();
+  }
+}
+
+void BM_serial(benchmark::State& state) {
+  uint64_t result = 0;
+  for (auto UNUSED_VAR : state) {
+    result = serialFib(kFibN);
+  }
+  checkResult(result);
+}
+
+uint64_t taskSetFib(dispenso::ThreadPool& pool, int n) {
+  if (n < kSerialCutoff) {
+    return serialFib(n);
+  }
+  uint64_t a;
+  uint64_t b;
+  dispenso::TaskSet tasks(pool);
+  tasks.schedule([&]() { a = taskSetFib(pool, n - 1); });
+  b = taskSetFib(pool, n - 2);
+  tasks.wait();
+  return a + b;
+}
+
+void BM_dispenso_task_set(benchmark::State& state) {
+  dispenso::ThreadPool pool(state.range(0) - 1);
+  uint64_t result = 0;
+  for (auto UNUSED_VAR : state) {
+    result = taskSetFib(pool, kFibN);
+  }
+  checkResult(result);
+}
+
+uint64_t forkJoinFib(dispenso::ThreadPool& pool, int n) {
+  if (n < kSerialCutoff) {
+    return serialFib(n);
+  }
+  uint64_t a;
+  uint64_t b;
+  dispenso::forkJoin(
+      pool, [&]() { b = forkJoinFib(pool, n - 2); }, [&]() { a = forkJoinFib(pool, n - 1); });
+  return a + b;
+}
+
+void BM_dispenso_fork_join(benchmark::State& state) {
+  dispenso::ThreadPool pool(state.range(0) - 1);
+  uint64_t result = 0;
+  for (auto UNUSED_VAR : state) {
+    result = forkJoinFib(pool, kFibN);
+  }
+  checkResult(result);
+}
+
+#if !defined(BENCHMARK_WITHOUT_TBB)
+uint64_t tbbFib(int n) {
+  if (n < kSerialCutoff) {
+    return serialFib(n);
+  }
+  uint64_t a;
+  uint64_t b;
+  tbb::task_group group;
+  group.run([&]() { a = tbbFib(n - 1); });
+  b = tbbFib(n - 2);
+  group.wait();
+  return a + b;
+}
+
+void BM_tbb(benchmark::State& state) {
+  tbb::task_scheduler_init initsched(state.range(0));
+  uint64_t result = 0;
+  for (auto UNUSED_VAR : state) {
+    result = tbbFib(kFibN);
+  }
+  checkResult(result);
+}
+#endif // !BENCHMARK_WITHOUT_TBB
+
+static void CustomArguments(benchmark::internal::Benchmark* b) {
+  for (int i : benchmarkThreads()) {
+    b->Arg(i);
+  }
+}
+
+BENCHMARK(BM_serial)->UseRealTime();
+BENCHMARK(BM_dispenso_task_set)->Apply(CustomArguments)->UseRealTime();
+BENCHMARK(BM_dispenso_fork_join)->Apply(CustomArguments)->UseRealTime();
+#if !defined(BENCHMARK_WITHOUT_TBB)
+BENCHMARK(BM_tbb)->Apply(CustomArguments)->UseRealTime();
+#endif // !BENCHMARK_WITHOUT_TBB
+
+BENCHMARK_MAIN();
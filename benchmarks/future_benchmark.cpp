@@ -371,6 +371,38 @@ void BM_dispenso_tree_when_all(benchmark::State& state) {
   checkTree(root, depth, modulo);
 }
 
+// A long chain of single continuations, which is dominated by the per-link overhead of then().
+void BM_dispenso_then_chain(benchmark::State& state) {
+  const int64_t length = state.range(0);
+  dispenso::globalThreadPool();
+
+  int64_t result = 0;
+  for (auto UNUSED_VAR : state) {
+    dispenso::Future<int64_t> f = dispenso::make_ready_future<int64_t>(0);
+    for (int64_t i = 0; i < length; ++i) {
+      f = f.then([](dispenso::Future<int64_t>&& prev) { return prev.get() + 1; });
+    }
+    result = f.get();
+  }
+
+  if (result != length) {
+    std::cerr << "Mismatch! " << length << " vs " << result << std::endl;
+    std::abort();
+  }
+}
+
+// A cache hit that hands back an already known value, as in memoized lookups.
+void BM_dispenso_make_ready_future(benchmark::State& state) {
+  int64_t sum = 0;
+  int64_t i = 0;
+  for (auto UNUSED_VAR : state) {
+    dispenso::Future<int64_t> f = dispenso::make_ready_future(i++);
+    benchmark::DoNotOptimize(f);
+    sum += f.get();
+  }
+  benchmark::DoNotOptimize(sum);
+}
+
 BENCHMARK_TEMPLATE(BM_serial_tree, kSmallSize)->UseRealTime();
 BENCHMARK_TEMPLATE(BM_serial_tree, kMediumSize)->UseRealTime();
 BENCHMARK_TEMPLATE(BM_serial_tree, kLargeSize)->UseRealTime();
@@ -397,4 +429,8 @@ BENCHMARK_TEMPLATE(BM_dispenso_tree_when_all, kSmallSize)->UseRealTime();
 BENCHMARK_TEMPLATE(BM_dispenso_tree_when_all, kMediumSize)->UseRealTime();
 BENCHMARK_TEMPLATE(BM_dispenso_tree_when_all, kLargeSize)->UseRealTime();
 
+BENCHMARK(BM_dispenso_then_chain)->Arg(1000)->Arg(10000)->UseRealTime();
+
+BENCHMARK(BM_dispenso_make_ready_future);
+
 BENCHMARK_MAIN();
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <random>
+
+#include <dispenso/future.h>
+#include <dispenso/graph.h>
+
+#include "thread_benchmark_common.h"
+
+// A fixed random DAG, executed once per iteration, as e.g. a per-frame task graph would be.
+constexpr size_t kNumNodes = 500;
+constexpr size_t kMaxPreds = 3;
+
+const std::vector<std::vector<size_t>>& getPreds() {
+  static const std::vector<std::vector<size_t>> preds = []() {
+    std::mt19937 rng(7);
+    std::vector<std::vector<size_t>> p(kNumNodes);
+    for (size_t i = 1; i < kNumNodes; ++i) {
+      std::uniform_int_distribution<size_t> dist(0, i - 1);
+      for (size_t j = 0; j < std::min(i, kMaxPreds); ++j) {
+        p[i].push_back(dist(rng));
+      }
+    }
+    return p;
+  }();
+  return preds;
+}
+
+inline void work(std::vector<uint64_t>& values, size_t node) {
+  uint64_t v = node;
+  for (size_t i = 0; i < 64; ++i) {
+    v = v * 6364136223846793005ULL + 1442695040888963407ULL;
+  }
+  values[node] = v;
+}
+
+void BM_serial(benchmark::State& state) {
+  std::vector<uint64_t> values(kNumNodes);
+  for (auto UNUSED_VAR : state) {
+    for (size_t i = 0; i < kNumNodes; ++i) {
+      work(values, i);
+    }
+  }
+}
+
+void BM_dispenso_futures(benchmark::State& state) {
+  const int numThreads = state.range(0) - 1;
+  dispenso::ThreadPool pool(numThreads);
+  const auto& preds = getPreds();
+  std::vector<uint64_t> values(kNumNodes);
+
+  for (auto UNUSED_VAR : state) {
+    // The futures must be rebuilt for each execution.
+    std::vector<dispenso::Future<void>> futures;
+    futures.reserve(kNumNodes);
+    for (size_t i = 0; i < kNumNodes; ++i) {
+      std::vector<dispenso::Future<void>> deps;
+      for (size_t p : preds[i]) {
+        deps.push_back(futures[p]);
+      }
+      auto fn = [&values, i](auto&&) { work(values, i); };
+      if (deps.empty()) {
+        futures.push_back(dispenso::async(pool, [&values, i]() { work(values, i); }));
+      } else {
+        futures.push_back(dispenso::when_all(deps.begin(), deps.end()).then(fn, pool));
+      }
+    }
+    dispenso::when_all(futures.begin(), futures.end()).wait();
+  }
+}
+
+void BM_dispenso_graph(benchmark::State& state) {
+  const int numThreads = state.range(0) - 1;
+  dispenso::ThreadPool pool(numThreads);
+  const auto& preds = getPreds();
+  std::vector<uint64_t> values(kNumNodes);
+
+  dispenso::Graph graph;
+  for (size_t i = 0; i < kNumNodes; ++i) {
+    graph.addNode([&values, i]() { work(values, i); });
+    for (size_t p : preds[i]) {
+      graph.addEdge(p, i);
+    }
+  }
+
+  for (auto UNUSED_VAR : state) {
+    graph.execute(pool);
+  }
+}
+
+// Only a few inputs change per iteration, so only their downstream nodes need to run again.
+void BM_dispenso_graph_dirty(benchmark::State& state) {
+  const int numThreads = state.range(0) - 1;
+  dispenso::ThreadPool pool(numThreads);
+  const auto& preds = getPreds();
+  std::vector<uint64_t> values(kNumNodes);
+
+  dispenso::Graph graph;
+  for (size_t i = 0; i < kNumNodes; ++i) {
+    graph.addNode([&values, i]() { work(values, i); });
+    for (size_t p : preds[i]) {
+      graph.addEdge(p, i);
+    }
+  }
+  graph.execute(pool);
+
+  std::mt19937 rng(3);
+  std::uniform_int_distribution<size_t> dist(kNumNodes / 2, kNumNodes - 1);
+  for (auto UNUSED_VAR : state) {
+    for (int i = 0; i < 4; ++i) {
+      graph.markDirty(dist(rng));
+    }
+    graph.executeDirty(pool);
+  }
+}
+
+static void CustomArguments(benchmark::internal::Benchmark* b) {
+  for (int i : benchmarkThreads()) {
+    b->Arg(i);
+  }
+}
+
+BENCHMARK(BM_serial)->UseRealTime();
+BENCHMARK(BM_dispenso_futures)->Apply(CustomArguments)->UseRealTime();
+BENCHMARK(BM_dispenso_graph)->Apply(CustomArguments)->UseRealTime();
+BENCHMARK(BM_dispenso_graph_dirty)->Apply(CustomArguments)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+// Latency distributions for the thread pool's wake-up and fan-out paths.  Each iteration takes one
+// sample, and the p50, p99, p999 and max of the samples are reported as counters, in nanoseconds.
+// The time column is the mean.  Every case runs with signaling wake (sleep_us:0), and with polling
+// wake at a few sleep lengths, so that changes to the idle backoff and wake paths show up in the
+// tails.
+
+#include <atomic>
+#include <thread>
+
+#include <dispenso/latency_histogram.h>
+#include <dispenso/parallel_for.h>
+#include <dispenso/task_set.h>
+#include <dispenso/timing.h>
+
+#include "thread_benchmark_common.h"
+
+namespace {
+
+using namespace std::chrono_literals;
+
+// Long enough for idle threads to get through the default backoff and go to sleep.
+constexpr auto kParkTime = 2ms;
+constexpr int kWakeSamples = 2000;
+constexpr int kRoundTripSamples = 100000;
+constexpr int kFanOutSamples = 20000;
+
+void setWake(dispenso::ThreadPool& pool, int64_t sleepUs) {
+  if (sleepUs) {
+    pool.setSignalingWake(false, std::chrono::microseconds(sleepUs));
+  } else {
+    pool.setSignalingWake(true, std::chrono::microseconds(dispenso::kDefaultSleepLenUs));
+  }
+}
+
+void recordSample(benchmark::State& state, dispenso::LatencyHistogram& histogram, double seconds) {
+  histogram.record(static_cast<uint64_t>(seconds * 1e9));
+  state.SetIterationTime(seconds);
+}
+
+void reportPercentiles(benchmark::State& state, const dispenso::LatencyHistogram& histogram) {
+  state.counters["p50"] = static_cast<double>(histogram.percentile(50.0));
+  state.counters["p99"] = static_cast<double>(histogram.percentile(99.0));
+  state.counters["p999"] = static_cast<double>(histogram.percentile(99.9));
+  state.counters["max"] = static_cast<double>(histogram.max());
+}
+
+} // namespace
+
+// The time from scheduling a task on a pool whose only thread is asleep until the task starts.
+void BM_dispenso_wake(benchmark::State& state) {
+  dispenso::ThreadPool pool(1);
+  setWake(pool, state.range(0));
+  dispenso::LatencyHistogram histogram;
+  std::atomic<double> started(0.0);
+  for (auto UNUSED_VAR : state) {
+    std::this_thread::sleep_for(kParkTime);
+    started.store(0.0, std::memory_order_relaxed);
+    const double start = dispenso::getTime();
+    pool.schedule(
+        [&started]() { started.store(dispenso::getTime(), std::memory_order_release); },
+        dispenso::ForceQueuingTag());
+    double end;
+    while ((end = started.load(std::memory_order_acquire)) == 0.0) {
+      std::this_thread::yield();
+    }
+    recordSample(state, histogram, end - start);
+  }
+  reportPercentiles(state, histogram);
+}
+
+// One schedule plus wait on a TaskSet over a single-thread pool, back to back.
+void BM_dispenso_round_trip(benchmark::State& state) {
+  dispenso::ThreadPool pool(1);
+  setWake(pool, state.range(0));
+  dispenso::LatencyHistogram histogram;
+  dispenso::TaskSet tasks(pool);
+  int count = 0;
+  for (auto UNUSED_VAR : state) {
+    const double start = dispenso::getTime();
+    tasks.schedule([&count]() { ++count; }, dispenso::ForceQueuingTag());
+    tasks.wait();
+    recordSample(state, histogram, dispenso::getTime() - start);
+  }
+  benchmark::DoNotOptimize(count);
+  reportPercentiles(state, histogram);
+}
+
+// A parallel_for with one trivial item per thread, from the call until every item is done.
+void BM_dispenso_fan_out(benchmark::State& state) {
+  const int numThreads = static_cast<int>(state.range(0));
+  dispenso::ThreadPool pool(numThreads - 1);
+  setWake(pool, state.range(1));
+  dispenso::LatencyHistogram histogram;
+  std::vector<int> output(numThreads, 0);
+  for (auto UNUSED_VAR : state) {
+    const double start = dispenso::getTime();
+    dispenso::TaskSet tasks(pool);
+    dispenso::parallel_for(tasks, 0, numThreads, [&output](int i) { ++output[i]; });
+    recordSample(state, histogram, dispenso::getTime() - start);
+  }
+  benchmark::DoNotOptimize(output.data());
+  reportPercentiles(state, histogram);
+}
+
+static void WakeArguments(benchmark::internal::Benchmark* b) {
+  b->ArgNames({"sleep_us"});
+  for (int sleepUs : {0, 50, static_cast<int>(dispenso::kDefaultSleepLenUs)}) {
+    b->Arg(sleepUs);
+  }
+}
+
+static void FanOutArguments(benchmark::internal::Benchmark* b) {
+  b->ArgNames({"threads", "sleep_us"});
+  for (int sleepUs : {0, 50, static_cast<int>(dispenso::kDefaultSleepLenUs)}) {
+    for (int threads : {2, 8, 64}) {
+      b->Args({threads, sleepUs});
+    }
+  }
+}
+
+BENCHMARK(BM_dispenso_wake)->Apply(WakeArguments)->Iterations(kWakeSamples)->UseManualTime();
+BENCHMARK(BM_dispenso_round_trip)
+    ->Apply(WakeArguments)
+    ->Iterations(kRoundTripSamples)
+    ->UseManualTime();
+BENCHMARK(BM_dispenso_fan_out)
+    ->Apply(FanOutArguments)
+    ->Iterations(kFanOutSamples)
+    ->UseManualTime();
+
+BENCHMARK_MAIN();
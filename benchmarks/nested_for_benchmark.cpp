@@ -266,7 +266,7 @@ void BM_async(benchmark::State& state) {
 
 static void CustomArguments(benchmark::internal::Benchmark* b) {
   for (int j : {kSmallSize, kMediumSize, kLargeSize}) {
-    for (int i : pow2HalfStepThreads()) {
+    for (int i : benchmarkThreads()) {
       b->Args({i, j});
     }
   }
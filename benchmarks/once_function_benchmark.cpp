@@ -8,8 +8,10 @@
 #include <cstring>
 #include <deque>
 #include <functional>
+#include <vector>
 
 #include <dispenso/once_function.h>
+#include <dispenso/unique_function.h>
 
 #include "benchmark_common.h"
 
@@ -90,6 +92,11 @@ void BM_move_once_function(benchmark::State& state) {
   runMoveLoop<dispenso::OnceFunction>(state, Foo<kSize>());
 }
 
+template <size_t kSize>
+void BM_move_unique_function(benchmark::State& state) {
+  runMoveLoop<dispenso::UniqueFunction<void()>>(state, Foo<kSize>());
+}
+
 constexpr int kMediumLoopLen = 200;
 
 template <size_t kSize>
@@ -125,17 +132,43 @@ void BM_queue_once_function(benchmark::State& state) {
   }
 }
 
+// Functors that are called repeatedly, as callbacks are.
+template <typename Func>
+void runRepeatedCalls(benchmark::State& state) {
+  std::vector<Func> funcs;
+  for (int i = 0; i < kMediumLoopLen; ++i) {
+    funcs.emplace_back(Foo<kMediumSize>());
+  }
+  for (auto UNUSED_VAR : state) {
+    for (auto& f : funcs) {
+      f();
+    }
+  }
+}
+
+void BM_call_std_function(benchmark::State& state) {
+  runRepeatedCalls<std::function<void()>>(state);
+}
+
+void BM_call_unique_function(benchmark::State& state) {
+  runRepeatedCalls<dispenso::UniqueFunction<void()>>(state);
+}
+
 BENCHMARK_TEMPLATE(BM_move_std_function, kSmallSize);
 BENCHMARK_TEMPLATE(BM_move_once_function, kSmallSize);
+BENCHMARK_TEMPLATE(BM_move_unique_function, kSmallSize);
 
 BENCHMARK_TEMPLATE(BM_move_std_function, kMediumSize);
 BENCHMARK_TEMPLATE(BM_move_once_function, kMediumSize);
+BENCHMARK_TEMPLATE(BM_move_unique_function, kMediumSize);
 
 BENCHMARK_TEMPLATE(BM_move_std_function, kLargeSize);
 BENCHMARK_TEMPLATE(BM_move_once_function, kLargeSize);
+BENCHMARK_TEMPLATE(BM_move_unique_function, kLargeSize);
 
 BENCHMARK_TEMPLATE(BM_move_std_function, kExtraLargeSize);
 BENCHMARK_TEMPLATE(BM_move_once_function, kExtraLargeSize);
+BENCHMARK_TEMPLATE(BM_move_unique_function, kExtraLargeSize);
 
 BENCHMARK_TEMPLATE(BM_queue_inline_function, kSmallSize);
 BENCHMARK_TEMPLATE(BM_queue_std_function, kSmallSize);
@@ -153,4 +186,7 @@ BENCHMARK_TEMPLATE(BM_queue_inline_function, kExtraLargeSize);
 BENCHMARK_TEMPLATE(BM_queue_std_function, kExtraLargeSize);
 BENCHMARK_TEMPLATE(BM_queue_once_function, kExtraLargeSize);
 
+BENCHMARK(BM_call_std_function);
+BENCHMARK(BM_call_unique_function);
+
 BENCHMARK_MAIN();
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <numeric>
+#include <unordered_map>
+
+#include <dispenso/parallel_scan.h>
+
+// std::execution::par requires linking TBB under libstdc++, so only use it where it is available.
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<execution>) && (!defined(__GLIBCXX__) || !defined(BENCHMARK_WITHOUT_TBB))
+#include <execution>
+#define BENCHMARK_WITH_STD_PAR 1
+#endif
+#endif
+
+#if !defined(BENCHMARK_WITHOUT_TBB)
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_scan.h"
+#include "tbb/task_scheduler_init.h"
+#endif // !BENCHMARK_WITHOUT_TBB
+
+#include "thread_benchmark_common.h"
+
+static uint32_t kSeed(8);
+static constexpr int kSmallSize = 1000;
+static constexpr int kMediumSize = 1000000;
+static constexpr int kLargeSize = 100000000;
+
+const std::vector<int64_t>& getInputs(int num_elements) {
+  static std::unordered_map<int, std::vector<int64_t>> vecs;
+  auto it = vecs.find(num_elements);
+  if (it != vecs.end()) {
+    return it->second;
+  }
+  // No need to use a high-quality rng for this test.
+  srand(kSeed);
+  std::vector<int64_t> values;
+  values.reserve(num_elements);
+  for (int i = 0; i < num_elements; ++i) {
+    values.push_back((rand() & 255) - 127);
+  }
+  auto res = vecs.emplace(num_elements, std::move(values));
+  assert(res.second);
+  return res.first->second;
+}
+
+void checkResults(const std::vector<int64_t>& inputs, const std::vector<int64_t>& output) {
+  int64_t expected = 0;
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    expected += inputs[i];
+    if (output[i] != expected) {
+      std::cerr << "FAIL! " << expected << " vs " << output[i] << " at " << i << std::endl;
+      abort();
+    }
+  }
+}
+
+template <int num_elements>
+void BM_serial(benchmark::State& state) {
+  auto& input = getInputs(num_elements);
+  std::vector<int64_t> output(num_elements);
+  for (auto UNUSED_VAR : state) {
+    std::partial_sum(input.begin(), input.end(), output.begin());
+  }
+  checkResults(input, output);
+}
+
+void BM_dispenso(benchmark::State& state) {
+  const int num_threads = state.range(0) - 1;
+  const int num_elements = state.range(1);
+
+  dispenso::ThreadPool pool(num_threads);
+
+  auto& input = getInputs(num_elements);
+  std::vector<int64_t> output(num_elements);
+  for (auto UNUSED_VAR : state) {
+    dispenso::TaskSet tasks(pool);
+    dispenso::parallel_inclusive_scan(tasks, input.begin(), input.end(), output.begin());
+  }
+  checkResults(input, output);
+}
+
+#if defined(BENCHMARK_WITH_STD_PAR)
+void BM_std_par(benchmark::State& state) {
+  const int num_elements = state.range(1);
+
+  auto& input = getInputs(num_elements);
+  std::vector<int64_t> output(num_elements);
+  for (auto UNUSED_VAR : state) {
+    std::inclusive_scan(std::execution::par, input.begin(), input.end(), output.begin());
+  }
+  checkResults(input, output);
+}
+#endif // BENCHMARK_WITH_STD_PAR
+
+#if !defined(BENCHMARK_WITHOUT_TBB)
+void BM_tbb(benchmark::State& state) {
+  const int num_threads = state.range(0);
+  const int num_elements = state.range(1);
+
+  auto& input = getInputs(num_elements);
+  std::vector<int64_t> output(num_elements);
+  for (auto UNUSED_VAR : state) {
+    tbb::task_scheduler_init initsched(num_threads);
+    tbb::parallel_scan(
+        tbb::blocked_range<size_t>(0, input.size()),
+        int64_t{0},
+        [&input, &output](const tbb::blocked_range<size_t>& r, int64_t sum, bool isFinal) {
+          for (size_t i = r.begin(); i != r.end(); ++i) {
+            sum += input[i];
+            if (isFinal) {
+              output[i] = sum;
+            }
+          }
+          return sum;
+        },
+        [](int64_t x, int64_t y) { return x + y; });
+  }
+  checkResults(input, output);
+}
+#endif // !BENCHMARK_WITHOUT_TBB
+
+static void CustomArguments(benchmark::internal::Benchmark* b) {
+  for (int j : {kSmallSize, kMediumSize, kLargeSize}) {
+    for (int i : benchmarkThreads()) {
+      b->Args({i, j});
+    }
+  }
+}
+
+static void StdParArguments(benchmark::internal::Benchmark* b) {
+  // The standard parallel policies do not expose a thread count.
+  for (int j : {kSmallSize, kMediumSize, kLargeSize}) {
+    b->Args({0, j});
+  }
+}
+
+BENCHMARK_TEMPLATE(BM_serial, kSmallSize);
+BENCHMARK_TEMPLATE(BM_serial, kMediumSize);
+BENCHMARK_TEMPLATE(BM_serial, kLargeSize);
+
+#if !defined(BENCHMARK_WITHOUT_TBB)
+BENCHMARK(BM_tbb)->Apply(CustomArguments)->UseRealTime();
+#endif // !BENCHMARK_WITHOUT_TBB
+#if defined(BENCHMARK_WITH_STD_PAR)
+BENCHMARK(BM_std_par)->Apply(StdParArguments)->UseRealTime();
+#endif // BENCHMARK_WITH_STD_PAR
+BENCHMARK(BM_dispenso)->Apply(CustomArguments)->UseRealTime();
+
+BENCHMARK_MAIN();
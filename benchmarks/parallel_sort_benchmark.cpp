@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <algorithm>
+#include <random>
+#include <unordered_map>
+
+#include <dispenso/parallel_sort.h>
+
+#if !defined(BENCHMARK_WITHOUT_TBB)
+#include "tbb/parallel_sort.h"
+#include "tbb/task_scheduler_init.h"
+#endif // !BENCHMARK_WITHOUT_TBB
+
+#include "thread_benchmark_common.h"
+
+static constexpr int kSmallSize = 10000;
+static constexpr int kMediumSize = 1000000;
+static constexpr int kLargeSize = 20000000;
+
+const std::vector<uint64_t>& getInputs(int num_elements) {
+  static std::unordered_map<int, std::vector<uint64_t>> vecs;
+  auto it = vecs.find(num_elements);
+  if (it != vecs.end()) {
+    return it->second;
+  }
+  std::mt19937_64 rng(num_elements);
+  std::vector<uint64_t> values(num_elements);
+  for (auto& v : values) {
+    v = rng();
+  }
+  auto res = vecs.emplace(num_elements, std::move(values));
+  assert(res.second);
+  return res.first->second;
+}
+
+void checkResults(const std::vector<uint64_t>& values) {
+  if (!std::is_sorted(values.begin(), values.end())) {
+    std::cerr << "FAIL! Not sorted" << std::endl;
+    abort();
+  }
+}
+
+// Comparing through a lambda disables the radix path, to measure the comparison sort.
+auto kLess = [](uint64_t a, uint64_t b) { return a < b; };
+
+template <int num_elements>
+void BM_std_sort(benchmark::State& state) {
+  auto& input = getInputs(num_elements);
+  std::vector<uint64_t> values;
+  for (auto UNUSED_VAR : state) {
+    state.PauseTiming();
+    values = input;
+    state.ResumeTiming();
+    std::sort(values.begin(), values.end());
+  }
+  checkResults(values);
+}
+
+void BM_dispenso_radix(benchmark::State& state) {
+  const int num_threads = state.range(0) - 1;
+  const int num_elements = state.range(1);
+
+  dispenso::ThreadPool pool(num_threads);
+
+  auto& input = getInputs(num_elements);
+  std::vector<uint64_t> values;
+  for (auto UNUSED_VAR : state) {
+    state.PauseTiming();
+    values = input;
+    state.ResumeTiming();
+    dispenso::TaskSet tasks(pool);
+    dispenso::parallel_sort(tasks, values.begin(), values.end());
+  }
+  checkResults(values);
+}
+
+void BM_dispenso_merge(benchmark::State& state) {
+  const int num_threads = state.range(0) - 1;
+  const int num_elements = state.range(1);
+
+  dispenso::ThreadPool pool(num_threads);
+
+  auto& input = getInputs(num_elements);
+  std::vector<uint64_t> values;
+  for (auto UNUSED_VAR : state) {
+    state.PauseTiming();
+    values = input;
+    state.ResumeTiming();
+    dispenso::TaskSet tasks(pool);
+    dispenso::parallel_sort(tasks, values.begin(), values.end(), kLess);
+  }
+  checkResults(values);
+}
+
+#if !defined(BENCHMARK_WITHOUT_TBB)
+void BM_tbb(benchmark::State& state) {
+  const int num_threads = state.range(0);
+  const int num_elements = state.range(1);
+
+  auto& input = getInputs(num_elements);
+  std::vector<uint64_t> values;
+  for (auto UNUSED_VAR : state) {
+    state.PauseTiming();
+    values = input;
+    state.ResumeTiming();
+    tbb::task_scheduler_init initsched(num_threads);
+    tbb::parallel_sort(values.begin(), values.end());
+  }
+  checkResults(values);
+}
+#endif // !BENCHMARK_WITHOUT_TBB
+
+static void CustomArguments(benchmark::internal::Benchmark* b) {
+  for (int j : {kSmallSize, kMediumSize, kLargeSize}) {
+    for (int i : benchmarkThreads()) {
+      b->Args({i, j});
+    }
+  }
+}
+
+BENCHMARK_TEMPLATE(BM_std_sort, kSmallSize);
+BENCHMARK_TEMPLATE(BM_std_sort, kMediumSize);
+BENCHMARK_TEMPLATE(BM_std_sort, kLargeSize);
+
+#if !defined(BENCHMARK_WITHOUT_TBB)
+BENCHMARK(BM_tbb)->Apply(CustomArguments)->UseRealTime();
+#endif // !BENCHMARK_WITHOUT_TBB
+BENCHMARK(BM_dispenso_radix)->Apply(CustomArguments)->UseRealTime();
+BENCHMARK(BM_dispenso_merge)->Apply(CustomArguments)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -173,6 +173,161 @@ void BM_dispenso_par(benchmark::State& state) {
   checkResults(results);
 }
 
+// As runDispensoPar, but the pipeline picks how many threads each later stage gets.
+void runDispensoAuto(std::vector<std::unique_ptr<uint8_t[]>>& results) {
+  results.resize(kNumImages);
+  size_t counter = 0;
+
+  dispenso::pipeline(
+      [&counter]() -> dispenso::OpResult<Work> {
+        if (counter < kNumImages) {
+          return fillImage(Work(counter++));
+        }
+        return {};
+      },
+      dispenso::stage(computeGeometricMean, dispenso::kStageAuto),
+      dispenso::stage(
+          [&results](Work work) {
+            size_t index = work.index;
+            results[index] = tonemap(std::move(work));
+          },
+          dispenso::kStageAuto));
+}
+
+void BM_dispenso_auto(benchmark::State& state) {
+  std::vector<std::unique_ptr<uint8_t[]>> results;
+
+  (void)dispenso::globalThreadPool();
+
+  for (auto UNUSED_VAR : state) {
+    runDispensoAuto(results);
+  }
+
+  checkResults(results);
+}
+
+// Small items, for which per-item scheduling dominates unless items are batched.
+constexpr size_t kNumSmallItems = 1 << 18;
+
+uint64_t mixBits(uint64_t x) {
+  x ^= x >> 31;
+  x *= 0x7fb5d329728ea185ULL;
+  return x ^ (x >> 27);
+}
+
+void BM_dispenso_par_small(benchmark::State& state) {
+  (void)dispenso::globalThreadPool();
+
+  uint64_t sum = 0;
+  for (auto UNUSED_VAR : state) {
+    std::atomic<size_t> counter(0);
+    std::atomic<uint64_t> total(0);
+    dispenso::pipeline(
+        dispenso::stage(
+            [&counter]() -> dispenso::OpResult<uint64_t> {
+              size_t curIndex = counter.fetch_add(1, std::memory_order_relaxed);
+              if (curIndex < kNumSmallItems) {
+                return curIndex;
+              }
+              return {};
+            },
+            dispenso::kStageNoLimit),
+        dispenso::stage(mixBits, dispenso::kStageNoLimit),
+        dispenso::stage(
+            [&total](uint64_t v) { total.fetch_add(v, std::memory_order_relaxed); },
+            dispenso::kStageNoLimit));
+    sum = total.load(std::memory_order_relaxed);
+  }
+  benchmark::DoNotOptimize(sum);
+}
+
+// Several cheap unlimited transforms in a row, which run fused within one task per item.
+void BM_dispenso_par_small_deep(benchmark::State& state) {
+  (void)dispenso::globalThreadPool();
+
+  uint64_t sum = 0;
+  for (auto UNUSED_VAR : state) {
+    std::atomic<size_t> counter(0);
+    std::atomic<uint64_t> total(0);
+    dispenso::pipeline(
+        dispenso::stage(
+            [&counter]() -> dispenso::OpResult<uint64_t> {
+              size_t curIndex = counter.fetch_add(1, std::memory_order_relaxed);
+              if (curIndex < kNumSmallItems) {
+                return curIndex;
+              }
+              return {};
+            },
+            dispenso::kStageNoLimit),
+        dispenso::stage(mixBits, dispenso::kStageNoLimit),
+        dispenso::stage(mixBits, dispenso::kStageNoLimit),
+        dispenso::stage(mixBits, dispenso::kStageNoLimit),
+        dispenso::stage(
+            [&total](uint64_t v) { total.fetch_add(v, std::memory_order_relaxed); },
+            dispenso::kStageNoLimit));
+    sum = total.load(std::memory_order_relaxed);
+  }
+  benchmark::DoNotOptimize(sum);
+}
+
+void BM_dispenso_par_small_batched(benchmark::State& state) {
+  (void)dispenso::globalThreadPool();
+
+  const size_t batchSize = static_cast<size_t>(state.range(0));
+  uint64_t sum = 0;
+  for (auto UNUSED_VAR : state) {
+    std::atomic<size_t> counter(0);
+    std::atomic<uint64_t> total(0);
+    dispenso::pipeline(
+        dispenso::stage(
+            dispenso::batchGenerator(
+                [&counter]() -> dispenso::OpResult<uint64_t> {
+                  size_t curIndex = counter.fetch_add(1, std::memory_order_relaxed);
+                  if (curIndex < kNumSmallItems) {
+                    return curIndex;
+                  }
+                  return {};
+                },
+                batchSize),
+            dispenso::kStageNoLimit),
+        dispenso::stage(dispenso::batched(mixBits), dispenso::kStageNoLimit),
+        dispenso::stage(
+            [&total](std::vector<uint64_t> batch) {
+              uint64_t batchSum = 0;
+              for (uint64_t v : batch) {
+                batchSum += v;
+              }
+              total.fetch_add(batchSum, std::memory_order_relaxed);
+            },
+            dispenso::kStageNoLimit));
+    sum = total.load(std::memory_order_relaxed);
+  }
+  benchmark::DoNotOptimize(sum);
+}
+
+// All stages serial, with tiny items, so that the cost is dominated by hand-offs between stages.
+void BM_dispenso_serial_small(benchmark::State& state) {
+  (void)dispenso::globalThreadPool();
+
+  uint64_t sum = 0;
+  for (auto UNUSED_VAR : state) {
+    size_t counter = 0;
+    uint64_t total = 0;
+    dispenso::pipeline(
+        [&counter]() -> dispenso::OpResult<uint64_t> {
+          if (counter < kNumSmallItems) {
+            return counter++;
+          }
+          return {};
+        },
+        mixBits,
+        mixBits,
+        [&total](uint64_t v) { total += v; });
+    sum = total;
+  }
+  benchmark::DoNotOptimize(sum);
+}
+
 #if !defined(BENCHMARK_WITHOUT_TBB)
 void runTBB(std::vector<std::unique_ptr<uint8_t[]>>& results) {
   results.resize(kNumImages);
@@ -262,5 +417,10 @@ BENCHMARK(BM_dispenso_par)->UseRealTime();
 #if !defined(BENCHMARK_WITHOUT_TBB)
 BENCHMARK(BM_tbb_par)->UseRealTime();
 #endif // !BENCHMARK_WITHOUT_TBB
+BENCHMARK(BM_dispenso_auto)->UseRealTime();
+BENCHMARK(BM_dispenso_par_small)->UseRealTime();
+BENCHMARK(BM_dispenso_par_small_deep)->UseRealTime();
+BENCHMARK(BM_dispenso_par_small_batched)->RangeMultiplier(8)->Range(8, 4096)->UseRealTime();
+BENCHMARK(BM_dispenso_serial_small)->UseRealTime();
 
 BENCHMARK_MAIN();
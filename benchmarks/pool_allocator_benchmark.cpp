@@ -86,6 +86,15 @@ void BM_pool_allocator_threaded(benchmark::State& state) {
       [&allocator](char* buf) { allocator.dealloc(buf); });
 }
 
+template <size_t kSize, size_t kThreads>
+void BM_caching_pool_allocator_threaded(benchmark::State& state) {
+  dispenso::CachingPoolAllocator allocator(kSize, (1 << 20), ::malloc, ::free);
+  runThreaded<kThreads>(
+      state,
+      [&allocator]() { return allocator.alloc(); },
+      [&allocator](char* buf) { allocator.dealloc(buf); });
+}
+
 BENCHMARK_TEMPLATE(BM_mallocfree, kSmallSize)->Range(1 << 13, 1 << 15);
 BENCHMARK_TEMPLATE(BM_pool_allocator, kSmallSize)->Range(1 << 13, 1 << 15);
 
@@ -97,29 +106,38 @@ BENCHMARK_TEMPLATE(BM_pool_allocator, kLargeSize)->Range(1 << 13, 1 << 15);
 
 BENCHMARK_TEMPLATE2(BM_mallocfree_threaded, kSmallSize, 2)->Range(1 << 13, 1 << 15);
 BENCHMARK_TEMPLATE2(BM_pool_allocator_threaded, kSmallSize, 2)->Range(1 << 13, 1 << 15);
+BENCHMARK_TEMPLATE2(BM_caching_pool_allocator_threaded, kSmallSize, 2)->Range(1 << 13, 1 << 15);
 
 BENCHMARK_TEMPLATE2(BM_mallocfree_threaded, kMediumSize, 2)->Range(1 << 13, 1 << 15);
 BENCHMARK_TEMPLATE2(BM_pool_allocator_threaded, kMediumSize, 2)->Range(1 << 13, 1 << 15);
+BENCHMARK_TEMPLATE2(BM_caching_pool_allocator_threaded, kMediumSize, 2)->Range(1 << 13, 1 << 15);
 
 BENCHMARK_TEMPLATE2(BM_mallocfree_threaded, kLargeSize, 2)->Range(1 << 13, 1 << 15);
 BENCHMARK_TEMPLATE2(BM_pool_allocator_threaded, kLargeSize, 2)->Range(1 << 13, 1 << 15);
+BENCHMARK_TEMPLATE2(BM_caching_pool_allocator_threaded, kLargeSize, 2)->Range(1 << 13, 1 << 15);
 
 BENCHMARK_TEMPLATE2(BM_mallocfree_threaded, kSmallSize, 8)->Range(1 << 13, 1 << 15);
 BENCHMARK_TEMPLATE2(BM_pool_allocator_threaded, kSmallSize, 8)->Range(1 << 13, 1 << 15);
+BENCHMARK_TEMPLATE2(BM_caching_pool_allocator_threaded, kSmallSize, 8)->Range(1 << 13, 1 << 15);
 
 BENCHMARK_TEMPLATE2(BM_mallocfree_threaded, kMediumSize, 8)->Range(1 << 13, 1 << 15);
 BENCHMARK_TEMPLATE2(BM_pool_allocator_threaded, kMediumSize, 8)->Range(1 << 13, 1 << 15);
+BENCHMARK_TEMPLATE2(BM_caching_pool_allocator_threaded, kMediumSize, 8)->Range(1 << 13, 1 << 15);
 
 BENCHMARK_TEMPLATE2(BM_mallocfree_threaded, kLargeSize, 8)->Range(1 << 13, 1 << 15);
 BENCHMARK_TEMPLATE2(BM_pool_allocator_threaded, kLargeSize, 8)->Range(1 << 13, 1 << 15);
+BENCHMARK_TEMPLATE2(BM_caching_pool_allocator_threaded, kLargeSize, 8)->Range(1 << 13, 1 << 15);
 
 BENCHMARK_TEMPLATE2(BM_mallocfree_threaded, kSmallSize, 16)->Range(1 << 13, 1 << 15);
 BENCHMARK_TEMPLATE2(BM_pool_allocator_threaded, kSmallSize, 16)->Range(1 << 13, 1 << 15);
+BENCHMARK_TEMPLATE2(BM_caching_pool_allocator_threaded, kSmallSize, 16)->Range(1 << 13, 1 << 15);
 
 BENCHMARK_TEMPLATE2(BM_mallocfree_threaded, kMediumSize, 16)->Range(1 << 13, 1 << 15);
 BENCHMARK_TEMPLATE2(BM_pool_allocator_threaded, kMediumSize, 16)->Range(1 << 13, 1 << 15);
+BENCHMARK_TEMPLATE2(BM_caching_pool_allocator_threaded, kMediumSize, 16)->Range(1 << 13, 1 << 15);
 
 BENCHMARK_TEMPLATE2(BM_mallocfree_threaded, kLargeSize, 16)->Range(1 << 13, 1 << 15);
 BENCHMARK_TEMPLATE2(BM_pool_allocator_threaded, kLargeSize, 16)->Range(1 << 13, 1 << 15);
+BENCHMARK_TEMPLATE2(BM_caching_pool_allocator_threaded, kLargeSize, 16)->Range(1 << 13, 1 << 15);
 
 BENCHMARK_MAIN();
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+// Compares ways of sharing a small, read-mostly table: reader/writer locks, SeqLock, and RcuPtr.
+
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+
+#include <dispenso/rcu.h>
+#include <dispenso/rw_lock.h>
+#include <dispenso/seq_lock.h>
+#include <dispenso/task_set.h>
+
+#include "thread_benchmark_common.h"
+
+namespace {
+constexpr int kReadsPerTask = 1 << 18;
+// One write per this many reads of the first task.
+constexpr int kWritePeriod = 1 << 14;
+
+struct Table {
+  int64_t routes[8];
+};
+
+template <typename MutexT>
+class LockedTable {
+ public:
+  int64_t read(int i) {
+    std::shared_lock<MutexT> lk(mtx_);
+    return table_.routes[i & 7];
+  }
+  void write(int64_t v) {
+    std::lock_guard<MutexT> lk(mtx_);
+    table_.routes[v & 7] = v;
+  }
+
+ private:
+  MutexT mtx_;
+  Table table_{};
+};
+
+class SeqLockTable {
+ public:
+  int64_t read(int i) {
+    return table_.load().routes[i & 7];
+  }
+  void write(int64_t v) {
+    table_.update([v](Table& t) { t.routes[v & 7] = v; });
+  }
+
+ private:
+  dispenso::SeqLock<Table> table_{Table{}};
+};
+
+class RcuTable {
+ public:
+  int64_t read(int i) {
+    return table_.read()->routes[i & 7];
+  }
+  void write(int64_t v) {
+    auto next = std::make_unique<Table>(*table_.read());
+    next->routes[v & 7] = v;
+    table_.update(std::move(next));
+  }
+
+ private:
+  dispenso::RcuPtr<Table> table_{std::make_unique<Table>()};
+};
+} // namespace
+
+template <typename TableT>
+void BM_read_mostly(benchmark::State& state) {
+  const int numTasks = state.range(0);
+  TableT table;
+  std::atomic<int64_t> total(0);
+  dispenso::TaskSet tasks(dispenso::globalThreadPool());
+  for (auto UNUSED_VAR : state) {
+    for (int t = 0; t < numTasks; ++t) {
+      tasks.schedule([&table, &total, t]() {
+        int64_t sum = 0;
+        for (int i = 0; i < kReadsPerTask; ++i) {
+          if (t == 0 && i % kWritePeriod == 0) {
+            table.write(i);
+          }
+          sum += table.read(i);
+        }
+        total.fetch_add(sum, std::memory_order_relaxed);
+      });
+    }
+    tasks.wait();
+  }
+  benchmark::DoNotOptimize(total.load());
+}
+
+static void CustomArguments(benchmark::internal::Benchmark* b) {
+  for (int s : benchmarkThreads()) {
+    b->Arg(s);
+  }
+}
+
+BENCHMARK_TEMPLATE(BM_read_mostly, LockedTable<std::shared_mutex>)
+    ->Apply(CustomArguments)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_read_mostly, LockedTable<dispenso::RWLock>)
+    ->Apply(CustomArguments)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_read_mostly, LockedTable<dispenso::DistributedRWLock>)
+    ->Apply(CustomArguments)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_read_mostly, SeqLockTable)->Apply(CustomArguments)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_read_mostly, RcuTable)->Apply(CustomArguments)->UseRealTime();
@@ -0,0 +1,323 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+// Merges the CSV output of dispenso's benchmarks into a single scaling report.
+//
+// Usage: benchmark_report <output prefix> [--sweep] <benchmark>=<results.csv> ...
+//
+// Each input is a file written by a benchmark run with --benchmark_out_format=csv.  Inputs marked
+// with --sweep come from benchmarks whose first argument is the thread count (those built on
+// benchmarkThreads()); for the rest, only Google Benchmark's own threads:N suffix is treated as a
+// thread count.  Benchmark names are split as BM_<library>[_<family>]/<args>, so that e.g.
+// BM_tbb/8/1000 and BM_dispenso/8/1000 compare TBB and dispenso on the same case.
+//
+// Writes <output prefix>.csv and <output prefix>.json, with one row per run holding the real time
+// in nanoseconds, the speedup and parallel efficiency relative to the same library's run at the
+// fewest threads, and the time relative to dispenso's run of the same case.
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+struct Result {
+  std::string benchmark;
+  std::string library;
+  std::string family;
+  std::string args;
+  int threads = 0;
+  double timeNs = 0.0;
+  double speedup = 0.0;
+  double efficiency = 0.0;
+  double vsDispenso = 0.0;
+};
+
+std::vector<std::string> parseCsvLine(const std::string& line) {
+  std::vector<std::string> fields(1);
+  bool quoted = false;
+  for (size_t i = 0; i < line.size(); ++i) {
+    const char c = line[i];
+    if (quoted) {
+      if (c == '"' && i + 1 < line.size() && line[i + 1] == '"') {
+        fields.back() += '"';
+        ++i;
+      } else if (c == '"') {
+        quoted = false;
+      } else {
+        fields.back() += c;
+      }
+    } else if (c == '"') {
+      quoted = true;
+    } else if (c == ',') {
+      fields.emplace_back();
+    } else if (c != '\r') {
+      fields.back() += c;
+    }
+  }
+  return fields;
+}
+
+bool endsWith(const std::string& s, const std::string& suffix) {
+  return s.size() >= suffix.size() &&
+      s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool isNumber(const std::string& s) {
+  return !s.empty() && s.find_first_not_of("-0123456789") == std::string::npos;
+}
+
+double toNs(double time, const std::string& unit) {
+  if (unit == "us") {
+    return time * 1e3;
+  } else if (unit == "ms") {
+    return time * 1e6;
+  } else if (unit == "s") {
+    return time * 1e9;
+  }
+  return time;
+}
+
+// Fills in library, family, args, and threads from a run name like "BM_dispenso_graph/8/1000".
+void parseName(const std::string& name, bool sweep, Result& result) {
+  std::vector<std::string> parts;
+  std::istringstream in(name);
+  std::string part;
+  while (std::getline(in, part, '/')) {
+    parts.push_back(part);
+  }
+  std::string base = parts.empty() ? name : parts.front();
+  if (base.compare(0, 3, "BM_") == 0) {
+    base = base.substr(3);
+  }
+  const size_t split = std::min(base.find('_'), base.find('<'));
+  result.library = base.substr(0, split);
+  result.family = split == std::string::npos ? "" : base.substr(split + (base[split] == '_'));
+
+  bool first = true;
+  for (size_t i = 1; i < parts.size(); ++i) {
+    const std::string& p = parts[i];
+    const size_t colon = p.find(':');
+    const std::string key = colon == std::string::npos ? "" : p.substr(0, colon);
+    const std::string value = colon == std::string::npos ? p : p.substr(colon + 1);
+    if (key == "threads" && isNumber(value)) {
+      result.threads = std::atoi(value.c_str());
+    } else if (isNumber(value) && sweep && first) {
+      result.threads = std::atoi(value.c_str());
+    } else if (isNumber(value) || (!key.empty() && key != "min_time" && key != "iterations")) {
+      result.args += (result.args.empty() ? "" : "/") + p;
+    }
+    first = first && !isNumber(value);
+  }
+}
+
+// Reads one benchmark's results.  Repeated runs are averaged, unless a median was reported.
+bool readResults(
+    const std::string& benchmark,
+    const std::string& path,
+    bool sweep,
+    std::vector<Result>& results) {
+  std::ifstream in(path);
+  if (!in) {
+    std::cerr << "Could not open " << path << std::endl;
+    return false;
+  }
+  std::string line;
+  std::vector<std::string> header;
+  // The file begins with the benchmark context; the CSV starts at its header.
+  while (std::getline(in, line)) {
+    if (line.compare(0, 5, "name,") == 0) {
+      header = parseCsvLine(line);
+      break;
+    }
+  }
+  auto column = [&header](const char* label) {
+    return static_cast<size_t>(std::find(header.begin(), header.end(), label) - header.begin());
+  };
+  const size_t kName = column("name");
+  const size_t kTime = column("real_time");
+  const size_t kUnit = column("time_unit");
+  const size_t kError = column("error_occurred");
+  if (kTime >= header.size() || kUnit >= header.size()) {
+    std::cerr << "No results found in " << path << std::endl;
+    return false;
+  }
+
+  struct Accum {
+    double sum = 0.0;
+    int count = 0;
+    double median = -1.0;
+  };
+  std::vector<std::string> order;
+  std::map<std::string, Accum> byName;
+  while (std::getline(in, line)) {
+    std::vector<std::string> fields = parseCsvLine(line);
+    if (fields.size() <= std::max(kTime, kUnit) ||
+        (kError < fields.size() && fields[kError] == "true")) {
+      continue;
+    }
+    std::string name = fields[kName];
+    const double timeNs = toNs(std::atof(fields[kTime].c_str()), fields[kUnit]);
+    bool isMedian = false;
+    if (endsWith(name, "_median")) {
+      name.resize(name.size() - 7);
+      isMedian = true;
+    } else if (endsWith(name, "_mean") || endsWith(name, "_stddev") || endsWith(name, "_cv")) {
+      continue;
+    }
+    auto it = byName.find(name);
+    if (it == byName.end()) {
+      order.push_back(name);
+      it = byName.emplace(name, Accum()).first;
+    }
+    if (isMedian) {
+      it->second.median = timeNs;
+    } else {
+      it->second.sum += timeNs;
+      ++it->second.count;
+    }
+  }
+
+  for (const std::string& name : order) {
+    const Accum& accum = byName[name];
+    Result result;
+    result.benchmark = benchmark;
+    parseName(name, sweep, result);
+    result.timeNs = accum.median >= 0.0 ? accum.median : accum.sum / accum.count;
+    results.push_back(result);
+  }
+  return true;
+}
+
+void computeScaling(std::vector<Result>& results) {
+  using CaseKey = std::tuple<std::string, std::string, std::string, std::string>;
+  std::map<CaseKey, const Result*> baselines;
+  std::map<std::tuple<std::string, std::string, std::string, int>, double> dispensoTimes;
+  for (const Result& r : results) {
+    if (r.threads <= 0) {
+      continue;
+    }
+    const Result*& base = baselines[CaseKey(r.benchmark, r.library, r.family, r.args)];
+    if (!base || r.threads < base->threads) {
+      base = &r;
+    }
+  }
+  for (const Result& r : results) {
+    if (r.library == "dispenso") {
+      dispensoTimes[std::make_tuple(r.benchmark, r.family, r.args, r.threads)] = r.timeNs;
+    }
+  }
+  for (Result& r : results) {
+    if (r.threads > 0 && r.timeNs > 0.0) {
+      const Result* base = baselines[CaseKey(r.benchmark, r.library, r.family, r.args)];
+      r.speedup = base->timeNs / r.timeNs;
+      r.efficiency = r.speedup * base->threads / r.threads;
+    }
+    auto it = dispensoTimes.find(std::make_tuple(r.benchmark, r.family, r.args, r.threads));
+    if (it != dispensoTimes.end() && it->second > 0.0) {
+      r.vsDispenso = r.timeNs / it->second;
+    }
+  }
+}
+
+std::string jsonString(const std::string& s) {
+  std::string out = "\"";
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+    }
+    out += c;
+  }
+  return out + '"';
+}
+
+// A missing value is written as an empty CSV field, or a JSON null.
+std::string value(double v, bool json) {
+  if (v <= 0.0) {
+    return json ? "null" : "";
+  }
+  std::ostringstream out;
+  out << std::setprecision(6) << v;
+  return out.str();
+}
+
+bool writeCsv(const std::string& path, const std::vector<Result>& results) {
+  std::ofstream out(path);
+  out << "benchmark,library,family,args,threads,real_time_ns,speedup,efficiency,"
+         "time_vs_dispenso\n";
+  for (const Result& r : results) {
+    out << r.benchmark << ',' << r.library << ",\"" << r.family << "\",\"" << r.args << "\","
+        << (r.threads > 0 ? std::to_string(r.threads) : "") << ',' << value(r.timeNs, false)
+        << ',' << value(r.speedup, false) << ',' << value(r.efficiency, false) << ','
+        << value(r.vsDispenso, false) << '\n';
+  }
+  out.close();
+  return !out.fail();
+}
+
+bool writeJson(const std::string& path, const std::vector<Result>& results) {
+  std::ofstream out(path);
+  out << "{\"results\":[";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result& r = results[i];
+    out << (i ? "," : "") << "\n{\"benchmark\":" << jsonString(r.benchmark)
+        << ",\"library\":" << jsonString(r.library) << ",\"family\":" << jsonString(r.family)
+        << ",\"args\":" << jsonString(r.args)
+        << ",\"threads\":" << (r.threads > 0 ? std::to_string(r.threads) : "null")
+        << ",\"real_time_ns\":" << value(r.timeNs, true)
+        << ",\"speedup\":" << value(r.speedup, true)
+        << ",\"efficiency\":" << value(r.efficiency, true)
+        << ",\"time_vs_dispenso\":" << value(r.vsDispenso, true) << '}';
+  }
+  out << "\n]}\n";
+  out.close();
+  return !out.fail();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0]
+              << " <output prefix> [--sweep] <benchmark>=<results.csv> ..." << std::endl;
+    return 1;
+  }
+  std::vector<Result> results;
+  bool ok = true;
+  bool sweep = false;
+  for (int i = 2; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--sweep") {
+      sweep = true;
+      continue;
+    }
+    const size_t eq = arg.find('=');
+    if (eq == std::string::npos) {
+      std::cerr << "Expected <benchmark>=<results.csv>, got " << arg << std::endl;
+      return 1;
+    }
+    ok = readResults(arg.substr(0, eq), arg.substr(eq + 1), sweep, results) && ok;
+    sweep = false;
+  }
+  computeScaling(results);
+
+  const std::string prefix = argv[1];
+  if (!writeCsv(prefix + ".csv", results) || !writeJson(prefix + ".json", results)) {
+    std::cerr << "Could not write " << prefix << ".{csv,json}" << std::endl;
+    return 1;
+  }
+  std::cout << "Wrote " << results.size() << " results to " << prefix << ".{csv,json}"
+            << std::endl;
+  return ok ? 0 : 1;
+}
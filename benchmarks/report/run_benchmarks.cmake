@@ -0,0 +1,44 @@
+# Copyright (c) Meta Platforms, Inc. and affiliates.
+#
+# This source code is licensed under the MIT license found in the
+# LICENSE file in the root directory of this source tree.
+
+# Runs each benchmark over the topology-aware thread sweep, then merges the results into one
+# scaling report.  Invoked by the benchmark_report target, with:
+#   BENCHMARKS        A list of benchmark executables.
+#   SWEEP_BENCHMARKS  The subset whose first argument is the thread count.
+#   REPORT_TOOL       The benchmark_report executable.
+#   OUTPUT_DIR        Where per-benchmark results and the report are written.
+#   THREADS           The DISPENSO_BENCH_THREADS setting, e.g. "topology" or "1,16,64".
+#   EXTRA_ARGS        Extra arguments for every benchmark, e.g. --benchmark_filter=dispenso.
+
+cmake_minimum_required(VERSION 3.12)
+
+file(MAKE_DIRECTORY ${OUTPUT_DIR})
+separate_arguments(EXTRA_ARGS)
+
+set(REPORT_INPUTS)
+foreach(BENCHMARK ${BENCHMARKS})
+  get_filename_component(BENCHMARK_NAME ${BENCHMARK} NAME_WE)
+  set(RESULTS ${OUTPUT_DIR}/${BENCHMARK_NAME}.csv)
+  message(STATUS "Running ${BENCHMARK_NAME}")
+  execute_process(
+    COMMAND ${CMAKE_COMMAND} -E env DISPENSO_BENCH_THREADS=${THREADS}
+            ${BENCHMARK} --benchmark_out=${RESULTS} --benchmark_out_format=csv ${EXTRA_ARGS}
+    RESULT_VARIABLE STATUS)
+  if (NOT STATUS EQUAL 0)
+    message(WARNING "${BENCHMARK_NAME} failed (${STATUS}); its results are skipped")
+    continue()
+  endif()
+  if (BENCHMARK_NAME IN_LIST SWEEP_BENCHMARKS)
+    list(APPEND REPORT_INPUTS --sweep)
+  endif()
+  list(APPEND REPORT_INPUTS ${BENCHMARK_NAME}=${RESULTS})
+endforeach()
+
+execute_process(
+  COMMAND ${REPORT_TOOL} ${OUTPUT_DIR}/report ${REPORT_INPUTS}
+  RESULT_VARIABLE STATUS)
+if (NOT STATUS EQUAL 0)
+  message(FATAL_ERROR "Could not generate the benchmark report")
+endif()
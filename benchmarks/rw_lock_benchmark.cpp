@@ -106,6 +106,14 @@ BENCHMARK_TEMPLATE(BM_serial, std::shared_mutex)->Apply(CustomArgumentsSerial)->
 
 BENCHMARK_TEMPLATE(BM_serial, dispenso::RWLock)->Apply(CustomArgumentsSerial)->UseRealTime();
 
+BENCHMARK_TEMPLATE(BM_serial, dispenso::DistributedRWLock)
+    ->Apply(CustomArgumentsSerial)
+    ->UseRealTime();
+
 BENCHMARK_TEMPLATE(BM_parallel, std::shared_mutex)->Apply(CustomArgumentsParallel)->UseRealTime();
 
 BENCHMARK_TEMPLATE(BM_parallel, dispenso::RWLock)->Apply(CustomArgumentsParallel)->UseRealTime();
+
+BENCHMARK_TEMPLATE(BM_parallel, dispenso::DistributedRWLock)
+    ->Apply(CustomArgumentsParallel)
+    ->UseRealTime();
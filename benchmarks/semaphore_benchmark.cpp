@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+// Compares dispenso::Semaphore against moodycamel's LightweightSemaphore and (when built as C++20)
+// std::counting_semaphore, both for ping-pong handoff between two threads and for many threads
+// contending for a small number of permits.
+
+#include <thread>
+#include <vector>
+
+#if __cplusplus >= 202002L && defined(__has_include)
+#if __has_include(<semaphore>)
+#include <semaphore>
+#define BENCHMARK_HAS_STD_SEMAPHORE 1
+#endif // has <semaphore>
+#endif // C++20
+
+#include <dispenso/semaphore.h>
+#include <blockingconcurrentqueue.h>
+
+#include "thread_benchmark_common.h"
+
+constexpr int kPingPongs = 10000;
+constexpr int kAcquiresPerThread = 10000;
+constexpr int kPermits = 2;
+
+struct DispensoSemaphore : dispenso::Semaphore {
+  explicit DispensoSemaphore(int initial) : dispenso::Semaphore(initial) {}
+};
+
+struct MoodycamelSemaphore : moodycamel::LightweightSemaphore {
+  explicit MoodycamelSemaphore(int initial) : moodycamel::LightweightSemaphore(initial) {}
+  void acquire() {
+    wait();
+  }
+  void release() {
+    signal();
+  }
+};
+
+#if defined(BENCHMARK_HAS_STD_SEMAPHORE)
+struct StdSemaphore : std::counting_semaphore<> {
+  explicit StdSemaphore(int initial) : std::counting_semaphore<>(initial) {}
+};
+#endif // BENCHMARK_HAS_STD_SEMAPHORE
+
+template <typename Sem>
+void BM_ping_pong(benchmark::State& state) {
+  for (auto UNUSED_VAR : state) {
+    Sem ping(0);
+    Sem pong(0);
+    std::thread other([&]() {
+      for (int i = 0; i < kPingPongs; ++i) {
+        ping.acquire();
+        pong.release();
+      }
+    });
+    for (int i = 0; i < kPingPongs; ++i) {
+      ping.release();
+      pong.acquire();
+    }
+    other.join();
+  }
+}
+
+template <typename Sem>
+void BM_contended(benchmark::State& state) {
+  const int numThreads = state.range(0);
+  int64_t sum = 0;
+  for (auto UNUSED_VAR : state) {
+    Sem sem(kPermits);
+    std::vector<int64_t> sums(numThreads);
+    auto body = [&sem, &sums](int t) {
+      int64_t local = 0;
+      for (int i = 0; i < kAcquiresPerThread; ++i) {
+        sem.acquire();
+        for (int j = 0; j < 50; ++j) {
+          local += i ^ j;
+          benchmark::DoNotOptimize(local);
+        }
+        sem.release();
+      }
+      sums[t] = local;
+    };
+    std::vector<std::thread> threads;
+    for (int t = 1; t < numThreads; ++t) {
+      threads.emplace_back(body, t);
+    }
+    body(0);
+    for (auto& t : threads) {
+      t.join();
+    }
+    for (int64_t s : sums) {
+      sum += s;
+    }
+  }
+  benchmark::DoNotOptimize(sum);
+}
+
+static void CustomArguments(benchmark::internal::Benchmark* b) {
+  for (int s : benchmarkThreads()) {
+    b->Arg(s);
+  }
+}
+
+BENCHMARK_TEMPLATE(BM_ping_pong, DispensoSemaphore)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ping_pong, MoodycamelSemaphore)->UseRealTime();
+#if defined(BENCHMARK_HAS_STD_SEMAPHORE)
+BENCHMARK_TEMPLATE(BM_ping_pong, StdSemaphore)->UseRealTime();
+#endif // BENCHMARK_HAS_STD_SEMAPHORE
+
+BENCHMARK_TEMPLATE(BM_contended, DispensoSemaphore)->Apply(CustomArguments)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_contended, MoodycamelSemaphore)->Apply(CustomArguments)->UseRealTime();
+#if defined(BENCHMARK_HAS_STD_SEMAPHORE)
+BENCHMARK_TEMPLATE(BM_contended, StdSemaphore)->Apply(CustomArguments)->UseRealTime();
+#endif // BENCHMARK_HAS_STD_SEMAPHORE
@@ -72,6 +72,7 @@ void BM_dispenso(benchmark::State& state) {
 
   std::vector<int> output(num_elements, 0);
   dispenso::ThreadPool pool(num_threads);
+  configureBenchmarkPool(pool);
 
   auto& input = getInputs(num_elements);
   for (auto UNUSED_VAR : state) {
@@ -127,7 +128,7 @@ void BM_tbb(benchmark::State& state) {
 
 static void CustomArguments(benchmark::internal::Benchmark* b) {
   for (int j : {kSmallSize, kMediumSize, kLargeSize}) {
-    for (int i : pow2HalfStepThreads()) {
+    for (int i : benchmarkThreads()) {
       b->Args({i, j});
     }
   }
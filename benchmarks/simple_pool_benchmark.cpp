@@ -8,6 +8,7 @@
 #include <chrono>
 #include <cmath>
 
+#include <dispenso/submission_batcher.h>
 #include <dispenso/task_set.h>
 
 #if !defined(BENCHMARK_WITHOUT_TBB)
@@ -76,6 +77,22 @@ void BM_dispenso(benchmark::State& state) {
   }
 }
 
+// As BM_dispenso, but submitting through a SubmissionBatcher, one bulk enqueue and wake per batch.
+void BM_dispenso_batched(benchmark::State& state) {
+  const int num_threads = state.range(0) - 1;
+  const int num_elements = state.range(1);
+  dispenso::ThreadPool pool(num_threads);
+
+  for (auto UNUSED_VAR : state) {
+    dispenso::TaskSet tasks(pool);
+    dispenso::SubmissionBatcher<dispenso::TaskSet> batcher(tasks);
+    for (int i = 0; i < num_elements; ++i) {
+      batcher.schedule([i]() { work() += i; });
+    }
+    batcher.wait();
+  }
+}
+
 #if !defined(BENCHMARK_WITHOUT_FOLLY)
 void BM_folly(benchmark::State& state) {
   const int num_threads = state.range(0);
@@ -275,14 +292,14 @@ void BM_dispenso_very_idle(benchmark::State& state) {
 
 static void CustomArguments(benchmark::internal::Benchmark* b) {
   for (int j : {kSmallSize, kMediumSize, kLargeSize}) {
-    for (int s : pow2HalfStepThreads()) {
+    for (int s : benchmarkThreads()) {
       b->Args({s, j});
     }
   }
 }
 
 static void CustomArgumentsVeryIdle(benchmark::internal::Benchmark* b) {
-  for (int s : pow2HalfStepThreads()) {
+  for (int s : benchmarkThreads()) {
     b->Args({s});
   }
 }
@@ -295,6 +312,10 @@ BENCHMARK(BM_tbb)->Apply(CustomArguments)->Unit(benchmark::kMicrosecond)->UseRea
 BENCHMARK(BM_folly)->Apply(CustomArguments)->Unit(benchmark::kMicrosecond)->UseRealTime();
 #endif // !BENCHMARK_WITHOUT_FOLLY
 BENCHMARK(BM_dispenso)->Apply(CustomArguments)->Unit(benchmark::kMicrosecond)->UseRealTime();
+BENCHMARK(BM_dispenso_batched)
+    ->Apply(CustomArguments)
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
 
 #if !defined(BENCHMARK_WITHOUT_TBB)
 BENCHMARK(BM_tbb2)->Apply(CustomArguments)->Unit(benchmark::kMicrosecond)->UseRealTime();
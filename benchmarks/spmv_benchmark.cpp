@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+// Sparse matrix-vector products over a CSR matrix whose row lengths follow a power law (Pareto),
+// as in web, social, and citation matrices.  Most rows are short, but a few have tens of thousands
+// of nonzeros, so partitioning rows evenly leaves threads with very unequal work.
+
+#include <cmath>
+#include <random>
+#include <unordered_map>
+
+#include <dispenso/parallel_for.h>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#if !defined(BENCHMARK_WITHOUT_TBB)
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
+#include "tbb/task_scheduler_init.h"
+#endif // !BENCHMARK_WITHOUT_TBB
+
+#include "thread_benchmark_common.h"
+
+static constexpr uint32_t kSeed = 8;
+static constexpr int kSmallRows = 1 << 12;
+static constexpr int kLargeRows = 1 << 19;
+
+// Row lengths are Pareto distributed with this minimum and shape, for a mean of about 17.
+static constexpr double kMinRowLength = 4.0;
+static constexpr double kShape = 1.3;
+
+struct CsrMatrix {
+  std::vector<uint32_t> offsets;
+  std::vector<uint32_t> columns;
+  std::vector<float> values;
+  std::vector<float> x;
+
+  size_t numRows() const {
+    return offsets.size() - 1;
+  }
+};
+
+// The raw engine output is used directly, so the matrix is the same on every platform.
+CsrMatrix makeMatrix(int numRows) {
+  std::mt19937 rng(kSeed);
+  auto uniform = [&rng]() { return (rng() + 0.5) / 4294967296.0; };
+  const uint32_t maxRowLength = static_cast<uint32_t>(numRows) / 4;
+
+  CsrMatrix matrix;
+  matrix.offsets.push_back(0);
+  for (int r = 0; r < numRows; ++r) {
+    const double length = kMinRowLength / std::pow(uniform(), 1.0 / kShape);
+    const uint32_t rowLength = static_cast<uint32_t>(std::min<double>(length, maxRowLength));
+    for (uint32_t i = 0; i < rowLength; ++i) {
+      matrix.columns.push_back(rng() % static_cast<uint32_t>(numRows));
+      matrix.values.push_back(static_cast<float>(uniform()) - 0.5f);
+    }
+    matrix.offsets.push_back(static_cast<uint32_t>(matrix.columns.size()));
+  }
+  for (int r = 0; r < numRows; ++r) {
+    matrix.x.push_back(static_cast<float>(uniform()));
+  }
+  return matrix;
+}
+
+const CsrMatrix& getMatrix(int numRows) {
+  static std::unordered_map<int, CsrMatrix> matrices;
+  auto it = matrices.find(numRows);
+  if (it != matrices.end()) {
+    return it->second;
+  }
+  return matrices.emplace(numRows, makeMatrix(numRows)).first->second;
+}
+
+inline void multiplyRows(const CsrMatrix& a, size_t begin, size_t end, float* y) {
+  for (size_t r = begin; r < end; ++r) {
+    float sum = 0.0f;
+    for (uint32_t i = a.offsets[r]; i < a.offsets[r + 1]; ++i) {
+      sum += a.values[i] * a.x[a.columns[i]];
+    }
+    y[r] = sum;
+  }
+}
+
+// Every variant sums each row in the same order, so results match exactly.
+void checkResults(const CsrMatrix& a, const std::vector<float>& y) {
+  std::vector<float> expected(a.numRows());
+  multiplyRows(a, 0, a.numRows(), expected.data());
+  if (y != expected) {
+    std::cerr << "FAIL! results differ from serial" << std::endl;
+    abort();
+  }
+}
+
+template <int num_rows>
+void BM_serial(benchmark::State& state) {
+  const CsrMatrix& a = getMatrix(num_rows);
+  std::vector<float> y(a.numRows());
+  for (auto UNUSED_VAR : state) {
+    multiplyRows(a, 0, a.numRows(), y.data());
+  }
+  checkResults(a, y);
+}
+
+void runDispenso(benchmark::State& state, dispenso::ParForChunking chunking) {
+  const int num_threads = state.range(0) - 1;
+  const CsrMatrix& a = getMatrix(state.range(1));
+  std::vector<float> y(a.numRows());
+  dispenso::ThreadPool pool(num_threads);
+  for (auto UNUSED_VAR : state) {
+    dispenso::TaskSet tasks(pool);
+    dispenso::parallel_for(
+        tasks,
+        dispenso::makeChunkedRange(size_t{0}, a.numRows(), chunking),
+        [&a, &y](size_t begin, size_t end) { multiplyRows(a, begin, end, y.data()); });
+  }
+  checkResults(a, y);
+}
+
+void BM_dispenso(benchmark::State& state) {
+  runDispenso(state, dispenso::ParForChunking::kAuto);
+}
+
+void BM_dispenso_static(benchmark::State& state) {
+  runDispenso(state, dispenso::ParForChunking::kStatic);
+}
+
+#if defined(_OPENMP)
+void BM_omp(benchmark::State& state) {
+  const int num_threads = state.range(0);
+  const CsrMatrix& a = getMatrix(state.range(1));
+  std::vector<float> y(a.numRows());
+  omp_set_num_threads(num_threads);
+  const int64_t numRows = static_cast<int64_t>(a.numRows());
+  for (auto UNUSED_VAR : state) {
+#pragma omp parallel for schedule(dynamic, 64)
+    for (int64_t r = 0; r < numRows; ++r) {
+      multiplyRows(a, r, r + 1, y.data());
+    }
+  }
+  checkResults(a, y);
+}
+#endif /*defined(_OPENMP)*/
+
+#if !defined(BENCHMARK_WITHOUT_TBB)
+void BM_tbb(benchmark::State& state) {
+  const int num_threads = state.range(0);
+  const CsrMatrix& a = getMatrix(state.range(1));
+  std::vector<float> y(a.numRows());
+  for (auto UNUSED_VAR : state) {
+    tbb::task_scheduler_init initsched(num_threads);
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, a.numRows()), [&a, &y](const tbb::blocked_range<size_t>& r) {
+          multiplyRows(a, r.begin(), r.end(), y.data());
+        });
+  }
+  checkResults(a, y);
+}
+#endif // !BENCHMARK_WITHOUT_TBB
+
+static void CustomArguments(benchmark::internal::Benchmark* b) {
+  for (int j : {kSmallRows, kLargeRows}) {
+    for (int i : benchmarkThreads()) {
+      b->Args({i, j});
+    }
+  }
+}
+
+BENCHMARK_TEMPLATE(BM_serial, kSmallRows)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_serial, kLargeRows)->UseRealTime();
+
+#if defined(_OPENMP)
+BENCHMARK(BM_omp)->Apply(CustomArguments)->UseRealTime();
+#endif // OPENMP
+#if !defined(BENCHMARK_WITHOUT_TBB)
+BENCHMARK(BM_tbb)->Apply(CustomArguments)->UseRealTime();
+#endif // !BENCHMARK_WITHOUT_TBB
+
+BENCHMARK(BM_dispenso)->Apply(CustomArguments)->UseRealTime();
+BENCHMARK(BM_dispenso_static)->Apply(CustomArguments)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -9,6 +9,7 @@
 #include <unordered_map>
 
 #include <dispenso/parallel_for.h>
+#include <dispenso/parallel_reduce.h>
 
 #if defined(_OPENMP)
 #include <omp.h>
@@ -76,6 +77,7 @@ void BM_dispenso(benchmark::State& state) {
   const int num_elements = state.range(1);
 
   dispenso::ThreadPool pool(num_threads);
+  configureBenchmarkPool(pool);
 
   int64_t sum = 0;
   int foo = 0;
@@ -108,6 +110,37 @@ void BM_dispenso(benchmark::State& state) {
   checkResults(input, sum, foo);
 }
 
+void BM_dispenso_reduce(benchmark::State& state) {
+  const int num_threads = state.range(0) - 1;
+  const int num_elements = state.range(1);
+
+  dispenso::ThreadPool pool(num_threads);
+  configureBenchmarkPool(pool);
+
+  int64_t sum = 0;
+  int foo = 0;
+
+  auto& input = getInputs(num_elements);
+  for (auto UNUSED_VAR : state) {
+    dispenso::TaskSet tasks(pool);
+    ++foo;
+    sum = dispenso::parallel_reduce(
+        tasks,
+        dispenso::makeChunkedRange(0, num_elements, dispenso::ParForChunking::kAuto),
+        int64_t{0},
+        [&input, foo](int64_t& lsumStore, size_t i, size_t end) {
+          int64_t lsum = 0;
+          for (; i != end; ++i) {
+            lsum += input[i] * input[i] - 3 * foo * input[i];
+          }
+          lsumStore += lsum;
+        },
+        [](int64_t x, int64_t y) { return x + y; });
+  }
+
+  checkResults(input, sum, foo);
+}
+
 #if defined(_OPENMP)
 void BM_omp(benchmark::State& state) {
   const int num_threads = state.range(0);
@@ -195,7 +228,7 @@ void BM_async(benchmark::State& state) {
 
 static void CustomArguments(benchmark::internal::Benchmark* b) {
   for (int j : {kSmallSize, kMediumSize, kLargeSize}) {
-    for (int i : pow2HalfStepThreads()) {
+    for (int i : benchmarkThreads()) {
       b->Args({i, j});
     }
   }
@@ -213,5 +246,6 @@ BENCHMARK(BM_tbb)->Apply(CustomArguments)->UseRealTime();
 #endif // !BENCHMARK_WITHOUT_TBB
 BENCHMARK(BM_async)->Apply(CustomArguments)->UseRealTime();
 BENCHMARK(BM_dispenso)->Apply(CustomArguments)->UseRealTime();
+BENCHMARK(BM_dispenso_reduce)->Apply(CustomArguments)->UseRealTime();
 
 BENCHMARK_MAIN();
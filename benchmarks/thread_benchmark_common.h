@@ -11,8 +11,19 @@
 #include <sys/resource.h>
 #endif // _POSIX_C_SOURCE
 
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
 #include <thread>
+#include <utility>
+#include <vector>
+
+#include <dispenso/thread_pool.h>
 
 #include "benchmark_common.h"
 
@@ -30,6 +41,78 @@ inline std::vector<int> pow2HalfStepThreads() {
   return result;
 }
 
+// Thread counts at the machine's topology boundaries: 1, the physical cores of one socket, that
+// socket's hardware threads (SMT), all physical cores (cross-socket), and all hardware threads.
+// Where the topology cannot be read, this is just 1 and all hardware threads.
+inline std::vector<int> topologyThreads() {
+  const int kRunningThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  std::set<std::pair<int, int>> cores;
+  std::map<int, std::set<int>> socketCores;
+  std::map<int, int> socketThreads;
+#if defined(__linux__)
+  for (int cpu = 0; cpu < kRunningThreads; ++cpu) {
+    const std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+    std::ifstream packageFile(dir + "physical_package_id");
+    std::ifstream coreFile(dir + "core_id");
+    int package;
+    int core;
+    if (!(packageFile >> package) || !(coreFile >> core)) {
+      continue;
+    }
+    cores.emplace(package, core);
+    socketCores[package].insert(core);
+    ++socketThreads[package];
+  }
+#endif // __linux__
+
+  std::set<int> counts = {1, kRunningThreads};
+  if (!socketCores.empty()) {
+    const int firstSocket = socketCores.begin()->first;
+    counts.insert(static_cast<int>(socketCores[firstSocket].size()));
+    counts.insert(socketThreads[firstSocket]);
+    counts.insert(static_cast<int>(cores.size()));
+  }
+  return std::vector<int>(counts.begin(), counts.end());
+}
+
+// The thread counts that threaded benchmarks sweep over.  By default these are pow2HalfStepThreads,
+// but the DISPENSO_BENCH_THREADS environment variable may select "topology" (topologyThreads), or
+// give an explicit comma separated list, e.g. "1,8,64".
+inline std::vector<int> benchmarkThreads() {
+  const char* env = std::getenv("DISPENSO_BENCH_THREADS");
+  if (!env || !*env) {
+    return pow2HalfStepThreads();
+  }
+  const std::string spec(env);
+  if (spec == "topology") {
+    return topologyThreads();
+  }
+  std::vector<int> result;
+  std::istringstream in(spec);
+  std::string token;
+  while (std::getline(in, token, ',')) {
+    const int count = std::atoi(token.c_str());
+    if (count > 0) {
+      result.push_back(count);
+    }
+  }
+  if (result.empty()) {
+    std::cerr << "Ignoring unrecognized DISPENSO_BENCH_THREADS=" << spec << std::endl;
+    return pow2HalfStepThreads();
+  }
+  return result;
+}
+
+// Puts a benchmark's pool in deterministic mode (see ThreadPool::setDeterministic) if the
+// DISPENSO_BENCH_DETERMINISTIC environment variable is set, using its value as the steal seed, so
+// that repeated runs can be compared closely.
+inline void configureBenchmarkPool(dispenso::ThreadPool& pool) {
+  const char* env = std::getenv("DISPENSO_BENCH_DETERMINISTIC");
+  if (env && *env) {
+    pool.setDeterministic(true, std::strtoull(env, nullptr, 10));
+  }
+}
+
 #ifdef _POSIX_C_SOURCE
 struct rusage g_rusage;
 
@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+// Builds a bounding volume hierarchy over clustered points by recursive spatial median splits.  On
+// clustered data, the splits are far from balanced, so the recursion produces subtrees of wildly
+// different sizes, and the build depends on the scheduler to balance nested, uneven fork-join work.
+
+#include <atomic>
+#include <cmath>
+#include <random>
+#include <unordered_map>
+
+#include <dispenso/task_set.h>
+
+#if !defined(BENCHMARK_WITHOUT_TBB)
+#include "tbb/task_group.h"
+#include "tbb/task_scheduler_init.h"
+#endif // !BENCHMARK_WITHOUT_TBB
+
+#include "thread_benchmark_common.h"
+
+static constexpr uint32_t kSeed = 8;
+static constexpr int kSmallSize = 1 << 14;
+static constexpr int kLargeSize = 1 << 20;
+static constexpr int kNumClusters = 64;
+static constexpr uint32_t kLeafSize = 4;
+// Subtrees smaller than this are built serially.
+static constexpr uint32_t kSerialCutoff = 2048;
+
+struct Point {
+  float p[3];
+};
+
+struct Box {
+  float lo[3];
+  float hi[3];
+};
+
+struct Node {
+  Box bounds;
+  uint32_t left;
+  uint32_t right;
+  uint32_t begin;
+  uint32_t end;
+};
+
+// Points in gaussian clusters of varying sizes and spreads.  The raw engine output is used
+// directly, so the points are the same on every platform.
+std::vector<Point> makePoints(int numPoints) {
+  std::mt19937 rng(kSeed);
+  auto uniform = [&rng]() { return static_cast<float>((rng() + 0.5) / 4294967296.0); };
+  auto gaussian = [&uniform]() {
+    return std::sqrt(-2.0f * std::log(uniform())) * std::cos(6.2831853f * uniform());
+  };
+
+  std::vector<Point> centers(kNumClusters);
+  std::vector<float> spreads(kNumClusters);
+  for (int c = 0; c < kNumClusters; ++c) {
+    for (float& x : centers[c].p) {
+      x = uniform();
+    }
+    spreads[c] = 0.1f * uniform() * uniform();
+  }
+  std::vector<Point> points(numPoints);
+  for (Point& point : points) {
+    // Squaring skews cluster populations, so that a few clusters hold most points.
+    const float u = uniform();
+    const int c = static_cast<int>(u * u * kNumClusters);
+    for (int d = 0; d < 3; ++d) {
+      point.p[d] = centers[c].p[d] + spreads[c] * gaussian();
+    }
+  }
+  return points;
+}
+
+const std::vector<Point>& getPoints(int numPoints) {
+  static std::unordered_map<int, std::vector<Point>> points;
+  auto it = points.find(numPoints);
+  if (it != points.end()) {
+    return it->second;
+  }
+  return points.emplace(numPoints, makePoints(numPoints)).first->second;
+}
+
+// The tree over a working copy of the points, which the build reorders.  Nodes are allocated from
+// an atomic counter, so their layout varies between parallel builds, but the tree's shape depends
+// only on the points.
+class Bvh {
+ public:
+  explicit Bvh(const std::vector<Point>& points) : points_(points), nodes_(2 * points.size()) {}
+
+  // Builds the tree, calling spawn(lo, hi) to build two sibling subtrees, possibly in parallel.
+  template <typename Spawn>
+  void build(Spawn&& spawn) {
+    nextNode_.store(1, std::memory_order_relaxed);
+    buildNode(0, 0, static_cast<uint32_t>(points_.size()), spawn);
+  }
+
+  // A checksum of the tree's shape: the node count, and the sum of leaf depths.
+  std::pair<uint32_t, uint64_t> shape() const {
+    uint64_t depthSum = 0;
+    std::vector<std::pair<uint32_t, uint32_t>> stack = {{0, 0}};
+    while (!stack.empty()) {
+      auto top = stack.back();
+      stack.pop_back();
+      const Node& node = nodes_[top.first];
+      if (node.left) {
+        stack.emplace_back(node.left, top.second + 1);
+        stack.emplace_back(node.right, top.second + 1);
+      } else {
+        depthSum += top.second;
+      }
+    }
+    return {nextNode_.load(std::memory_order_relaxed), depthSum};
+  }
+
+ private:
+  template <typename Spawn>
+  void buildNode(uint32_t index, uint32_t begin, uint32_t end, Spawn& spawn) {
+    Node& node = nodes_[index];
+    node.begin = begin;
+    node.end = end;
+    node.left = node.right = 0;
+    Box& box = node.bounds;
+    for (int d = 0; d < 3; ++d) {
+      box.lo[d] = box.hi[d] = points_[begin].p[d];
+    }
+    for (uint32_t i = begin + 1; i < end; ++i) {
+      for (int d = 0; d < 3; ++d) {
+        box.lo[d] = std::min(box.lo[d], points_[i].p[d]);
+        box.hi[d] = std::max(box.hi[d], points_[i].p[d]);
+      }
+    }
+    if (end - begin <= kLeafSize) {
+      return;
+    }
+
+    int axis = 0;
+    for (int d = 1; d < 3; ++d) {
+      if (box.hi[d] - box.lo[d] > box.hi[axis] - box.lo[axis]) {
+        axis = d;
+      }
+    }
+    const float mid = 0.5f * (box.lo[axis] + box.hi[axis]);
+    auto first = points_.begin() + begin;
+    auto last = points_.begin() + end;
+    uint32_t split = static_cast<uint32_t>(
+        std::partition(first, last, [axis, mid](const Point& pt) { return pt.p[axis] < mid; }) -
+        points_.begin());
+    if (split == begin || split == end) {
+      // Coincident points; split them evenly.
+      split = begin + (end - begin) / 2;
+    }
+
+    const uint32_t left = nextNode_.fetch_add(2, std::memory_order_relaxed);
+    node.left = left;
+    node.right = left + 1;
+    auto buildLeft = [this, left, begin, split, &spawn]() {
+      buildNode(left, begin, split, spawn);
+    };
+    auto buildRight = [this, left, split, end, &spawn]() {
+      buildNode(left + 1, split, end, spawn);
+    };
+    if (end - begin < kSerialCutoff) {
+      buildLeft();
+      buildRight();
+    } else {
+      spawn(buildLeft, buildRight);
+    }
+  }
+
+  std::vector<Point> points_;
+  std::vector<Node> nodes_;
+  std::atomic<uint32_t> nextNode_{0};
+};
+
+struct SerialSpawn {
+  template <typename F, typename G>
+  void operator()(F& f, G& g) const {
+    f();
+    g();
+  }
+};
+
+void checkShape(const std::vector<Point>& points, const Bvh& bvh) {
+  Bvh expected(points);
+  expected.build(SerialSpawn());
+  if (bvh.shape() != expected.shape()) {
+    std::cerr << "FAIL! tree shape differs from serial" << std::endl;
+    abort();
+  }
+}
+
+template <int num_points>
+void BM_serial(benchmark::State& state) {
+  const std::vector<Point>& points = getPoints(num_points);
+  Bvh bvh(points);
+  for (auto UNUSED_VAR : state) {
+    bvh.build(SerialSpawn());
+  }
+  checkShape(points, bvh);
+}
+
+// Fork-join with a TaskSet per split, the same shape as recursive parallel tree builds in
+// rendering and physics code.
+struct DispensoSpawn {
+  template <typename F, typename G>
+  void operator()(F& f, G& g) const {
+    dispenso::TaskSet tasks(pool);
+    tasks.schedule(f);
+    g();
+    tasks.wait();
+  }
+  dispenso::ThreadPool& pool;
+};
+
+void BM_dispenso(benchmark::State& state) {
+  const int num_threads = state.range(0) - 1;
+  const std::vector<Point>& points = getPoints(state.range(1));
+  dispenso::ThreadPool pool(num_threads);
+  Bvh bvh(points);
+  for (auto UNUSED_VAR : state) {
+    bvh.build(DispensoSpawn{pool});
+  }
+  checkShape(points, bvh);
+}
+
+#if !defined(BENCHMARK_WITHOUT_TBB)
+struct TbbSpawn {
+  template <typename F, typename G>
+  void operator()(F& f, G& g) const {
+    tbb::task_group group;
+    group.run(f);
+    g();
+    group.wait();
+  }
+};
+
+void BM_tbb(benchmark::State& state) {
+  const int num_threads = state.range(0);
+  const std::vector<Point>& points = getPoints(state.range(1));
+  Bvh bvh(points);
+  for (auto UNUSED_VAR : state) {
+    tbb::task_scheduler_init initsched(num_threads);
+    bvh.build(TbbSpawn());
+  }
+  checkShape(points, bvh);
+}
+#endif // !BENCHMARK_WITHOUT_TBB
+
+static void CustomArguments(benchmark::internal::Benchmark* b) {
+  for (int j : {kSmallSize, kLargeSize}) {
+    for (int i : benchmarkThreads()) {
+      b->Args({i, j});
+    }
+  }
+}
+
+BENCHMARK_TEMPLATE(BM_serial, kSmallSize)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_serial, kLargeSize)->UseRealTime();
+
+#if !defined(BENCHMARK_WITHOUT_TBB)
+BENCHMARK(BM_tbb)->Apply(CustomArguments)->UseRealTime();
+#endif // !BENCHMARK_WITHOUT_TBB
+
+BENCHMARK(BM_dispenso)->Apply(CustomArguments)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -73,6 +73,7 @@ void BM_dispenso(benchmark::State& state) {
   const int num_elements = state.range(1);
 
   dispenso::ThreadPool pool(num_threads);
+  configureBenchmarkPool(pool);
 
   uint64_t sum = 0;
   int foo = 0;
@@ -192,7 +193,7 @@ void BM_async(benchmark::State& state) {
 
 static void CustomArguments(benchmark::internal::Benchmark* b) {
   for (int j : {kSmallSize, kMediumSize, kLargeSize}) {
-    for (int i : pow2HalfStepThreads()) {
+    for (int i : benchmarkThreads()) {
       b->Args({i, j});
     }
   }
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/arena.h>
+
+#include <algorithm>
+#include <thread>
+
+#include <dispenso/detail/math.h>
+#include <dispenso/thread_id.h>
+
+namespace dispenso {
+
+constexpr size_t Arena::kDefaultSlabSize;
+
+Arena::Arena(
+    size_t slabSize,
+    std::function<void*(size_t)> allocFunc,
+    std::function<void(void*)> deallocFunc)
+    : slabSize_(slabSize),
+      allocFunc_(std::move(allocFunc)),
+      deallocFunc_(std::move(deallocFunc)) {}
+
+void* Arena::allocateSlow(size_t bytes, size_t alignment) {
+  // Worst case padding to reach the alignment.
+  size_t needed = bytes + alignment - 1;
+  if (needed > slabSize_) {
+    char* buffer = reinterpret_cast<char*>(allocFunc_(needed));
+    large_.push_back(buffer);
+    largeBytes_ += needed;
+    uintptr_t p = (reinterpret_cast<uintptr_t>(buffer) + alignment - 1) & ~(alignment - 1);
+    return reinterpret_cast<void*>(p);
+  }
+
+  // Move on to the next slab.  The remainder of the current one is abandoned until reset().
+  if (nextSlab_ == slabs_.size()) {
+    slabs_.push_back(reinterpret_cast<char*>(allocFunc_(slabSize_)));
+  }
+  char* slab = slabs_[nextSlab_++];
+  uintptr_t p = (reinterpret_cast<uintptr_t>(slab) + alignment - 1) & ~(alignment - 1);
+  cur_ = p + bytes;
+  end_ = reinterpret_cast<uintptr_t>(slab) + slabSize_;
+  return reinterpret_cast<void*>(p);
+}
+
+void Arena::reset() {
+  for (char* buffer : large_) {
+    deallocFunc_(buffer);
+  }
+  large_.clear();
+  largeBytes_ = 0;
+  nextSlab_ = 0;
+  cur_ = 1;
+  end_ = 0;
+}
+
+Arena::~Arena() {
+  reset();
+  for (char* slab : slabs_) {
+    deallocFunc_(slab);
+  }
+}
+
+ConcurrentArena::ConcurrentArena(
+    size_t slabSize,
+    std::function<void*(size_t)> allocFunc,
+    std::function<void(void*)> deallocFunc)
+    : mask_(detail::nextPow2(2 * std::max<size_t>(1, std::thread::hardware_concurrency())) - 1),
+      subArenas_(reinterpret_cast<SubArena*>(
+          detail::alignedMalloc((mask_ + 1) * sizeof(SubArena), alignof(SubArena)))) {
+  for (size_t i = 0; i <= mask_; ++i) {
+    new (&subArenas_[i]) SubArena(slabSize, allocFunc, deallocFunc);
+  }
+}
+
+void* ConcurrentArena::allocate(size_t bytes, size_t alignment) {
+  SubArena& sub = subArenas_[threadId() & mask_];
+  while (sub.locked.exchange(true, std::memory_order_acquire)) {
+    std::this_thread::yield();
+  }
+  void* p = sub.arena.allocate(bytes, alignment);
+  sub.locked.store(false, std::memory_order_release);
+  return p;
+}
+
+void ConcurrentArena::reset() {
+  for (size_t i = 0; i <= mask_; ++i) {
+    subArenas_[i].arena.reset();
+  }
+}
+
+size_t ConcurrentArena::bytesReserved() const {
+  size_t total = 0;
+  for (size_t i = 0; i <= mask_; ++i) {
+    total += subArenas_[i].arena.bytesReserved();
+  }
+  return total;
+}
+
+ConcurrentArena::~ConcurrentArena() {
+  for (size_t i = 0; i <= mask_; ++i) {
+    subArenas_[i].~SubArena();
+  }
+  detail::alignedFree(subArenas_);
+}
+
+} // namespace dispenso
@@ -0,0 +1,235 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file arena.h
+ * A file providing monotonic bump allocators for scratch memory that is released all at once.
+ * <code>Arena</code> carves allocations out of a chain of slabs obtained from a pluggable upstream
+ * allocation function, and <code>reset()</code> rewinds it, keeping the slabs for reuse.
+ * <code>ConcurrentArena</code> is a thread-safe variant built from per-thread sub-arenas, and with
+ * C++17, <code>ArenaResource</code> adapts either to <code>std::pmr::memory_resource</code> for use
+ * with standard containers.
+ **/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <utility>
+#include <vector>
+
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define DISPENSO_HAS_MEMORY_RESOURCE 1
+#endif // has <memory_resource>
+#endif // C++17
+
+#include <dispenso/platform.h>
+
+namespace dispenso {
+
+/**
+ * A monotonic bump allocator.  Allocation is a pointer bump in the common case, individual
+ * allocations are never freed, and <code>reset()</code> releases everything at once.  Not
+ * concurrency safe; see <code>ConcurrentArena</code>.
+ **/
+class Arena {
+ public:
+  static constexpr size_t kDefaultSlabSize = 64 * 1024;
+
+  /**
+   * Construct an Arena.
+   *
+   * @param slabSize The size of the slabs to request from allocFunc.  Allocations too large to fit
+   * in a slab are served by a dedicated call to allocFunc.
+   * @param allocFunc The underlying allocation function for allocating slabs
+   * @param deallocFunc The underlying deallocation function.
+   **/
+  DISPENSO_DLL_ACCESS explicit Arena(
+      size_t slabSize = kDefaultSlabSize,
+      std::function<void*(size_t)> allocFunc = ::malloc,
+      std::function<void(void*)> deallocFunc = ::free);
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  /**
+   * Allocate memory from the arena.
+   *
+   * @param bytes The number of bytes to allocate
+   * @param alignment The required alignment, which must be a power of two
+   * @return A pointer to the allocated memory, valid until reset() or destruction
+   **/
+  void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t)) {
+    uintptr_t p = (cur_ + alignment - 1) & ~(alignment - 1);
+    if (p <= end_ && bytes <= end_ - p) {
+      cur_ = p + bytes;
+      return reinterpret_cast<void*>(p);
+    }
+    return allocateSlow(bytes, alignment);
+  }
+
+  /**
+   * Construct an object in arena memory.  The object's destructor is never run by the arena, so
+   * this is best suited to trivially destructible types, or to objects that are destroyed
+   * explicitly.
+   *
+   * @param args The arguments to construct the object with
+   * @return A pointer to the new object
+   **/
+  template <typename T, typename... Args>
+  T* create(Args&&... args) {
+    return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+  }
+
+  /**
+   * Release all allocations at once.  Slabs are kept and reused by subsequent allocations, while
+   * dedicated allocations for oversized requests are returned to deallocFunc.
+   **/
+  DISPENSO_DLL_ACCESS void reset();
+
+  /**
+   * Get the number of bytes currently obtained from allocFunc.
+   *
+   * @return The total size of slabs and dedicated allocations held by the arena.
+   **/
+  size_t bytesReserved() const {
+    return slabs_.size() * slabSize_ + largeBytes_;
+  }
+
+  /**
+   * Destruct an Arena, returning all memory to deallocFunc.
+   **/
+  DISPENSO_DLL_ACCESS ~Arena();
+
+ private:
+  DISPENSO_DLL_ACCESS void* allocateSlow(size_t bytes, size_t alignment);
+
+  // With no slab to bump from, cur_ is past end_, so allocation takes the slow path.
+  uintptr_t cur_ = 1;
+  uintptr_t end_ = 0;
+  const size_t slabSize_;
+  std::function<void*(size_t)> allocFunc_;
+  std::function<void(void*)> deallocFunc_;
+  std::vector<char*> slabs_;
+  // Index of the next slab in slabs_ to bump from.
+  size_t nextSlab_ = 0;
+  std::vector<char*> large_;
+  size_t largeBytes_ = 0;
+};
+
+/**
+ * A thread-safe monotonic bump allocator.  Allocations are served by a fixed set of sub-arenas
+ * picked by thread ID, so each is normally used by only one thread and its lock is uncontended.
+ **/
+class ConcurrentArena {
+ public:
+  /**
+   * Construct a ConcurrentArena.
+   *
+   * @param slabSize The size of the slabs each sub-arena requests from allocFunc.
+   * @param allocFunc The underlying allocation function for allocating slabs.  This may be called
+   * concurrently.
+   * @param deallocFunc The underlying deallocation function.
+   **/
+  DISPENSO_DLL_ACCESS explicit ConcurrentArena(
+      size_t slabSize = Arena::kDefaultSlabSize,
+      std::function<void*(size_t)> allocFunc = ::malloc,
+      std::function<void(void*)> deallocFunc = ::free);
+
+  ConcurrentArena(const ConcurrentArena&) = delete;
+  ConcurrentArena& operator=(const ConcurrentArena&) = delete;
+
+  /**
+   * Allocate memory from the arena.  Concurrency safe.
+   *
+   * @param bytes The number of bytes to allocate
+   * @param alignment The required alignment, which must be a power of two
+   * @return A pointer to the allocated memory, valid until reset() or destruction
+   **/
+  DISPENSO_DLL_ACCESS void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+  /**
+   * Construct an object in arena memory.  Concurrency safe.  As with Arena::create, the object's
+   * destructor is never run by the arena.
+   *
+   * @param args The arguments to construct the object with
+   * @return A pointer to the new object
+   **/
+  template <typename T, typename... Args>
+  T* create(Args&&... args) {
+    return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+  }
+
+  /**
+   * Release all allocations at once, as Arena::reset.  Not concurrency safe.
+   **/
+  DISPENSO_DLL_ACCESS void reset();
+
+  /**
+   * Get the number of bytes currently obtained from allocFunc.  Not concurrency safe.
+   *
+   * @return The total size of slabs and dedicated allocations held by all sub-arenas.
+   **/
+  DISPENSO_DLL_ACCESS size_t bytesReserved() const;
+
+  DISPENSO_DLL_ACCESS ~ConcurrentArena();
+
+ private:
+  struct alignas(kCacheLineSize) SubArena {
+    SubArena(
+        size_t slabSize,
+        const std::function<void*(size_t)>& allocFunc,
+        const std::function<void(void*)>& deallocFunc)
+        : arena(slabSize, allocFunc, deallocFunc) {}
+
+    std::atomic<bool> locked{false};
+    Arena arena;
+  };
+
+  size_t mask_;
+  SubArena* subArenas_;
+};
+
+#if defined(DISPENSO_HAS_MEMORY_RESOURCE)
+/**
+ * A <code>std::pmr::memory_resource</code> that allocates from an Arena or ConcurrentArena.
+ * Deallocation is a no-op; memory is reclaimed when the arena is reset.
+ *
+ * @tparam ArenaT Either Arena or ConcurrentArena.
+ **/
+template <typename ArenaT>
+class ArenaResource : public std::pmr::memory_resource {
+ public:
+  /**
+   * Construct an ArenaResource.
+   *
+   * @param arena The arena to allocate from.  It must outlive the resource.
+   **/
+  explicit ArenaResource(ArenaT& arena) : arena_(arena) {}
+
+ private:
+  void* do_allocate(size_t bytes, size_t alignment) override {
+    return arena_.allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void* /*p*/, size_t /*bytes*/, size_t /*alignment*/) override {}
+
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+  ArenaT& arena_;
+};
+#endif // DISPENSO_HAS_MEMORY_RESOURCE
+
+} // namespace dispenso
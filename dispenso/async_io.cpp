@@ -0,0 +1,396 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/async_io.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+#include <dispenso/blocking_region.h>
+#include <dispenso/completion_event.h>
+#include <dispenso/tsan_annotations.h>
+
+#if defined(_WIN32)
+#include <io.h>
+#include <Windows.h>
+#else
+#include <unistd.h>
+#endif // _WIN32
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define DISPENSO_HAS_IO_URING 1
+#endif // has io_uring.h
+#endif // __linux__
+
+namespace dispenso {
+
+namespace {
+
+constexpr int kOpRead = 0;
+constexpr int kOpWrite = 1;
+
+// A blocking read or write at an offset, returning bytes transferred or the negated errno.
+ssize_t syncIo(int op, int fd, uint64_t offset, void* addr, size_t size) {
+#if defined(_WIN32)
+  HANDLE h = reinterpret_cast<HANDLE>(_get_osfhandle(fd));
+  if (h == INVALID_HANDLE_VALUE) {
+    return -EBADF;
+  }
+  OVERLAPPED overlapped = {};
+  overlapped.Offset = static_cast<DWORD>(offset);
+  overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+  DWORD len = static_cast<DWORD>(size);
+  DWORD done = 0;
+  BOOL ok = op == kOpRead ? ReadFile(h, addr, len, &done, &overlapped)
+                          : WriteFile(h, addr, len, &done, &overlapped);
+  if (!ok && GetLastError() != ERROR_HANDLE_EOF) {
+    return -EIO;
+  }
+  return static_cast<ssize_t>(done);
+#else
+  ssize_t result;
+  do {
+    result = op == kOpRead ? ::pread(fd, addr, size, static_cast<off_t>(offset))
+                           : ::pwrite(fd, addr, size, static_cast<off_t>(offset));
+  } while (result < 0 && errno == EINTR);
+  return result < 0 ? -errno : result;
+#endif // _WIN32
+}
+
+// A Schedulable that captures the Future's task instead of running it, so that the completion
+// thread can run it once the kernel reports the result.
+struct CaptureInvoker {
+  void schedule(OnceFunction f) {
+    *slot = std::move(f);
+  }
+  void schedule(OnceFunction f, ForceQueuingTag) {
+    *slot = std::move(f);
+  }
+  OnceFunction* slot;
+};
+
+} // namespace
+
+// Shared by the Future's task and the completion thread; whichever finishes last frees it.
+struct AsyncIo::Op {
+  OnceFunction complete;
+  CompletionEvent done;
+  IoBuffer buffer;
+  ssize_t result = 0;
+  std::atomic<int> refs{2};
+
+  void release() {
+    if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+};
+
+#if defined(DISPENSO_HAS_IO_URING)
+
+struct AsyncIo::Ring {
+  int fd = -1;
+  void* sq = MAP_FAILED;
+  size_t sqSize = 0;
+  void* cq = MAP_FAILED;
+  size_t cqSize = 0;
+  io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+  size_t sqesSize = 0;
+
+  unsigned* sqTail = nullptr;
+  unsigned* sqMask = nullptr;
+  unsigned* sqArray = nullptr;
+  unsigned* cqHead = nullptr;
+  unsigned* cqTail = nullptr;
+  unsigned* cqMask = nullptr;
+  io_uring_cqe* cqes = nullptr;
+
+  bool init(uint32_t entries) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (fd < 0) {
+      return false;
+    }
+    sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMap) {
+      sqSize = cqSize = std::max(sqSize, cqSize);
+    }
+    sq = mmap(
+        nullptr, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED) {
+      return false;
+    }
+    if (!singleMap) {
+      cq = mmap(
+          nullptr,
+          cqSize,
+          PROT_READ | PROT_WRITE,
+          MAP_SHARED | MAP_POPULATE,
+          fd,
+          IORING_OFF_CQ_RING);
+      if (cq == MAP_FAILED) {
+        return false;
+      }
+    }
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = static_cast<io_uring_sqe*>(mmap(
+        nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+    if (sqes == MAP_FAILED) {
+      return false;
+    }
+
+    char* sqBase = static_cast<char*>(sq);
+    char* cqBase = static_cast<char*>(singleMap ? sq : cq);
+    sqTail = reinterpret_cast<unsigned*>(sqBase + params.sq_off.tail);
+    sqMask = reinterpret_cast<unsigned*>(sqBase + params.sq_off.ring_mask);
+    sqArray = reinterpret_cast<unsigned*>(sqBase + params.sq_off.array);
+    cqHead = reinterpret_cast<unsigned*>(cqBase + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned*>(cqBase + params.cq_off.tail);
+    cqMask = reinterpret_cast<unsigned*>(cqBase + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cqBase + params.cq_off.cqes);
+    return true;
+  }
+
+  // The caller must serialize calls, since the submission queue has a single producer.
+  void push(uint8_t opcode, int file, uint64_t offset, const void* addr, size_t size, void* data) {
+    unsigned tail = *sqTail;
+    unsigned index = tail & *sqMask;
+    io_uring_sqe& sqe = sqes[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = opcode;
+    sqe.fd = file;
+    sqe.off = offset;
+    sqe.addr = reinterpret_cast<uint64_t>(addr);
+    sqe.len = static_cast<uint32_t>(size);
+    sqe.user_data = reinterpret_cast<uint64_t>(data);
+    sqArray[index] = index;
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    while (syscall(__NR_io_uring_enter, fd, 1, 0, 0, nullptr, 0) < 0) {
+      assert((errno == EINTR || errno == EAGAIN || errno == EBUSY) && "io_uring_enter failed");
+      std::this_thread::yield();
+    }
+  }
+
+  // Blocks until a completion is available, then consumes it.
+  void pop(void*& data, int& result) {
+    unsigned head = *cqHead;
+    while (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+      syscall(__NR_io_uring_enter, fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+    }
+    const io_uring_cqe& cqe = cqes[head & *cqMask];
+    data = reinterpret_cast<void*>(cqe.user_data);
+    result = cqe.res;
+    __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+  }
+
+  ~Ring() {
+    if (sqes != MAP_FAILED) {
+      munmap(sqes, sqesSize);
+    }
+    if (cq != MAP_FAILED) {
+      munmap(cq, cqSize);
+    }
+    if (sq != MAP_FAILED) {
+      munmap(sq, sqSize);
+    }
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+};
+
+#else
+
+struct AsyncIo::Ring {};
+
+#endif // DISPENSO_HAS_IO_URING
+
+AsyncIo::AsyncIo(ThreadPool& pool, size_t bufferSize, uint32_t queueDepth)
+    : pool_(pool),
+      buffers_(std::make_shared<PoolAllocator>(bufferSize, bufferSize * 16, ::malloc, ::free)),
+      slots_(static_cast<int>(queueDepth)),
+      queueDepth_(queueDepth) {
+  assert(queueDepth > 0);
+#if defined(DISPENSO_HAS_IO_URING)
+  auto ring = std::make_unique<Ring>();
+  if (ring->init(queueDepth)) {
+    ring_ = std::move(ring);
+    completer_ = std::thread([this]() { completionLoop(); });
+  }
+#endif // DISPENSO_HAS_IO_URING
+}
+
+void AsyncIo::setResult(IoBuffer& buffer, ssize_t result) {
+  if (result < 0) {
+    buffer.error_ = static_cast<int>(-result);
+    buffer.size_ = 0;
+  } else {
+    buffer.error_ = 0;
+    buffer.size_ = static_cast<size_t>(result);
+  }
+}
+
+IoBuffer AsyncIo::allocate(size_t size) {
+  IoBuffer buffer;
+  if (size <= buffers_->chunkSize()) {
+    buffer.data_ = buffers_->alloc();
+    buffer.capacity_ = buffers_->chunkSize();
+    buffer.pool_ = buffers_;
+  } else {
+    buffer.data_ = static_cast<char*>(std::malloc(size));
+    buffer.capacity_ = size;
+  }
+  return buffer;
+}
+
+Future<IoBuffer> AsyncIo::read(int fd, uint64_t offset, size_t size) {
+  if (!ring_) {
+    fallbackOutstanding_.fetch_add(1, std::memory_order_relaxed);
+    return Future<IoBuffer>(
+        [this, buffer = allocate(size), fd, offset, size]() mutable {
+          ssize_t result;
+          {
+            BlockingRegion blocking(pool_);
+            result = syncIo(kOpRead, fd, offset, buffer.data_, size);
+          }
+          IoBuffer out(std::move(buffer));
+          setResult(out, result);
+          fallbackOutstanding_.fetch_sub(1, std::memory_order_release);
+          return out;
+        },
+        pool_,
+        std::launch::async);
+  }
+
+  Op* op = new Op();
+  op->buffer = allocate(size);
+  CaptureInvoker capture{&op->complete};
+  Future<IoBuffer> future(
+      [op]() {
+        op->done.wait();
+        IoBuffer out(std::move(op->buffer));
+        setResult(out, op->result);
+        op->release();
+        return out;
+      },
+      capture,
+      kNotAsync,
+      kNotDeferred);
+  submit(op, kOpRead, fd, offset, op->buffer.data_, size);
+  return future;
+}
+
+Future<ssize_t> AsyncIo::write(int fd, uint64_t offset, const void* data, size_t size) {
+  if (!ring_) {
+    fallbackOutstanding_.fetch_add(1, std::memory_order_relaxed);
+    return Future<ssize_t>(
+        [this, data, fd, offset, size]() {
+          ssize_t result;
+          {
+            BlockingRegion blocking(pool_);
+            result = syncIo(kOpWrite, fd, offset, const_cast<void*>(data), size);
+          }
+          fallbackOutstanding_.fetch_sub(1, std::memory_order_release);
+          return result;
+        },
+        pool_,
+        std::launch::async);
+  }
+
+  Op* op = new Op();
+  CaptureInvoker capture{&op->complete};
+  Future<ssize_t> future(
+      [op]() {
+        op->done.wait();
+        ssize_t result = op->result;
+        op->release();
+        return result;
+      },
+      capture,
+      kNotAsync,
+      kNotDeferred);
+  submit(op, kOpWrite, fd, offset, data, size);
+  return future;
+}
+
+void AsyncIo::submit(Op* op, int opcode, int fd, uint64_t offset, const void* addr, size_t size) {
+#if defined(DISPENSO_HAS_IO_URING)
+  assert(size <= UINT32_MAX && "io_uring transfers are limited to 4GB");
+  slots_.acquire();
+  std::lock_guard<std::mutex> lk(submitMutex_);
+  // The kernel hands the op to the completion thread, which TSAN cannot see.
+  DISPENSO_TSAN_ANNOTATE_HAPPENS_BEFORE(op);
+  ring_->push(
+      static_cast<uint8_t>(opcode == kOpRead ? IORING_OP_READ : IORING_OP_WRITE),
+      fd,
+      offset,
+      addr,
+      size,
+      op);
+#else
+  (void)op;
+  (void)opcode;
+  (void)fd;
+  (void)offset;
+  (void)addr;
+  (void)size;
+  assert(false && "io_uring is unavailable on this platform");
+#endif // DISPENSO_HAS_IO_URING
+}
+
+void AsyncIo::completionLoop() {
+#if defined(DISPENSO_HAS_IO_URING)
+  while (true) {
+    void* data;
+    int result;
+    ring_->pop(data, result);
+    if (!data) {
+      // The shutdown marker.
+      return;
+    }
+    Op* op = static_cast<Op*>(data);
+    DISPENSO_TSAN_ANNOTATE_HAPPENS_AFTER(op);
+    OnceFunction complete = std::move(op->complete);
+    op->result = result;
+    op->done.notify();
+    // Runs the Future's task unless a waiter already ran it inline, then schedules continuations.
+    complete();
+    op->release();
+    slots_.release();
+  }
+#endif // DISPENSO_HAS_IO_URING
+}
+
+AsyncIo::~AsyncIo() {
+#if defined(DISPENSO_HAS_IO_URING)
+  if (ring_) {
+    // Once every slot is held, nothing remains in flight.
+    for (uint32_t i = 0; i < queueDepth_; ++i) {
+      slots_.acquire();
+    }
+    {
+      std::lock_guard<std::mutex> lk(submitMutex_);
+      ring_->push(IORING_OP_NOP, -1, 0, nullptr, 0, nullptr);
+    }
+    completer_.join();
+  }
+#endif // DISPENSO_HAS_IO_URING
+  while (fallbackOutstanding_.load(std::memory_order_acquire)) {
+    std::this_thread::yield();
+  }
+}
+
+} // namespace dispenso
@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file async_io.h
+ * A file providing AsyncIo, which performs file reads and writes asynchronously and delivers the
+ * results as Futures, so that I/O overlaps with computation on a ThreadPool.
+ **/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include <dispenso/future.h>
+#include <dispenso/platform.h>
+#include <dispenso/pool_allocator.h>
+#include <dispenso/semaphore.h>
+#include <dispenso/thread_pool.h>
+
+namespace dispenso {
+
+/**
+ * A move-only byte buffer holding the result of an AsyncIo read.  Buffers up to the AsyncIo's
+ * buffer size come from a PoolAllocator, so steady-state reads do not touch the heap.  The pool is
+ * shared by its buffers, so an IoBuffer may outlive the AsyncIo that produced it.
+ **/
+class IoBuffer {
+ public:
+  IoBuffer() = default;
+
+  IoBuffer(IoBuffer&& other) noexcept
+      : data_(other.data_),
+        size_(other.size_),
+        capacity_(other.capacity_),
+        error_(other.error_),
+        pool_(std::move(other.pool_)) {
+    other.data_ = nullptr;
+    other.size_ = 0;
+    other.capacity_ = 0;
+  }
+
+  IoBuffer& operator=(IoBuffer&& other) noexcept {
+    if (this != &other) {
+      reset();
+      std::swap(data_, other.data_);
+      std::swap(size_, other.size_);
+      std::swap(capacity_, other.capacity_);
+      std::swap(error_, other.error_);
+      std::swap(pool_, other.pool_);
+    }
+    return *this;
+  }
+
+  IoBuffer(const IoBuffer&) = delete;
+  IoBuffer& operator=(const IoBuffer&) = delete;
+
+  /**
+   * Get the bytes read.
+   *
+   * @return A pointer to the first of <code>size()</code> bytes.
+   **/
+  char* data() {
+    return data_;
+  }
+  const char* data() const {
+    return data_;
+  }
+
+  /**
+   * Get the number of bytes read.  This may be fewer than requested, e.g. at end of file.
+   *
+   * @return The number of valid bytes.
+   **/
+  size_t size() const {
+    return size_;
+  }
+
+  /**
+   * Get the number of bytes allocated.
+   *
+   * @return The buffer capacity.
+   **/
+  size_t capacity() const {
+    return capacity_;
+  }
+
+  /**
+   * Get the error code of the read.
+   *
+   * @return 0 on success, otherwise an errno value, in which case <code>size()</code> is 0.
+   **/
+  int error() const {
+    return error_;
+  }
+
+  ~IoBuffer() {
+    reset();
+  }
+
+ private:
+  void reset() {
+    if (data_) {
+      if (pool_) {
+        pool_->dealloc(data_);
+      } else {
+        std::free(data_);
+      }
+      data_ = nullptr;
+      pool_.reset();
+    }
+  }
+
+  char* data_ = nullptr;
+  size_t size_ = 0;
+  size_t capacity_ = 0;
+  int error_ = 0;
+  std::shared_ptr<PoolAllocator> pool_;
+
+  friend class AsyncIo;
+};
+
+/**
+ * An asynchronous file I/O engine.  On Linux, reads and writes are submitted through io_uring and
+ * completed by a dedicated completion thread, so no pool thread blocks on I/O.  Elsewhere, or when
+ * the kernel does not permit io_uring, each operation runs as a pool task inside a BlockingRegion.
+ *
+ * Results are delivered as Futures; use <code>then</code> to schedule processing onto a pool:
+ *
+ * @code
+ * dispenso::AsyncIo io(pool);
+ * auto processed = io.read(fd, 0, size).then(
+ *     [](dispenso::Future<dispenso::IoBuffer>&& f) { return process(f.get()); }, pool);
+ * @endcode
+ *
+ * Each operation is a single read or write system call, so it may complete partially.  Files are
+ * identified by POSIX file descriptors, which remain owned by the caller and must stay open until
+ * the operations on them complete.
+ **/
+class AsyncIo {
+ public:
+  /**
+   * Construct an AsyncIo.
+   *
+   * @param pool The pool that runs fallback operations.  Continuations are scheduled wherever
+   * <code>then</code> is told to schedule them.
+   * @param bufferSize The size of pooled read buffers.  Larger reads allocate from the heap.
+   * @param queueDepth The maximum number of operations in flight in the kernel at once.  Submitting
+   * beyond this blocks until an operation completes.
+   **/
+  DISPENSO_DLL_ACCESS AsyncIo(
+      ThreadPool& pool = globalThreadPool(),
+      size_t bufferSize = 1 << 20,
+      uint32_t queueDepth = 256);
+
+  AsyncIo(const AsyncIo&) = delete;
+  AsyncIo& operator=(const AsyncIo&) = delete;
+
+  /**
+   * Read from a file.
+   *
+   * @param fd The file descriptor to read from.
+   * @param offset The byte offset in the file at which to start reading.
+   * @param size The maximum number of bytes to read.
+   * @return A Future holding the bytes read, or the error.
+   **/
+  DISPENSO_DLL_ACCESS Future<IoBuffer> read(int fd, uint64_t offset, size_t size);
+
+  /**
+   * Write to a file.
+   *
+   * @param fd The file descriptor to write to.
+   * @param offset The byte offset in the file at which to start writing.
+   * @param data The bytes to write, which must stay valid until the returned Future is ready.
+   * @param size The number of bytes to write.
+   * @return A Future holding the number of bytes written, or the negated errno value on failure.
+   **/
+  DISPENSO_DLL_ACCESS Future<ssize_t>
+  write(int fd, uint64_t offset, const void* data, size_t size);
+
+  /**
+   * Check whether operations go through io_uring.
+   *
+   * @return true if io_uring is in use, false if operations run on the pool instead.
+   **/
+  bool usingIoUring() const {
+    return ring_ != nullptr;
+  }
+
+  /**
+   * Destruct the AsyncIo, blocking until all outstanding operations complete.
+   **/
+  DISPENSO_DLL_ACCESS ~AsyncIo();
+
+ private:
+  struct Ring;
+  struct Op;
+
+  static void setResult(IoBuffer& buffer, ssize_t result);
+  IoBuffer allocate(size_t size);
+  void submit(Op* op, int opcode, int fd, uint64_t offset, const void* addr, size_t size);
+  void completionLoop();
+
+  ThreadPool& pool_;
+  std::shared_ptr<PoolAllocator> buffers_;
+  Semaphore slots_;
+  uint32_t queueDepth_;
+  std::unique_ptr<Ring> ring_;
+  std::mutex submitMutex_;
+  std::thread completer_;
+  std::atomic<ssize_t> fallbackOutstanding_{0};
+};
+
+} // namespace dispenso
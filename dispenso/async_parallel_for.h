@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file async_parallel_for.h
+ * A file providing async_parallel_for, a parallel for loop that returns a Future instead of
+ * waiting, so that further work can be chained onto loops without blocking any thread.
+ **/
+
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <utility>
+
+#include <dispenso/completion_event.h>
+#include <dispenso/future.h>
+#include <dispenso/parallel_for.h>
+
+namespace dispenso {
+namespace detail {
+
+// The state shared by the chunk workers of one loop.  The last worker to finish notifies done and
+// runs complete, which makes the loop's Future ready.
+template <typename IntegerT, typename F>
+struct AsyncParForState {
+  AsyncParForState(
+      const ChunkedRange<IntegerT>& r,
+      F&& func,
+      IntegerT chunkSize,
+      int64_t minChunkItems,
+      ssize_t numWorkers)
+      : range(r),
+        chunk(chunkSize),
+        minItems(minChunkItems),
+        workingThreads(numWorkers),
+        index(r.start),
+        pending(numWorkers),
+        f(std::move(func)) {}
+
+  // Claims and runs chunks until none are left.  If f throws, the first exception is kept, and
+  // the chunks nobody has claimed yet are skipped.
+  void runChunks() {
+    auto recurseInfo = PerPoolPerThreadInfo::parForRecurse();
+#if defined(__cpp_exceptions)
+    try {
+      runDynamicChunks(range, index, chunk, minItems, workingThreads, nullptr, f);
+    } catch (...) {
+      if (!failed.exchange(true, std::memory_order_relaxed)) {
+        exception = std::current_exception();
+      }
+      index.store(range.end, std::memory_order_relaxed);
+    }
+#else
+    runDynamicChunks(range, index, chunk, minItems, workingThreads, nullptr, f);
+#endif // __cpp_exceptions
+  }
+
+  const ChunkedRange<IntegerT> range;
+  const IntegerT chunk;
+  const int64_t minItems;
+  const ssize_t workingThreads;
+  alignas(kCacheLineSize) std::atomic<IntegerT> index;
+  alignas(kCacheLineSize) std::atomic<ssize_t> pending;
+  F f;
+  CompletionEvent done;
+  OnceFunction complete;
+#if defined(__cpp_exceptions)
+  std::atomic<bool> failed{false};
+  std::exception_ptr exception;
+#endif // __cpp_exceptions
+};
+
+} // namespace detail
+
+/**
+ * Execute a loop over the range in parallel on a pool, without waiting.  The loop's chunks are
+ * claimed dynamically by up to <code>options.maxThreads</code> pool threads, and the thread that
+ * finishes the last chunk completes the returned Future, so continuations attached with
+ * <code>then</code> run as soon as the loop is done, and the Future can be combined with others
+ * through <code>when_all</code>.  A thread that waits on the Future before the loop is done
+ * helps run the remaining chunks.
+ *
+ * @param pool The pool to run the loop on.
+ * @param range The range defining the loop extents as well as chunking strategy.  Static ranges
+ * are split into one chunk per thread.
+ * @param f The functor to execute in parallel.  Must have a signature like
+ * <code>void(size_t begin, size_t end)</code>.  It is moved into the loop's shared state.
+ * @param options See ParForOptions for details.  <code>wait</code> is ignored, and
+ * <code>numaPlacement</code>, <code>chunkAlignment</code>, <code>stopOnCancel</code> and
+ * <code>affinity</code> are not supported.
+ *
+ * @return A Future that becomes ready once every chunk has run.  If <code>f</code> throws, the
+ * remaining chunks are skipped, and the first exception is rethrown from <code>get</code>.  Loops
+ * that cannot use the pool (no pool threads, <code>maxThreads</code> of zero, tiny ranges, or
+ * calls from inside a parallel_for on the same pool) run inline, and return a ready Future.
+ **/
+template <typename IntegerT, typename F>
+Future<void> async_parallel_for(
+    ThreadPool& pool,
+    const ChunkedRange<IntegerT>& range,
+    F&& f,
+    ParForOptions options = {}) {
+  if (range.empty()) {
+    return make_ready_future();
+  }
+  options.wait = false;
+  detail::capThreadsForGrain(range.size(), options);
+  ssize_t numToLaunch = std::min<ssize_t>(options.maxThreads, pool.numThreads());
+  if (numToLaunch == 0 || range.size() == 1 ||
+      detail::PerPoolPerThreadInfo::isParForRecursive(&pool)) {
+    return Future<void>([&range, &f]() { f(range.start, range.end); }, kImmediateInvoker);
+  }
+
+  const int64_t minItems = detail::minChunkItems(options);
+  int64_t chunk = range.isStatic() || numToLaunch == 1
+      ? (range.size() + numToLaunch - 1) / numToLaunch
+      : static_cast<int64_t>(range.calcChunkSize(numToLaunch, false));
+  chunk = std::max(chunk, minItems);
+  numToLaunch = std::min<ssize_t>(numToLaunch, (range.size() + chunk - 1) / chunk);
+
+  using FNoRef = std::remove_reference_t<F>;
+  using State = detail::AsyncParForState<IntegerT, FNoRef>;
+  auto state = std::make_shared<State>(
+      range, FNoRef(std::forward<F>(f)), static_cast<IntegerT>(chunk), minItems, numToLaunch);
+
+  // Waiting on the Future may run this early, on the waiting thread, in which case it helps with
+  // the remaining chunks and then waits for those still running elsewhere.
+  detail::InterceptionInvoker invoker;
+  Future<void> result(
+      [state]() {
+        if (state->pending.load(std::memory_order_acquire)) {
+          state->runChunks();
+          state->done.wait();
+        }
+#if defined(__cpp_exceptions)
+        if (state->exception) {
+          std::rethrow_exception(state->exception);
+        }
+#endif // __cpp_exceptions
+      },
+      invoker);
+  state->complete = std::move(invoker.savedOffFn);
+
+  auto worker = [state]() {
+    state->runChunks();
+    // Continuations run from complete, outside of the chunks' parallel_for recursion marker.
+    if (state->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      state->done.notify();
+      state->complete();
+    }
+  };
+  pool.scheduleBulk(
+      static_cast<size_t>(numToLaunch), [&worker](size_t) { return worker; }, ForceQueuingTag());
+  return result;
+}
+
+/**
+ * Execute a loop over the range in parallel on the global thread pool, without waiting.  See the
+ * overload taking a <code>ThreadPool</code>.
+ *
+ * @param range The range defining the loop extents as well as chunking strategy.
+ * @param f The functor to execute in parallel.  Must have a signature like
+ * <code>void(size_t begin, size_t end)</code>.
+ * @param options See ParForOptions for details.
+ *
+ * @return A Future that becomes ready once every chunk has run.
+ **/
+template <typename IntegerT, typename F>
+Future<void>
+async_parallel_for(const ChunkedRange<IntegerT>& range, F&& f, ParForOptions options = {}) {
+  return async_parallel_for(globalThreadPool(), range, std::forward<F>(f), options);
+}
+
+/**
+ * Execute a loop over the indices [start, end) in parallel on a pool, without waiting.  Chunking
+ * follows <code>options.defaultChunking</code>.  See the overload taking a ChunkedRange.
+ *
+ * @param pool The pool to run the loop on.
+ * @param start The start of the loop extents.
+ * @param end The end of the loop extents.
+ * @param f The functor to execute in parallel.  Must have a signature like
+ * <code>void(size_t index)</code>.
+ * @param options See ParForOptions for details.
+ *
+ * @return A Future that becomes ready once every index has run.
+ **/
+template <
+    typename IntegerA,
+    typename IntegerB,
+    typename F,
+    std::enable_if_t<std::is_integral<IntegerA>::value, bool> = true,
+    std::enable_if_t<std::is_integral<IntegerB>::value, bool> = true>
+Future<void> async_parallel_for(
+    ThreadPool& pool,
+    IntegerA start,
+    IntegerB end,
+    F&& f,
+    ParForOptions options = {}) {
+  using IntegerT = std::common_type_t<IntegerA, IntegerB>;
+  auto range = makeChunkedRange(start, end, options.defaultChunking);
+  return async_parallel_for(
+      pool,
+      range,
+      [f = std::forward<F>(f)](IntegerT s, IntegerT e) {
+        for (IntegerT i = s; i < e; ++i) {
+          f(i);
+        }
+      },
+      options);
+}
+
+/**
+ * Execute a loop over the indices [start, end) in parallel on the global thread pool, without
+ * waiting.  See the overload taking a ChunkedRange.
+ *
+ * @param start The start of the loop extents.
+ * @param end The end of the loop extents.
+ * @param f The functor to execute in parallel.  Must have a signature like
+ * <code>void(size_t index)</code>.
+ * @param options See ParForOptions for details.
+ *
+ * @return A Future that becomes ready once every index has run.
+ **/
+template <
+    typename IntegerA,
+    typename IntegerB,
+    typename F,
+    std::enable_if_t<std::is_integral<IntegerA>::value, bool> = true,
+    std::enable_if_t<std::is_integral<IntegerB>::value, bool> = true>
+Future<void> async_parallel_for(IntegerA start, IntegerB end, F&& f, ParForOptions options = {}) {
+  return async_parallel_for(globalThreadPool(), start, end, std::forward<F>(f), options);
+}
+
+} // namespace dispenso
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file barrier.h
+ * A file providing Barrier, a reusable thread barrier for phase-synchronous work, similar to
+ * std::barrier.
+ **/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+
+#include <dispenso/detail/completion_event_impl.h>
+#include <dispenso/platform.h>
+
+namespace dispenso {
+
+/**
+ * A reusable barrier.  Each phase completes once the expected number of participants have arrived,
+ * at which point an optional completion function runs on the last arriving thread, and then all
+ * waiting participants are released into the next phase.  Waiters spin briefly before sleeping in
+ * the OS.
+ **/
+class Barrier {
+ public:
+  /**
+   * Construct a Barrier.
+   *
+   * @param expected The number of participants in each phase.  Must be positive.
+   * @param completion A functor run once per phase, after all participants have arrived and before
+   * any are released.
+   **/
+  explicit Barrier(ptrdiff_t expected, std::function<void()> completion = {})
+      : expected_(expected), remaining_(expected), completion_(std::move(completion)) {}
+
+  Barrier(const Barrier&) = delete;
+  Barrier& operator=(const Barrier&) = delete;
+
+  /**
+   * Arrive at the barrier, and wait for the current phase to complete.
+   **/
+  void arriveAndWait() {
+    int phase = phase_.intrusiveStatus().load(std::memory_order_acquire);
+    if (arrive(phase)) {
+      return;
+    }
+    int next = nextPhase(phase);
+    for (int i = 0; i < kSpinsBeforeSleep; ++i) {
+      if (phase_.intrusiveStatus().load(std::memory_order_acquire) == next) {
+        return;
+      }
+      detail::cpuRelax();
+    }
+    // Pairs with the fence in arrive: either the last arriver sees this sleeper and wakes it, or
+    // the wait sees the new phase.
+    sleepers_.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    phase_.wait(next);
+    sleepers_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  /**
+   * Arrive at the barrier without waiting, and remove the caller from subsequent phases.
+   **/
+  void arriveAndDrop() {
+    int phase = phase_.intrusiveStatus().load(std::memory_order_acquire);
+    expected_.fetch_sub(1, std::memory_order_relaxed);
+    arrive(phase);
+  }
+
+ private:
+  static constexpr int kSpinsBeforeSleep = 1024;
+
+  static int nextPhase(int phase) {
+    // Wrap around rather than overflow.
+    return static_cast<int>(static_cast<unsigned>(phase) + 1u);
+  }
+
+  // Returns true if the caller completed the phase.
+  bool arrive(int phase) {
+    if (remaining_.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+      return false;
+    }
+    // No participant can arrive for the next phase until it is released below, so the count can be
+    // reset without racing.
+    remaining_.store(expected_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    if (completion_) {
+      completion_();
+    }
+    // Skip the wake system call when every participant is still spinning, which is the common case
+    // for tightly synchronized phases.
+    int next = nextPhase(phase);
+    phase_.intrusiveStatus().store(next, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepers_.load(std::memory_order_relaxed)) {
+      phase_.notify(next);
+    }
+    return true;
+  }
+
+  std::atomic<ptrdiff_t> expected_;
+  alignas(kCacheLineSize) std::atomic<ptrdiff_t> remaining_;
+  std::function<void()> completion_;
+  alignas(kCacheLineSize) detail::CompletionEventImpl phase_{0};
+  std::atomic<int> sleepers_{0};
+};
+
+} // namespace dispenso
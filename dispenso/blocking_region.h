@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file blocking_region.h
+ * A file providing BlockingRegion, a scoped hint that a task is about to block, letting the pool
+ * activate a spare thread meanwhile.
+ **/
+
+#pragma once
+
+#include <dispenso/thread_pool.h>
+
+namespace dispenso {
+
+/**
+ * A scoped guard marking a region in which the running task blocks, e.g. on file I/O.  If
+ * constructed on one of the pool's threads, a spare thread runs the pool's work until the guard is
+ * destroyed, so the pool's effective parallelism holds up.  Elsewhere the guard has no effect.
+ *
+ * @code
+ * pool.schedule([&]() {
+ *   std::string contents;
+ *   {
+ *     dispenso::BlockingRegion blocking(pool);
+ *     contents = readFile(path);
+ *   }
+ *   process(contents);
+ * });
+ * @endcode
+ **/
+class BlockingRegion {
+ public:
+  /**
+   * Enter a blocking region.
+   *
+   * @param pool The pool whose thread is about to block.
+   **/
+  explicit BlockingRegion(ThreadPool& pool = globalThreadPool())
+      : pool_(pool), compensated_(pool.enterBlocking()) {}
+
+  BlockingRegion(const BlockingRegion&) = delete;
+  BlockingRegion& operator=(const BlockingRegion&) = delete;
+
+  /**
+   * Check whether a spare thread was activated for this region.
+   *
+   * @return true if the pool is compensating for the blocked thread.
+   **/
+  bool compensated() const {
+    return compensated_;
+  }
+
+  /**
+   * Leave the blocking region.
+   **/
+  ~BlockingRegion() {
+    if (compensated_) {
+      pool_.exitBlocking();
+    }
+  }
+
+ private:
+  ThreadPool& pool_;
+  bool compensated_;
+};
+
+} // namespace dispenso
@@ -0,0 +1,300 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file bounded_queue.h
+ * A file providing a bounded multi-producer, multi-consumer queue.  The queue is a fixed-capacity
+ * ring buffer of cells, each tagged with a sequence number (after Dmitry Vyukov's bounded MPMC
+ * queue), so producers and consumers only contend on their own position counter, and never
+ * allocate after construction.  Non-blocking tryPush/tryPop are lock-free in the common case, and
+ * the blocking push/pop variants sleep in the OS (a futex on Linux) rather than spinning while the
+ * queue is full or empty.
+ **/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <thread>
+#include <utility>
+
+#include <dispenso/detail/epoch_waiter.h>
+#include <dispenso/detail/math.h>
+#include <dispenso/platform.h>
+
+namespace dispenso {
+
+/**
+ * A bounded, concurrent, multi-producer multi-consumer FIFO queue.
+ *
+ * @tparam T The element type.  Must be move constructible.
+ **/
+template <typename T>
+class BoundedQueue {
+ public:
+  /**
+   * Construct the queue.
+   *
+   * @param capacity The maximum number of elements the queue may hold.  This is rounded up to a
+   * power of two (and at least 2).
+   **/
+  explicit BoundedQueue(size_t capacity)
+      : mask_(std::max<size_t>(2, detail::nextPow2(capacity)) - 1),
+        cells_(reinterpret_cast<Cell*>(
+            detail::alignedMalloc((mask_ + 1) * sizeof(Cell), alignof(Cell)))) {
+    for (size_t i = 0; i <= mask_; ++i) {
+      new (&cells_[i].sequence) std::atomic<size_t>(i);
+    }
+  }
+
+  BoundedQueue(const BoundedQueue&) = delete;
+  BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+  /**
+   * Destroy the queue, and any elements remaining in it.  Not concurrency safe.
+   **/
+  ~BoundedQueue() {
+    for (size_t pos = popPos_.load(std::memory_order_relaxed);
+         pos != pushPos_.load(std::memory_order_relaxed);
+         ++pos) {
+      cells_[pos & mask_].value()->~T();
+    }
+    detail::alignedFree(cells_);
+  }
+
+  /**
+   * Try to construct an element at the back of the queue.  Concurrency safe.
+   *
+   * @param args The arguments to construct the element with.
+   * @return true if the element was enqueued, false if the queue was full or closed.
+   **/
+  template <typename... Args>
+  bool tryEmplace(Args&&... args) {
+    if (closed_.load(std::memory_order_relaxed)) {
+      return false;
+    }
+    size_t pos = pushPos_.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+      cell = &cells_[pos & mask_];
+      size_t seq = cell->sequence.load(std::memory_order_acquire);
+      ssize_t dif = static_cast<ssize_t>(seq - pos);
+      if (dif == 0) {
+        if (pushPos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (dif < 0) {
+        return false;
+      } else {
+        pos = pushPos_.load(std::memory_order_relaxed);
+      }
+    }
+    new (cell->storage) T(std::forward<Args>(args)...);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    wakeIfWaiting(popWaiters_, notEmpty_);
+    return true;
+  }
+
+  /**
+   * Try to push an element to the back of the queue.  Concurrency safe.
+   *
+   * @param value The element to push.
+   * @return true if the element was enqueued, false if the queue was full or closed.
+   **/
+  bool tryPush(const T& value) {
+    return tryEmplace(value);
+  }
+
+  /**
+   * Try to push an element to the back of the queue.  Concurrency safe.
+   *
+   * @param value The element to push.  It is only moved from if the push succeeds.
+   * @return true if the element was enqueued, false if the queue was full or closed.
+   **/
+  bool tryPush(T&& value) {
+    return tryEmplace(std::move(value));
+  }
+
+  /**
+   * Push an element to the back of the queue, sleeping while the queue is full.  Concurrency safe.
+   *
+   * @param value The element to push.
+   * @return true if the element was enqueued, false if the queue was closed.
+   **/
+  bool push(T&& value) {
+    return blockingOp(
+        pushWaiters_, notFull_, [this, &value]() { return tryPush(std::move(value)); });
+  }
+
+  /**
+   * Push an element to the back of the queue, sleeping while the queue is full.  Concurrency safe.
+   *
+   * @param value The element to push.
+   * @return true if the element was enqueued, false if the queue was closed.
+   **/
+  bool push(const T& value) {
+    return blockingOp(pushWaiters_, notFull_, [this, &value]() { return tryPush(value); });
+  }
+
+  /**
+   * Try to pop the element at the front of the queue.  Concurrency safe.
+   *
+   * @param out Assigned the popped element on success.
+   * @return true if an element was popped, false if the queue was empty.
+   **/
+  bool tryPop(T& out) {
+    size_t pos = popPos_.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+      cell = &cells_[pos & mask_];
+      size_t seq = cell->sequence.load(std::memory_order_acquire);
+      ssize_t dif = static_cast<ssize_t>(seq - (pos + 1));
+      if (dif == 0) {
+        if (popPos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (dif < 0) {
+        return false;
+      } else {
+        pos = popPos_.load(std::memory_order_relaxed);
+      }
+    }
+    T* value = cell->value();
+    out = std::move(*value);
+    value->~T();
+    cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+    wakeIfWaiting(pushWaiters_, notFull_);
+    return true;
+  }
+
+  /**
+   * Pop the element at the front of the queue, sleeping while the queue is empty.  Concurrency
+   * safe.
+   *
+   * @param out Assigned the popped element on success.
+   * @return true if an element was popped, false if the queue was closed and is empty.
+   **/
+  bool pop(T& out) {
+    return blockingOp(popWaiters_, notEmpty_, [this, &out]() { return tryPop(out); });
+  }
+
+  /**
+   * Close the queue.  Subsequent pushes fail, and blocked or subsequent pops fail once the queue is
+   * drained.  Elements pushed concurrently with close may remain in the queue for tryPop.
+   * Concurrency safe.
+   **/
+  void close() {
+    closed_.store(true, std::memory_order_seq_cst);
+    notEmpty_.bumpAndWakeAll();
+    notFull_.bumpAndWakeAll();
+  }
+
+  /**
+   * Check if the queue has been closed.  Concurrency safe.
+   *
+   * @return true if close() has been called.
+   **/
+  bool closed() const {
+    return closed_.load(std::memory_order_acquire);
+  }
+
+  /**
+   * Get the approximate number of elements in the queue.  Concurrency safe, but the result may be
+   * stale by the time it is used.
+   *
+   * @return The number of elements in the queue.
+   **/
+  size_t size() const {
+    size_t popPos = popPos_.load(std::memory_order_acquire);
+    size_t pushPos = pushPos_.load(std::memory_order_acquire);
+    return pushPos > popPos ? std::min(pushPos - popPos, capacity()) : 0;
+  }
+
+  /**
+   * Check if the queue is approximately empty.  Concurrency safe, but the result may be stale.
+   *
+   * @return true if the queue held no elements.
+   **/
+  bool empty() const {
+    return size() == 0;
+  }
+
+  /**
+   * Get the capacity of the queue.
+   *
+   * @return The maximum number of elements the queue can hold.
+   **/
+  size_t capacity() const {
+    return mask_ + 1;
+  }
+
+ private:
+  struct Cell {
+    T* value() {
+      return reinterpret_cast<T*>(storage);
+    }
+
+    std::atomic<size_t> sequence;
+    alignas(T) char storage[sizeof(T)];
+  };
+
+  // Blocked threads register in waiters before their final attempt, and the other side checks
+  // waiters after completing an operation.  The fences ensure at least one of them sees the other,
+  // so a wakeup is never lost, and the uncontended path never makes a system call.
+  void wakeIfWaiting(std::atomic<int>& waiters, detail::EpochWaiter& waiter) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters.load(std::memory_order_relaxed)) {
+      waiter.bumpAndWake();
+    }
+  }
+
+  template <typename TryOp>
+  bool blockingOp(std::atomic<int>& waiters, detail::EpochWaiter& waiter, TryOp tryOp) {
+    // Yield briefly first, since the other side often completes within a timeslice, and parking
+    // costs system calls on both sides.
+    for (int i = 0; i < kYieldsBeforeSleep; ++i) {
+      if (tryOp()) {
+        return true;
+      }
+      if (closed_.load(std::memory_order_acquire)) {
+        break;
+      }
+      std::this_thread::yield();
+    }
+    while (true) {
+      waiters.fetch_add(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      uint32_t epoch = waiter.current();
+      bool done = tryOp();
+      if (!done && !closed_.load(std::memory_order_acquire)) {
+        waiter.wait(epoch);
+      }
+      waiters.fetch_sub(1, std::memory_order_relaxed);
+      if (done || tryOp()) {
+        return true;
+      }
+      if (closed_.load(std::memory_order_acquire)) {
+        return false;
+      }
+    }
+  }
+
+  static constexpr int kYieldsBeforeSleep = 16;
+
+  const size_t mask_;
+  Cell* const cells_;
+  alignas(kCacheLineSize) std::atomic<size_t> pushPos_{0};
+  alignas(kCacheLineSize) std::atomic<size_t> popPos_{0};
+  alignas(kCacheLineSize) std::atomic<int> pushWaiters_{0};
+  std::atomic<int> popWaiters_{0};
+  std::atomic<bool> closed_{false};
+  alignas(kCacheLineSize) detail::EpochWaiter notFull_;
+  alignas(kCacheLineSize) detail::EpochWaiter notEmpty_;
+};
+
+} // namespace dispenso
@@ -0,0 +1,518 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file concurrent_hash_map.h
+ * A file providing a concurrent hash map.  The map is split into a power-of-two number of shards,
+ * each an open-addressing (linear probing) table guarded by its own RWLock.  Lookups take the
+ * shard's lock for read, and insertions take it for write, so threads only contend when they touch
+ * the same shard.  Each shard grows independently, so growth never stalls the whole map.
+ *
+ * Elements are allocated individually (via the small buffer allocator when small enough), and the
+ * tables hold only the hash and a pointer to the element.  This keeps probing compact, and means
+ * that pointers to elements remain valid while the map grows.  As with
+ * tbb::concurrent_unordered_map, insertion and lookup are safe to call concurrently, while erasure
+ * is safe with respect to other operations on the map, but invalidates any pointer to the erased
+ * element that another thread may hold.
+ **/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <shared_mutex>
+#include <thread>
+#include <tuple>
+#include <utility>
+
+#include <dispenso/detail/math.h>
+#include <dispenso/platform.h>
+#include <dispenso/rw_lock.h>
+#include <dispenso/small_buffer_allocator.h>
+
+namespace dispenso {
+
+/**
+ * A concurrent unordered map from Key to T.
+ *
+ * @tparam Key The key type.
+ * @tparam T The mapped type.
+ * @tparam Hash A hash functor for Key.  The result is remixed internally, so identity hashes (e.g.
+ * std::hash for integers) are fine.
+ * @tparam KeyEqual An equality functor for Key.
+ **/
+template <
+    typename Key,
+    typename T,
+    typename Hash = std::hash<Key>,
+    typename KeyEqual = std::equal_to<Key>>
+class ConcurrentHashMap {
+ public:
+  using key_type = Key;
+  using mapped_type = T;
+  using value_type = std::pair<const Key, T>;
+  using size_type = size_t;
+  using hasher = Hash;
+  using key_equal = KeyEqual;
+  using reference = value_type&;
+  using const_reference = const value_type&;
+  using pointer = value_type*;
+  using const_pointer = const value_type*;
+
+  /**
+   * Construct the map.
+   *
+   * @param initialCapacity The number of elements to reserve space for up front.
+   * @param numShards The number of independently locked shards, rounded up to a power of two.  If
+   * zero, a default based on the hardware concurrency is used.
+   * @param hash The hash functor.
+   * @param equal The key equality functor.
+   **/
+  explicit ConcurrentHashMap(
+      size_t initialCapacity = 0,
+      size_t numShards = 0,
+      const Hash& hash = Hash(),
+      const KeyEqual& equal = KeyEqual())
+      : hash_(hash), equal_(equal) {
+    if (!numShards) {
+      numShards = std::max<size_t>(16, 4 * std::thread::hardware_concurrency());
+    }
+    numShards = std::min<size_t>(detail::nextPow2(numShards), kMaxShards);
+    shardBits_ = detail::log2(numShards);
+    shards_ = reinterpret_cast<Shard*>(
+        detail::alignedMalloc(numShards * sizeof(Shard), alignof(Shard)));
+    for (size_t i = 0; i < numShards; ++i) {
+      new (shards_ + i) Shard();
+    }
+    reserve(initialCapacity);
+  }
+
+  ConcurrentHashMap(const ConcurrentHashMap&) = delete;
+  ConcurrentHashMap& operator=(const ConcurrentHashMap&) = delete;
+
+  /**
+   * Destroy the map.  Not concurrency safe.
+   **/
+  ~ConcurrentHashMap() {
+    clear();
+    for (size_t i = 0; i < numShards(); ++i) {
+      detail::alignedFree(shards_[i].slots);
+      shards_[i].~Shard();
+    }
+    detail::alignedFree(shards_);
+  }
+
+  /**
+   * Insert a key/value pair if the key is not already present.  Concurrency safe.
+   *
+   * @param value The pair to insert.
+   * @return A pair of a pointer to the element with the key, and whether the insertion took place.
+   **/
+  std::pair<pointer, bool> insert(const value_type& value) {
+    return try_emplace(value.first, value.second);
+  }
+
+  /**
+   * Insert a key/value pair if the key is not already present.  Concurrency safe.
+   *
+   * @param value The pair to insert.
+   * @return A pair of a pointer to the element with the key, and whether the insertion took place.
+   **/
+  std::pair<pointer, bool> insert(value_type&& value) {
+    return try_emplace(std::move(const_cast<Key&>(value.first)), std::move(value.second));
+  }
+
+  /**
+   * Construct an element in place from args if its key is not already present.  Concurrency safe.
+   * The element is constructed before the lookup, and destroyed again if the key is present; prefer
+   * try_emplace when the key is available separately.
+   *
+   * @param args The arguments to construct a value_type from.
+   * @return A pair of a pointer to the element with the key, and whether the insertion took place.
+   **/
+  template <typename... Args>
+  std::pair<pointer, bool> emplace(Args&&... args) {
+    value_type* node = newNode(std::forward<Args>(args)...);
+    size_t hash = hashOf(node->first);
+    Shard& shard = shardFor(hash);
+    std::lock_guard<UnalignedRWLock> lk(shard.lock);
+    if (value_type* existing = findLocked(shard, hash, node->first)) {
+      deleteNode(node);
+      return {existing, false};
+    }
+    insertLocked(shard, hash, node);
+    return {node, true};
+  }
+
+  /**
+   * Construct an element from key and args if the key is not already present.  Concurrency safe.
+   *
+   * @param key The key to look up, and to construct the element with.
+   * @param args The arguments to construct the mapped value from.
+   * @return A pair of a pointer to the element with the key, and whether the insertion took place.
+   **/
+  template <typename K, typename... Args>
+  std::pair<pointer, bool> try_emplace(K&& key, Args&&... args) {
+    size_t hash = hashOf(key);
+    Shard& shard = shardFor(hash);
+    {
+      // Most lookups of existing keys need only the read lock.
+      std::shared_lock<UnalignedRWLock> lk(shard.lock);
+      if (value_type* existing = findLocked(shard, hash, key)) {
+        return {existing, false};
+      }
+    }
+    std::lock_guard<UnalignedRWLock> lk(shard.lock);
+    if (value_type* existing = findLocked(shard, hash, key)) {
+      return {existing, false};
+    }
+    value_type* node = newNode(
+        std::piecewise_construct,
+        std::forward_as_tuple(std::forward<K>(key)),
+        std::forward_as_tuple(std::forward<Args>(args)...));
+    insertLocked(shard, hash, node);
+    return {node, true};
+  }
+
+  /**
+   * Get the mapped value for key, default constructing it if the key is not present.
+   * Concurrency safe.
+   *
+   * @param key The key to look up.
+   * @return A reference to the mapped value.
+   **/
+  T& operator[](const Key& key) {
+    return try_emplace(key).first->second;
+  }
+
+  /**
+   * Find the element with key.  Concurrency safe.
+   *
+   * @param key The key to look up.
+   * @return A pointer to the element, or nullptr if the key is not present.
+   **/
+  pointer find(const Key& key) {
+    size_t hash = hashOf(key);
+    Shard& shard = shardFor(hash);
+    std::shared_lock<UnalignedRWLock> lk(shard.lock);
+    return findLocked(shard, hash, key);
+  }
+
+  /**
+   * Find the element with key.  Concurrency safe.
+   *
+   * @param key The key to look up.
+   * @return A pointer to the element, or nullptr if the key is not present.
+   **/
+  const_pointer find(const Key& key) const {
+    return const_cast<ConcurrentHashMap*>(this)->find(key);
+  }
+
+  /**
+   * Count the elements with key.  Concurrency safe.
+   *
+   * @param key The key to look up.
+   * @return 1 if the key is present, 0 otherwise.
+   **/
+  size_t count(const Key& key) const {
+    return find(key) != nullptr;
+  }
+
+  /**
+   * Check if the key is present.  Concurrency safe.
+   *
+   * @param key The key to look up.
+   * @return true if the key is present.
+   **/
+  bool contains(const Key& key) const {
+    return find(key) != nullptr;
+  }
+
+  /**
+   * Remove the element with key.  Concurrency safe with respect to other calls on the map, but
+   * pointers to the erased element are invalidated, and it is the user's responsibility to ensure
+   * no other thread is still using it.
+   *
+   * @param key The key to remove.
+   * @return The number of elements removed (0 or 1).
+   **/
+  size_t erase(const Key& key) {
+    size_t hash = hashOf(key);
+    Shard& shard = shardFor(hash);
+    value_type* node;
+    {
+      std::lock_guard<UnalignedRWLock> lk(shard.lock);
+      node = eraseLocked(shard, hash, key);
+    }
+    if (!node) {
+      return 0;
+    }
+    deleteNode(node);
+    return 1;
+  }
+
+  /**
+   * Get the number of elements.  Concurrency safe, though elements may be inserted concurrently.
+   *
+   * @return The number of elements in the map.
+   **/
+  size_t size() const {
+    size_t total = 0;
+    for (size_t i = 0; i < numShards(); ++i) {
+      total += shards_[i].count.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+  /**
+   * Check if the map is empty.  Concurrency safe, though elements may be inserted concurrently.
+   *
+   * @return true if there are no elements in the map.
+   **/
+  bool empty() const {
+    return size() == 0;
+  }
+
+  /**
+   * Reserve space for at least capacity elements, spread evenly across the shards.  Concurrency
+   * safe.
+   *
+   * @param capacity The number of elements to reserve space for.
+   **/
+  void reserve(size_t capacity) {
+    size_t perShard = (capacity + numShards() - 1) >> shardBits_;
+    if (!perShard) {
+      return;
+    }
+    size_t slots = detail::nextPow2(perShard + perShard / 3 + 1);
+    for (size_t i = 0; i < numShards(); ++i) {
+      Shard& shard = shards_[i];
+      std::lock_guard<UnalignedRWLock> lk(shard.lock);
+      if (shard.capacity() < slots) {
+        rehashLocked(shard, slots);
+      }
+    }
+  }
+
+  /**
+   * Remove all elements.  Table storage is retained.  Not concurrency safe.
+   **/
+  void clear() {
+    for (size_t i = 0; i < numShards(); ++i) {
+      Shard& shard = shards_[i];
+      for (size_t s = 0; s < shard.capacity(); ++s) {
+        if (shard.slots[s].node) {
+          deleteNode(shard.slots[s].node);
+          shard.slots[s] = Slot();
+        }
+      }
+      shard.count.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * Call f on every element.  Each shard is held for read while its elements are visited, so
+   * concurrent inserts into other shards may or may not be seen.  f must not insert into or erase
+   * from this map.
+   *
+   * @param f A functor with signature like <code>void(value_type&)</code>.
+   **/
+  template <typename F>
+  void for_each(F&& f) {
+    for (size_t i = 0; i < numShards(); ++i) {
+      Shard& shard = shards_[i];
+      std::shared_lock<UnalignedRWLock> lk(shard.lock);
+      for (size_t s = 0; s < shard.capacity(); ++s) {
+        if (value_type* node = shard.slots[s].node) {
+          f(*node);
+        }
+      }
+    }
+  }
+
+  /**
+   * Call f on every element.  See the non-const version.
+   *
+   * @param f A functor with signature like <code>void(const value_type&)</code>.
+   **/
+  template <typename F>
+  void for_each(F&& f) const {
+    const_cast<ConcurrentHashMap*>(this)->for_each(
+        [&f](const value_type& value) { f(value); });
+  }
+
+  /**
+   * Get the number of shards.
+   *
+   * @return The number of independently locked shards.
+   **/
+  size_t numShards() const {
+    return size_t{1} << shardBits_;
+  }
+
+ private:
+  static constexpr size_t kMaxShards = 1 << 16;
+  static constexpr size_t kMinShardCapacity = 8;
+  // Small buffer blocks are aligned to their size, so this also satisfies the element alignment.
+  static constexpr size_t kNodeBlockSize = static_cast<size_t>(
+      detail::nextPow2(std::max({sizeof(value_type), alignof(value_type), size_t{8}})));
+
+  struct Slot {
+    size_t hash = 0;
+    value_type* node = nullptr;
+  };
+
+  struct alignas(kCacheLineSize) Shard {
+    size_t capacity() const {
+      return slots ? mask + 1 : 0;
+    }
+
+    UnalignedRWLock lock;
+    Slot* slots = nullptr;
+    size_t mask = 0;
+    std::atomic<size_t> count{0};
+  };
+
+  template <typename K>
+  size_t hashOf(const K& key) const {
+    // Finalizer from MurmurHash3, so that the low and high bits are both well distributed.
+    uint64_t h = static_cast<uint64_t>(hash_(key));
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return static_cast<size_t>(h);
+  }
+
+  Shard& shardFor(size_t hash) const {
+    return shards_[hash & (numShards() - 1)];
+  }
+
+  size_t homeSlot(const Shard& shard, size_t hash) const {
+    return (hash >> shardBits_) & shard.mask;
+  }
+
+  template <typename K>
+  value_type* findLocked(const Shard& shard, size_t hash, const K& key) const {
+    if (!shard.slots) {
+      return nullptr;
+    }
+    for (size_t s = homeSlot(shard, hash);; s = (s + 1) & shard.mask) {
+      const Slot& slot = shard.slots[s];
+      if (!slot.node) {
+        return nullptr;
+      }
+      if (slot.hash == hash && equal_(slot.node->first, key)) {
+        return slot.node;
+      }
+    }
+  }
+
+  void placeLocked(Shard& shard, size_t hash, value_type* node) {
+    size_t s = homeSlot(shard, hash);
+    while (shard.slots[s].node) {
+      s = (s + 1) & shard.mask;
+    }
+    shard.slots[s].hash = hash;
+    shard.slots[s].node = node;
+  }
+
+  void insertLocked(Shard& shard, size_t hash, value_type* node) {
+    size_t count = shard.count.load(std::memory_order_relaxed) + 1;
+    // Keep the load factor at or below 3/4, so that probe sequences stay short.
+    if (4 * count > 3 * shard.capacity()) {
+      rehashLocked(shard, std::max(kMinShardCapacity, 2 * shard.capacity()));
+    }
+    placeLocked(shard, hash, node);
+    shard.count.store(count, std::memory_order_relaxed);
+  }
+
+  value_type* eraseLocked(Shard& shard, size_t hash, const Key& key) {
+    if (!shard.slots) {
+      return nullptr;
+    }
+    size_t s = homeSlot(shard, hash);
+    for (;; s = (s + 1) & shard.mask) {
+      const Slot& slot = shard.slots[s];
+      if (!slot.node) {
+        return nullptr;
+      }
+      if (slot.hash == hash && equal_(slot.node->first, key)) {
+        break;
+      }
+    }
+    value_type* node = shard.slots[s].node;
+    // Backward shift deletion: pull later elements of the probe run into the hole, unless that
+    // would move them before their home slot.  This avoids the need for tombstones.
+    for (size_t next = (s + 1) & shard.mask; shard.slots[next].node;
+         next = (next + 1) & shard.mask) {
+      size_t home = homeSlot(shard, shard.slots[next].hash);
+      if (((next - home) & shard.mask) >= ((next - s) & shard.mask)) {
+        shard.slots[s] = shard.slots[next];
+        s = next;
+      }
+    }
+    shard.slots[s] = Slot();
+    shard.count.store(shard.count.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+    return node;
+  }
+
+  void rehashLocked(Shard& shard, size_t newCapacity) {
+    Slot* oldSlots = shard.slots;
+    size_t oldCapacity = shard.capacity();
+    shard.slots =
+        reinterpret_cast<Slot*>(detail::alignedMalloc(newCapacity * sizeof(Slot), kCacheLineSize));
+    std::uninitialized_fill_n(shard.slots, newCapacity, Slot());
+    shard.mask = newCapacity - 1;
+    for (size_t s = 0; s < oldCapacity; ++s) {
+      if (oldSlots[s].node) {
+        placeLocked(shard, oldSlots[s].hash, oldSlots[s].node);
+      }
+    }
+    detail::alignedFree(oldSlots);
+  }
+
+  template <typename... Args>
+  static value_type* newNode(Args&&... args) {
+    char* buf = allocSmallBuffer<kNodeBlockSize>();
+#if defined(__cpp_exceptions)
+    try {
+      return new (buf) value_type(std::forward<Args>(args)...);
+    } catch (...) {
+      deallocSmallBuffer<kNodeBlockSize>(buf);
+      throw;
+    }
+#else
+    return new (buf) value_type(std::forward<Args>(args)...);
+#endif // __cpp_exceptions
+  }
+
+  static void deleteNode(value_type* node) {
+    node->~value_type();
+    deallocSmallBuffer<kNodeBlockSize>(node);
+  }
+
+  Hash hash_;
+  KeyEqual equal_;
+  size_t shardBits_;
+  Shard* shards_;
+};
+
+template <typename Key, typename T, typename Hash, typename KeyEqual>
+constexpr size_t ConcurrentHashMap<Key, T, Hash, KeyEqual>::kMaxShards;
+template <typename Key, typename T, typename Hash, typename KeyEqual>
+constexpr size_t ConcurrentHashMap<Key, T, Hash, KeyEqual>::kMinShardCapacity;
+template <typename Key, typename T, typename Hash, typename KeyEqual>
+constexpr size_t ConcurrentHashMap<Key, T, Hash, KeyEqual>::kNodeBlockSize;
+
+} // namespace dispenso
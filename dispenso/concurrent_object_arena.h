@@ -12,13 +12,15 @@
 
 #pragma once
 
+#include <dispenso/detail/math.h>
 #include <dispenso/platform.h>
 
+#include <algorithm>
 #include <atomic>
 #include <cassert>
 #include <cstring>
-#include <mutex>
-#include <vector>
+#include <new>
+#include <type_traits>
 
 namespace detail {
 
@@ -42,15 +44,21 @@ namespace dispenso {
  * arrays, with additional bookkeeping. The size of arrays is always power of
  * two (to optimize indexed access)
  * <pre>
- *  buffers  |<────     bufferSize      ───>|
- *    ┌─┐    ┌──────────────────────────────┐
- *    │*├───>│                              │
- *    ├─┤    ├──────────────────────────────┤
- *    │*├───>│                              │
- *    ├─┤    ├──────────────────────────────┤
- *    │*├───>│                              │
- *    └─┘    └──────────────────────────────┘
+ *  levels   buffers  |<────     bufferSize      ───>|
+ *    ┌─┐    ┌─┐      ┌──────────────────────────────┐
+ *    │*├───>│*├─────>│ buffer 0                     │
+ *    ├─┤    └─┘      └──────────────────────────────┘
+ *    │*├───>┌─┐      ┌──────────────────────────────┐
+ *    │ │    │*├─────>│ buffer 1                     │
+ *    │ │    ├─┤      ├──────────────────────────────┤
+ *    │ │    │*├─────>│ buffer 2                     │
+ *    ├─┤    └─┘      └──────────────────────────────┘
+ *    │*├───> ... level k holds 2^k buffer pointers
+ *    └─┘
  *</pre>
+ * Buffer pointer tables are never reallocated, so indexing never races with growth, and buffers
+ * are installed with compare-and-swap, so growth is lock-free.  For many threads appending small
+ * groups, a per-thread <code>Reservation</code> reduces traffic on the shared insertion point.
  **/
 template <class T, class Index = size_t, size_t alignment = dispenso::kCacheLineSize>
 struct ConcurrentObjectArena {
@@ -68,11 +76,8 @@ struct ConcurrentObjectArena {
         kBufferSize(Index{1} << kLog2BuffSize),
         kMask((Index{1} << kLog2BuffSize) - 1),
         pos_(0),
-        allocatedSize_(0),
-        buffers_(nullptr),
-        buffersSize_(0),
-        buffersPos_(0) {
-    allocateBuffer();
+        allocatedSize_(0) {
+    installBuffer(0);
     allocatedSize_.store(kBufferSize, std::memory_order_relaxed);
   }
 
@@ -84,21 +89,12 @@ struct ConcurrentObjectArena {
         kBufferSize(other.kBufferSize),
         kMask(other.kMask),
         pos_(other.pos_.load(std::memory_order_relaxed)),
-        allocatedSize_(other.allocatedSize_.load(std::memory_order_relaxed)),
-        buffersSize_(other.buffersSize_),
-        buffersPos_(other.buffersPos_) {
-    T** otherBuffers = other.buffers_.load(std::memory_order_relaxed);
-    T** newBuffers = new T*[buffersSize_];
-    for (Index i = 0; i < buffersSize_; ++i) {
-      void* ptr = detail::alignedMalloc(kBufferSize * sizeof(T), alignment);
-#if defined(__cpp_exceptions)
-      if (ptr == nullptr)
-        throw std::bad_alloc();
-#endif // __cpp_exceptions
-      std::memcpy(ptr, otherBuffers[i], kBufferSize * sizeof(T));
-      newBuffers[i] = static_cast<T*>(ptr);
+        allocatedSize_(other.allocatedSize_.load(std::memory_order_relaxed)) {
+    const Index numBuffs = numBuffers();
+    for (Index i = 0; i < numBuffs; ++i) {
+      installBuffer(i);
     }
-    buffers_.store(newBuffers, std::memory_order_relaxed);
+    copyObjects(other, std::is_trivially_copyable<T>());
   }
 
   /**
@@ -109,23 +105,29 @@ struct ConcurrentObjectArena {
         kBufferSize(0),
         kMask(0),
         pos_(0),
-        allocatedSize_(0),
-        buffers_(nullptr),
-        buffersSize_(0),
-        buffersPos_(0) {
+        allocatedSize_(0) {
     swap(*this, other);
   }
 
+  /**
+   * Destroy the elements and free the buffers.  To destroy a large arena's elements in parallel,
+   * call <code>clear(taskSet)</code> first.
+   **/
   ~ConcurrentObjectArena() {
-    T** buffers = buffers_.load(std::memory_order_relaxed);
-
-    for (Index i = 0; i < buffersPos_; i++)
-      detail::alignedFree(buffers[i]);
-
-    delete[] buffers;
-
-    for (T** p : deleteLater_)
-      delete[] p;
+    destroyObjects(0, pos_.load(std::memory_order_relaxed));
+    for (Index level = 0; level < kMaxLevels; ++level) {
+      std::atomic<T*>* table = levels_[level].load(std::memory_order_relaxed);
+      if (!table) {
+        break;
+      }
+      for (Index i = 0; i < (Index{1} << level); ++i) {
+        // Free every installed buffer, including any installed just past the capacity.
+        if (T* buf = table[i].load(std::memory_order_relaxed)) {
+          detail::alignedFree(buf);
+        }
+      }
+      delete[] table;
+    }
   }
 
   /**
@@ -150,36 +152,88 @@ struct ConcurrentObjectArena {
    * Grow a container
    *
    * This function is thread safe and never invalidates pointers or
-   * references to the rest of the elements. It is lock-free if new elements
-   * can be placed in current buffer. It locks if it allocates a new buffer.
+   * references to the rest of the elements. It is lock-free, including when
+   * new buffers are needed: threads racing to install the same buffer each
+   * allocate one, and all but the winner free theirs.
    * @param delta New size of the container will be <code>delta<\code> elements bigger.
    * @return index of the first element of the allocated group.
    **/
   Index grow_by(const Index delta) {
-    Index newPos;
-    Index oldPos = pos_.load(std::memory_order_relaxed);
+    const Index oldPos = claim(delta);
+    constructObjects(oldPos, oldPos + delta);
+    return oldPos;
+  }
 
-    do {
-      Index curSize = allocatedSize_.load(std::memory_order_acquire);
+  /**
+   * Grow a container, constructing the new elements in parallel.  Useful when a single
+   * large group of non-trivial elements is added at once.  Otherwise as <code>grow_by</code>.
+   *
+   * @param taskSet The task set (e.g. TaskSet or ConcurrentTaskSet) to construct the elements on.
+   * This call waits on it before returning.
+   * @param delta New size of the container will be <code>delta<\code> elements bigger.
+   * @return index of the first element of the allocated group.
+   **/
+  template <typename TaskSetT>
+  Index grow_by(TaskSetT& taskSet, const Index delta) {
+    const Index oldPos = claim(delta);
+    forEachRange(taskSet, oldPos, oldPos + delta, [this](Index begin, Index end) {
+      constructObjects(begin, end);
+    });
+    return oldPos;
+  }
 
-      if (oldPos + delta >= curSize) {
-        const std::lock_guard<std::mutex> guard(resizeMutex_);
-        curSize = allocatedSize_.load(std::memory_order_relaxed);
-        while (oldPos + delta >= curSize) {
-          allocateBuffer();
-          allocatedSize_.store(curSize + kBufferSize, std::memory_order_release);
-          curSize = curSize + kBufferSize;
-        }
+  /**
+   * A per-thread cursor into a <code>ConcurrentObjectArena</code>.  It claims indices from the
+   * arena in blocks and hands them out with plain bump allocation, so the shared insertion point
+   * is only touched once per block.  A Reservation is not itself concurrency safe; give each
+   * thread its own.
+   *
+   * @note Claimed elements are constructed and counted in <code>size()</code> whether or not they
+   * are handed out, so up to a block per Reservation may go unused.
+   **/
+  class Reservation {
+   public:
+    /**
+     * Construct a Reservation.
+     *
+     * @param arena The arena to claim from.
+     * @param blockSize The number of indices to claim at a time.  If 0, the arena's buffer size.
+     **/
+    explicit Reservation(ConcurrentObjectArena& arena, Index blockSize = 0)
+        : arena_(arena), blockSize_(blockSize ? blockSize : arena.kBufferSize) {}
+
+    /**
+     * Claim consecutive elements, as <code>ConcurrentObjectArena::grow_by</code> does.
+     *
+     * @param delta The number of elements.
+     * @return index of the first element of the group.
+     **/
+    Index grow_by(const Index delta) {
+      if (delta > end_ - next_) {
+        const Index claim = std::max(delta, blockSize_);
+        next_ = arena_.grow_by(claim);
+        end_ = next_ + claim;
       }
+      const Index index = next_;
+      next_ += delta;
+      return index;
+    }
 
-      newPos = oldPos + delta;
-    } while (!std::atomic_compare_exchange_weak_explicit(
-        &pos_, &oldPos, newPos, std::memory_order_release, std::memory_order_relaxed));
-
-    constructObjects(oldPos, oldPos + delta);
+    /**
+     * Get the number of claimed elements not yet handed out.
+     *
+     * @return The elements remaining in the current block.
+     **/
+    Index remaining() const {
+      return end_ - next_;
+    }
 
-    return oldPos;
-  }
+   private:
+    ConcurrentObjectArena& arena_;
+    Index blockSize_;
+    Index next_ = 0;
+    Index end_ = 0;
+  };
 
   /**
    * Access an element of the object arena.  Concurrency safe.
@@ -193,7 +247,7 @@ struct ConcurrentObjectArena {
     const Index bufIndex = index >> kLog2BuffSize;
     const Index i = index & kMask;
 
-    return buffers_.load(std::memory_order_relaxed)[bufIndex][i];
+    return getBuffer(bufIndex)[i];
   }
 
   /**
@@ -231,7 +285,7 @@ struct ConcurrentObjectArena {
    * @return The current number of buffers. Note that buffers can be appended concurrently
    **/
   Index numBuffers() const {
-    return buffersPos_;
+    return allocatedSize_.load(std::memory_order_relaxed) >> kLog2BuffSize;
   }
 
   /**
@@ -240,7 +294,7 @@ struct ConcurrentObjectArena {
    * @return The pointer to the buffer.
    **/
   const T* getBuffer(const Index index) const {
-    return buffers_.load(std::memory_order_relaxed)[index];
+    return slot(index).load(std::memory_order_acquire);
   }
 
   /**
@@ -249,7 +303,7 @@ struct ConcurrentObjectArena {
    * @return The pointer to the buffer.
    **/
   T* getBuffer(const Index index) {
-    return buffers_.load(std::memory_order_relaxed)[index];
+    return slot(index).load(std::memory_order_acquire);
   }
 
   /**
@@ -267,6 +321,92 @@ struct ConcurrentObjectArena {
       return pos_.load(std::memory_order_relaxed) - (kBufferSize * (numBuffs - 1));
   }
 
+  /**
+   * A view of the used part of one internal buffer.  The elements are contiguous, so a span can
+   * be processed with ordinary pointer loops.
+   **/
+  template <typename U>
+  struct BasicSpan {
+    /** The first element of the span. **/
+    U* data;
+    /** The number of elements in the span. **/
+    Index size;
+
+    U* begin() const {
+      return data;
+    }
+    U* end() const {
+      return data + size;
+    }
+  };
+
+  using BufferSpan = BasicSpan<T>;
+  using ConstBufferSpan = BasicSpan<const T>;
+
+  /**
+   * Get a view of the used part of a buffer.  Not concurrency safe with growth.  Together with
+   * <code>numBuffers()</code> this allows processing the arena with <code>parallel_for</code>:
+   *
+   * @code
+   * dispenso::parallel_for(0, arena.numBuffers(), [&arena](size_t b) {
+   *   for (Foo& foo : arena.bufferSpan(b)) {
+   *     process(foo);
+   *   }
+   * });
+   * @endcode
+   *
+   * @param index index of the buffer.
+   * @return A span of <code>getBufferSize(index)</code> elements.
+   **/
+  BufferSpan bufferSpan(const Index index) {
+    return {getBuffer(index), getBufferSize(index)};
+  }
+  ConstBufferSpan bufferSpan(const Index index) const {
+    return {getBuffer(index), getBufferSize(index)};
+  }
+
+  /**
+   * Call a functor on every element, in parallel.  Not concurrency safe with growth.
+   *
+   * @param taskSet The task set (e.g. TaskSet or ConcurrentTaskSet) to run on.  This call waits
+   * on it before returning.
+   * @param f A functor with signature <code>void(T&)</code>.
+   **/
+  template <typename TaskSetT, typename F>
+  void parallelForEach(TaskSetT& taskSet, F f) {
+    forEachRange(taskSet, 0, size(), [this, f](Index begin, Index end) {
+      for (Index i = begin; i < end; ++i) {
+        f((*this)[i]);
+      }
+    });
+  }
+
+  /**
+   * Destroy all elements, keeping the buffers for reuse.  This is not concurrency safe.
+   **/
+  void clear() {
+    destroyObjects(0, pos_.load(std::memory_order_relaxed));
+    pos_.store(0, std::memory_order_relaxed);
+  }
+
+  /**
+   * Destroy all elements in parallel, keeping the buffers for reuse.  This is not concurrency
+   * safe with other operations on the arena.  For trivially destructible <code>T</code> this does
+   * not touch <code>taskSet</code>.
+   *
+   * @param taskSet The task set (e.g. TaskSet or ConcurrentTaskSet) to destroy the elements on.
+   * This call waits on it before returning.
+   **/
+  template <typename TaskSetT>
+  void clear(TaskSetT& taskSet) {
+    if (!std::is_trivially_destructible<T>::value) {
+      forEachRange(taskSet, 0, pos_.load(std::memory_order_relaxed), [this](Index b, Index e) {
+        destroyObjects(b, e);
+      });
+    }
+    pos_.store(0, std::memory_order_relaxed);
+  }
+
   /**
    * Swap the contents of containers lhs, and rhs.  This is not concurrency safe.
    * @param lhs object arena to swap
@@ -290,39 +430,125 @@ struct ConcurrentObjectArena {
         lhs.allocatedSize_.load(std::memory_order_relaxed), std::memory_order_relaxed);
     lhs.allocatedSize_.store(rhs_allocatedSize, std::memory_order_relaxed);
 
-    T** const rhs_buffers = rhs.buffers_.load(std::memory_order_relaxed);
-    rhs.buffers_.store(lhs.buffers_.load(std::memory_order_relaxed), std::memory_order_relaxed);
-    lhs.buffers_.store(rhs_buffers, std::memory_order_relaxed);
-
-    swap(lhs.buffersSize_, rhs.buffersSize_);
-    swap(lhs.buffersPos_, rhs.buffersPos_);
-    swap(lhs.deleteLater_, rhs.deleteLater_);
+    for (Index level = 0; level < kMaxLevels; ++level) {
+      std::atomic<T*>* const rhs_table = rhs.levels_[level].load(std::memory_order_relaxed);
+      rhs.levels_[level].store(
+          lhs.levels_[level].load(std::memory_order_relaxed), std::memory_order_relaxed);
+      lhs.levels_[level].store(rhs_table, std::memory_order_relaxed);
+    }
   }
 
  private:
-  void allocateBuffer() {
+  static constexpr Index kMaxLevels = static_cast<Index>(sizeof(Index) * 8);
+
+  // Buffer b lives in level log2(b + 1), which holds 2^level buffer pointers, at slot
+  // b + 1 - 2^level.
+  std::atomic<T*>& slot(const Index bufIndex) const {
+    const Index level = static_cast<Index>(detail::log2(static_cast<uint64_t>(bufIndex) + 1));
+    const Index offset = bufIndex + 1 - (Index{1} << level);
+    return levels_[level].load(std::memory_order_acquire)[offset];
+  }
+
+  std::atomic<T*>& installSlot(const Index bufIndex) {
+    const Index level = static_cast<Index>(detail::log2(static_cast<uint64_t>(bufIndex) + 1));
+    std::atomic<T*>* table = levels_[level].load(std::memory_order_acquire);
+    if (!table) {
+      std::atomic<T*>* fresh = new std::atomic<T*>[size_t{1} << level]();
+      if (levels_[level].compare_exchange_strong(
+              table, fresh, std::memory_order_acq_rel, std::memory_order_acquire)) {
+        table = fresh;
+      } else {
+        delete[] fresh;
+      }
+    }
+    return table[bufIndex + 1 - (Index{1} << level)];
+  }
+
+  void installBuffer(const Index bufIndex) {
+    std::atomic<T*>& s = installSlot(bufIndex);
+    if (s.load(std::memory_order_acquire)) {
+      return;
+    }
     void* ptr = detail::alignedMalloc(kBufferSize * sizeof(T), alignment);
 #if defined(__cpp_exceptions)
     if (ptr == nullptr)
       throw std::bad_alloc();
 #endif // __cpp_exceptions
+    T* expected = nullptr;
+    if (!s.compare_exchange_strong(
+            expected,
+            static_cast<T*>(ptr),
+            std::memory_order_acq_rel,
+            std::memory_order_acquire)) {
+      detail::alignedFree(ptr);
+    }
+  }
 
-    if (buffersPos_ < buffersSize_) {
-      buffers_.load(std::memory_order_relaxed)[buffersPos_++] = static_cast<T*>(ptr);
-    } else {
-      const Index oldBuffersSize = buffersSize_;
-      T** oldBuffers = buffers_.load(std::memory_order_relaxed);
+  Index claim(const Index delta) {
+    Index newPos;
+    Index oldPos = pos_.load(std::memory_order_relaxed);
 
-      buffersSize_ = oldBuffersSize == 0 ? 2 : oldBuffersSize * 2;
-      T** newBuffers = new T*[buffersSize_];
+    do {
+      Index curSize = allocatedSize_.load(std::memory_order_acquire);
 
-      if (oldBuffers != nullptr) {
-        std::memcpy(newBuffers, oldBuffers, sizeof(T*) * oldBuffersSize);
-        deleteLater_.push_back(oldBuffers);
+      while (oldPos + delta >= curSize) {
+        // The buffer is installed before any thread can advance the capacity past it.
+        installBuffer(curSize >> kLog2BuffSize);
+        if (allocatedSize_.compare_exchange_weak(
+                curSize,
+                curSize + kBufferSize,
+                std::memory_order_acq_rel,
+                std::memory_order_acquire)) {
+          curSize += kBufferSize;
+        }
       }
 
-      newBuffers[buffersPos_++] = static_cast<T*>(ptr);
-      buffers_.store(newBuffers, std::memory_order_relaxed);
+      newPos = oldPos + delta;
+    } while (!std::atomic_compare_exchange_weak_explicit(
+        &pos_, &oldPos, newPos, std::memory_order_release, std::memory_order_relaxed));
+
+    return oldPos;
+  }
+
+  // Run f(begin, end) over [beginIndex, endIndex) in pieces of whole buffers, with enough
+  // elements per piece to amortize scheduling.
+  template <typename TaskSetT, typename F>
+  void forEachRange(TaskSetT& taskSet, const Index beginIndex, const Index endIndex, F f) {
+    constexpr Index kMinPiece = 4096;
+    const Index piece = kBufferSize * ((kMinPiece + kBufferSize - 1) / kBufferSize);
+    if (endIndex - beginIndex <= piece) {
+      f(beginIndex, endIndex);
+      return;
+    }
+    Index begin = beginIndex;
+    while (begin < endIndex) {
+      const Index end = std::min(endIndex, (begin + piece) & ~kMask);
+      taskSet.schedule([f, begin, end]() { f(begin, end); });
+      begin = end;
+    }
+    taskSet.wait();
+  }
+
+  void copyObjects(const ConcurrentObjectArena& other, std::true_type /*trivial*/) {
+    const Index numBuffs = numBuffers();
+    for (Index i = 0; i < numBuffs; ++i) {
+      std::memcpy(getBuffer(i), other.getBuffer(i), kBufferSize * sizeof(T));
+    }
+  }
+
+  void copyObjects(const ConcurrentObjectArena& other, std::false_type /*trivial*/) {
+    const Index end = pos_.load(std::memory_order_relaxed);
+    for (Index i = 0; i < end; ++i) {
+      new (&(*this)[i]) T(other[i]);
+    }
+  }
+
+  void destroyObjects(const Index beginIndex, const Index endIndex) {
+    if (std::is_trivially_destructible<T>::value) {
+      return;
+    }
+    for (Index i = beginIndex; i < endIndex; ++i) {
+      (*this)[i].~T();
     }
   }
 
@@ -332,7 +558,7 @@ struct ConcurrentObjectArena {
 
     Index bufStart = beginIndex & kMask;
     for (Index b = startBuffer; b <= endBuffer; ++b) {
-      T* buf = buffers_.load(std::memory_order_relaxed)[b];
+      T* buf = getBuffer(b);
       const Index bufEnd = b == endBuffer ? (endIndex & kMask) : kBufferSize;
       for (Index i = bufStart; i < bufEnd; ++i)
         new (buf + i) T();
@@ -346,8 +572,6 @@ struct ConcurrentObjectArena {
   //                ──┬──
   //                  └─number of 1s is log2BuffSize
   //
-  std::mutex resizeMutex_;
-
   Index kLog2BuffSize;
   Index kBufferSize;
   Index kMask;
@@ -355,10 +579,10 @@ struct ConcurrentObjectArena {
   std::atomic<Index> pos_;
   std::atomic<Index> allocatedSize_;
 
-  std::atomic<T**> buffers_;
-  Index buffersSize_;
-  Index buffersPos_;
-  std::vector<T**> deleteLater_;
+  std::atomic<std::atomic<T*>*> levels_[kMaxLevels] = {};
 };
 
+template <class T, class Index, size_t alignment>
+constexpr Index ConcurrentObjectArena<T, Index, alignment>::kMaxLevels;
+
 } // namespace dispenso
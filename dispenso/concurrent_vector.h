@@ -12,10 +12,11 @@
  * an array of buffers that grow by powers of two.  The interface is intended to be a reasonably
  * complete standin for both std::vector and tbb::concurrent_vector.  When compared to std::vector,
  * it is missing only the .data() accessor, because it is not possible to access the contents as a
- * contiguous buffer.  The interface is also compatible with TBB's concurrent_vector, but provides
- * slightly more functionality to be compatible with std::vector (e.g. .insert() and .erase()), and
- * also to enable higher performance without requiring double-initialization in some grow_by cases
- * (via .grow_by_generator()).  ConcurrentVector also has a reserving Constructor that can allow for
+ * contiguous buffer (.segments() instead provides each contiguous bucket).  The interface is also
+ * compatible with TBB's concurrent_vector, but provides slightly more functionality to be
+ * compatible with std::vector (e.g. .insert() and .erase()), and also to enable higher performance
+ * without requiring double-initialization in some grow_by cases (via
+ * .grow_by_generator()).  ConcurrentVector also has a reserving Constructor that can allow for
  * better performance when the size (or maximum size, or even a guess at the size) is known ahead of
  * time.
  *
@@ -50,9 +51,15 @@
 #include <cstring>
 #include <initializer_list>
 #include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 #include <dispenso/detail/math.h>
+#include <dispenso/huge_pages.h>
+#include <dispenso/parallel_for.h>
 #include <dispenso/platform.h>
+#include <dispenso/task_set.h>
 
 namespace dispenso {
 
@@ -76,6 +83,51 @@ struct ReserveTagS {};
  **/
 constexpr ReserveTagS ReserveTag;
 
+/**
+ * The default allocator for ConcurrentVector buckets.  Custom allocators, e.g. for NUMA-local or
+ * arena memory, or to account for memory, supply the same two static functions through the
+ * <code>Allocator</code> member of the vector's traits.  Each vector calls them directly, with no
+ * allocator object, so allocators that need state must reach it statically.
+ **/
+struct DefaultConcurrentVectorAllocator {
+  /**
+   * Allocate memory for one or more buckets.
+   *
+   * @param bytes The number of bytes to allocate.
+   * @param alignment The alignment required, the alignment of the element type.
+   *
+   * @return The allocated memory.
+   **/
+  static void* alloc(size_t bytes, size_t alignment) {
+    return detail::alignedMalloc(bytes, alignment);
+  }
+
+  /**
+   * Free memory from <code>alloc</code>.
+   *
+   * @param ptr The pointer returned by <code>alloc</code>.
+   **/
+  static void dealloc(void* ptr) {
+    detail::alignedFree(ptr);
+  }
+};
+
+/**
+ * A ConcurrentVector bucket allocator taking memory from <code>hugePageAlloc</code>.  This is the
+ * allocator used for traits that set <code>kUseHugePages</code>.
+ **/
+struct HugePageConcurrentVectorAllocator {
+  static void* alloc(size_t bytes, size_t alignment) {
+    assert(alignment <= kHugePageMinAlignment);
+    (void)alignment;
+    return hugePageAlloc(bytes);
+  }
+
+  static void dealloc(void* ptr) {
+    hugePageFree(ptr);
+  }
+};
+
 // Textual inclusion.  Includes undocumented implementation details, e.g. iterators.
 #include <dispenso/detail/concurrent_vector_impl.h>
 
@@ -102,8 +154,13 @@ struct DefaultConcurrentVectorSizeTraits {
 };
 
 /**
- * The default ConcurrentVector traits type.  All members are required should one wish to supply a
- * custom set of traits.
+ * The default ConcurrentVector traits type.  All members but kUseHugePages are required should one
+ * wish to supply a custom set of traits.
+ *
+ * Custom traits may also name an allocator for the vector's buckets, as a member type
+ * <code>Allocator</code> with the static functions of DefaultConcurrentVectorAllocator.  It takes
+ * precedence over kUseHugePages.  Without one, buckets come from DefaultConcurrentVectorAllocator,
+ * or HugePageConcurrentVectorAllocator if kUseHugePages is set.
  **/
 struct DefaultConcurrentVectorTraits {
   /**
@@ -138,6 +195,15 @@ struct DefaultConcurrentVectorTraits {
    *
    **/
   static constexpr bool kIteratorPreferSpeed = true;
+
+  /**
+   * @brief Should buckets be allocated with hugePageAlloc.
+   *
+   * Large vectors that are accessed all over can spend much of their time on TLB misses, which huge
+   * pages reduce.  Only buckets of at least <code>hugePageSize()</code> bytes get huge pages, so
+   * small vectors are unaffected.
+   **/
+  static constexpr bool kUseHugePages = false;
 };
 
 /**
@@ -170,6 +236,10 @@ class ConcurrentVector {
       cv::CompactCVecIterator<ConcurrentVector<T, Traits>, T, true>>;
   using reverse_iterator = std::reverse_iterator<iterator>;
   using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+  using segment = cv::Segment<T>;
+  using const_segment = cv::Segment<const T>;
+  using segments_view = cv::SegmentsView<ConcurrentVector, T>;
+  using const_segments_view = cv::SegmentsView<ConcurrentVector, const T>;
 
   /**
    * Default construct the ConcurrentVector.
@@ -185,7 +255,7 @@ class ConcurrentVector {
       : firstBucketShift_(detail::log2(
             detail::nextPow2(std::max(startCapacity, SizeTraits::kDefaultCapacity / 2)))),
         firstBucketLen_(size_type{1} << firstBucketShift_) {
-    T* firstTwo = cv::alloc<T>(2 * firstBucketLen_);
+    T* firstTwo = cv::allocBucket<T, BucketAllocator>(2 * firstBucketLen_);
     buffers_[0].store(firstTwo, std::memory_order_release);
     buffers_[1].store(firstTwo + firstBucketLen_, std::memory_order_release);
   }
@@ -213,6 +283,34 @@ class ConcurrentVector {
     }
   }
 
+  /**
+   * Sizing constructor with default initialization, constructing the elements in parallel.
+   *
+   * @param startSize The number of elements.
+   * @param tasks The TaskSet to construct the elements with.  This waits on <code>tasks</code>.
+   **/
+  ConcurrentVector(size_t startSize, TaskSet& tasks) : ConcurrentVector(startSize, ReserveTag) {
+    size_.store(startSize, std::memory_order_relaxed);
+    parallelForRuns(tasks, 0, startSize, [](T* elts, size_t len, size_t) {
+      for (size_t i = 0; i < len; ++i) {
+        new (elts + i) T();
+      }
+    });
+  }
+
+  /**
+   * Sizing constructor with specified default value, constructing the elements in parallel.
+   *
+   * @param startSize The number of elements.
+   * @param defaultValue The value to copy into each element.
+   * @param tasks The TaskSet to construct the elements with.  This waits on <code>tasks</code>.
+   **/
+  ConcurrentVector(size_t startSize, const T& defaultValue, TaskSet& tasks)
+      : ConcurrentVector(startSize, ReserveTag) {
+    size_.store(startSize, std::memory_order_relaxed);
+    parallelFillN(tasks, 0, startSize, defaultValue);
+  }
+
   /**
    * Constructor taking an iterator range.
    **/
@@ -256,7 +354,7 @@ class ConcurrentVector {
     other.size_.store(0, std::memory_order_relaxed);
     // This is possibly unnecessary overhead, but enables the "other" vector to be in a valid,
     // usable state right away, no empty check or clear required, as it is for std::vector.
-    T* firstTwo = cv::alloc<T>(2 * firstBucketLen_);
+    T* firstTwo = cv::allocBucket<T, BucketAllocator>(2 * firstBucketLen_);
     other.buffers_[0].store(firstTwo, std::memory_order_relaxed);
     other.buffers_[1].store(firstTwo + firstBucketLen_, std::memory_order_relaxed);
   }
@@ -381,6 +479,43 @@ class ConcurrentVector {
     }
   }
 
+  /**
+   * Resize the vector, using default initialization for any new values.  New elements are
+   * constructed, or removed elements destroyed, in parallel.  Not concurrency safe.
+   *
+   * @param len The length of the vector after the resize.
+   * @param tasks The TaskSet to construct or destroy elements with.  This waits on
+   * <code>tasks</code>.
+   **/
+  void resize(difference_type len, TaskSet& tasks) {
+    difference_type curLen = static_cast<difference_type>(size_.load(std::memory_order_relaxed));
+    if (curLen < len) {
+      grow_by(len - curLen, tasks);
+    } else if (curLen > len) {
+      parallelDestroy(tasks, len, curLen);
+      size_.store(len, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * Resize the vector, copying the provided value into any new elements.  New elements are
+   * constructed, or removed elements destroyed, in parallel.  Not concurrency safe.
+   *
+   * @param len The length of the vector after the resize.
+   * @param value The value to copy into any new elements.
+   * @param tasks The TaskSet to construct or destroy elements with.  This waits on
+   * <code>tasks</code>.
+   **/
+  void resize(difference_type len, const T& value, TaskSet& tasks) {
+    difference_type curLen = static_cast<difference_type>(size_.load(std::memory_order_relaxed));
+    if (curLen < len) {
+      grow_by(len - curLen, value, tasks);
+    } else if (curLen > len) {
+      parallelDestroy(tasks, len, curLen);
+      size_.store(len, std::memory_order_relaxed);
+    }
+  }
+
   /**
    * The default capacity of this vector.
    * @return The capacity if the vector were cleared and then called shrink_to_fit.
@@ -427,6 +562,18 @@ class ConcurrentVector {
     size_.store(0, std::memory_order_release);
   }
 
+  /**
+   * Clear the vector, destructing the elements in parallel.  Calling this before destruction also
+   * makes destruction of a large vector parallel, since the destructor then has nothing left to
+   * destruct.  Not concurrency safe.
+   *
+   * @param tasks The TaskSet to destruct elements with.  This waits on <code>tasks</code>.
+   **/
+  void clear(TaskSet& tasks) {
+    parallelDestroy(tasks, 0, size_.load(std::memory_order_relaxed));
+    size_.store(0, std::memory_order_release);
+  }
+
   /**
    * Gets rid of extra capacity that is not needed to maintain preconditions.  At least the default
    * capacity will remain, even if the size of the vector is zero.  Not concurrency safe.
@@ -444,7 +591,7 @@ class ConcurrentVector {
         break;
       }
       if (buffers_.shouldDealloc(b)) {
-        cv::dealloc<T>(ptr);
+        cv::deallocBucket<T, BucketAllocator>(ptr);
       }
       buffers_[b].store(nullptr, std::memory_order_release);
     }
@@ -456,7 +603,7 @@ class ConcurrentVector {
   ~ConcurrentVector() {
     clear();
     shrink_to_fit();
-    cv::dealloc<T>(buffers_[0].load(std::memory_order_acquire));
+    cv::deallocBucket<T, BucketAllocator>(buffers_[0].load(std::memory_order_acquire));
   }
 
   /**
@@ -637,6 +784,55 @@ class ConcurrentVector {
     return ret;
   }
 
+  /**
+   * Grow the vector, constructing new elements in parallel via a generator.  Concurrency safe.
+   * @param delta The number of elements to grow by.
+   * @param gen The generator to use to construct new elements.  Must have
+   * operator()(size_type index) and return a valid T, where index is the position within the grown
+   * range.  It may be called concurrently, and in any order.
+   * @param tasks The TaskSet to construct the elements with.  This waits on <code>tasks</code>.
+   * @return The iterator to the start of the grown range.
+   **/
+  template <typename Gen>
+  iterator grow_by_generator(size_type delta, Gen gen, TaskSet& tasks) {
+    size_type start = growByUninitializedIndex(delta);
+    parallelForRuns(tasks, start, start + delta, [&gen, start](T* elts, size_t len, size_t index) {
+      for (size_t i = 0; i < len; ++i) {
+        new (elts + i) T(gen(index - start + i));
+      }
+    });
+    return {this, start, bucketAndSubIndex(start)};
+  }
+
+  /**
+   * Grow the vector, copying the provided value into new elements in parallel.  Concurrency safe.
+   * @param delta The number of elements to grow by.
+   * @param t The value to copy into all new elements.
+   * @param tasks The TaskSet to construct the elements with.  This waits on <code>tasks</code>.
+   * @return The iterator to the start of the grown range.
+   **/
+  iterator grow_by(size_type delta, const T& t, TaskSet& tasks) {
+    size_type start = growByUninitializedIndex(delta);
+    parallelFillN(tasks, start, delta, t);
+    return {this, start, bucketAndSubIndex(start)};
+  }
+
+  /**
+   * Grow the vector, default initializing new elements in parallel.  Concurrency safe.
+   * @param delta The number of elements to grow by.
+   * @param tasks The TaskSet to construct the elements with.  This waits on <code>tasks</code>.
+   * @return The iterator to the start of the grown range.
+   **/
+  iterator grow_by(size_type delta, TaskSet& tasks) {
+    size_type start = growByUninitializedIndex(delta);
+    parallelForRuns(tasks, start, start + delta, [](T* elts, size_t len, size_t) {
+      for (size_t i = 0; i < len; ++i) {
+        new (elts + i) T();
+      }
+    });
+    return {this, start, bucketAndSubIndex(start)};
+  }
+
   /**
    * Grow the vector, copying the provided value into new elements.  Concurrency safe.
    * @param delta The number of elements to grow by.
@@ -907,6 +1103,95 @@ class ConcurrentVector {
     return const_reverse_iterator(cbegin());
   }
 
+  /**
+   * Get a view of the vector's storage as a range of contiguous segments, one per bucket, in
+   * element order.  Concurrency safe.  Each segment is a pointer and a length, so that loops over
+   * a segment can be vectorized, which loops over iterators generally can not be.
+   * <code>for (auto seg : vec.segments()) { for (auto& v : seg) { ... } }</code>
+   *
+   * @return A view covering the elements in the vector at the time of the call.  Elements appended
+   * concurrently are not included, but the segments remain valid as the vector grows.
+   **/
+  segments_view segments() {
+    return {this, size_.load(std::memory_order_relaxed)};
+  }
+
+  /**
+   * Get a view of the vector's storage as a range of contiguous segments, one per bucket, in
+   * element order.  Concurrency safe.
+   *
+   * @return A view covering the elements in the vector at the time of the call.
+   **/
+  const_segments_view segments() const {
+    return {this, size_.load(std::memory_order_relaxed)};
+  }
+
+  /**
+   * Copy the elements, in order, into contiguous storage, in parallel.  Each thread copies a run of
+   * whole segments, with <code>memcpy</code> for trivially copyable types, so the copy is limited
+   * by memory bandwidth.  Must not be called concurrently with modifications of existing elements;
+   * elements appended concurrently are not copied.
+   *
+   * @param out The destination, holding at least <code>size()</code> constructed elements, which
+   * are assigned to.  For trivially copyable types it may be uninitialized.
+   * @param tasks The TaskSet to copy with.  This waits on <code>tasks</code>.
+   **/
+  void copyToContiguous(T* out, TaskSet& tasks) const {
+    transferToContiguous(segments(), out, tasks, [](const T* first, const T* last, T* dst) {
+      std::copy(first, last, dst);
+    });
+  }
+
+  /**
+   * Copy the elements, in order, into contiguous storage, in parallel on the global thread pool.
+   * See the overload taking a TaskSet.
+   *
+   * @param out The destination, holding at least <code>size()</code> elements.
+   **/
+  void copyToContiguous(T* out) const {
+    TaskSet tasks(globalThreadPool());
+    copyToContiguous(out, tasks);
+  }
+
+  /**
+   * Move the elements, in order, into contiguous storage, in parallel.  The vector's elements are
+   * left in a moved-from state, and its size is unchanged.  Not concurrency safe.
+   *
+   * @param out The destination, holding at least <code>size()</code> constructed elements, which
+   * are move assigned to.  For trivially copyable types it may be uninitialized.
+   * @param tasks The TaskSet to move with.  This waits on <code>tasks</code>.
+   **/
+  void moveToContiguous(T* out, TaskSet& tasks) {
+    transferToContiguous(segments(), out, tasks, [](T* first, T* last, T* dst) {
+      std::move(first, last, dst);
+    });
+  }
+
+  /**
+   * Copy the elements, in order, into a new <code>std::vector</code>, in parallel.  Requires
+   * <code>T</code> to be default constructible.
+   *
+   * @param tasks The TaskSet to copy with.  This waits on <code>tasks</code>.
+   *
+   * @return A vector holding a copy of each element.
+   **/
+  std::vector<T> toVector(TaskSet& tasks) const {
+    std::vector<T> result(size());
+    copyToContiguous(result.data(), tasks);
+    return result;
+  }
+
+  /**
+   * Copy the elements, in order, into a new <code>std::vector</code>, in parallel on the global
+   * thread pool.  Requires <code>T</code> to be default constructible.
+   *
+   * @return A vector holding a copy of each element.
+   **/
+  std::vector<T> toVector() const {
+    TaskSet tasks(globalThreadPool());
+    return toVector(tasks);
+  }
+
   /**
    * Checks if the vector contains any elements. Concurrency safe.
    * @return true if the vector contains no elements, false otherwise.  Note that an element could
@@ -985,6 +1270,42 @@ class ConcurrentVector {
   }
 
  private:
+  using BucketAllocator = typename cv::BucketAllocatorFor<Traits>::type;
+  static_assert(
+      !std::is_same<BucketAllocator, HugePageConcurrentVectorAllocator>::value ||
+          alignof(T) <= kHugePageMinAlignment,
+      "Huge page buckets cannot hold types this overaligned");
+
+  // Splits the elements covered by segs into runs of at least kMinTransferBytes, and calls
+  // transfer(first, last, dst) on each bucket-contiguous piece, in parallel.  Trivially copyable
+  // elements are memcpy'd instead.
+  template <typename SegmentsT, typename Transfer>
+  static void
+  transferToContiguous(const SegmentsT& segs, T* out, TaskSet& tasks, Transfer transfer) {
+    constexpr size_t kMinTransferBytes = 64 * 1024;
+    ParForOptions options;
+    options.minItemsPerChunk =
+        static_cast<uint32_t>(std::max<size_t>(1, kMinTransferBytes / sizeof(T)));
+    parallel_for(
+        tasks,
+        makeChunkedRange(size_t{0}, segs.numElements(), ParForChunking::kStatic),
+        [&segs, out, transfer](size_t start, size_t end) {
+          T* dst = out + start;
+          segs.forEachRun(start, end, [&dst, transfer](auto seg) {
+            if (std::is_trivially_copyable<T>::value) {
+              std::memcpy(
+                  static_cast<void*>(dst),
+                  static_cast<const void*>(seg.data()),
+                  seg.size() * sizeof(T));
+            } else {
+              transfer(seg.begin(), seg.end(), dst);
+            }
+            dst += seg.size();
+          });
+        },
+        options);
+  }
+
   DISPENSO_INLINE cv::BucketInfo bucketAndSubIndexForIndex(size_t index) const {
 #if defined(__clang__)
     if (index < firstBucketLen_) {
@@ -1036,11 +1357,52 @@ class ConcurrentVector {
     }
   }
 
+  // Call f(elements, length, index) on each contiguous run of elements in [start, end), as a task
+  // in tasks, and wait.  Runs never span buckets, so that elements are addressed directly, and are
+  // capped in length so that large buckets are split to balance.  New buckets are first touched
+  // by the threads that construct into them.
+  template <typename F>
+  void parallelForRuns(TaskSet& tasks, size_t start, size_t end, F f) {
+    constexpr size_t kMaxRunLen = std::max<size_t>(1, (size_t{1} << 16) / sizeof(T));
+    while (start < end) {
+      auto binfo = bucketAndSubIndex(start);
+      size_t len =
+          std::min({binfo.bucketCapacity - binfo.bucketIndex, end - start, kMaxRunLen});
+      T* elts = buffers_[binfo.bucket].load(std::memory_order_relaxed) + binfo.bucketIndex;
+      tasks.schedule([&f, elts, len, start]() { f(elts, len, start); });
+      start += len;
+    }
+    tasks.wait();
+  }
+
+  void parallelFillN(TaskSet& tasks, size_t start, size_t len, const T& value) {
+    parallelForRuns(tasks, start, start + len, [&value](T* elts, size_t runLen, size_t) {
+      for (size_t i = 0; i < runLen; ++i) {
+        new (elts + i) T(value);
+      }
+    });
+  }
+
+  void parallelDestroy(TaskSet& tasks, size_t start, size_t end) {
+    if (std::is_trivially_destructible<T>::value) {
+      return;
+    }
+    parallelForRuns(tasks, start, end, [](T* elts, size_t len, size_t) {
+      for (size_t i = 0; i < len; ++i) {
+        elts[i].~T();
+      }
+    });
+  }
+
   iterator growByUninitialized(size_type delta) {
+    auto index = growByUninitializedIndex(delta);
+    return {this, index, bucketAndSubIndex(index)};
+  }
+
+  size_type growByUninitializedIndex(size_type delta) {
     auto index = size_.fetch_add(delta, std::memory_order_relaxed);
-    auto binfo = bucketAndSubIndex(index);
-    buffers_.allocAsNecessary(binfo, delta, bucketAndSubIndex(index + delta));
-    return {this, index, binfo};
+    buffers_.allocAsNecessary(bucketAndSubIndex(index), delta, bucketAndSubIndex(index + delta));
+    return index;
   }
 
   iterator insertPartial(const_iterator pos) {
@@ -1068,7 +1430,8 @@ class ConcurrentVector {
       SizeTraits::kDefaultCapacity / 2,
       SizeTraits::kMaxVectorSize,
       Traits::kPreferBuffersInline,
-      Traits::kReallocStrategy> buffers_;
+      Traits::kReallocStrategy,
+      BucketAllocator> buffers_;
   static constexpr size_t kMaxBuffers = decltype(buffers_)::kMaxBuffers;
 
   size_t firstBucketShift_;
@@ -1079,6 +1442,8 @@ class ConcurrentVector {
   friend class cv::ConVecIterBase<ConcurrentVector<T, Traits>, T>;
   friend class cv::ConcurrentVectorIterator<ConcurrentVector<T, Traits>, T, false>;
   friend class cv::ConcurrentVectorIterator<ConcurrentVector<T, Traits>, T, true>;
+  friend class cv::SegmentsView<ConcurrentVector, T>;
+  friend class cv::SegmentsView<ConcurrentVector, const T>;
 };
 
 template <typename T, class Traits1, class Traits2>
@@ -1128,6 +1493,53 @@ inline void swap(ConcurrentVector<T, Traits>& a, ConcurrentVector<T, Traits>& b)
   a.swap(b);
 }
 
+/**
+ * Execute a loop over the segments of a ConcurrentVector in parallel.  The elements are chunked as
+ * for <code>parallel_for</code> over an index range, and each chunk is passed to <code>f</code>
+ * as one or more contiguous segments, split where the chunk crosses a bucket boundary.
+ *
+ * @param taskSet The task set to schedule the loop on.
+ * @param segments The segments to loop over, e.g. from <code>vec.segments()</code>.
+ * @param f The functor to execute in parallel.  Must have a signature like
+ * <code>void(cv::Segment<T> segment)</code>.
+ * @param options See ParForOptions for details.
+ **/
+template <typename TaskSetT, typename VecT, typename T, typename F>
+void parallel_for(
+    TaskSetT& taskSet,
+    const cv::SegmentsView<VecT, T>& segments,
+    F&& f,
+    ParForOptions options = {}) {
+  auto range = makeChunkedRange(size_t{0}, segments.numElements(), options.defaultChunking);
+  parallel_for(
+      taskSet,
+      range,
+      [segments, f = std::forward<F>(f)](size_t start, size_t end) {
+        segments.forEachRun(start, end, f);
+      },
+      options);
+}
+
+/**
+ * Execute a loop over the segments of a ConcurrentVector in parallel on the global thread pool,
+ * and wait until complete.
+ *
+ * @param segments The segments to loop over, e.g. from <code>vec.segments()</code>.
+ * @param f The functor to execute in parallel.  Must have a signature like
+ * <code>void(cv::Segment<T> segment)</code>.
+ * @param options See ParForOptions for details.  <code>options.wait</code> will always be reset
+ * to true.
+ **/
+template <typename VecT, typename T, typename F>
+void parallel_for(
+    const cv::SegmentsView<VecT, T>& segments,
+    F&& f,
+    ParForOptions options = {}) {
+  TaskSet taskSet(globalThreadPool());
+  options.wait = true;
+  parallel_for(taskSet, segments, std::forward<F>(f), options);
+}
+
 // Textual inclusion.  Includes undocumented implementation details, e.g. iterators.
 #include <dispenso/detail/concurrent_vector_impl2.h>
 
@@ -0,0 +1,435 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file coroutine.h
+ * C++20 coroutine support: a lazy <code>Task<T></code> coroutine type, an awaitable for moving a
+ * coroutine onto a thread pool or task set, and <code>co_await</code> for <code>Future</code>s.
+ * Suspended coroutines do not occupy a thread; they are resumed by scheduling onto a pool's queue.
+ * When compiled as C++17 or earlier, this header provides nothing.
+ **/
+
+#pragma once
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#define DISPENSO_HAS_COROUTINES 1
+
+#include <algorithm>
+#include <coroutine>
+#include <exception>
+#include <type_traits>
+#include <utility>
+
+#include <dispenso/completion_event.h>
+#include <dispenso/detail/math.h>
+#include <dispenso/future.h>
+#include <dispenso/small_buffer_allocator.h>
+
+namespace dispenso {
+
+namespace detail {
+
+// Coroutine frames are allocated from the small buffer pools when they fit, and the size is passed
+// back to the sized operator delete to find the pool again.
+inline size_t coroutineFrameBlockSize(size_t size) {
+  return static_cast<size_t>(nextPow2(std::max<size_t>(size, 16)));
+}
+
+inline void* allocCoroutineFrame(size_t size) {
+#if !defined(DISPENSO_NO_SMALL_BUFFER_ALLOCATOR)
+  size_t blockSize = coroutineFrameBlockSize(size);
+  if (blockSize <= kMaxSmallBufferSize) {
+    return allocSmallBufferImpl(log2(blockSize) - 3);
+  }
+#endif // DISPENSO_NO_SMALL_BUFFER_ALLOCATOR
+  return alignedMalloc(size, alignof(std::max_align_t));
+}
+
+inline void deallocCoroutineFrame(void* ptr, size_t size) {
+#if !defined(DISPENSO_NO_SMALL_BUFFER_ALLOCATOR)
+  size_t blockSize = coroutineFrameBlockSize(size);
+  if (blockSize <= kMaxSmallBufferSize) {
+    deallocSmallBufferImpl(log2(blockSize) - 3, ptr);
+    return;
+  }
+#endif // DISPENSO_NO_SMALL_BUFFER_ALLOCATOR
+  alignedFree(ptr);
+}
+
+class TaskPromiseBase {
+ public:
+  static void* operator new(size_t size) {
+    return allocCoroutineFrame(size);
+  }
+
+  static void operator delete(void* ptr, size_t size) {
+    deallocCoroutineFrame(ptr, size);
+  }
+
+  std::suspend_always initial_suspend() noexcept {
+    return {};
+  }
+
+  // On completion, transfer straight to whoever awaited the task, signal a blocked syncWait, or
+  // free a detached task.
+  struct FinalAwaiter {
+    bool await_ready() noexcept {
+      return false;
+    }
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept {
+      TaskPromiseBase& promise = h.promise();
+      if (promise.continuation_) {
+        return promise.continuation_;
+      }
+      if (promise.done_) {
+        promise.done_->notify();
+      } else if (promise.detached_) {
+        h.destroy();
+      }
+      return std::noop_coroutine();
+    }
+    void await_resume() noexcept {}
+  };
+
+  FinalAwaiter final_suspend() noexcept {
+    return {};
+  }
+
+  void unhandled_exception() {
+#if defined(__cpp_exceptions)
+    if (detached_) {
+      // As with std::thread, there is nobody to receive the exception.
+      std::terminate();
+    }
+    exception_ = std::current_exception();
+#else
+    std::terminate();
+#endif // __cpp_exceptions
+  }
+
+  void setContinuation(std::coroutine_handle<> continuation) {
+    continuation_ = continuation;
+  }
+
+  void setDoneEvent(CompletionEvent* done) {
+    done_ = done;
+  }
+
+  void setDetached() {
+    detached_ = true;
+  }
+
+ protected:
+  void rethrowIfException() {
+#if defined(__cpp_exceptions)
+    if (exception_) {
+      std::rethrow_exception(exception_);
+    }
+#endif // __cpp_exceptions
+  }
+
+ private:
+  std::coroutine_handle<> continuation_;
+  CompletionEvent* done_ = nullptr;
+  bool detached_ = false;
+#if defined(__cpp_exceptions)
+  std::exception_ptr exception_;
+#endif // __cpp_exceptions
+};
+
+} // namespace detail
+
+/**
+ * A lazily started coroutine producing a <code>T</code>.  The coroutine body does not begin until
+ * the task is awaited (or passed to <code>syncWait</code>), and it runs on the awaiting thread
+ * until it suspends; use <code>co_await scheduleOn(pool)</code> to move it onto a pool.  When the
+ * body finishes, the awaiting coroutine is resumed directly, without going through a queue.
+ * Coroutine frames are allocated from dispenso's small buffer pools when small enough.
+ *
+ * Tasks are move-only, and may be awaited once.
+ **/
+template <typename T = void>
+class Task {
+ public:
+  class promise_type : public detail::TaskPromiseBase {
+   public:
+    Task get_return_object() {
+      return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+
+    template <typename U>
+    void return_value(U&& value) {
+      new (static_cast<void*>(resultBuf_)) T(std::forward<U>(value));
+      hasResult_ = true;
+    }
+
+    T takeResult() {
+      rethrowIfException();
+      return std::move(*reinterpret_cast<T*>(resultBuf_));
+    }
+
+    ~promise_type() {
+      if (hasResult_) {
+        reinterpret_cast<T*>(resultBuf_)->~T();
+      }
+    }
+
+   private:
+    alignas(T) char resultBuf_[sizeof(T)];
+    bool hasResult_ = false;
+  };
+
+  Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+
+  Task& operator=(Task&& other) noexcept {
+    if (this != &other) {
+      reset();
+      handle_ = std::exchange(other.handle_, nullptr);
+    }
+    return *this;
+  }
+
+  ~Task() {
+    reset();
+  }
+
+  /**
+   * Start the task, suspending the awaiting coroutine until the task completes.
+   *
+   * @return The value the task's coroutine returned.
+   **/
+  auto operator co_await() && noexcept {
+    struct Awaiter {
+      bool await_ready() noexcept {
+        return false;
+      }
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle.promise().setContinuation(awaiting);
+        return handle;
+      }
+      T await_resume() {
+        return handle.promise().takeResult();
+      }
+      std::coroutine_handle<promise_type> handle;
+    };
+    return Awaiter{handle_};
+  }
+
+ private:
+  explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+  void reset() {
+    if (handle_) {
+      handle_.destroy();
+      handle_ = nullptr;
+    }
+  }
+
+  std::coroutine_handle<promise_type> handle_;
+
+  template <typename U>
+  friend U syncWait(Task<U>&&);
+};
+
+/**
+ * A lazily started coroutine producing no value.  See <code>Task<T></code>.
+ **/
+template <>
+class Task<void> {
+ public:
+  class promise_type : public detail::TaskPromiseBase {
+   public:
+    Task get_return_object() {
+      return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+
+    void return_void() {}
+
+    void takeResult() {
+      rethrowIfException();
+    }
+  };
+
+  Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+
+  Task& operator=(Task&& other) noexcept {
+    if (this != &other) {
+      reset();
+      handle_ = std::exchange(other.handle_, nullptr);
+    }
+    return *this;
+  }
+
+  ~Task() {
+    reset();
+  }
+
+  /**
+   * Start the task, suspending the awaiting coroutine until the task completes.
+   **/
+  auto operator co_await() && noexcept {
+    struct Awaiter {
+      bool await_ready() noexcept {
+        return false;
+      }
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle.promise().setContinuation(awaiting);
+        return handle;
+      }
+      void await_resume() {
+        handle.promise().takeResult();
+      }
+      std::coroutine_handle<promise_type> handle;
+    };
+    return Awaiter{handle_};
+  }
+
+ private:
+  explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+  void reset() {
+    if (handle_) {
+      handle_.destroy();
+      handle_ = nullptr;
+    }
+  }
+
+  std::coroutine_handle<promise_type> handle_;
+
+  template <typename U>
+  friend U syncWait(Task<U>&&);
+  friend void startDetached(Task<void>&&);
+};
+
+/**
+ * Run a task from non-coroutine code, blocking the calling thread until it completes.  The task
+ * starts on the calling thread.
+ *
+ * @param task The task to run.
+ * @return The value the task's coroutine returned.
+ **/
+template <typename T>
+T syncWait(Task<T>&& task) {
+  CompletionEvent done;
+  task.handle_.promise().setDoneEvent(&done);
+  task.handle_.resume();
+  done.wait();
+  return task.handle_.promise().takeResult();
+}
+
+/**
+ * Start a task without waiting for it; its frame is freed when it completes.  This is the way to
+ * launch many concurrent coroutines, e.g. request handlers, each of which typically begins with
+ * <code>co_await scheduleOn(pool)</code>.  An exception escaping a detached task terminates the
+ * program.
+ *
+ * @param task The task to start.  It runs on the calling thread until it first suspends.
+ **/
+inline void startDetached(Task<void>&& task) {
+  auto handle = std::exchange(task.handle_, nullptr);
+  handle.promise().setDetached();
+  handle.resume();
+}
+
+/**
+ * An awaitable that suspends the awaiting coroutine and resumes it as a task on a pool or task set.
+ * Obtain one through <code>scheduleOn</code>.
+ **/
+template <typename Schedulable>
+class ScheduleOnAwaiter {
+ public:
+  explicit ScheduleOnAwaiter(Schedulable& sched) : sched_(sched) {}
+
+  bool await_ready() const noexcept {
+    return false;
+  }
+
+  void await_suspend(std::coroutine_handle<> h) {
+    sched_.schedule([h]() { h.resume(); }, ForceQueuingTag());
+  }
+
+  void await_resume() const noexcept {}
+
+ private:
+  Schedulable& sched_;
+};
+
+/**
+ * Move the awaiting coroutine onto a ThreadPool, TaskSet or ConcurrentTaskSet:
+ * <code>co_await dispenso::scheduleOn(pool);</code>.  The rest of the coroutine, up to its next
+ * suspension, is run as a task queued on <code>sched</code>.  When resumed through a task set,
+ * waiting on the task set waits for that portion of the coroutine.
+ *
+ * @param sched The pool or task set to resume on.  It must outlive the suspension.
+ * @return An awaitable.
+ **/
+template <typename Schedulable>
+ScheduleOnAwaiter<Schedulable> scheduleOn(Schedulable& sched) {
+  return ScheduleOnAwaiter<Schedulable>(sched);
+}
+
+/**
+ * An awaitable for a Future, resuming the awaiting coroutine on a pool once the future is ready.
+ * Obtain one through <code>co_await future</code>, which resumes on the global thread pool, or
+ * <code>resumeOn</code>.
+ **/
+template <typename Result, typename Schedulable>
+class FutureAwaiter {
+ public:
+  FutureAwaiter(Future<Result> future, Schedulable& sched)
+      : future_(std::move(future)), sched_(sched) {}
+
+  bool await_ready() const noexcept {
+    return future_.is_ready();
+  }
+
+  void await_suspend(std::coroutine_handle<> h) {
+    // The continuation's own future is not needed; the continuation runs regardless.
+    (void)future_.then([h](Future<Result>&&) { h.resume(); }, sched_, std::launch::async);
+  }
+
+  std::conditional_t<std::is_reference<Result>::value, Result, std::remove_cv_t<Result>>
+  await_resume() const {
+    return future_.get();
+  }
+
+ private:
+  mutable Future<Result> future_;
+  Schedulable& sched_;
+};
+
+/**
+ * Await a future from within a coroutine, resuming on the given pool or task set when the future
+ * is ready: <code>auto value = co_await dispenso::resumeOn(future, pool);</code>.  If the future is
+ * already ready, the coroutine continues without suspending.
+ *
+ * @param future The future to await.  The awaiter holds a reference to its shared state.
+ * @param sched The pool or task set to resume on.
+ * @return An awaitable producing a copy of the future's value (or the reference, for
+ * <code>Future<T&></code>).
+ **/
+template <typename Result, typename Schedulable>
+FutureAwaiter<Result, Schedulable> resumeOn(const Future<Result>& future, Schedulable& sched) {
+  return FutureAwaiter<Result, Schedulable>(future, sched);
+}
+
+/**
+ * Await a future from within a coroutine, resuming on the global thread pool when it is ready.
+ *
+ * @param future The future to await.
+ * @return An awaitable producing a copy of the future's value.
+ **/
+template <typename Result>
+FutureAwaiter<Result, ThreadPool> operator co_await(const Future<Result>& future) {
+  return FutureAwaiter<Result, ThreadPool>(future, globalThreadPool());
+}
+
+} // namespace dispenso
+
+#endif // __cpp_impl_coroutine
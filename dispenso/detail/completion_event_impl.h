@@ -24,6 +24,8 @@
 //    racing to get some statuses, and they should use compare_exchange functions to resolve those,
 //    setting completed status should not typically be racy.
 
+#include <dispenso/platform.h>
+
 #include "notifier_common.h"
 
 namespace dispenso {
@@ -298,6 +300,10 @@ class CompletionEventImpl {
     return status_;
   }
 
+  const std::atomic<int>& intrusiveStatus() const {
+    return status_;
+  }
+
  private:
   mutable std::mutex mtx_;
   mutable std::condition_variable cv_;
@@ -305,5 +311,18 @@ class CompletionEventImpl {
 };
 #endif // platform
 
+// Wait for the event to reach completedStatus, spinning briefly before sleeping in the OS.  Phases
+// in tightly synchronized loops often complete within microseconds, where the system calls to
+// sleep and wake cost more than the wait itself.
+inline void spinThenWait(const CompletionEventImpl& impl, int completedStatus, int spins) {
+  for (int i = 0; i < spins; ++i) {
+    if (impl.intrusiveStatus().load(std::memory_order_acquire) == completedStatus) {
+      return;
+    }
+    cpuRelax();
+  }
+  impl.wait(completedStatus);
+}
+
 } // namespace detail
 } // namespace dispenso
@@ -250,14 +250,35 @@ class CompactCVecIterator : public CompactCVecIterBase<VecT, T> {
   using CompactCVecIterBase<VecT, T>::index_;
 };
 
-template <typename T>
-inline T* alloc(size_t elts) {
-  return reinterpret_cast<T*>(detail::alignedMalloc(elts * sizeof(T), alignof(T)));
+// Traits::Allocator if Traits has one.  Otherwise the huge-page allocator if Traits sets
+// kUseHugePages, and the default allocator if not.
+template <typename Traits, typename = void>
+struct HugePagesByTraits : std::false_type {};
+
+template <typename Traits>
+struct HugePagesByTraits<Traits, std::enable_if_t<Traits::kUseHugePages>> : std::true_type {};
+
+template <typename Traits, typename = void>
+struct BucketAllocatorFor {
+  using type = std::conditional_t<
+      HugePagesByTraits<Traits>::value,
+      HugePageConcurrentVectorAllocator,
+      DefaultConcurrentVectorAllocator>;
+};
+
+template <typename Traits>
+struct BucketAllocatorFor<Traits, std::conditional_t<true, void, typename Traits::Allocator>> {
+  using type = typename Traits::Allocator;
+};
+
+template <typename T, typename Allocator>
+inline T* allocBucket(size_t elts) {
+  return reinterpret_cast<T*>(Allocator::alloc(elts * sizeof(T), alignof(T)));
 }
 
-template <typename T>
-inline void dealloc(T* p) {
-  detail::alignedFree(p);
+template <typename T, typename Allocator>
+inline void deallocBucket(T* p) {
+  Allocator::dealloc(p);
 }
 
 template <typename T, size_t kMinBufferSize, size_t kMaxVectorSize, bool kMakeInline>
@@ -268,18 +289,18 @@ class ConVecBufferBase<T, kMinBufferSize, kMaxVectorSize, false> {
  public:
   static constexpr size_t kMaxBuffers = detail::log2const(kMaxVectorSize / kMinBufferSize) + 1;
 
-  ConVecBufferBase() : buffers_(alloc<detail::AlignedAtomic<T>>(kMaxBuffers)) {
+  ConVecBufferBase() : buffers_(allocBuffers()) {
     for (size_t i = 0; i < kMaxBuffers; ++i) {
       buffers_[i].store(nullptr, std::memory_order_relaxed);
     }
   }
 
   ~ConVecBufferBase() {
-    dealloc<detail::AlignedAtomic<T>>(buffers_);
+    deallocBucket<detail::AlignedAtomic<T>, DefaultConcurrentVectorAllocator>(buffers_);
   }
 
   ConVecBufferBase(ConVecBufferBase&& other)
-      : buffers_(std::exchange(other.buffers_, alloc<detail::AlignedAtomic<T>>(kMaxBuffers))) {
+      : buffers_(std::exchange(other.buffers_, allocBuffers())) {
     for (size_t i = 0; i < kMaxBuffers; ++i) {
       other.buffers_[i].store(nullptr, std::memory_order_relaxed);
     }
@@ -293,6 +314,11 @@ class ConVecBufferBase<T, kMinBufferSize, kMaxVectorSize, false> {
 
  protected:
   detail::AlignedAtomic<T>* buffers_;
+
+ private:
+  static detail::AlignedAtomic<T>* allocBuffers() {
+    return allocBucket<detail::AlignedAtomic<T>, DefaultConcurrentVectorAllocator>(kMaxBuffers);
+  }
 };
 
 template <typename T, size_t kMinBufferSize, size_t kMaxVectorSize>
@@ -333,7 +359,8 @@ template <
     size_t kMinBufferSize,
     size_t kMaxVectorSize,
     bool kMakeInline,
-    ConcurrentVectorReallocStrategy kStrategy>
+    ConcurrentVectorReallocStrategy kStrategy,
+    typename Allocator>
 class ConVecBuffer : public ConVecBufferBase<T, kMinBufferSize, kMaxVectorSize, kMakeInline> {
  public:
   ConVecBuffer() {
@@ -372,7 +399,7 @@ class ConVecBuffer : public ConVecBufferBase<T, kMinBufferSize, kMaxVectorSize,
     if (DISPENSO_EXPECT(binfo.bucketIndex == indexToCheck, 0)) {
       if (!this->buffers_[binfo.bucket + 1].load(std::memory_order_acquire)) {
         this->buffers_[binfo.bucket + 1].store(
-            cv::alloc<T>(binfo.bucketCapacity << 1), std::memory_order_release);
+            cv::allocBucket<T, Allocator>(binfo.bucketCapacity << 1), std::memory_order_release);
         shouldDealloc_[binfo.bucket + 1] = true;
       }
     }
@@ -417,7 +444,7 @@ class ConVecBuffer : public ConVecBufferBase<T, kMinBufferSize, kMaxVectorSize,
 
       T* allocBufs = nullptr;
       if (sizeToAlloc) {
-        allocBufs = cv::alloc<T>(sizeToAlloc);
+        allocBufs = cv::allocBucket<T, Allocator>(sizeToAlloc);
       }
       bool firstAccounted = false;
 
@@ -457,4 +484,122 @@ class ConVecBuffer : public ConVecBufferBase<T, kMinBufferSize, kMaxVectorSize,
   bool shouldDealloc_[BaseType::kMaxBuffers];
 };
 
+// A contiguous run of elements, e.g. one bucket of a ConcurrentVector.  A minimal stand-in for
+// std::span, which is not available in C++14.
+template <typename T>
+class Segment {
+ public:
+  using value_type = std::remove_const_t<T>;
+  using pointer = T*;
+  using reference = T&;
+  using iterator = T*;
+
+  Segment() = default;
+  Segment(T* data, size_t size) : data_(data), size_(size) {}
+
+  T* data() const {
+    return data_;
+  }
+  size_t size() const {
+    return size_;
+  }
+  bool empty() const {
+    return size_ == 0;
+  }
+  T* begin() const {
+    return data_;
+  }
+  T* end() const {
+    return data_ + size_;
+  }
+  T& operator[](size_t i) const {
+    return data_[i];
+  }
+  Segment subspan(size_t offset, size_t count) const {
+    return {data_ + offset, std::min(count, size_ - offset)};
+  }
+
+  // Allow a mutable segment to convert to a const one.
+  operator Segment<const T>() const {
+    return {data_, size_};
+  }
+
+ private:
+  T* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+// A view of the buckets of a ConcurrentVector as a range of Segments, covering the elements that
+// existed when the view was created.
+template <typename VecT, typename T>
+class SegmentsView {
+ public:
+  class iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using difference_type = ssize_t;
+    using value_type = Segment<T>;
+    using pointer = const Segment<T>*;
+    using reference = Segment<T>;
+
+    iterator(const SegmentsView* view, size_t index) : view_(view), index_(index) {}
+
+    Segment<T> operator*() const {
+      return (*view_)[index_];
+    }
+    iterator& operator++() {
+      ++index_;
+      return *this;
+    }
+    iterator operator++(int) {
+      iterator result = *this;
+      ++index_;
+      return result;
+    }
+    friend bool operator==(const iterator& a, const iterator& b) {
+      return a.index_ == b.index_;
+    }
+    friend bool operator!=(const iterator& a, const iterator& b) {
+      return a.index_ != b.index_;
+    }
+
+   private:
+    const SegmentsView* view_;
+    size_t index_;
+  };
+  using const_iterator = iterator;
+
+  SegmentsView(const VecT* vec, size_t numElements);
+
+  // The number of segments.
+  size_t size() const {
+    return numSegments_;
+  }
+  bool empty() const {
+    return numSegments_ == 0;
+  }
+  // The number of elements covered by all segments.
+  size_t numElements() const {
+    return numElements_;
+  }
+
+  Segment<T> operator[](size_t segment) const;
+
+  iterator begin() const {
+    return {this, 0};
+  }
+  iterator end() const {
+    return {this, numSegments_};
+  }
+
+  // Call f(Segment<T>) on each contiguous run of elements with index in [start, end).
+  template <typename F>
+  void forEachRun(size_t start, size_t end, F&& f) const;
+
+ private:
+  const VecT* vec_;
+  size_t numElements_;
+  size_t numSegments_;
+};
+
 } // namespace cv
@@ -133,4 +133,31 @@ DISPENSO_INLINE typename CompactCVecIterator<VecT, T, kIsConst>::reference
 CompactCVecIterator<VecT, T, kIsConst>::operator[](ssize_t n) const {
   return const_cast<VecT&>(*vec_)[index_ + n];
 }
+template <typename VecT, typename T>
+SegmentsView<VecT, T>::SegmentsView(const VecT* vec, size_t numElements)
+    : vec_(vec),
+      numElements_(numElements),
+      numSegments_(numElements ? vec->bucketAndSubIndex(numElements - 1).bucket + 1 : 0) {}
+
+template <typename VecT, typename T>
+DISPENSO_INLINE Segment<T> SegmentsView<VecT, T>::operator[](size_t segment) const {
+  // Buckets 0 and 1 both hold firstBucketLen_ elements, and each later bucket doubles.
+  size_t capacity = segment ? vec_->firstBucketLen_ << (segment - 1) : vec_->firstBucketLen_;
+  size_t start = segment ? capacity : 0;
+  T* data = vec_->buffers_[segment].load(std::memory_order_relaxed);
+  return {data, std::min(capacity, numElements_ - start)};
+}
+
+template <typename VecT, typename T>
+template <typename F>
+void SegmentsView<VecT, T>::forEachRun(size_t start, size_t end, F&& f) const {
+  end = std::min(end, numElements_);
+  while (start < end) {
+    auto binfo = vec_->bucketAndSubIndex(start);
+    size_t len = std::min(binfo.bucketCapacity - binfo.bucketIndex, end - start);
+    T* data = vec_->buffers_[binfo.bucket].load(std::memory_order_relaxed) + binfo.bucketIndex;
+    f(Segment<T>(data, len));
+    start += len;
+  }
+}
 } // namespace cv
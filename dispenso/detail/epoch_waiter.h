@@ -14,6 +14,25 @@
 namespace dispenso {
 namespace detail {
 
+// Sleepers count themselves as parked before their final check of the epoch, and wakers check for
+// parked sleepers after bumping the epoch (both sequentially consistent), so a waker either sees a
+// sleeper and wakes it, or the sleeper sees the new epoch and does not sleep.  Wakers therefore
+// skip the wake system call entirely when nobody is parked.  Futexes and WaitOnAddress recheck
+// the epoch in the kernel, so there the final check is the kernel's.  Mach semaphores do not, so
+// Mach sleepers park before checking the epoch themselves.
+class ParkedScope {
+ public:
+  explicit ParkedScope(std::atomic<uint32_t>& sleepers) : sleepers_(sleepers) {
+    sleepers_.fetch_add(1, std::memory_order_seq_cst);
+  }
+  ~ParkedScope() {
+    sleepers_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<uint32_t>& sleepers_;
+};
+
 #if defined(__linux__)
 
 class EpochWaiter {
@@ -21,19 +40,32 @@ class EpochWaiter {
   EpochWaiter() : ftx_(0) {}
 
   void bumpAndWake() {
-    epoch_.fetch_add(1, std::memory_order_acq_rel);
-    futex(&ftx_, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+    bumpAndWakeN(1);
+  }
+
+  void bumpAndWakeN(uint32_t n) {
+    if (bumpHasSleepers()) {
+      futex(
+          &ftx_,
+          FUTEX_WAKE_PRIVATE,
+          static_cast<int>(std::min<uint32_t>(n, std::numeric_limits<int>::max())),
+          nullptr,
+          nullptr,
+          0);
+    }
   }
 
   void bumpAndWakeAll() {
-    epoch_.fetch_add(1, std::memory_order_acq_rel);
-    futex(&ftx_, FUTEX_WAKE_PRIVATE, std::numeric_limits<int>::max(), nullptr, nullptr, 0);
+    if (bumpHasSleepers()) {
+      futex(&ftx_, FUTEX_WAKE_PRIVATE, std::numeric_limits<int>::max(), nullptr, nullptr, 0);
+    }
   }
 
   uint32_t wait(uint32_t expectedEpoch) const {
     uint32_t current;
     // allow spurious wakeups
     if ((current = epoch_.load(std::memory_order_acquire)) == expectedEpoch) {
+      ParkedScope parked(sleepers_);
       futex(&ftx_, FUTEX_WAIT_PRIVATE, expectedEpoch, nullptr, nullptr, 0);
     } else {
       return current;
@@ -57,6 +89,7 @@ class EpochWaiter {
 
     // allow spurious wakeups
     if ((current = epoch_.load(std::memory_order_acquire)) == expectedEpoch) {
+      ParkedScope parked(sleepers_);
       futex(&ftx_, FUTEX_WAIT_PRIVATE, current, &ts, nullptr, 0);
     } else {
       return current;
@@ -65,10 +98,16 @@ class EpochWaiter {
   }
 
  private:
+  bool bumpHasSleepers() {
+    epoch_.fetch_add(1, std::memory_order_seq_cst);
+    return sleepers_.load(std::memory_order_seq_cst) != 0;
+  }
+
   union {
     mutable int ftx_;
     std::atomic<uint32_t> epoch_;
   };
+  mutable std::atomic<uint32_t> sleepers_{0};
 };
 
 #elif defined(__MACH__)
@@ -84,13 +123,21 @@ class EpochWaiter {
   }
 
   void bumpAndWake() {
-    epoch_.fetch_add(1, std::memory_order_release);
-    semaphore_signal(sem_);
+    bumpAndWakeN(1);
+  }
+
+  void bumpAndWakeN(uint32_t n) {
+    if (bumpHasSleepers()) {
+      for (uint32_t i = 0; i < n; ++i) {
+        semaphore_signal(sem_);
+      }
+    }
   }
 
   void bumpAndWakeAll() {
-    epoch_.fetch_add(1, std::memory_order_release);
-    semaphore_signal_all(sem_);
+    if (bumpHasSleepers()) {
+      semaphore_signal_all(sem_);
+    }
   }
 
   uint32_t wait(uint32_t expectedEpoch) const {
@@ -98,20 +145,15 @@ class EpochWaiter {
     ts.tv_sec = 0;
     ts.tv_nsec = 2000000; // 2 ms
     uint32_t current;
-    // Allow spurious wake
-    if ((current = epoch_.load(std::memory_order_acquire)) == expectedEpoch) {
-      // Here we use timedwait with medium-long wait time. This is because it is possible that we
-      // can have the following sequence:
-      // 1. We check the status_ condition for this loop
-      // 2. notify() sets status_ to true
-      // 3. notify() calls semaphore_signal_all
-      // 4. We enter semaphore_wait here.  This would result in never being woken.
-
-      // Although the sequencing above is unlikely, it is possible.  By chosing semaphore_timedwait
-      // instead of semaphore_wait, we will ensure that we can always complete the wait.
+    {
+      // Park before the check: a bump after it then sees us, and its signal is counted by the
+      // semaphore even if it lands before we block.  The wait is still timed, as a backstop.
+      ParkedScope parked(sleepers_);
+      // Allow spurious wake
+      if ((current = epoch_.load(std::memory_order_seq_cst)) != expectedEpoch) {
+        return current;
+      }
       semaphore_timedwait(sem_, ts);
-    } else {
-      return current;
     }
     return epoch_.load(std::memory_order_acquire);
   }
@@ -126,11 +168,13 @@ class EpochWaiter {
     ts.tv_sec = relTimeUs / 1000000;
     ts.tv_nsec = static_cast<clock_res_t>((relTimeUs - (ts.tv_sec * 1000000)) * 1000);
 
-    // Allow spurious wake
-    if ((current = epoch_.load(std::memory_order_acquire)) == expectedEpoch) {
+    {
+      ParkedScope parked(sleepers_);
+      // Allow spurious wake
+      if ((current = epoch_.load(std::memory_order_seq_cst)) != expectedEpoch) {
+        return current;
+      }
       semaphore_timedwait(sem_, ts);
-    } else {
-      return current;
     }
     return epoch_.load(std::memory_order_acquire);
   }
@@ -140,8 +184,14 @@ class EpochWaiter {
   }
 
  private:
+  bool bumpHasSleepers() {
+    epoch_.fetch_add(1, std::memory_order_seq_cst);
+    return sleepers_.load(std::memory_order_seq_cst) != 0;
+  }
+
   semaphore_t sem_;
   std::atomic<uint32_t> epoch_;
+  mutable std::atomic<uint32_t> sleepers_{0};
 };
 
 #elif defined(_WIN32)
@@ -151,19 +201,28 @@ class EpochWaiter {
   EpochWaiter() : epoch_(0) {}
 
   void bumpAndWake() {
-    epoch_.fetch_add(1, std::memory_order_acq_rel);
-    WakeByAddressSingle(&epoch_);
+    bumpAndWakeN(1);
+  }
+
+  void bumpAndWakeN(uint32_t n) {
+    if (bumpHasSleepers()) {
+      for (uint32_t i = 0; i < n; ++i) {
+        WakeByAddressSingle(&epoch_);
+      }
+    }
   }
 
   void bumpAndWakeAll() {
-    epoch_.fetch_add(1, std::memory_order_acq_rel);
-    WakeByAddressAll(&epoch_);
+    if (bumpHasSleepers()) {
+      WakeByAddressAll(&epoch_);
+    }
   }
 
   uint32_t wait(uint32_t expectedEpoch) const {
     uint32_t current;
     // Allow spurious wake
     if ((current = epoch_.load(std::memory_order_acquire)) == expectedEpoch) {
+      ParkedScope parked(sleepers_);
       WaitOnAddress(&epoch_, &current, sizeof(uint32_t), kInfiniteWin);
     } else {
       return current;
@@ -184,6 +243,7 @@ class EpochWaiter {
     int msWait = std::max(1, static_cast<int>(relTimeUs / 1000));
     // Allow spurious wake
     if ((current = epoch_.load(std::memory_order_acquire)) == expectedEpoch) {
+      ParkedScope parked(sleepers_);
       WaitOnAddress(&epoch_, &current, sizeof(uint32_t), msWait);
     } else {
       return current;
@@ -192,7 +252,13 @@ class EpochWaiter {
   }
 
  private:
+  bool bumpHasSleepers() {
+    epoch_.fetch_add(1, std::memory_order_seq_cst);
+    return sleepers_.load(std::memory_order_seq_cst) != 0;
+  }
+
   mutable std::atomic<uint32_t> epoch_;
+  mutable std::atomic<uint32_t> sleepers_{0};
 };
 
 #else
@@ -203,21 +269,32 @@ class EpochWaiter {
   EpochWaiter() : epoch_(0) {}
 
   void bumpAndWake() {
-    epoch_.fetch_add(1, std::memory_order_acq_rel);
-    cv_.notify_one();
+    bumpAndWakeN(1);
+  }
+
+  void bumpAndWakeN(uint32_t n) {
+    if (bumpHasSleepers()) {
+      for (uint32_t i = 0; i < n; ++i) {
+        cv_.notify_one();
+      }
+    }
   }
 
   void bumpAndWakeAll() {
-    epoch_.fetch_add(1, std::memory_order_acq_rel);
-    cv_.notify_all();
+    if (bumpHasSleepers()) {
+      cv_.notify_all();
+    }
   }
 
   uint32_t wait(uint32_t expectedEpoch) const {
     uint32_t current;
     // Allow spurious wake
     if ((current = epoch_.load(std::memory_order_acquire)) == expectedEpoch) {
+      ParkedScope parked(sleepers_);
       std::unique_lock<std::mutex> lk(mtx_);
-      cv_.wait(lk);
+      if (epoch_.load(std::memory_order_acquire) == expectedEpoch) {
+        cv_.wait(lk);
+      }
     } else {
       return current;
     }
@@ -236,8 +313,11 @@ class EpochWaiter {
 
     // Allow spurious wake
     if ((current = epoch_.load(std::memory_order_acquire)) == expectedEpoch) {
+      ParkedScope parked(sleepers_);
       std::unique_lock<std::mutex> lk(mtx_);
-      cv_.wait_for(lk, std::chrono::microseconds(relTimeUs));
+      if (epoch_.load(std::memory_order_acquire) == expectedEpoch) {
+        cv_.wait_for(lk, std::chrono::microseconds(relTimeUs));
+      }
     } else {
       return current;
     }
@@ -245,9 +325,20 @@ class EpochWaiter {
   }
 
  private:
+  bool bumpHasSleepers() {
+    epoch_.fetch_add(1, std::memory_order_seq_cst);
+    if (!sleepers_.load(std::memory_order_seq_cst)) {
+      return false;
+    }
+    // Acquiring the mutex orders the notify after any sleeper's check of the epoch.
+    { std::lock_guard<std::mutex> lk(mtx_); }
+    return true;
+  }
+
   mutable std::mutex mtx_;
   mutable std::condition_variable cv_;
   std::atomic<uint32_t> epoch_;
+  mutable std::atomic<uint32_t> sleepers_{0};
 };
 
 #endif // platform
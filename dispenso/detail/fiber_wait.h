@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+#include <dispenso/detail/per_thread_info.h>
+
+namespace dispenso {
+namespace detail {
+
+// True if the calling thread is running a fiber from a FiberTaskSet (see fiber.h).
+inline bool inFiber() {
+  return PerPoolPerThreadInfo::fiber() != nullptr;
+}
+
+// Suspend the calling fiber until ready(arg) returns true, handing its thread back to the pool in
+// the meantime.  The fiber is queued to resume, possibly on a different thread, by wakeFibers(arg),
+// which whatever makes ready(arg) true must call afterwards.  Returns false without waiting if the
+// fiber cannot be suspended here, e.g. when called from inside a parallel_for chunk or a TaskSet
+// task that the fiber ran while helping, in which case the caller should wait as usual.
+DISPENSO_DLL_ACCESS bool suspendFiberUntil(bool (*ready)(const void*), const void* arg);
+
+// The number of fibers suspended and not yet woken, across all FiberTaskSets.
+DISPENSO_DLL_ACCESS extern std::atomic<size_t> g_suspendedFibers;
+
+DISPENSO_DLL_ACCESS void wakeSuspendedFibers(const void* arg);
+
+// Resume the fibers suspended until ready(arg).  arg is only compared, never dereferenced, so this
+// may be called once the object behind it may have been destroyed.
+inline void wakeFibers(const void* arg) {
+  // Pairs with the fence in suspending: either this sees the fiber suspended, or the fiber sees
+  // ready(arg) before suspending.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (g_suspendedFibers.load(std::memory_order_relaxed)) {
+    wakeSuspendedFibers(arg);
+  }
+}
+
+} // namespace detail
+} // namespace dispenso
@@ -8,6 +8,7 @@
 #include <future>
 
 #include <dispenso/completion_event.h>
+#include <dispenso/detail/fiber_wait.h>
 #include <dispenso/once_function.h>
 #include <dispenso/task_set.h>
 
@@ -153,6 +154,9 @@ class FutureImplBase : private FutureImplResultMember<Result>, public OnceCallab
     if (waitCommon(true)) {
       return;
     }
+    if (inFiber() && suspendFiberUntil(&readyFromWait, this)) {
+      return;
+    }
     status_.wait(kReady);
   }
 
@@ -203,10 +207,13 @@ class FutureImplBase : private FutureImplResultMember<Result>, public OnceCallab
       if (status_.intrusiveStatus().compare_exchange_weak(s, kRunning, std::memory_order_acq_rel)) {
         runFunc();
         status_.notify(kReady);
+        wakeFibers(this);
         if (taskSetCounter_) {
           //  If we want TaskSet::wait to imply Future::is_ready(),
           //  we need to signal that *after* setting the Future status to ready.
-          taskSetCounter_->fetch_sub(1, std::memory_order_release);
+          if (taskSetCounter_->fetch_sub(1, std::memory_order_release) == 1) {
+            wakeFibers(taskSetCounter_);
+          }
         }
         tryExecuteThenChain();
         return true;
@@ -222,15 +229,28 @@ class FutureImplBase : private FutureImplResultMember<Result>, public OnceCallab
     void* impl;
     void* schedulable;
     ThenChainInvoke* invoke;
+  };
 
-    ThenChain* scheduleDestroyAndGetNext() {
-      invoke(impl, schedulable);
-      constexpr size_t kImplSize = nextPow2(sizeof(this));
-      auto* ret = this->next;
-      deallocSmallBuffer<kImplSize>(this);
-      return ret;
+  static constexpr size_t kThenChainSize = nextPow2(sizeof(ThenChain));
+
+  // The first continuation registered uses the link embedded in this impl, so that the common case
+  // of a single then() needs no allocation.  Later links come from the small buffer pool.
+  ThenChain* allocThenChainLink() {
+    if (!inlineThenChainUsed_.load(std::memory_order_relaxed) &&
+        !inlineThenChainUsed_.exchange(true, std::memory_order_relaxed)) {
+      return &inlineThenChain_;
     }
-  };
+    return reinterpret_cast<ThenChain*>(allocSmallBuffer<kThenChainSize>());
+  }
+
+  ThenChain* scheduleDestroyAndGetNext(ThenChain* link) {
+    ThenChain* next = link->next;
+    link->invoke(link->impl, link->schedulable);
+    if (link != &inlineThenChain_) {
+      deallocSmallBuffer<kThenChainSize>(link);
+    }
+    return next;
+  }
 
   void tryExecuteThenChain() {
     ThenChain* head = thenChain_.load(std::memory_order_acquire);
@@ -240,7 +260,7 @@ class FutureImplBase : private FutureImplResultMember<Result>, public OnceCallab
         // Managed to exchange with head, value of thenChain_ now points to null chain.
         // Head points to the implicit list of items to be executed.
         while (head) {
-          head = head->scheduleDestroyAndGetNext();
+          head = scheduleDestroyAndGetNext(head);
         }
         // At this point, the list is exhausted, so we exit the outer loop too.  It would be valid
         // to get head again and try all over again, but it is guaranteed that if another link was
@@ -275,9 +295,7 @@ class FutureImplBase : private FutureImplResultMember<Result>, public OnceCallab
       return;
     }
 
-    constexpr size_t kImplSize = nextPow2(sizeof(ThenChain));
-    auto* buffer = allocSmallBuffer<kImplSize>();
-    ThenChain* link = reinterpret_cast<ThenChain*>(buffer);
+    ThenChain* link = allocThenChainLink();
     link->impl = impl;
     using NonConstSchedulable = std::remove_const_t<Schedulable>;
     NonConstSchedulable* nonConstSched = const_cast<NonConstSchedulable*>(&sched);
@@ -299,6 +317,10 @@ class FutureImplBase : private FutureImplResultMember<Result>, public OnceCallab
     }
   }
 
+  static bool readyFromWait(const void* impl) {
+    return const_cast<FutureImplBase*>(static_cast<const FutureImplBase*>(impl))->ready();
+  }
+
   inline bool waitCommon(bool allowInline) {
     int s = status_.intrusiveStatus().load(std::memory_order_acquire);
     return s == kReady || (allowInline && run(s));
@@ -317,6 +339,8 @@ class FutureImplBase : private FutureImplResultMember<Result>, public OnceCallab
   std::atomic<ssize_t>* taskSetCounter_{nullptr};
 
   std::atomic<ThenChain*> thenChain_{nullptr};
+  std::atomic<bool> inlineThenChainUsed_{false};
+  ThenChain inlineThenChain_;
 
   template <typename R, typename T>
   friend FutureImplBase<R&>* createValueFutureImplReady(std::reference_wrapper<T> t);
@@ -423,14 +447,6 @@ inline FutureImplBase<X&>* createRefFutureImplReady(std::reference_wrapper<X> x)
   return ret;
 }
 
-inline FutureImplBase<void>* createVoidFutureImplReady() {
-  constexpr size_t kImplSize = nextPow2(sizeof(FutureImplSmall<16, void, void>));
-  using SmallT = FutureImplSmall<kImplSize, void, void>;
-  FutureImplBase<void>* ret = new (allocSmallBuffer<kImplSize>()) SmallT();
-  ret->setReady();
-  return ret;
-}
-
 template <typename TaskSetType>
 struct TaskSetInterceptionInvoker {
   TaskSetInterceptionInvoker(TaskSetType& ts) : taskSet(ts) {}
@@ -445,14 +461,94 @@ struct TaskSetInterceptionInvoker {
   OnceFunction savedOffFn;
 };
 
+// Ready results that are trivially copyable and no larger than this are kept inside the Future
+// itself, so that make_ready_future need not allocate shared state.
+constexpr size_t kInlineReadyResultSize = 2 * sizeof(void*);
+
 template <typename Result>
-class FutureBase {
+struct IsInlineReadyResult
+    : std::integral_constant<
+          bool,
+          std::is_trivially_copyable<Result>::value && sizeof(Result) <= kInlineReadyResultSize> {
+};
+
+template <>
+struct IsInlineReadyResult<void> : std::true_type {};
+
+template <typename Result, bool kEnabled = IsInlineReadyResult<Result>::value>
+class InlineReadyResult {
+ protected:
+  static constexpr bool kInline = false;
+
+  bool hasInlineResult() const {
+    return false;
+  }
+  decltype(auto) result(FutureImplBase<Result>* impl) const {
+    return impl->result();
+  }
+  void clearInlineResult() {}
+};
+
+template <typename Result>
+class InlineReadyResult<Result, true> {
+ protected:
+  static constexpr bool kInline = true;
+
+  bool hasInlineResult() const {
+    return hasInline_;
+  }
+  const Result& result(FutureImplBase<Result>* impl) const {
+    return impl ? impl->result() : *reinterpret_cast<const Result*>(buf_);
+  }
+  template <typename T>
+  void setInlineResult(T&& t) {
+    new (buf_) Result(std::forward<T>(t));
+    hasInline_ = true;
+  }
+  void clearInlineResult() {
+    hasInline_ = false;
+  }
+
+ private:
+  alignas(Result) unsigned char buf_[sizeof(Result)];
+  bool hasInline_ = false;
+};
+
+template <>
+class InlineReadyResult<void, true> {
+ protected:
+  static constexpr bool kInline = true;
+
+  bool hasInlineResult() const {
+    return hasInline_;
+  }
+  void result(FutureImplBase<void>* impl) const {
+    if (impl) {
+      impl->result();
+    }
+  }
+  void setInlineResult() {
+    hasInline_ = true;
+  }
+  void clearInlineResult() {
+    hasInline_ = false;
+  }
+
+ private:
+  bool hasInline_ = false;
+};
+
+template <typename Result>
+class FutureBase : protected InlineReadyResult<Result> {
+  using Inline = InlineReadyResult<Result>;
+
  protected:
   FutureBase() noexcept : impl_(nullptr) {}
-  FutureBase(FutureBase&& f) noexcept : impl_(f.impl_) {
+  FutureBase(FutureBase&& f) noexcept : Inline(f), impl_(f.impl_) {
+    f.clearInlineResult();
     f.impl_ = nullptr;
   }
-  FutureBase(const FutureBase& f) noexcept {
+  FutureBase(const FutureBase& f) noexcept : Inline(f) {
     impl_ = f.impl_;
     if (impl_) {
       impl_->incRefCount();
@@ -518,7 +614,17 @@ class FutureBase {
   }
 
   void move(FutureBase&& f) noexcept {
+    if (this == &f) {
+      return;
+    }
+    Inline::operator=(f);
+    f.clearInlineResult();
     if (impl_ == f.impl_) {
+      // Both futures hold a reference to the same state, so f's is released, not transferred.
+      if (f.impl_) {
+        f.impl_->decRefCountMaybeDestroy();
+        f.impl_ = nullptr;
+      }
       return;
     } else if (impl_) {
       impl_->decRefCountMaybeDestroy();
@@ -527,6 +633,7 @@ class FutureBase {
     f.impl_ = nullptr;
   }
   void copy(const FutureBase& f) {
+    Inline::operator=(f);
     if (impl_ != f.impl_) {
       if (impl_ != nullptr) {
         impl_->decRefCountMaybeDestroy();
@@ -543,27 +650,69 @@ class FutureBase {
     }
   }
   bool valid() const noexcept {
-    return impl_;
+    return impl_ || this->hasInlineResult();
   }
   bool is_ready() const {
     assertValid();
-    return impl_->ready();
+    return isInline() || impl_->ready();
   }
   void wait() const {
     assertValid();
-    impl_->wait();
+    if (!isInline()) {
+      impl_->wait();
+    }
   }
   template <class Rep, class Period>
   std::future_status wait_for(const std::chrono::duration<Rep, Period>& timeoutDuration) const {
     assertValid();
+    if (isInline()) {
+      return std::future_status::ready;
+    }
     return impl_->waitFor(timeoutDuration);
   }
   template <class Clock, class Duration>
   std::future_status wait_until(const std::chrono::time_point<Clock, Duration>& timeoutTime) const {
     assertValid();
+    if (isInline()) {
+      return std::future_status::ready;
+    }
     return impl_->waitUntil(timeoutTime);
   }
 
+  // A valid future holds its result inline exactly when it has no shared state.
+  bool isInline() const {
+    return Inline::kInline && !impl_;
+  }
+
+  decltype(auto) result() const {
+    return Inline::result(impl_);
+  }
+
+  template <typename T>
+  void setReadyResult(T&& t) {
+    setReadyResult(std::forward<T>(t), IsInlineReadyResult<Result>());
+  }
+  template <typename T>
+  void setReadyResult(T&& t, std::true_type) {
+    this->setInlineResult(std::forward<T>(t));
+  }
+  template <typename T>
+  void setReadyResult(T&& t, std::false_type) {
+    impl_ = createValueFutureImplReady<Result>(std::forward<T>(t));
+  }
+
+  // Runs impl once this future is ready.  Inline results are always ready, and need no then chain.
+  template <typename SomeFutureImpl, typename Schedulable>
+  void thenOrExecute(SomeFutureImpl* impl, Schedulable& sched, std::launch asyncPolicy) {
+    if (!isInline()) {
+      impl_->addToThenChainOrExecute(impl, sched, asyncPolicy);
+    } else if ((asyncPolicy & std::launch::async) == std::launch::async) {
+      sched.schedule(OnceFunction(impl, true), ForceQueuingTag());
+    } else {
+      sched.schedule(OnceFunction(impl, true));
+    }
+  }
+
   template <typename RetResult, typename F, typename Schedulable>
   FutureImplBase<RetResult>*
   thenImpl(F&& f, Schedulable& sched, std::launch asyncPolicy, std::launch deferredPolicy);
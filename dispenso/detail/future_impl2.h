@@ -37,7 +37,7 @@ FutureImplBase<RetResult>* FutureBase<Result>::thenImpl(
 
   auto* retImpl = createFutureImpl<RetResult>(
       std::move(func), (deferredPolicy & std::launch::deferred) == std::launch::deferred, nullptr);
-  impl_->addToThenChainOrExecute(retImpl, sched, asyncPolicy);
+  thenOrExecute(retImpl, sched, asyncPolicy);
   return retImpl;
 }
 
@@ -59,7 +59,7 @@ FutureImplBase<RetResult>* FutureBase<Result>::thenImpl(
       std::move(func),
       (deferredPolicy & std::launch::deferred) == std::launch::deferred,
       &sched.outstandingTaskCount_);
-  impl_->addToThenChainOrExecute(retImpl, sched.pool(), asyncPolicy);
+  thenOrExecute(retImpl, sched.pool(), asyncPolicy);
   return retImpl;
 }
 
@@ -81,7 +81,7 @@ FutureImplBase<RetResult>* FutureBase<Result>::thenImpl(
       std::move(func),
       (deferredPolicy & std::launch::deferred) == std::launch::deferred,
       &sched.outstandingTaskCount_);
-  impl_->addToThenChainOrExecute(retImpl, sched.pool(), asyncPolicy);
+  thenOrExecute(retImpl, sched.pool(), asyncPolicy);
   return retImpl;
 }
 
@@ -219,6 +219,94 @@ whenAllIterators(Invoker& invoker, InputIt first, InputIt last) {
   return res;
 }
 
+template <typename Sequence>
+struct WhenAnyShared {
+  static constexpr size_t kNoIndex = std::numeric_limits<size_t>::max();
+
+  Sequence seq;
+  std::atomic<size_t> index{kNoIndex};
+  // Reaches 2 once both a winner is chosen and all continuations are registered.  Until then the
+  // sequence may not be moved out, since registration is still walking it.
+  std::atomic<size_t> stages{0};
+  CompletionEvent done;
+  OnceFunction f;
+
+  template <typename... Args>
+  WhenAnyShared(Args&&... args) : seq(std::forward<Args>(args)...) {}
+
+  void advance() {
+    if (stages.fetch_add(1, std::memory_order_acq_rel) == 1) {
+      done.notify();
+      f();
+    }
+  }
+
+  void complete(size_t i) {
+    size_t expected = kNoIndex;
+    if (index.compare_exchange_strong(expected, i, std::memory_order_acq_rel)) {
+      advance();
+    }
+  }
+
+  WhenAnyResult<Sequence> take() {
+    // If a waiter runs the result future's function inline, it must block here for the winner.
+    done.wait();
+    return {index.load(std::memory_order_acquire), std::move(seq)};
+  }
+};
+
+template <typename Tuple, typename F, size_t... Is>
+void forEachIndexed(Tuple& t, F& f, std::index_sequence<Is...>) {
+  int dummy[] = {0, (f(std::get<Is>(t), Is), 0)...};
+  (void)dummy;
+}
+
+template <typename Invoker, typename Sequence, typename ForEachFn>
+Future<WhenAnyResult<Sequence>> whenAnyImpl(
+    Invoker& invoker,
+    std::shared_ptr<WhenAnyShared<Sequence>> shared,
+    ForEachFn forEachFuture) {
+  Future<WhenAnyResult<Sequence>> res([shared]() { return shared->take(); }, invoker);
+  shared->f = std::move(invoker.savedOffFn);
+
+  auto registerOne = [&shared](auto& future, size_t i) {
+    future.then([shared, i](auto&&) { shared->complete(i); }, kImmediateInvoker);
+  };
+  forEachFuture(shared->seq, registerOne);
+  shared->advance();
+  return res;
+}
+
+template <typename Invoker, typename InputIt>
+Future<WhenAnyResult<std::vector<typename std::iterator_traits<InputIt>::value_type>>>
+whenAnyIterators(Invoker& invoker, InputIt first, InputIt last) {
+  using VecType = std::vector<typename std::iterator_traits<InputIt>::value_type>;
+  using Shared = WhenAnyShared<VecType>;
+
+  if (first == last) {
+    return make_ready_future(WhenAnyResult<VecType>{Shared::kNoIndex, VecType()});
+  }
+
+  return whenAnyImpl(
+      invoker, std::make_shared<Shared>(first, last), [](VecType& vec, auto& registerOne) {
+        for (size_t i = 0; i < vec.size(); ++i) {
+          registerOne(vec[i], i);
+        }
+      });
+}
+
+template <typename Invoker, typename... Futures>
+auto whenAnyTuple(Invoker& invoker, Futures&&... futures)
+    -> Future<WhenAnyResult<std::tuple<std::decay_t<Futures>...>>> {
+  using TupleType = std::tuple<std::decay_t<Futures>...>;
+  return whenAnyImpl(
+      invoker,
+      std::make_shared<WhenAnyShared<TupleType>>(std::forward<Futures>(futures)...),
+      [](TupleType& tuple, auto& registerOne) {
+        forEachIndexed(tuple, registerOne, std::index_sequence_for<Futures...>());
+      });
+}
+
 } // namespace detail
 
 template <typename InputIt>
@@ -275,4 +363,52 @@ auto when_all(ConcurrentTaskSet& taskSet, Futures&&... futures)
   return whenAllTuple(interceptor, std::forward<Futures>(futures)...);
 }
 
+template <typename InputIt>
+Future<WhenAnyResult<std::vector<typename std::iterator_traits<InputIt>::value_type>>> when_any(
+    InputIt first,
+    InputIt last) {
+  detail::InterceptionInvoker interceptor;
+  return detail::whenAnyIterators(interceptor, first, last);
+}
+
+template <typename InputIt>
+Future<WhenAnyResult<std::vector<typename std::iterator_traits<InputIt>::value_type>>>
+when_any(TaskSet& taskSet, InputIt first, InputIt last) {
+  detail::TaskSetInterceptionInvoker<TaskSet> interceptor(taskSet);
+  return detail::whenAnyIterators(interceptor, first, last);
+}
+
+template <typename InputIt>
+Future<WhenAnyResult<std::vector<typename std::iterator_traits<InputIt>::value_type>>>
+when_any(ConcurrentTaskSet& taskSet, InputIt first, InputIt last) {
+  detail::TaskSetInterceptionInvoker<ConcurrentTaskSet> interceptor(taskSet);
+  return detail::whenAnyIterators(interceptor, first, last);
+}
+
+inline auto when_any() -> Future<WhenAnyResult<std::tuple<>>> {
+  return make_ready_future(
+      WhenAnyResult<std::tuple<>>{std::numeric_limits<size_t>::max(), std::tuple<>()});
+}
+
+template <class... Futures>
+auto when_any(Futures&&... futures)
+    -> Future<WhenAnyResult<std::tuple<std::decay_t<Futures>...>>> {
+  detail::InterceptionInvoker interceptor;
+  return detail::whenAnyTuple(interceptor, std::forward<Futures>(futures)...);
+}
+
+template <typename... Futures>
+auto when_any(TaskSet& taskSet, Futures&&... futures)
+    -> Future<WhenAnyResult<std::tuple<std::decay_t<Futures>...>>> {
+  detail::TaskSetInterceptionInvoker<TaskSet> interceptor(taskSet);
+  return detail::whenAnyTuple(interceptor, std::forward<Futures>(futures)...);
+}
+
+template <typename... Futures>
+auto when_any(ConcurrentTaskSet& taskSet, Futures&&... futures)
+    -> Future<WhenAnyResult<std::tuple<std::decay_t<Futures>...>>> {
+  detail::TaskSetInterceptionInvoker<ConcurrentTaskSet> interceptor(taskSet);
+  return detail::whenAnyTuple(interceptor, std::forward<Futures>(futures)...);
+}
+
 } // namespace dispenso
@@ -7,14 +7,27 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+
 #include <dispenso/platform.h>
 
 namespace dispenso {
 namespace detail {
 
+constexpr size_t kNoWorkerIndex = ~size_t{0};
+
 struct alignas(kCacheLineSize) PerThreadInfo {
   void* pool = nullptr;
   void* producer = nullptr;
+  void* worker = nullptr;
+  size_t workerIndex = kNoWorkerIndex;
+  void* rcuRecord = nullptr;
+  uint64_t epochDomain = 0;
+  void* epochRecord = nullptr;
+  uint64_t externalPoolId = 0;
+  void* externalProducer = nullptr;
+  void* fiber = nullptr;
   int parForRecursionLevel = 0;
 };
 
@@ -35,10 +48,16 @@ class ParForRecursion {
 
 class PerPoolPerThreadInfo {
  public:
-  static void registerPool(void* pool, void* producer) {
+  static void registerPool(
+      void* pool,
+      void* producer,
+      void* worker = nullptr,
+      size_t workerIndex = kNoWorkerIndex) {
     auto& i = info();
     i.pool = pool;
     i.producer = producer;
+    i.worker = worker;
+    i.workerIndex = workerIndex;
   }
 
   static void* producer(void* pool) {
@@ -46,6 +65,16 @@ class PerPoolPerThreadInfo {
     return i.pool == pool ? i.producer : nullptr;
   }
 
+  static void* worker(void* pool) {
+    auto& i = info();
+    return i.pool == pool ? i.worker : nullptr;
+  }
+
+  static size_t workerIndex(const void* pool) {
+    auto& i = info();
+    return i.pool == pool ? i.workerIndex : kNoWorkerIndex;
+  }
+
   static bool isParForRecursive(void* pool) {
     auto& i = info();
     return (!i.pool || i.pool == pool) && i.parForRecursionLevel > 0;
@@ -59,6 +88,55 @@ class PerPoolPerThreadInfo {
     return ParForRecursion(info().parForRecursionLevel);
   }
 
+  static int parForRecursionLevel() {
+    return info().parForRecursionLevel;
+  }
+
+  // The calling thread's RCU reader record (see rcu.h), registered on the thread's first read.
+  static void* rcuRecord() {
+    return info().rcuRecord;
+  }
+
+  static void setRcuRecord(void* record) {
+    info().rcuRecord = record;
+  }
+
+  // The calling thread's reader record in the EpochDomain with the given ID (see
+  // epoch_domain.h).  Only the record for the domain the thread used last is cached here.
+  static void* epochRecord(uint64_t domain) {
+    auto& i = info();
+    return i.epochDomain == domain ? i.epochRecord : nullptr;
+  }
+
+  static void setEpochRecord(uint64_t domain, void* record) {
+    auto& i = info();
+    i.epochDomain = domain;
+    i.epochRecord = record;
+  }
+
+  // The calling thread's producer token for the pool with the given ID, for threads that are not
+  // the pool's own (see ThreadPool::externalProducer).  Only the token for the pool the thread
+  // submitted to last is cached here.
+  static void* externalProducer(uint64_t poolId) {
+    auto& i = info();
+    return i.externalPoolId == poolId ? i.externalProducer : nullptr;
+  }
+
+  static void setExternalProducer(uint64_t poolId, void* producer) {
+    auto& i = info();
+    i.externalPoolId = poolId;
+    i.externalProducer = producer;
+  }
+
+  // The fiber the calling thread is running (see fiber.h), or nullptr on the thread's own stack.
+  static void* fiber() {
+    return info().fiber;
+  }
+
+  static void setFiber(void* fiber) {
+    info().fiber = fiber;
+  }
+
  private:
   DISPENSO_DLL_ACCESS static PerThreadInfo& info();
 };
@@ -11,17 +11,128 @@
 #include <optional>
 #endif // C++17
 
+#include <mutex>
+#include <tuple>
+#include <utility>
+#include <vector>
+
 #include <dispenso/detail/completion_event_impl.h>
 #include <dispenso/detail/op_result.h>
 #include <dispenso/detail/result_of.h>
+#include <dispenso/detail/spsc_queue.h>
 #include <dispenso/task_set.h>
+#include <dispenso/timing.h>
 #include <dispenso/tsan_annotations.h>
 
 namespace dispenso {
 namespace detail {
 
 class LimitGatedScheduler {
+  class Impl;
+
  public:
+  // Shares a thread budget among the schedulers of a pipeline's kStageAuto stages.  Each such
+  // scheduler records how long its items run, and every kInterval seconds, one thread finishing an
+  // item splits the budget among the stages in proportion to the thread time each used recently.
+  // Stages with items waiting for a slot count double, since their use was capped by their limit.
+  // Stages that need little get at least one slot, and the rest go where the pipeline is
+  // bottlenecked.
+  class Tuner {
+   public:
+    static constexpr double kInterval = 0.002;
+
+    explicit Tuner(ssize_t poolThreads) : poolThreads_(poolThreads) {}
+
+    void add(LimitGatedScheduler& scheduler) {
+      stages_.push_back({scheduler.impl_.get()});
+    }
+
+    size_t numStages() const {
+      return stages_.size();
+    }
+
+    // Give every stage an equal share to start with.  Must be called once every stage is added,
+    // and before anything is scheduled.
+    void start() {
+      budget_ = std::max<ssize_t>(poolThreads_, static_cast<ssize_t>(stages_.size()));
+      ssize_t share = budget_ / static_cast<ssize_t>(stages_.size());
+      for (auto& stage : stages_) {
+        stage.impl->adjustLimit(share - stage.limit);
+        stage.limit = share;
+      }
+      nextTune_.store(getTime() + kInterval, std::memory_order_relaxed);
+    }
+
+    void maybeTune(double now) {
+      if (now < nextTune_.load(std::memory_order_relaxed) ||
+          tuning_.exchange(true, std::memory_order_acquire)) {
+        return;
+      }
+      if (now >= nextTune_.load(std::memory_order_relaxed)) {
+        tune();
+        nextTune_.store(now + kInterval, std::memory_order_relaxed);
+      }
+      tuning_.store(false, std::memory_order_release);
+    }
+
+   private:
+    struct TunedStage {
+      Impl* impl;
+      ssize_t limit = 1;
+      double weight = 0.0;
+      double share = 0.0;
+    };
+
+    void tune() {
+      double total = 0.0;
+      for (auto& stage : stages_) {
+        double used = stage.impl->takeBusySeconds();
+        if (stage.impl->backlogged()) {
+          used *= 2.0;
+        }
+        // Smooth over intervals, so that one noisy interval cannot swing the limits.
+        stage.weight = 0.5 * stage.weight + 0.5 * used;
+        total += stage.weight;
+      }
+      if (total <= 0.0) {
+        return;
+      }
+
+      // Round shares down, with a floor of one, and then hand leftover slots to the stages that
+      // lost the most to rounding.
+      ssize_t assigned = 0;
+      std::vector<ssize_t> targets(stages_.size());
+      for (size_t i = 0; i < stages_.size(); ++i) {
+        stages_[i].share = static_cast<double>(budget_) * stages_[i].weight / total;
+        targets[i] = std::max<ssize_t>(1, static_cast<ssize_t>(stages_[i].share));
+        assigned += targets[i];
+      }
+      for (; assigned < budget_; ++assigned) {
+        size_t best = 0;
+        for (size_t i = 1; i < stages_.size(); ++i) {
+          if (stages_[i].share - static_cast<double>(targets[i]) >
+              stages_[best].share - static_cast<double>(targets[best])) {
+            best = i;
+          }
+        }
+        ++targets[best];
+      }
+
+      for (size_t i = 0; i < stages_.size(); ++i) {
+        if (targets[i] != stages_[i].limit) {
+          stages_[i].impl->adjustLimit(targets[i] - stages_[i].limit);
+          stages_[i].limit = targets[i];
+        }
+      }
+    }
+
+    const ssize_t poolThreads_;
+    ssize_t budget_ = 1;
+    std::vector<TunedStage> stages_;
+    std::atomic<double> nextTune_{0.0};
+    std::atomic<bool> tuning_{false};
+  };
+
   LimitGatedScheduler(ConcurrentTaskSet& tasks, ssize_t res)
       : impl_(new (alignedMalloc(sizeof(Impl), alignof(Impl))) Impl(tasks, res)) {}
 
@@ -34,6 +145,32 @@ class LimitGatedScheduler {
     impl_->wait();
   }
 
+  // Switch a serial scheduler to hand items to a single draining task through a single-producer,
+  // single-consumer queue.  Only valid when the scheduler's resource limit is 1 and schedule() is
+  // never called concurrently with itself.  Must be called before anything is scheduled.
+  void setSerialHandOff(bool handOff) {
+    impl_->setSerialHandOff(handOff);
+  }
+
+  // The number of tasks scheduled through this scheduler that have not yet finished, whether
+  // running or queued.
+  size_t outstanding() const {
+    return impl_->outstanding();
+  }
+
+  // Hand this scheduler's limit over to tuner.  The scheduler must have been created with a limit
+  // of 1, and this must be called before anything is scheduled.
+  void setTuner(Tuner& tuner) {
+    impl_->setTuner(&tuner);
+    tuner.add(*this);
+  }
+
+  // Run a pending task from tasks' pool on the calling thread, if there is one.  For pipes that
+  // must wait on downstream progress.
+  static bool tryExecuteNext(ConcurrentTaskSet& tasks) {
+    return tasks.tryExecuteNext();
+  }
+
  private:
   // Put the guts within a unique_ptr to enable this type to be movable.
   class Impl {
@@ -41,10 +178,36 @@ class LimitGatedScheduler {
     Impl(ConcurrentTaskSet& tasks, ssize_t res)
         : tasks_(tasks), resources_(res), unlimited_(res == std::numeric_limits<ssize_t>::max()) {}
 
+    void setSerialHandOff(bool handOff) {
+      if (handOff && !handOff_) {
+        handOff_ = std::make_unique<SpscQueue<OnceFunction>>();
+      } else if (!handOff) {
+        handOff_.reset();
+      }
+    }
+
     template <typename F>
     void schedule(F&& fPipe) {
       outstanding_.fetch_add(1, std::memory_order_acq_rel);
 
+      if (handOff_) {
+        // The stage is serialized by the single drain task, so there is no slot to release.
+        handOff_->push(OnceFunction([this, fPipe = std::move(fPipe)]() mutable {
+          fPipe([]() {});
+          outstanding_.fetch_sub(1, std::memory_order_acq_rel);
+        }));
+        if (!draining_.exchange(true, std::memory_order_acq_rel)) {
+          // The drain counts as outstanding itself, since it still touches this after running the
+          // last item, and wait() must not return until it is done.
+          outstanding_.fetch_add(1, std::memory_order_acq_rel);
+          tasks_.schedule([this]() {
+            drain();
+            outstanding_.fetch_sub(1, std::memory_order_acq_rel);
+          });
+        }
+        return;
+      }
+
       if (unlimited_) {
         tasks_.schedule([this, fPipe = std::move(fPipe)]() mutable {
           fPipe([]() {});
@@ -55,27 +218,45 @@ class LimitGatedScheduler {
 
       DISPENSO_TSAN_ANNOTATE_IGNORE_WRITES_BEGIN();
       queue_.enqueue([this, fPipe = std::move(fPipe)]() mutable {
-        fPipe([this]() {
-          OnceFunction func;
-          if (queue_.try_dequeue(func)) {
-            tasks_.schedule(std::move(func));
-          } else {
-            resources_.fetch_add(1, std::memory_order_acq_rel);
-          }
-        });
+        if (tuner_) {
+          const double start = getTime();
+          fPipe([this, start]() { finishTuned(start); });
+        } else {
+          fPipe([this]() {
+            OnceFunction func;
+            if (queue_.try_dequeue(func)) {
+              tasks_.schedule(std::move(func));
+            } else {
+              resources_.fetch_add(1, std::memory_order_acq_rel);
+            }
+          });
+        }
         outstanding_.fetch_sub(1, std::memory_order_acq_rel);
       });
       DISPENSO_TSAN_ANNOTATE_IGNORE_WRITES_END();
 
-      while (resources_.fetch_sub(1, std::memory_order_acq_rel) > 0) {
-        OnceFunction func;
-        if (queue_.try_dequeue(func)) {
-          tasks_.schedule(std::move(func));
-        } else {
-          break;
-        }
+      dispatch();
+    }
+
+    void setTuner(Tuner* tuner) {
+      tuner_ = tuner;
+    }
+
+    // Grow or shrink the limit.  A shrink may leave resources_ negative, in which case finishing
+    // items return their slots until the count is back in range.
+    void adjustLimit(ssize_t delta) {
+      resources_.fetch_add(delta, std::memory_order_acq_rel);
+      if (delta > 0) {
+        dispatch();
       }
-      resources_.fetch_add(1, std::memory_order_acq_rel);
+    }
+
+    double takeBusySeconds() {
+      return static_cast<double>(busyNs_.exchange(0, std::memory_order_relaxed)) * 1e-9;
+    }
+
+    bool backlogged() const {
+      return queue_.size_approx() > 0;
     }
 
     void wait() {
@@ -97,7 +278,50 @@ class LimitGatedScheduler {
       }
     }
 
+    size_t outstanding() const {
+      return outstanding_.load(std::memory_order_acquire);
+    }
+
    private:
+    // Start queued items while there are free slots.
+    void dispatch() {
+      while (resources_.fetch_sub(1, std::memory_order_acq_rel) > 0) {
+        OnceFunction func;
+        if (queue_.try_dequeue(func)) {
+          tasks_.schedule(std::move(func));
+        } else {
+          break;
+        }
+      }
+      resources_.fetch_add(1, std::memory_order_acq_rel);
+    }
+
+    // A tuned stage's limit may change at any time, so a finished item returns its slot rather
+    // than passing it straight on to the next queued item.
+    void finishTuned(double start) {
+      const double now = getTime();
+      busyNs_.fetch_add(static_cast<uint64_t>((now - start) * 1e9), std::memory_order_relaxed);
+      resources_.fetch_add(1, std::memory_order_acq_rel);
+      dispatch();
+      tuner_->maybeTune(now);
+    }
+
+    // Run handed off items until the queue is empty.  An item pushed after the last pop but before
+    // draining_ is cleared is picked up by the recheck, since its producer saw draining_ set and
+    // did not schedule a drain of its own.
+    void drain() {
+      OnceFunction func;
+      while (true) {
+        while (handOff_->tryPop(func)) {
+          func();
+        }
+        draining_.exchange(false, std::memory_order_acq_rel);
+        if (handOff_->empty() || draining_.exchange(true, std::memory_order_acq_rel)) {
+          return;
+        }
+      }
+    }
+
     ConcurrentTaskSet& tasks_;
     alignas(kCacheLineSize) std::atomic<ssize_t> resources_;
     alignas(kCacheLineSize) std::atomic<size_t> outstanding_{0};
@@ -105,6 +329,10 @@ class LimitGatedScheduler {
     // Note: In benchmarks, this doesn't seem to help very much (~1%), but using it should lower
     // resource requirements because the queue_ never needs to instantiate memory.
     const bool unlimited_;
+    std::unique_ptr<SpscQueue<OnceFunction>> handOff_;
+    alignas(kCacheLineSize) std::atomic<bool> draining_{false};
+    Tuner* tuner_ = nullptr;
+    alignas(kCacheLineSize) std::atomic<uint64_t> busyNs_{0};
   };
 
   struct Deleter {
@@ -117,35 +345,305 @@ class LimitGatedScheduler {
   std::unique_ptr<Impl, Deleter> impl_;
 };
 
+// A Schedulable that holds on to the function it is given rather than running it, so that a Future
+// may be completed later by running the released function.
+class HeldInvoker {
+ public:
+  void schedule(OnceFunction f) {
+    f_ = std::move(f);
+  }
+  void schedule(OnceFunction f, ForceQueuingTag) {
+    f_ = std::move(f);
+  }
+  OnceFunction release() {
+    return std::move(f_);
+  }
+
+ private:
+  OnceFunction f_;
+};
+
 template <typename F>
 struct Stage {
-  Stage(F&& fIn, ssize_t limitIn) : f(std::move(fIn)), limit(limitIn) {}
+  Stage(F&& fIn, ssize_t limitIn, size_t capacityIn)
+      : f(std::move(fIn)), limit(limitIn), capacity(capacityIn) {}
+
+  Stage named(const char* nameIn) && {
+    name = nameIn;
+    return std::move(*this);
+  }
 
   template <typename T>
   auto operator()(T&& t) {
+    DISPENSO_TRACE_SCOPE(name);
     return f(std::forward<T>(t));
   }
 
   auto operator()() {
+    DISPENSO_TRACE_SCOPE(name);
     return f();
   }
 
   F f;
   ssize_t limit;
+  size_t capacity;
+  const char* name = nullptr;
+};
+
+template <typename F>
+struct OrderedStage {
+  OrderedStage(F&& fIn, size_t windowIn) : f(std::move(fIn)), window(windowIn) {}
+
+  OrderedStage named(const char* nameIn) && {
+    name = nameIn;
+    return std::move(*this);
+  }
+
+  template <typename T>
+  auto operator()(T&& t) {
+    DISPENSO_TRACE_SCOPE(name);
+    return f(std::forward<T>(t));
+  }
+
+  F f;
+  size_t window;
+  const char* name = nullptr;
+};
+
+constexpr size_t kDefaultFanOutCapacity = 256;
+
+// A stage that runs several branch functions on each item, concurrently, and then joins their
+// results through merge.
+template <typename Merge, typename... Branches>
+struct FanOutStage {
+  FanOutStage(std::tuple<Branches...>&& branchesIn, Merge&& mergeIn, size_t capacityIn)
+      : branches(std::move(branchesIn)),
+        merge(std::forward<Merge>(mergeIn)),
+        capacity(capacityIn) {}
+
+  // Run the branches and merge serially.  This defines the stage's result type; in a pipeline, the
+  // branches run as separate tasks.
+  template <typename T>
+  auto operator()(T&& item) {
+    return runSerial(item, std::index_sequence_for<Branches...>());
+  }
+
+  std::tuple<Branches...> branches;
+  Merge merge;
+  size_t capacity;
+
+ private:
+  template <typename T, size_t... Is>
+  auto runSerial(T& item, std::index_sequence<Is...>) {
+    const T& shared = item;
+    auto results = std::make_tuple(std::get<Is>(branches)(shared)...);
+    return merge(std::move(item), std::move(std::get<Is>(results))...);
+  }
+};
+
+template <typename... Branches>
+struct FanOut {
+  template <typename Merge>
+  FanOutStage<Merge, Branches...> join(Merge&& merge, size_t capacity = kDefaultFanOutCapacity) && {
+    return FanOutStage<Merge, Branches...>(
+        std::move(branches), std::forward<Merge>(merge), capacity);
+  }
+
+  std::tuple<Branches...> branches;
+};
+
+template <typename T>
+struct IsOrderedStage : std::false_type {};
+
+template <typename F>
+struct IsOrderedStage<OrderedStage<F>> : std::true_type {};
+
+template <typename T>
+struct IsFanOutStage : std::false_type {};
+
+template <typename Merge, typename... Branches>
+struct IsFanOutStage<FanOutStage<Merge, Branches...>> : std::true_type {};
+
+template <typename T>
+struct OptionalStrippedTraits {
+  using Type = T;
+};
+
+#if __cplusplus >= 201703L
+template <typename T>
+struct OptionalStrippedTraits<std::optional<T>> {
+  using Type = T;
+};
+#endif // C++17
+
+template <typename T>
+struct OptionalStrippedTraits<OpResult<T>> {
+  using Type = T;
+};
+
+template <typename T>
+struct IsOptionalLike : std::false_type {};
+
+#if __cplusplus >= 201703L
+template <typename T>
+struct IsOptionalLike<std::optional<T>> : std::true_type {};
+#endif // C++17
+
+template <typename T>
+struct IsOptionalLike<OpResult<T>> : std::true_type {};
+
+template <typename Gen>
+class BatchGenerator {
+ public:
+  using Item = std::decay_t<typename OptionalStrippedTraits<ResultOf<Gen>>::Type>;
+
+  BatchGenerator(Gen&& gen, size_t maxItems, double maxSeconds)
+      : gen_(std::forward<Gen>(gen)),
+        maxItems_(std::max<size_t>(1, maxItems)),
+        maxSeconds_(maxSeconds) {}
+
+  BatchGenerator(BatchGenerator&& other)
+      : gen_(std::forward<Gen>(other.gen_)),
+        maxItems_(other.maxItems_),
+        maxSeconds_(other.maxSeconds_),
+        done_(other.done_.load(std::memory_order_relaxed)) {}
+
+  OpResult<std::vector<Item>> operator()() {
+    // Once the wrapped generator has reported the end, it must not be called again.
+    if (done_.load(std::memory_order_acquire)) {
+      return {};
+    }
+    std::vector<Item> batch;
+    batch.reserve(maxItems_);
+    double start = 0.0;
+    while (batch.size() < maxItems_) {
+      auto op = gen_();
+      if (!op) {
+        done_.store(true, std::memory_order_release);
+        break;
+      }
+      batch.push_back(std::move(op.value()));
+      if (maxSeconds_ > 0.0) {
+        if (batch.size() == 1) {
+          start = getTime();
+        } else if (getTime() - start >= maxSeconds_) {
+          break;
+        }
+      }
+    }
+    if (batch.empty()) {
+      return {};
+    }
+    return batch;
+  }
+
+ private:
+  Gen gen_;
+  size_t maxItems_;
+  double maxSeconds_;
+  std::atomic<bool> done_{false};
 };
 
+// How a per-item function is applied across a batch: 0 for sinks, 1 for filtering transforms, 2 for
+// transforms that keep the item type, and 3 for other transforms.
+template <typename R, typename T>
+struct BatchKind
+    : std::integral_constant<
+          int,
+          IsOptionalLike<R>::value ? 1 : (std::is_same<std::decay_t<R>, T>::value ? 2 : 3)> {};
+
+template <typename T>
+struct BatchKind<void, T> : std::integral_constant<int, 0> {};
+
+template <typename F>
+class BatchedStage {
+ public:
+  BatchedStage(F&& f) : f_(std::forward<F>(f)) {}
+
+  template <typename T>
+  auto operator()(std::vector<T> batch) {
+    using R = decltype(f_(std::move(batch[0])));
+    return apply(std::move(batch), BatchKind<R, T>());
+  }
+
+ private:
+  // Sink: consume each item.
+  template <typename T>
+  void apply(std::vector<T> batch, std::integral_constant<int, 0>) {
+    for (auto& item : batch) {
+      f_(std::move(item));
+    }
+  }
+
+  // Filtering transform: keep the items that pass, and drop the batch entirely if none do.
+  template <typename T>
+  auto apply(std::vector<T> batch, std::integral_constant<int, 1>) {
+    using R = decltype(f_(std::move(batch[0])));
+    using U = std::decay_t<typename OptionalStrippedTraits<R>::Type>;
+    std::vector<U> out;
+    out.reserve(batch.size());
+    for (auto& item : batch) {
+      auto op = f_(std::move(item));
+      if (op) {
+        out.push_back(std::move(op.value()));
+      }
+    }
+    if (out.empty()) {
+      return OpResult<std::vector<U>>();
+    }
+    return OpResult<std::vector<U>>(std::move(out));
+  }
+
+  // Type-preserving transform: reuse the batch's storage.
+  template <typename T>
+  std::vector<T> apply(std::vector<T> batch, std::integral_constant<int, 2>) {
+    for (auto& item : batch) {
+      item = f_(std::move(item));
+    }
+    return batch;
+  }
+
+  template <typename T>
+  auto apply(std::vector<T> batch, std::integral_constant<int, 3>) {
+    std::vector<std::decay_t<decltype(f_(std::move(batch[0])))>> out;
+    out.reserve(batch.size());
+    for (auto& item : batch) {
+      out.push_back(f_(std::move(item)));
+    }
+    return out;
+  }
+
+  F f_;
+};
+
+// Marks a stage whose limit is picked by the pipeline (see kStageAuto in pipeline.h).
+constexpr ssize_t kAutoStageLimit = std::numeric_limits<ssize_t>::min();
+
 template <typename T>
 struct StageLimits {
   constexpr static ssize_t limit(const T& /*t*/) {
     return 1;
   }
+  constexpr static size_t capacity(const T& /*t*/) {
+    return std::numeric_limits<size_t>::max();
+  }
+  constexpr static bool tuned(const T& /*t*/) {
+    return false;
+  }
 };
 
 template <typename T>
 struct StageLimits<Stage<T>> {
+  // Tuned stages start out serial, until their tuner hands out slots.
   static ssize_t limit(const Stage<T>& t) {
     return std::max(ssize_t{1}, t.limit);
   }
+  static size_t capacity(const Stage<T>& t) {
+    return std::max(size_t{1}, t.capacity);
+  }
+  static bool tuned(const Stage<T>& t) {
+    return t.limit == kAutoStageLimit;
+  }
 };
 
 enum class StageClass { kSingleStage, kGenerator, kOpTransform, kTransform, kSink };
@@ -167,23 +665,6 @@ struct TransformTraits<OpResult<T>> {
   static constexpr StageClass kStageClass = StageClass::kOpTransform;
 };
 
-template <typename T>
-struct OptionalStrippedTraits {
-  using Type = T;
-};
-
-#if __cplusplus >= 201703L
-template <typename T>
-struct OptionalStrippedTraits<std::optional<T>> {
-  using Type = T;
-};
-#endif // C++17
-
-template <typename T>
-struct OptionalStrippedTraits<OpResult<T>> {
-  using Type = T;
-};
-
 struct SinkPipe {};
 
 template <StageClass stageClass, typename CurStage, typename PipeNext>
@@ -196,17 +677,81 @@ class TransformPipe {
   TransformPipe(ConcurrentTaskSet& tasks, StageIn&& s, PipeNext&& n)
       : stage_(std::forward<StageIn>(s)),
         tasks_(tasks, StageLimits<CurStage>::limit(stage_)),
-        pipeNext_(std::move(n)) {}
+        capacity_(StageLimits<CurStage>::capacity(stage_)),
+        pipeNext_(std::move(n)),
+        fuseNext_(fusible() && pipeNext_.fusible()) {}
 
   void wait() {
     tasks_.wait();
     pipeNext_.wait();
   }
 
+  // Whether every stage from here on has room in its queue for another item.
+  bool hasRoom() const {
+    return (capacity_ == std::numeric_limits<size_t>::max() || tasks_.outstanding() < capacity_) &&
+        pipeNext_.hasRoom();
+  }
+
+  // The number of items that have left the pipeline, either through the sink or by being filtered.
+  size_t retired() const {
+    return pipeNext_.retired();
+  }
+
+  // An input with sequence number seq was filtered out upstream.
+  void skip(size_t seq) {
+    pipeNext_.skip(seq);
+  }
+
+  // Whether the generator may emit an item with sequence number seq without overflowing the reorder
+  // window of any ordered stage downstream.
+  bool admits(size_t seq) const {
+    return pipeNext_.admits(seq);
+  }
+
+  // Called before execution with whether this stage's inputs are produced by a single serialized
+  // producer.  A serial stage fed that way hands items off through an SPSC queue, and in turn
+  // produces serially for the next stage.
+  void setSerialInput(bool serial) {
+    bool handOff = serial && StageLimits<CurStage>::limit(stage_) == 1 &&
+        !StageLimits<CurStage>::tuned(stage_);
+    tasks_.setSerialHandOff(handOff);
+    pipeNext_.setSerialInput(handOff);
+  }
+
+  // Register every tuned stage from here on with tuner.
+  void setTuner(LimitGatedScheduler::Tuner& tuner) {
+    if (StageLimits<CurStage>::tuned(stage_)) {
+      tasks_.setTuner(tuner);
+    }
+    pipeNext_.setTuner(tuner);
+  }
+
+  // Whether this stage may be run inline by the task of the stage before it.  An unlimited stage
+  // with an unbounded queue has nothing to gate, so a separate task per item buys nothing.
+  bool fusible() const {
+    return StageLimits<CurStage>::limit(stage_) == std::numeric_limits<ssize_t>::max() &&
+        capacity_ == std::numeric_limits<size_t>::max();
+  }
+
+  static constexpr bool kOrdered = PipeNext::kOrdered;
+
  protected:
+  // Pass a result on, running the next stage inline when both stages are fusible.  Chains of
+  // fusible stages then cost a single task per item.
+  template <typename Result>
+  void forward(Result&& res, size_t seq) {
+    if (fuseNext_) {
+      pipeNext_.run(std::forward<Result>(res), seq);
+    } else {
+      pipeNext_.execute(std::forward<Result>(res), seq);
+    }
+  }
+
   CurStage stage_;
   LimitGatedScheduler tasks_;
+  size_t capacity_;
   PipeNext pipeNext_;
+  bool fuseNext_;
 };
 
 template <typename CurStage, typename PipeNext>
@@ -217,13 +762,20 @@ class Pipe<StageClass::kTransform, CurStage, PipeNext> : public TransformPipe<Cu
       : TransformPipe<CurStage, PipeNext>(tasks, std::forward<StageIn>(s), std::move(n)) {}
 
   template <typename Input>
-  void execute(Input&& input) {
-    this->tasks_.schedule([input = std::move(input), this](auto&& stageCompleteFunc) mutable {
+  void execute(Input&& input, size_t seq) {
+    this->tasks_.schedule([input = std::move(input), seq, this](auto&& stageCompleteFunc) mutable {
       auto&& res = this->stage_(std::move(input));
       stageCompleteFunc();
-      this->pipeNext_.execute(res);
+      this->forward(res, seq);
     });
   }
+
+  // Run the stage on the calling thread, for a fused upstream stage.
+  template <typename Input>
+  void run(Input&& input, size_t seq) {
+    auto&& res = this->stage_(std::move(input));
+    this->forward(res, seq);
+  }
 };
 
 template <typename CurStage, typename PipeNext>
@@ -235,15 +787,28 @@ class Pipe<StageClass::kOpTransform, CurStage, PipeNext>
       : TransformPipe<CurStage, PipeNext>(tasks, std::forward<StageIn>(s), std::move(n)) {}
 
   template <typename Input>
-  void execute(Input&& input) {
-    this->tasks_.schedule([input = std::move(input), this](auto&& stageCompleteFunc) mutable {
+  void execute(Input&& input, size_t seq) {
+    this->tasks_.schedule([input = std::move(input), seq, this](auto&& stageCompleteFunc) mutable {
       auto op = this->stage_(std::move(input));
       stageCompleteFunc();
       if (op) {
-        this->pipeNext_.execute(std::move(op.value()));
+        this->forward(std::move(op.value()), seq);
+      } else {
+        this->pipeNext_.skip(seq);
       }
     });
   }
+
+  // Run the stage on the calling thread, for a fused upstream stage.
+  template <typename Input>
+  void run(Input&& input, size_t seq) {
+    auto op = this->stage_(std::move(input));
+    if (op) {
+      this->forward(std::move(op.value()), seq);
+    } else {
+      this->pipeNext_.skip(seq);
+    }
+  }
 };
 
 template <typename CurStage, typename PipeNext>
@@ -253,26 +818,81 @@ class Pipe<StageClass::kGenerator, CurStage, PipeNext> {
   Pipe(ConcurrentTaskSet& tasks, StageIn&& s, PipeNext&& n)
       : tasks_(tasks), stage_(std::forward<StageIn>(s)), pipeNext_(std::move(n)) {}
 
+  Pipe(Pipe&& other)
+      : tasks_(other.tasks_),
+        completion_(std::move(other.completion_)),
+        stage_(std::forward<CurStage>(other.stage_)),
+        pipeNext_(std::move(other.pipeNext_)),
+        tuner_(std::move(other.tuner_)),
+        maxInFlight_(other.maxInFlight_) {}
+
+  // Bound the number of items between the generator and the end of the pipeline; zero means
+  // unbounded.
+  void setMaxInFlight(size_t maxInFlight) {
+    maxInFlight_ = maxInFlight;
+  }
+
   void execute() {
     ssize_t numThreads = std::max<ssize_t>(
         1, std::min(tasks_.numPoolThreads(), StageLimits<CurStage>::limit(stage_)));
     completion_ = std::make_unique<CompletionEventImpl>(static_cast<int>(numThreads));
+    pipeNext_.setSerialInput(numThreads == 1);
+    auto tuner = std::make_unique<LimitGatedScheduler::Tuner>(tasks_.numPoolThreads());
+    pipeNext_.setTuner(*tuner);
+    if (tuner->numStages()) {
+      tuner->start();
+      tuner_ = std::move(tuner);
+    }
     for (ssize_t i = 0; i < numThreads; ++i) {
       tasks_.schedule([this]() {
-        while (auto op = stage_()) {
-          pipeNext_.execute(std::move(op.value()));
+        while (true) {
+          waitForRoom();
+          auto op = stage_();
+          if (!op) {
+            // Release any other generator threads waiting for room; they will find the end too.
+            finished_.store(true, std::memory_order_release);
+            break;
+          }
+          size_t seq = 0;
+          if (PipeNext::kOrdered) {
+            // Stamp each item with its position in the stream, and hold it back while it would
+            // fall outside an ordered stage's reorder window, helping with other work meanwhile.
+            seq = nextSeq_.fetch_add(1, std::memory_order_relaxed);
+            while (!pipeNext_.admits(seq)) {
+              if (!LimitGatedScheduler::tryExecuteNext(tasks_)) {
+                std::this_thread::yield();
+              }
+            }
+          }
+          pipeNext_.execute(std::move(op.value()), seq);
         }
         // fetch_sub returns the previous value, so if it was 1, that means no items are left.
         // notify wouldn't technically require the value to be set, since the underlying status
         // is already zero, but we just use the current notify interface, as this is unlikely to be
         // any kind of bottleneck.
         if (completion_->intrusiveStatus().fetch_sub(1, std::memory_order_acq_rel) == 1) {
-          completion_->notify(0);
+          if (async_) {
+            // Nobody is waiting, so finish off the downstream stages here.  onDone may destroy
+            // this pipe, so nothing may be touched after it is called.
+            pipeNext_.wait();
+            OnceFunction onDone = std::move(onDone_);
+            onDone();
+          } else {
+            completion_->notify(0);
+          }
         }
       });
     }
   }
 
+  // As execute(), but rather than the pipeline being waited for, onDone is called once the whole
+  // pipeline has completed.  The caller must not call wait().
+  void execute(OnceFunction onDone) {
+    async_ = true;
+    onDone_ = std::move(onDone);
+    execute();
+  }
+
   void wait() {
     completion_->wait(0);
     pipeNext_.wait();
@@ -280,10 +900,32 @@ class Pipe<StageClass::kGenerator, CurStage, PipeNext> {
   }
 
  private:
+  // Hold off generating while the pipeline is at its in-flight limit, or any stage's queue is full,
+  // helping run pipeline work meanwhile.  Each generator call takes a ticket, and a ticket is let
+  // through only once fewer than maxInFlight_ earlier items remain in the pipeline.
+  void waitForRoom() {
+    size_t ticket = maxInFlight_ ? issued_.fetch_add(1, std::memory_order_relaxed) : 0;
+    while (!finished_.load(std::memory_order_acquire) &&
+           ((maxInFlight_ && ticket >= pipeNext_.retired() + maxInFlight_) ||
+            !pipeNext_.hasRoom())) {
+      if (!LimitGatedScheduler::tryExecuteNext(tasks_)) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
   ConcurrentTaskSet& tasks_;
   std::unique_ptr<CompletionEventImpl> completion_;
   CurStage stage_;
   PipeNext pipeNext_;
+  // Shares the pool among the kStageAuto stages, if there are any.
+  std::unique_ptr<LimitGatedScheduler::Tuner> tuner_;
+  size_t maxInFlight_ = 0;
+  bool async_ = false;
+  OnceFunction onDone_;
+  std::atomic<size_t> nextSeq_{0};
+  std::atomic<size_t> issued_{0};
+  std::atomic<bool> finished_{false};
 };
 
 template <typename CurStage>
@@ -292,6 +934,11 @@ class Pipe<StageClass::kSingleStage, CurStage, SinkPipe> {
   template <typename StageIn>
   Pipe(ConcurrentTaskSet& tasks, StageIn&& s) : tasks_(tasks), stage_(std::forward<StageIn>(s)) {}
 
+  Pipe(Pipe&& other) : tasks_(other.tasks_), stage_(std::forward<CurStage>(other.stage_)) {}
+
+  // A single stage pipeline has no items in flight.
+  void setMaxInFlight(size_t /*maxInFlight*/) {}
+
   void execute() {
     size_t numThreads = std::min(tasks_.numPoolThreads(), StageLimits<CurStage>::limit(stage_));
     for (size_t i = 0; i < numThreads; ++i) {
@@ -302,6 +949,26 @@ class Pipe<StageClass::kSingleStage, CurStage, SinkPipe> {
     }
   }
 
+  // As execute(), but rather than the pipeline being waited for, onDone is called by the last
+  // thread to finish.  The caller must not call wait().
+  void execute(OnceFunction onDone) {
+    ssize_t numThreads = std::max<ssize_t>(
+        1, std::min(tasks_.numPoolThreads(), StageLimits<CurStage>::limit(stage_)));
+    remaining_ = numThreads;
+    onDone_ = std::move(onDone);
+    for (ssize_t i = 0; i < numThreads; ++i) {
+      tasks_.schedule([this]() {
+        while (stage_()) {
+        }
+        if (remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+          // onDone may destroy this pipe.
+          OnceFunction onDone = std::move(onDone_);
+          onDone();
+        }
+      });
+    }
+  }
+
   void wait() {
     tasks_.wait();
   }
@@ -309,6 +976,8 @@ class Pipe<StageClass::kSingleStage, CurStage, SinkPipe> {
  private:
   ConcurrentTaskSet& tasks_;
   CurStage stage_;
+  std::atomic<ssize_t> remaining_{0};
+  OnceFunction onDone_;
 };
 
 template <typename CurStage>
@@ -316,28 +985,516 @@ class Pipe<StageClass::kSink, CurStage, SinkPipe> {
  public:
   template <typename StageIn>
   Pipe(ConcurrentTaskSet& tasks, StageIn&& s)
-      : stage_(std::forward<StageIn>(s)), tasks_(tasks, StageLimits<CurStage>::limit(stage_)) {}
+      : stage_(std::forward<StageIn>(s)),
+        tasks_(tasks, StageLimits<CurStage>::limit(stage_)),
+        capacity_(StageLimits<CurStage>::capacity(stage_)) {}
+
+  Pipe(Pipe&& other)
+      : stage_(std::forward<CurStage>(other.stage_)),
+        tasks_(std::move(other.tasks_)),
+        capacity_(other.capacity_) {}
 
   template <typename Input>
-  void execute(Input&& input) {
+  void execute(Input&& input, size_t /*seq*/) {
     tasks_.schedule([input = std::move(input), this](auto&& stageCompleteFunc) mutable {
       stage_(std::move(input));
       stageCompleteFunc();
+      retired_.fetch_add(1, std::memory_order_release);
     });
   }
 
+  // Run the stage on the calling thread, for a fused upstream stage.
+  template <typename Input>
+  void run(Input&& input, size_t /*seq*/) {
+    stage_(std::move(input));
+    retired_.fetch_add(1, std::memory_order_release);
+  }
+
+  void skip(size_t /*seq*/) {
+    retired_.fetch_add(1, std::memory_order_release);
+  }
+
+  bool admits(size_t /*seq*/) const {
+    return true;
+  }
+
+  bool hasRoom() const {
+    return capacity_ == std::numeric_limits<size_t>::max() || tasks_.outstanding() < capacity_;
+  }
+
+  bool fusible() const {
+    return StageLimits<CurStage>::limit(stage_) == std::numeric_limits<ssize_t>::max() &&
+        capacity_ == std::numeric_limits<size_t>::max();
+  }
+
+  size_t retired() const {
+    return retired_.load(std::memory_order_acquire);
+  }
+
   void wait() {
     tasks_.wait();
   }
 
+  void setSerialInput(bool serial) {
+    tasks_.setSerialHandOff(
+        serial && StageLimits<CurStage>::limit(stage_) == 1 &&
+        !StageLimits<CurStage>::tuned(stage_));
+  }
+
+  void setTuner(LimitGatedScheduler::Tuner& tuner) {
+    if (StageLimits<CurStage>::tuned(stage_)) {
+      tasks_.setTuner(tuner);
+    }
+  }
+
+  static constexpr bool kOrdered = false;
+
  private:
   CurStage stage_;
   LimitGatedScheduler tasks_;
+  size_t capacity_;
+  std::atomic<size_t> retired_{0};
+};
+
+// A serial stage that runs its inputs in sequence order.  Inputs arriving ahead of their turn are
+// parked in a ring of window slots; whichever thread delivers the next expected input drains the
+// ring, running the stage inline, while other arrivals just park and leave.  The generator keeps
+// every sequence number within the window, so slots are never overrun.
+template <StageClass stageClass, typename CurStage, typename PipeNext, typename InputT>
+class OrderedPipe {
+ public:
+  template <typename StageIn>
+  OrderedPipe(ConcurrentTaskSet& /*tasks*/, StageIn&& s, PipeNext&& n)
+      : stage_(std::forward<StageIn>(s)),
+        pipeNext_(std::move(n)),
+        slots_(std::max<size_t>(1, stage_.window)) {}
+
+  OrderedPipe(OrderedPipe&& other)
+      : stage_(std::forward<CurStage>(other.stage_)),
+        pipeNext_(std::move(other.pipeNext_)),
+        slots_(std::move(other.slots_)) {}
+
+  template <typename Input>
+  void execute(Input&& input, size_t seq) {
+    arrive(OpResult<InputT>(std::move(input)), seq);
+  }
+
+  void skip(size_t seq) {
+    arrive(OpResult<InputT>(), seq);
+  }
+
+  // execute() already runs on the delivering thread, so there is nothing to fuse.
+  bool fusible() const {
+    return false;
+  }
+
+  template <typename Input>
+  void run(Input&& input, size_t seq) {
+    execute(std::forward<Input>(input), seq);
+  }
+
+  bool admits(size_t seq) const {
+    return seq < nextSeq_.load(std::memory_order_acquire) + slots_.size() &&
+        pipeNext_.admits(seq);
+  }
+
+  bool hasRoom() const {
+    return pipeNext_.hasRoom();
+  }
+
+  size_t retired() const {
+    return pipeNext_.retired();
+  }
+
+  void wait() {
+    pipeNext_.wait();
+  }
+
+  // Only the draining thread runs the stage, so the next stage always has a serial producer.
+  void setSerialInput(bool /*serial*/) {
+    pipeNext_.setSerialInput(true);
+  }
+
+  void setTuner(LimitGatedScheduler::Tuner& tuner) {
+    pipeNext_.setTuner(tuner);
+  }
+
+  static constexpr bool kOrdered = true;
+
+ private:
+  struct Slot {
+    OpResult<InputT> value;
+    bool ready = false;
+  };
+
+  void arrive(OpResult<InputT>&& value, size_t seq) {
+    std::unique_lock<std::mutex> lk(mutex_);
+    Slot& slot = slots_[seq % slots_.size()];
+    slot.value = std::move(value);
+    slot.ready = true;
+    if (draining_) {
+      return;
+    }
+    draining_ = true;
+    while (true) {
+      size_t next = nextSeq_.load(std::memory_order_relaxed);
+      Slot& cur = slots_[next % slots_.size()];
+      if (!cur.ready) {
+        break;
+      }
+      OpResult<InputT> item = std::move(cur.value);
+      cur.value = OpResult<InputT>();
+      cur.ready = false;
+      nextSeq_.store(next + 1, std::memory_order_release);
+      lk.unlock();
+      if (item) {
+        run(std::move(item.value()), next, std::integral_constant<StageClass, stageClass>());
+      } else {
+        skipNext(next);
+      }
+      lk.lock();
+    }
+    draining_ = false;
+  }
+
+  void run(InputT&& input, size_t seq, std::integral_constant<StageClass, StageClass::kTransform>) {
+    auto&& res = stage_(std::move(input));
+    pipeNext_.execute(res, seq);
+  }
+
+  void
+  run(InputT&& input, size_t seq, std::integral_constant<StageClass, StageClass::kOpTransform>) {
+    auto op = stage_(std::move(input));
+    if (op) {
+      pipeNext_.execute(std::move(op.value()), seq);
+    } else {
+      pipeNext_.skip(seq);
+    }
+  }
+
+  void run(InputT&& input, size_t seq, std::integral_constant<StageClass, StageClass::kSink>) {
+    stage_(std::move(input));
+    // Let the end of the chain count the item as retired.
+    pipeNext_.skip(seq);
+  }
+
+  void skipNext(size_t seq) {
+    pipeNext_.skip(seq);
+  }
+
+  CurStage stage_;
+  PipeNext pipeNext_;
+  std::vector<Slot> slots_;
+  std::mutex mutex_;
+  bool draining_ = false;
+  std::atomic<size_t> nextSeq_{0};
+};
+
+// The end of the pipe chain past an ordered or fan-out sink, which just counts retired items.
+struct OrderedSinkEnd {
+  OrderedSinkEnd() = default;
+  OrderedSinkEnd(OrderedSinkEnd&& other)
+      : retired_(other.retired_.load(std::memory_order_relaxed)) {}
+
+  template <typename Input>
+  void execute(Input&&, size_t) {}
+  void skip(size_t) {
+    retired_.fetch_add(1, std::memory_order_release);
+  }
+  bool admits(size_t) const {
+    return true;
+  }
+  bool hasRoom() const {
+    return true;
+  }
+  size_t retired() const {
+    return retired_.load(std::memory_order_acquire);
+  }
+  void wait() {}
+  void setSerialInput(bool) {}
+  void setTuner(LimitGatedScheduler::Tuner&) {}
+  static constexpr bool kOrdered = false;
+
+  std::atomic<size_t> retired_{0};
+};
+
+template <typename InputT, typename Branches>
+struct FanOutResults;
+
+template <typename InputT, typename... Branches>
+struct FanOutResults<InputT, std::tuple<Branches...>> {
+  using Type = std::tuple<OpResult<std::decay_t<ResultOf<Branches, const InputT&>>>...>;
+};
+
+// Runs a FanOutStage.  Each item is moved once into a join node, which every branch reads through
+// a const reference, from tasks gated by the branch's own limit.  The thread that finishes an
+// item's last branch runs the merge and passes its result on.  Join nodes count against the
+// stage's capacity, which bounds the items held between the split and the merge.
+template <StageClass mergeClass, typename CurStage, typename PipeNext, typename InputT>
+class FanOutPipe {
+  using Branches = decltype(std::decay_t<CurStage>::branches);
+  static constexpr size_t kNumBranches = std::tuple_size<Branches>::value;
+  using Indices = std::make_index_sequence<kNumBranches>;
+
+  template <size_t I>
+  using Branch = std::decay_t<std::tuple_element_t<I, Branches>>;
+
+  struct Join {
+    Join(InputT&& itemIn, size_t seqIn) : item(std::move(itemIn)), seq(seqIn) {}
+
+    InputT item;
+    typename FanOutResults<InputT, Branches>::Type results;
+    std::atomic<size_t> remaining{kNumBranches};
+    size_t seq;
+  };
+
+ public:
+  template <typename StageIn>
+  FanOutPipe(ConcurrentTaskSet& tasks, StageIn&& s, PipeNext&& n)
+      : stage_(std::forward<StageIn>(s)),
+        capacity_(std::max<size_t>(1, stage_.capacity)),
+        pipeNext_(std::move(n)) {
+    makeSchedulers(tasks, Indices());
+  }
+
+  FanOutPipe(FanOutPipe&& other)
+      : stage_(std::forward<CurStage>(other.stage_)),
+        branchTasks_(std::move(other.branchTasks_)),
+        capacity_(other.capacity_),
+        pipeNext_(std::move(other.pipeNext_)) {}
+
+  template <typename Input>
+  void execute(Input&& input, size_t seq) {
+    pending_.fetch_add(1, std::memory_order_acq_rel);
+    Join* join = new Join(InputT(std::move(input)), seq);
+    scheduleBranches(join, Indices());
+  }
+
+  // Branches always run as tasks of their own, so there is nothing to fuse.
+  bool fusible() const {
+    return false;
+  }
+
+  template <typename Input>
+  void run(Input&& input, size_t seq) {
+    execute(std::forward<Input>(input), seq);
+  }
+
+  void skip(size_t seq) {
+    pipeNext_.skip(seq);
+  }
+
+  bool admits(size_t seq) const {
+    return pipeNext_.admits(seq);
+  }
+
+  bool hasRoom() const {
+    return pending_.load(std::memory_order_acquire) < capacity_ && pipeNext_.hasRoom();
+  }
+
+  size_t retired() const {
+    return pipeNext_.retired();
+  }
+
+  // An item's merge runs inside its last branch task, so once every branch is idle, so are the
+  // merges.
+  void wait() {
+    for (auto& tasks : branchTasks_) {
+      tasks.wait();
+    }
+    pipeNext_.wait();
+  }
+
+  // Each branch is fed by whoever feeds this stage, but merges run on whichever branch finishes
+  // last.
+  void setSerialInput(bool serial) {
+    setBranchesSerialInput(serial, Indices());
+    pipeNext_.setSerialInput(false);
+  }
+
+  void setTuner(LimitGatedScheduler::Tuner& tuner) {
+    setBranchesTuner(tuner, Indices());
+    pipeNext_.setTuner(tuner);
+  }
+
+  static constexpr bool kOrdered = PipeNext::kOrdered;
+
+ private:
+  template <size_t I>
+  const Branch<I>& branch() const {
+    return std::get<I>(stage_.branches);
+  }
+
+  template <size_t... Is>
+  void makeSchedulers(ConcurrentTaskSet& tasks, std::index_sequence<Is...>) {
+    branchTasks_.reserve(kNumBranches);
+    int dummy[] = {
+        0, (branchTasks_.emplace_back(tasks, StageLimits<Branch<Is>>::limit(branch<Is>())), 0)...};
+    (void)dummy;
+  }
+
+  template <size_t... Is>
+  void setBranchesSerialInput(bool serial, std::index_sequence<Is...>) {
+    int dummy[] = {
+        0,
+        (branchTasks_[Is].setSerialHandOff(
+             serial && StageLimits<Branch<Is>>::limit(branch<Is>()) == 1 &&
+             !StageLimits<Branch<Is>>::tuned(branch<Is>())),
+         0)...};
+    (void)dummy;
+  }
+
+  template <size_t... Is>
+  void setBranchesTuner(LimitGatedScheduler::Tuner& tuner, std::index_sequence<Is...>) {
+    int dummy[] = {
+        0,
+        (StageLimits<Branch<Is>>::tuned(branch<Is>()) ? branchTasks_[Is].setTuner(tuner)
+                                                       : void(),
+         0)...};
+    (void)dummy;
+  }
+
+  template <size_t... Is>
+  void scheduleBranches(Join* join, std::index_sequence<Is...>) {
+    int dummy[] = {0, (scheduleBranch<Is>(join), 0)...};
+    (void)dummy;
+  }
+
+  template <size_t I>
+  void scheduleBranch(Join* join) {
+    branchTasks_[I].schedule([join, this](auto&& stageCompleteFunc) {
+      const InputT& item = join->item;
+      std::get<I>(join->results) = std::get<I>(stage_.branches)(item);
+      stageCompleteFunc();
+      if (join->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        finish(join, Indices(), std::integral_constant<StageClass, mergeClass>());
+      }
+    });
+  }
+
+  template <size_t... Is>
+  auto merge(Join* join, std::index_sequence<Is...>) {
+    return stage_.merge(std::move(join->item), std::move(std::get<Is>(join->results).value())...);
+  }
+
+  void release(Join* join) {
+    delete join;
+    pending_.fetch_sub(1, std::memory_order_acq_rel);
+  }
+
+  template <size_t... Is>
+  void finish(
+      Join* join,
+      std::index_sequence<Is...> indices,
+      std::integral_constant<StageClass, StageClass::kTransform>) {
+    auto res = merge(join, indices);
+    size_t seq = join->seq;
+    release(join);
+    pipeNext_.execute(std::move(res), seq);
+  }
+
+  template <size_t... Is>
+  void finish(
+      Join* join,
+      std::index_sequence<Is...> indices,
+      std::integral_constant<StageClass, StageClass::kOpTransform>) {
+    auto op = merge(join, indices);
+    size_t seq = join->seq;
+    release(join);
+    if (op) {
+      pipeNext_.execute(std::move(op.value()), seq);
+    } else {
+      pipeNext_.skip(seq);
+    }
+  }
+
+  template <size_t... Is>
+  void finish(
+      Join* join,
+      std::index_sequence<Is...> indices,
+      std::integral_constant<StageClass, StageClass::kSink>) {
+    merge(join, indices);
+    size_t seq = join->seq;
+    release(join);
+    // Let the end of the chain count the item as retired.
+    pipeNext_.skip(seq);
+  }
+
+  CurStage stage_;
+  std::vector<LimitGatedScheduler> branchTasks_;
+  size_t capacity_;
+  PipeNext pipeNext_;
+  alignas(kCacheLineSize) std::atomic<size_t> pending_{0};
+};
+
+template <typename InputType, typename Stage0, bool kIsOrdered, bool kIsFanOut>
+struct SinkPipeFor {
+  using Type = Pipe<StageClass::kSink, Stage0, SinkPipe>;
+  static Type make(ConcurrentTaskSet& tasks, Stage0&& s) {
+    return Type(tasks, std::forward<Stage0>(s));
+  }
+};
+
+template <typename InputType, typename Stage0>
+struct SinkPipeFor<InputType, Stage0, true, false> {
+  using Type = OrderedPipe<
+      StageClass::kSink,
+      Stage0,
+      OrderedSinkEnd,
+      std::decay_t<typename OptionalStrippedTraits<InputType>::Type>>;
+  static Type make(ConcurrentTaskSet& tasks, Stage0&& s) {
+    return Type(tasks, std::forward<Stage0>(s), OrderedSinkEnd());
+  }
+};
+
+template <typename InputType, typename Stage0>
+struct SinkPipeFor<InputType, Stage0, false, true> {
+  using Type = FanOutPipe<
+      StageClass::kSink,
+      Stage0,
+      OrderedSinkEnd,
+      std::decay_t<typename OptionalStrippedTraits<InputType>::Type>>;
+  static Type make(ConcurrentTaskSet& tasks, Stage0&& s) {
+    return Type(tasks, std::forward<Stage0>(s), OrderedSinkEnd());
+  }
+};
+
+template <
+    StageClass kSc,
+    typename InputType,
+    typename Stage0,
+    typename PipeNext,
+    bool kIsOrdered,
+    bool kIsFanOut>
+struct TransformPipeFor {
+  using Type = Pipe<kSc, Stage0, PipeNext>;
+};
+
+template <StageClass kSc, typename InputType, typename Stage0, typename PipeNext>
+struct TransformPipeFor<kSc, InputType, Stage0, PipeNext, false, true> {
+  using Type = FanOutPipe<
+      kSc,
+      Stage0,
+      PipeNext,
+      std::decay_t<typename OptionalStrippedTraits<InputType>::Type>>;
+};
+
+template <StageClass kSc, typename InputType, typename Stage0, typename PipeNext>
+struct TransformPipeFor<kSc, InputType, Stage0, PipeNext, true, false> {
+  using Type = OrderedPipe<
+      kSc,
+      Stage0,
+      PipeNext,
+      std::decay_t<typename OptionalStrippedTraits<InputType>::Type>>;
 };
 
 template <typename InputType, typename Stage0>
 auto makePipesHelper(ConcurrentTaskSet& tasks, Stage0&& sCur) {
-  return Pipe<StageClass::kSink, Stage0, SinkPipe>(tasks, std::forward<Stage0>(sCur));
+  return SinkPipeFor<
+      InputType,
+      Stage0,
+      IsOrderedStage<std::decay_t<Stage0>>::value,
+      IsFanOutStage<std::decay_t<Stage0>>::value>::make(tasks, std::forward<Stage0>(sCur));
 }
 
 template <typename InputType, typename Stage0, typename Stage1, typename... Stages>
@@ -352,7 +1509,14 @@ auto makePipesHelper(
       tasks, std::forward<Stage1>(sNext), std::forward<Stages>(sFollowing)...);
 
   constexpr StageClass kSc = TransformTraits<Stage0Result>::kStageClass;
-  return Pipe<kSc, Stage0, decltype(pipe)>(tasks, std::forward<Stage0>(sCur), std::move(pipe));
+  using PipeType = typename TransformPipeFor<
+      kSc,
+      InputType,
+      Stage0,
+      decltype(pipe),
+      IsOrderedStage<std::decay_t<Stage0>>::value,
+      IsFanOutStage<std::decay_t<Stage0>>::value>::Type;
+  return PipeType(tasks, std::forward<Stage0>(sCur), std::move(pipe));
 }
 
 template <typename Stage0, typename Stage1, typename... Stages>
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include <dispenso/platform.h>
+
+namespace dispenso {
+namespace detail {
+
+// The per-thread record shared by the epoch-based reclamation schemes (EpochDomain and RcuPtr).
+// Records form a push-only list that reclaimers scan for the oldest epoch still being read, and a
+// record released by an exiting thread is reused by the next thread to register.
+template <typename Derived>
+struct alignas(kCacheLineSize) ReaderRecord {
+  // The epoch observed when the thread's outermost read section began, or 0 when the thread is
+  // outside any read section.
+  std::atomic<uint64_t> epoch{0};
+  // Only touched by the owning thread.
+  uint32_t nesting = 0;
+  std::atomic<bool> inUse{true};
+  Derived* next = nullptr;
+
+#if __cplusplus < 201703L
+  static void* operator new(size_t sz) {
+    return detail::alignedMalloc(sz);
+  }
+  static void operator delete(void* ptr) {
+    return detail::alignedFree(ptr);
+  }
+#endif // __cplusplus
+};
+
+// Claim a released record from the list, or push a new one.  Records must not be freed while the
+// list can still be scanned.
+template <typename Record>
+Record* acquireReaderRecord(std::atomic<Record*>& head) {
+  for (Record* r = head.load(std::memory_order_acquire); r; r = r->next) {
+    bool expected = false;
+    if (!r->inUse.load(std::memory_order_relaxed) &&
+        r->inUse.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+      return r;
+    }
+  }
+  Record* record = new Record();
+  Record* oldHead = head.load(std::memory_order_relaxed);
+  do {
+    record->next = oldHead;
+  } while (!head.compare_exchange_weak(
+      oldHead, record, std::memory_order_release, std::memory_order_relaxed));
+  return record;
+}
+
+template <typename Record>
+void releaseReaderRecord(Record& record) {
+  record.inUse.store(false, std::memory_order_release);
+}
+
+// The oldest epoch any record is reading in, or UINT64_MAX if none are reading.
+template <typename Record>
+uint64_t oldestReaderEpoch(const std::atomic<Record*>& head) {
+  uint64_t oldest = UINT64_MAX;
+  for (Record* r = head.load(std::memory_order_acquire); r; r = r->next) {
+    uint64_t epoch = r->epoch.load(std::memory_order_seq_cst);
+    if (epoch && epoch < oldest) {
+      oldest = epoch;
+    }
+  }
+  return oldest;
+}
+
+} // namespace detail
+} // namespace dispenso
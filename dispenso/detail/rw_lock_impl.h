@@ -5,7 +5,13 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <algorithm>
+#include <new>
+#include <thread>
+
+#include <dispenso/detail/math.h>
 #include <dispenso/platform.h>
+#include <dispenso/thread_id.h>
 
 namespace dispenso {
 namespace detail {
@@ -144,5 +150,125 @@ inline void RWLockImpl::lock_downgrade() {
   lock_.fetch_add(1, std::memory_order_acq_rel);
   unlock();
 }
+
+// Readers count themselves in one of a set of cache-line padded slots picked by thread ID, and
+// writers scan every slot.  A reader announces itself in its slot before checking for a writer,
+// and a writer announces itself before scanning the slots; sequentially consistent ordering on both
+// sides ensures at least one sees the other.
+class DistributedRWLockImpl {
+ public:
+  DistributedRWLockImpl()
+      // Twice as many slots as hardware threads keeps collisions between threads rare.
+      : mask_(static_cast<size_t>(
+                  nextPow2(2 * std::max<size_t>(1, std::thread::hardware_concurrency()))) -
+              1),
+        slots_(reinterpret_cast<Slot*>(alignedMalloc((mask_ + 1) * sizeof(Slot), sizeof(Slot)))) {
+    for (size_t i = 0; i <= mask_; ++i) {
+      new (&slots_[i]) Slot();
+    }
+  }
+
+  DistributedRWLockImpl(const DistributedRWLockImpl&) = delete;
+  DistributedRWLockImpl& operator=(const DistributedRWLockImpl&) = delete;
+
+  ~DistributedRWLockImpl() {
+    for (size_t i = 0; i <= mask_; ++i) {
+      slots_[i].~Slot();
+    }
+    alignedFree(slots_);
+  }
+
+  void lock() {
+    claimWriter();
+    drainReaders();
+  }
+
+  bool try_lock() {
+    uint32_t expected = 0;
+    if (!writer_.compare_exchange_strong(expected, 1, std::memory_order_seq_cst)) {
+      return false;
+    }
+    for (size_t i = 0; i <= mask_; ++i) {
+      if (slots_[i].readers.load(std::memory_order_seq_cst)) {
+        writer_.store(0, std::memory_order_release);
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void unlock() {
+    writer_.store(0, std::memory_order_release);
+  }
+
+  void lock_shared() {
+    std::atomic<uint32_t>& readers = localSlot().readers;
+    while (true) {
+      readers.fetch_add(1, std::memory_order_seq_cst);
+      if (!writer_.load(std::memory_order_seq_cst)) {
+        return;
+      }
+      readers.fetch_sub(1, std::memory_order_release);
+      while (writer_.load(std::memory_order_acquire)) {
+        cpuRelax();
+      }
+    }
+  }
+
+  bool try_lock_shared() {
+    std::atomic<uint32_t>& readers = localSlot().readers;
+    readers.fetch_add(1, std::memory_order_seq_cst);
+    if (!writer_.load(std::memory_order_seq_cst)) {
+      return true;
+    }
+    readers.fetch_sub(1, std::memory_order_release);
+    return false;
+  }
+
+  void unlock_shared() {
+    localSlot().readers.fetch_sub(1, std::memory_order_release);
+  }
+
+  void lock_upgrade() {
+    claimWriter();
+    localSlot().readers.fetch_sub(1, std::memory_order_release);
+    drainReaders();
+  }
+
+  void lock_downgrade() {
+    localSlot().readers.fetch_add(1, std::memory_order_relaxed);
+    unlock();
+  }
+
+ private:
+  struct alignas(kCacheLineSize) Slot {
+    std::atomic<uint32_t> readers{0};
+  };
+
+  Slot& localSlot() {
+    return slots_[static_cast<size_t>(threadId()) & mask_];
+  }
+
+  void claimWriter() {
+    uint32_t expected = 0;
+    while (!writer_.compare_exchange_weak(expected, 1, std::memory_order_seq_cst)) {
+      expected = 0;
+      cpuRelax();
+    }
+  }
+
+  void drainReaders() {
+    for (size_t i = 0; i <= mask_; ++i) {
+      while (slots_[i].readers.load(std::memory_order_seq_cst)) {
+        cpuRelax();
+      }
+    }
+  }
+
+  const size_t mask_;
+  Slot* const slots_;
+  // Only written by writers, so readers checking it share the cache line without invalidation.
+  alignas(kCacheLineSize) std::atomic<uint32_t> writer_{0};
+};
 } // namespace detail
 } // namespace dispenso
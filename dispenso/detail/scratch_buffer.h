@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <dispenso/platform.h>
+
+namespace dispenso {
+namespace detail {
+
+// Uninitialized, cache-aligned storage for n elements of T, used as temporary space by the
+// parallel algorithms.  Elements are placement-constructed by the algorithm as it moves values in;
+// once every element has been constructed, setConstructed() makes this responsible for destroying
+// them.
+template <typename T>
+class ScratchBuffer {
+ public:
+  explicit ScratchBuffer(size_t n)
+      : data_(reinterpret_cast<T*>(alignedMalloc(n * sizeof(T)))), size_(n) {}
+
+  ScratchBuffer(const ScratchBuffer&) = delete;
+  ScratchBuffer& operator=(const ScratchBuffer&) = delete;
+
+  T* data() {
+    return data_;
+  }
+
+  void setConstructed() {
+    constructed_ = true;
+  }
+
+  ~ScratchBuffer() {
+    if (constructed_) {
+      for (size_t i = 0; i < size_; ++i) {
+        data_[i].~T();
+      }
+    }
+    alignedFree(data_);
+  }
+
+ private:
+  T* data_;
+  size_t size_;
+  bool constructed_ = false;
+};
+
+} // namespace detail
+} // namespace dispenso
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+#include "notifier_common.h"
+
+// AddressWaiter sleeps until an atomic int changes away from an expected value, and wakes sleepers
+// when it has changed.  As with the futex system call it is modeled on, wakeups may be spurious,
+// and callers must recheck their condition.  Callers are responsible for only calling wake when
+// there may be sleepers; wake is a system call on every platform.
+
+namespace dispenso {
+namespace detail {
+
+#if defined(__linux__)
+
+class AddressWaiter {
+ public:
+  // relSeconds < 0 means wait without a timeout.  Returns false if the wait timed out.
+  bool wait(std::atomic<int>& value, int expected, double relSeconds) const {
+    int* addr = reinterpret_cast<int*>(&value);
+    if (relSeconds < 0.0) {
+      futex(addr, FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+      return true;
+    }
+    struct timespec ts;
+    ts.tv_sec = static_cast<time_t>(relSeconds);
+    relSeconds -= static_cast<double>(ts.tv_sec);
+    ts.tv_nsec = static_cast<long>(1e9 * relSeconds);
+    return !(futex(addr, FUTEX_WAIT_PRIVATE, expected, &ts, nullptr, 0) && errno == ETIMEDOUT);
+  }
+
+  void wake(std::atomic<int>& value, int count) {
+    futex(reinterpret_cast<int*>(&value), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+  }
+};
+
+#elif defined(_WIN32)
+
+class AddressWaiter {
+ public:
+  bool wait(std::atomic<int>& value, int expected, double relSeconds) const {
+    unsigned long msWait = relSeconds < 0.0
+        ? kInfiniteWin
+        : static_cast<unsigned long>(std::max(1.0, relSeconds * 1000.0));
+    return WaitOnAddress(&value, &expected, sizeof(int), msWait) ||
+        GetLastError() != kErrorTimeoutWin;
+  }
+
+  void wake(std::atomic<int>& value, int count) {
+    if (count == 1) {
+      WakeByAddressSingle(&value);
+    } else {
+      WakeByAddressAll(&value);
+    }
+  }
+};
+
+#else
+
+// Fallback C++11 implementation.
+class AddressWaiter {
+ public:
+  bool wait(std::atomic<int>& value, int expected, double relSeconds) const {
+    std::unique_lock<std::mutex> lk(mtx_);
+    auto changed = [&value, expected]() {
+      return value.load(std::memory_order_relaxed) != expected;
+    };
+    if (relSeconds < 0.0) {
+      cv_.wait(lk, changed);
+      return true;
+    }
+    return cv_.wait_for(lk, std::chrono::duration<double>(relSeconds), changed);
+  }
+
+  void wake(std::atomic<int>& /*value*/, int count) {
+    // Acquiring the mutex orders this wake after any sleeper's check of the value.
+    { std::lock_guard<std::mutex> lk(mtx_); }
+    if (count == 1) {
+      cv_.notify_one();
+    } else {
+      cv_.notify_all();
+    }
+  }
+
+ private:
+  mutable std::mutex mtx_;
+  mutable std::condition_variable cv_;
+};
+
+#endif // platform
+
+} // namespace detail
+} // namespace dispenso
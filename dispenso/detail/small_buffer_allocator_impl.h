@@ -7,25 +7,80 @@
 
 #pragma once
 
+#include <algorithm>
 #include <vector>
 
 #include <dispenso/detail/math.h>
+#include <dispenso/detail/trim_slabs.h>
+#include <dispenso/huge_pages.h>
 #include <dispenso/platform.h>
+#include <dispenso/small_buffer_allocator.h>
+#include <dispenso/topology.h>
 #include <dispenso/tsan_annotations.h>
 
 #include <concurrentqueue.h>
 
+#if !defined(DISPENSO_SMALL_BUFFER_SLAB_UNIT)
+#define DISPENSO_SMALL_BUFFER_SLAB_UNIT 4096
+#endif // DISPENSO_SMALL_BUFFER_SLAB_UNIT
+
+#if !defined(DISPENSO_SMALL_BUFFER_TL_CACHE_DIVISOR)
+#define DISPENSO_SMALL_BUFFER_TL_CACHE_DIVISOR 4
+#endif // DISPENSO_SMALL_BUFFER_TL_CACHE_DIVISOR
+
+#if !defined(DISPENSO_SMALL_BUFFER_HUGE_PAGES)
+#define DISPENSO_SMALL_BUFFER_HUGE_PAGES 0
+#endif // DISPENSO_SMALL_BUFFER_HUGE_PAGES
+
+static_assert(DISPENSO_SMALL_BUFFER_SLAB_UNIT > 0, "DISPENSO_SMALL_BUFFER_SLAB_UNIT must be > 0");
+static_assert(
+    DISPENSO_SMALL_BUFFER_TL_CACHE_DIVISOR > 0,
+    "DISPENSO_SMALL_BUFFER_TL_CACHE_DIVISOR must be > 0");
+
 namespace dispenso {
 namespace detail {
 
+// Backing allocations come from hugePageAlloc if DISPENSO_SMALL_BUFFER_HUGE_PAGES is set (see
+// small_buffer_allocator.h).
+inline char* allocSlab(size_t bytes, size_t alignment) {
+#if DISPENSO_SMALL_BUFFER_HUGE_PAGES
+  static_assert(kMaxSmallBufferSize <= kHugePageMinAlignment, "Slabs must be chunk aligned");
+  (void)alignment;
+  return reinterpret_cast<char*>(hugePageAlloc(bytes));
+#else
+  return reinterpret_cast<char*>(alignedMalloc(bytes, alignment));
+#endif // DISPENSO_SMALL_BUFFER_HUGE_PAGES
+}
+
+inline void freeSlab(char* slab) {
+#if DISPENSO_SMALL_BUFFER_HUGE_PAGES
+  hugePageFree(slab);
+#else
+  alignedFree(slab);
+#endif // DISPENSO_SMALL_BUFFER_HUGE_PAGES
+}
+
 struct SmallBufferGlobals {
-  moodycamel::ConcurrentQueue<char*> centralStore;
+  SmallBufferGlobals()
+      : numCentralStores(numaTopology().size()),
+        centralStores(new moodycamel::ConcurrentQueue<char*>[numCentralStores]) {}
+
+  // The central store is sharded by NUMA node.  Threads return buffers to, and refill from, their
+  // own node's shard first, so freed buffers tend to be reused on the node that last touched them.
+  // The shards are deliberately never freed: threads still running after main returns (e.g.
+  // detached threads releasing the last reference to a future) may return buffers to them after
+  // these globals are destroyed.
+  const size_t numCentralStores;
+  moodycamel::ConcurrentQueue<char*>* const centralStores;
   std::vector<char*> backingStore;
   std::atomic<uint32_t> backingStoreLock{0};
+  // Guarded by backingStoreLock.
+  size_t peakBackingStoreSize = 0;
+  std::atomic<size_t> numThreadCaches{0};
 
   ~SmallBufferGlobals() {
     for (char* b : backingStore) {
-      alignedFree(b);
+      freeSlab(b);
     }
   }
 };
@@ -46,15 +101,18 @@ class SmallBufferAllocator {
  private:
   static constexpr size_t kLogFactor = log2const(kChunkSize | 1);
 
-  // TODO(T88183021): Make these factors compile-time configurable.  For example, the current values
-  // can lead to megabytes of data being allocated, even if the alloctor is only used for one or two
-  // allocations.  Likely we can reduce these sizes by a decent factor without affecting benchmarks,
-  // and then reduce them even further as an option.
-  static constexpr size_t kMallocBytes = (1 << 12) * kLogFactor;
-  static constexpr size_t kIdealTLCacheBytes = kMallocBytes / 4;
-  static constexpr size_t kIdealNumTLBuffers = kIdealTLCacheBytes / kChunkSize;
+  // These are configured through DISPENSO_SMALL_BUFFER_SLAB_UNIT and
+  // DISPENSO_SMALL_BUFFER_TL_CACHE_DIVISOR (see small_buffer_allocator.h).  Each backing allocation
+  // holds at least two thread-local refills, and each refill at least one buffer, however small
+  // the configured sizes.
+  static constexpr size_t kTargetMallocBytes = DISPENSO_SMALL_BUFFER_SLAB_UNIT * kLogFactor;
+  static constexpr size_t kIdealNumTLBuffers = std::max<size_t>(
+      1,
+      kTargetMallocBytes / DISPENSO_SMALL_BUFFER_TL_CACHE_DIVISOR / kChunkSize);
   static constexpr size_t kMaxNumTLBuffers = 2 * kIdealNumTLBuffers;
-  static constexpr size_t kBuffersPerMalloc = kMallocBytes / kChunkSize;
+  static constexpr size_t kBuffersPerMalloc =
+      std::max<size_t>(2 * kIdealNumTLBuffers, kTargetMallocBytes / kChunkSize);
+  static constexpr size_t kMallocBytes = kBuffersPerMalloc * kChunkSize;
 
   static_assert(kIdealNumTLBuffers > 0, "Must have a positive number of buffers to work with");
 
@@ -115,19 +173,96 @@ class SmallBufferAllocator {
     return bytes;
   }
 
+  /**
+   * Get a snapshot of the allocator's memory usage.  Cheap enough to call periodically; it holds
+   * the backing store lock only to copy two counters.
+   *
+   * @return The current statistics.
+   **/
+  static SmallBufferStats stats() {
+    auto& globals = getSmallBufferGlobals<kChunkSize>();
+    auto& lock = globals.backingStoreLock;
+    uint32_t allocId = 0;
+    while (!lock.compare_exchange_weak(allocId, 1, std::memory_order_acquire)) {
+      allocId = 0;
+    }
+    SmallBufferStats stats;
+    stats.chunkSize = kChunkSize;
+    stats.bytesReserved = kMallocBytes * globals.backingStore.size();
+    stats.peakBytesReserved = kMallocBytes * globals.peakBackingStoreSize;
+    lock.store(0, std::memory_order_release);
+    size_t numCentral = 0;
+    for (size_t i = 0; i < globals.numCentralStores; ++i) {
+      numCentral += globals.centralStores[i].size_approx();
+    }
+    stats.bytesInCentralStore = std::min(numCentral * kChunkSize, stats.bytesReserved);
+    stats.bytesHeldByThreads = stats.bytesReserved - stats.bytesInCentralStore;
+    stats.numThreadCaches = globals.numThreadCaches.load(std::memory_order_relaxed);
+    stats.maxBytesPerThreadCache = kMaxNumTLBuffers * kChunkSize;
+    return stats;
+  }
+
+  /**
+   * Release backing allocations whose buffers have all been returned to the central store.  The
+   * calling thread's cached buffers are returned first; buffers cached by other threads keep their
+   * backing allocations alive.
+   *
+   * @return The number of bytes released.
+   **/
+  static size_t trim() {
+    auto bnc = buffersAndCount();
+    char** tlBuffers = std::get<0>(bnc);
+    size_t& tlCount = std::get<1>(bnc);
+    registerCleanup();
+    if (tlCount) {
+      recycleToCentralStore(tlBuffers, tlCount);
+      tlCount = 0;
+    }
+
+    auto& queue = getThreadQueuingData();
+    auto& globals = getSmallBufferGlobals<kChunkSize>();
+    auto& lock = globals.backingStoreLock;
+    uint32_t allocId = 0;
+    while (!lock.compare_exchange_weak(allocId, 1, std::memory_order_acquire)) {
+      allocId = 0;
+      std::this_thread::yield();
+    }
+    // Holding the lock keeps allocating threads from refilling from new backing allocations while
+    // the central store is drained.  Concurrent deallocations may still add buffers, which are
+    // simply left for the next trim.
+    std::vector<char*> freeBuffers;
+    char* batch[kIdealNumTLBuffers];
+    while (size_t grabbed = queue.try_dequeue_bulk(batch, kIdealNumTLBuffers)) {
+      freeBuffers.insert(freeBuffers.end(), batch, batch + grabbed);
+    }
+    while (size_t grabbed = queue.tryDequeueRemoteBulk(batch, kIdealNumTLBuffers)) {
+      freeBuffers.insert(freeBuffers.end(), batch, batch + grabbed);
+    }
+    size_t released = trimFreeSlabs(
+        globals.backingStore, freeBuffers, kBuffersPerMalloc, [](char* b) { freeSlab(b); });
+    if (!freeBuffers.empty()) {
+      queue.enqueue_bulk(freeBuffers.data(), freeBuffers.size());
+    }
+    lock.store(0, std::memory_order_release);
+    return released * kMallocBytes;
+  }
+
  private:
   struct PerThreadQueuingData {
-    PerThreadQueuingData(
-        moodycamel::ConcurrentQueue<char*>& cstore,
-        std::tuple<char**, size_t&> buffersAndCount)
-        : cstore_(cstore),
-          ptoken_(cstore),
-          ctoken_(cstore),
+    PerThreadQueuingData(SmallBufferGlobals& globals, std::tuple<char**, size_t&> buffersAndCount)
+        : globals_(globals),
+          home_(currentNumaNode() % globals.numCentralStores),
+          cstore_(globals.centralStores[home_]),
+          ptoken_(cstore_),
+          ctoken_(cstore_),
           buffers_(std::get<0>(buffersAndCount)),
-          count_(std::get<1>(buffersAndCount)) {}
+          count_(std::get<1>(buffersAndCount)) {
+      globals_.numThreadCaches.fetch_add(1, std::memory_order_relaxed);
+    }
 
     ~PerThreadQueuingData() {
       enqueue_bulk(buffers_, count_);
+      globals_.numThreadCaches.fetch_sub(1, std::memory_order_relaxed);
     }
 
     void enqueue_bulk(char** buffers, size_t count) {
@@ -140,7 +275,21 @@ class SmallBufferAllocator {
       return cstore_.try_dequeue_bulk(ctoken_, buffers, count);
     }
 
+    // Take buffers from another node's shard.  This keeps buffers freed on one node from piling up
+    // there while threads on another node allocate fresh memory.
+    size_t tryDequeueRemoteBulk(char** buffers, size_t count) {
+      for (size_t i = 1; i < globals_.numCentralStores; ++i) {
+        size_t shard = (home_ + i) % globals_.numCentralStores;
+        if (size_t grabbed = globals_.centralStores[shard].try_dequeue_bulk(buffers, count)) {
+          return grabbed;
+        }
+      }
+      return 0;
+    }
+
    private:
+    SmallBufferGlobals& globals_;
+    const size_t home_;
     moodycamel::ConcurrentQueue<char*>& cstore_;
     moodycamel::ProducerToken ptoken_;
     moodycamel::ConsumerToken ctoken_;
@@ -167,10 +316,16 @@ class SmallBufferAllocator {
       if (grabbed) {
         return grabbed;
       }
+      grabbed = queue.tryDequeueRemoteBulk(buffers, kIdealNumTLBuffers);
+      if (grabbed) {
+        return grabbed;
+      }
       uint32_t allocId = lock.fetch_add(1, std::memory_order_acquire);
       if (allocId == 0) {
-        char* buffer = reinterpret_cast<char*>(detail::alignedMalloc(kMallocBytes, kChunkSize));
+        char* buffer = allocSlab(kMallocBytes, kChunkSize);
         backingStore.push_back(buffer);
+        globals.peakBackingStoreSize =
+            std::max(globals.peakBackingStoreSize, backingStore.size());
 
         constexpr size_t kNumToPush = kBuffersPerMalloc - kIdealNumTLBuffers;
         char* topush[kNumToPush];
@@ -205,7 +360,7 @@ class SmallBufferAllocator {
   };
   DISPENSO_DLL_ACCESS static PerThreadQueuingData& getThreadQueuingData() {
     static thread_local PerThreadQueuingData data(
-        getSmallBufferGlobals<kChunkSize>().centralStore, buffersAndCount());
+        getSmallBufferGlobals<kChunkSize>(), buffersAndCount());
     return data;
   }
 };
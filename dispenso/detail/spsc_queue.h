@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <new>
+#include <utility>
+
+#include <dispenso/platform.h>
+
+namespace dispenso {
+namespace detail {
+
+// An unbounded single-producer, single-consumer FIFO queue.  Elements are stored in a linked list
+// of fixed-size blocks: the producer only writes to the tail block and the consumer only reads from
+// the head block, so the only shared state is each block's write index and next pointer.  The most
+// recently drained block is kept for reuse, so a queue that stays short never allocates in steady
+// state.
+template <typename T, size_t kBlockSize = 64>
+class SpscQueue {
+ public:
+  SpscQueue() : head_(newBlock()), tail_(head_) {}
+
+  SpscQueue(const SpscQueue&) = delete;
+  SpscQueue& operator=(const SpscQueue&) = delete;
+
+  ~SpscQueue() {
+    T value;
+    while (tryPop(value)) {
+    }
+    deleteBlock(head_);
+    deleteBlock(spare_.load(std::memory_order_acquire));
+  }
+
+  // Producer only.
+  template <typename U>
+  void push(U&& value) {
+    size_t w = tail_->writeIndex.load(std::memory_order_relaxed);
+    if (w == kBlockSize) {
+      Block* block = spare_.exchange(nullptr, std::memory_order_acq_rel);
+      if (block) {
+        block->writeIndex.store(0, std::memory_order_relaxed);
+        block->readIndex = 0;
+        block->next.store(nullptr, std::memory_order_relaxed);
+      } else {
+        block = newBlock();
+      }
+      tail_->next.store(block, std::memory_order_release);
+      tail_ = block;
+      w = 0;
+    }
+    new (tail_->slot(w)) T(std::forward<U>(value));
+    tail_->writeIndex.store(w + 1, std::memory_order_release);
+  }
+
+  // Consumer only.
+  bool tryPop(T& out) {
+    while (true) {
+      size_t r = head_->readIndex;
+      if (r < head_->writeIndex.load(std::memory_order_acquire)) {
+        T* value = head_->slot(r);
+        out = std::move(*value);
+        value->~T();
+        head_->readIndex = r + 1;
+        return true;
+      }
+      if (r < kBlockSize) {
+        return false;
+      }
+      Block* next = head_->next.load(std::memory_order_acquire);
+      if (!next) {
+        return false;
+      }
+      recycle(head_);
+      head_ = next;
+    }
+  }
+
+  // Consumer only.
+  bool empty() const {
+    const Block* block = head_;
+    while (true) {
+      size_t r = block->readIndex;
+      if (r < block->writeIndex.load(std::memory_order_acquire)) {
+        return false;
+      }
+      if (r < kBlockSize) {
+        return true;
+      }
+      block = block->next.load(std::memory_order_acquire);
+      if (!block) {
+        return true;
+      }
+    }
+  }
+
+ private:
+  struct Block {
+    T* slot(size_t i) {
+      return reinterpret_cast<T*>(storage) + i;
+    }
+
+    alignas(kCacheLineSize) std::atomic<size_t> writeIndex{0};
+    std::atomic<Block*> next{nullptr};
+    // Only touched by the consumer.
+    alignas(kCacheLineSize) size_t readIndex = 0;
+    alignas(T) char storage[kBlockSize * sizeof(T)];
+  };
+
+  static Block* newBlock() {
+    return new (alignedMalloc(sizeof(Block), alignof(Block))) Block();
+  }
+
+  static void deleteBlock(Block* block) {
+    if (block) {
+      block->~Block();
+      alignedFree(block);
+    }
+  }
+
+  void recycle(Block* block) {
+    deleteBlock(spare_.exchange(block, std::memory_order_acq_rel));
+  }
+
+  // head_ belongs to the consumer and tail_ to the producer.
+  alignas(kCacheLineSize) Block* head_;
+  alignas(kCacheLineSize) Block* tail_;
+  alignas(kCacheLineSize) std::atomic<Block*> spare_{nullptr};
+};
+
+} // namespace detail
+} // namespace dispenso
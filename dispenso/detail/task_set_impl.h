@@ -13,6 +13,8 @@
 
 #pragma once
 
+#include <dispenso/detail/fiber_wait.h>
+#include <dispenso/sub_pool.h>
 #include <dispenso/thread_pool.h>
 
 namespace dispenso {
@@ -27,6 +29,8 @@ class LimitGatedScheduler;
 
 DISPENSO_DLL_ACCESS void pushThreadTaskSet(TaskSetBase* tasks);
 DISPENSO_DLL_ACCESS void popThreadTaskSet();
+// The number of TaskSet tasks currently running on the calling thread's stack.
+DISPENSO_DLL_ACCESS size_t threadTaskSetDepth();
 
 } // namespace detail
 
@@ -37,22 +41,20 @@ class TaskSetBase {
   TaskSetBase(
       ThreadPool& p,
       ParentCascadeCancel registerForParentCancel = ParentCascadeCancel::kOff,
-      ssize_t stealingLoadMultiplier = 4)
-      : pool_(p), taskSetLoadFactor_(stealingLoadMultiplier * p.numThreads()) {
-#if defined DISPENSO_DEBUG
-    assert(stealingLoadMultiplier > 0);
-    pool_.outstandingTaskSets_.fetch_add(1, std::memory_order_acquire);
-#endif
-
-    parent_ = (registerForParentCancel == ParentCascadeCancel::kOn) ? parentTaskSet() : nullptr;
+      ssize_t stealingLoadMultiplier = 4,
+      TaskPriority priority = TaskPriority::kNormal)
+      : TaskSetBase(p, nullptr, registerForParentCancel, stealingLoadMultiplier, priority) {}
 
-    if (parent_) {
-      parent_->registerChild(this);
-      if (parent_->canceled()) {
-        canceled_.store(true, std::memory_order_release);
-      }
-    }
-  }
+  TaskSetBase(
+      SubPool& sub,
+      ParentCascadeCancel registerForParentCancel = ParentCascadeCancel::kOff,
+      ssize_t stealingLoadMultiplier = 4)
+      : TaskSetBase(
+            sub.pool(),
+            &sub,
+            registerForParentCancel,
+            stealingLoadMultiplier,
+            TaskPriority::kNormal) {}
 
   TaskSetBase(TaskSetBase&& other) = delete;
   TaskSetBase& operator=(TaskSetBase&& other) = delete;
@@ -65,6 +67,34 @@ class TaskSetBase {
     return pool_;
   }
 
+  /**
+   * Get the SubPool this set schedules to.
+   *
+   * @return The SubPool, or nullptr if the set schedules directly to its pool.
+   **/
+  SubPool* subPool() const {
+    return subPool_;
+  }
+
+  TaskPriority priority() const {
+    return priority_;
+  }
+
+  /**
+   * Name the set's tasks in traces (see trace.h).  Tasks scheduled after the call show up as
+   * slices with this name.  Must not be called concurrently with scheduling.
+   *
+   * @param name The name, which must remain valid until the trace is written, e.g. a string
+   * literal.  nullptr leaves the tasks unnamed.
+   **/
+  void setName(const char* name) {
+    name_ = name;
+  }
+
+  const char* name() const {
+    return name_;
+  }
+
   void cancel() {
     canceled_.store(true, std::memory_order_release);
     cancelChildren();
@@ -84,12 +114,46 @@ class TaskSetBase {
     }
   }
 
+ private:
+  TaskSetBase(
+      ThreadPool& p,
+      SubPool* sub,
+      ParentCascadeCancel registerForParentCancel,
+      ssize_t stealingLoadMultiplier,
+      TaskPriority priority)
+      : pool_(p),
+        subPool_(sub),
+        taskSetLoadFactor_(
+            stealingLoadMultiplier * (sub ? sub->maxConcurrency() : p.numThreads())),
+        priority_(priority) {
+#if defined DISPENSO_DEBUG
+    assert(stealingLoadMultiplier > 0);
+    pool_.outstandingTaskSets_.fetch_add(1, std::memory_order_acquire);
+#endif
+
+    parent_ = (registerForParentCancel == ParentCascadeCancel::kOn) ? parentTaskSet() : nullptr;
+
+    if (parent_) {
+      parent_->registerChild(this);
+      if (parent_->canceled()) {
+        canceled_.store(true, std::memory_order_release);
+      }
+    }
+  }
+
  protected:
   template <typename F>
   auto packageTask(F&& f) {
     outstandingTaskCount_.fetch_add(1, std::memory_order_acquire);
+    return wrapTask(std::forward<F>(f));
+  }
+
+  // As packageTask, but the caller is responsible for incrementing outstandingTaskCount_.
+  template <typename F>
+  auto wrapTask(F&& f) {
     return [this, f = std::move(f)]() mutable {
       detail::pushThreadTaskSet(this);
+      DISPENSO_TRACE_SCOPE(name_);
       if (!canceled_.load(std::memory_order_acquire)) {
 #if defined(__cpp_exceptions)
         try {
@@ -102,10 +166,42 @@ class TaskSetBase {
 #endif // __cpp_exceptions
       }
       detail::popThreadTaskSet();
-      outstandingTaskCount_.fetch_sub(1, std::memory_order_release);
+      // The set may be destroyed as soon as the count is zero, so only its address is used after.
+      std::atomic<ssize_t>* outstanding = &outstandingTaskCount_;
+      if (outstanding->fetch_sub(1, std::memory_order_release) == 1) {
+        detail::wakeFibers(outstanding);
+      }
     };
   }
 
+  // Run a functor inline in the scheduling thread.  Exceptions are captured as for queued tasks,
+  // so that they are always propagated from wait rather than from schedule.
+  template <typename F>
+  void runInline(F&& f) {
+    DISPENSO_TRACE_SCOPE(name_);
+#if defined(__cpp_exceptions)
+    try {
+      f();
+    } catch (...) {
+      trySetCurrentException();
+    }
+#else
+    f();
+#endif // __cpp_exceptions
+  }
+
+  template <typename Gen>
+  auto wrapTaskGenerator(Gen& gen, size_t count) {
+    outstandingTaskCount_.fetch_add(static_cast<ssize_t>(count), std::memory_order_acquire);
+    return [this, &gen](size_t i) { return wrapTask(gen(i)); };
+  }
+
+  // Threads waiting on a set help with its SubPool's work, since the SubPool's concurrency may be
+  // used up by tasks that are themselves waiting.
+  bool tryExecuteSubPool() {
+    return subPool_ && subPool_->tryExecuteNext();
+  }
+
   DISPENSO_DLL_ACCESS void trySetCurrentException();
   bool testAndResetException();
 
@@ -153,8 +249,11 @@ class TaskSetBase {
 
   alignas(kCacheLineSize) std::atomic<ssize_t> outstandingTaskCount_{0};
   alignas(kCacheLineSize) ThreadPool& pool_;
+  SubPool* const subPool_;
   alignas(kCacheLineSize) std::atomic<bool> canceled_{false};
   const ssize_t taskSetLoadFactor_;
+  const TaskPriority priority_;
+  const char* name_ = nullptr;
 #if defined(__cpp_exceptions)
   enum ExceptionState { kUnset, kSetting, kSet };
   std::atomic<ExceptionState> guardException_{kUnset};
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/detail/timer_wheel.h>
+
+#include <algorithm>
+
+#include <dispenso/timing.h>
+
+namespace dispenso {
+namespace detail {
+
+constexpr size_t TimerWheel::kNumSlots;
+constexpr double TimerWheel::kTickSeconds;
+
+TimerWheel::TimerWheel() : slots_(kNumSlots), lastTick_(tickOf(getTime()) - 1) {}
+
+bool TimerWheel::add(double deadline, OnceFunction f) {
+  std::lock_guard<std::mutex> lk(mtx_);
+  // Timers that are already due go in the first slot still to be expired.
+  int64_t tick = std::max(tickOf(deadline), lastTick_ + 1);
+  slotFor(tick).push_back({tick, deadline, std::move(f)});
+  pending_.fetch_add(1, std::memory_order_acq_rel);
+
+  if (deadline < nextDeadline_.load(std::memory_order_relaxed)) {
+    nextDeadline_.store(deadline, std::memory_order_release);
+    return true;
+  }
+  return false;
+}
+
+bool TimerWheel::collectExpired(double now, std::vector<OnceFunction>& expired) {
+  std::unique_lock<std::mutex> lk(mtx_, std::try_to_lock);
+  if (!lk.owns_lock()) {
+    return false;
+  }
+
+  const int64_t nowTick = tickOf(now);
+  if (nowTick <= lastTick_) {
+    return true;
+  }
+  const size_t before = expired.size();
+  auto expireSlot = [now, &expired](std::vector<Timer>& slot) {
+    for (size_t i = 0; i < slot.size();) {
+      if (slot[i].deadline <= now) {
+        expired.push_back(std::move(slot[i].f));
+        slot[i] = std::move(slot.back());
+        slot.pop_back();
+      } else {
+        ++i;
+      }
+    }
+  };
+
+  // The slot for nowTick is only partially expired, so it is revisited next time.
+  const int64_t numTicks = nowTick - lastTick_;
+  if (numTicks >= static_cast<int64_t>(kNumSlots)) {
+    for (auto& slot : slots_) {
+      expireSlot(slot);
+    }
+  } else {
+    for (int64_t t = lastTick_ + 1; t <= nowTick; ++t) {
+      expireSlot(slotFor(t));
+    }
+  }
+  lastTick_ = nowTick - 1;
+
+  size_t numExpired = expired.size() - before;
+  size_t remaining = numExpired
+      ? pending_.fetch_sub(numExpired, std::memory_order_acq_rel) - numExpired
+      : pending_.load(std::memory_order_acquire);
+  // Refresh the bound, so that pollers don't keep taking the lock until the next deadline.
+  nextDeadline_.store(
+      remaining ? computeNextDeadline(nowTick) : std::numeric_limits<double>::infinity(),
+      std::memory_order_release);
+  return true;
+}
+
+double TimerWheel::computeNextDeadline(int64_t fromTick) {
+  for (int64_t t = fromTick; t < fromTick + static_cast<int64_t>(kNumSlots); ++t) {
+    double best = std::numeric_limits<double>::infinity();
+    for (auto& timer : slotFor(t)) {
+      if (timer.tick == t) {
+        best = std::min(best, timer.deadline);
+      }
+    }
+    if (best < std::numeric_limits<double>::infinity()) {
+      return best;
+    }
+  }
+  // Everything pending is at least a rotation away.
+  return static_cast<double>(fromTick + static_cast<int64_t>(kNumSlots)) * kTickSeconds;
+}
+
+} // namespace detail
+} // namespace dispenso
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+#include <dispenso/once_function.h>
+#include <dispenso/platform.h>
+
+namespace dispenso {
+namespace detail {
+
+// A hashed timer wheel (Varghese and Lauck).  Timers are bucketed by deadline tick modulo the
+// number of slots, so insertion is O(1), and expiry only visits the slots for ticks that have
+// elapsed.  Timers more than one rotation out simply stay in their slot until their own rotation
+// comes around.  Times are in seconds, as returned by getTime().
+class TimerWheel {
+ public:
+  static constexpr size_t kNumSlots = 256;
+  static constexpr double kTickSeconds = 100e-6;
+
+  DISPENSO_DLL_ACCESS TimerWheel();
+
+  // Add a timer.  Returns true if this deadline is earlier than any other pending timer, in which
+  // case sleeping threads may need to be woken to service it in time.
+  DISPENSO_DLL_ACCESS bool add(double deadline, OnceFunction f);
+
+  // Move every timer whose deadline is at or before now into expired.  Returns false without
+  // doing anything if another thread is already collecting.
+  DISPENSO_DLL_ACCESS bool collectExpired(double now, std::vector<OnceFunction>& expired);
+
+  size_t pending() const {
+    return pending_.load(std::memory_order_acquire);
+  }
+
+  // A lower bound on the earliest pending deadline, or infinity if there are none.
+  double nextDeadline() const {
+    return nextDeadline_.load(std::memory_order_acquire);
+  }
+
+ private:
+  struct Timer {
+    int64_t tick;
+    double deadline;
+    OnceFunction f;
+  };
+
+  static int64_t tickOf(double t) {
+    return static_cast<int64_t>(t / kTickSeconds);
+  }
+
+  std::vector<Timer>& slotFor(int64_t tick) {
+    return slots_[static_cast<size_t>(tick) % kNumSlots];
+  }
+
+  double computeNextDeadline(int64_t fromTick);
+
+  std::mutex mtx_;
+  std::vector<std::vector<Timer>> slots_;
+  // Ticks up to and including lastTick_ have been fully expired.
+  int64_t lastTick_;
+  alignas(kCacheLineSize) std::atomic<size_t> pending_{0};
+  std::atomic<double> nextDeadline_{std::numeric_limits<double>::infinity()};
+};
+
+} // namespace detail
+} // namespace dispenso
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+namespace dispenso {
+namespace detail {
+
+// Given the slabs backing a pool and the pool's free chunks, release every slab with all of its
+// chunks free through freeSlab, and remove those slabs and their chunks from the vectors.  Returns
+// the number of slabs released.
+template <typename FreeSlab>
+size_t trimFreeSlabs(
+    std::vector<char*>& slabs,
+    std::vector<char*>& chunks,
+    size_t chunksPerSlab,
+    FreeSlab&& freeSlab) {
+  std::less<char*> less;
+  std::sort(slabs.begin(), slabs.end(), less);
+  auto slabOf = [&slabs, less](char* chunk) {
+    return static_cast<size_t>(std::upper_bound(slabs.begin(), slabs.end(), chunk, less) -
+                               slabs.begin()) -
+        1;
+  };
+
+  std::vector<size_t> freeCounts(slabs.size(), 0);
+  size_t numFree = 0;
+  for (char* chunk : chunks) {
+    numFree += ++freeCounts[slabOf(chunk)] == chunksPerSlab;
+  }
+  if (!numFree) {
+    return 0;
+  }
+
+  chunks.erase(
+      std::remove_if(
+          chunks.begin(),
+          chunks.end(),
+          [&](char* chunk) { return freeCounts[slabOf(chunk)] == chunksPerSlab; }),
+      chunks.end());
+
+  size_t kept = 0;
+  for (size_t i = 0; i < slabs.size(); ++i) {
+    if (freeCounts[i] == chunksPerSlab) {
+      freeSlab(slabs[i]);
+    } else {
+      slabs[kept++] = slabs[i];
+    }
+  }
+  slabs.resize(kept);
+  return numFree;
+}
+
+} // namespace detail
+} // namespace dispenso
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <type_traits>
+#include <utility>
+
+#include <dispenso/detail/math.h>
+#include <dispenso/small_buffer_allocator.h>
+
+namespace dispenso {
+namespace detail {
+
+template <typename R, typename... Args>
+class UniqueCallable {
+ public:
+  virtual R call(Args&&... args) = 0;
+  virtual void destroy() = 0;
+
+ protected:
+  ~UniqueCallable() = default;
+};
+
+template <typename R>
+struct InvokeAs {
+  template <typename F, typename... Args>
+  static R invoke(F& f, Args&&... args) {
+    return f(std::forward<Args>(args)...);
+  }
+};
+
+template <>
+struct InvokeAs<void> {
+  template <typename F, typename... Args>
+  static void invoke(F& f, Args&&... args) {
+    f(std::forward<Args>(args)...);
+  }
+};
+
+template <size_t kBufferSize, typename F, typename R, typename... Args>
+class UniqueCallableImpl final : public UniqueCallable<R, Args...> {
+ public:
+  template <typename G>
+  UniqueCallableImpl(G&& f) : f_(std::forward<G>(f)) {}
+
+  R call(Args&&... args) override {
+    return InvokeAs<R>::invoke(f_, std::forward<Args>(args)...);
+  }
+
+  void destroy() override {
+    this->~UniqueCallableImpl();
+    deallocSmallBuffer<kBufferSize>(this);
+  }
+
+ private:
+  F f_;
+};
+
+template <typename R, typename... Args, typename F>
+inline UniqueCallable<R, Args...>* createUniqueCallable(F&& f) {
+  using FDecay = std::decay_t<F>;
+
+  constexpr size_t kImplSize = nextPow2(sizeof(UniqueCallableImpl<16, FDecay, R, Args...>));
+
+  return new (allocSmallBuffer<kImplSize>())
+      UniqueCallableImpl<kImplSize, FDecay, R, Args...>(std::forward<F>(f));
+}
+
+} // namespace detail
+} // namespace dispenso
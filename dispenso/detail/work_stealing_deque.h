@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <dispenso/platform.h>
+
+namespace dispenso {
+namespace detail {
+
+// A Chase-Lev work-stealing deque of pointers, following "Correct and Efficient Work-Stealing for
+// Weak Memory Models" (Le et al. 2013).  A single owner thread may push() and pop() from the
+// bottom (LIFO), while any number of thief threads may steal() from the top (FIFO).  The ring
+// grows on demand by the owner; retired rings are kept alive until destruction, since a thief may
+// still be reading from one.
+template <typename T>
+class alignas(kCacheLineSize) WorkStealingDeque {
+ public:
+  WorkStealingDeque(size_t initialCapacity = 256) {
+    size_t cap = 1;
+    while (cap < initialCapacity) {
+      cap <<= 1;
+    }
+    rings_.emplace_back(std::make_unique<Ring>(cap));
+    ring_.store(rings_.back().get(), std::memory_order_relaxed);
+  }
+
+  WorkStealingDeque(const WorkStealingDeque&) = delete;
+  WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+  // Owner only.
+  void push(T* item) {
+    ssize_t b = bottom_.load(std::memory_order_relaxed);
+    ssize_t t = top_.load(std::memory_order_acquire);
+    Ring* ring = ring_.load(std::memory_order_relaxed);
+    if (b - t > ring->mask) {
+      ring = grow(ring, t, b);
+    }
+    ring->put(b, item);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+  }
+
+  // Owner only.  Returns nullptr if empty.
+  T* pop() {
+    ssize_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    Ring* ring = ring_.load(std::memory_order_relaxed);
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    ssize_t t = top_.load(std::memory_order_relaxed);
+
+    if (t > b) {
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+
+    T* item = ring->get(b);
+    if (t == b) {
+      // Last item; race against thieves for it.
+      if (!top_.compare_exchange_strong(
+              t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        item = nullptr;
+      }
+      bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+    return item;
+  }
+
+  // Any thread.  Returns nullptr if empty or if the steal lost a race.
+  T* steal() {
+    ssize_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    ssize_t b = bottom_.load(std::memory_order_acquire);
+    if (t >= b) {
+      return nullptr;
+    }
+    Ring* ring = ring_.load(std::memory_order_acquire);
+    T* item = ring->get(t);
+    if (!top_.compare_exchange_strong(
+            t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+      return nullptr;
+    }
+    return item;
+  }
+
+  // Approximate; may be stale by the time it is used.
+  bool empty() const {
+    return bottom_.load(std::memory_order_relaxed) <= top_.load(std::memory_order_relaxed);
+  }
+
+#if __cplusplus < 201703L
+  static void* operator new(size_t sz) {
+    return detail::alignedMalloc(sz);
+  }
+  static void operator delete(void* ptr) {
+    return detail::alignedFree(ptr);
+  }
+#endif // __cplusplus
+
+ private:
+  struct Ring {
+    Ring(size_t capacity)
+        : mask(static_cast<ssize_t>(capacity) - 1),
+          slots(std::make_unique<std::atomic<T*>[]>(capacity)) {}
+
+    T* get(ssize_t i) const {
+      return slots[static_cast<size_t>(i & mask)].load(std::memory_order_relaxed);
+    }
+    void put(ssize_t i, T* item) {
+      slots[static_cast<size_t>(i & mask)].store(item, std::memory_order_relaxed);
+    }
+
+    ssize_t mask;
+    std::unique_ptr<std::atomic<T*>[]> slots;
+  };
+
+  Ring* grow(Ring* old, ssize_t t, ssize_t b) {
+    auto ring = std::make_unique<Ring>(static_cast<size_t>(old->mask + 1) * 2);
+    for (ssize_t i = t; i < b; ++i) {
+      ring->put(i, old->get(i));
+    }
+    Ring* raw = ring.get();
+    rings_.emplace_back(std::move(ring));
+    ring_.store(raw, std::memory_order_release);
+    return raw;
+  }
+
+  alignas(kCacheLineSize) std::atomic<ssize_t> top_{0};
+  alignas(kCacheLineSize) std::atomic<ssize_t> bottom_{0};
+  std::atomic<Ring*> ring_;
+  std::vector<std::unique_ptr<Ring>> rings_;
+};
+
+} // namespace detail
+} // namespace dispenso
@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/epoch_domain.h>
+
+#include <algorithm>
+#include <cassert>
+#include <thread>
+
+namespace dispenso {
+namespace detail {
+
+namespace {
+
+std::atomic<uint64_t> g_nextDomainId{1};
+
+struct ThreadRecord {
+  uint64_t domain;
+  std::shared_ptr<EpochRecordList> records;
+  EpochRecord* record;
+};
+
+// The records this thread has registered, released for reuse by future threads on exit.
+struct ThreadRecords {
+  ~ThreadRecords() {
+    for (auto& entry : entries) {
+      releaseReaderRecord(*entry.record);
+    }
+    PerPoolPerThreadInfo::setEpochRecord(0, nullptr);
+  }
+  std::vector<ThreadRecord> entries;
+};
+
+void lockBag(EpochRecord& record) {
+  while (record.bagLocked.exchange(true, std::memory_order_acquire)) {
+    std::this_thread::yield();
+  }
+}
+
+void unlockBag(EpochRecord& record) {
+  record.bagLocked.store(false, std::memory_order_release);
+}
+
+} // namespace
+
+EpochRecord& registerEpochThread(
+    uint64_t domain,
+    const std::shared_ptr<EpochRecordList>& records) {
+  static thread_local ThreadRecords threadRecords;
+  auto& entries = threadRecords.entries;
+  auto it = std::find_if(entries.begin(), entries.end(), [domain](const ThreadRecord& entry) {
+    return entry.domain == domain;
+  });
+  EpochRecord* record;
+  if (it != entries.end()) {
+    record = it->record;
+  } else {
+    // Forget domains that have since been destroyed; this thread holds the last reference.
+    entries.erase(
+        std::remove_if(
+            entries.begin(),
+            entries.end(),
+            [](const ThreadRecord& entry) { return entry.records.use_count() == 1; }),
+        entries.end());
+    // Records are only freed with the list, since reclamation may be scanning it at any time.
+    record = acquireReaderRecord(records->head);
+    entries.push_back({domain, records, record});
+  }
+  PerPoolPerThreadInfo::setEpochRecord(domain, record);
+  return *record;
+}
+
+} // namespace detail
+
+EpochDomain::EpochDomain(ThreadPool& pool, size_t batchSize)
+    : id_(detail::g_nextDomainId.fetch_add(1, std::memory_order_relaxed)),
+      batchSize_(std::max<size_t>(1, batchSize)),
+      records_(std::make_shared<detail::EpochRecordList>()),
+      tasks_(pool) {}
+
+void EpochDomain::retire(void* ptr, void (*deleter)(void*)) {
+  // Pairs with the fence in Guard: readers that may have seen ptr entered in this epoch or
+  // earlier.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  const uint64_t epoch = epoch_.load(std::memory_order_relaxed);
+  retiredCount_.fetch_add(1, std::memory_order_relaxed);
+
+  void* cached = detail::PerPoolPerThreadInfo::epochRecord(id_);
+  detail::EpochRecord& record = cached ? *static_cast<detail::EpochRecord*>(cached)
+                                       : detail::registerEpochThread(id_, records_);
+  std::vector<detail::EpochRetired> batch;
+  detail::lockBag(record);
+  record.bag.push_back({ptr, deleter, epoch});
+  if (record.bag.size() >= batchSize_) {
+    batch.swap(record.bag);
+  }
+  detail::unlockBag(record);
+  if (batch.empty()) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lk(pendingMutex_);
+    pending_.insert(pending_.end(), batch.begin(), batch.end());
+  }
+  if (!reclaimScheduled_.exchange(true, std::memory_order_acq_rel)) {
+    tasks_.schedule([this]() { reclaim(); });
+  }
+}
+
+uint64_t EpochDomain::oldestActiveEpoch() const {
+  return detail::oldestReaderEpoch(records_->head);
+}
+
+void EpochDomain::collectBags(bool all) {
+  std::vector<detail::EpochRetired> collected;
+  for (detail::EpochRecord* r = records_->head.load(std::memory_order_acquire); r; r = r->next) {
+    // Batches of threads that have exited would otherwise wait for a new thread to fill them.
+    if (!all && r->inUse.load(std::memory_order_acquire)) {
+      continue;
+    }
+    detail::lockBag(*r);
+    collected.insert(collected.end(), r->bag.begin(), r->bag.end());
+    r->bag.clear();
+    detail::unlockBag(*r);
+  }
+  if (!collected.empty()) {
+    std::lock_guard<std::mutex> lk(pendingMutex_);
+    pending_.insert(pending_.end(), collected.begin(), collected.end());
+  }
+}
+
+void EpochDomain::reclaimBefore(uint64_t epoch) {
+  std::vector<detail::EpochRetired> toFree;
+  {
+    std::lock_guard<std::mutex> lk(pendingMutex_);
+    auto keep = std::partition(
+        pending_.begin(), pending_.end(), [epoch](const detail::EpochRetired& r) {
+          return r.epoch >= epoch;
+        });
+    toFree.assign(keep, pending_.end());
+    pending_.erase(keep, pending_.end());
+  }
+  for (auto& r : toFree) {
+    r.deleter(r.ptr);
+  }
+  retiredCount_.fetch_sub(toFree.size(), std::memory_order_relaxed);
+}
+
+void EpochDomain::reclaim() {
+  // Clear the flag first, so that batches handed over from here on schedule another pass.
+  reclaimScheduled_.store(false, std::memory_order_release);
+  collectBags(false);
+  // Readers entering from here on cannot reach anything retired so far.
+  epoch_.fetch_add(1, std::memory_order_seq_cst);
+  reclaimBefore(oldestActiveEpoch());
+}
+
+void EpochDomain::synchronize() {
+  assert(
+      (!detail::PerPoolPerThreadInfo::epochRecord(id_) ||
+       !static_cast<detail::EpochRecord*>(detail::PerPoolPerThreadInfo::epochRecord(id_))
+            ->nesting) &&
+      "EpochDomain::synchronize must not be called while holding a Guard");
+  collectBags(true);
+  const uint64_t epoch = epoch_.fetch_add(1, std::memory_order_seq_cst);
+  // Wait for readers that entered in or before the epoch to leave.
+  while (oldestActiveEpoch() <= epoch) {
+    std::this_thread::yield();
+  }
+  reclaimBefore(epoch + 1);
+}
+
+EpochDomain::~EpochDomain() {
+  tasks_.wait();
+  collectBags(true);
+  for (auto& r : pending_) {
+    r.deleter(r.ptr);
+  }
+}
+
+EpochDomain& globalEpochDomain() {
+  static EpochDomain domain;
+  return domain;
+}
+
+} // namespace dispenso
@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file epoch_domain.h
+ * A file providing EpochDomain, epoch-based safe memory reclamation for lock-free data structures.
+ * Readers enter the domain for the duration of each operation, and objects unlinked from a
+ * structure are retired to the domain, which destroys them in batches on a pool once no reader can
+ * still hold a reference.
+ **/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <dispenso/detail/per_thread_info.h>
+#include <dispenso/detail/reader_records.h>
+#include <dispenso/platform.h>
+#include <dispenso/task_set.h>
+
+namespace dispenso {
+namespace detail {
+
+struct EpochRetired {
+  void* ptr;
+  void (*deleter)(void*);
+  // Readers that entered in this epoch or earlier may still refer to ptr.
+  uint64_t epoch;
+};
+
+struct EpochRecord : ReaderRecord<EpochRecord> {
+  // Guards bag, which is normally only touched by the owning thread.
+  std::atomic<bool> bagLocked{false};
+  std::vector<EpochRetired> bag;
+};
+
+// Records live as long as the domain or the longest-lived thread that used it, whichever is later,
+// so that exiting threads can always release theirs.
+struct EpochRecordList {
+  std::atomic<EpochRecord*> head{nullptr};
+
+  ~EpochRecordList() {
+    EpochRecord* r = head.load(std::memory_order_acquire);
+    while (r) {
+      EpochRecord* next = r->next;
+      delete r;
+      r = next;
+    }
+  }
+};
+
+DISPENSO_DLL_ACCESS EpochRecord& registerEpochThread(
+    uint64_t domain,
+    const std::shared_ptr<EpochRecordList>& records);
+
+} // namespace detail
+
+/**
+ * An epoch-based memory reclamation domain.  A thread reading a lock-free structure holds a Guard
+ * from <code>enter()</code> while it follows pointers; a thread that unlinks a node passes it to
+ * <code>retire()</code> instead of deleting it.  Entering is wait-free and touches only the
+ * thread's own record.
+ *
+ * Retired objects are gathered in per-thread batches.  Each full batch is handed to the domain,
+ * and a reclamation task on the domain's pool advances the epoch and destroys every retired object
+ * that no current reader can reach.  Threads register a record on first use, and the record is
+ * recycled when the thread exits, so the number of records is bounded by the peak number of
+ * threads using the domain.  Garbage is bounded by the batch size per thread plus whatever was
+ * retired while the oldest current guard has been held.
+ **/
+class EpochDomain {
+ public:
+  /**
+   * An RAII guard marking the current thread as reading the domain.  Objects retired after the
+   * guard was created are not destroyed until it is destroyed.  Guards may nest, and must be
+   * destroyed on the thread that created them.
+   **/
+  class Guard {
+   public:
+    Guard(Guard&& other) : record_(other.record_) {
+      other.record_ = nullptr;
+    }
+
+    Guard(const Guard&) = delete;
+    Guard& operator=(const Guard&) = delete;
+    Guard& operator=(Guard&&) = delete;
+
+    ~Guard() {
+      if (record_ && --record_->nesting == 0) {
+        record_->epoch.store(0, std::memory_order_release);
+      }
+    }
+
+   private:
+    Guard(detail::EpochRecord& record, const std::atomic<uint64_t>& epoch) : record_(&record) {
+      if (record.nesting++ == 0) {
+        record.epoch.store(epoch.load(std::memory_order_acquire), std::memory_order_relaxed);
+        // Pairs with the fence in retire: either reclamation sees this epoch, or this thread's
+        // subsequent reads do not see the retired object.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+      }
+    }
+
+    detail::EpochRecord* record_;
+
+    friend class EpochDomain;
+  };
+
+  /**
+   * Construct an EpochDomain.
+   *
+   * @param pool The pool on which reclamation tasks run, and so on which deleters are called.
+   * @param batchSize The number of objects a thread retires before handing them to the domain
+   * for reclamation.
+   **/
+  DISPENSO_DLL_ACCESS explicit EpochDomain(
+      ThreadPool& pool = globalThreadPool(),
+      size_t batchSize = 64);
+
+  EpochDomain(const EpochDomain&) = delete;
+  EpochDomain& operator=(const EpochDomain&) = delete;
+
+  /**
+   * Enter the domain.  Wait-free.
+   *
+   * @return A guard that keeps the calling thread in the domain until it is destroyed.
+   **/
+  Guard enter() {
+    void* record = detail::PerPoolPerThreadInfo::epochRecord(id_);
+    return Guard(
+        record ? *static_cast<detail::EpochRecord*>(record)
+               : detail::registerEpochThread(id_, records_),
+        epoch_);
+  }
+
+  /**
+   * Retire an object that has been unlinked, so that no new reader can reach it.  It is destroyed
+   * once every reader that might still refer to it has left the domain.  Concurrency safe, and may
+   * be called while holding a Guard.
+   *
+   * @param ptr The object to retire.
+   * @param deleter The function that destroys the object.  Called on an arbitrary thread.
+   **/
+  DISPENSO_DLL_ACCESS void retire(void* ptr, void (*deleter)(void*));
+
+  /**
+   * Retire an object allocated with <code>new</code>.  See the other overload for details.
+   *
+   * @param ptr The object to retire, which is destroyed with <code>delete</code>.
+   **/
+  template <typename T>
+  void retire(T* ptr) {
+    retire(static_cast<void*>(ptr), [](void* p) { delete static_cast<T*>(p); });
+  }
+
+  /**
+   * Wait until every guard in progress on any thread has been destroyed, and then destroy every
+   * object retired to the domain before the call, including those still in other threads'
+   * batches.  Must not be called while holding a Guard on this domain.
+   **/
+  DISPENSO_DLL_ACCESS void synchronize();
+
+  /**
+   * Get the number of objects retired and not yet destroyed.  Concurrency safe.
+   *
+   * @return The number of objects awaiting reclamation.
+   **/
+  size_t retiredCount() const {
+    return retiredCount_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Destroy the domain and every object still retired to it, after waiting for any reclamation
+   * task in progress.  There must be no guards in progress on the domain, and no concurrent calls
+   * to <code>retire</code>.
+   **/
+  DISPENSO_DLL_ACCESS ~EpochDomain();
+
+ private:
+  uint64_t oldestActiveEpoch() const;
+  void collectBags(bool all);
+  void reclaimBefore(uint64_t epoch);
+  void reclaim();
+
+  const uint64_t id_;
+  const size_t batchSize_;
+  std::shared_ptr<detail::EpochRecordList> records_;
+  // Epoch 0 marks a record outside the domain, so the epoch starts at 1.
+  alignas(kCacheLineSize) std::atomic<uint64_t> epoch_{1};
+  std::atomic<size_t> retiredCount_{0};
+  std::atomic<bool> reclaimScheduled_{false};
+
+  std::mutex pendingMutex_;
+  std::vector<detail::EpochRetired> pending_;
+
+  ConcurrentTaskSet tasks_;
+};
+
+/**
+ * Get a process-wide EpochDomain that reclaims on the global thread pool, for structures that
+ * have no reason to keep their garbage apart.
+ *
+ * @return The global domain.
+ **/
+DISPENSO_DLL_ACCESS EpochDomain& globalEpochDomain();
+
+} // namespace dispenso
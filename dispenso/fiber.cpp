@@ -0,0 +1,353 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+// ucontext.h is only declared with the X/Open extensions on macOS, which must be requested before
+// any system header is included.
+#if defined(__APPLE__) && !defined(_XOPEN_SOURCE)
+#define _XOPEN_SOURCE 600
+#endif // __APPLE__
+
+#include <dispenso/fiber.h>
+
+#include <algorithm>
+#include <cassert>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include <dispenso/detail/fiber_wait.h>
+#include <dispenso/task_set.h>
+#include <dispenso/tsan_annotations.h>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#define DISPENSO_UCONTEXT_FIBERS 0
+#elif defined(__unix__) || defined(__APPLE__)
+#include <ucontext.h>
+#define DISPENSO_UCONTEXT_FIBERS 1
+#else
+#define DISPENSO_UCONTEXT_FIBERS 0
+#endif // PLATFORM
+
+#if defined(__APPLE__)
+// The ucontext functions are deprecated on macOS, but remain the portable way to switch stacks.
+#pragma clang diagnostic ignored "-Wdeprecated-declarations"
+#endif // __APPLE__
+
+#if DISPENSO_HAS_TSAN
+extern "C" {
+void* __tsan_get_current_fiber(void);
+void* __tsan_create_fiber(unsigned flags);
+void __tsan_destroy_fiber(void* fiber);
+void __tsan_switch_to_fiber(void* fiber, unsigned flags);
+}
+#endif // DISPENSO_HAS_TSAN
+
+namespace dispenso {
+
+constexpr size_t FiberTaskSet::kDefaultStackSize;
+
+namespace detail {
+
+struct Fiber {
+  Fiber(FiberTaskSet* set, OnceFunction func) : owner(set), f(std::move(func)) {}
+
+  FiberTaskSet* owner;
+  OnceFunction f;
+  // While suspended, the fiber may resume once ready(readyArg) returns true.  readyArg also keys
+  // the fiber for wakeFibers.
+  bool (*ready)(const void*) = nullptr;
+  const void* readyArg = nullptr;
+  // The resuming thread's state when the fiber was last switched to.  Only frames the fiber pushed
+  // on top of this state can travel with it to another thread, so it must be back to exactly this
+  // state to suspend.
+  size_t taskSetDepth = 0;
+  int parForLevel = 0;
+  bool finished = false;
+#if defined(_WIN32)
+  void* handle = nullptr;
+  void* caller = nullptr;
+#elif DISPENSO_UCONTEXT_FIBERS
+  ucontext_t context;
+  ucontext_t* caller = nullptr;
+#endif // PLATFORM
+#if DISPENSO_HAS_TSAN
+  void* tsanFiber = nullptr;
+  void* tsanCaller = nullptr;
+#endif // DISPENSO_HAS_TSAN
+};
+
+namespace {
+// Each stack chunk starts with its Fiber, and the rest is the stack.
+constexpr size_t kFiberHeaderSize = alignToCacheLine(sizeof(Fiber));
+constexpr size_t kStacksPerSlab = 8;
+
+size_t stackChunkSize(size_t stackSize) {
+  return kFiberHeaderSize + alignToCacheLine(stackSize);
+}
+
+struct SuspendedFibers {
+  std::mutex mtx;
+  std::vector<Fiber*> fibers;
+};
+
+SuspendedFibers& suspendedFibers() {
+  // Leaked, since fibers may be woken during static destruction.
+  static SuspendedFibers* suspended = new SuspendedFibers();
+  return *suspended;
+}
+} // namespace
+
+std::atomic<size_t> g_suspendedFibers{0};
+
+struct FiberAccess {
+  static Fiber* create(FiberTaskSet& set, OnceFunction f);
+  static void destroy(Fiber* fiber);
+  // Runs the fiber's functor on the fiber's stack, and then leaves it for good.
+  static void run(Fiber* fiber);
+  static void switchToCaller(Fiber* fiber);
+  // Runs the fiber on the calling thread until it finishes or suspends.
+  static void resume(Fiber* fiber);
+  // Registers a fiber that has switched out to wait, unless it is already ready to resume.
+  static bool park(Fiber* fiber);
+  static void scheduleResume(Fiber* fiber);
+};
+
+namespace {
+#if defined(_WIN32)
+void WINAPI fiberEntry(void* fiber) {
+  FiberAccess::run(static_cast<Fiber*>(fiber));
+}
+#elif DISPENSO_UCONTEXT_FIBERS
+void fiberEntry() {
+  // makecontext can only portably pass int arguments, so the fiber is found through the thread,
+  // which resume points at it before switching.
+  FiberAccess::run(static_cast<Fiber*>(PerPoolPerThreadInfo::fiber()));
+}
+#endif // PLATFORM
+} // namespace
+
+Fiber* FiberAccess::create(FiberTaskSet& set, OnceFunction f) {
+#if defined(_WIN32)
+  Fiber* fiber = new Fiber(&set, std::move(f));
+  fiber->handle = CreateFiber(set.stackSize_, &fiberEntry, fiber);
+  assert(fiber->handle);
+#elif DISPENSO_UCONTEXT_FIBERS
+  char* chunk = set.stacks_.alloc();
+  Fiber* fiber = new (chunk) Fiber(&set, std::move(f));
+  getcontext(&fiber->context);
+  fiber->context.uc_stack.ss_sp = chunk + kFiberHeaderSize;
+  fiber->context.uc_stack.ss_size = stackChunkSize(set.stackSize_) - kFiberHeaderSize;
+  fiber->context.uc_link = nullptr;
+  makecontext(&fiber->context, &fiberEntry, 0);
+#else
+  Fiber* fiber = new Fiber(&set, std::move(f));
+#endif // PLATFORM
+#if DISPENSO_HAS_TSAN
+  fiber->tsanFiber = __tsan_create_fiber(0);
+#endif // DISPENSO_HAS_TSAN
+  return fiber;
+}
+
+void FiberAccess::destroy(Fiber* fiber) {
+#if DISPENSO_HAS_TSAN
+  __tsan_destroy_fiber(fiber->tsanFiber);
+#endif // DISPENSO_HAS_TSAN
+#if defined(_WIN32)
+  DeleteFiber(fiber->handle);
+  delete fiber;
+#elif DISPENSO_UCONTEXT_FIBERS
+  FiberTaskSet* set = fiber->owner;
+  fiber->~Fiber();
+  set->stacks_.dealloc(reinterpret_cast<char*>(fiber));
+#else
+  delete fiber;
+#endif // PLATFORM
+}
+
+void FiberAccess::run(Fiber* fiber) {
+#if defined(__cpp_exceptions)
+  try {
+    fiber->f();
+  } catch (...) {
+    FiberTaskSet* set = fiber->owner;
+    if (!set->failed_.exchange(true, std::memory_order_acq_rel)) {
+      set->exception_ = std::current_exception();
+    }
+  }
+#else
+  fiber->f();
+#endif // __cpp_exceptions
+  fiber->finished = true;
+  switchToCaller(fiber);
+}
+
+void FiberAccess::switchToCaller(Fiber* fiber) {
+#if DISPENSO_HAS_TSAN
+  __tsan_switch_to_fiber(fiber->tsanCaller, 0);
+#endif // DISPENSO_HAS_TSAN
+#if defined(_WIN32)
+  SwitchToFiber(fiber->caller);
+#elif DISPENSO_UCONTEXT_FIBERS
+  swapcontext(&fiber->context, fiber->caller);
+#endif // PLATFORM
+}
+
+void FiberAccess::resume(Fiber* fiber) {
+  void* prev = PerPoolPerThreadInfo::fiber();
+  fiber->taskSetDepth = threadTaskSetDepth();
+  fiber->parForLevel = PerPoolPerThreadInfo::parForRecursionLevel();
+  PerPoolPerThreadInfo::setFiber(fiber);
+#if DISPENSO_HAS_TSAN
+  fiber->tsanCaller = __tsan_get_current_fiber();
+  __tsan_switch_to_fiber(fiber->tsanFiber, 0);
+#endif // DISPENSO_HAS_TSAN
+#if defined(_WIN32)
+  // Nested resumes come from a fiber, and only the thread's first resume needs converting it.
+  fiber->caller = IsThreadAFiber() ? GetCurrentFiber() : ConvertThreadToFiber(nullptr);
+  SwitchToFiber(fiber->handle);
+#elif DISPENSO_UCONTEXT_FIBERS
+  ucontext_t caller;
+  fiber->caller = &caller;
+  swapcontext(&caller, &fiber->context);
+#else
+  run(fiber);
+#endif // PLATFORM
+  PerPoolPerThreadInfo::setFiber(prev);
+
+  if (fiber->finished) {
+    std::atomic<size_t>* outstanding = &fiber->owner->outstanding_;
+    destroy(fiber);
+    // The set may be destroyed as soon as this is zero.
+    if (outstanding->fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      wakeFibers(outstanding);
+    }
+  } else if (!park(fiber)) {
+    scheduleResume(fiber);
+  }
+}
+
+bool FiberAccess::park(Fiber* fiber) {
+  SuspendedFibers& suspended = suspendedFibers();
+  std::lock_guard<std::mutex> lk(suspended.mtx);
+  g_suspendedFibers.fetch_add(1, std::memory_order_relaxed);
+  // Pairs with the fence in wakeFibers.  Checking under the lock means the fiber is not yet
+  // visible to wakers, so nothing else can resume it, and what it waits on is still alive.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (fiber->ready(fiber->readyArg)) {
+    g_suspendedFibers.fetch_sub(1, std::memory_order_relaxed);
+    return false;
+  }
+  suspended.fibers.push_back(fiber);
+  return true;
+}
+
+void FiberAccess::scheduleResume(Fiber* fiber) {
+  // With no pool threads, e.g. if the pool was shrunk while the fiber was suspended, this resumes
+  // the fiber on the waking thread.
+  fiber->owner->pool_.schedule([fiber]() { resume(fiber); }, ForceQueuingTag());
+}
+
+void wakeSuspendedFibers(const void* arg) {
+  std::vector<Fiber*> woken;
+  {
+    SuspendedFibers& suspended = suspendedFibers();
+    std::lock_guard<std::mutex> lk(suspended.mtx);
+    auto& fibers = suspended.fibers;
+    auto it = std::partition(
+        fibers.begin(), fibers.end(), [arg](Fiber* f) { return f->readyArg != arg; });
+    if (it == fibers.end()) {
+      return;
+    }
+    woken.assign(it, fibers.end());
+    fibers.erase(it, fibers.end());
+    g_suspendedFibers.fetch_sub(woken.size(), std::memory_order_relaxed);
+  }
+  for (Fiber* fiber : woken) {
+    FiberAccess::scheduleResume(fiber);
+  }
+}
+
+bool suspendFiberUntil(bool (*ready)(const void*), const void* arg) {
+#if defined(_WIN32) || DISPENSO_UCONTEXT_FIBERS
+  Fiber* fiber = static_cast<Fiber*>(PerPoolPerThreadInfo::fiber());
+  if (!fiber || !fiber->owner->pool().numThreads() ||
+      fiber->taskSetDepth != threadTaskSetDepth() ||
+      fiber->parForLevel != PerPoolPerThreadInfo::parForRecursionLevel()) {
+    return false;
+  }
+  while (!ready(arg)) {
+    fiber->ready = ready;
+    fiber->readyArg = arg;
+    // Returns once resumed, maybe on another thread, and so fiber must not be cached in thread
+    // state across this.
+    FiberAccess::switchToCaller(fiber);
+  }
+  return true;
+#else
+  (void)ready;
+  (void)arg;
+  return false;
+#endif // PLATFORM
+}
+
+} // namespace detail
+
+FiberTaskSet::FiberTaskSet(ThreadPool& pool, size_t stackSize)
+    : pool_(pool),
+      stackSize_(stackSize),
+      stacks_(
+          detail::stackChunkSize(stackSize),
+          detail::stackChunkSize(stackSize) * detail::kStacksPerSlab,
+          [](size_t bytes) { return detail::alignedMalloc(bytes, kCacheLineSize); },
+          [](void* ptr) { detail::alignedFree(ptr); }) {}
+
+void FiberTaskSet::scheduleFiber(OnceFunction f) {
+  outstanding_.fetch_add(1, std::memory_order_relaxed);
+  detail::Fiber* fiber = detail::FiberAccess::create(*this, std::move(f));
+  pool_.schedule([fiber]() { detail::FiberAccess::resume(fiber); }, ForceQueuingTag());
+}
+
+namespace {
+bool noFibersOutstanding(const void* count) {
+  return !static_cast<const std::atomic<size_t>*>(count)->load(std::memory_order_acquire);
+}
+} // namespace
+
+void FiberTaskSet::waitForFibers() {
+  if (detail::inFiber() && detail::suspendFiberUntil(&noFibersOutstanding, &outstanding_)) {
+    return;
+  }
+  while (outstanding_.load(std::memory_order_acquire)) {
+    if (!pool_.tryExecuteNext()) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+void FiberTaskSet::wait() {
+  assert(
+      (!detail::inFiber() ||
+       static_cast<detail::Fiber*>(detail::PerPoolPerThreadInfo::fiber())->owner != this) &&
+      "FiberTaskSet::wait would wait for the calling fiber to finish");
+  waitForFibers();
+#if defined(__cpp_exceptions)
+  if (failed_.load(std::memory_order_acquire)) {
+    auto exception = std::move(exception_);
+    exception_ = nullptr;
+    failed_.store(false, std::memory_order_release);
+    std::rethrow_exception(exception);
+  }
+#endif // __cpp_exceptions
+}
+
+FiberTaskSet::~FiberTaskSet() {
+  waitForFibers();
+}
+
+} // namespace dispenso
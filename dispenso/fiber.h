@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file fiber.h
+ * A file providing FiberTaskSet, a task set whose tasks run as stackful fibers on a ThreadPool.
+ * A blocking wait inside such a task suspends the fiber instead of tying up its thread.
+ **/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <utility>
+
+#include <dispenso/once_function.h>
+#include <dispenso/pool_allocator.h>
+#include <dispenso/thread_pool.h>
+
+namespace dispenso {
+namespace detail {
+struct Fiber;
+struct FiberAccess;
+} // namespace detail
+
+/**
+ * A set of tasks that each run on their own stack.  When a task calls <code>Future::wait</code>,
+ * <code>TaskSet::wait</code>, <code>ConcurrentTaskSet::wait</code> or
+ * <code>FiberTaskSet::wait</code> on work that is not yet done, its fiber is suspended and the
+ * thread goes back to running other pool work, so tasks blocked on long dependency chains hold no
+ * threads, and cannot starve or deadlock the pool.  A suspended fiber is queued back to the pool
+ * by whichever thread completes its dependency, and may resume on another thread.
+ *
+ * Because fibers migrate between threads, a task must not keep thread-affine state (thread_local
+ * variables, locks, RCU or epoch read sections) across a wait.  Waits made from inside a
+ * parallel_for chunk or a TaskSet task that the fiber picked up while helping do not suspend, and
+ * block as usual.  Stacks have no guard pages, so tasks must stay within <code>stackSize</code>.
+ *
+ * Stacks are recycled through a PoolAllocator.  On Windows, stacks are created by the OS fiber API
+ * instead.  With a pool of zero threads, tasks run to completion on the scheduling thread.
+ **/
+class FiberTaskSet {
+ public:
+  /**
+   * The default stack size for each fiber, in bytes.
+   **/
+  static constexpr size_t kDefaultStackSize = 256 * 1024;
+
+  /**
+   * Construct a FiberTaskSet.
+   *
+   * @param pool The pool whose threads run the fibers.
+   * @param stackSize The size of each fiber's stack, in bytes.
+   **/
+  DISPENSO_DLL_ACCESS explicit FiberTaskSet(
+      ThreadPool& pool,
+      size_t stackSize = kDefaultStackSize);
+
+  FiberTaskSet(const FiberTaskSet&) = delete;
+  FiberTaskSet& operator=(const FiberTaskSet&) = delete;
+
+  /**
+   * Schedule a functor to run as a fiber.  Fibers are always queued to the pool, unless the pool
+   * has no threads.  May be called concurrently, including from fibers of this set.
+   *
+   * @param f A functor matching signature <code>void()</code>.
+   **/
+  template <typename F>
+  void schedule(F&& f) {
+    scheduleFiber(OnceFunction(std::forward<F>(f)));
+  }
+
+  /**
+   * Wait for all scheduled fibers to finish.  The calling thread helps with pool work meanwhile,
+   * or, if called from a fiber, is suspended.  If any fiber threw, the first exception is
+   * rethrown, and the rest are dropped.  Must not be called from one of this set's own fibers,
+   * which would wait for itself to finish.
+   **/
+  DISPENSO_DLL_ACCESS void wait();
+
+  /**
+   * Get the number of fibers scheduled and not yet finished.  Only a snapshot under concurrency.
+   *
+   * @return The number of pending fibers, including running and suspended ones.
+   **/
+  size_t numPending() const {
+    return outstanding_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Get the pool backing the set.
+   *
+   * @return The pool whose threads run this set's fibers.
+   **/
+  ThreadPool& pool() const {
+    return pool_;
+  }
+
+  /**
+   * Get the stack size of the set's fibers.
+   *
+   * @return The size of each fiber's stack, in bytes.
+   **/
+  size_t stackSize() const {
+    return stackSize_;
+  }
+
+  /**
+   * Destroy the FiberTaskSet, first waiting for all fibers to finish.  Exceptions not collected
+   * by <code>wait</code> are dropped.
+   **/
+  DISPENSO_DLL_ACCESS ~FiberTaskSet();
+
+ private:
+  DISPENSO_DLL_ACCESS void scheduleFiber(OnceFunction f);
+  void waitForFibers();
+
+  ThreadPool& pool_;
+  const size_t stackSize_;
+  PoolAllocator stacks_;
+  alignas(kCacheLineSize) std::atomic<size_t> outstanding_{0};
+#if defined(__cpp_exceptions)
+  std::atomic<bool> failed_{false};
+  std::exception_ptr exception_;
+#endif // __cpp_exceptions
+
+  friend struct detail::FiberAccess;
+};
+
+} // namespace dispenso
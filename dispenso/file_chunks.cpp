@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/file_chunks.h>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // _WIN32
+
+namespace dispenso {
+
+#if defined(_WIN32)
+
+MappedFile::MappedFile(const std::string& path) {
+  HANDLE file = CreateFileA(
+      path.c_str(),
+      GENERIC_READ,
+      FILE_SHARE_READ,
+      nullptr,
+      OPEN_EXISTING,
+      FILE_FLAG_SEQUENTIAL_SCAN,
+      nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return;
+  }
+  file_ = file;
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size)) {
+    return;
+  }
+  size_ = static_cast<size_t>(size.QuadPart);
+  if (!size_) {
+    valid_ = true;
+    return;
+  }
+  mapping_ = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!mapping_) {
+    return;
+  }
+  data_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+  valid_ = data_ != nullptr;
+}
+
+void MappedFile::adviseSequential() const {}
+
+void MappedFile::adviseWillNeed(size_t, size_t) const {}
+
+MappedFile::~MappedFile() {
+  if (data_) {
+    UnmapViewOfFile(data_);
+  }
+  if (mapping_) {
+    CloseHandle(mapping_);
+  }
+  if (file_) {
+    CloseHandle(file_);
+  }
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == 0) {
+    size_ = static_cast<size_t>(st.st_size);
+    if (!size_) {
+      valid_ = true;
+    } else {
+      void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data != MAP_FAILED) {
+        data_ = static_cast<const char*>(data);
+        valid_ = true;
+      }
+    }
+  }
+  // The mapping keeps the file's contents reachable without the descriptor.
+  close(fd);
+}
+
+void MappedFile::adviseSequential() const {
+  if (data_) {
+    madvise(const_cast<char*>(data_), size_, MADV_SEQUENTIAL);
+  }
+}
+
+void MappedFile::adviseWillNeed(size_t offset, size_t length) const {
+  if (!data_ || offset >= size_) {
+    return;
+  }
+  // madvise needs a page-aligned start.
+  static const size_t kPageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  size_t end = std::min(size_, offset + length);
+  size_t start = offset & ~(kPageSize - 1);
+  madvise(const_cast<char*>(data_) + start, end - start, MADV_WILLNEED);
+}
+
+MappedFile::~MappedFile() {
+  if (data_) {
+    munmap(const_cast<char*>(data_), size_);
+  }
+}
+
+#endif // _WIN32
+
+} // namespace dispenso
@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file file_chunks.h
+ * A file providing MappedFile, a read-only memory mapping of a file, and
+ * <code>parallel_for_file_chunks</code>, which processes a delimited file's records in parallel
+ * without copying them.
+ **/
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <string>
+
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif // C++17
+
+#include <dispenso/parallel_for.h>
+#include <dispenso/platform.h>
+
+namespace dispenso {
+
+/**
+ * A read-only memory mapping of an entire file.
+ **/
+class MappedFile {
+ public:
+  /**
+   * Map a file.  Check <code>valid()</code> for success.
+   *
+   * @param path The path of the file to map.
+   **/
+  DISPENSO_DLL_ACCESS explicit MappedFile(const std::string& path);
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  /**
+   * Check whether the file was mapped.
+   *
+   * @return true if the file could be opened and mapped.  An empty file is valid, with a null
+   * <code>data()</code>.
+   **/
+  bool valid() const {
+    return valid_;
+  }
+
+  /**
+   * Get the file contents.
+   *
+   * @return A pointer to the first of <code>size()</code> bytes.
+   **/
+  const char* data() const {
+    return data_;
+  }
+
+  /**
+   * Get the file size.
+   *
+   * @return The number of bytes mapped.
+   **/
+  size_t size() const {
+    return size_;
+  }
+
+  /**
+   * Hint that the mapping will be read front to back, so the OS may read ahead aggressively.  A
+   * no-op where the OS offers no such hint.
+   **/
+  DISPENSO_DLL_ACCESS void adviseSequential() const;
+
+  /**
+   * Hint that a range of the mapping will be needed soon, so the OS may begin reading it in.  A
+   * no-op where the OS offers no such hint.
+   *
+   * @param offset The byte offset of the range.
+   * @param length The number of bytes in the range.  Clamped to the end of the file.
+   **/
+  DISPENSO_DLL_ACCESS void adviseWillNeed(size_t offset, size_t length) const;
+
+  DISPENSO_DLL_ACCESS ~MappedFile();
+
+ private:
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+  bool valid_ = false;
+#if defined(_WIN32)
+  void* file_ = nullptr;
+  void* mapping_ = nullptr;
+#endif // _WIN32
+};
+
+/**
+ * A contiguous run of whole records within a MappedFile.
+ **/
+struct FileChunk {
+  /** The first byte of the chunk. **/
+  const char* data;
+  /** The number of bytes in the chunk, including each record's trailing delimiter. **/
+  size_t size;
+  /** The byte offset of the chunk within the file. **/
+  size_t offset;
+
+#if __cplusplus >= 201703L
+  /**
+   * View the chunk as a string.
+   *
+   * @return A string_view over the chunk's bytes.
+   **/
+  std::string_view view() const {
+    return std::string_view(data, size);
+  }
+#endif // C++17
+};
+
+/**
+ * Options controlling <code>parallel_for_file_chunks</code>.
+ **/
+struct FileChunkOptions {
+  /**
+   * The approximate size of each chunk.  Chunk boundaries move forward to the next record start,
+   * so chunks vary in size, and a chunk is skipped entirely if one record spans it.
+   **/
+  size_t chunkBytes = size_t{4} << 20;
+  /**
+   * The number of chunks ahead of the one being started to request from the OS.  If 0, twice the
+   * number of threads in the pool.
+   **/
+  size_t prefetchChunks = 0;
+};
+
+namespace detail {
+// The start of the first record at or after offset in [data, data + size).
+inline size_t nextRecordStart(const char* data, size_t size, size_t offset, char delimiter) {
+  if (offset == 0 || offset >= size) {
+    return std::min(offset, size);
+  }
+  const void* found = std::memchr(data + offset - 1, delimiter, size - offset + 1);
+  return found ? static_cast<size_t>(static_cast<const char*>(found) - data) + 1 : size;
+}
+} // namespace detail
+
+/**
+ * Process a mapped file in parallel, in chunks of whole records.  Each chunk starts at the
+ * beginning of a record (just after a delimiter) and ends just after a delimiter, except that the
+ * last chunk ends at the end of the file.  Chunks are handed out in file order, with read-ahead
+ * requested a few chunks in front of the workers.
+ *
+ * @param taskSet The task set to schedule the chunks on.
+ * @param file The mapped file.  Must be valid.
+ * @param delimiter The byte that ends each record, e.g. <code>'\n'</code>.
+ * @param f A functor with signature <code>void(const FileChunk&)</code>.  The chunk's bytes point
+ * into the mapping and are valid for as long as <code>file</code> is.
+ * @param options See FileChunkOptions for details.
+ **/
+template <typename TaskSetT, typename F>
+void parallel_for_file_chunks(
+    TaskSetT& taskSet,
+    const MappedFile& file,
+    char delimiter,
+    F&& f,
+    FileChunkOptions options = {}) {
+  assert(file.valid());
+  assert(options.chunkBytes > 0);
+  const char* data = file.data();
+  const size_t size = file.size();
+  if (!size) {
+    return;
+  }
+  const size_t chunkBytes = options.chunkBytes;
+  const size_t numChunks = (size + chunkBytes - 1) / chunkBytes;
+  size_t prefetch = options.prefetchChunks;
+  if (!prefetch) {
+    prefetch = 2 * static_cast<size_t>(std::max<ssize_t>(1, taskSet.numPoolThreads()));
+  }
+
+  file.adviseSequential();
+  file.adviseWillNeed(0, prefetch * chunkBytes);
+
+  parallel_for(
+      taskSet,
+      makeChunkedRange(size_t{0}, numChunks, size_t{1}),
+      [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+          // The window just past the initial read-ahead slides forward one chunk per chunk begun.
+          file.adviseWillNeed((i + prefetch) * chunkBytes, chunkBytes);
+          size_t start = detail::nextRecordStart(data, size, i * chunkBytes, delimiter);
+          size_t stop = detail::nextRecordStart(data, size, (i + 1) * chunkBytes, delimiter);
+          if (start < stop) {
+            f(FileChunk{data + start, stop - start, start});
+          }
+        }
+      });
+}
+
+/**
+ * Map a file and process it in parallel on the global thread pool, in chunks of whole records.  See
+ * the MappedFile overload for details.
+ *
+ * @param path The path of the file to process.
+ * @param delimiter The byte that ends each record, e.g. <code>'\n'</code>.
+ * @param f A functor with signature <code>void(const FileChunk&)</code>.  The chunk's bytes are
+ * only valid during the call.
+ * @param options See FileChunkOptions for details.
+ * @return false if the file could not be mapped, in which case <code>f</code> is never called.
+ **/
+template <typename F>
+bool parallel_for_file_chunks(
+    const std::string& path,
+    char delimiter,
+    F&& f,
+    FileChunkOptions options = {}) {
+  MappedFile file(path);
+  if (!file.valid()) {
+    return false;
+  }
+  TaskSet taskSet(globalThreadPool());
+  parallel_for_file_chunks(taskSet, file, delimiter, std::forward<F>(f), options);
+  return true;
+}
+
+} // namespace dispenso
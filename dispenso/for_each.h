@@ -16,8 +16,11 @@
 
 #include <algorithm>
 
+#include <iterator>
+#include <type_traits>
+
 #include <dispenso/detail/per_thread_info.h>
-#include <dispenso/task_set.h>
+#include <dispenso/parallel_for.h>
 
 namespace dispenso {
 
@@ -40,8 +43,77 @@ struct ForEachOptions {
    * TaskSet.
    **/
   bool wait = true;
+
+  /**
+   * How to chunk the range when the iterators are random access.  kStatic hands one contiguous
+   * block to each thread, as for non-random-access iterators.  The other modes hand out chunks
+   * dynamically as for the equivalent ParForChunking mode, which helps load balance when the cost
+   * per element varies.  Ignored (treated as kStatic) for non-random-access iterators.
+   **/
+  ParForChunking chunking = ParForChunking::kStatic;
+
+  /**
+   * The fewest elements worth running as one chunk.  See
+   * <code>ParForOptions::minItemsPerChunk</code>.
+   **/
+  uint32_t minItemsPerChunk = 1;
+
+  /**
+   * An optional estimate of the cost of calling the function on one element, in nanoseconds.  See
+   * <code>ParForOptions::costPerItemNs</code>.
+   **/
+  double costPerItemNs = 0.0;
 };
 
+namespace detail {
+
+template <typename Iter>
+using IsRandomAccess = std::is_base_of<
+    std::random_access_iterator_tag,
+    typename std::iterator_traits<Iter>::iterator_category>;
+
+inline ParForOptions toParForOptions(const ForEachOptions& options) {
+  ParForOptions parOptions;
+  parOptions.maxThreads = options.maxThreads;
+  parOptions.wait = options.wait;
+  parOptions.defaultChunking = options.chunking;
+  parOptions.minItemsPerChunk = options.minItemsPerChunk;
+  parOptions.costPerItemNs = options.costPerItemNs;
+  return parOptions;
+}
+
+template <typename TaskSetT, typename Iter, typename F>
+void for_each_n_dynamic(
+    TaskSetT& tasks,
+    Iter start,
+    size_t n,
+    F&& f,
+    const ForEachOptions& options,
+    std::true_type /*isRandomAccess*/) {
+  parallel_for(
+      tasks,
+      makeChunkedRange(size_t{0}, n, options.chunking),
+      [start, f = std::forward<F>(f)](size_t b, size_t e) {
+        for (Iter it = start + static_cast<ssize_t>(b), end = start + static_cast<ssize_t>(e);
+             it != end;
+             ++it) {
+          f(*it);
+        }
+      },
+      toParForOptions(options));
+}
+
+template <typename TaskSetT, typename Iter, typename F>
+void for_each_n_dynamic(
+    TaskSetT&,
+    Iter,
+    size_t,
+    F&&,
+    const ForEachOptions&,
+    std::false_type /*isRandomAccess*/) {}
+
+} // namespace detail
+
 /**
  * A function like std::for_each_n, but where the function is invoked in parallel across the passed
  * range.
@@ -55,6 +127,14 @@ struct ForEachOptions {
  **/
 template <typename TaskSetT, typename Iter, typename F>
 void for_each_n(TaskSetT& tasks, Iter start, size_t n, F&& f, ForEachOptions options = {}) {
+  if (options.chunking != ParForChunking::kStatic && detail::IsRandomAccess<Iter>::value) {
+    detail::for_each_n_dynamic(
+        tasks, start, n, std::forward<F>(f), options, detail::IsRandomAccess<Iter>());
+    return;
+  }
+  ParForOptions grain = detail::toParForOptions(options);
+  detail::capThreadsForGrain(static_cast<int64_t>(n), grain);
+  options.maxThreads = grain.maxThreads;
   // TODO(bbudge): With options.maxThreads, we might want to allow a small fanout factor in
   // recursive case?
   if (!n || !options.maxThreads || detail::PerPoolPerThreadInfo::isParForRecursive(&tasks.pool())) {
@@ -80,36 +160,25 @@ void for_each_n(TaskSetT& tasks, Iter start, size_t n, F&& f, ForEachOptions opt
   // (!perfectlyChunked) ? chunking.transitionTaskIndex : numThreads - 1;
   ssize_t firstLoopLen = chunking.transitionTaskIndex - perfectlyChunked;
 
-  ssize_t t;
-  for (t = 0; t < firstLoopLen; ++t) {
-    Iter next = start;
-    std::advance(next, chunkSize);
-    tasks.schedule([start, next, f]() {
-      auto recurseInfo = detail::PerPoolPerThreadInfo::parForRecurse();
-      for (Iter it = start; it != next; ++it) {
-        f(*it);
-      }
-    });
-    start = next;
-  }
-
-  // Reduce the remaining chunk sizes by 1.
-  chunkSize -= !perfectlyChunked;
-  // Finish submitting all but the last item.
-  for (; t < numThreads - 1; ++t) {
-    Iter next = start;
-    std::advance(next, chunkSize);
-    tasks.schedule([start, next, f]() {
-      auto recurseInfo = detail::PerPoolPerThreadInfo::parForRecurse();
-      for (Iter it = start; it != next; ++it) {
-        f(*it);
-      }
+  // Chunks before firstLoopLen are one larger than the rest.  Submit all but the last item.
+  size_t smallChunkSize = chunkSize - !perfectlyChunked;
+  if (numThreads > 1) {
+    tasks.scheduleBulk(static_cast<size_t>(numThreads - 1), [&](size_t t) {
+      Iter next = start;
+      std::advance(next, static_cast<ssize_t>(t) < firstLoopLen ? chunkSize : smallChunkSize);
+      auto chunkTask = [start, next, f]() {
+        auto recurseInfo = detail::PerPoolPerThreadInfo::parForRecurse();
+        for (Iter it = start; it != next; ++it) {
+          f(*it);
+        }
+      };
+      start = next;
+      return chunkTask;
     });
-    start = next;
   }
 
   Iter end = start;
-  std::advance(end, chunkSize);
+  std::advance(end, smallChunkSize);
 
   if (options.wait) {
     for (Iter it = start; it != end; ++it) {
@@ -178,6 +247,82 @@ void for_each(Iter start, Iter end, F&& f, ForEachOptions options = {}) {
   for_each_n(start, std::distance(start, end), std::forward<F>(f), options);
 }
 
+/**
+ * Like for_each_n, but where the function is invoked on subranges of the passed range rather than
+ * on individual elements.  Handing the function a whole chunk avoids per-element dispatch and lets
+ * the compiler vectorize the body.
+ *
+ * @param tasks The task set to schedule the for_each on.
+ * @param start The iterator for the start of the range.  Must be random access.
+ * @param n The length of the range.
+ * @param f The function to execute in parallel.  Must have a signature like
+ * <code>void(Iter begin, Iter end)</code>.
+ * @param options See ForEachOptions for details.
+ **/
+template <typename TaskSetT, typename Iter, typename F>
+void for_each_n_chunked(TaskSetT& tasks, Iter start, size_t n, F&& f, ForEachOptions options = {}) {
+  static_assert(
+      detail::IsRandomAccess<Iter>::value, "for_each_n_chunked requires random access iterators");
+  parallel_for(
+      tasks,
+      makeChunkedRange(size_t{0}, n, options.chunking),
+      [start, f = std::forward<F>(f)](size_t b, size_t e) {
+        f(start + static_cast<ssize_t>(b), start + static_cast<ssize_t>(e));
+      },
+      detail::toParForOptions(options));
+}
+
+/**
+ * Like for_each_n, but where the function is invoked on subranges of the passed range rather than
+ * on individual elements.
+ *
+ * @param start The iterator for the start of the range.  Must be random access.
+ * @param n The length of the range.
+ * @param f The function to execute in parallel.  Must have a signature like
+ * <code>void(Iter begin, Iter end)</code>.
+ * @param options See ForEachOptions for details; however it should be noted that this function must
+ * always wait, and therefore options.wait is ignored.
+ **/
+template <typename Iter, typename F>
+void for_each_n_chunked(Iter start, size_t n, F&& f, ForEachOptions options = {}) {
+  TaskSet taskSet(globalThreadPool());
+  options.wait = true;
+  for_each_n_chunked(taskSet, start, n, std::forward<F>(f), options);
+}
+
+/**
+ * Like for_each, but where the function is invoked on subranges of the passed range rather than on
+ * individual elements.
+ *
+ * @param tasks The task set to schedule the for_each on.
+ * @param start The iterator for the start of the range.  Must be random access.
+ * @param end The iterator for the end of the range.
+ * @param f The function to execute in parallel.  Must have a signature like
+ * <code>void(Iter begin, Iter end)</code>.
+ * @param options See ForEachOptions for details.
+ **/
+template <typename TaskSetT, typename Iter, typename F>
+void for_each_chunked(TaskSetT& tasks, Iter start, Iter end, F&& f, ForEachOptions options = {}) {
+  for_each_n_chunked(
+      tasks, start, static_cast<size_t>(end - start), std::forward<F>(f), options);
+}
+
+/**
+ * Like for_each, but where the function is invoked on subranges of the passed range rather than on
+ * individual elements.
+ *
+ * @param start The iterator for the start of the range.  Must be random access.
+ * @param end The iterator for the end of the range.
+ * @param f The function to execute in parallel.  Must have a signature like
+ * <code>void(Iter begin, Iter end)</code>.
+ * @param options See ForEachOptions for details; however it should be noted that this function must
+ * always wait, and therefore options.wait is ignored.
+ **/
+template <typename Iter, typename F>
+void for_each_chunked(Iter start, Iter end, F&& f, ForEachOptions options = {}) {
+  for_each_n_chunked(start, static_cast<size_t>(end - start), std::forward<F>(f), options);
+}
+
 // TODO(bbudge): Implement ranges versions for these in C++20 (currently not in an env where this
 // can be tested)
 
@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file fork_join.h
+ * A file providing forkJoin and parallel_invoke, for fine-grained recursive (e.g. divide and
+ * conquer) parallelism.
+ **/
+
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <tuple>
+#include <utility>
+
+#include <dispenso/thread_pool.h>
+
+namespace dispenso {
+namespace detail {
+
+// The join state for a single fork.  It lives on the forking thread's stack, so recursive forks
+// never contend on a shared counter the way tasks in a common TaskSet do.
+struct ForkJoinFrame {
+  std::atomic<bool> done{false};
+#if defined(__cpp_exceptions)
+  std::exception_ptr exception;
+#endif // __cpp_exceptions
+};
+
+// The join state for one parallel_invoke: a count of the scheduled functors still running, and the
+// first exception any of them threw.  Like ForkJoinFrame, it lives on the invoking thread's stack.
+struct InvokeFrame {
+  explicit InvokeFrame(size_t count) : pending(count) {}
+
+  std::atomic<size_t> pending;
+#if defined(__cpp_exceptions)
+  std::atomic<bool> failed{false};
+  std::exception_ptr exception;
+#endif // __cpp_exceptions
+};
+
+struct ForkJoinAccess {
+  static void join(ThreadPool& pool, ForkJoinFrame& frame) {
+    // On a pool thread, the forked task is most likely still on top of our local queue, so the
+    // first attempt usually just runs it here.
+    while (!frame.done.load(std::memory_order_acquire)) {
+      if (!pool.tryExecuteNext()) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  static void join(ThreadPool& pool, InvokeFrame& frame) {
+    while (frame.pending.load(std::memory_order_acquire)) {
+      if (!pool.tryExecuteNext()) {
+        std::this_thread::yield();
+      }
+    }
+  }
+};
+
+template <typename F>
+void scheduleInvoke(ThreadPool& pool, InvokeFrame& frame, F& f) {
+  pool.schedule([&frame, &f]() {
+#if defined(__cpp_exceptions)
+    try {
+      f();
+    } catch (...) {
+      if (!frame.failed.exchange(true, std::memory_order_relaxed)) {
+        frame.exception = std::current_exception();
+      }
+    }
+#else
+    f();
+#endif // __cpp_exceptions
+    frame.pending.fetch_sub(1, std::memory_order_release);
+  });
+}
+
+// Schedules the functors in fs at indices I, and runs the one at index sizeof...(I) inline.
+template <typename Tuple, size_t... I>
+void parallelInvokeImpl(ThreadPool& pool, Tuple&& fs, std::index_sequence<I...>) {
+  InvokeFrame frame(sizeof...(I));
+  // Braced initialization guarantees left to right evaluation.
+  int expand[] = {(scheduleInvoke(pool, frame, std::get<I>(fs)), 0)...};
+  (void)expand;
+  auto& last = std::get<sizeof...(I)>(fs);
+
+#if defined(__cpp_exceptions)
+  try {
+    last();
+  } catch (...) {
+    // The scheduled functors reference the frame, so they must finish before we unwind.
+    ForkJoinAccess::join(pool, frame);
+    throw;
+  }
+  ForkJoinAccess::join(pool, frame);
+  if (frame.exception) {
+    std::rethrow_exception(frame.exception);
+  }
+#else
+  last();
+  ForkJoinAccess::join(pool, frame);
+#endif // __cpp_exceptions
+}
+
+} // namespace detail
+
+/**
+ * Run two functors, potentially in parallel, and return once both have completed.
+ * <code>f2</code> is offered to the pool, and <code>f1</code> is run on the calling thread.  If no
+ * other thread has picked up <code>f2</code> by then, the calling thread runs it too.
+ *
+ * Unlike scheduling into a <code>TaskSet</code>, no counter is shared between forks, making this
+ * suitable for deeply recursive algorithms with very small tasks, where each level forks again
+ * (e.g. <code>forkJoin(pool, [&]() { a = fib(n - 1); }, [&]() { b = fib(n - 2); })</code>).
+ *
+ * @param pool The pool to offer <code>f2</code> to.
+ * @param f1 A functor with signature <code>void()</code>, run on the calling thread.
+ * @param f2 A functor with signature <code>void()</code>, possibly run on another thread.
+ *
+ * @note If either functor throws, the exception is rethrown once both have finished.  If both
+ * throw, the exception from <code>f1</code> is propagated.
+ **/
+template <typename F1, typename F2>
+void forkJoin(ThreadPool& pool, F1&& f1, F2&& f2) {
+  detail::ForkJoinFrame frame;
+  pool.schedule([&frame, &f2]() {
+#if defined(__cpp_exceptions)
+    try {
+      f2();
+    } catch (...) {
+      frame.exception = std::current_exception();
+    }
+#else
+    f2();
+#endif // __cpp_exceptions
+    frame.done.store(true, std::memory_order_release);
+  });
+
+#if defined(__cpp_exceptions)
+  try {
+    f1();
+  } catch (...) {
+    // f2 may still reference the frame, so it must finish before we unwind.
+    detail::ForkJoinAccess::join(pool, frame);
+    throw;
+  }
+  detail::ForkJoinAccess::join(pool, frame);
+  if (frame.exception) {
+    std::rethrow_exception(frame.exception);
+  }
+#else
+  f1();
+  detail::ForkJoinAccess::join(pool, frame);
+#endif // __cpp_exceptions
+}
+
+/**
+ * Run any number of functors, potentially in parallel, and return once all have completed.  This
+ * forks recursively, so the first functor runs on the calling thread.
+ *
+ * @param pool The pool to offer the functors to.
+ * @param f1 A functor with signature <code>void()</code>.
+ * @param f2 A functor with signature <code>void()</code>.
+ * @param fs More functors with signature <code>void()</code>.
+ **/
+template <typename F1, typename F2, typename F3, typename... Fs>
+void forkJoin(ThreadPool& pool, F1&& f1, F2&& f2, F3&& f3, Fs&&... fs) {
+  forkJoin(pool, std::forward<F1>(f1), [&]() {
+    forkJoin(pool, std::forward<F2>(f2), std::forward<F3>(f3), std::forward<Fs>(fs)...);
+  });
+}
+
+/**
+ * Run functors on the global thread pool, potentially in parallel, and return once all have
+ * completed.  See the overloads taking a <code>ThreadPool</code>.
+ *
+ * @param f1 A functor with signature <code>void()</code>.
+ * @param f2 A functor with signature <code>void()</code>.
+ * @param fs More functors with signature <code>void()</code>.
+ **/
+template <typename F1, typename F2, typename... Fs>
+void forkJoin(F1&& f1, F2&& f2, Fs&&... fs) {
+  forkJoin(
+      globalThreadPool(), std::forward<F1>(f1), std::forward<F2>(f2), std::forward<Fs>(fs)...);
+}
+
+/**
+ * Run any number of functors, potentially in parallel, and return once all have completed.  All
+ * but the last functor are offered to the pool, and the last is run on the calling thread, which
+ * then helps run pool work until the others are done.
+ *
+ * Unlike the variadic <code>forkJoin</code>, which forks once per functor, all of the functors
+ * share a single join counter on the calling thread's stack, and unlike scheduling into a
+ * <code>TaskSet</code>, nothing is shared with other calls.  This suits splitting work several
+ * ways at each level of a recursion, e.g.
+ * <code>parallel_invoke(pool, [&]() { sort(a); }, [&]() { sort(b); }, [&]() { sort(c); })</code>.
+ *
+ * @param pool The pool to offer the functors to.
+ * @param f1 A functor with signature <code>void()</code>.
+ * @param f2 A functor with signature <code>void()</code>.
+ * @param fs More functors with signature <code>void()</code>.  The last functor passed runs on the
+ * calling thread.
+ *
+ * @note If any functor throws, the exception is rethrown once all have finished.  An exception from
+ * the last functor takes precedence; otherwise the first exception thrown is propagated.
+ **/
+template <typename F1, typename F2, typename... Fs>
+void parallel_invoke(ThreadPool& pool, F1&& f1, F2&& f2, Fs&&... fs) {
+  detail::parallelInvokeImpl(
+      pool,
+      std::forward_as_tuple(f1, f2, fs...),
+      std::make_index_sequence<sizeof...(Fs) + 1>());
+}
+
+/**
+ * Run functors on the global thread pool, potentially in parallel, and return once all have
+ * completed.  See the overload taking a <code>ThreadPool</code>.
+ *
+ * @param f1 A functor with signature <code>void()</code>.
+ * @param f2 A functor with signature <code>void()</code>.
+ * @param fs More functors with signature <code>void()</code>.
+ **/
+template <typename F1, typename F2, typename... Fs>
+void parallel_invoke(F1&& f1, F2&& f2, Fs&&... fs) {
+  parallel_invoke(
+      globalThreadPool(), std::forward<F1>(f1), std::forward<F2>(f2), std::forward<Fs>(fs)...);
+}
+
+} // namespace dispenso
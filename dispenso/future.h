@@ -16,6 +16,10 @@
 #pragma once
 
 #include <functional>
+#include <limits>
+#include <memory>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 #include <dispenso/detail/future_impl.h>
@@ -25,7 +29,7 @@ namespace dispenso {
 
 // See https://en.cppreference.com/w/cpp/experimental/future for details on the API.
 
-// TODO(bbudge): Implement when_any(), ?unwrapping constructor? functionality.
+// TODO(bbudge): Implement ?unwrapping constructor? functionality.
 
 /**
  *  A <code>std::launch</code> policy specifying we won't force asynchronicity.  Opposite of
@@ -284,7 +288,7 @@ class Future : detail::FutureBase<Result> {
    **/
   const Result& get() const {
     wait();
-    return this->impl_->result();
+    return this->result();
   }
 
   /**
@@ -321,7 +325,7 @@ class Future : detail::FutureBase<Result> {
  private:
   template <typename T>
   Future(T&& t, detail::ReadyTag) {
-    this->impl_ = detail::createValueFutureImplReady<Result>(std::forward<T>(t));
+    this->setReadyResult(std::forward<T>(t));
   }
 
   template <typename T>
@@ -374,7 +378,7 @@ class Future<Result&> : detail::FutureBase<Result&> {
    **/
   Result& get() const {
     wait();
-    return this->impl_->result();
+    return this->result();
   }
 
   template <typename F, typename Schedulable>
@@ -447,7 +451,7 @@ class Future<void> : detail::FutureBase<void> {
    **/
   void get() const {
     wait();
-    this->impl_->result();
+    this->result();
   }
 
   template <typename F, typename Schedulable>
@@ -468,7 +472,7 @@ class Future<void> : detail::FutureBase<void> {
 
  private:
   Future(detail::ReadyTag) {
-    impl_ = detail::createVoidFutureImplReady();
+    setInlineResult();
   }
 
   friend Future<void> make_ready_future();
@@ -635,7 +639,9 @@ inline Future<detail::ResultOf<F, Args...>> async(NewThreadInvoker sched, F&& f,
 
 /**
  * Make a <code>Future</code> in a ready state with the value passed into
- * <code>make_ready_future</code>
+ * <code>make_ready_future</code>.  Trivially copyable values of up to two pointers in size are kept
+ * inside the returned Future, so that no shared state is allocated, and copies of the Future copy
+ * the value.
  *
  * @param t the value to use to create the returned future.
  **/
@@ -656,7 +662,7 @@ inline Future<X&> make_ready_future(std::reference_wrapper<X> x) {
 }
 
 /**
- * Make a <code>Future<void></code> in a ready state.
+ * Make a <code>Future<void></code> in a ready state.  No shared state is allocated.
  *
  **/
 inline Future<void> make_ready_future() {
@@ -731,6 +737,81 @@ auto when_all(TaskSet& taskSet, Futures&&... futures)
 template <class... Futures>
 auto when_all(ConcurrentTaskSet& taskSet, Futures&&... futures)
     -> Future<std::tuple<std::decay_t<Futures>...>>;
+
+/**
+ * The result of <code>when_any</code>: the input futures, and the index of the first one found to
+ * be ready.
+ **/
+template <typename Sequence>
+struct WhenAnyResult {
+  /** The index of the first ready future, or <code>size_t(-1)</code> if there were no futures. **/
+  size_t index;
+  /** Copies of the input futures.  Others than <code>futures[index]</code> may not be ready. **/
+  Sequence futures;
+};
+
+/**
+ * Take a collection of futures, and return a future which will be ready when any input future is
+ * ready.  No thread blocks waiting; each input future gets a continuation, and the first to run
+ * readies the result.  This is useful e.g. for hedged requests, where the first response wins.
+ *
+ * @param first An iterator to the start of the future collection.
+ * @param last An iterator to the end of the future collection.
+ *
+ * @return A Future containing a WhenAnyResult holding a vector of copies of the input Futures.  If
+ * the collection is empty, the returned Future is immediately ready, with no index.
+ **/
+template <class InputIt>
+Future<WhenAnyResult<std::vector<typename std::iterator_traits<InputIt>::value_type>>> when_any(
+    InputIt first,
+    InputIt last);
+
+/**
+ * Take a specific set of futures, and return a future which will be ready when any input future is
+ * ready.
+ *
+ * @param futures A parameter pack of futures.
+ *
+ * @return A Future containing a WhenAnyResult holding a tuple of copies of the input Futures.
+ **/
+template <class... Futures>
+auto when_any(Futures&&... futures) -> Future<WhenAnyResult<std::tuple<std::decay_t<Futures>...>>>;
+
+/**
+ * Take a collection of futures, and return a future which will be ready when any input future is
+ * ready.
+ *
+ * @param tastSet A task set to register with such that after this call,
+ * <code>taskSet::wait()</code> implies that the resultant future <code>is_ready()</code>
+ * @param first An iterator to the start of the future collection.
+ * @param last An iterator to the end of the future collection.
+ *
+ * @return A Future containing a WhenAnyResult holding a vector of copies of the input Futures.
+ **/
+template <class InputIt>
+Future<WhenAnyResult<std::vector<typename std::iterator_traits<InputIt>::value_type>>>
+when_any(TaskSet& taskSet, InputIt first, InputIt last);
+template <class InputIt>
+Future<WhenAnyResult<std::vector<typename std::iterator_traits<InputIt>::value_type>>>
+when_any(ConcurrentTaskSet& taskSet, InputIt first, InputIt last);
+
+/**
+ * Take a specific set of futures, and return a future which will be ready when any input future is
+ * ready.
+ *
+ * @param tastSet A task set to register with such that after this call,
+ * <code>taskSet::wait()</code> implies that the resultant future <code>is_ready()</code>
+ * @param futures A parameter pack of futures.
+ *
+ * @return A Future containing a WhenAnyResult holding a tuple of copies of the input Futures.
+ **/
+template <class... Futures>
+auto when_any(TaskSet& taskSet, Futures&&... futures)
+    -> Future<WhenAnyResult<std::tuple<std::decay_t<Futures>...>>>;
+
+template <class... Futures>
+auto when_any(ConcurrentTaskSet& taskSet, Futures&&... futures)
+    -> Future<WhenAnyResult<std::tuple<std::decay_t<Futures>...>>>;
 } // namespace dispenso
 
 #include <dispenso/detail/future_impl2.h>
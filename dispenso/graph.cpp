@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "graph.h"
+
+namespace dispenso {
+
+constexpr size_t Graph::kInvalidNode;
+
+void Graph::compile() {
+  const size_t numNodes = functions_.size();
+
+  successorStarts_.assign(numNodes + 1, 0);
+  numPredecessors_.assign(numNodes, 0);
+  for (auto& edge : edges_) {
+    ++successorStarts_[edge.first + 1];
+    ++numPredecessors_[edge.second];
+  }
+  for (size_t i = 0; i < numNodes; ++i) {
+    successorStarts_[i + 1] += successorStarts_[i];
+  }
+  successors_.resize(edges_.size());
+  std::vector<size_t> fill(successorStarts_.begin(), successorStarts_.end() - 1);
+  for (auto& edge : edges_) {
+    successors_[fill[edge.first]++] = edge.second;
+  }
+
+  roots_.clear();
+  for (size_t i = 0; i < numNodes; ++i) {
+    if (!numPredecessors_[i]) {
+      roots_.push_back(i);
+    }
+  }
+
+#if !defined(NDEBUG)
+  // Kahn's algorithm visits every node only if the graph is acyclic.
+  std::vector<uint32_t> remaining(numPredecessors_);
+  std::vector<size_t> ready(roots_);
+  size_t visited = 0;
+  while (!ready.empty()) {
+    size_t node = ready.back();
+    ready.pop_back();
+    ++visited;
+    for (size_t s = successorStarts_[node]; s < successorStarts_[node + 1]; ++s) {
+      if (!--remaining[successors_[s]]) {
+        ready.push_back(successors_[s]);
+      }
+    }
+  }
+  assert(visited == numNodes && "Graph contains a cycle");
+#endif // NDEBUG
+
+  pending_.reset(new std::atomic<uint32_t>[numNodes]);
+  inSubgraph_.assign(numNodes, 0);
+  compiled_ = true;
+}
+
+void Graph::clearDirty() {
+  for (size_t node : dirtyNodes_) {
+    dirty_[node] = 0;
+  }
+  dirtyNodes_.clear();
+}
+
+void Graph::runFrom(ConcurrentTaskSet& tasks, size_t node) {
+  while (node != kInvalidNode) {
+    functions_[node]();
+
+    size_t next = kInvalidNode;
+    for (size_t s = successorStarts_[node]; s < successorStarts_[node + 1]; ++s) {
+      size_t succ = successors_[s];
+      if (pending_[succ].fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        continue;
+      }
+      if (next == kInvalidNode) {
+        next = succ;
+      } else {
+        tasks.schedule([this, &tasks, succ]() { runFrom(tasks, succ); }, ForceQueuingTag());
+      }
+    }
+    node = next;
+  }
+}
+
+void Graph::run(ThreadPool& pool, const std::vector<size_t>& roots) {
+  // Scheduling publishes the counter resets to the pool threads.
+  ConcurrentTaskSet tasks(pool);
+  for (size_t root : roots) {
+    tasks.schedule([this, &tasks, root]() { runFrom(tasks, root); }, ForceQueuingTag());
+  }
+  tasks.wait();
+}
+
+void Graph::execute(ThreadPool& pool) {
+  if (!compiled_) {
+    compile();
+  }
+  clearDirty();
+
+  const size_t numNodes = functions_.size();
+  for (size_t i = 0; i < numNodes; ++i) {
+    pending_[i].store(numPredecessors_[i], std::memory_order_relaxed);
+  }
+  run(pool, roots_);
+}
+
+void Graph::executeDirty(ThreadPool& pool) {
+  if (!compiled_) {
+    compile();
+  }
+
+  // Gather the dirty nodes and everything downstream of them.  All successors of a node in the
+  // subgraph are in the subgraph, so runFrom needs no changes; only the counters differ, counting
+  // just the predecessors within the subgraph.
+  subgraph_.clear();
+  for (size_t node : dirtyNodes_) {
+    if (!inSubgraph_[node]) {
+      inSubgraph_[node] = 1;
+      subgraph_.push_back(node);
+    }
+  }
+  clearDirty();
+  for (size_t i = 0; i < subgraph_.size(); ++i) {
+    size_t node = subgraph_[i];
+    for (size_t s = successorStarts_[node]; s < successorStarts_[node + 1]; ++s) {
+      size_t succ = successors_[s];
+      if (!inSubgraph_[succ]) {
+        inSubgraph_[succ] = 1;
+        subgraph_.push_back(succ);
+      }
+    }
+  }
+
+  for (size_t node : subgraph_) {
+    pending_[node].store(0, std::memory_order_relaxed);
+  }
+  for (size_t node : subgraph_) {
+    for (size_t s = successorStarts_[node]; s < successorStarts_[node + 1]; ++s) {
+      auto& pending = pending_[successors_[s]];
+      pending.store(pending.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+  }
+  subgraphRoots_.clear();
+  for (size_t node : subgraph_) {
+    inSubgraph_[node] = 0;
+    if (!pending_[node].load(std::memory_order_relaxed)) {
+      subgraphRoots_.push_back(node);
+    }
+  }
+
+  run(pool, subgraphRoots_);
+}
+
+} // namespace dispenso
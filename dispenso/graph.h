@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file graph.h
+ * A file providing Graph, a static dependency graph of tasks that may be executed repeatedly.
+ **/
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <dispenso/task_set.h>
+
+namespace dispenso {
+
+/**
+ * A directed acyclic graph of tasks.  Nodes and edges are declared once, and the graph may then be
+ * executed any number of times.  Each execution runs every node exactly once, and a node only runs
+ * after all of its predecessors have finished.
+ *
+ * Structure is compiled into flat successor lists on the first execution after a change, so
+ * repeated execution of an unchanged graph does not allocate.  Per execution, the predecessor
+ * counters are reset in bulk, and each edge costs a single atomic decrement.  When a node finishes,
+ * the first of its successors that becomes ready is run directly on the same thread, and only the
+ * others are scheduled.
+ *
+ * Nodes may also be marked dirty, and <code>executeDirty</code> then runs only the dirty nodes and
+ * everything downstream of them, skipping the rest of the graph, whose results from earlier
+ * executions stay valid.  The cost of such an execution is proportional to the size of that
+ * subgraph rather than to the size of the whole graph.
+ *
+ * Graph is not thread-safe: it must not be modified (including marking nodes dirty) while
+ * executing, and only one execution may be in progress at a time.
+ **/
+class Graph {
+ public:
+  /**
+   * A value that is never a valid node index.
+   **/
+  static constexpr size_t kInvalidNode = std::numeric_limits<size_t>::max();
+
+  Graph() = default;
+  Graph(Graph&& other) = default;
+  Graph& operator=(Graph&& other) = default;
+
+  /**
+   * Add a node to the graph.
+   *
+   * @param f A function-like object with signature <code>void()</code>.  It is invoked once per
+   * execution of the graph, and is kept for the lifetime of the graph.
+   * @return The index of the new node, for use with <code>addEdge</code>.  Indices are assigned
+   * sequentially from zero.  The new node starts out dirty, since it has never run.
+   **/
+  template <typename F>
+  size_t addNode(F&& f) {
+    functions_.emplace_back(std::forward<F>(f));
+    dirty_.push_back(0);
+    compiled_ = false;
+    size_t node = functions_.size() - 1;
+    markDirty(node);
+    return node;
+  }
+
+  /**
+   * Add a dependency between two nodes.  Edges must not form a cycle.  Since its inputs change,
+   * <code>to</code> is marked dirty.
+   *
+   * @param from The index of the node that must finish first.
+   * @param to The index of the node that depends on <code>from</code>.
+   **/
+  void addEdge(size_t from, size_t to) {
+    assert(from < functions_.size() && to < functions_.size());
+    edges_.emplace_back(from, to);
+    compiled_ = false;
+    markDirty(to);
+  }
+
+  /**
+   * Mark a node dirty, so that the next call to <code>executeDirty</code> runs it and all of its
+   * transitive successors.
+   *
+   * @param node The index of the node.
+   **/
+  void markDirty(size_t node) {
+    assert(node < functions_.size());
+    if (!dirty_[node]) {
+      dirty_[node] = 1;
+      dirtyNodes_.push_back(node);
+    }
+  }
+
+  /**
+   * Check whether a node is dirty.
+   *
+   * @param node The index of the node.
+   * @return true if the node has been marked dirty since the graph was last executed.
+   **/
+  bool isDirty(size_t node) const {
+    return dirty_[node];
+  }
+
+  /**
+   * Get the number of nodes in the graph.
+   *
+   * @return The number of nodes.
+   **/
+  size_t numNodes() const {
+    return functions_.size();
+  }
+
+  /**
+   * Get the number of edges in the graph.
+   *
+   * @return The number of edges.
+   **/
+  size_t numEdges() const {
+    return edges_.size();
+  }
+
+  /**
+   * Run every node of the graph in dependency order, and wait for them to finish.  The calling
+   * thread participates in the work.
+   *
+   * @param pool The ThreadPool to run the nodes on.
+   * @note If a node throws, its successors are not run, and the first exception is rethrown once
+   * the rest of the graph has finished.  All nodes are clean afterward either way.
+   **/
+  DISPENSO_DLL_ACCESS void execute(ThreadPool& pool);
+
+  /**
+   * Run every node of the graph on dispenso's global thread pool, and wait for them to finish.
+   **/
+  void execute() {
+    execute(globalThreadPool());
+  }
+
+  /**
+   * Run only the dirty nodes and their transitive successors, in dependency order, and wait for
+   * them to finish.  Edges from nodes outside this subgraph are treated as already satisfied.
+   * Afterward, all nodes are clean.
+   *
+   * @param pool The ThreadPool to run the nodes on.
+   **/
+  DISPENSO_DLL_ACCESS void executeDirty(ThreadPool& pool);
+
+  /**
+   * Run only the dirty nodes and their transitive successors on dispenso's global thread pool.
+   **/
+  void executeDirty() {
+    executeDirty(globalThreadPool());
+  }
+
+ private:
+  void compile();
+  void clearDirty();
+  void run(ThreadPool& pool, const std::vector<size_t>& roots);
+  void runFrom(ConcurrentTaskSet& tasks, size_t node);
+
+  std::vector<std::function<void()>> functions_;
+  std::vector<std::pair<size_t, size_t>> edges_;
+
+  // Compiled form: the successors of node i are successors_[successorStarts_[i]] up to
+  // successors_[successorStarts_[i + 1]].
+  std::vector<size_t> successorStarts_;
+  std::vector<size_t> successors_;
+  std::vector<uint32_t> numPredecessors_;
+  std::vector<size_t> roots_;
+  std::unique_ptr<std::atomic<uint32_t>[]> pending_;
+  bool compiled_ = false;
+
+  std::vector<char> dirty_;
+  std::vector<size_t> dirtyNodes_;
+  // Scratch for executeDirty, kept to avoid reallocating per execution.
+  std::vector<char> inSubgraph_;
+  std::vector<size_t> subgraph_;
+  std::vector<size_t> subgraphRoots_;
+};
+
+} // namespace dispenso
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/huge_pages.h>
+
+#include <cstdlib>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <fstream>
+#elif defined(_WIN32)
+#include <Windows.h>
+#endif // PLATFORM
+
+namespace dispenso {
+
+namespace {
+size_t roundUp(size_t bytes, size_t multiple) {
+  return (bytes + multiple - 1) / multiple * multiple;
+}
+} // namespace
+
+#if defined(__linux__)
+
+size_t hugePageSize() {
+  static const size_t size = []() {
+    size_t pmdSize = 0;
+    std::ifstream in("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size");
+    if (!(in >> pmdSize) || !pmdSize) {
+      pmdSize = size_t{2} << 20;
+    }
+    return pmdSize;
+  }();
+  return size;
+}
+
+void* hugePageAlloc(size_t bytes) {
+  const size_t huge = hugePageSize();
+  const bool useHuge = bytes >= huge;
+  const size_t alignment = useHuge ? huge : kHugePageMinAlignment;
+  bytes = roundUp(bytes ? bytes : 1, alignment);
+  void* ptr = nullptr;
+  if (::posix_memalign(&ptr, alignment, bytes)) {
+    return nullptr;
+  }
+  if (useHuge) {
+    // Only advice; the kernel may still use small pages, e.g. if THP is disabled.
+    (void)::madvise(ptr, bytes, MADV_HUGEPAGE);
+  }
+  return ptr;
+}
+
+void hugePageFree(void* ptr) {
+  ::free(ptr);
+}
+
+#elif defined(_WIN32)
+
+size_t hugePageSize() {
+  static const size_t size = GetLargePageMinimum();
+  return size;
+}
+
+void* hugePageAlloc(size_t bytes) {
+  const size_t huge = hugePageSize();
+  bytes = bytes ? bytes : 1;
+  if (huge && bytes >= huge) {
+    // Fails without SeLockMemoryPrivilege, or when physical memory is too fragmented.
+    if (void* ptr = VirtualAlloc(
+            nullptr,
+            roundUp(bytes, huge),
+            MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+            PAGE_READWRITE)) {
+      return ptr;
+    }
+  }
+  return VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+
+void hugePageFree(void* ptr) {
+  if (ptr) {
+    VirtualFree(ptr, 0, MEM_RELEASE);
+  }
+}
+
+#else
+
+size_t hugePageSize() {
+  return 0;
+}
+
+void* hugePageAlloc(size_t bytes) {
+  return detail::alignedMalloc(
+      roundUp(bytes ? bytes : 1, kHugePageMinAlignment), kHugePageMinAlignment);
+}
+
+void hugePageFree(void* ptr) {
+  detail::alignedFree(ptr);
+}
+
+#endif // PLATFORM
+
+} // namespace dispenso
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file huge_pages.h
+ * A file providing allocation functions for memory backed by huge pages where the platform
+ * supports them, to cut TLB misses for large, heavily used buffers.  The functions match the
+ * signatures PoolAllocator takes for its backing allocations.
+ **/
+
+#pragma once
+
+#include <cstddef>
+
+#include <dispenso/platform.h>
+
+namespace dispenso {
+
+/**
+ * The alignment of every pointer returned by <code>hugePageAlloc</code>.
+ **/
+constexpr size_t kHugePageMinAlignment = 4096;
+
+/**
+ * Get the size of the huge pages <code>hugePageAlloc</code> asks for, e.g. 2 MB on x86-64 Linux.
+ *
+ * @return The huge page size in bytes, or 0 if the platform's huge pages are not supported.
+ **/
+DISPENSO_DLL_ACCESS size_t hugePageSize();
+
+/**
+ * Allocate memory, preferring huge pages.  Requests of at least <code>hugePageSize()</code> bytes
+ * are rounded up to a whole number of huge pages and aligned to a huge page.  On Linux the range
+ * is advised as a transparent huge page candidate (<code>MADV_HUGEPAGE</code>); on Windows, large
+ * pages are used when the process holds the privilege to lock pages.  Smaller requests, and
+ * requests the platform cannot back with huge pages, get ordinary pages.
+ *
+ * @param bytes The number of bytes to allocate.
+ *
+ * @return A pointer aligned to at least <code>kHugePageMinAlignment</code>, to be freed with
+ * <code>hugePageFree</code>, or null if the allocation failed.
+ **/
+DISPENSO_DLL_ACCESS void* hugePageAlloc(size_t bytes);
+
+/**
+ * Free memory from <code>hugePageAlloc</code>.
+ *
+ * @param ptr The pointer to free.  May be null.
+ **/
+DISPENSO_DLL_ACCESS void hugePageFree(void* ptr);
+
+} // namespace dispenso
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file latch.h
+ * A file providing Latch, a single-use countdown that threads can wait on, similar to std::latch.
+ **/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+#include <dispenso/detail/completion_event_impl.h>
+#include <dispenso/platform.h>
+
+namespace dispenso {
+
+/**
+ * A countdown latch.  The latch is constructed with a count, threads count it down, and waiting
+ * threads are released once it reaches zero.  Waiters spin briefly before sleeping in the OS.  A
+ * Latch cannot be reset; see Barrier for a reusable alternative.
+ **/
+class Latch {
+ public:
+  /**
+   * Construct a Latch.
+   *
+   * @param expected The number of countdowns required to release waiters.  Must be non-negative.
+   **/
+  explicit Latch(ptrdiff_t expected) : count_(expected), event_(expected == 0 ? 1 : 0) {}
+
+  Latch(const Latch&) = delete;
+  Latch& operator=(const Latch&) = delete;
+
+  /**
+   * Decrement the count without waiting, releasing waiters if it reaches zero.
+   *
+   * @param n The amount to decrement by.  The count must not go below zero.
+   **/
+  void countDown(ptrdiff_t n = 1) {
+    if (count_.fetch_sub(n, std::memory_order_acq_rel) == n) {
+      event_.notify(1);
+    }
+  }
+
+  /**
+   * Check whether the count has reached zero.
+   *
+   * @return true if waiters have been released.
+   **/
+  bool tryWait() const {
+    return event_.intrusiveStatus().load(std::memory_order_acquire) == 1;
+  }
+
+  /**
+   * Wait for the count to reach zero.
+   **/
+  void wait() const {
+    detail::spinThenWait(event_, 1, kSpinsBeforeSleep);
+  }
+
+  /**
+   * Wait for the count to reach zero, or for the relative timeout to expire, whichever is first.
+   *
+   * @return true if the count reached zero, false if timed out.
+   **/
+  template <class Rep, class Period>
+  bool waitFor(const std::chrono::duration<Rep, Period>& relTime) const {
+    return event_.waitFor(1, relTime);
+  }
+
+  /**
+   * Decrement the count, and then wait for it to reach zero.
+   *
+   * @param n The amount to decrement by.  The count must not go below zero.
+   **/
+  void arriveAndWait(ptrdiff_t n = 1) {
+    countDown(n);
+    wait();
+  }
+
+ private:
+  static constexpr int kSpinsBeforeSleep = 1024;
+
+  std::atomic<ptrdiff_t> count_;
+  detail::CompletionEventImpl event_;
+};
+
+} // namespace dispenso
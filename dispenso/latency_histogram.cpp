@@ -0,0 +1,15 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/latency_histogram.h>
+
+namespace dispenso {
+
+constexpr uint32_t LatencyHistogram::kSubBucketBits;
+constexpr size_t LatencyHistogram::kNumBuckets;
+
+} // namespace dispenso
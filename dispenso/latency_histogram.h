@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file latency_histogram.h
+ * A file providing LatencyHistogram, a log-bucketed histogram of durations in the style of HDR
+ * histograms, suitable for tail latency percentiles.
+ **/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <dispenso/detail/math.h>
+#include <dispenso/platform.h>
+
+namespace dispenso {
+namespace detail {
+struct AtomicLatencyHistogram;
+} // namespace detail
+
+/**
+ * A histogram of durations in nanoseconds.  Each power of two range is split into eight linear
+ * sub-buckets, so every recorded value is known to within 12.5%, over the full range of
+ * <code>uint64_t</code>, in a fixed few kilobytes.  Histograms can be merged, e.g. to combine
+ * per-thread histograms.
+ **/
+class LatencyHistogram {
+ public:
+  /** The number of linear sub-buckets per power of two is 2 to this power. **/
+  static constexpr uint32_t kSubBucketBits = 3;
+  /** The number of buckets. **/
+  static constexpr size_t kNumBuckets = (64 - kSubBucketBits + 1) << kSubBucketBits;
+
+  /**
+   * Get the bucket a value falls in.
+   *
+   * @param ns The value.
+   * @return The bucket index, less than <code>kNumBuckets</code>.
+   **/
+  static size_t bucketIndex(uint64_t ns) {
+    constexpr uint64_t kSubBuckets = uint64_t{1} << kSubBucketBits;
+    if (ns < kSubBuckets) {
+      return static_cast<size_t>(ns);
+    }
+    const uint32_t shift = detail::log2(ns) - kSubBucketBits;
+    return static_cast<size_t>(((shift + 1) << kSubBucketBits) + ((ns >> shift) - kSubBuckets));
+  }
+
+  /**
+   * Get the smallest value that falls in a bucket.
+   *
+   * @param index The bucket index.
+   * @return The bucket's lower bound.
+   **/
+  static uint64_t bucketLowerBound(size_t index) {
+    constexpr size_t kSubBuckets = size_t{1} << kSubBucketBits;
+    if (index < kSubBuckets) {
+      return index;
+    }
+    const size_t shift = (index >> kSubBucketBits) - 1;
+    return static_cast<uint64_t>(kSubBuckets + (index & (kSubBuckets - 1))) << shift;
+  }
+
+  /**
+   * Get the largest value that falls in a bucket.
+   *
+   * @param index The bucket index.
+   * @return The bucket's upper bound.
+   **/
+  static uint64_t bucketUpperBound(size_t index) {
+    return index + 1 < kNumBuckets ? bucketLowerBound(index + 1) - 1 : UINT64_MAX;
+  }
+
+  /**
+   * Record a value.
+   *
+   * @param ns The value.
+   * @param count The number of times to record it.
+   **/
+  void record(uint64_t ns, uint64_t count = 1) {
+    if (buckets_.empty()) {
+      buckets_.resize(kNumBuckets);
+    }
+    buckets_[bucketIndex(ns)] += count;
+    count_ += count;
+    sum_ += ns * count;
+    max_ = std::max(max_, ns);
+  }
+
+  /**
+   * Add another histogram's values to this one.
+   *
+   * @param other The histogram to merge.
+   **/
+  void merge(const LatencyHistogram& other) {
+    if (other.buckets_.empty()) {
+      return;
+    }
+    if (buckets_.empty()) {
+      buckets_.resize(kNumBuckets);
+    }
+    for (size_t i = 0; i < kNumBuckets; ++i) {
+      buckets_[i] += other.buckets_[i];
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+    max_ = std::max(max_, other.max_);
+  }
+
+  /**
+   * Get the number of recorded values.
+   **/
+  uint64_t count() const {
+    return count_;
+  }
+
+  /**
+   * Get the largest recorded value, or 0 if there are none.
+   **/
+  uint64_t max() const {
+    return max_;
+  }
+
+  /**
+   * Get the mean of the recorded values, or 0 if there are none.
+   **/
+  double mean() const {
+    return count_ ? static_cast<double>(sum_) / static_cast<double>(count_) : 0.0;
+  }
+
+  /**
+   * Get a percentile of the recorded values.
+   *
+   * @param percent The percentile, in [0, 100], e.g. 99.9.
+   * @return An upper bound, within the bucket precision, of the value that <code>percent</code>
+   * percent of recorded values are at or below, or 0 if there are none.
+   **/
+  uint64_t percentile(double percent) const {
+    if (!count_) {
+      return 0;
+    }
+    const double clamped = std::min(100.0, std::max(0.0, percent));
+    const uint64_t rank = std::max<uint64_t>(
+        1, static_cast<uint64_t>(std::ceil(clamped / 100.0 * static_cast<double>(count_))));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kNumBuckets; ++i) {
+      seen += buckets_[i];
+      if (seen >= rank) {
+        return std::min(bucketUpperBound(i), max_);
+      }
+    }
+    return max_;
+  }
+
+  /**
+   * Get the per-bucket counts.
+   *
+   * @return The counts, indexed by bucket, or an empty vector if nothing was ever recorded.
+   **/
+  const std::vector<uint64_t>& buckets() const {
+    return buckets_;
+  }
+
+ private:
+  std::vector<uint64_t> buckets_;
+  uint64_t count_ = 0;
+  uint64_t sum_ = 0;
+  uint64_t max_ = 0;
+
+  friend struct detail::AtomicLatencyHistogram;
+};
+
+namespace detail {
+
+// A LatencyHistogram that may be recorded to concurrently.
+struct AtomicLatencyHistogram {
+  void record(uint64_t ns) {
+    buckets[LatencyHistogram::bucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t cur = max.load(std::memory_order_relaxed);
+    while (ns > cur && !max.compare_exchange_weak(cur, ns, std::memory_order_relaxed)) {
+    }
+  }
+
+  void addTo(AtomicLatencyHistogram& to) const {
+    for (size_t i = 0; i < LatencyHistogram::kNumBuckets; ++i) {
+      to.buckets[i].fetch_add(
+          buckets[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    to.sum.fetch_add(sum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    uint64_t m = max.load(std::memory_order_relaxed);
+    uint64_t cur = to.max.load(std::memory_order_relaxed);
+    while (m > cur && !to.max.compare_exchange_weak(cur, m, std::memory_order_relaxed)) {
+    }
+  }
+
+  // Concurrent records may be partially reflected.
+  void addTo(LatencyHistogram& to) const {
+    LatencyHistogram h;
+    h.buckets_.resize(LatencyHistogram::kNumBuckets);
+    for (size_t i = 0; i < LatencyHistogram::kNumBuckets; ++i) {
+      h.buckets_[i] = buckets[i].load(std::memory_order_relaxed);
+      h.count_ += h.buckets_[i];
+    }
+    if (!h.count_) {
+      return;
+    }
+    h.sum_ = sum.load(std::memory_order_relaxed);
+    h.max_ = max.load(std::memory_order_relaxed);
+    to.merge(h);
+  }
+
+  std::atomic<uint64_t> buckets[LatencyHistogram::kNumBuckets] = {};
+  std::atomic<uint64_t> sum{0};
+  std::atomic<uint64_t> max{0};
+};
+
+} // namespace detail
+} // namespace dispenso
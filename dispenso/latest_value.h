@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file latest_value.h
+ * A file providing LatestValue.  Like AsyncRequest, this passes updates of one object from a
+ * producer to a consumer, but for continuous streams of updates where the consumer only wants the
+ * freshest one, and neither side should ever wait on the other.
+ **/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#if __cplusplus >= 201703L
+#include <optional>
+#else
+#include <dispenso/detail/op_result.h>
+#endif // C++17
+
+#include <dispenso/platform.h>
+
+namespace dispenso {
+
+/**
+ * A triple-buffered value for a single producer and a single consumer.  The producer publishes new
+ * values without waiting, and the consumer picks up the most recently completed one without
+ * waiting; intermediate values the consumer never looked at are simply overwritten.  Handing a
+ * value over is a single atomic exchange of a buffer index, and values are never copied.
+ *
+ * Because buffers are reused, publishInPlace can update a value while keeping its allocations
+ * (e.g. the capacity of a vector) from the time the buffer was last used.
+ **/
+template <typename T>
+class LatestValue {
+ public:
+#if __cplusplus >= 201703L
+  using OpResult = std::optional<T>;
+#else
+  using OpResult = detail::OpResult<T>;
+#endif // C++17
+
+  LatestValue() = default;
+  LatestValue(const LatestValue&) = delete;
+  LatestValue& operator=(const LatestValue&) = delete;
+
+  /**
+   * The producer can call this to publish a new value.
+   *
+   * @param args The arguments to construct the new value from.
+   **/
+  template <typename... Args>
+  void publish(Args&&... args) {
+    buffers_[back_].emplace(std::forward<Args>(args)...);
+    swapBack();
+  }
+
+  /**
+   * The producer can call this to build a new value in a reused buffer, and then publish it.
+   *
+   * @param f A functor with signature void(T&).  It is passed whichever value previously occupied
+   * the buffer (an older published value, or a default constructed T the first time the buffer is
+   * used), and should overwrite it with the new value.
+   **/
+  template <typename F>
+  void publishInPlace(F&& f) {
+    OpResult& buffer = buffers_[back_];
+    if (!buffer) {
+      buffer.emplace();
+    }
+    f(buffer.value());
+    swapBack();
+  }
+
+  /**
+   * The consumer can check whether a value has been published since it last called getLatest.
+   *
+   * @return true if getLatest would return a new value.
+   **/
+  bool hasUpdate() const {
+    return middle_.load(std::memory_order_relaxed) & kFresh;
+  }
+
+  /**
+   * The consumer can get the most recently published value.
+   *
+   * @return A pointer to the latest value, or nullptr if nothing has been published yet.  If
+   * nothing was published since the previous call, the same value is returned again.  The pointer
+   * remains valid, and the value may be modified or moved from, until the next call to getLatest.
+   **/
+  T* getLatest() {
+    if (middle_.load(std::memory_order_relaxed) & kFresh) {
+      front_ =
+          static_cast<uint8_t>(middle_.exchange(front_, std::memory_order_acq_rel) & kIndexMask);
+    }
+    OpResult& buffer = buffers_[front_];
+    return buffer ? &buffer.value() : nullptr;
+  }
+
+ private:
+  static constexpr uint8_t kIndexMask = 0x3;
+  static constexpr uint8_t kFresh = 0x4;
+
+  void swapBack() {
+    back_ = static_cast<uint8_t>(
+        middle_.exchange(static_cast<uint8_t>(back_ | kFresh), std::memory_order_acq_rel) &
+        kIndexMask);
+  }
+
+  OpResult buffers_[3];
+  // The buffer index not owned by either side, plus kFresh if it holds an unconsumed value.
+  alignas(kCacheLineSize) std::atomic<uint8_t> middle_{1};
+  // Each index is only touched by its own side, so keep them on separate cache lines.
+  alignas(kCacheLineSize) uint8_t back_ = 2;
+  alignas(kCacheLineSize) uint8_t front_ = 0;
+};
+
+} // namespace dispenso
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file lock_free_stack.h
+ * A file providing LockFreeStack, an intrusive lock-free (Treiber) stack suitable for free lists.
+ **/
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include <dispenso/platform.h>
+
+namespace dispenso {
+
+/**
+ * An intrusive lock-free LIFO stack.  Nodes are linked through a member
+ * <code>std::atomic<Node*> next</code>, which the stack owns while a node is on it.  The head
+ * pointer is tagged with a counter that changes on every pop, so a thread that is preempted
+ * between reading the head and swinging it cannot be fooled by the same node being popped and
+ * pushed back in the meantime (the ABA problem).
+ *
+ * The stack never allocates or frees.  Nodes must stay valid memory for as long as any thread may
+ * pop from the stack, even after they have been popped, since a racing pop may still read their
+ * <code>next</code>.  This is naturally the case for free lists whose nodes are only ever recycled,
+ * e.g. nodes carved from slabs that live as long as the stack.
+ *
+ * @note Node addresses must fit in 48 bits on 64-bit platforms, which is true of user-space
+ * addresses on current x86-64 and AArch64 operating systems.
+ **/
+template <typename Node>
+class LockFreeStack {
+ public:
+  LockFreeStack() = default;
+  LockFreeStack(const LockFreeStack&) = delete;
+  LockFreeStack& operator=(const LockFreeStack&) = delete;
+
+  /**
+   * Push a node.  Concurrency safe.
+   *
+   * @param node The node to push.
+   **/
+  void push(Node* node) {
+    pushBatch(node, node);
+  }
+
+  /**
+   * Push a chain of nodes with a single atomic operation.  Concurrency safe.
+   *
+   * @param first The first node of the chain, which will be the new top of the stack.
+   * @param last The last node of the chain, reached from <code>first</code> through
+   * <code>next</code>.  May be the same as <code>first</code>.
+   **/
+  void pushBatch(Node* first, Node* last) {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    uint64_t newHead;
+    do {
+      last->next.store(pointer(head), std::memory_order_relaxed);
+      newHead = pack(first, tag(head));
+    } while (!head_.compare_exchange_weak(
+        head, newHead, std::memory_order_release, std::memory_order_relaxed));
+  }
+
+  /**
+   * Pop a node.  Concurrency safe.
+   *
+   * @return The former top of the stack, or nullptr if the stack was empty.
+   **/
+  Node* pop() {
+    size_t count;
+    return popBatch(1, count);
+  }
+
+  /**
+   * Pop up to <code>maxCount</code> nodes with a single atomic operation.  Concurrency safe.
+   *
+   * @param maxCount The maximum number of nodes to pop.  Must be at least 1.
+   * @param count Set to the number of nodes popped.
+   * @return The first of <code>count</code> nodes, linked through <code>next</code> and terminated
+   * by nullptr, or nullptr if the stack was empty.
+   **/
+  Node* popBatch(size_t maxCount, size_t& count) {
+    assert(maxCount > 0);
+    uint64_t head = head_.load(std::memory_order_acquire);
+    while (true) {
+      Node* first = pointer(head);
+      if (!first) {
+        count = 0;
+        return nullptr;
+      }
+      // The nodes may be popped and reused concurrently, in which case the values read here are
+      // stale, but the tag makes the exchange below fail.
+      Node* last = first;
+      size_t n = 1;
+      Node* rest = last->next.load(std::memory_order_relaxed);
+      while (n < maxCount && rest) {
+        last = rest;
+        ++n;
+        rest = last->next.load(std::memory_order_relaxed);
+      }
+      if (head_.compare_exchange_weak(
+              head,
+              pack(rest, tag(head) + 1),
+              std::memory_order_acquire,
+              std::memory_order_acquire)) {
+        last->next.store(nullptr, std::memory_order_relaxed);
+        count = n;
+        return first;
+      }
+    }
+  }
+
+  /**
+   * Pop every node with a single atomic operation.  Concurrency safe.
+   *
+   * @return The former top of the stack, with the remaining nodes linked through
+   * <code>next</code> and terminated by nullptr, or nullptr if the stack was empty.
+   **/
+  Node* popAll() {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    while (!head_.compare_exchange_weak(
+        head, pack(nullptr, tag(head) + 1), std::memory_order_acquire, std::memory_order_relaxed)) {
+    }
+    return pointer(head);
+  }
+
+  /**
+   * Check whether the stack is empty.  Concurrency safe, though the result may be stale by the
+   * time it is used.
+   *
+   * @return true if the stack has no nodes.
+   **/
+  bool empty() const {
+    return pointer(head_.load(std::memory_order_relaxed)) == nullptr;
+  }
+
+ private:
+  static constexpr unsigned kPointerBits = sizeof(void*) >= 8 ? 48 : 32;
+  static constexpr uint64_t kPointerMask = (uint64_t{1} << kPointerBits) - 1;
+
+  static uint64_t pack(Node* node, uint64_t tag) {
+    const uint64_t bits = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(node));
+    assert((bits & ~kPointerMask) == 0);
+    return bits | (tag << kPointerBits);
+  }
+
+  static Node* pointer(uint64_t head) {
+    return reinterpret_cast<Node*>(static_cast<uintptr_t>(head & kPointerMask));
+  }
+
+  static uint64_t tag(uint64_t head) {
+    return head >> kPointerBits;
+  }
+
+  alignas(kCacheLineSize) std::atomic<uint64_t> head_{0};
+};
+
+} // namespace dispenso
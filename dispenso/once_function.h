@@ -25,10 +25,13 @@ template <typename Result>
 class FutureImplBase;
 } // namespace detail
 
+class ThreadPool;
+
 /**
  * A class fullfilling the void() signature, and operator() must be called exactly once for valid
  * <code>OnceFunction</code>s.  This class can be much more efficient than std::function for type
- * erasing functors without too much state (currently < ~250 bytes).
+ * erasing functors without too much state (less than kMaxSmallBufferSize, by default 256 bytes,
+ * minus a pointer; see DISPENSO_MAX_SMALL_BUFFER_SIZE).
  * @note The wrapped type-erased functor in OnceFunction is *not* deleted upon destruction, but
  * rather when operator() is called.  It is the user's responsibility to ensure that operator() is
  * called.
@@ -58,13 +61,13 @@ class OnceFunction {
 
   OnceFunction(const OnceFunction& other) = delete;
 
-  OnceFunction(OnceFunction&& other) : onceCallable_(other.onceCallable_) {
+  OnceFunction(OnceFunction&& other) noexcept : onceCallable_(other.onceCallable_) {
 #if defined DISPENSO_DEBUG
     other.onceCallable_ = nullptr;
 #endif // DISPENSO_DEBUG
   }
 
-  OnceFunction& operator=(OnceFunction&& other) {
+  OnceFunction& operator=(OnceFunction&& other) noexcept {
     onceCallable_ = other.onceCallable_;
 #if defined DISPENSO_DEBUG
     if (&other != this) {
@@ -99,6 +102,7 @@ class OnceFunction {
   friend class detail::FutureBase;
   template <typename Result>
   friend class detail::FutureImplBase;
+  friend class ThreadPool;
 };
 
 } // namespace dispenso
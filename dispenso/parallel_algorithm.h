@@ -0,0 +1,348 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file parallel_algorithm.h
+ * Parallel versions of std::transform, std::copy_if and std::stable_partition.  Like for_each,
+ * these take an optional (Concurrent)TaskSet and ForEachOptions, and split the range into one
+ * contiguous block per thread.  Output is written without any shared atomics, and copy_if and
+ * partition preserve the relative order of elements.
+ **/
+
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include <dispenso/detail/scratch_buffer.h>
+#include <dispenso/for_each.h>
+
+namespace dispenso {
+
+namespace detail {
+
+template <typename TaskSetT>
+size_t forEachNumBlocks(TaskSetT& tasks, size_t n, const ForEachOptions& options) {
+  if (!n) {
+    return 0;
+  }
+  if (!options.maxThreads || PerPoolPerThreadInfo::isParForRecursive(&tasks.pool())) {
+    return 1;
+  }
+  size_t numThreads =
+      std::min<size_t>(static_cast<size_t>(tasks.numPoolThreads()), options.maxThreads) +
+      options.wait;
+  return std::max<size_t>(1, std::min(numThreads, n));
+}
+
+// Iterators to the start of each of numBlocks near-equal blocks of [first, first + n), plus the
+// end.  This only advances through the range once, so it is suitable for forward iterators too.
+template <typename Iter>
+std::vector<Iter> blockStarts(Iter first, size_t n, size_t numBlocks) {
+  std::vector<Iter> starts;
+  starts.reserve(numBlocks + 1);
+  starts.push_back(first);
+  size_t pos = 0;
+  for (size_t b = 1; b <= numBlocks; ++b) {
+    size_t next = n * b / numBlocks;
+    std::advance(first, static_cast<ssize_t>(next - pos));
+    pos = next;
+    starts.push_back(first);
+  }
+  return starts;
+}
+
+// Run the task makeTask(b) for each block b in [0, numBlocks).  If wait is true, the last block
+// runs on the calling thread and all blocks are complete on return.
+template <typename TaskSetT, typename MakeTask>
+void runBlocks(TaskSetT& tasks, size_t numBlocks, bool wait, MakeTask makeTask) {
+  if (numBlocks == 1 && wait) {
+    makeTask(size_t{0})();
+  } else if (numBlocks) {
+    tasks.scheduleBulk(
+        numBlocks - wait,
+        [&makeTask](size_t b) {
+          return [task = makeTask(b)]() mutable {
+            auto recurseInfo = PerPoolPerThreadInfo::parForRecurse();
+            task();
+          };
+        },
+        ForceQueuingTag());
+    if (wait) {
+      makeTask(numBlocks - 1)();
+    }
+  }
+  if (wait) {
+    tasks.wait();
+  }
+}
+
+// As runBlocks, but with blockFn(b) run directly, always waiting.  blockFn may capture the caller's
+// state by reference.
+template <typename TaskSetT, typename BlockFn>
+void runBlocksAndWait(TaskSetT& tasks, size_t numBlocks, const BlockFn& blockFn) {
+  runBlocks(
+      tasks, numBlocks, true, [&blockFn](size_t b) { return [&blockFn, b]() { blockFn(b); }; });
+}
+
+// Count the elements of each block satisfying pred, and replace the counts by their exclusive
+// prefix sum, i.e. the number of satisfying elements before each block.  Returns the total.
+template <typename TaskSetT, typename Iter, typename Pred>
+size_t countMatches(
+    TaskSetT& tasks,
+    const std::vector<Iter>& starts,
+    Pred& pred,
+    std::vector<CachePadded<size_t>>& counts) {
+  const size_t numBlocks = starts.size() - 1;
+  counts.assign(numBlocks, CachePadded<size_t>(0));
+  runBlocksAndWait(tasks, numBlocks, [&starts, &pred, &counts](size_t b) {
+    size_t count = 0;
+    for (Iter it = starts[b]; it != starts[b + 1]; ++it) {
+      count += static_cast<bool>(pred(*it));
+    }
+    counts[b].value = count;
+  });
+
+  size_t total = 0;
+  for (auto& c : counts) {
+    size_t count = c.value;
+    c.value = total;
+    total += count;
+  }
+  return total;
+}
+
+// Blocks write through copies of the output iterator advanced to their offsets, which single-pass
+// output iterators (e.g. std::back_inserter) do not support.
+template <typename Iter>
+constexpr bool isForwardIterator() {
+  return std::is_base_of<
+      std::forward_iterator_tag,
+      typename std::iterator_traits<Iter>::iterator_category>::value;
+}
+
+} // namespace detail
+
+/**
+ * A function like std::transform, but where op is invoked in parallel across the passed range.
+ *
+ * @param tasks The task set to schedule the transform on.
+ * @param first The iterator for the start of the input range.
+ * @param last The iterator for the end of the input range.
+ * @param out The forward iterator for the start of the output range.  The output must not overlap
+ * the input, except that <code>out</code> may equal <code>first</code>.
+ * @param op A unary function applied to each input element; its result is assigned to the
+ * corresponding output element.
+ * @param options See ForEachOptions for details.  If <code>options.wait</code> is false, the input
+ * and output must stay valid until the task set has been waited on.
+ *
+ * @return The iterator for the end of the output range.
+ **/
+template <typename TaskSetT, typename InIter, typename OutIter, typename UnaryOp>
+OutIter parallel_transform(
+    TaskSetT& tasks,
+    InIter first,
+    InIter last,
+    OutIter out,
+    UnaryOp op,
+    ForEachOptions options = {}) {
+  static_assert(
+      detail::isForwardIterator<OutIter>(),
+      "parallel_transform requires a forward output iterator");
+  size_t n = static_cast<size_t>(std::distance(first, last));
+  size_t numBlocks = detail::forEachNumBlocks(tasks, n, options);
+  auto inStarts = detail::blockStarts(first, n, numBlocks);
+  auto outStarts = detail::blockStarts(out, n, numBlocks);
+  OutIter outEnd = outStarts.back();
+  detail::runBlocks(tasks, numBlocks, options.wait, [&inStarts, &outStarts, &op](size_t b) {
+    return [it = inStarts[b], end = inStarts[b + 1], o = outStarts[b], op]() mutable {
+      for (; it != end; ++it, ++o) {
+        *o = op(*it);
+      }
+    };
+  });
+  return outEnd;
+}
+
+/**
+ * A function like std::transform, but where op is invoked in parallel across the passed range.
+ *
+ * @param first The iterator for the start of the input range.
+ * @param last The iterator for the end of the input range.
+ * @param out The forward iterator for the start of the output range.
+ * @param op A unary function applied to each input element.
+ * @param options See ForEachOptions for details; however it should be noted that this function must
+ * always wait, and therefore options.wait is ignored.
+ *
+ * @return The iterator for the end of the output range.
+ **/
+template <typename InIter, typename OutIter, typename UnaryOp>
+OutIter parallel_transform(
+    InIter first,
+    InIter last,
+    OutIter out,
+    UnaryOp op,
+    ForEachOptions options = {}) {
+  TaskSet taskSet(globalThreadPool());
+  options.wait = true;
+  return parallel_transform(taskSet, first, last, out, op, options);
+}
+
+/**
+ * A function like std::copy_if, but run in parallel.  The range is split into blocks; the matches
+ * in each block are counted, the counts are scanned to find each block's output offset, and then
+ * each block copies its matches.  The relative order of the copied elements is preserved.
+ *
+ * @param tasks The task set to schedule the copy on.  Any work previously scheduled on the task
+ * set is also waited for.
+ * @param first The iterator for the start of the input range.
+ * @param last The iterator for the end of the input range.
+ * @param out The iterator for the start of the output range, which must not overlap the input.
+ * This should be random access; other forward iterators work, but each block must advance to its
+ * offset.
+ * @param pred The predicate selecting elements to copy.  It is evaluated twice per element, and so
+ * must return the same result each time.
+ * @param options See ForEachOptions for details.  <code>options.wait</code> is ignored; the
+ * function always waits, since the output size is not known until the counts are in.
+ *
+ * @return The iterator for the end of the output range.
+ **/
+template <typename TaskSetT, typename InIter, typename OutIter, typename Pred>
+OutIter parallel_copy_if(
+    TaskSetT& tasks,
+    InIter first,
+    InIter last,
+    OutIter out,
+    Pred pred,
+    ForEachOptions options = {}) {
+  static_assert(
+      detail::isForwardIterator<OutIter>(),
+      "parallel_copy_if requires a forward output iterator");
+  options.wait = true;
+  size_t n = static_cast<size_t>(std::distance(first, last));
+  size_t numBlocks = detail::forEachNumBlocks(tasks, n, options);
+  if (numBlocks <= 1) {
+    out = std::copy_if(first, last, out, pred);
+    tasks.wait();
+    return out;
+  }
+
+  auto starts = detail::blockStarts(first, n, numBlocks);
+  std::vector<detail::CachePadded<size_t>> counts;
+  size_t total = detail::countMatches(tasks, starts, pred, counts);
+
+  detail::runBlocksAndWait(tasks, numBlocks, [&starts, &counts, &pred, out](size_t b) {
+    OutIter o = std::next(out, static_cast<ssize_t>(counts[b].value));
+    for (InIter it = starts[b]; it != starts[b + 1]; ++it) {
+      if (pred(*it)) {
+        *o = *it;
+        ++o;
+      }
+    }
+  });
+  return std::next(out, static_cast<ssize_t>(total));
+}
+
+/**
+ * A function like std::copy_if, but run in parallel on the global thread pool.
+ *
+ * @param first The iterator for the start of the input range.
+ * @param last The iterator for the end of the input range.
+ * @param out The iterator for the start of the output range.
+ * @param pred The predicate selecting elements to copy.  It is evaluated twice per element.
+ * @param options See ForEachOptions for details.
+ *
+ * @return The iterator for the end of the output range.
+ **/
+template <typename InIter, typename OutIter, typename Pred>
+OutIter
+parallel_copy_if(InIter first, InIter last, OutIter out, Pred pred, ForEachOptions options = {}) {
+  TaskSet taskSet(globalThreadPool());
+  return parallel_copy_if(taskSet, first, last, out, pred, options);
+}
+
+/**
+ * A function like std::stable_partition, but run in parallel.  Elements satisfying pred are moved
+ * to the front of the range and the rest to the back, each group keeping its relative order.  The
+ * elements are scattered into a temporary buffer by block offsets, as in parallel_copy_if, and
+ * moved back.
+ *
+ * @param tasks The task set to schedule the partition on.  Any work previously scheduled on the
+ * task set is also waited for.
+ * @param first The iterator for the start of the range.
+ * @param last The iterator for the end of the range.
+ * @param pred The predicate.  It is evaluated twice per element, and so must return the same
+ * result each time.
+ * @param options See ForEachOptions for details.  <code>options.wait</code> is ignored; the
+ * function always waits.
+ *
+ * @return The iterator to the first element of the second group.
+ **/
+template <typename TaskSetT, typename Iter, typename Pred>
+Iter parallel_partition(
+    TaskSetT& tasks,
+    Iter first,
+    Iter last,
+    Pred pred,
+    ForEachOptions options = {}) {
+  using T = typename std::iterator_traits<Iter>::value_type;
+  options.wait = true;
+  size_t n = static_cast<size_t>(std::distance(first, last));
+  size_t numBlocks = detail::forEachNumBlocks(tasks, n, options);
+  if (numBlocks <= 1) {
+    Iter mid = std::stable_partition(first, last, pred);
+    tasks.wait();
+    return mid;
+  }
+
+  auto starts = detail::blockStarts(first, n, numBlocks);
+  std::vector<detail::CachePadded<size_t>> counts;
+  size_t numTrue = detail::countMatches(tasks, starts, pred, counts);
+
+  detail::ScratchBuffer<T> scratch(n);
+  T* buf = scratch.data();
+  auto blockStart = [n, numBlocks](size_t b) { return n * b / numBlocks; };
+  detail::runBlocksAndWait(tasks, numBlocks, [&](size_t b) {
+    size_t t = counts[b].value;
+    // Failing elements go after all the passing ones, behind those of earlier blocks.
+    size_t f = numTrue + blockStart(b) - counts[b].value;
+    for (Iter it = starts[b]; it != starts[b + 1]; ++it) {
+      T* dst = buf + (pred(*it) ? t++ : f++);
+      ::new (static_cast<void*>(dst)) T(std::move(*it));
+    }
+  });
+  scratch.setConstructed();
+
+  detail::runBlocksAndWait(tasks, numBlocks, [&](size_t b) {
+    T* src = buf + blockStart(b);
+    for (Iter it = starts[b]; it != starts[b + 1]; ++it, ++src) {
+      *it = std::move(*src);
+    }
+  });
+  return std::next(first, static_cast<ssize_t>(numTrue));
+}
+
+/**
+ * A function like std::stable_partition, but run in parallel on the global thread pool.
+ *
+ * @param first The iterator for the start of the range.
+ * @param last The iterator for the end of the range.
+ * @param pred The predicate.  It is evaluated twice per element.
+ * @param options See ForEachOptions for details.
+ *
+ * @return The iterator to the first element of the second group.
+ **/
+template <typename Iter, typename Pred>
+Iter parallel_partition(Iter first, Iter last, Pred pred, ForEachOptions options = {}) {
+  TaskSet taskSet(globalThreadPool());
+  return parallel_partition(taskSet, first, last, pred, options);
+}
+
+} // namespace dispenso
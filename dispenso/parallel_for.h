@@ -12,12 +12,16 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <limits>
 #include <memory>
+#include <vector>
 
 #include <dispenso/detail/per_thread_info.h>
 #include <dispenso/task_set.h>
+#include <dispenso/timing.h>
 
 namespace dispenso {
 
@@ -27,9 +31,81 @@ namespace dispenso {
  * conjunction with other parallel_for calls or with other task submissions to a TaskSet, some
  * dynamic load balancing is automatically introduced, and selecting kStatic load balancing here can
  * be better.  If the workload per iteration deviates a lot from constant, and some ranges may be
- * much cheaper than others, select kAuto.
+ * much cheaper than others, select kAuto.  kGuided hands out large chunks early and shrinks them as
+ * the remaining work drops (as OpenMP's guided schedule does), which reduces both contention on
+ * the shared index and imbalance at the tail of irregular loops.  kAdaptive times chunks as they
+ * run, and sizes each thread's chunks to take a fixed, short amount of time; this suits loops whose
+ * per-iteration cost is unknown ahead of time.
  **/
-enum class ParForChunking { kStatic, kAuto };
+enum class ParForChunking { kStatic, kAuto, kGuided, kAdaptive };
+
+namespace detail {
+struct AffinityAccess;
+} // namespace detail
+
+/**
+ * Remembers which thread ran each chunk of a parallel_for, so that later loops over the same range
+ * hand each thread the same chunks again, and find their data still in that thread's caches.  Pass
+ * the same partitioner through <code>ParForOptions::affinity</code> to each of a series of loops,
+ * e.g. the sweeps of an iterative solver.  Each thread first runs the chunks it ran last time, and
+ * then steals chunks no other thread has claimed, so load balancing falls back to stealing when
+ * threads are busy elsewhere or chunk costs change.  The first loop, and any loop whose range,
+ * chunk size, or pool differs from the last one, starts from an even, contiguous split of the
+ * chunks.
+ *
+ * A partitioner may only be used by one loop at a time, and must outlive that loop, including when
+ * the loop does not wait.
+ **/
+class AffinityPartitioner {
+ public:
+  AffinityPartitioner() = default;
+  AffinityPartitioner(const AffinityPartitioner&) = delete;
+  AffinityPartitioner& operator=(const AffinityPartitioner&) = delete;
+
+  /**
+   * Forget the recorded placement, so that the next loop starts from an even split.
+   **/
+  void reset() {
+    numChunks_ = 0;
+  }
+
+  /**
+   * Get the number of chunks in the recorded placement.
+   *
+   * @return The chunk count of the most recent loop, or zero if there is no recorded placement.
+   **/
+  size_t numChunks() const {
+    return numChunks_;
+  }
+
+  /**
+   * Get how well the most recent loop reproduced the placement it was given.
+   *
+   * @return The number of chunks in the most recent loop that ran on the thread they were assigned
+   * to, i.e. the thread that ran them in the loop before.
+   **/
+  size_t lastAffinityHits() const {
+    return hits_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  friend struct detail::AffinityAccess;
+
+  const void* pool_ = nullptr;
+  int64_t start_ = 0;
+  int64_t end_ = 0;
+  int64_t chunk_ = 0;
+  size_t numSlots_ = 0;
+  size_t numChunks_ = 0;
+  size_t capacity_ = 0;
+  // The thread slot that ran (or is assigned) each chunk.
+  std::unique_ptr<std::atomic<uint32_t>[]> owners_;
+  std::unique_ptr<std::atomic<bool>[]> claimed_;
+  // The chunks assigned to slot s are homeChunks_[homeOffsets_[s], homeOffsets_[s + 1]).
+  std::vector<size_t> homeOffsets_;
+  std::vector<size_t> homeChunks_;
+  std::atomic<size_t> hits_{0};
+};
 
 /**
  * A set of options to control parallel_for
@@ -52,12 +128,86 @@ struct ParForOptions {
   bool wait = true;
 
   /**
-   * Specify whether default chunking should be static or auto (dynamic load balancing).  This is
-   * used when invoking the version of parallel_for that takes index parameters (vs a ChunkedRange).
+   * Specify whether default chunking should be static or one of the dynamic load balancing
+   * strategies.  This is used when invoking the version of parallel_for that takes index
+   * parameters (vs a ChunkedRange).
    **/
   ParForChunking defaultChunking = ParForChunking::kStatic;
+
+  /**
+   * Specify whether statically chunked loops should place chunks on NUMA nodes.  If true and the
+   * TaskSet's pool is NUMA-aware (see <code>ThreadPool::setNumaAware</code>), chunk i of N is
+   * scheduled onto node <code>i * numNumaNodes / N</code>.  Repeated loops over the same range
+   * therefore touch the same memory from the same node, so that first-touch placement sticks.
+   * Ignored for dynamically load-balanced (auto chunked) loops.
+   **/
+  bool numaPlacement = false;
+
+  /**
+   * Specify whether dynamically load-balanced loops should stop early if the TaskSet is canceled.
+   * If true, each thread checks <code>canceled()</code> before claiming its next chunk, and stops
+   * claiming chunks once it is set, so that e.g. a search can finish as soon as one chunk finds a
+   * match and cancels the TaskSet.  Chunks already running are not interrupted; long running
+   * bodies may poll a <code>CancellationToken</code>.  Statically chunked loops already skip chunks
+   * that have not started when the TaskSet is canceled.
+   **/
+  bool stopOnCancel = false;
+
+  /**
+   * The fewest loop indices worth running as one chunk.  The loop uses no more threads than leave
+   * every chunk this many indices (save the tail of the range, for dynamic chunking), and runs
+   * inline on the calling thread if the range is too small to make two such chunks.  Explicit
+   * chunk sizes smaller than this are raised to it.  Ignored by 2D and 3D loops.
+   **/
+  uint32_t minItemsPerChunk = 1;
+
+  /**
+   * An optional estimate of the cost of one loop index, in nanoseconds.  If nonzero, chunks are
+   * also made large enough to take at least <code>kParForMinChunkNs</code>, so that loops with too
+   * little work to repay fanning out run inline, and larger loops use only as many threads as they
+   * keep busy.  Ignored by 2D and 3D loops.
+   **/
+  double costPerItemNs = 0.0;
+
+  /**
+   * If greater than one, statically chunked loops place the boundaries between chunks on
+   * multiples of this many indices, so that threads writing to adjacent parts of an array never
+   * share a cache line, and vectorized bodies get aligned starts.  For an array of T starting on a
+   * cache line, use <code>elementsPerCacheLine<T>()</code>.  The first chunk starts at the range's
+   * start and the last ends at its end, whatever their alignment, and fewer chunks are used if the
+   * range is too small to give every chunk a full multiple.  Ignored for dynamically
+   * load-balanced loops.
+   **/
+  uint32_t chunkAlignment = 1;
+
+  /**
+   * An optional partitioner that records which thread ran each chunk, and steers later loops
+   * given the same partitioner to run each chunk on the same thread; see AffinityPartitioner.
+   * Statically chunked loops use one chunk per thread, and dynamically chunked ones use the auto
+   * chunk size, or the range's explicit one.  When set, <code>numaPlacement</code> and
+   * <code>chunkAlignment</code> are ignored.  Ignored by loops with per-thread state, and by 2D and
+   * 3D loops.
+   **/
+  AffinityPartitioner* affinity = nullptr;
 };
 
+/**
+ * Get the number of T that fit in a cache line, for use as
+ * <code>ParForOptions::chunkAlignment</code>.
+ *
+ * @return <code>kCacheLineSize / sizeof(T)</code>, or 1 if T is larger than a cache line.
+ **/
+template <typename T>
+constexpr uint32_t elementsPerCacheLine() {
+  return sizeof(T) >= kCacheLineSize ? 1 : static_cast<uint32_t>(kCacheLineSize / sizeof(T));
+}
+
+/**
+ * The least work, in nanoseconds, that a chunk should carry when <code>costPerItemNs</code> is
+ * given.  This is several times the cost of scheduling a chunk on a pool thread and waiting for it.
+ **/
+constexpr double kParForMinChunkNs = 10000.0;
+
 /**
  * A helper class for <code>parallel_for</code>.  It provides various configuration parameters to
  * describe how to break up work for parallel processing.  ChunkedRanges can be created with Auto
@@ -72,7 +222,11 @@ template <typename IntegerT = ssize_t>
 struct ChunkedRange {
   struct Static {};
   struct Auto {};
+  struct Guided {};
+  struct Adaptive {};
   static constexpr IntegerT kStatic = std::numeric_limits<IntegerT>::max();
+  static constexpr IntegerT kGuided = std::numeric_limits<IntegerT>::max() - 1;
+  static constexpr IntegerT kAdaptive = std::numeric_limits<IntegerT>::max() - 2;
 
   /**
    * Create a ChunkedRange with specific chunk size
@@ -97,11 +251,34 @@ struct ChunkedRange {
    * @param e The end of the range.
    **/
   ChunkedRange(IntegerT s, IntegerT e, Auto) : ChunkedRange(s, e, 0) {}
+  /**
+   * Create a ChunkedRange with guided chunking, where chunk sizes shrink as work runs out.
+   *
+   * @param s The start of the range.
+   * @param e The end of the range.
+   **/
+  ChunkedRange(IntegerT s, IntegerT e, Guided) : ChunkedRange(s, e, kGuided) {}
+  /**
+   * Create a ChunkedRange with adaptive chunking, where chunk sizes are chosen from measured chunk
+   * run times.
+   *
+   * @param s The start of the range.
+   * @param e The end of the range.
+   **/
+  ChunkedRange(IntegerT s, IntegerT e, Adaptive) : ChunkedRange(s, e, kAdaptive) {}
 
   bool isStatic() const {
     return chunk == kStatic;
   }
 
+  bool isGuided() const {
+    return chunk == kGuided;
+  }
+
+  bool isAdaptive() const {
+    return chunk == kAdaptive;
+  }
+
   bool empty() const {
     return end <= start;
   }
@@ -117,7 +294,8 @@ struct ChunkedRange {
     ssize_t workingThreads = static_cast<ssize_t>(numLaunched) + ssize_t{oneOnCaller};
     assert(workingThreads > 1);
 
-    if (!chunk) {
+    if (!chunk || chunk == kGuided || chunk == kAdaptive) {
+      // Guided and adaptive chunking use this as a starting point.
       // TODO(bbudge): play with different load balancing factors for auto.
       // IntegerT dynFactor = std::log2(1.0f + (end_ - start_) / (cyclesPerIndex_ *
       // cyclesPerIndex_));
@@ -148,9 +326,17 @@ template <typename IntegerA, typename IntegerB>
 inline ChunkedRange<std::common_type_t<IntegerA, IntegerB>>
 makeChunkedRange(IntegerA start, IntegerB end, ParForChunking chunking = ParForChunking::kStatic) {
   using IntegerT = std::common_type_t<IntegerA, IntegerB>;
-  return (chunking == ParForChunking::kStatic)
-      ? ChunkedRange<IntegerT>(start, end, typename ChunkedRange<IntegerT>::Static())
-      : ChunkedRange<IntegerT>(start, end, typename ChunkedRange<IntegerT>::Auto());
+  switch (chunking) {
+    case ParForChunking::kStatic:
+      return ChunkedRange<IntegerT>(start, end, typename ChunkedRange<IntegerT>::Static());
+    case ParForChunking::kGuided:
+      return ChunkedRange<IntegerT>(start, end, typename ChunkedRange<IntegerT>::Guided());
+    case ParForChunking::kAdaptive:
+      return ChunkedRange<IntegerT>(start, end, typename ChunkedRange<IntegerT>::Adaptive());
+    case ParForChunking::kAuto:
+    default:
+      return ChunkedRange<IntegerT>(start, end, typename ChunkedRange<IntegerT>::Auto());
+  }
 }
 
 /**
@@ -166,8 +352,307 @@ makeChunkedRange(IntegerA start, IntegerB end, IntegerC chunkSize) {
   return ChunkedRange<std::common_type_t<IntegerA, IntegerB>>(start, end, chunkSize);
 }
 
+/**
+ * A two-dimensional range for <code>parallel_for</code>, split into rectangular tiles.  Each
+ * dimension is described by a ChunkedRange whose chunk is the tile extent in that dimension; a
+ * chunk of zero selects the extent automatically, aiming for tiles of a few thousand elements
+ * (small enough to stay cache resident), while making enough tiles to keep all threads busy.
+ * Tiles are enumerated in row-major order.  With static chunking each thread receives a contiguous
+ * run of tiles, and with auto chunking tiles are dynamically load balanced.
+ **/
+template <typename IntegerT = ssize_t>
+struct ChunkedRange2D {
+  /**
+   * Create a ChunkedRange2D.
+   *
+   * @param yStart The start of the outer (slow) dimension.
+   * @param yEnd The end of the outer dimension.
+   * @param xStart The start of the inner (fast, contiguous) dimension.
+   * @param xEnd The end of the inner dimension.
+   * @param chunking The strategy for distributing tiles to threads.
+   * @param tileY The tile extent in the outer dimension, or zero to choose automatically.
+   * @param tileX The tile extent in the inner dimension, or zero to choose automatically.
+   **/
+  ChunkedRange2D(
+      IntegerT yStart,
+      IntegerT yEnd,
+      IntegerT xStart,
+      IntegerT xEnd,
+      ParForChunking chunking = ParForChunking::kStatic,
+      IntegerT tileY = 0,
+      IntegerT tileX = 0)
+      : y(yStart, yEnd, tileY), x(xStart, xEnd, tileX), chunking(chunking) {}
+
+  bool empty() const {
+    return y.empty() || x.empty();
+  }
+
+  ChunkedRange<IntegerT> y;
+  ChunkedRange<IntegerT> x;
+  ParForChunking chunking;
+};
+
+/**
+ * A three-dimensional range for <code>parallel_for</code>, split into box-shaped tiles.  See
+ * ChunkedRange2D.
+ **/
+template <typename IntegerT = ssize_t>
+struct ChunkedRange3D {
+  /**
+   * Create a ChunkedRange3D.
+   *
+   * @param zStart The start of the outermost dimension.
+   * @param zEnd The end of the outermost dimension.
+   * @param yStart The start of the middle dimension.
+   * @param yEnd The end of the middle dimension.
+   * @param xStart The start of the innermost (contiguous) dimension.
+   * @param xEnd The end of the innermost dimension.
+   * @param chunking The strategy for distributing tiles to threads.
+   * @param tileZ The tile extent in the outermost dimension, or zero to choose automatically.
+   * @param tileY The tile extent in the middle dimension, or zero to choose automatically.
+   * @param tileX The tile extent in the innermost dimension, or zero to choose automatically.
+   **/
+  ChunkedRange3D(
+      IntegerT zStart,
+      IntegerT zEnd,
+      IntegerT yStart,
+      IntegerT yEnd,
+      IntegerT xStart,
+      IntegerT xEnd,
+      ParForChunking chunking = ParForChunking::kStatic,
+      IntegerT tileZ = 0,
+      IntegerT tileY = 0,
+      IntegerT tileX = 0)
+      : z(zStart, zEnd, tileZ),
+        y(yStart, yEnd, tileY),
+        x(xStart, xEnd, tileX),
+        chunking(chunking) {}
+
+  bool empty() const {
+    return z.empty() || y.empty() || x.empty();
+  }
+
+  ChunkedRange<IntegerT> z;
+  ChunkedRange<IntegerT> y;
+  ChunkedRange<IntegerT> x;
+  ParForChunking chunking;
+};
+
+/**
+ * Create a ChunkedRange2D.  See the ChunkedRange2D constructor for parameters.
+ **/
+template <typename IntegerA, typename IntegerB, typename IntegerC, typename IntegerD>
+inline auto makeChunkedRange2D(
+    IntegerA yStart,
+    IntegerB yEnd,
+    IntegerC xStart,
+    IntegerD xEnd,
+    ParForChunking chunking = ParForChunking::kStatic) {
+  using IntegerT = std::common_type_t<IntegerA, IntegerB, IntegerC, IntegerD>;
+  return ChunkedRange2D<IntegerT>(yStart, yEnd, xStart, xEnd, chunking);
+}
+
+/**
+ * Create a ChunkedRange3D.  See the ChunkedRange3D constructor for parameters.
+ **/
+template <
+    typename IntegerA,
+    typename IntegerB,
+    typename IntegerC,
+    typename IntegerD,
+    typename IntegerE,
+    typename IntegerF>
+inline auto makeChunkedRange3D(
+    IntegerA zStart,
+    IntegerB zEnd,
+    IntegerC yStart,
+    IntegerD yEnd,
+    IntegerE xStart,
+    IntegerF xEnd,
+    ParForChunking chunking = ParForChunking::kStatic) {
+  using IntegerT =
+      std::common_type_t<IntegerA, IntegerB, IntegerC, IntegerD, IntegerE, IntegerF>;
+  return ChunkedRange3D<IntegerT>(zStart, zEnd, yStart, yEnd, xStart, xEnd, chunking);
+}
+
 namespace detail {
 
+// Claims chunks of [index, end) from a shared index on behalf of one of workingThreads threads, and
+// runs f on each, until the range is exhausted.  The chunk sizing policy follows the range's
+// chunking: fixed, guided (a fraction of the remaining work), or adaptive (sized from the measured
+// run time of this thread's previous chunk).  Non-fixed chunks are never smaller than a quarter of
+// the auto chunk size, or than minItems, to bound contention on the index.  If cancelSource is
+// non-null, no further chunks are claimed once it is canceled.
+template <typename IntegerT, typename F>
+void runDynamicChunks(
+    const ChunkedRange<IntegerT>& range,
+    std::atomic<IntegerT>& index,
+    IntegerT chunk,
+    int64_t minItems,
+    ssize_t workingThreads,
+    const TaskSetBase* cancelSource,
+    F& f) {
+  const IntegerT end = range.end;
+  auto stopped = [cancelSource]() { return cancelSource && cancelSource->canceled(); };
+  if (!range.isGuided() && !range.isAdaptive()) {
+    while (!stopped()) {
+      IntegerT cur = index.fetch_add(chunk, std::memory_order_relaxed);
+      if (cur >= end) {
+        break;
+      }
+      f(cur, std::min<IntegerT>(static_cast<IntegerT>(cur + chunk), end));
+    }
+    return;
+  }
+
+  constexpr double kAdaptiveChunkSeconds = 50e-6;
+  const int64_t minChunk = std::max<int64_t>(minItems, chunk / 4);
+  const int64_t divisor = 2 * workingThreads;
+  int64_t adaptiveChunk = minChunk;
+  while (!stopped()) {
+    // The guided bound uses a possibly stale view of the remaining work; that only affects sizing,
+    // since the claim itself is an atomic fetch_add.
+    int64_t remaining =
+        static_cast<int64_t>(end) - static_cast<int64_t>(index.load(std::memory_order_relaxed));
+    if (remaining <= 0) {
+      break;
+    }
+    int64_t guided = std::max<int64_t>(minChunk, remaining / divisor);
+    int64_t thisChunk = range.isAdaptive() ? std::min(adaptiveChunk, guided) : guided;
+    IntegerT cur = index.fetch_add(static_cast<IntegerT>(thisChunk), std::memory_order_relaxed);
+    if (cur >= end) {
+      break;
+    }
+    IntegerT next = static_cast<IntegerT>(std::min<int64_t>(cur + thisChunk, end));
+    if (range.isAdaptive()) {
+      double startTime = getTime();
+      f(cur, next);
+      double elapsed = getTime() - startTime;
+      // Scale toward the target duration, changing by at most a factor of two per chunk.
+      double scale = elapsed > 0.0 ? kAdaptiveChunkSeconds / elapsed : 2.0;
+      scale = std::min(2.0, std::max(0.5, scale));
+      adaptiveChunk = std::max<int64_t>(
+          minChunk, static_cast<int64_t>(static_cast<double>(thisChunk) * scale));
+    } else {
+      f(cur, next);
+    }
+  }
+}
+
+template <typename TaskSetT, typename F>
+void scheduleStaticChunk(
+    TaskSetT& taskSet,
+    F&& f,
+    ssize_t chunk,
+    ssize_t numChunks,
+    size_t numaNodes,
+    bool forceQueuing = false) {
+  if (numaNodes > 1) {
+    size_t node = static_cast<size_t>(chunk) * numaNodes / static_cast<size_t>(numChunks);
+    taskSet.scheduleOnNode(std::forward<F>(f), node);
+  } else if (forceQueuing) {
+    taskSet.schedule(std::forward<F>(f), ForceQueuingTag());
+  } else {
+    taskSet.schedule(std::forward<F>(f));
+  }
+}
+
+// Schedules the chunk tasks produced by gen(0) ... gen(count - 1), in one bulk operation unless
+// the chunks need to be placed on particular NUMA nodes.
+template <typename TaskSetT, typename Gen>
+void scheduleStaticChunks(
+    TaskSetT& taskSet,
+    ssize_t count,
+    ssize_t numChunks,
+    size_t numaNodes,
+    Gen&& gen) {
+  if (count <= 0) {
+    return;
+  }
+  if (numaNodes > 1) {
+    for (ssize_t t = 0; t < count; ++t) {
+      scheduleStaticChunk(taskSet, gen(static_cast<size_t>(t)), t, numChunks, numaNodes);
+    }
+  } else {
+    taskSet.scheduleBulk(static_cast<size_t>(count), gen);
+  }
+}
+
+// The fewest indices worth running as one chunk, from minItemsPerChunk and the cost hint.
+inline int64_t minChunkItems(const ParForOptions& options) {
+  double items = static_cast<double>(std::max<uint32_t>(1, options.minItemsPerChunk));
+  if (options.costPerItemNs > 0.0) {
+    items = std::max(items, std::ceil(kParForMinChunkNs / options.costPerItemNs));
+  }
+  return static_cast<int64_t>(std::min(items, 1e18));
+}
+
+// Caps options.maxThreads so that each chunk of a loop over size indices gets at least
+// minChunkItems(options) of them.  A cap of zero threads runs the loop inline.
+inline void capThreadsForGrain(int64_t size, ParForOptions& options) {
+  const int64_t minItems = minChunkItems(options);
+  if (minItems <= 1) {
+    return;
+  }
+  const int64_t maxChunks = size / minItems;
+  // When waiting, the calling thread runs one of the chunks.
+  const int64_t maxThreads = maxChunks <= 1 ? 0 : maxChunks - options.wait;
+  options.maxThreads = static_cast<uint32_t>(std::min<int64_t>(options.maxThreads, maxThreads));
+}
+
+// The boundaries of up to maxChunks static chunks over a range, rounded up to multiples of
+// alignment in absolute index terms.  The chunk count is reduced so that chunks are at least
+// alignment long, which keeps the rounded boundaries distinct and inside the range.
+template <typename IntegerT>
+class AlignedStaticChunks {
+ public:
+  AlignedStaticChunks(const ChunkedRange<IntegerT>& range, ssize_t maxChunks, uint32_t alignment)
+      : start_(range.start),
+        end_(range.end),
+        size_(range.size()),
+        alignment_(std::max<int64_t>(1, alignment)),
+        numChunks_(static_cast<ssize_t>(std::max<int64_t>(
+            1, std::min<int64_t>(static_cast<int64_t>(maxChunks), size_ / alignment_)))) {}
+
+  ssize_t numChunks() const {
+    return numChunks_;
+  }
+
+  // The start of chunk i, or the end of the range for i == numChunks().
+  IntegerT boundary(ssize_t i) const {
+    if (i <= 0) {
+      return start_;
+    }
+    if (i >= numChunks_) {
+      return end_;
+    }
+    const int64_t n = static_cast<int64_t>(numChunks_);
+    const int64_t k = static_cast<int64_t>(i);
+    // Split to avoid overflowing size_ * k.
+    int64_t x = static_cast<int64_t>(start_) + (size_ / n) * k + (size_ % n) * k / n;
+    int64_t rem = x % alignment_;
+    if (rem < 0) {
+      rem += alignment_;
+    }
+    if (rem) {
+      x += alignment_ - rem;
+    }
+    return static_cast<IntegerT>(std::min<int64_t>(x, static_cast<int64_t>(end_)));
+  }
+
+ private:
+  IntegerT start_;
+  IntegerT end_;
+  int64_t size_;
+  int64_t alignment_;
+  ssize_t numChunks_;
+};
+
+template <typename TaskSetT>
+size_t staticNumaNodes(TaskSetT& taskSet, const ParForOptions& options) {
+  return options.numaPlacement ? taskSet.pool().numNumaNodes() : 1;
+}
+
 template <typename TaskSetT, typename IntegerT, typename F>
 void parallel_for_staticImpl(
     TaskSetT& taskSet,
@@ -178,6 +663,11 @@ void parallel_for_staticImpl(
   // Reduce threads used if they exceed work to be done.
   numThreads = std::min<ssize_t>(numThreads, range.size()) + options.wait;
 
+  const AlignedStaticChunks<IntegerT> aligned(range, numThreads, options.chunkAlignment);
+  if (options.chunkAlignment > 1) {
+    numThreads = aligned.numChunks();
+  }
+
   auto chunking = detail::staticChunkSize(range.size(), numThreads);
   IntegerT chunkSize = static_cast<IntegerT>(chunking.ceilChunkSize);
 
@@ -186,39 +676,39 @@ void parallel_for_staticImpl(
   // (!perfectlyChunked) ? chunking.transitionTaskIndex : numThreads - 1;
   ssize_t firstLoopLen = static_cast<ssize_t>(chunking.transitionTaskIndex) - perfectlyChunked;
 
-  IntegerT start = range.start;
-  ssize_t t;
-  for (t = 0; t < firstLoopLen; ++t) {
-    IntegerT next = static_cast<IntegerT>(start + chunkSize);
-    taskSet.schedule([start, next, f]() {
-      auto recurseInfo = detail::PerPoolPerThreadInfo::parForRecurse();
-      f(start, next);
-    });
-    start = next;
-  }
+  const size_t numaNodes = staticNumaNodes(taskSet, options);
 
-  // Reduce the remaining chunk sizes by 1.
-  chunkSize = static_cast<IntegerT>(chunkSize - !perfectlyChunked);
-  // Finish submitting all but the last item.
-  for (; t < numThreads - 1; ++t) {
-    IntegerT next = static_cast<IntegerT>(start + chunkSize);
-    taskSet.schedule([start, next, f]() {
+  IntegerT start = range.start;
+  // Chunks before firstLoopLen are one larger than the rest.  Submit all but the last item.
+  IntegerT smallChunkSize = static_cast<IntegerT>(chunkSize - !perfectlyChunked);
+  ssize_t t = numThreads - 1;
+  scheduleStaticChunks(taskSet, t, numThreads, numaNodes, [&](size_t i) {
+    IntegerT next = options.chunkAlignment > 1
+        ? aligned.boundary(static_cast<ssize_t>(i) + 1)
+        : static_cast<IntegerT>(
+              start + (static_cast<ssize_t>(i) < firstLoopLen ? chunkSize : smallChunkSize));
+    auto chunkTask = [start, next, f]() {
       auto recurseInfo = detail::PerPoolPerThreadInfo::parForRecurse();
       f(start, next);
-    });
+    };
     start = next;
-  }
+    return chunkTask;
+  });
 
   if (options.wait) {
     f(start, range.end);
     taskSet.wait();
   } else {
-    taskSet.schedule(
+    scheduleStaticChunk(
+        taskSet,
         [start, end = range.end, f]() {
           auto recurseInfo = detail::PerPoolPerThreadInfo::parForRecurse();
           f(start, end);
         },
-        ForceQueuingTag());
+        t,
+        numThreads,
+        numaNodes,
+        true);
   }
 }
 
@@ -239,6 +729,11 @@ void parallel_for_staticImpl(
   // Reduce threads used if they exceed work to be done.
   numThreads = std::min<ssize_t>(numThreads, range.size()) + options.wait;
 
+  const AlignedStaticChunks<IntegerT> aligned(range, numThreads, options.chunkAlignment);
+  if (options.chunkAlignment > 1) {
+    numThreads = aligned.numChunks();
+  }
+
   for (ssize_t i = 0; i < numThreads; ++i) {
     states.emplace_back(defaultState());
   }
@@ -251,40 +746,170 @@ void parallel_for_staticImpl(
   // (!perfectlyChunked) ? chunking.transitionTaskIndex : numThreads - 1;
   ssize_t firstLoopLen = chunking.transitionTaskIndex - perfectlyChunked;
 
+  const size_t numaNodes = staticNumaNodes(taskSet, options);
+
   auto stateIt = states.begin();
   IntegerT start = range.start;
-  ssize_t t;
-  for (t = 0; t < firstLoopLen; ++t) {
-    IntegerT next = static_cast<IntegerT>(start + chunkSize);
-    taskSet.schedule([it = stateIt++, start, next, f]() {
+  // Chunks before firstLoopLen are one larger than the rest.  Submit all but the last item.
+  IntegerT smallChunkSize = static_cast<IntegerT>(chunkSize - !perfectlyChunked);
+  ssize_t t = numThreads - 1;
+  scheduleStaticChunks(taskSet, t, numThreads, numaNodes, [&](size_t i) {
+    IntegerT next = options.chunkAlignment > 1
+        ? aligned.boundary(static_cast<ssize_t>(i) + 1)
+        : static_cast<IntegerT>(
+              start + (static_cast<ssize_t>(i) < firstLoopLen ? chunkSize : smallChunkSize));
+    auto chunkTask = [it = stateIt++, start, next, f]() {
       auto recurseInfo = detail::PerPoolPerThreadInfo::parForRecurse();
       f(*it, start, next);
-    });
+    };
     start = next;
-  }
-
-  // Reduce the remaining chunk sizes by 1.
-  chunkSize = static_cast<IntegerT>(chunkSize - !perfectlyChunked);
-  // Finish submitting all but the last item.
-  for (; t < numThreads - 1; ++t) {
-    IntegerT next = static_cast<IntegerT>(start + chunkSize);
-    taskSet.schedule([it = stateIt++, start, next, f]() {
-      auto recurseInfo = detail::PerPoolPerThreadInfo::parForRecurse();
-      f(*it, start, next);
-    });
-    start = next;
-  }
+    return chunkTask;
+  });
 
   if (options.wait) {
     f(*stateIt, start, range.end);
     taskSet.wait();
   } else {
-    taskSet.schedule(
+    scheduleStaticChunk(
+        taskSet,
         [stateIt, start, end = range.end, f]() {
           auto recurseInfo = detail::PerPoolPerThreadInfo::parForRecurse();
           f(*stateIt, start, end);
         },
-        ForceQueuingTag());
+        t,
+        numThreads,
+        numaNodes,
+        true);
+  }
+}
+
+struct AffinityAccess {
+  // Sets p up for a loop over [start, end) in chunks of chunk indices, run by numSlots thread
+  // slots.  The recorded placement is kept if the layout matches the last loop's, and otherwise
+  // replaced by an even, contiguous split.  Then each slot's home chunks are gathered, and all
+  // chunks are marked unclaimed.
+  static void prepare(
+      AffinityPartitioner& p,
+      const void* pool,
+      int64_t start,
+      int64_t end,
+      int64_t chunk,
+      size_t numSlots) {
+    if (!p.numChunks_ || p.pool_ != pool || p.start_ != start || p.end_ != end ||
+        p.chunk_ != chunk || p.numSlots_ != numSlots) {
+      const size_t numChunks = static_cast<size_t>((end - start + chunk - 1) / chunk);
+      if (numChunks > p.capacity_) {
+        p.owners_.reset(new std::atomic<uint32_t>[numChunks]);
+        p.claimed_.reset(new std::atomic<bool>[numChunks]);
+        p.capacity_ = numChunks;
+      }
+      for (size_t c = 0; c < numChunks; ++c) {
+        p.owners_[c].store(
+            static_cast<uint32_t>(c * numSlots / numChunks), std::memory_order_relaxed);
+      }
+      p.pool_ = pool;
+      p.start_ = start;
+      p.end_ = end;
+      p.chunk_ = chunk;
+      p.numSlots_ = numSlots;
+      p.numChunks_ = numChunks;
+    }
+
+    // Counting sort of the chunks by owner.  Placing chunk c advances homeOffsets_[owner], which
+    // leaves each slot's offset at the start of the next slot's chunks, so shift them back after.
+    p.homeOffsets_.assign(numSlots + 1, 0);
+    p.homeChunks_.resize(p.numChunks_);
+    for (size_t c = 0; c < p.numChunks_; ++c) {
+      ++p.homeOffsets_[p.owners_[c].load(std::memory_order_relaxed) + 1];
+      p.claimed_[c].store(false, std::memory_order_relaxed);
+    }
+    for (size_t s = 0; s < numSlots; ++s) {
+      p.homeOffsets_[s + 1] += p.homeOffsets_[s];
+    }
+    for (size_t c = 0; c < p.numChunks_; ++c) {
+      p.homeChunks_[p.homeOffsets_[p.owners_[c].load(std::memory_order_relaxed)]++] = c;
+    }
+    for (size_t s = numSlots; s > 0; --s) {
+      p.homeOffsets_[s] = p.homeOffsets_[s - 1];
+    }
+    p.homeOffsets_[0] = 0;
+    p.hits_.store(0, std::memory_order_relaxed);
+  }
+
+  // Runs the chunks of slot's home list that are still unclaimed, and then steals any unclaimed
+  // chunk, recording slot as the owner of each chunk it runs.  The claim flags only arbitrate
+  // which thread runs a chunk; the loop's completion is published by the TaskSet's wait.
+  template <typename IntegerT, typename F>
+  static void run(AffinityPartitioner& p, size_t slot, const TaskSetBase* cancelSource, F& f) {
+    auto stopped = [cancelSource]() { return cancelSource && cancelSource->canceled(); };
+    size_t hits = 0;
+    auto tryRun = [&p, slot, &hits, &f](size_t c) {
+      if (p.claimed_[c].load(std::memory_order_relaxed) ||
+          p.claimed_[c].exchange(true, std::memory_order_relaxed)) {
+        return;
+      }
+      const int64_t begin = p.start_ + static_cast<int64_t>(c) * p.chunk_;
+      f(static_cast<IntegerT>(begin), static_cast<IntegerT>(std::min(begin + p.chunk_, p.end_)));
+      if (p.owners_[c].load(std::memory_order_relaxed) == slot) {
+        ++hits;
+      } else {
+        p.owners_[c].store(static_cast<uint32_t>(slot), std::memory_order_relaxed);
+      }
+    };
+
+    for (size_t i = p.homeOffsets_[slot]; i < p.homeOffsets_[slot + 1] && !stopped(); ++i) {
+      tryRun(p.homeChunks_[i]);
+    }
+    // Start stealing at this slot's share of an even split, to spread thieves over the range.
+    const size_t n = p.numChunks_;
+    const size_t first = slot * n / p.numSlots_;
+    for (size_t k = 0; k < n && !stopped(); ++k) {
+      const size_t c = first + k;
+      tryRun(c < n ? c : c - n);
+    }
+    p.hits_.fetch_add(hits, std::memory_order_relaxed);
+  }
+};
+
+// Runs a loop over range through options.affinity, on numToLaunch pool threads plus the calling
+// thread if waiting.  Workers of the pool use their worker index as their slot, and all other
+// threads (the caller, or threads helping while waiting) share one extra slot.
+template <typename TaskSetT, typename IntegerT, typename F>
+void parallel_for_affinityImpl(
+    TaskSetT& taskSet,
+    const ChunkedRange<IntegerT>& range,
+    F&& f,
+    const ParForOptions& options,
+    ssize_t numToLaunch) {
+  const ssize_t workingThreads = numToLaunch + options.wait;
+  int64_t chunk = range.isStatic()
+      ? (range.size() + workingThreads - 1) / workingThreads
+      : static_cast<int64_t>(range.calcChunkSize(numToLaunch, options.wait));
+  chunk = std::max(chunk, minChunkItems(options));
+
+  AffinityPartitioner* partitioner = options.affinity;
+  ThreadPool* pool = &taskSet.pool();
+  const size_t sharedSlot = static_cast<size_t>(pool->numThreads());
+  AffinityAccess::prepare(*partitioner, pool, range.start, range.end, chunk, sharedSlot + 1);
+  const TaskSetBase* cancelSource = options.stopOnCancel ? &taskSet : nullptr;
+
+  if (options.wait) {
+    auto worker = [partitioner, pool, sharedSlot, cancelSource, &f]() {
+      auto recurseInfo = detail::PerPoolPerThreadInfo::parForRecurse();
+      const size_t slot = std::min(pool->currentWorkerIndex(), sharedSlot);
+      AffinityAccess::run<IntegerT>(*partitioner, slot, cancelSource, f);
+    };
+    taskSet.scheduleBulk(static_cast<size_t>(numToLaunch), [&worker](size_t) { return worker; });
+    worker();
+    taskSet.wait();
+  } else {
+    auto worker = [partitioner, pool, sharedSlot, cancelSource, f]() mutable {
+      auto recurseInfo = detail::PerPoolPerThreadInfo::parForRecurse();
+      const size_t slot = std::min(pool->currentWorkerIndex(), sharedSlot);
+      AffinityAccess::run<IntegerT>(*partitioner, slot, cancelSource, f);
+    };
+    taskSet.scheduleBulk(
+        static_cast<size_t>(numToLaunch), [&worker](size_t) { return worker; }, ForceQueuingTag());
   }
 }
 
@@ -311,6 +936,7 @@ void parallel_for(
     }
     return;
   }
+  detail::capThreadsForGrain(range.size(), options);
   // TODO(bbudge): With options.maxThreads, we might want to allow a small fanout factor in
   // recursive case?
   const ssize_t N = taskSet.numPoolThreads();
@@ -325,38 +951,47 @@ void parallel_for(
     return;
   }
 
+  const ssize_t numToLaunch = std::min<ssize_t>(options.maxThreads, N);
+
+  if (options.affinity && (numToLaunch > 1 || options.wait)) {
+    detail::parallel_for_affinityImpl(taskSet, range, std::forward<F>(f), options, numToLaunch);
+    return;
+  }
+
+  if (options.wait && taskSet.pool().deterministic()) {
+    // A fresh partitioner starts from an even split, giving each pool thread the same chunks on
+    // every run.
+    AffinityPartitioner partitioner;
+    options.affinity = &partitioner;
+    detail::parallel_for_affinityImpl(taskSet, range, std::forward<F>(f), options, numToLaunch);
+    return;
+  }
+
   if (range.isStatic()) {
     detail::parallel_for_staticImpl(taskSet, range, std::forward<F>(f), options);
     return;
   }
 
-  const ssize_t numToLaunch = std::min<ssize_t>(options.maxThreads, N);
-
   if (numToLaunch == 1 && !options.wait) {
     taskSet.schedule([range, f = std::move(f)]() { f(range.start, range.end); });
     return;
   }
 
-  const IntegerT chunk = range.calcChunkSize(numToLaunch, options.wait);
+  const int64_t minItems = detail::minChunkItems(options);
+  const IntegerT chunk = static_cast<IntegerT>(
+      std::max<int64_t>(range.calcChunkSize(numToLaunch, options.wait), minItems));
+  const TaskSetBase* cancelSource = options.stopOnCancel ? &taskSet : nullptr;
 
   if (options.wait) {
     alignas(kCacheLineSize) std::atomic<IntegerT> index(range.start);
-    auto worker = [end = range.end, &index, f = std::move(f), chunk]() {
-      auto recurseInfo = detail::PerPoolPerThreadInfo::parForRecurse();
-      while (true) {
-        IntegerT cur = index.fetch_add(chunk, std::memory_order_relaxed);
-        if (cur >= end) {
-          break;
-        }
-        f(cur, std::min<IntegerT>(static_cast<IntegerT>(cur + chunk), end));
-      }
-    };
-
-    using Function = decltype(worker);
+    auto worker =
+        [range, &index, f = std::move(f), chunk, minItems, numToLaunch, cancelSource]() {
+          auto recurseInfo = detail::PerPoolPerThreadInfo::parForRecurse();
+          detail::runDynamicChunks(
+              range, index, chunk, minItems, numToLaunch + 1, cancelSource, f);
+        };
 
-    for (ssize_t i = 0; i < numToLaunch; ++i) {
-      taskSet.schedule(Function(worker));
-    }
+    taskSet.scheduleBulk(static_cast<size_t>(numToLaunch), [&worker](size_t) { return worker; });
     worker();
     taskSet.wait();
   } else {
@@ -368,22 +1003,15 @@ void parallel_for(
     };
     // TODO(bbudge): dispenso::make_shared?
     auto wrapper = std::make_shared<Atomic>(range.start);
-    auto worker = [end = range.end, wrapper = std::move(wrapper), f, chunk]() {
-      auto recurseInfo = detail::PerPoolPerThreadInfo::parForRecurse();
-      while (true) {
-        IntegerT cur = wrapper->index.fetch_add(chunk, std::memory_order_relaxed);
-        if (cur >= end) {
-          break;
-        }
-        f(cur, std::min<IntegerT>(static_cast<IntegerT>(cur + chunk), end));
-      }
-    };
-
-    using Function = decltype(worker);
+    auto worker =
+        [range, wrapper = std::move(wrapper), f, chunk, minItems, numToLaunch, cancelSource]() {
+          auto recurseInfo = detail::PerPoolPerThreadInfo::parForRecurse();
+          detail::runDynamicChunks(
+              range, wrapper->index, chunk, minItems, numToLaunch, cancelSource, f);
+        };
 
-    for (ssize_t i = 0; i < numToLaunch; ++i) {
-      taskSet.schedule(Function(worker), ForceQueuingTag());
-    }
+    taskSet.scheduleBulk(
+        static_cast<size_t>(numToLaunch), [&worker](size_t) { return worker; }, ForceQueuingTag());
   }
 }
 
@@ -438,6 +1066,7 @@ void parallel_for(
     }
     return;
   }
+  detail::capThreadsForGrain(range.size(), options);
   const ssize_t N = taskSet.numPoolThreads();
   if (N == 0 || !options.maxThreads || range.size() == 1 ||
       detail::PerPoolPerThreadInfo::isParForRecursive(&taskSet.pool())) {
@@ -468,26 +1097,24 @@ void parallel_for(
     return;
   }
 
-  const IntegerT chunk = range.calcChunkSize(numToLaunch, options.wait);
+  const int64_t minItems = detail::minChunkItems(options);
+  const IntegerT chunk = static_cast<IntegerT>(
+      std::max<int64_t>(range.calcChunkSize(numToLaunch, options.wait), minItems));
+  const TaskSetBase* cancelSource = options.stopOnCancel ? &taskSet : nullptr;
 
   if (options.wait) {
     alignas(kCacheLineSize) std::atomic<IntegerT> index(range.start);
-    auto worker = [end = range.end, &index, f, chunk](auto& s) {
+    auto worker = [range, &index, f, chunk, minItems, numToLaunch, cancelSource](auto& s) {
       auto recurseInfo = detail::PerPoolPerThreadInfo::parForRecurse();
-
-      while (true) {
-        IntegerT cur = index.fetch_add(chunk, std::memory_order_relaxed);
-        if (cur >= end) {
-          break;
-        }
-        f(s, cur, std::min<IntegerT>(static_cast<IntegerT>(cur + chunk), end));
-      }
+      auto body = [&s, &f](IntegerT b, IntegerT e) { f(s, b, e); };
+      detail::runDynamicChunks(
+          range, index, chunk, minItems, numToLaunch + 1, cancelSource, body);
     };
 
     auto it = states.begin();
-    for (ssize_t i = 0; i < numToLaunch; ++i) {
-      taskSet.schedule([&s = *it++, worker]() { worker(s); });
-    }
+    taskSet.scheduleBulk(static_cast<size_t>(numToLaunch), [&it, &worker](size_t) {
+      return [&s = *it++, worker]() { worker(s); };
+    });
     worker(*it);
     taskSet.wait();
   } else {
@@ -498,21 +1125,24 @@ void parallel_for(
       char buffer2[kCacheLineSize];
     };
     auto wrapper = std::make_shared<Atomic>(range.start);
-    auto worker = [end = range.end, wrapper = std::move(wrapper), f, chunk](auto& s) {
+    auto worker = [range,
+                   wrapper = std::move(wrapper),
+                   f,
+                   chunk,
+                   minItems,
+                   numToLaunch,
+                   cancelSource](auto& s) {
       auto recurseInfo = detail::PerPoolPerThreadInfo::parForRecurse();
-      while (true) {
-        IntegerT cur = wrapper->index.fetch_add(chunk, std::memory_order_relaxed);
-        if (cur >= end) {
-          break;
-        }
-        f(s, cur, std::min<IntegerT>(static_cast<IntegerT>(cur + chunk), end));
-      }
+      auto body = [&s, &f](IntegerT b, IntegerT e) { f(s, b, e); };
+      detail::runDynamicChunks(
+          range, wrapper->index, chunk, minItems, numToLaunch, cancelSource, body);
     };
 
     auto it = states.begin();
-    for (ssize_t i = 0; i < numToLaunch; ++i) {
-      taskSet.schedule([&s = *it++, worker]() { worker(s); }, ForceQueuingTag());
-    }
+    taskSet.scheduleBulk(
+        static_cast<size_t>(numToLaunch),
+        [&it, &worker](size_t) { return [&s = *it++, worker]() { worker(s); }; },
+        ForceQueuingTag());
   }
 }
 
@@ -691,4 +1321,201 @@ void parallel_for(
   parallel_for(taskSet, states, defaultState, start, end, std::forward<F>(f), options);
 }
 
+namespace detail {
+
+// The tiling of an N-dimensional range, dimension 0 being the outermost.
+template <typename IntegerT, size_t N>
+struct TileGrid {
+  TileGrid(const ChunkedRange<IntegerT>* const (&dims)[N], ssize_t numThreads) {
+    constexpr int64_t kTileElements = 4096;
+    for (size_t d = 0; d < N; ++d) {
+      start[d] = dims[d]->start;
+      end[d] = dims[d]->end;
+      size[d] = dims[d]->size();
+      isAuto[d] = dims[d]->chunk <= 0;
+      tile[d] = isAuto[d] ? size[d] : std::min<int64_t>(dims[d]->chunk, size[d]);
+    }
+    // Fill the element budget from the innermost dimension outward, splitting what remains evenly
+    // across the dimensions still to be sized.
+    int64_t inner = 1;
+    for (size_t d = N; d-- > 0;) {
+      if (isAuto[d]) {
+        double budget = static_cast<double>(kTileElements) / static_cast<double>(inner);
+        auto extent = static_cast<int64_t>(std::pow(budget, 1.0 / static_cast<double>(d + 1)));
+        tile[d] = std::max<int64_t>(1, std::min(size[d], extent));
+      }
+      inner *= tile[d];
+    }
+    // Shrink automatically sized tiles, outermost first, until there is enough parallelism.
+    const int64_t minTiles = 4 * numThreads;
+    bool shrunk = true;
+    while (numTiles() < minTiles && shrunk) {
+      shrunk = false;
+      for (size_t d = 0; d < N && numTiles() < minTiles; ++d) {
+        if (isAuto[d] && tile[d] > 1) {
+          tile[d] = (tile[d] + 1) / 2;
+          shrunk = true;
+        }
+      }
+    }
+  }
+
+  int64_t count(size_t d) const {
+    return (size[d] + tile[d] - 1) / tile[d];
+  }
+
+  int64_t numTiles() const {
+    int64_t total = 1;
+    for (size_t d = 0; d < N; ++d) {
+      total *= count(d);
+    }
+    return total;
+  }
+
+  void bounds(int64_t index, IntegerT (&b)[N], IntegerT (&e)[N]) const {
+    for (size_t d = N; d-- > 0;) {
+      int64_t c = count(d);
+      int64_t offset = (index % c) * tile[d];
+      index /= c;
+      b[d] = static_cast<IntegerT>(start[d] + offset);
+      e[d] = static_cast<IntegerT>(start[d] + std::min(offset + tile[d], size[d]));
+    }
+  }
+
+  IntegerT start[N];
+  IntegerT end[N];
+  int64_t size[N];
+  int64_t tile[N];
+  bool isAuto[N];
+};
+
+template <typename TaskSetT, typename IntegerT, size_t N, typename F>
+void parallel_for_tiles(
+    TaskSetT& taskSet,
+    const ChunkedRange<IntegerT>* const (&dims)[N],
+    ParForChunking chunking,
+    F&& f,
+    ParForOptions options) {
+  // Tiles are not loop indices, so per-index grain settings do not apply to them.
+  options.minItemsPerChunk = 1;
+  options.costPerItemNs = 0.0;
+  ssize_t numThreads = std::min<ssize_t>(taskSet.numPoolThreads(), options.maxThreads) + 1;
+  TileGrid<IntegerT, N> grid(dims, numThreads);
+  parallel_for(
+      taskSet,
+      makeChunkedRange(int64_t{0}, grid.numTiles(), chunking),
+      [grid, f = std::forward<F>(f)](int64_t tb, int64_t te) {
+        IntegerT b[N];
+        IntegerT e[N];
+        for (int64_t t = tb; t < te; ++t) {
+          grid.bounds(t, b, e);
+          f(b, e);
+        }
+      },
+      options);
+}
+
+} // namespace detail
+
+/**
+ * Execute loop over the tiles of a 2D range in parallel.
+ *
+ * @param taskSet The task set to schedule the loop on.
+ * @param range The range defining the loop extents as well as tiling and chunking strategy.
+ * @param f The functor to execute in parallel.  Must have a signature like
+ * <code>void(size_t yBegin, size_t yEnd, size_t xBegin, size_t xEnd)</code>, and is called once
+ * per tile.
+ * @param options See ParForOptions for details.
+ **/
+template <typename TaskSetT, typename IntegerT, typename F>
+void parallel_for(
+    TaskSetT& taskSet,
+    const ChunkedRange2D<IntegerT>& range,
+    F&& f,
+    ParForOptions options = {}) {
+  if (range.empty()) {
+    if (options.wait) {
+      taskSet.wait();
+    }
+    return;
+  }
+  const ChunkedRange<IntegerT>* const dims[2] = {&range.y, &range.x};
+  detail::parallel_for_tiles(
+      taskSet,
+      dims,
+      range.chunking,
+      [f = std::forward<F>(f)](const IntegerT(&b)[2], const IntegerT(&e)[2]) {
+        f(b[0], e[0], b[1], e[1]);
+      },
+      options);
+}
+
+/**
+ * Execute loop over the tiles of a 2D range in parallel on the global thread pool, and wait until
+ * complete.
+ *
+ * @param range The range defining the loop extents as well as tiling and chunking strategy.
+ * @param f The functor to execute in parallel.  Must have a signature like
+ * <code>void(size_t yBegin, size_t yEnd, size_t xBegin, size_t xEnd)</code>.
+ * @param options See ParForOptions for details.  <code>options.wait</code> will always be reset
+ * to true.
+ **/
+template <typename IntegerT, typename F>
+void parallel_for(const ChunkedRange2D<IntegerT>& range, F&& f, ParForOptions options = {}) {
+  TaskSet taskSet(globalThreadPool());
+  options.wait = true;
+  parallel_for(taskSet, range, std::forward<F>(f), options);
+}
+
+/**
+ * Execute loop over the tiles of a 3D range in parallel.
+ *
+ * @param taskSet The task set to schedule the loop on.
+ * @param range The range defining the loop extents as well as tiling and chunking strategy.
+ * @param f The functor to execute in parallel.  Must have a signature like
+ * <code>void(size_t zBegin, size_t zEnd, size_t yBegin, size_t yEnd, size_t xBegin,
+ * size_t xEnd)</code>, and is called once per tile.
+ * @param options See ParForOptions for details.
+ **/
+template <typename TaskSetT, typename IntegerT, typename F>
+void parallel_for(
+    TaskSetT& taskSet,
+    const ChunkedRange3D<IntegerT>& range,
+    F&& f,
+    ParForOptions options = {}) {
+  if (range.empty()) {
+    if (options.wait) {
+      taskSet.wait();
+    }
+    return;
+  }
+  const ChunkedRange<IntegerT>* const dims[3] = {&range.z, &range.y, &range.x};
+  detail::parallel_for_tiles(
+      taskSet,
+      dims,
+      range.chunking,
+      [f = std::forward<F>(f)](const IntegerT(&b)[3], const IntegerT(&e)[3]) {
+        f(b[0], e[0], b[1], e[1], b[2], e[2]);
+      },
+      options);
+}
+
+/**
+ * Execute loop over the tiles of a 3D range in parallel on the global thread pool, and wait until
+ * complete.
+ *
+ * @param range The range defining the loop extents as well as tiling and chunking strategy.
+ * @param f The functor to execute in parallel.  Must have a signature like
+ * <code>void(size_t zBegin, size_t zEnd, size_t yBegin, size_t yEnd, size_t xBegin,
+ * size_t xEnd)</code>.
+ * @param options See ParForOptions for details.  <code>options.wait</code> will always be reset
+ * to true.
+ **/
+template <typename IntegerT, typename F>
+void parallel_for(const ChunkedRange3D<IntegerT>& range, F&& f, ParForOptions options = {}) {
+  TaskSet taskSet(globalThreadPool());
+  options.wait = true;
+  parallel_for(taskSet, range, std::forward<F>(f), options);
+}
+
 } // namespace dispenso
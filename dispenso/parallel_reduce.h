@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file parallel_reduce.h
+ * Functions for performing parallel reductions over ranges.
+ **/
+
+#pragma once
+
+#include <vector>
+
+#include <dispenso/parallel_for.h>
+
+namespace dispenso {
+
+/**
+ * How the per-thread partial results of <code>parallel_reduce</code> are combined.
+ **/
+enum class ReduceCombine {
+  /** Partial results are folded serially on the calling thread.  Best for cheap combines. **/
+  kSerial,
+  /**
+   * Partial results are combined pairwise in a tree, with each level of the tree run in parallel.
+   * Best for expensive combines, e.g. merging containers.
+   **/
+  kTree
+};
+
+namespace detail {
+
+template <typename TaskSetT, typename T, typename CombineFn>
+T combinePartials(
+    TaskSetT& taskSet,
+    std::vector<CachePadded<T>>& partials,
+    CombineFn& combine,
+    ReduceCombine mode,
+    const ParForOptions& options) {
+  const size_t n = partials.size();
+  if (mode == ReduceCombine::kTree && n > 2) {
+    ParForOptions levelOptions;
+    levelOptions.maxThreads = options.maxThreads;
+    for (size_t stride = 1; stride < n; stride *= 2) {
+      size_t pairs = (n - stride + 2 * stride - 1) / (2 * stride);
+      parallel_for(
+          taskSet,
+          size_t{0},
+          pairs,
+          [&partials, &combine, stride](size_t pair) {
+            size_t i = pair * 2 * stride;
+            partials[i].value =
+                combine(std::move(partials[i].value), std::move(partials[i + stride].value));
+          },
+          levelOptions);
+    }
+    return std::move(partials[0].value);
+  }
+
+  T result = std::move(partials[0].value);
+  for (size_t i = 1; i < n; ++i) {
+    result = combine(std::move(result), std::move(partials[i].value));
+  }
+  return result;
+}
+
+} // namespace detail
+
+/**
+ * Reduce over the range in parallel, and wait until complete.  Each executing thread accumulates
+ * into its own copy of <code>identity</code>, and the per-thread results are then combined.
+ *
+ * @param taskSet The task set to schedule the loop on.  Any work previously scheduled on the task
+ * set is also waited for.
+ * @param range The range defining the loop extents as well as chunking strategy.
+ * @param identity The initial value for each per-thread accumulator.  This should be the identity
+ * of <code>combine</code> (e.g. 0 for sums).
+ * @param mapFn The functor to execute in parallel.  Must have a signature like
+ * <code>void(T &accumulator, size_t begin, size_t end)</code>.
+ * @param combine The functor used to combine two partial results.  Must have a signature like
+ * <code>T(T a, T b)</code>; arguments are passed as rvalues.  It must be associative, and because
+ * with auto chunking a partial result does not correspond to a contiguous subrange, it must also
+ * be commutative unless the range is statically chunked.
+ * @param options See ParForOptions for details.  <code>options.wait</code> is ignored; reductions
+ * always wait.
+ * @param combineMode Whether partial results are combined serially or in a parallel tree.
+ *
+ * @return The combined result.
+ **/
+template <typename TaskSetT, typename IntegerT, typename T, typename MapFn, typename CombineFn>
+T parallel_reduce(
+    TaskSetT& taskSet,
+    const ChunkedRange<IntegerT>& range,
+    const T& identity,
+    MapFn&& mapFn,
+    CombineFn&& combine,
+    ParForOptions options = {},
+    ReduceCombine combineMode = ReduceCombine::kSerial) {
+  if (range.empty()) {
+    taskSet.wait();
+    return identity;
+  }
+
+  options.wait = true;
+  std::vector<detail::CachePadded<T>> partials;
+  partials.reserve(static_cast<size_t>(taskSet.numPoolThreads()) + 1);
+  parallel_for(
+      taskSet,
+      partials,
+      [&identity]() { return detail::CachePadded<T>(identity); },
+      range,
+      [&mapFn](detail::CachePadded<T>& acc, IntegerT begin, IntegerT end) {
+        mapFn(acc.value, begin, end);
+      },
+      options);
+
+  return detail::combinePartials(taskSet, partials, combine, combineMode, options);
+}
+
+/**
+ * Reduce over the range in parallel on the global thread pool.
+ *
+ * @param range The range defining the loop extents as well as chunking strategy.
+ * @param identity The initial value for each per-thread accumulator.
+ * @param mapFn The functor to execute in parallel.  Must have a signature like
+ * <code>void(T &accumulator, size_t begin, size_t end)</code>.
+ * @param combine The functor used to combine two partial results.  Must have a signature like
+ * <code>T(T a, T b)</code>.
+ * @param options See ParForOptions for details.
+ * @param combineMode Whether partial results are combined serially or in a parallel tree.
+ *
+ * @return The combined result.
+ **/
+template <typename IntegerT, typename T, typename MapFn, typename CombineFn>
+T parallel_reduce(
+    const ChunkedRange<IntegerT>& range,
+    const T& identity,
+    MapFn&& mapFn,
+    CombineFn&& combine,
+    ParForOptions options = {},
+    ReduceCombine combineMode = ReduceCombine::kSerial) {
+  TaskSet taskSet(globalThreadPool());
+  return parallel_reduce(
+      taskSet,
+      range,
+      identity,
+      std::forward<MapFn>(mapFn),
+      std::forward<CombineFn>(combine),
+      options,
+      combineMode);
+}
+
+/**
+ * Reduce over the index range in parallel, and wait until complete.
+ *
+ * @param taskSet The task set to schedule the loop on.
+ * @param start The start of the loop extents.
+ * @param end The end of the loop extents.
+ * @param identity The initial value for each per-thread accumulator.
+ * @param mapFn The functor to execute in parallel.  Must have a signature like
+ * <code>void(T &accumulator, size_t index)</code>.
+ * @param combine The functor used to combine two partial results.  Must have a signature like
+ * <code>T(T a, T b)</code>.
+ * @param options See ParForOptions for details.
+ * @param combineMode Whether partial results are combined serially or in a parallel tree.
+ *
+ * @return The combined result.
+ **/
+template <
+    typename TaskSetT,
+    typename IntegerA,
+    typename IntegerB,
+    typename T,
+    typename MapFn,
+    typename CombineFn,
+    std::enable_if_t<std::is_integral<IntegerA>::value, bool> = true,
+    std::enable_if_t<std::is_integral<IntegerB>::value, bool> = true>
+T parallel_reduce(
+    TaskSetT& taskSet,
+    IntegerA start,
+    IntegerB end,
+    const T& identity,
+    MapFn&& mapFn,
+    CombineFn&& combine,
+    ParForOptions options = {},
+    ReduceCombine combineMode = ReduceCombine::kSerial) {
+  using IntegerT = std::common_type_t<IntegerA, IntegerB>;
+  return parallel_reduce(
+      taskSet,
+      makeChunkedRange(start, end, options.defaultChunking),
+      identity,
+      [&mapFn](T& acc, IntegerT s, IntegerT e) {
+        for (IntegerT i = s; i < e; ++i) {
+          mapFn(acc, i);
+        }
+      },
+      std::forward<CombineFn>(combine),
+      options,
+      combineMode);
+}
+
+/**
+ * Reduce over the index range in parallel on the global thread pool.
+ *
+ * @param start The start of the loop extents.
+ * @param end The end of the loop extents.
+ * @param identity The initial value for each per-thread accumulator.
+ * @param mapFn The functor to execute in parallel.  Must have a signature like
+ * <code>void(T &accumulator, size_t index)</code>.
+ * @param combine The functor used to combine two partial results.  Must have a signature like
+ * <code>T(T a, T b)</code>.
+ * @param options See ParForOptions for details.
+ * @param combineMode Whether partial results are combined serially or in a parallel tree.
+ *
+ * @return The combined result.
+ **/
+template <
+    typename IntegerA,
+    typename IntegerB,
+    typename T,
+    typename MapFn,
+    typename CombineFn,
+    std::enable_if_t<std::is_integral<IntegerA>::value, bool> = true,
+    std::enable_if_t<std::is_integral<IntegerB>::value, bool> = true>
+T parallel_reduce(
+    IntegerA start,
+    IntegerB end,
+    const T& identity,
+    MapFn&& mapFn,
+    CombineFn&& combine,
+    ParForOptions options = {},
+    ReduceCombine combineMode = ReduceCombine::kSerial) {
+  TaskSet taskSet(globalThreadPool());
+  return parallel_reduce(
+      taskSet,
+      start,
+      end,
+      identity,
+      std::forward<MapFn>(mapFn),
+      std::forward<CombineFn>(combine),
+      options,
+      combineMode);
+}
+
+} // namespace dispenso
@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file parallel_scan.h
+ * Functions for computing inclusive and exclusive scans (prefix sums) in parallel.
+ **/
+
+#pragma once
+
+#include <functional>
+#include <iterator>
+#include <vector>
+
+#include <dispenso/parallel_for.h>
+
+namespace dispenso {
+
+namespace detail {
+
+// The usual two-pass blocked scan.  The range is split into one block per participating thread;
+// the first pass reduces each block (but the last) into a padded partial, the partials are scanned
+// serially to get each block's starting offset, and the second pass scans each block from its
+// offset.  Only a block's own thread reads and writes within the block, so input and output may
+// alias elementwise (in-place scans).
+template <typename TaskSetT, typename InIter, typename OutIter, typename T, typename BinaryOp>
+OutIter scanImpl(
+    TaskSetT& taskSet,
+    InIter first,
+    InIter last,
+    OutIter out,
+    const T* init,
+    BinaryOp& op,
+    ParForOptions options) {
+  const size_t n = static_cast<size_t>(std::distance(first, last));
+
+  auto scanBlock = [first, out, init, &op](size_t begin, size_t end, const T* offset) {
+    size_t i = begin;
+    T acc;
+    if (offset) {
+      acc = *offset;
+    } else {
+      // Inclusive scan of the first block has no offset.
+      acc = first[i];
+      out[i++] = acc;
+    }
+    if (init) {
+      for (; i < end; ++i) {
+        T value = first[i];
+        out[i] = acc;
+        acc = op(std::move(acc), std::move(value));
+      }
+    } else {
+      for (; i < end; ++i) {
+        acc = op(std::move(acc), first[i]);
+        out[i] = acc;
+      }
+    }
+  };
+
+  const size_t numBlocks = std::min(
+      n,
+      std::min(static_cast<size_t>(taskSet.numPoolThreads()), size_t{options.maxThreads}) + 1);
+  if (numBlocks <= 1) {
+    if (n) {
+      scanBlock(0, n, init);
+    }
+    taskSet.wait();
+    return out + static_cast<std::ptrdiff_t>(n);
+  }
+
+  auto blockStart = [n, numBlocks](size_t b) { return n * b / numBlocks; };
+
+  options.wait = true;
+  std::vector<CachePadded<T>> partials(numBlocks - 1, CachePadded<T>(T{}));
+  parallel_for(
+      taskSet,
+      size_t{0},
+      numBlocks - 1,
+      [&](size_t b) {
+        size_t i = blockStart(b);
+        size_t end = blockStart(b + 1);
+        T acc = first[i];
+        for (++i; i < end; ++i) {
+          acc = op(std::move(acc), first[i]);
+        }
+        partials[b].value = std::move(acc);
+      },
+      options);
+
+  // Turn the partials into the starting offset of each block after the first.
+  T running = init ? op(*init, std::move(partials[0].value)) : std::move(partials[0].value);
+  partials[0].value = running;
+  for (size_t b = 1; b + 1 < numBlocks; ++b) {
+    running = op(std::move(running), std::move(partials[b].value));
+    partials[b].value = running;
+  }
+
+  parallel_for(
+      taskSet,
+      size_t{0},
+      numBlocks,
+      [&](size_t b) {
+        scanBlock(blockStart(b), blockStart(b + 1), b ? &partials[b - 1].value : init);
+      },
+      options);
+
+  return out + static_cast<std::ptrdiff_t>(n);
+}
+
+} // namespace detail
+
+/**
+ * Compute an inclusive scan in parallel, like <code>std::inclusive_scan</code>.  Element i of the
+ * output is <code>op(op(first[0], first[1]), ... first[i])</code>.
+ *
+ * @param taskSet The task set to schedule the scan on.  Any work previously scheduled on the task
+ * set is also waited for.
+ * @param first The start of the input range.  Must be a random access iterator.
+ * @param last The end of the input range.
+ * @param out The start of the output range.  Must be a random access iterator, and may be equal to
+ * <code>first</code> for an in-place scan.
+ * @param op An associative binary operation with signature <code>T(T, T)</code>.  It need not be
+ * commutative.
+ * @param options See ParForOptions for details.  <code>options.wait</code> is ignored; scans always
+ * wait.
+ *
+ * @return An iterator to the end of the output range.
+ **/
+template <typename TaskSetT, typename InIter, typename OutIter, typename BinaryOp>
+OutIter parallel_inclusive_scan(
+    TaskSetT& taskSet,
+    InIter first,
+    InIter last,
+    OutIter out,
+    BinaryOp op,
+    ParForOptions options = {}) {
+  using T = typename std::iterator_traits<InIter>::value_type;
+  return detail::scanImpl(taskSet, first, last, out, static_cast<const T*>(nullptr), op, options);
+}
+
+/**
+ * Compute an inclusive prefix sum in parallel.
+ *
+ * @param taskSet The task set to schedule the scan on.
+ * @param first The start of the input range.  Must be a random access iterator.
+ * @param last The end of the input range.
+ * @param out The start of the output range.
+ * @param options See ParForOptions for details.
+ *
+ * @return An iterator to the end of the output range.
+ **/
+template <typename TaskSetT, typename InIter, typename OutIter>
+OutIter parallel_inclusive_scan(
+    TaskSetT& taskSet,
+    InIter first,
+    InIter last,
+    OutIter out,
+    ParForOptions options = {}) {
+  return parallel_inclusive_scan(taskSet, first, last, out, std::plus<>(), options);
+}
+
+/**
+ * Compute an inclusive prefix sum in parallel on the global thread pool.
+ *
+ * @param first The start of the input range.  Must be a random access iterator.
+ * @param last The end of the input range.
+ * @param out The start of the output range.
+ *
+ * @return An iterator to the end of the output range.
+ **/
+template <typename InIter, typename OutIter>
+OutIter parallel_inclusive_scan(InIter first, InIter last, OutIter out) {
+  TaskSet taskSet(globalThreadPool());
+  return parallel_inclusive_scan(taskSet, first, last, out);
+}
+
+/**
+ * Compute an exclusive scan in parallel, like <code>std::exclusive_scan</code>.  Element i of the
+ * output is <code>op(op(init, first[0]), ... first[i - 1])</code>, and element 0 is
+ * <code>init</code>.
+ *
+ * @param taskSet The task set to schedule the scan on.  Any work previously scheduled on the task
+ * set is also waited for.
+ * @param first The start of the input range.  Must be a random access iterator.
+ * @param last The end of the input range.
+ * @param out The start of the output range.  Must be a random access iterator, and may be equal to
+ * <code>first</code> for an in-place scan.
+ * @param init The initial value.
+ * @param op An associative binary operation with signature <code>T(T, T)</code>.  It need not be
+ * commutative.
+ * @param options See ParForOptions for details.  <code>options.wait</code> is ignored; scans always
+ * wait.
+ *
+ * @return An iterator to the end of the output range.
+ **/
+template <typename TaskSetT, typename InIter, typename OutIter, typename T, typename BinaryOp>
+OutIter parallel_exclusive_scan(
+    TaskSetT& taskSet,
+    InIter first,
+    InIter last,
+    OutIter out,
+    T init,
+    BinaryOp op,
+    ParForOptions options = {}) {
+  return detail::scanImpl(taskSet, first, last, out, &init, op, options);
+}
+
+/**
+ * Compute an exclusive prefix sum in parallel.
+ *
+ * @param taskSet The task set to schedule the scan on.
+ * @param first The start of the input range.  Must be a random access iterator.
+ * @param last The end of the input range.
+ * @param out The start of the output range.
+ * @param init The initial value.
+ * @param options See ParForOptions for details.
+ *
+ * @return An iterator to the end of the output range.
+ **/
+template <typename TaskSetT, typename InIter, typename OutIter, typename T>
+OutIter parallel_exclusive_scan(
+    TaskSetT& taskSet,
+    InIter first,
+    InIter last,
+    OutIter out,
+    T init,
+    ParForOptions options = {}) {
+  return parallel_exclusive_scan(taskSet, first, last, out, init, std::plus<>(), options);
+}
+
+/**
+ * Compute an exclusive prefix sum in parallel on the global thread pool.
+ *
+ * @param first The start of the input range.  Must be a random access iterator.
+ * @param last The end of the input range.
+ * @param out The start of the output range.
+ * @param init The initial value.
+ *
+ * @return An iterator to the end of the output range.
+ **/
+template <typename InIter, typename OutIter, typename T>
+OutIter parallel_exclusive_scan(InIter first, InIter last, OutIter out, T init) {
+  TaskSet taskSet(globalThreadPool());
+  return parallel_exclusive_scan(taskSet, first, last, out, init);
+}
+
+} // namespace dispenso
@@ -0,0 +1,354 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file parallel_sort.h
+ * Functions for sorting ranges in parallel.
+ **/
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include <dispenso/detail/math.h>
+#include <dispenso/detail/scratch_buffer.h>
+#include <dispenso/parallel_for.h>
+
+namespace dispenso {
+
+namespace detail {
+
+// Below this many elements, sorting serially is faster than distributing the work.
+constexpr size_t kMinParallelSortSize = 4096;
+
+template <typename T, typename Compare>
+struct UseRadixSort
+    : std::integral_constant<
+          bool,
+          std::is_integral<T>::value && !std::is_same<T, bool>::value &&
+              (std::is_same<Compare, std::less<>>::value ||
+               std::is_same<Compare, std::less<T>>::value)> {};
+
+template <typename T>
+inline size_t radixDigit(T v, uint32_t shift) {
+  using U = std::make_unsigned_t<T>;
+  // Flip the sign bit so that negative values order before positive ones.
+  constexpr U kFlip = std::is_signed<T>::value ? U(U(1) << (sizeof(T) * 8 - 1)) : U(0);
+  return (static_cast<U>(static_cast<U>(v) ^ kFlip) >> shift) & 0xff;
+}
+
+// One stable counting pass of an LSD radix sort on the byte at shift.  Returns false (and moves
+// nothing) if every key has the same byte, in which case the pass would be the identity.
+template <typename TaskSetT, typename SrcIt, typename DstIt>
+bool radixPass(
+    TaskSetT& taskSet,
+    SrcIt src,
+    DstIt dst,
+    size_t n,
+    size_t numBlocks,
+    uint32_t shift,
+    std::vector<size_t>& counts) {
+  auto blockStart = [n, numBlocks](size_t b) { return n * b / numBlocks; };
+
+  parallel_for(taskSet, size_t{0}, numBlocks, [&](size_t b) {
+    size_t* c = counts.data() + b * 256;
+    std::fill(c, c + 256, size_t{0});
+    for (size_t i = blockStart(b), e = blockStart(b + 1); i < e; ++i) {
+      ++c[radixDigit(src[i], shift)];
+    }
+  });
+
+  size_t running = 0;
+  for (size_t d = 0; d < 256; ++d) {
+    size_t total = 0;
+    for (size_t b = 0; b < numBlocks; ++b) {
+      total += counts[b * 256 + d];
+    }
+    if (total == n) {
+      return false;
+    }
+    for (size_t b = 0; b < numBlocks; ++b) {
+      size_t count = counts[b * 256 + d];
+      counts[b * 256 + d] = running;
+      running += count;
+    }
+  }
+
+  parallel_for(taskSet, size_t{0}, numBlocks, [&](size_t b) {
+    size_t* c = counts.data() + b * 256;
+    for (size_t i = blockStart(b), e = blockStart(b + 1); i < e; ++i) {
+      dst[c[radixDigit(src[i], shift)]++] = src[i];
+    }
+  });
+  return true;
+}
+
+template <typename TaskSetT, typename RandomIt>
+void radixSort(TaskSetT& taskSet, RandomIt first, size_t n, size_t numBlocks) {
+  using T = typename std::iterator_traits<RandomIt>::value_type;
+  ScratchBuffer<T> scratch(n);
+  std::vector<size_t> counts(numBlocks * 256);
+  bool inScratch = false;
+  for (uint32_t shift = 0; shift < sizeof(T) * 8; shift += 8) {
+    bool moved = inScratch
+        ? radixPass(taskSet, scratch.data(), first, n, numBlocks, shift, counts)
+        : radixPass(taskSet, first, scratch.data(), n, numBlocks, shift, counts);
+    inScratch ^= moved;
+  }
+  if (inScratch) {
+    T* src = scratch.data();
+    parallel_for(taskSet, makeChunkedRange(size_t{0}, n), [src, first](size_t i, size_t e) {
+      std::copy(src + i, src + e, first + static_cast<std::ptrdiff_t>(i));
+    });
+  }
+}
+
+// Find how many of the first p elements of the stable merge of [a, a + na) and [b, b + nb) come
+// from a.  Elements of a order before equal elements of b.
+template <typename It, typename Compare>
+size_t mergeSplit(It a, size_t na, It b, size_t nb, size_t p, Compare& comp) {
+  size_t lo = p > nb ? p - nb : 0;
+  size_t hi = std::min(p, na);
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (comp(b[p - mid - 1], a[mid])) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  return lo;
+}
+
+template <bool kConstruct, typename It, typename OutIt, typename Compare>
+void mergeMove(It a, It aEnd, It b, It bEnd, OutIt out, Compare& comp) {
+  using T = typename std::iterator_traits<OutIt>::value_type;
+  auto put = [&out](auto& value) {
+    if (kConstruct) {
+      ::new (static_cast<void*>(&*out)) T(std::move(value));
+    } else {
+      *out = std::move(value);
+    }
+    ++out;
+  };
+  while (a != aEnd && b != bEnd) {
+    if (comp(*b, *a)) {
+      put(*b++);
+    } else {
+      put(*a++);
+    }
+  }
+  for (; a != aEnd; ++a) {
+    put(*a);
+  }
+  for (; b != bEnd; ++b) {
+    put(*b);
+  }
+}
+
+// Merge each adjacent pair of sorted runs of width runs from src into dst.  Each merge is split
+// into pieces of roughly equal output size so that the final levels, with only a few large merges,
+// still use every thread.  The split points are all found before any piece starts moving elements
+// out of src.
+template <bool kConstruct, typename TaskSetT, typename SrcIt, typename DstIt, typename Compare>
+void mergeLevel(
+    TaskSetT& taskSet,
+    SrcIt src,
+    DstIt dst,
+    const std::vector<size_t>& bounds,
+    size_t width,
+    size_t numPieces,
+    std::vector<size_t>& splits,
+    Compare& comp) {
+  const size_t numRuns = bounds.size() - 1;
+  const size_t pairs = numRuns / (2 * width);
+  const size_t piecesPerPair = std::max<size_t>(1, numPieces / pairs);
+
+  auto pairRuns = [&bounds, width](size_t pair, size_t& aStart, size_t& na, size_t& nb) {
+    aStart = bounds[pair * 2 * width];
+    size_t bStart = bounds[pair * 2 * width + width];
+    na = bStart - aStart;
+    nb = bounds[(pair + 1) * 2 * width] - bStart;
+  };
+
+  splits.resize(pairs * (piecesPerPair + 1));
+  for (size_t pair = 0; pair < pairs; ++pair) {
+    size_t aStart, na, nb;
+    pairRuns(pair, aStart, na, nb);
+    SrcIt a = src + static_cast<std::ptrdiff_t>(aStart);
+    SrcIt b = a + static_cast<std::ptrdiff_t>(na);
+    size_t* pairSplits = splits.data() + pair * (piecesPerPair + 1);
+    for (size_t piece = 0; piece <= piecesPerPair; ++piece) {
+      size_t p = (na + nb) * piece / piecesPerPair;
+      pairSplits[piece] = mergeSplit(a, na, b, nb, p, comp);
+    }
+  }
+
+  parallel_for(taskSet, size_t{0}, pairs * piecesPerPair, [&](size_t job) {
+    size_t pair = job / piecesPerPair;
+    size_t piece = job % piecesPerPair;
+    size_t aStart, na, nb;
+    pairRuns(pair, aStart, na, nb);
+    size_t p0 = (na + nb) * piece / piecesPerPair;
+    size_t p1 = (na + nb) * (piece + 1) / piecesPerPair;
+    size_t i0 = splits[pair * (piecesPerPair + 1) + piece];
+    size_t i1 = splits[pair * (piecesPerPair + 1) + piece + 1];
+    SrcIt a = src + static_cast<std::ptrdiff_t>(aStart);
+    SrcIt b = a + static_cast<std::ptrdiff_t>(na);
+    mergeMove<kConstruct>(
+        a + static_cast<std::ptrdiff_t>(i0),
+        a + static_cast<std::ptrdiff_t>(i1),
+        b + static_cast<std::ptrdiff_t>(p0 - i0),
+        b + static_cast<std::ptrdiff_t>(p1 - i1),
+        dst + static_cast<std::ptrdiff_t>(aStart + p0),
+        comp);
+  });
+}
+
+// Sort power-of-two many blocks independently, then merge them pairwise, ping-ponging between the
+// input and a scratch buffer.  Where the blocks are sorted is chosen by the parity of the number of
+// merge levels so that the final level always lands back in the input.
+template <typename TaskSetT, typename RandomIt, typename Compare>
+void mergeSort(TaskSetT& taskSet, RandomIt first, size_t n, size_t numBlocks, Compare& comp) {
+  using T = typename std::iterator_traits<RandomIt>::value_type;
+  const uint32_t levels = detail::log2(numBlocks);
+  const size_t numPieces = 2 * static_cast<size_t>(taskSet.numPoolThreads() + 1);
+
+  std::vector<size_t> bounds(numBlocks + 1);
+  for (size_t b = 0; b <= numBlocks; ++b) {
+    bounds[b] = n * b / numBlocks;
+  }
+
+  ScratchBuffer<T> scratch(n);
+  T* buf = scratch.data();
+  const bool sortInScratch = levels & 1;
+
+  parallel_for(taskSet, size_t{0}, numBlocks, [&](size_t b) {
+    RandomIt bFirst = first + static_cast<std::ptrdiff_t>(bounds[b]);
+    RandomIt bLast = first + static_cast<std::ptrdiff_t>(bounds[b + 1]);
+    if (sortInScratch) {
+      T* out = buf + bounds[b];
+      for (RandomIt it = bFirst; it != bLast; ++it, ++out) {
+        ::new (static_cast<void*>(out)) T(std::move(*it));
+      }
+      std::sort(buf + bounds[b], buf + bounds[b + 1], comp);
+    } else {
+      std::sort(bFirst, bLast, comp);
+    }
+  });
+
+  std::vector<size_t> splits;
+  bool inScratch = sortInScratch;
+  for (uint32_t level = 0; level < levels; ++level) {
+    size_t width = size_t{1} << level;
+    if (inScratch) {
+      mergeLevel<false>(taskSet, buf, first, bounds, width, numPieces, splits, comp);
+    } else if (level == 0) {
+      mergeLevel<true>(taskSet, first, buf, bounds, width, numPieces, splits, comp);
+    } else {
+      mergeLevel<false>(taskSet, first, buf, bounds, width, numPieces, splits, comp);
+    }
+    inScratch = !inScratch;
+  }
+  scratch.setConstructed();
+}
+
+template <typename TaskSetT, typename RandomIt, typename Compare>
+void parallelSortImpl(
+    TaskSetT& taskSet,
+    RandomIt first,
+    size_t n,
+    size_t numThreads,
+    Compare& /*comp*/,
+    std::true_type /*useRadix*/) {
+  radixSort(taskSet, first, n, numThreads);
+}
+
+template <typename TaskSetT, typename RandomIt, typename Compare>
+void parallelSortImpl(
+    TaskSetT& taskSet,
+    RandomIt first,
+    size_t n,
+    size_t numThreads,
+    Compare& comp,
+    std::false_type /*useRadix*/) {
+  mergeSort(taskSet, first, n, nextPow2(numThreads), comp);
+}
+
+} // namespace detail
+
+/**
+ * Sort the range in parallel, and wait until complete.  Like <code>std::sort</code>, the sort is
+ * not stable.  Integral keys sorted by <code>std::less</code> use a parallel LSD radix sort; all
+ * other sorts sort one block per thread and then merge the blocks with parallel merges.
+ *
+ * @param taskSet The task set to schedule the sort on.  Any work previously scheduled on the task
+ * set is also waited for.
+ * @param first The start of the range.  Must be a random access iterator.
+ * @param last The end of the range.
+ * @param comp A strict weak ordering, as for <code>std::sort</code>.
+ *
+ * @note Temporary storage for a copy of the range is allocated from dispenso's aligned allocator.
+ * Element types must be move constructible and move assignable.
+ **/
+template <typename TaskSetT, typename RandomIt, typename Compare>
+void parallel_sort(TaskSetT& taskSet, RandomIt first, RandomIt last, Compare comp) {
+  using T = typename std::iterator_traits<RandomIt>::value_type;
+  const size_t n = static_cast<size_t>(std::distance(first, last));
+  const size_t numThreads = static_cast<size_t>(taskSet.numPoolThreads()) + 1;
+
+  if (numThreads == 1 || n < detail::kMinParallelSortSize) {
+    std::sort(first, last, comp);
+  } else {
+    detail::parallelSortImpl(
+        taskSet, first, n, numThreads, comp, detail::UseRadixSort<T, Compare>());
+  }
+  taskSet.wait();
+}
+
+/**
+ * Sort the range in ascending order in parallel, and wait until complete.
+ *
+ * @param taskSet The task set to schedule the sort on.
+ * @param first The start of the range.  Must be a random access iterator.
+ * @param last The end of the range.
+ **/
+template <typename TaskSetT, typename RandomIt>
+void parallel_sort(TaskSetT& taskSet, RandomIt first, RandomIt last) {
+  parallel_sort(taskSet, first, last, std::less<>());
+}
+
+/**
+ * Sort the range in parallel on the global thread pool.
+ *
+ * @param first The start of the range.  Must be a random access iterator.
+ * @param last The end of the range.
+ * @param comp A strict weak ordering, as for <code>std::sort</code>.
+ **/
+template <typename RandomIt, typename Compare>
+void parallel_sort(RandomIt first, RandomIt last, Compare comp) {
+  TaskSet taskSet(globalThreadPool());
+  parallel_sort(taskSet, first, last, comp);
+}
+
+/**
+ * Sort the range in ascending order in parallel on the global thread pool.
+ *
+ * @param first The start of the range.  Must be a random access iterator.
+ * @param last The end of the range.
+ **/
+template <typename RandomIt>
+void parallel_sort(RandomIt first, RandomIt last) {
+  parallel_sort(first, last, std::less<>());
+}
+
+} // namespace dispenso
@@ -13,8 +13,11 @@
 #pragma once
 
 #include <limits>
+#include <memory>
 
+#include <dispenso/completion_event.h>
 #include <dispenso/detail/pipeline_impl.h>
+#include <dispenso/future.h>
 
 namespace dispenso {
 
@@ -34,6 +37,21 @@ using OpResult = detail::OpResult<T>;
  **/
 constexpr ssize_t kStageNoLimit = std::numeric_limits<ssize_t>::max();
 
+/**
+ * A stage limit asking the pipeline to pick the stage's parallelism.  The pool's threads are shared
+ * among all of a pipeline's <code>kStageAuto</code> stages, and every couple of milliseconds they
+ * are redistributed in proportion to the thread time each stage has recently used, favoring stages
+ * with items waiting for a slot, so that the slower stages get more threads as the workload
+ * changes.  Each auto stage keeps at least one thread.  Stages with fixed limits are not counted
+ * against the budget.  A generator stage with <code>kStageAuto</code> is serial.
+ **/
+constexpr ssize_t kStageAuto = detail::kAutoStageLimit;
+
+/**
+ * A constant representing an unbounded queue capacity for a stage.
+ **/
+constexpr size_t kStageUnboundedQueue = std::numeric_limits<size_t>::max();
+
 /**
  * Create a stage for use in the pipeline function.
  *
@@ -41,12 +59,152 @@ constexpr ssize_t kStageNoLimit = std::numeric_limits<ssize_t>::max();
  * which produces the output for the next stage (if any).
  * @param limit How many threads may concurrently run work for this stage.  Values larger than the
  * number of threads in the associated thread pool of the used ConcurrentTaskSet will be capped to
- * the size of the pool.
- * @return A stage object suitable for pipelining.
+ * the size of the pool.  Pass <code>kStageAuto</code> to have the pipeline tune it.
+ * @param capacity How many items may be queued for or running in this stage.  While the stage is at
+ * capacity, the generator stops producing new items.  Earlier stages still hand on the items they
+ * already hold, so this is a soft bound.  Ignored for the generator stage.
+ * @return A stage object suitable for pipelining.  Call <code>named("name")</code> on it to label
+ * the stage's work in traces (see trace.h); the name must remain valid until the trace is written.
+ **/
+template <typename F>
+auto stage(F&& f, ssize_t limit, size_t capacity = kStageUnboundedQueue) {
+  return detail::Stage<F>(std::forward<F>(f), limit, capacity);
+}
+
+/**
+ * The default number of out-of-order items an ordered stage may hold back.
+ **/
+constexpr size_t kDefaultReorderWindow = 256;
+
+/**
+ * Create an ordered stage for use in the pipeline function.  An ordered stage is serial, and
+ * receives its inputs in the order the generator produced them, even if the stages before it run
+ * in parallel.  Items that arrive early are parked in a reorder buffer until their turn; items
+ * filtered out by earlier stages simply free their turn.
+ *
+ * @param f A function-like object that can accept the result of the previous stage, and which
+ * produces the output for the next stage (if any).  Any later serial stages also see items in order
+ * if they are ordered stages themselves.
+ * @param window The capacity of the reorder buffer.  When an item would land more than
+ * <code>window</code> positions ahead of the next one this stage is waiting for, the generator
+ * holds off (helping run other pipeline work) until this stage catches up, which bounds memory.
+ * @return A stage object suitable for pipelining.  It may not be used as the generator stage.  As
+ * with <code>stage</code>, <code>named("name")</code> labels its work in traces.
  **/
 template <typename F>
-auto stage(F&& f, ssize_t limit) {
-  return detail::Stage<F>(std::forward<F>(f), limit);
+auto orderedStage(F&& f, size_t window = kDefaultReorderWindow) {
+  return detail::OrderedStage<F>(std::forward<F>(f), window);
+}
+
+/**
+ * The default number of items a fan-out stage may hold between splitting and merging them.
+ **/
+constexpr size_t kDefaultFanOutCapacity = detail::kDefaultFanOutCapacity;
+
+/**
+ * Create a fan-out stage, which hands each item to several independent branches that run
+ * concurrently, and then joins their results.  Call <code>join(merge, capacity)</code> on the
+ * result to get a stage for use in the pipeline function, e.g.
+ * <code>fanOut(stage(index, 4), compress).join(combine)</code>.
+ *
+ * @param branches Function-like objects accepting a const reference to the item, so that all of
+ * them share one copy of it.  Each must return a value.  A branch wrapped with <code>stage</code>
+ * gets that parallelism limit (including <code>kStageAuto</code>), and its capacity is ignored; a
+ * plain function-like object is serial.
+ * @return An object whose <code>join</code> member takes <code>merge</code>, a function-like
+ * object accepting the item by value (moved in once every branch is done with it) followed by each
+ * branch's result, in branch order, and <code>capacity</code>, the most items that may be between
+ * the split and the merge at once (default <code>kDefaultFanOutCapacity</code>).  While that many
+ * are, the generator holds off, as for a full stage queue.  The merge runs on the thread that
+ * finished the item's last branch, possibly concurrently for different items, and its result is
+ * passed on as for a Transform stage, with an invalid OpResult or std::optional filtering the
+ * item.  As the last stage, the merge's result is ignored.  The joined stage may not be used as
+ * the generator stage.
+ **/
+template <typename... Branches>
+auto fanOut(Branches&&... branches) {
+  static_assert(sizeof...(Branches) > 0, "fanOut needs at least one branch");
+  return detail::FanOut<Branches...>{std::tuple<Branches...>(std::forward<Branches>(branches)...)};
+}
+
+/**
+ * Wrap a generator so that it produces batches of items rather than single items.  Every item
+ * passed between stages costs a scheduled task, so for small items it is often much cheaper to
+ * pass <code>std::vector</code>s of them, letting every later stage run once per batch.  See also
+ * <code>batched</code>, which adapts per-item stage functions to batches.
+ *
+ * @param gen A generator function-like object, returning an OpResult or std::optional item, with an
+ * invalid/nullopt result indicating the end of input.  It is not called again after that.
+ * @param maxItems The maximum number of items per batch.
+ * @param maxSeconds If positive, a batch is also closed once this long has passed since its first
+ * item was generated, so that slow inputs still flow through the pipeline promptly.  The time is
+ * checked between calls to <code>gen</code>.
+ * @return A generator producing <code>OpResult<std::vector<T>></code> batches.  The final batch may
+ * be partially full.  It may be wrapped with <code>stage</code> for a parallel generator, so long
+ * as <code>gen</code> is thread-safe.
+ **/
+template <typename Gen>
+auto batchGenerator(Gen&& gen, size_t maxItems, double maxSeconds = 0.0) {
+  return detail::BatchGenerator<Gen>(std::forward<Gen>(gen), maxItems, maxSeconds);
+}
+
+/**
+ * Adapt a per-item stage function to accept a <code>std::vector</code> batch of items, as produced
+ * by <code>batchGenerator</code>.  The stage is then run once per batch, and its loop over the
+ * items is visible to the compiler (e.g. for vectorization).
+ *
+ * @param f A function-like object accepting a single item.  If it returns nothing, the adapted
+ * stage is a sink.  If it returns an OpResult or std::optional, the adapted stage returns a batch
+ * of the valid results, and batches in which every item was filtered are dropped.  Otherwise the
+ * adapted stage returns a batch of the results; if they have the item type, the input batch is
+ * reused.
+ * @return A function-like object, which may be further wrapped by <code>stage</code> or
+ * <code>orderedStage</code>.
+ **/
+template <typename F>
+auto batched(F&& f) {
+  return detail::BatchedStage<F>(std::forward<F>(f));
+}
+
+/**
+ * Options controlling a whole pipeline.
+ **/
+struct PipelineOptions {
+  /**
+   * The maximum number of items that may be in the pipeline at once, counting from when the
+   * generator is called for an item until the item is consumed by the sink or filtered out.  While
+   * the pipeline is full, the generator waits (helping run other pipeline work), which bounds the
+   * memory held by in-flight items.  Zero means unbounded.
+   **/
+  size_t maxInFlight = 0;
+};
+
+/**
+ * Pipeline work in stages, with options.  See the overload without options for details.
+ *
+ * @param pool The ThreadPool to run the work in.
+ * @param options See PipelineOptions for details.
+ * @param sIn The stages to run.
+ **/
+template <typename... Stages>
+void pipeline(ThreadPool& pool, PipelineOptions options, Stages&&... sIn) {
+  ConcurrentTaskSet tasks(pool);
+  auto pipes = detail::makePipes(tasks, std::forward<Stages>(sIn)...);
+  pipes.setMaxInFlight(options.maxInFlight);
+  pipes.execute();
+  pipes.wait();
+}
+
+/**
+ * Pipeline work in stages, with options, on dispenso's global thread pool.  See the overload
+ * without options for details.
+ *
+ * @param options See PipelineOptions for details.
+ * @param sIn The stages to run.
+ **/
+template <typename... Stages>
+void pipeline(PipelineOptions options, Stages&&... sIn) {
+  pipeline(globalThreadPool(), options, std::forward<Stages>(sIn)...);
 }
 
 /**
@@ -75,10 +233,51 @@ auto stage(F&& f, ssize_t limit) {
  **/
 template <typename... Stages>
 void pipeline(ThreadPool& pool, Stages&&... sIn) {
-  ConcurrentTaskSet tasks(pool);
-  auto pipes = detail::makePipes(tasks, std::forward<Stages>(sIn)...);
-  pipes.execute();
-  pipes.wait();
+  pipeline(pool, PipelineOptions(), std::forward<Stages>(sIn)...);
+}
+
+/**
+ * Launch a pipeline without waiting for it.  The stages work just as for <code>pipeline</code>, but
+ * this function returns as soon as the pipeline has started, so that one thread may run several
+ * pipelines at once, or do other work meanwhile, without blocking any threads.
+ *
+ * @param tasks The ConcurrentTaskSet to run the pipeline's work in.  Waiting on it also waits for
+ * the pipeline.  It must outlive the pipeline, as must any stages passed as lvalues, which are
+ * referenced rather than copied.
+ * @param options See PipelineOptions for details.
+ * @param sIn The stages to run.
+ * @return A Future that becomes ready once every stage has finished processing every item.
+ **/
+template <typename... Stages>
+Future<void> asyncPipeline(ConcurrentTaskSet& tasks, PipelineOptions options, Stages&&... sIn) {
+  using Pipes = decltype(detail::makePipes(tasks, std::forward<Stages>(sIn)...));
+  Pipes* pipes = new Pipes(detail::makePipes(tasks, std::forward<Stages>(sIn)...));
+  pipes->setMaxInFlight(options.maxInFlight);
+
+  // The future's function just waits for the pipeline.  It is normally run once the pipeline is
+  // done, making the future ready, but a waiter may run it first and so block until done.
+  auto finished = std::make_shared<CompletionEvent>();
+  detail::HeldInvoker invoker;
+  Future<void> done([finished]() { finished->wait(); }, invoker, kNotAsync, kNotDeferred);
+  pipes->execute([pipes, finished, complete = invoker.release()]() {
+    // The stages are destroyed before the future becomes ready.
+    delete pipes;
+    finished->notify();
+    complete();
+  });
+  return done;
+}
+
+/**
+ * Launch a pipeline without waiting for it.  See the overload with PipelineOptions for details.
+ *
+ * @param tasks The ConcurrentTaskSet to run the pipeline's work in.
+ * @param sIn The stages to run.
+ * @return A Future that becomes ready once the pipeline has completed.
+ **/
+template <typename... Stages>
+Future<void> asyncPipeline(ConcurrentTaskSet& tasks, Stages&&... sIn) {
+  return asyncPipeline(tasks, PipelineOptions(), std::forward<Stages>(sIn)...);
 }
 
 /**
@@ -121,6 +121,17 @@ struct AlignedBuffer {
 template <typename T>
 struct alignas(kCacheLineSize) AlignedAtomic : public std::atomic<T*> {};
 
+// A value followed by a cache line of padding.  Unlike CacheAligned, this does not rely on
+// over-aligned allocation, so arrays of these may be held in standard containers while still
+// keeping neighboring values on separate cache lines.
+template <typename T>
+struct CachePadded {
+  CachePadded(const T& t) : value(t) {}
+
+  T value;
+  char padding[kCacheLineSize];
+};
+
 inline void* alignedMalloc(size_t bytes, size_t alignment) {
   alignment = std::max(alignment, sizeof(uintptr_t));
   char* ptr = reinterpret_cast<char*>(::malloc(bytes + alignment));
@@ -7,6 +7,15 @@
 
 #include <dispenso/pool_allocator.h>
 
+#include <algorithm>
+#include <new>
+#include <mutex>
+#include <thread>
+
+#include <dispenso/detail/math.h>
+#include <dispenso/detail/trim_slabs.h>
+#include <dispenso/thread_id.h>
+
 namespace dispenso {
 
 PoolAllocator::PoolAllocator(
@@ -18,59 +27,257 @@ PoolAllocator::PoolAllocator(
       allocSize_(allocSize),
       chunksPerAlloc_(allocSize / chunkSize),
       allocFunc_(std::move(allocFunc)),
-      deallocFunc_(std::move(deallocFunc)) {
-  // Start off with at least enough space to store at least one set of chunks.
-  chunks_.reserve(chunksPerAlloc_);
+      deallocFunc_(std::move(deallocFunc)) {}
+
+// Called with slabMutex_ held.  Returns count nodes linked in order and terminated by nullptr.
+PoolAllocator::FreeNode* PoolAllocator::newNodes(size_t count) {
+  FreeNode* nodes = new FreeNode[count];
+  nodeBlocks_.push_back(nodes);
+  for (size_t i = 0; i + 1 < count; ++i) {
+    nodes[i].next.store(&nodes[i + 1], std::memory_order_relaxed);
+  }
+  return nodes;
 }
 
-char* PoolAllocator::alloc() {
-  while (true) {
-    uint32_t allocId = backingAllocLock_.fetch_add(1, std::memory_order_acquire);
-
-    if (allocId == 0) {
-      if (chunks_.empty()) {
-        char* buffer = reinterpret_cast<char*>(allocFunc_(allocSize_));
-        backingAllocs_.push_back(buffer);
-        // Push n-1 values into the chunks_ buffer, and then return the nth.
-        for (size_t i = 0; i < chunksPerAlloc_ - 1; ++i) {
-          chunks_.push_back(buffer);
-          buffer += chunkSize_;
-        }
-        backingAllocLock_.store(0, std::memory_order_release);
-        return buffer;
-      }
-      char* back = chunks_.back();
-      chunks_.pop_back();
-      backingAllocLock_.store(0, std::memory_order_release);
-      return back;
+// Called with slabMutex_ held.  Hands out the first count chunks of a new slab through ptrs, and
+// puts the rest on the free list.
+void PoolAllocator::allocSlab(char** ptrs, size_t count) {
+  char* buffer = reinterpret_cast<char*>(allocFunc_(allocSize_));
+  backingAllocs_.push_back(buffer);
+  peakBackingAllocs_ = std::max(peakBackingAllocs_, backingAllocs_.size());
+
+  FreeNode* nodes = newNodes(chunksPerAlloc_);
+  for (size_t i = 0; i < chunksPerAlloc_; ++i) {
+    char* chunk = buffer + i * chunkSize_;
+    if (i < count) {
+      ptrs[i] = chunk;
     } else {
-      std::this_thread::yield();
+      nodes[i].chunk = chunk;
+    }
+  }
+  spareNodes_.pushBatch(&nodes[0], &nodes[count - 1]);
+  if (count < chunksPerAlloc_) {
+    chunks_.pushBatch(&nodes[count], &nodes[chunksPerAlloc_ - 1]);
+  }
+}
+
+void PoolAllocator::noteAllocated(size_t count) {
+  const size_t inUse = chunksInUse_.fetch_add(count, std::memory_order_relaxed) + count;
+  size_t peak = peakChunksInUse_.load(std::memory_order_relaxed);
+  while (inUse > peak &&
+         !peakChunksInUse_.compare_exchange_weak(peak, inUse, std::memory_order_relaxed)) {
+  }
+}
+
+char* PoolAllocator::alloc() {
+  FreeNode* node = chunks_.pop();
+  if (!node) {
+    std::lock_guard<std::mutex> lock(slabMutex_);
+    // Another thread may have added a slab while we waited.
+    node = chunks_.pop();
+    if (!node) {
+      char* ptr;
+      allocSlab(&ptr, 1);
+      noteAllocated(1);
+      return ptr;
     }
   }
+  char* ptr = node->chunk;
+  spareNodes_.push(node);
+  noteAllocated(1);
+  return ptr;
 }
 
 void PoolAllocator::dealloc(char* ptr) {
-  // For now do not release any memory back to the deallocFunc until destruction.
-  // TODO(bbudge): Consider cases where we haven't gotten below some threshold of ready chunks
-  // in a while.  In that case, we could begin tracking allocations, and try to assemble entire
-  // starting allocations, possibly deferring a small amount to each alloc call.  This would be
-  // slower, but would ensure we don't get into a situation where we need a bunch of memory up
-  // front, and then never again.
-
-  while (true) {
-    uint32_t allocId = backingAllocLock_.fetch_add(1, std::memory_order_acquire);
-    if (allocId == 0) {
-      chunks_.push_back(ptr);
-      backingAllocLock_.store(0, std::memory_order_release);
+  // Memory is only released back to the deallocFunc in trim() and on destruction.
+  FreeNode* node = spareNodes_.pop();
+  if (!node) {
+    // Every chunk in use has a spare node, but racing deallocations may briefly hold them all.
+    std::lock_guard<std::mutex> lock(slabMutex_);
+    node = newNodes(1);
+  }
+  node->chunk = ptr;
+  chunks_.push(node);
+  chunksInUse_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void PoolAllocator::allocBatch(char** ptrs, size_t count) {
+  size_t got = 0;
+  while (got < count) {
+    size_t popped;
+    FreeNode* first = chunks_.popBatch(count - got, popped);
+    if (!first) {
       break;
     }
+    FreeNode* last = first;
+    for (FreeNode* node = first; node; node = node->next.load(std::memory_order_relaxed)) {
+      ptrs[got++] = node->chunk;
+      last = node;
+    }
+    spareNodes_.pushBatch(first, last);
+  }
+  if (got < count) {
+    std::lock_guard<std::mutex> lock(slabMutex_);
+    while (got < count) {
+      const size_t fromSlab = std::min(chunksPerAlloc_, count - got);
+      allocSlab(ptrs + got, fromSlab);
+      got += fromSlab;
+    }
+  }
+  noteAllocated(count);
+}
+
+void PoolAllocator::deallocBatch(char* const* ptrs, size_t count) {
+  size_t done = 0;
+  while (done < count) {
+    size_t popped;
+    FreeNode* first = spareNodes_.popBatch(count - done, popped);
+    if (!first) {
+      std::lock_guard<std::mutex> lock(slabMutex_);
+      first = newNodes(count - done);
+    }
+    FreeNode* last = first;
+    for (FreeNode* node = first; node; node = node->next.load(std::memory_order_relaxed)) {
+      node->chunk = ptrs[done++];
+      last = node;
+    }
+    chunks_.pushBatch(first, last);
+  }
+  chunksInUse_.fetch_sub(count, std::memory_order_relaxed);
+}
+
+size_t PoolAllocator::trim() {
+  std::lock_guard<std::mutex> lock(slabMutex_);
+  // Chunks freed concurrently land on the now empty free list, and keep their slabs alive.
+  std::vector<FreeNode*> nodes;
+  std::vector<char*> chunks;
+  for (FreeNode* node = chunks_.popAll(); node; node = node->next.load(std::memory_order_relaxed)) {
+    nodes.push_back(node);
+    chunks.push_back(node->chunk);
+  }
+  size_t released = detail::trimFreeSlabs(
+      backingAllocs_, chunks, chunksPerAlloc_, [this](char* slab) { deallocFunc_(slab); });
+
+  // Nodes remain allocated, so that racing pops may still read them; reuse them for the kept
+  // chunks, and keep the rest as spares.
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    if (i < chunks.size()) {
+      nodes[i]->chunk = chunks[i];
+    }
+    if (i + 1 < nodes.size()) {
+      nodes[i]->next.store(nodes[i + 1], std::memory_order_relaxed);
+    }
+  }
+  if (!chunks.empty()) {
+    chunks_.pushBatch(nodes.front(), nodes[chunks.size() - 1]);
   }
+  if (nodes.size() > chunks.size()) {
+    spareNodes_.pushBatch(nodes[chunks.size()], nodes.back());
+  }
+  return released * allocSize_;
+}
+
+PoolAllocatorStats PoolAllocator::stats() const {
+  std::lock_guard<std::mutex> lock(slabMutex_);
+  const size_t chunks = backingAllocs_.size() * chunksPerAlloc_;
+  const size_t inUse = std::min(chunksInUse_.load(std::memory_order_relaxed), chunks);
+  PoolAllocatorStats stats;
+  stats.bytesReserved = backingAllocs_.size() * allocSize_;
+  stats.peakBytesReserved = peakBackingAllocs_ * allocSize_;
+  stats.bytesFree = (chunks - inUse) * chunkSize_;
+  stats.bytesInUse = inUse * chunkSize_;
+  stats.peakBytesInUse = peakChunksInUse_.load(std::memory_order_relaxed) * chunkSize_;
+  return stats;
 }
 
 PoolAllocator::~PoolAllocator() {
   for (char* backing : backingAllocs_) {
     deallocFunc_(backing);
   }
+  for (FreeNode* nodes : nodeBlocks_) {
+    delete[] nodes;
+  }
+}
+
+constexpr size_t CachingPoolAllocator::kMagazineCapacity;
+constexpr size_t CachingPoolAllocator::kBatchSize;
+
+CachingPoolAllocator::CachingPoolAllocator(
+    size_t chunkSize,
+    size_t allocSize,
+    std::function<void*(size_t)> allocFunc,
+    std::function<void(void*)> deallocFunc)
+    : central_(chunkSize, allocSize, std::move(allocFunc), std::move(deallocFunc)),
+      // Twice as many magazines as hardware threads keeps collisions between threads rare.
+      magazineMask_(
+          detail::nextPow2(2 * std::max<size_t>(1, std::thread::hardware_concurrency())) - 1),
+      magazines_(reinterpret_cast<Magazine*>(
+          detail::alignedMalloc((magazineMask_ + 1) * sizeof(Magazine), alignof(Magazine)))) {
+  for (size_t i = 0; i <= magazineMask_; ++i) {
+    new (&magazines_[i]) Magazine();
+  }
+}
+
+CachingPoolAllocator::Magazine& CachingPoolAllocator::lockMagazine(size_t index) const {
+  Magazine& magazine = magazines_[index];
+  while (magazine.locked.exchange(true, std::memory_order_acquire)) {
+    std::this_thread::yield();
+  }
+  return magazine;
+}
+
+char* CachingPoolAllocator::alloc() {
+  Magazine& magazine = lockMagazine(threadId() & magazineMask_);
+  if (!magazine.count) {
+    central_.allocBatch(magazine.chunks, kBatchSize);
+    magazine.count = kBatchSize;
+  }
+  char* ptr = magazine.chunks[--magazine.count];
+  magazine.locked.store(false, std::memory_order_release);
+  return ptr;
+}
+
+void CachingPoolAllocator::dealloc(char* ptr) {
+  Magazine& magazine = lockMagazine(threadId() & magazineMask_);
+  if (magazine.count == kMagazineCapacity) {
+    // Keep half, so that alternating allocation and deallocation doesn't bounce batches.
+    magazine.count -= kBatchSize;
+    central_.deallocBatch(magazine.chunks + magazine.count, kBatchSize);
+  }
+  magazine.chunks[magazine.count++] = ptr;
+  magazine.locked.store(false, std::memory_order_release);
+}
+
+size_t CachingPoolAllocator::trim() {
+  for (size_t i = 0; i <= magazineMask_; ++i) {
+    Magazine& magazine = lockMagazine(i);
+    central_.deallocBatch(magazine.chunks, magazine.count);
+    magazine.count = 0;
+    magazine.locked.store(false, std::memory_order_release);
+  }
+  return central_.trim();
+}
+
+PoolAllocatorStats CachingPoolAllocator::stats() const {
+  size_t cached = 0;
+  for (size_t i = 0; i <= magazineMask_; ++i) {
+    Magazine& magazine = lockMagazine(i);
+    cached += magazine.count;
+    magazine.locked.store(false, std::memory_order_release);
+  }
+  PoolAllocatorStats stats = central_.stats();
+  // Chunks handed to magazines count as in use by the central pool.  Concurrent traffic between
+  // the two reads may make this slightly off, so clamp rather than underflow.
+  stats.bytesCached = std::min(cached * central_.chunkSize(), stats.bytesInUse);
+  stats.bytesInUse -= stats.bytesCached;
+  return stats;
+}
+
+CachingPoolAllocator::~CachingPoolAllocator() {
+  for (size_t i = 0; i <= magazineMask_; ++i) {
+    magazines_[i].~Magazine();
+  }
+  detail::alignedFree(magazines_);
 }
 
 } // namespace dispenso
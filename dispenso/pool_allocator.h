@@ -9,21 +9,49 @@
  * @file pool_allocator.h
  * A pool allocator to help reduce calls to the underlying allocation and deallocation functions
  * that can be provided custom backing allocation and deallocation functions, e.g. cudaMalloc,
- * cudaFree.
+ * cudaFree.  CachingPoolAllocator adds per-thread magazines in front of a PoolAllocator, for
+ * workloads where many threads allocate and deallocate concurrently.
  **/
 
 #pragma once
 
+#include <algorithm>
 #include <atomic>
 #include <functional>
+#include <mutex>
 #include <vector>
 
+#include <dispenso/lock_free_stack.h>
 #include <dispenso/platform.h>
 
 namespace dispenso {
 
+/**
+ * A snapshot of a pool allocator's memory usage, e.g. for export to a metrics system.
+ **/
+struct PoolAllocatorStats {
+  /** Bytes currently obtained from allocFunc. */
+  size_t bytesReserved = 0;
+  /** The most bytes ever obtained from allocFunc at once. */
+  size_t peakBytesReserved = 0;
+  /** Bytes in chunks handed out and not yet deallocated. */
+  size_t bytesInUse = 0;
+  /**
+   * The most bytes ever in use at once.  For CachingPoolAllocator, chunks cached in magazines at
+   * the time count as in use, so this is an upper bound.
+   **/
+  size_t peakBytesInUse = 0;
+  /** Bytes in free chunks in the central pool. */
+  size_t bytesFree = 0;
+  /** Bytes in free chunks cached in per-thread magazines (CachingPoolAllocator only). */
+  size_t bytesCached = 0;
+};
+
 /**
  * A pool allocator to help reduce calls to the underlying allocation and deallocation functions.
+ * Free chunks are kept on a LockFreeStack, so allocation and deallocation never wait on another
+ * thread unless a new slab must be obtained; a preempted thread cannot stall the others.  Chunk
+ * memory is never touched by the allocator, so it may be e.g. device memory.
  **/
 class PoolAllocator {
  public:
@@ -33,7 +61,7 @@ class PoolAllocator {
    * @param chunkSize The chunk size for each pool allocation
    * @param allocSize The size of underlying slabs to be chunked
    * @param allocFunc The underlying allocation function for allocating slabs
-   * @param deallocFunc The underlying deallocation function.  Currently only called on destruction.
+   * @param deallocFunc The underlying deallocation function.  Called on trim() and destruction.
    **/
   DISPENSO_DLL_ACCESS PoolAllocator(
       size_t chunkSize,
@@ -55,6 +83,51 @@ class PoolAllocator {
    **/
   DISPENSO_DLL_ACCESS void dealloc(char* ptr);
 
+  /**
+   * Allocate several chunks at once, popping them from the free list together.
+   *
+   * @param ptrs An array to be filled with pointers to buffers of chunkSize bytes
+   * @param count The number of chunks to allocate
+   **/
+  DISPENSO_DLL_ACCESS void allocBatch(char** ptrs, size_t count);
+
+  /**
+   * Deallocate several previously allocated chunks at once, pushing them onto the free list
+   * together.
+   *
+   * @param ptrs The chunks to return to the available pool
+   * @param count The number of chunks in ptrs
+   **/
+  DISPENSO_DLL_ACCESS void deallocBatch(char* const* ptrs, size_t count);
+
+  /**
+   * Release every slab whose chunks are all free back to deallocFunc.  This is not done
+   * automatically; long-running programs may call it periodically, e.g. after a spike in usage, to
+   * bound their memory.  Concurrency safe, though allocations that need a new slab wait while it
+   * runs.
+   *
+   * @return The number of bytes released.
+   **/
+  DISPENSO_DLL_ACCESS size_t trim();
+
+  /**
+   * Get a snapshot of the allocator's memory usage.  Concurrency safe, and cheap enough to call
+   * periodically; it holds the slab lock only to copy a few counters.  Under concurrent traffic
+   * the fields may be slightly inconsistent with one another.
+   *
+   * @return The current statistics.
+   **/
+  DISPENSO_DLL_ACCESS PoolAllocatorStats stats() const;
+
+  /**
+   * Get the size of the chunks handed out by this allocator.
+   *
+   * @return The chunk size in bytes.
+   **/
+  size_t chunkSize() const {
+    return chunkSize_;
+  }
+
   /**
    * Destruct a PoolAllocator
    **/
@@ -68,11 +141,107 @@ class PoolAllocator {
   std::function<void*(size_t)> allocFunc_;
   std::function<void(void*)> deallocFunc_;
 
-  // Use of a spin lock was found to be faster than std::mutex in benchmarks.
-  alignas(kCacheLineSize) std::atomic<uint32_t> backingAllocLock_{0};
+  // A free-list entry.  Entries are kept apart from the chunks so that chunk memory is never
+  // written, and are only freed on destruction, as LockFreeStack requires.
+  struct FreeNode {
+    std::atomic<FreeNode*> next{nullptr};
+    char* chunk = nullptr;
+  };
+
+  FreeNode* newNodes(size_t count);
+  void allocSlab(char** ptrs, size_t count);
+  void noteAllocated(size_t count);
+
+  // Nodes holding free chunks.
+  LockFreeStack<FreeNode> chunks_;
+  // Nodes not holding a chunk, one for each chunk in use.
+  LockFreeStack<FreeNode> spareNodes_;
+
+  alignas(kCacheLineSize) std::atomic<size_t> chunksInUse_{0};
+  std::atomic<size_t> peakChunksInUse_{0};
+
+  // Guards slab allocation and release, and the bookkeeping below.
+  alignas(kCacheLineSize) mutable std::mutex slabMutex_;
   std::vector<char*> backingAllocs_;
+  std::vector<FreeNode*> nodeBlocks_;
+  size_t peakBackingAllocs_ = 0;
+};
+
+/**
+ * A PoolAllocator with a thread-cached front end.  Each thread allocates from, and deallocates to,
+ * a small magazine of chunks, which is refilled from and flushed to a central PoolAllocator in
+ * batches.  Magazines are picked by thread ID from a fixed set sized for the machine, so each is
+ * normally touched by only one thread, and its lock is uncontended; the central free list is
+ * touched only once per batch.  Chunks may be deallocated on a different thread than they were
+ * allocated on.
+ **/
+class CachingPoolAllocator {
+ public:
+  /**
+   * Construct a CachingPoolAllocator.
+   *
+   * @param chunkSize The chunk size for each pool allocation
+   * @param allocSize The size of underlying slabs to be chunked
+   * @param allocFunc The underlying allocation function for allocating slabs
+   * @param deallocFunc The underlying deallocation function.  Called on trim() and destruction.
+   **/
+  DISPENSO_DLL_ACCESS CachingPoolAllocator(
+      size_t chunkSize,
+      size_t allocSize,
+      std::function<void*(size_t)> allocFunc,
+      std::function<void(void*)> deallocFunc);
+
+  /**
+   * Allocate a chunk, usually from the calling thread's magazine.
+   *
+   * @return The pointer to a buffer of chunkSize bytes
+   **/
+  DISPENSO_DLL_ACCESS char* alloc();
+
+  /**
+   * Deallocate a previously allocated chunk, usually into the calling thread's magazine.
+   *
+   * @param ptr The chunk to return to the available pool
+   **/
+  DISPENSO_DLL_ACCESS void dealloc(char* ptr);
+
+  /**
+   * Return every thread's cached chunks to the central pool, and then release every slab whose
+   * chunks are all free back to deallocFunc, as PoolAllocator::trim.  Concurrency safe.
+   *
+   * @return The number of bytes released.
+   **/
+  DISPENSO_DLL_ACCESS size_t trim();
+
+  /**
+   * Get a snapshot of the allocator's memory usage, including chunks cached in magazines.
+   * Concurrency safe.
+   *
+   * @return The current statistics.
+   **/
+  DISPENSO_DLL_ACCESS PoolAllocatorStats stats() const;
+
+  /**
+   * Destruct a CachingPoolAllocator.  All chunks must have been deallocated, or must no longer be
+   * used.
+   **/
+  DISPENSO_DLL_ACCESS ~CachingPoolAllocator();
+
+ private:
+  static constexpr size_t kMagazineCapacity = 64;
+  static constexpr size_t kBatchSize = kMagazineCapacity / 2;
+
+  struct alignas(kCacheLineSize) Magazine {
+    std::atomic<bool> locked{false};
+    size_t count = 0;
+    char* chunks[kMagazineCapacity];
+  };
+
+  Magazine& lockMagazine(size_t index) const;
 
-  std::vector<char*> chunks_;
+  PoolAllocator central_;
+  size_t magazineMask_;
+  Magazine* magazines_;
 };
 
 } // namespace dispenso
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/rcu.h>
+
+#include <cassert>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dispenso {
+namespace detail {
+
+namespace {
+
+struct Retired {
+  void* ptr;
+  void (*deleter)(void*);
+  // Read sections that began in this epoch or earlier may still refer to ptr.
+  uint64_t epoch;
+};
+
+// Epoch 0 marks a quiescent record, so the global epoch starts at 1.
+std::atomic<uint64_t> g_epoch{1};
+std::atomic<RcuRecord*> g_records{nullptr};
+
+std::mutex& retiredMutex() {
+  static std::mutex mtx;
+  return mtx;
+}
+
+// Versions still retired at exit are destroyed then, when no threads can be reading.
+struct RetiredList : std::vector<Retired> {
+  ~RetiredList() {
+    for (auto& r : *this) {
+      r.deleter(r.ptr);
+    }
+  }
+};
+
+RetiredList& retiredList() {
+  static RetiredList retired;
+  return retired;
+}
+
+// Releases the thread's record for reuse by future threads when the thread exits.
+struct RecordReleaser {
+  ~RecordReleaser() {
+    if (record) {
+      releaseReaderRecord(*record);
+      PerPoolPerThreadInfo::setRcuRecord(nullptr);
+    }
+  }
+  RcuRecord* record = nullptr;
+};
+
+// The oldest epoch any thread is currently reading in, or UINT64_MAX if none are reading.
+uint64_t oldestActiveEpoch() {
+  return oldestReaderEpoch(g_records);
+}
+
+// Destroy retired versions from before the given epoch.
+void reclaimBefore(uint64_t epoch) {
+  std::vector<Retired> toFree;
+  {
+    std::lock_guard<std::mutex> lk(retiredMutex());
+    auto& retired = retiredList();
+    auto keep = retired.begin();
+    for (auto& r : retired) {
+      if (r.epoch < epoch) {
+        toFree.push_back(r);
+      } else {
+        *keep++ = r;
+      }
+    }
+    retired.erase(keep, retired.end());
+  }
+  for (auto& r : toFree) {
+    r.deleter(r.ptr);
+  }
+}
+
+} // namespace
+
+RcuRecord& registerRcuThread() {
+  static thread_local RecordReleaser releaser;
+  // Records are never freed, since writers may be scanning the list at any time.
+  RcuRecord* record = acquireReaderRecord(g_records);
+  record->globalEpoch = &g_epoch;
+  releaser.record = record;
+  PerPoolPerThreadInfo::setRcuRecord(record);
+  return *record;
+}
+
+void rcuRetire(void* ptr, void (*deleter)(void*)) {
+  // Readers that may have seen ptr began their read section in this epoch or earlier.
+  uint64_t epoch = g_epoch.fetch_add(1, std::memory_order_seq_cst);
+  {
+    std::lock_guard<std::mutex> lk(retiredMutex());
+    retiredList().push_back({ptr, deleter, epoch});
+  }
+  reclaimBefore(oldestActiveEpoch());
+}
+
+} // namespace detail
+
+void rcuSynchronize() {
+  assert(
+      (!detail::PerPoolPerThreadInfo::rcuRecord() || !detail::rcuRecord().nesting) &&
+      "rcuSynchronize must not be called from inside a read section");
+  uint64_t epoch = detail::g_epoch.fetch_add(1, std::memory_order_seq_cst);
+  // Wait for read sections that began in or before the epoch to finish.
+  while (detail::oldestActiveEpoch() <= epoch) {
+    std::this_thread::yield();
+  }
+  detail::reclaimBefore(epoch + 1);
+}
+
+} // namespace dispenso
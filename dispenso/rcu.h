@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file rcu.h
+ * A file providing RcuPtr, a read-copy-update pointer for read-mostly shared data.  Readers are
+ * wait-free: a read section only publishes the reading thread's epoch in a per-thread record.
+ * Writers publish a new version with a single pointer swap, and retired versions are destroyed once
+ * every thread that might still be reading them has left its read section.
+ **/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include <dispenso/detail/per_thread_info.h>
+#include <dispenso/detail/reader_records.h>
+#include <dispenso/platform.h>
+
+namespace dispenso {
+namespace detail {
+
+struct RcuRecord : ReaderRecord<RcuRecord> {
+  std::atomic<uint64_t>* globalEpoch;
+};
+
+DISPENSO_DLL_ACCESS RcuRecord& registerRcuThread();
+DISPENSO_DLL_ACCESS void rcuRetire(void* ptr, void (*deleter)(void*));
+
+inline RcuRecord& rcuRecord() {
+  void* record = PerPoolPerThreadInfo::rcuRecord();
+  return record ? *static_cast<RcuRecord*>(record) : registerRcuThread();
+}
+
+inline void rcuReadLock(RcuRecord& record) {
+  if (record.nesting++ == 0) {
+    record.epoch.store(
+        record.globalEpoch->load(std::memory_order_acquire), std::memory_order_relaxed);
+    // Pairs with the writer's swap and epoch bump: either the writer's scan sees this epoch, or
+    // this thread's subsequent reads see the new version.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  }
+}
+
+inline void rcuReadUnlock(RcuRecord& record) {
+  if (--record.nesting == 0) {
+    record.epoch.store(0, std::memory_order_release);
+  }
+}
+
+} // namespace detail
+
+/**
+ * Wait until every read section in progress on any thread has finished, and then destroy all
+ * versions retired before the call.  Retired versions are otherwise destroyed opportunistically as
+ * later versions are retired, so this may be used to reclaim memory promptly.  Must not be called
+ * from inside a read section.
+ **/
+DISPENSO_DLL_ACCESS void rcuSynchronize();
+
+/**
+ * A pointer to a shared, immutable version of T that readers access wait-free, and that writers
+ * replace wholesale.  Suited to read-mostly data such as configuration or routing tables, where
+ * copying the data to update it is acceptable.
+ *
+ * @tparam T The pointee type.  Readers only get const access.
+ **/
+template <typename T>
+class RcuPtr {
+ public:
+  /**
+   * An RAII read section.  While it is alive, the version it refers to will not be destroyed.  Read
+   * sections may nest, and must be ended on the thread that began them.
+   **/
+  class ReadGuard {
+   public:
+    ReadGuard(ReadGuard&& other) : record_(other.record_), ptr_(other.ptr_) {
+      other.record_ = nullptr;
+    }
+
+    ReadGuard(const ReadGuard&) = delete;
+    ReadGuard& operator=(const ReadGuard&) = delete;
+    ReadGuard& operator=(ReadGuard&&) = delete;
+
+    ~ReadGuard() {
+      if (record_) {
+        detail::rcuReadUnlock(*record_);
+      }
+    }
+
+    /**
+     * Get the version read.
+     *
+     * @return A pointer to the version, or nullptr if the RcuPtr was empty.
+     **/
+    const T* get() const {
+      return ptr_;
+    }
+
+    const T& operator*() const {
+      return *ptr_;
+    }
+
+    const T* operator->() const {
+      return ptr_;
+    }
+
+    explicit operator bool() const {
+      return ptr_ != nullptr;
+    }
+
+   private:
+    ReadGuard(detail::RcuRecord& record, const std::atomic<T*>& ptr) : record_(&record) {
+      detail::rcuReadLock(record);
+      ptr_ = ptr.load(std::memory_order_acquire);
+    }
+
+    detail::RcuRecord* record_;
+    const T* ptr_;
+
+    friend class RcuPtr<T>;
+  };
+
+  /**
+   * Construct an RcuPtr.
+   *
+   * @param initial The initial version, which may be null.
+   **/
+  explicit RcuPtr(std::unique_ptr<T> initial = nullptr) : ptr_(initial.release()) {}
+
+  RcuPtr(const RcuPtr&) = delete;
+  RcuPtr& operator=(const RcuPtr&) = delete;
+
+  /**
+   * Begin a read section on the current version.  Wait-free.
+   *
+   * @return A guard giving access to the current version until it is destroyed.
+   **/
+  ReadGuard read() const {
+    return ReadGuard(detail::rcuRecord(), ptr_);
+  }
+
+  /**
+   * Publish a new version.  The previous version is retired, and destroyed once all read sections
+   * that might refer to it have finished.  Concurrency safe, including with other updates.
+   *
+   * @param value The new version, which may be null.
+   **/
+  void update(std::unique_ptr<T> value) {
+    T* old = ptr_.exchange(value.release(), std::memory_order_seq_cst);
+    if (old) {
+      detail::rcuRetire(old, [](void* p) { delete static_cast<T*>(p); });
+    }
+  }
+
+  /**
+   * Destroy the RcuPtr and its current version.  There must be no read sections in progress on
+   * this RcuPtr.  Previously retired versions are still reclaimed as usual.
+   **/
+  ~RcuPtr() {
+    delete ptr_.load(std::memory_order_acquire);
+  }
+
+ private:
+  std::atomic<T*> ptr_;
+};
+
+} // namespace dispenso
@@ -8,13 +8,27 @@
 /**
  * @file resource_pool.h
  * A file providing ResourcePool.  This is syntactic sugar over what is essentially a set of
- * semaphore guarded resources.
+ * semaphore guarded resources.  Optionally, each thread caches a few released resources so that
+ * acquiring and releasing from the same thread avoids the shared queue, and resources can be
+ * created lazily on demand and destroyed again once idle.
  **/
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
 #include <blockingconcurrentqueue.h>
+#include <dispenso/detail/math.h>
 #include <dispenso/platform.h>
+#include <dispenso/thread_id.h>
 #include <dispenso/tsan_annotations.h>
 
 namespace dispenso {
@@ -44,7 +58,7 @@ class Resource {
   }
 
   /**
-   * Access the underlying resource object.
+   * Access the underlying resource object.  Must only be called on a valid Resource.
    *
    * @return a reference to the resource.
    **/
@@ -52,6 +66,16 @@ class Resource {
     return *resource_;
   }
 
+  /**
+   * Check whether this Resource holds a resource.  Resources returned by <code>tryAcquire</code>
+   * and <code>acquireFor</code> may be empty, as are moved-from Resources.
+   *
+   * @return true if the Resource holds a resource.
+   **/
+  bool valid() const {
+    return resource_ != nullptr;
+  }
+
   ~Resource() {
     recycle();
   }
@@ -67,6 +91,30 @@ class Resource {
   friend class ResourcePool<T>;
 };
 
+/**
+ * Options for constructing a ResourcePool.
+ **/
+struct ResourcePoolOptions {
+  /**
+   * The maximum number of resources cached per thread, clamped to
+   * <code>ResourcePool::kMaxThreadCacheSize</code>.  Zero disables caching.
+   **/
+  size_t threadCacheSize = 0;
+
+  /**
+   * Specify whether resources should be created on demand.  If true, the constructor creates no
+   * resources, and acquiring from a pool with none available creates a new one while fewer than
+   * the pool's size exist.
+   **/
+  bool lazy = false;
+
+  /**
+   * For lazy pools, resources left unused in the pool for longer than this are destroyed, and are
+   * recreated if demand returns.  Zero keeps resources until the pool is destroyed.
+   **/
+  std::chrono::milliseconds idleTimeout{0};
+};
+
 /**
  * A pool of resources that can be accessed from multiple threads.  This is akin to a set of
  * resources and a semaphore ensuring enough resources exist.
@@ -83,23 +131,42 @@ class ResourcePool {
    **/
   template <typename F>
   ResourcePool(size_t size, const F& init)
-      : pool_(size),
-        backingResources_(reinterpret_cast<char*>(
-            detail::alignedMalloc(size * detail::alignToCacheLine(sizeof(T))))),
-        size_(size) {
-    char* buf = backingResources_;
+      : ResourcePool(size, init, ResourcePoolOptions(), std::false_type()) {}
 
-    // There are three reasons we create our own buffer and use placement new:
-    // 1. We want to be able to handle non-movable non-copyable objects
-    //   * Note that we could do this with std::deque
-    // 2. We want to minimize memory allocations, since that can be a common point of contention in
-    //    multithreaded programs.
-    // 3. We can easily ensure that the objects are cache aligned to help avoid false sharing.
+  /**
+   * Construct a ResourcePool with per-thread caching.  Equivalent to passing ResourcePoolOptions
+   * with only threadCacheSize set.  Released resources are kept in a small
+   * cache for the releasing thread (up to threadCacheSize of them), and acquire checks that cache
+   * before the shared queue.  This helps when threads repeatedly acquire and release, e.g. scratch
+   * buffers inside parallel_for bodies.  Cached resources are taken by other threads when the
+   * shared queue runs dry, so caching never causes a waiter to starve.
+   *
+   * @param size The number of <code>T</code> objects in the pool.
+   * @param init A functor with signature T() which can be called to initialize the pool's
+   * resources.
+   * @param threadCacheSize The maximum number of resources cached per thread, clamped to
+   * kMaxThreadCacheSize.  Zero disables caching.
+   **/
+  template <typename F>
+  ResourcePool(size_t size, const F& init, size_t threadCacheSize)
+      : ResourcePool(size, init, cacheOptions(threadCacheSize), std::false_type()) {}
 
-    for (size_t i = 0; i < size; ++i) {
-      pool_.enqueue(new (buf) T(init()));
-      buf += detail::alignToCacheLine(sizeof(T));
-    }
+  /**
+   * Construct a ResourcePool with the given options.
+   *
+   * @param size The maximum number of <code>T</code> objects in the pool.
+   * @param init A functor with signature T() which can be called to initialize the pool's
+   * resources.  For lazy pools, it is copied, kept, and called concurrently as resources are
+   * needed, so <code>init</code> must be copyable.  A move-only <code>init</code> can be used with
+   * the constructors that take no options.
+   * @param options Options controlling caching and lazy creation.  See ResourcePoolOptions.
+   **/
+  template <typename F>
+  ResourcePool(size_t size, const F& init, const ResourcePoolOptions& options)
+      : ResourcePool(size, init, options, std::is_copy_constructible<F>()) {
+    static_assert(
+        std::is_copy_constructible<F>::value,
+        "Lazy ResourcePools keep a copy of init, so init must be copyable when options are given");
   }
 
   /**
@@ -108,39 +175,373 @@ class ResourcePool {
    * @return a <code>Resource</code>-wrapped resource.
    **/
   Resource<T> acquire() {
-    T* t;
-    pool_.wait_dequeue(t);
+    T* t = tryTakeOrGrow();
+    if (!t) {
+      t = waitTake([this](T*& out) {
+        pool_.wait_dequeue(out);
+        return true;
+      });
+    }
+    return Resource<T>(t, this);
+  }
+
+  /**
+   * Acquire a resource from the pool if one is immediately available.
+   *
+   * @return a <code>Resource</code>-wrapped resource, which is not valid() if none was available.
+   **/
+  Resource<T> tryAcquire() {
+    return Resource<T>(tryTakeOrGrow(), this);
+  }
+
+  /**
+   * Acquire a resource from the pool, blocking for at most the given duration.
+   *
+   * @param timeout The maximum time to wait for a resource to become available.
+   * @return a <code>Resource</code>-wrapped resource, which is not valid() if the wait timed out.
+   **/
+  template <class Rep, class Period>
+  Resource<T> acquireFor(const std::chrono::duration<Rep, Period>& timeout) {
+    T* t = tryTakeOrGrow();
+    if (!t) {
+      t = waitTake([this, &timeout](T*& out) { return pool_.wait_dequeue_timed(out, timeout); });
+    }
     return Resource<T>(t, this);
   }
 
+  /**
+   * Destroy resources that have been idle in the pool for longer than the idleTimeout option.
+   * This runs automatically as resources are released, at most once per idleTimeout, but may also
+   * be called explicitly.  A no-op for pools that are not lazy or have no idle timeout.
+   *
+   * @return The number of resources destroyed.
+   **/
+  size_t evictIdle() {
+    if (idleTimeoutNs_ <= 0) {
+      return 0;
+    }
+    std::lock_guard<std::mutex> lk(growMutex_);
+    return evictIdleLocked(nowNs());
+  }
+
+  /**
+   * Get the number of resources that currently exist, whether in the pool or acquired.
+   *
+   * @return The number of live resources.  For pools that are not lazy, this is always the size.
+   **/
+  size_t numLive() const {
+    return live_.load(std::memory_order_relaxed);
+  }
+
   /**
    * Destruct the ResourcePool.  The user must ensure that all resources are returned to the pool
    * prior to destroying the pool.
    **/
   ~ResourcePool() {
-    assert(pool_.size_approx() == size_);
-    for (size_t i = 0; i < size_; ++i) {
+    size_t remaining = live_.load(std::memory_order_relaxed);
+    for (size_t i = 0; cacheSize_ && i <= cacheMask_; ++i) {
+      ThreadCache& cache = caches_[i];
+      for (size_t j = 0; j < cache.count; ++j) {
+        cache.items[j]->~T();
+      }
+      remaining -= cache.count;
+      cache.~ThreadCache();
+    }
+    assert(pool_.size_approx() == remaining);
+    for (size_t i = 0; i < remaining; ++i) {
       T* t;
       pool_.wait_dequeue(t);
       t->~T();
     }
+    detail::alignedFree(caches_);
     detail::alignedFree(backingResources_);
   }
 
+  static constexpr size_t kMaxThreadCacheSize = 8;
+
  private:
-  void recycle(T* t) {
+  static constexpr size_t kStride = detail::alignToCacheLine(sizeof(T));
+
+  static ResourcePoolOptions cacheOptions(size_t threadCacheSize) {
+    ResourcePoolOptions options;
+    options.threadCacheSize = threadCacheSize;
+    return options;
+  }
+
+  // Only lazy pools keep init, so only a pool that may be lazy requires it to be copyable.
+  template <typename F, bool kMayBeLazy>
+  ResourcePool(
+      size_t size,
+      const F& init,
+      const ResourcePoolOptions& options,
+      std::integral_constant<bool, kMayBeLazy> mayBeLazy)
+      : pool_(size),
+        backingResources_(reinterpret_cast<char*>(detail::alignedMalloc(size * kStride))),
+        size_(size),
+        cacheSize_(std::min(options.threadCacheSize, kMaxThreadCacheSize)),
+        live_(options.lazy ? 0 : size),
+        idleTimeoutNs_(options.lazy ? options.idleTimeout.count() * 1000000 : 0) {
+    if (cacheSize_) {
+      // Twice as many caches as hardware threads keeps collisions between threads rare.
+      cacheMask_ = static_cast<size_t>(
+          detail::nextPow2(2 * std::max<size_t>(1, std::thread::hardware_concurrency())) - 1);
+      caches_ = reinterpret_cast<ThreadCache*>(
+          detail::alignedMalloc((cacheMask_ + 1) * sizeof(ThreadCache), alignof(ThreadCache)));
+      for (size_t i = 0; i <= cacheMask_; ++i) {
+        new (&caches_[i]) ThreadCache();
+      }
+    }
+    if (options.lazy) {
+      setLazyInit(init, mayBeLazy);
+      if (idleTimeoutNs_ > 0) {
+        lastUsed_.reset(new std::atomic<int64_t>[size]());
+        lastEvictionNs_.store(nowNs(), std::memory_order_relaxed);
+      }
+      return;
+    }
+
+    char* buf = backingResources_;
+
+    // There are three reasons we create our own buffer and use placement new:
+    // 1. We want to be able to handle non-movable non-copyable objects
+    //   * Note that we could do this with std::deque
+    // 2. We want to minimize memory allocations, since that can be a common point of contention in
+    //    multithreaded programs.
+    // 3. We can easily ensure that the objects are cache aligned to help avoid false sharing.
+
+    for (size_t i = 0; i < size; ++i) {
+      pool_.enqueue(new (buf) T(init()));
+      buf += kStride;
+    }
+  }
+
+  template <typename F>
+  void setLazyInit(const F& init, std::true_type) {
+    init_ = init;
+  }
+  template <typename F>
+  void setLazyInit(const F&, std::false_type) {}
+
+  static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  size_t slotIndex(T* t) const {
+    return static_cast<size_t>(reinterpret_cast<char*>(t) - backingResources_) / kStride;
+  }
+
+  T* tryTakeOrGrow() {
+    T* t = tryTake();
+    if (!t && init_) {
+      t = tryGrow();
+    }
+    return t;
+  }
+
+  // Create a new resource if fewer than size_ exist.  Only the slot is claimed under the lock, so
+  // that slow resource creation doesn't serialize.
+  T* tryGrow() {
+    size_t slot;
+    {
+      std::lock_guard<std::mutex> lk(growMutex_);
+      // An eviction pass may have just returned resources to the queue.
+      T* t;
+      if (pool_.try_dequeue(t)) {
+        return t;
+      }
+      if (live_.load(std::memory_order_relaxed) == size_) {
+        return nullptr;
+      }
+      live_.fetch_add(1, std::memory_order_relaxed);
+      if (freeSlots_.empty()) {
+        slot = nextSlot_++;
+      } else {
+        slot = freeSlots_.back();
+        freeSlots_.pop_back();
+      }
+    }
+#if defined(__cpp_exceptions)
+    try {
+      return new (backingResources_ + slot * kStride) T(init_());
+    } catch (...) {
+      std::lock_guard<std::mutex> lk(growMutex_);
+      freeSlots_.push_back(slot);
+      live_.fetch_sub(1, std::memory_order_relaxed);
+      throw;
+    }
+#else
+    return new (backingResources_ + slot * kStride) T(init_());
+#endif // __cpp_exceptions
+  }
+
+  size_t evictIdleLocked(int64_t now) {
+    lastEvictionNs_.store(now, std::memory_order_relaxed);
+    for (size_t i = 0; cacheSize_ && i <= cacheMask_; ++i) {
+      flushCache(i);
+    }
+    std::vector<T*> idle;
+    T* t;
+    while (pool_.try_dequeue(t)) {
+      idle.push_back(t);
+    }
+    // A waiter may have registered after failing to find these resources.  Evicting now could
+    // leave it blocked with no resource due back, so only evict with no waiters; a waiter that
+    // registers later tries to grow, which it can only do once this pass releases the lock.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool canEvict = !waiters_.load(std::memory_order_relaxed);
+    size_t evicted = 0;
+    for (T* r : idle) {
+      size_t slot = slotIndex(r);
+      if (canEvict && now - lastUsed_[slot].load(std::memory_order_relaxed) >= idleTimeoutNs_) {
+        r->~T();
+        freeSlots_.push_back(slot);
+        live_.fetch_sub(1, std::memory_order_relaxed);
+        ++evicted;
+      } else {
+        enqueue(r);
+      }
+    }
+    return evicted;
+  }
+
+  void maybeEvictIdle(int64_t now) {
+    if (now - lastEvictionNs_.load(std::memory_order_relaxed) < idleTimeoutNs_) {
+      return;
+    }
+    std::unique_lock<std::mutex> lk(growMutex_, std::try_to_lock);
+    if (lk.owns_lock()) {
+      evictIdleLocked(now);
+    }
+  }
+
+  struct alignas(kCacheLineSize) ThreadCache {
+    std::atomic<bool> locked{false};
+    size_t count = 0;
+    T* items[kMaxThreadCacheSize];
+  };
+
+  ThreadCache& lockCache(size_t index) {
+    ThreadCache& cache = caches_[index];
+    while (cache.locked.exchange(true, std::memory_order_acquire)) {
+      std::this_thread::yield();
+    }
+    return cache;
+  }
+
+  size_t localCache() const {
+    return static_cast<size_t>(threadId()) & cacheMask_;
+  }
+
+  T* takeFromCache(size_t index) {
+    ThreadCache& cache = lockCache(index);
+    T* t = cache.count ? cache.items[--cache.count] : nullptr;
+    cache.locked.store(false, std::memory_order_release);
+    return t;
+  }
+
+  // Move everything in a cache to the shared queue, so that blocked acquirers can get it.
+  void flushCache(size_t index) {
+    ThreadCache& cache = lockCache(index);
+    for (size_t i = 0; i < cache.count; ++i) {
+      enqueue(cache.items[i]);
+    }
+    cache.count = 0;
+    cache.locked.store(false, std::memory_order_release);
+  }
+
+  // Take a resource from this thread's cache, then the shared queue, then other threads' caches.
+  T* tryTake() {
+    const size_t local = cacheSize_ ? localCache() : 0;
+    T* t;
+    if (cacheSize_ && (t = takeFromCache(local))) {
+      return t;
+    }
+    if (pool_.try_dequeue(t)) {
+      return t;
+    }
+    for (size_t i = 1; cacheSize_ && i <= cacheMask_; ++i) {
+      if ((t = takeFromCache((local + i) & cacheMask_))) {
+        return t;
+      }
+    }
+    return nullptr;
+  }
+
+  // Waiters register before their final scan of the caches, and caching releasers check for
+  // waiters after filling a cache.  The fences ensure at least one of them sees the other: either
+  // the waiter finds the cached resource, or the releaser flushes it to the shared queue.
+  template <typename Wait>
+  T* waitTake(Wait wait) {
+    waiters_.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    T* t = tryTakeOrGrow();
+    if (!t && !wait(t)) {
+      t = nullptr;
+    }
+    waiters_.fetch_sub(1, std::memory_order_relaxed);
+    return t;
+  }
+
+  void enqueue(T* t) {
     DISPENSO_TSAN_ANNOTATE_IGNORE_WRITES_BEGIN();
     pool_.enqueue(t);
     DISPENSO_TSAN_ANNOTATE_IGNORE_WRITES_END();
   }
 
+  void recycle(T* t) {
+    if (idleTimeoutNs_ > 0) {
+      int64_t now = nowNs();
+      lastUsed_[slotIndex(t)].store(now, std::memory_order_relaxed);
+      maybeEvictIdle(now);
+    }
+    if (cacheSize_ && !waiters_.load(std::memory_order_relaxed)) {
+      size_t local = localCache();
+      ThreadCache& cache = lockCache(local);
+      bool cached = cache.count < cacheSize_;
+      if (cached) {
+        cache.items[cache.count++] = t;
+      }
+      cache.locked.store(false, std::memory_order_release);
+      if (cached) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters_.load(std::memory_order_relaxed)) {
+          flushCache(local);
+        }
+        return;
+      }
+    }
+    enqueue(t);
+  }
+
   moodycamel::BlockingConcurrentQueue<T*> pool_;
   char* backingResources_;
   size_t size_;
+  const size_t cacheSize_;
+  size_t cacheMask_ = 0;
+  ThreadCache* caches_ = nullptr;
+  std::atomic<size_t> waiters_{0};
+
+  // Lazy pools only.
+  std::function<T()> init_;
+  std::atomic<size_t> live_;
+  const int64_t idleTimeoutNs_;
+  std::unique_ptr<std::atomic<int64_t>[]> lastUsed_;
+  std::atomic<int64_t> lastEvictionNs_{0};
+  // Guards slot bookkeeping and eviction.
+  std::mutex growMutex_;
+  std::vector<size_t> freeSlots_;
+  size_t nextSlot_ = 0;
 
   friend class Resource<T>;
 };
 
+template <typename T>
+constexpr size_t ResourcePool<T>::kMaxThreadCacheSize;
+template <typename T>
+constexpr size_t ResourcePool<T>::kStride;
+
 template <typename T>
 void Resource<T>::recycle() {
   if (resource_) {
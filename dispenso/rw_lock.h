@@ -98,4 +98,29 @@ class alignas(kCacheLineSize) RWLock : public detail::RWLockImpl {
  **/
 class UnalignedRWLock : public detail::RWLockImpl {};
 
+/**
+ * A reader/writer lock for read-mostly data accessed by many threads, with the same interface as
+ * RWLock.  Where RWLock counts readers in a single atomic word, whose cache line bounces between
+ * cores as readers come and go, DistributedRWLock gives readers a set of cache-line padded slots
+ * picked by thread ID.  An uncontended reader therefore writes only a cache line of its own, and
+ * read throughput scales with the number of threads.  The tradeoffs are that writers must scan
+ * every slot, so write locking is slower, and that each lock occupies a cache line per slot (twice
+ * the hardware concurrency, rounded up to a power of two).  Prefer RWLock unless profiling shows
+ * readers contending on it.
+ *
+ * Locking and unlocking for read must happen on the same thread.  As with RWLock, waiting never
+ * goes to the OS, and the notes on lock_upgrade apply.
+ **/
+class alignas(kCacheLineSize) DistributedRWLock : public detail::DistributedRWLockImpl {
+ public:
+  using detail::DistributedRWLockImpl::lock;
+  using detail::DistributedRWLockImpl::try_lock;
+  using detail::DistributedRWLockImpl::unlock;
+  using detail::DistributedRWLockImpl::lock_shared;
+  using detail::DistributedRWLockImpl::try_lock_shared;
+  using detail::DistributedRWLockImpl::unlock_shared;
+  using detail::DistributedRWLockImpl::lock_upgrade;
+  using detail::DistributedRWLockImpl::lock_downgrade;
+};
+
 } // namespace dispenso
@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file semaphore.h
+ * A file providing Semaphore, a counting semaphore with timed waits, similar to
+ * std::counting_semaphore.
+ **/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <dispenso/detail/semaphore_impl.h>
+#include <dispenso/platform.h>
+
+namespace dispenso {
+
+/**
+ * A counting semaphore.  Acquirers spin briefly before sleeping in the OS (on a futex on Linux, via
+ * WaitOnAddress on Windows, and on a condition variable elsewhere), and releasers only make a
+ * system call when a thread is actually asleep, so uncontended and briefly contended use never
+ * enters the kernel.
+ **/
+class Semaphore {
+ public:
+  /**
+   * Construct a Semaphore.
+   *
+   * @param initial The number of permits initially available.  Must be non-negative.
+   **/
+  explicit Semaphore(int initial = 0) : count_(initial) {}
+
+  Semaphore(const Semaphore&) = delete;
+  Semaphore& operator=(const Semaphore&) = delete;
+
+  /**
+   * Make permits available, waking sleeping acquirers as needed.
+   *
+   * @param n The number of permits to release.
+   **/
+  void release(int n = 1) {
+    count_.fetch_add(n, std::memory_order_release);
+    // Pairs with the fence in sleep: either a sleeper is seen here, or it sees the new permits.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int sleepers = sleepers_.load(std::memory_order_relaxed);
+    if (sleepers) {
+      waiter_.wake(count_, std::min(n, sleepers));
+    }
+  }
+
+  /**
+   * Take a permit if one is available, without waiting.
+   *
+   * @return true if a permit was taken.
+   **/
+  bool tryAcquire() {
+    int cur = count_.load(std::memory_order_relaxed);
+    while (cur > 0) {
+      if (count_.compare_exchange_weak(
+              cur, cur - 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * Take a permit, waiting until one is available.
+   **/
+  void acquire() {
+    if (spinAcquire()) {
+      return;
+    }
+    while (!sleep(-1.0)) {
+    }
+  }
+
+  /**
+   * Take a permit, waiting until one is available or the relative timeout expires, whichever is
+   * first.
+   *
+   * @return true if a permit was taken, false if timed out.
+   **/
+  template <class Rep, class Period>
+  bool tryAcquireFor(const std::chrono::duration<Rep, Period>& relTime) {
+    return tryAcquireUntil(std::chrono::steady_clock::now() + relTime);
+  }
+
+  /**
+   * Take a permit, waiting until one is available or the absolute timeout expires, whichever is
+   * first.
+   *
+   * @return true if a permit was taken, false if timed out.
+   **/
+  template <class Clock, class Duration>
+  bool tryAcquireUntil(const std::chrono::time_point<Clock, Duration>& absTime) {
+    if (spinAcquire()) {
+      return true;
+    }
+    while (true) {
+      double relSeconds = std::chrono::duration<double>(absTime - Clock::now()).count();
+      if (relSeconds <= 0.0) {
+        return tryAcquire();
+      }
+      if (sleep(relSeconds)) {
+        return true;
+      }
+    }
+  }
+
+  /**
+   * Get the number of permits currently available.  Only a snapshot under concurrency.
+   *
+   * @return The number of available permits.
+   **/
+  int available() const {
+    return count_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  static constexpr int kSpinsBeforeYield = 32;
+  static constexpr int kYieldsBeforeSleep = 32;
+
+  bool spinAcquire() {
+    for (int i = 0; i < kSpinsBeforeYield; ++i) {
+      if (tryAcquire()) {
+        return true;
+      }
+      detail::cpuRelax();
+    }
+    // Yielding lets a releaser sharing this core run, which is far cheaper than a sleep and wake.
+    for (int i = 0; i < kYieldsBeforeSleep; ++i) {
+      if (tryAcquire()) {
+        return true;
+      }
+      std::this_thread::yield();
+    }
+    return false;
+  }
+
+  // Register as a sleeper and sleep while no permits are available.  Returns true if a permit was
+  // taken; false on wakeup or timeout without one.
+  bool sleep(double relSeconds) {
+    sleepers_.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool acquired = tryAcquire();
+    if (!acquired) {
+      waiter_.wait(count_, 0, relSeconds);
+      acquired = tryAcquire();
+    }
+    sleepers_.fetch_sub(1, std::memory_order_relaxed);
+    return acquired;
+  }
+
+  alignas(kCacheLineSize) std::atomic<int> count_;
+  std::atomic<int> sleepers_{0};
+  detail::AddressWaiter waiter_;
+};
+
+} // namespace dispenso
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file seq_lock.h
+ * A file providing SeqLock, a sequence lock for small, trivially copyable data that is read far
+ * more often than it is written.  Readers never write shared memory; they copy the data and retry
+ * if a writer was active meanwhile.
+ **/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include <dispenso/platform.h>
+
+namespace dispenso {
+
+/**
+ * A sequence lock.  Writers bump a sequence number to odd, write, and bump it back to even, and
+ * readers copy the data between two reads of the sequence number, retrying if it changed.  Reads
+ * are therefore cheap and scale perfectly across threads, but may retry while a write is in
+ * progress, so SeqLock suits small values (a few cache lines at most) that change rarely.
+ *
+ * The value is stored as relaxed atomic words, so concurrent reads and writes are well defined
+ * (and clean under TSAN) rather than relying on a benign data race.
+ *
+ * @tparam T The value type.  Must be trivially copyable and default constructible.
+ **/
+template <typename T>
+class SeqLock {
+  static_assert(std::is_trivially_copyable<T>::value, "SeqLock requires trivially copyable T");
+
+ public:
+  /**
+   * Construct a SeqLock.
+   *
+   * @param value The initial value.
+   **/
+  explicit SeqLock(const T& value = T()) {
+    uint64_t words[kNumWords] = {};
+    std::memcpy(words, &value, sizeof(T));
+    for (size_t i = 0; i < kNumWords; ++i) {
+      words_[i].store(words[i], std::memory_order_relaxed);
+    }
+  }
+
+  SeqLock(const SeqLock&) = delete;
+  SeqLock& operator=(const SeqLock&) = delete;
+
+  /**
+   * Read the value.  Concurrency safe, and never blocks writers.
+   *
+   * @return A consistent copy of the most recently stored value.
+   **/
+  T load() const {
+    uint64_t words[kNumWords];
+    while (true) {
+      size_t seq = seq_.load(std::memory_order_acquire);
+      if (seq & 1) {
+        detail::cpuRelax();
+        continue;
+      }
+      for (size_t i = 0; i < kNumWords; ++i) {
+        words[i] = words_[i].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (seq_.load(std::memory_order_relaxed) == seq) {
+        break;
+      }
+    }
+    T value;
+    std::memcpy(&value, words, sizeof(T));
+    return value;
+  }
+
+  /**
+   * Replace the value.  Concurrency safe; concurrent writers are serialized.
+   *
+   * @param value The new value.
+   **/
+  void store(const T& value) {
+    uint64_t words[kNumWords] = {};
+    std::memcpy(words, &value, sizeof(T));
+    size_t seq = lockWrite();
+    writeWords(words);
+    seq_.store(seq + 2, std::memory_order_release);
+  }
+
+  /**
+   * Modify the value in place.  Concurrency safe; concurrent writers are serialized.  Readers spin
+   * while <code>f</code> runs, so it should be short.
+   *
+   * @param f A functor with signature void(T&) that is passed a copy of the current value, and
+   * whose modifications are published once it returns.
+   **/
+  template <typename F>
+  void update(F&& f) {
+    size_t seq = lockWrite();
+    uint64_t words[kNumWords];
+    for (size_t i = 0; i < kNumWords; ++i) {
+      words[i] = words_[i].load(std::memory_order_relaxed);
+    }
+    T value;
+    std::memcpy(&value, words, sizeof(T));
+    f(value);
+    std::memcpy(words, &value, sizeof(T));
+    writeWords(words);
+    seq_.store(seq + 2, std::memory_order_release);
+  }
+
+ private:
+  static constexpr size_t kNumWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+  // Returns the even sequence number from before the write.
+  size_t lockWrite() {
+    size_t seq = seq_.load(std::memory_order_relaxed);
+    while ((seq & 1) || !seq_.compare_exchange_weak(seq, seq + 1, std::memory_order_acquire)) {
+      detail::cpuRelax();
+      seq = seq_.load(std::memory_order_relaxed);
+    }
+    // Keep the data writes from being reordered before the odd sequence number.
+    std::atomic_thread_fence(std::memory_order_release);
+    return seq;
+  }
+
+  void writeWords(const uint64_t* words) {
+    for (size_t i = 0; i < kNumWords; ++i) {
+      words_[i].store(words[i], std::memory_order_relaxed);
+    }
+  }
+
+  alignas(kCacheLineSize) std::atomic<size_t> seq_{0};
+  std::atomic<uint64_t> words_[kNumWords];
+};
+
+template <typename T>
+constexpr size_t SeqLock<T>::kNumWords;
+
+} // namespace dispenso
@@ -0,0 +1,391 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/shared_task_queue.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#include <dispenso/detail/math.h>
+#include <dispenso/detail/notifier_common.h>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // _WIN32
+
+namespace dispenso {
+
+constexpr size_t SharedTaskQueue::kDefaultCapacity;
+constexpr std::chrono::microseconds SharedTaskWorker::kIdleWait;
+
+// Other processes may be built separately, so everything in the mapping is plain data and
+// address-free atomics.
+static_assert(
+    ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+    "Shared task queues need lock-free atomics");
+
+namespace detail {
+
+struct SharedTaskQueueHeader {
+  explicit SharedTaskQueueHeader(uint32_t slots)
+      : version(kVersion), capacity(slots), enqueuePos(0), dequeuePos(0), ftx(0), sleepers(0) {}
+
+  static constexpr uint64_t kMagic = 0x6473707175657565; // "dspqueue"
+  static constexpr uint32_t kVersion = 1;
+
+  // Set last by the creating process, so that a half-initialized queue is never used.
+  uint64_t magic = 0;
+  uint32_t version;
+  uint32_t capacity;
+  alignas(kCacheLineSize) std::atomic<uint64_t> enqueuePos;
+  alignas(kCacheLineSize) std::atomic<uint64_t> dequeuePos;
+  // Bumped by every push.  Sleeping consumers wait for it to change, using the same protocol as
+  // detail::EpochWaiter, but with process-shared futex operations.
+  union {
+    alignas(kCacheLineSize) int ftx;
+    std::atomic<uint32_t> epoch;
+  };
+  std::atomic<uint32_t> sleepers;
+};
+
+// A slot of a bounded MPMC queue, after Dmitry Vyukov's design.  A slot at position p may be
+// pushed to when its sequence is p, and popped from when its sequence is p + 1.
+struct SharedTaskQueueCell {
+  std::atomic<uint64_t> sequence;
+  SharedTask task;
+};
+
+static_assert(sizeof(SharedTaskQueueCell) == kCacheLineSize, "Cells should be one line each");
+
+} // namespace detail
+
+namespace {
+using Header = detail::SharedTaskQueueHeader;
+using Cell = detail::SharedTaskQueueCell;
+
+constexpr size_t kHeaderBytes = sizeof(Header);
+
+size_t mappedSize(size_t slots) {
+  return kHeaderBytes + slots * sizeof(Cell);
+}
+
+bool validLayout(const void* data, size_t bytes, uint64_t magic, uint32_t version) {
+  if (bytes < kHeaderBytes) {
+    return false;
+  }
+  uint64_t gotMagic;
+  uint32_t gotVersion;
+  uint32_t slots;
+  std::memcpy(&gotMagic, data, sizeof(gotMagic));
+  std::memcpy(&gotVersion, static_cast<const char*>(data) + sizeof(gotMagic), sizeof(gotVersion));
+  std::memcpy(
+      &slots,
+      static_cast<const char*>(data) + sizeof(gotMagic) + sizeof(gotVersion),
+      sizeof(slots));
+  return gotMagic == magic && gotVersion == version && slots >= 2 && !(slots & (slots - 1)) &&
+      bytes == mappedSize(slots);
+}
+} // namespace
+
+#if defined(_WIN32)
+
+SharedTaskQueue::SharedTaskQueue(const std::string& path, size_t capacity) {
+  HANDLE file = CreateFileA(
+      path.c_str(),
+      GENERIC_READ | GENERIC_WRITE,
+      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+      nullptr,
+      OPEN_ALWAYS,
+      FILE_ATTRIBUTE_NORMAL,
+      nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return;
+  }
+  file_ = file;
+  // The lock serializes creation against other processes opening the same queue.
+  OVERLAPPED overlapped = {};
+  if (!LockFileEx(file, LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD, &overlapped)) {
+    return;
+  }
+  LARGE_INTEGER size;
+  size_t slots = 0;
+  if (GetFileSizeEx(file, &size)) {
+    size_t bytes = static_cast<size_t>(size.QuadPart);
+    if (!bytes) {
+      slots = static_cast<size_t>(detail::nextPow2(std::max<size_t>(capacity, 2)));
+      bytes = mappedSize(slots);
+      LARGE_INTEGER end;
+      end.QuadPart = static_cast<LONGLONG>(bytes);
+      if (!SetFilePointerEx(file, end, nullptr, FILE_BEGIN) || !SetEndOfFile(file)) {
+        bytes = 0;
+      }
+    }
+    mapping_ = bytes ? CreateFileMappingA(file, nullptr, PAGE_READWRITE, 0, 0, nullptr) : nullptr;
+    void* data = mapping_ ? MapViewOfFile(mapping_, FILE_MAP_ALL_ACCESS, 0, 0, 0) : nullptr;
+    if (data && slots) {
+      header_ = new (data) Header(static_cast<uint32_t>(slots));
+    } else if (data && validLayout(data, bytes, Header::kMagic, Header::kVersion)) {
+      header_ = static_cast<Header*>(data);
+    } else if (data) {
+      UnmapViewOfFile(data);
+    }
+    mappedBytes_ = bytes;
+  }
+  if (header_) {
+    cells_ = reinterpret_cast<Cell*>(reinterpret_cast<char*>(header_) + kHeaderBytes);
+    mask_ = header_->capacity - 1;
+    if (slots) {
+      for (size_t i = 0; i < slots; ++i) {
+        new (&cells_[i]) Cell();
+        cells_[i].sequence.store(i, std::memory_order_relaxed);
+      }
+      header_->magic = Header::kMagic;
+    }
+  }
+  UnlockFileEx(file, 0, MAXDWORD, MAXDWORD, &overlapped);
+}
+
+SharedTaskQueue::~SharedTaskQueue() {
+  if (header_) {
+    UnmapViewOfFile(header_);
+  }
+  if (mapping_) {
+    CloseHandle(mapping_);
+  }
+  if (file_) {
+    CloseHandle(file_);
+  }
+}
+
+bool SharedTaskQueue::remove(const std::string& path) {
+  return DeleteFileA(path.c_str()) != 0;
+}
+
+#else
+
+SharedTaskQueue::SharedTaskQueue(const std::string& path, size_t capacity) {
+  int fd = open(path.c_str(), O_RDWR | O_CREAT, 0600);
+  if (fd < 0) {
+    return;
+  }
+  // The lock serializes creation against other processes opening the same queue.
+  if (flock(fd, LOCK_EX) != 0) {
+    close(fd);
+    return;
+  }
+  struct stat st;
+  size_t slots = 0;
+  if (fstat(fd, &st) == 0) {
+    size_t bytes = static_cast<size_t>(st.st_size);
+    if (!bytes) {
+      slots = static_cast<size_t>(detail::nextPow2(std::max<size_t>(capacity, 2)));
+      bytes = mappedSize(slots);
+      if (ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+        bytes = 0;
+      }
+    }
+    void* data =
+        bytes ? mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    if (data != MAP_FAILED && slots) {
+      header_ = new (data) Header(static_cast<uint32_t>(slots));
+    } else if (data != MAP_FAILED && validLayout(data, bytes, Header::kMagic, Header::kVersion)) {
+      header_ = static_cast<Header*>(data);
+    } else if (data != MAP_FAILED) {
+      munmap(data, bytes);
+    }
+    mappedBytes_ = bytes;
+  }
+  if (header_) {
+    cells_ = reinterpret_cast<Cell*>(reinterpret_cast<char*>(header_) + kHeaderBytes);
+    mask_ = header_->capacity - 1;
+    if (slots) {
+      for (size_t i = 0; i < slots; ++i) {
+        new (&cells_[i]) Cell();
+        cells_[i].sequence.store(i, std::memory_order_relaxed);
+      }
+      header_->magic = Header::kMagic;
+    }
+  }
+  // Unlocking publishes the initialized queue to the next process to take the lock.  The mapping
+  // keeps the queue reachable without the descriptor.
+  flock(fd, LOCK_UN);
+  close(fd);
+}
+
+SharedTaskQueue::~SharedTaskQueue() {
+  if (header_) {
+    munmap(header_, mappedBytes_);
+  }
+}
+
+bool SharedTaskQueue::remove(const std::string& path) {
+  return unlink(path.c_str()) == 0;
+}
+
+#endif // _WIN32
+
+bool SharedTaskQueue::tryPush(uint32_t functionId, const void* args, size_t size) {
+  assert(valid());
+  assert(size <= kSharedTaskArgsSize);
+  if (size > kSharedTaskArgsSize) {
+    return false;
+  }
+  uint64_t pos = header_->enqueuePos.load(std::memory_order_relaxed);
+  Cell* cell;
+  while (true) {
+    cell = &cells_[pos & mask_];
+    uint64_t seq = cell->sequence.load(std::memory_order_acquire);
+    int64_t diff = static_cast<int64_t>(seq - pos);
+    if (diff == 0) {
+      if (header_->enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = header_->enqueuePos.load(std::memory_order_relaxed);
+    }
+  }
+  cell->task.functionId = functionId;
+  cell->task.argsSize = static_cast<uint32_t>(size);
+  if (size) {
+    std::memcpy(cell->task.args, args, size);
+  }
+  cell->sequence.store(pos + 1, std::memory_order_release);
+  wakeOne();
+  return true;
+}
+
+bool SharedTaskQueue::tryPop(SharedTask& task) {
+  assert(valid());
+  uint64_t pos = header_->dequeuePos.load(std::memory_order_relaxed);
+  Cell* cell;
+  while (true) {
+    cell = &cells_[pos & mask_];
+    uint64_t seq = cell->sequence.load(std::memory_order_acquire);
+    int64_t diff = static_cast<int64_t>(seq - (pos + 1));
+    if (diff == 0) {
+      if (header_->dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = header_->dequeuePos.load(std::memory_order_relaxed);
+    }
+  }
+  task = cell->task;
+  cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+  return true;
+}
+
+size_t SharedTaskQueue::approxSize() const {
+  assert(valid());
+  uint64_t dequeued = header_->dequeuePos.load(std::memory_order_relaxed);
+  uint64_t enqueued = header_->enqueuePos.load(std::memory_order_relaxed);
+  return enqueued > dequeued ? static_cast<size_t>(enqueued - dequeued) : 0;
+}
+
+void SharedTaskQueue::wakeOne() {
+  // Sleepers count themselves before their final check of the epoch, so either this sees a sleeper
+  // and wakes it, or the sleeper sees the new epoch.
+  header_->epoch.fetch_add(1, std::memory_order_seq_cst);
+#if defined(__linux__)
+  if (header_->sleepers.load(std::memory_order_seq_cst)) {
+    detail::futex(&header_->ftx, FUTEX_WAKE, 1, nullptr, nullptr, 0);
+  }
+#endif // __linux__
+}
+
+bool SharedTaskQueue::popForMicros(SharedTask& task, uint32_t timeoutUs) {
+  assert(valid());
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeoutUs);
+  while (true) {
+    uint32_t epoch = header_->epoch.load(std::memory_order_acquire);
+    if (tryPop(task)) {
+      return true;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (now >= deadline) {
+      return false;
+    }
+    auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(deadline - now);
+#if defined(__linux__)
+    struct timespec ts;
+    ts.tv_sec = static_cast<time_t>(remaining.count() / 1000000);
+    ts.tv_nsec = static_cast<long>((remaining.count() % 1000000) * 1000);
+    header_->sleepers.fetch_add(1, std::memory_order_seq_cst);
+    if (header_->epoch.load(std::memory_order_seq_cst) == epoch) {
+      detail::futex(&header_->ftx, FUTEX_WAIT, static_cast<int>(epoch), &ts, nullptr, 0);
+    }
+    header_->sleepers.fetch_sub(1, std::memory_order_relaxed);
+#else
+    // Without a process-shared wait primitive, sleepers poll.
+    (void)epoch;
+    std::this_thread::sleep_for(std::min(remaining, std::chrono::microseconds(100)));
+#endif // __linux__
+  }
+}
+
+namespace {
+// The most tasks a drain task runs before giving its thread back to the pool.
+constexpr size_t kTasksPerTurn = 64;
+} // namespace
+
+SharedTaskWorker::SharedTaskWorker(
+    SharedTaskQueue& queue,
+    const SharedTaskRegistry& registry,
+    ThreadPool& pool,
+    size_t concurrency)
+    : queue_(queue), registry_(registry), pool_(pool) {
+  assert(queue.valid());
+  if (!pool_.numThreads()) {
+    return;
+  }
+  active_.store(concurrency, std::memory_order_relaxed);
+  for (size_t i = 0; i < concurrency; ++i) {
+    pool_.schedule([this]() { drain(); }, TaskPriority::kLow, ForceQueuingTag());
+  }
+}
+
+void SharedTaskWorker::drain() {
+  SharedTask task;
+  for (size_t i = 0; i < kTasksPerTurn && !stop_.load(std::memory_order_acquire); ++i) {
+    if (!queue_.popFor(task, kIdleWait)) {
+      break;
+    }
+    if (registry_.run(task)) {
+      executed_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  // With no threads, the pool would run the next drain inline, and never return.
+  if (stop_.load(std::memory_order_acquire) || !pool_.numThreads()) {
+    active_.fetch_sub(1, std::memory_order_acq_rel);
+    return;
+  }
+  pool_.schedule([this]() { drain(); }, TaskPriority::kLow, ForceQueuingTag());
+}
+
+SharedTaskWorker::~SharedTaskWorker() {
+  stop_.store(true, std::memory_order_release);
+  while (active_.load(std::memory_order_acquire)) {
+    std::this_thread::yield();
+  }
+}
+
+} // namespace dispenso
@@ -0,0 +1,305 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file shared_task_queue.h
+ * A file providing SharedTaskQueue, a task queue in a shared memory segment that several processes
+ * may push to and pop from, SharedTaskRegistry, which maps the queue's function IDs to functions
+ * in each process, and SharedTaskWorker, which lets a ThreadPool run tasks from such a queue.
+ **/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <dispenso/thread_pool.h>
+
+namespace dispenso {
+namespace detail {
+struct SharedTaskQueueHeader;
+struct SharedTaskQueueCell;
+} // namespace detail
+
+/**
+ * The most bytes of arguments a SharedTask can carry.
+ **/
+constexpr size_t kSharedTaskArgsSize = 48;
+
+/**
+ * A task descriptor, as carried by a SharedTaskQueue.  Tasks are plain data: a function ID that
+ * each process resolves through its SharedTaskRegistry, and a copy of the function's arguments.
+ **/
+struct SharedTask {
+  uint32_t functionId;
+  uint32_t argsSize;
+  alignas(8) unsigned char args[kSharedTaskArgsSize];
+};
+
+/**
+ * A table from function IDs to functions.  Every process using a queue must register the same
+ * functions under the same IDs, as only the IDs cross process boundaries.  Functions must not
+ * throw.  Not thread-safe to modify while tasks are being run.
+ **/
+class SharedTaskRegistry {
+ public:
+  /**
+   * A function run for a task.  It receives the task's argument bytes, 8-byte aligned.
+   **/
+  using Function = void (*)(const void* args, size_t size);
+
+  /**
+   * Register a function.  A function already registered under <code>id</code> is replaced.
+   *
+   * @param id The ID to register under.  IDs index a table, so they should be small and dense.
+   * @param f The function to run for tasks with this ID.
+   **/
+  void add(uint32_t id, Function f) {
+    if (id >= functions_.size()) {
+      functions_.resize(id + size_t{1}, nullptr);
+    }
+    functions_[id] = f;
+  }
+
+  /**
+   * Look up a function.
+   *
+   * @param id The ID to look up.
+   * @return The function registered under <code>id</code>, or nullptr if there is none.
+   **/
+  Function find(uint32_t id) const {
+    return id < functions_.size() ? functions_[id] : nullptr;
+  }
+
+  /**
+   * Run a task.
+   *
+   * @param task The task to run.
+   * @return true if the task's function was found and run, false if its ID is unknown here.
+   **/
+  bool run(const SharedTask& task) const {
+    Function f = find(task.functionId);
+    if (!f) {
+      return false;
+    }
+    f(task.args, task.argsSize);
+    return true;
+  }
+
+ private:
+  std::vector<Function> functions_;
+};
+
+/**
+ * A bounded, lock-free, multi-producer, multi-consumer queue of SharedTasks in a memory mapped
+ * file, so that several processes on one host can share work.  Each process constructs its own
+ * SharedTaskQueue on the same path, typically one on a tmpfs such as <code>/dev/shm</code>.  The
+ * first to do so creates and initializes the queue, and the rest map it as is.
+ *
+ * Consumers that find the queue empty may sleep in <code>popFor</code>, and pushes wake them.  On
+ * Linux this uses a process-shared futex, and elsewhere sleepers poll.
+ *
+ * A process that dies in the middle of a push or pop can leave one slot stuck, which stalls the
+ * queue once consumers reach it, so the queue should be removed and recreated after a crash.
+ **/
+class SharedTaskQueue {
+ public:
+  /**
+   * The default number of slots in a queue.
+   **/
+  static constexpr size_t kDefaultCapacity = 4096;
+
+  /**
+   * Open the queue at <code>path</code>, creating it if it does not exist yet.  Check
+   * <code>valid()</code> for success.
+   *
+   * @param path The path of the file backing the queue.
+   * @param capacity The number of slots, rounded up to a power of two, if the queue is created.
+   * An existing queue keeps its capacity.
+   **/
+  DISPENSO_DLL_ACCESS explicit SharedTaskQueue(
+      const std::string& path,
+      size_t capacity = kDefaultCapacity);
+
+  SharedTaskQueue(const SharedTaskQueue&) = delete;
+  SharedTaskQueue& operator=(const SharedTaskQueue&) = delete;
+
+  /**
+   * Unmap the queue.  The queue itself lives on until <code>remove</code> is called.
+   **/
+  DISPENSO_DLL_ACCESS ~SharedTaskQueue();
+
+  /**
+   * Delete the file backing a queue.  Processes that already have it mapped may keep using it.
+   *
+   * @param path The path of the file backing the queue.
+   * @return true if the file was deleted.
+   **/
+  DISPENSO_DLL_ACCESS static bool remove(const std::string& path);
+
+  /**
+   * Check whether the queue was opened.
+   *
+   * @return true if the queue could be created or mapped, false if the file could not be opened,
+   * or holds something other than a compatible queue.
+   **/
+  bool valid() const {
+    return header_ != nullptr;
+  }
+
+  /**
+   * Get the number of slots.
+   *
+   * @return The most tasks the queue can hold at once.
+   **/
+  size_t capacity() const {
+    return mask_ + 1;
+  }
+
+  /**
+   * Try to push a task.
+   *
+   * @param functionId The ID of the function to run, as registered in each SharedTaskRegistry.
+   * @param args The argument bytes to copy into the task.
+   * @param size The number of argument bytes.  Must be at most <code>kSharedTaskArgsSize</code>.
+   * @return true if the task was pushed, false if the queue was full.
+   **/
+  DISPENSO_DLL_ACCESS bool tryPush(uint32_t functionId, const void* args, size_t size);
+
+  /**
+   * Try to push a task taking a trivially copyable argument.
+   *
+   * @param functionId The ID of the function to run, as registered in each SharedTaskRegistry.
+   * @param args The argument to copy into the task.
+   * @return true if the task was pushed, false if the queue was full.
+   **/
+  template <typename T>
+  bool tryPush(uint32_t functionId, const T& args) {
+    static_assert(std::is_trivially_copyable<T>::value, "Shared task arguments must be plain data");
+    static_assert(sizeof(T) <= kSharedTaskArgsSize, "Shared task arguments are too large");
+    static_assert(alignof(T) <= 8, "Shared task arguments may be at most 8-byte aligned");
+    return tryPush(functionId, &args, sizeof(T));
+  }
+
+  /**
+   * Try to pop a task.
+   *
+   * @param task Set to the popped task on success.
+   * @return true if a task was popped, false if the queue was empty.
+   **/
+  DISPENSO_DLL_ACCESS bool tryPop(SharedTask& task);
+
+  /**
+   * Pop a task, sleeping until one is pushed or the timeout expires.
+   *
+   * @param task Set to the popped task on success.
+   * @param timeout The longest time to sleep.
+   * @return true if a task was popped, false on timeout.
+   **/
+  template <class Rep, class Period>
+  bool popFor(SharedTask& task, const std::chrono::duration<Rep, Period>& timeout) {
+    return popForMicros(
+        task,
+        static_cast<uint32_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(timeout).count()));
+  }
+
+  /**
+   * Get the number of tasks in the queue.  Only a snapshot under concurrency.
+   *
+   * @return The number of tasks pushed and not yet popped.
+   **/
+  DISPENSO_DLL_ACCESS size_t approxSize() const;
+
+ private:
+  DISPENSO_DLL_ACCESS bool popForMicros(SharedTask& task, uint32_t timeoutUs);
+  void wakeOne();
+
+  detail::SharedTaskQueueHeader* header_ = nullptr;
+  detail::SharedTaskQueueCell* cells_ = nullptr;
+  size_t mask_ = 0;
+  size_t mappedBytes_ = 0;
+#if defined(_WIN32)
+  void* file_ = nullptr;
+  void* mapping_ = nullptr;
+#endif // _WIN32
+};
+
+/**
+ * Runs tasks from a SharedTaskQueue on a ThreadPool.  Up to <code>concurrency</code> low priority
+ * drain tasks are kept scheduled on the pool.  Each runs queued tasks, sleeping briefly in the
+ * queue while it is empty, and then reschedules itself, so that the pool's own work interleaves
+ * with the shared work, and the pool's idle threads soak up work pushed by busier processes.
+ *
+ * Draining stops if the pool has no threads.  The worker must be destroyed before the pool or the
+ * queue.
+ **/
+class SharedTaskWorker {
+ public:
+  /**
+   * The longest a drain task sleeps in an empty queue before yielding its thread back to the pool.
+   **/
+  static constexpr std::chrono::microseconds kIdleWait{1000};
+
+  /**
+   * Start running tasks from a queue.
+   *
+   * @param queue The queue to take tasks from.  Must be valid.
+   * @param registry The functions to run the tasks with.  Tasks with unknown IDs are dropped.
+   * @param pool The pool to run the tasks on.
+   * @param concurrency The most pool threads to spend on the queue at once.
+   **/
+  DISPENSO_DLL_ACCESS SharedTaskWorker(
+      SharedTaskQueue& queue,
+      const SharedTaskRegistry& registry,
+      ThreadPool& pool,
+      size_t concurrency = 1);
+
+  SharedTaskWorker(const SharedTaskWorker&) = delete;
+  SharedTaskWorker& operator=(const SharedTaskWorker&) = delete;
+
+  /**
+   * Get the number of tasks this worker has run.
+   *
+   * @return The count of tasks run, not counting those dropped for unknown IDs.
+   **/
+  size_t numExecuted() const {
+    return executed_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Get the number of tasks this worker has dropped.
+   *
+   * @return The count of tasks whose function IDs were not in the registry.
+   **/
+  size_t numDropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Stop taking tasks, and wait for running drain tasks to return.  Tasks still queued stay in the
+   * queue for other workers.
+   **/
+  DISPENSO_DLL_ACCESS ~SharedTaskWorker();
+
+ private:
+  void drain();
+
+  SharedTaskQueue& queue_;
+  const SharedTaskRegistry& registry_;
+  ThreadPool& pool_;
+  std::atomic<bool> stop_{false};
+  alignas(kCacheLineSize) std::atomic<size_t> active_{0};
+  alignas(kCacheLineSize) std::atomic<size_t> executed_{0};
+  std::atomic<size_t> dropped_{0};
+};
+
+} // namespace dispenso
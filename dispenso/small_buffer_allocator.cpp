@@ -26,6 +26,18 @@ SMALL_BUFFER_GLOBALS_DECL(32);
 SMALL_BUFFER_GLOBALS_DECL(64);
 SMALL_BUFFER_GLOBALS_DECL(128);
 SMALL_BUFFER_GLOBALS_DECL(256);
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 512
+SMALL_BUFFER_GLOBALS_DECL(512);
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 1024
+SMALL_BUFFER_GLOBALS_DECL(1024);
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 2048
+SMALL_BUFFER_GLOBALS_DECL(2048);
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 4096
+SMALL_BUFFER_GLOBALS_DECL(4096);
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
 
 #define SMALL_BUFFER_GLOBAL_FUNC_DEFS(N)           \
   template <>                                      \
@@ -39,6 +51,18 @@ SMALL_BUFFER_GLOBAL_FUNC_DEFS(32)
 SMALL_BUFFER_GLOBAL_FUNC_DEFS(64)
 SMALL_BUFFER_GLOBAL_FUNC_DEFS(128)
 SMALL_BUFFER_GLOBAL_FUNC_DEFS(256)
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 512
+SMALL_BUFFER_GLOBAL_FUNC_DEFS(512)
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 1024
+SMALL_BUFFER_GLOBAL_FUNC_DEFS(1024)
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 2048
+SMALL_BUFFER_GLOBAL_FUNC_DEFS(2048)
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 4096
+SMALL_BUFFER_GLOBAL_FUNC_DEFS(4096)
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
 
 SchwarzSmallBufferInit::SchwarzSmallBufferInit() {
   if (g_smallBufferSchwarzCounter.fetch_add(1) == 0) {
@@ -48,6 +72,18 @@ SchwarzSmallBufferInit::SchwarzSmallBufferInit() {
     ::new (&g_globals64) SmallBufferGlobals();
     ::new (&g_globals128) SmallBufferGlobals();
     ::new (&g_globals256) SmallBufferGlobals();
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 512
+    ::new (&g_globals512) SmallBufferGlobals();
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 1024
+    ::new (&g_globals1024) SmallBufferGlobals();
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 2048
+    ::new (&g_globals2048) SmallBufferGlobals();
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 4096
+    ::new (&g_globals4096) SmallBufferGlobals();
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
   }
 }
 SchwarzSmallBufferInit::~SchwarzSmallBufferInit() {
@@ -59,6 +95,18 @@ SchwarzSmallBufferInit::~SchwarzSmallBufferInit() {
     g_globals64.~SmallBufferGlobals();
     g_globals128.~SmallBufferGlobals();
     g_globals256.~SmallBufferGlobals();
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 512
+    g_globals512.~SmallBufferGlobals();
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 1024
+    g_globals1024.~SmallBufferGlobals();
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 2048
+    g_globals2048.~SmallBufferGlobals();
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 4096
+    g_globals4096.~SmallBufferGlobals();
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
     DISPENSO_TSAN_ANNOTATE_IGNORE_WRITES_END();
   }
 }
@@ -77,6 +125,22 @@ char* allocSmallBufferImpl(size_t ordinal) {
       return detail::SmallBufferAllocator<128>::alloc();
     case 5:
       return detail::SmallBufferAllocator<256>::alloc();
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 512
+    case 6:
+      return detail::SmallBufferAllocator<512>::alloc();
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 1024
+    case 7:
+      return detail::SmallBufferAllocator<1024>::alloc();
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 2048
+    case 8:
+      return detail::SmallBufferAllocator<2048>::alloc();
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 4096
+    case 9:
+      return detail::SmallBufferAllocator<4096>::alloc();
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
     default:
       assert(false && "Invalid small buffer ordinal requested");
       return nullptr;
@@ -103,6 +167,26 @@ void deallocSmallBufferImpl(size_t ordinal, void* buf) {
     case 5:
       detail::SmallBufferAllocator<256>::dealloc(reinterpret_cast<char*>(buf));
       break;
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 512
+    case 6:
+      detail::SmallBufferAllocator<512>::dealloc(reinterpret_cast<char*>(buf));
+      break;
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 1024
+    case 7:
+      detail::SmallBufferAllocator<1024>::dealloc(reinterpret_cast<char*>(buf));
+      break;
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 2048
+    case 8:
+      detail::SmallBufferAllocator<2048>::dealloc(reinterpret_cast<char*>(buf));
+      break;
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 4096
+    case 9:
+      detail::SmallBufferAllocator<4096>::dealloc(reinterpret_cast<char*>(buf));
+      break;
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
     default:
       assert(false && "Invalid small buffer ordinal requested");
   }
@@ -122,18 +206,135 @@ size_t approxBytesAllocatedSmallBufferImpl(size_t ordinal) {
       return detail::SmallBufferAllocator<128>::bytesAllocated();
     case 5:
       return detail::SmallBufferAllocator<256>::bytesAllocated();
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 512
+    case 6:
+      return detail::SmallBufferAllocator<512>::bytesAllocated();
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 1024
+    case 7:
+      return detail::SmallBufferAllocator<1024>::bytesAllocated();
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 2048
+    case 8:
+      return detail::SmallBufferAllocator<2048>::bytesAllocated();
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 4096
+    case 9:
+      return detail::SmallBufferAllocator<4096>::bytesAllocated();
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
+    default:
+      assert(false && "Invalid small buffer ordinal requested");
+      return 0;
+  }
+}
+
+size_t trimSmallBufferImpl(size_t ordinal) {
+  switch (ordinal) {
+    case 0:
+      return detail::SmallBufferAllocator<8>::trim();
+    case 1:
+      return detail::SmallBufferAllocator<16>::trim();
+    case 2:
+      return detail::SmallBufferAllocator<32>::trim();
+    case 3:
+      return detail::SmallBufferAllocator<64>::trim();
+    case 4:
+      return detail::SmallBufferAllocator<128>::trim();
+    case 5:
+      return detail::SmallBufferAllocator<256>::trim();
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 512
+    case 6:
+      return detail::SmallBufferAllocator<512>::trim();
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 1024
+    case 7:
+      return detail::SmallBufferAllocator<1024>::trim();
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 2048
+    case 8:
+      return detail::SmallBufferAllocator<2048>::trim();
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 4096
+    case 9:
+      return detail::SmallBufferAllocator<4096>::trim();
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
     default:
       assert(false && "Invalid small buffer ordinal requested");
       return 0;
   }
 }
 
+SmallBufferStats smallBufferStatsImpl(size_t ordinal) {
+  switch (ordinal) {
+    case 0:
+      return detail::SmallBufferAllocator<8>::stats();
+    case 1:
+      return detail::SmallBufferAllocator<16>::stats();
+    case 2:
+      return detail::SmallBufferAllocator<32>::stats();
+    case 3:
+      return detail::SmallBufferAllocator<64>::stats();
+    case 4:
+      return detail::SmallBufferAllocator<128>::stats();
+    case 5:
+      return detail::SmallBufferAllocator<256>::stats();
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 512
+    case 6:
+      return detail::SmallBufferAllocator<512>::stats();
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 1024
+    case 7:
+      return detail::SmallBufferAllocator<1024>::stats();
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 2048
+    case 8:
+      return detail::SmallBufferAllocator<2048>::stats();
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 4096
+    case 9:
+      return detail::SmallBufferAllocator<4096>::stats();
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
+    default:
+      assert(false && "Invalid small buffer ordinal requested");
+      return {};
+  }
+}
+
 template class SmallBufferAllocator<8>;
 template class SmallBufferAllocator<16>;
 template class SmallBufferAllocator<32>;
 template class SmallBufferAllocator<64>;
 template class SmallBufferAllocator<128>;
 template class SmallBufferAllocator<256>;
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 512
+template class SmallBufferAllocator<512>;
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 1024
+template class SmallBufferAllocator<1024>;
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 2048
+template class SmallBufferAllocator<2048>;
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
+#if DISPENSO_MAX_SMALL_BUFFER_SIZE >= 4096
+template class SmallBufferAllocator<4096>;
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
 
 } // namespace detail
+
+size_t trimSmallBufferAllocators() {
+  size_t released = 0;
+  for (size_t ordinal = 0; ordinal <= detail::log2const(kMaxSmallBufferSize) - 3; ++ordinal) {
+    released += detail::trimSmallBufferImpl(ordinal);
+  }
+  return released;
+}
+
+std::vector<SmallBufferStats> smallBufferAllocatorStats() {
+  std::vector<SmallBufferStats> stats;
+  for (size_t ordinal = 0; ordinal <= detail::log2const(kMaxSmallBufferSize) - 3; ++ordinal) {
+    stats.push_back(detail::smallBufferStatsImpl(ordinal));
+  }
+  return stats;
+}
+
 } // namespace dispenso
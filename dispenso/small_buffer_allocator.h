@@ -13,17 +13,66 @@
 
 #pragma once
 
+#include <vector>
+
 #include <dispenso/detail/math.h>
 #include <dispenso/platform.h>
 
 namespace dispenso {
 
+#if !defined(DISPENSO_MAX_SMALL_BUFFER_SIZE)
+#define DISPENSO_MAX_SMALL_BUFFER_SIZE 256
+#endif // DISPENSO_MAX_SMALL_BUFFER_SIZE
+
 /**
  * Set a standard for the maximum chunk size for use within dispenso.  The reason for this limit is
  * that there are diminishing returns after a certain size, and each new pool has it's own memory
- * overhead.
+ * overhead.  It may be raised to 512, 1024, 2048, or 4096 by defining
+ * DISPENSO_MAX_SMALL_BUFFER_SIZE (the DISPENSO_MAX_SMALL_BUFFER_SIZE CMake variable), e.g. to keep
+ * larger closures in <code>OnceFunction</code> out of the heap.  The same value must be used for
+ * dispenso and all code including it.
+ *
+ * The memory footprint of each pool can be tuned with DISPENSO_SMALL_BUFFER_SLAB_UNIT, the bytes
+ * of each backing allocation per log2 of the chunk size (default 4096), and
+ * DISPENSO_SMALL_BUFFER_TL_CACHE_DIVISOR, the fraction of a backing allocation that each thread
+ * caches (default 4).  Smaller units or larger divisors reduce memory held by idle pools and
+ * threads, at the cost of more frequent trips to the central store.
+ *
+ * Defining DISPENSO_SMALL_BUFFER_HUGE_PAGES to 1 (the DISPENSO_SMALL_BUFFER_HUGE_PAGES CMake
+ * option) takes backing allocations from <code>hugePageAlloc</code>.  Only backing allocations of
+ * at least <code>hugePageSize()</code> bytes get huge pages, so this only helps if the slab unit is
+ * raised far enough for the slabs of busy size classes to reach that size.
+ **/
+constexpr size_t kMaxSmallBufferSize = DISPENSO_MAX_SMALL_BUFFER_SIZE;
+
+static_assert(
+    kMaxSmallBufferSize == 256 || kMaxSmallBufferSize == 512 || kMaxSmallBufferSize == 1024 ||
+        kMaxSmallBufferSize == 2048 || kMaxSmallBufferSize == 4096,
+    "DISPENSO_MAX_SMALL_BUFFER_SIZE must be one of 256, 512, 1024, 2048, or 4096");
+
+/**
+ * A snapshot of one small buffer pool's memory usage, e.g. for export to a metrics system.
  **/
-constexpr size_t kMaxSmallBufferSize = 256;
+struct SmallBufferStats {
+  /** The size of the buffers in this pool. */
+  size_t chunkSize = 0;
+  /** Bytes in the pool's backing allocations. */
+  size_t bytesReserved = 0;
+  /** The most bytes ever held in backing allocations at once. */
+  size_t peakBytesReserved = 0;
+  /** Approximate bytes in free buffers in the pool's central store. */
+  size_t bytesInCentralStore = 0;
+  /**
+   * Bytes held by threads, either in use or cached in thread-local caches.  Telling the two apart
+   * exactly would cost a shared counter update on every allocation, but each thread caches at most
+   * maxBytesPerThreadCache.
+   **/
+  size_t bytesHeldByThreads = 0;
+  /** The number of live threads with a thread-local cache for this pool. */
+  size_t numThreadCaches = 0;
+  /** The most bytes a single thread-local cache may hold. */
+  size_t maxBytesPerThreadCache = 0;
+};
 
 namespace detail {
 
@@ -31,6 +80,8 @@ DISPENSO_DLL_ACCESS char* allocSmallBufferImpl(size_t ordinal);
 DISPENSO_DLL_ACCESS void deallocSmallBufferImpl(size_t ordinal, void* buf);
 
 DISPENSO_DLL_ACCESS size_t approxBytesAllocatedSmallBufferImpl(size_t ordinal);
+DISPENSO_DLL_ACCESS size_t trimSmallBufferImpl(size_t ordinal);
+DISPENSO_DLL_ACCESS SmallBufferStats smallBufferStatsImpl(size_t ordinal);
 
 template <size_t kBlockSize>
 inline std::enable_if_t<(kBlockSize <= kMaxSmallBufferSize), char*> allocSmallOrLarge() {
@@ -108,4 +159,45 @@ size_t approxBytesAllocatedSmallBuffer() {
   return detail::approxBytesAllocatedSmallBufferImpl(detail::log2const(kBlockSize) - 3);
 }
 
+/**
+ * Get a snapshot of the memory usage of a single small buffer pool (associated with kBlockSize).
+ *
+ * @tparam kBlockSize The block size for the pool to query.
+ * @return The pool's statistics.
+ **/
+template <size_t kBlockSize>
+SmallBufferStats smallBufferStats() {
+  return detail::smallBufferStatsImpl(detail::log2const(kBlockSize) - 3);
+}
+
+/**
+ * Get a snapshot of the memory usage of every small buffer pool, from the smallest size class to
+ * the largest.
+ *
+ * @return One entry per size class.
+ **/
+DISPENSO_DLL_ACCESS std::vector<SmallBufferStats> smallBufferAllocatorStats();
+
+/**
+ * Release backing memory of a single small buffer pool (associated with kBlockSize) that is no
+ * longer in use.  See trimSmallBufferAllocators.
+ *
+ * @tparam kBlockSize The block size for the pool to trim.
+ * @return The number of bytes released.
+ **/
+template <size_t kBlockSize>
+size_t trimSmallBuffer() {
+  return detail::trimSmallBufferImpl(detail::log2const(kBlockSize) - 3);
+}
+
+/**
+ * Release backing memory of the small buffer pools that is no longer in use, e.g. after a spike in
+ * usage.  Only backing allocations whose buffers have all been returned to a pool's central store
+ * can be released; buffers cached by other threads keep theirs alive.  This locks each pool while
+ * it runs, and should be called occasionally, e.g. from a periodic maintenance task.
+ *
+ * @return The number of bytes released.
+ **/
+DISPENSO_DLL_ACCESS size_t trimSmallBufferAllocators();
+
 } // namespace dispenso
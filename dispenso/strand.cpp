@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/strand.h>
+
+#include <algorithm>
+#include <cassert>
+#include <thread>
+
+namespace dispenso {
+
+constexpr size_t Strand::kDefaultMaxPerTurn;
+
+Strand::Strand(ThreadPool& pool, size_t maxPerTurn)
+    : pool_(pool), maxPerTurn_(maxPerTurn), tail_(&stub_), head_(&stub_) {
+  assert(maxPerTurn >= 1);
+}
+
+Strand::~Strand() {
+  // The drain task stops touching the strand once it brings pending_ to zero.
+  while (pending_.load(std::memory_order_acquire)) {
+    std::this_thread::yield();
+  }
+  freeNode(tail_);
+}
+
+void Strand::freeNode(Node* node) {
+  if (node != &stub_) {
+    node->~Node();
+    deallocSmallBuffer<kNodeSize>(node);
+  }
+}
+
+void Strand::runNext() {
+  // pending_ says the node was pushed, but the producer may not have linked it yet.
+  Node* next;
+  while (!(next = tail_->next.load(std::memory_order_acquire))) {
+    std::this_thread::yield();
+  }
+  // No producer touches a node after linking its successor, so the old position can go.
+  freeNode(tail_);
+  tail_ = next;
+  next->f();
+}
+
+void Strand::drain() {
+  const bool bounded = pool_.numThreads() > 0;
+  size_t ran = 0;
+  while (true) {
+    size_t count = pending_.load(std::memory_order_acquire);
+    if (bounded) {
+      count = std::min(count, maxPerTurn_ - ran);
+    }
+    for (size_t i = 0; i < count; ++i) {
+      runNext();
+    }
+    ran += count;
+    if (pending_.fetch_sub(count, std::memory_order_acq_rel) == count) {
+      // Idle.  The next push schedules a new drain, and the strand may be destroyed from here on.
+      return;
+    }
+    if (bounded && ran >= maxPerTurn_) {
+      pool_.schedule([this]() { drain(); }, ForceQueuingTag());
+      return;
+    }
+  }
+}
+
+} // namespace dispenso
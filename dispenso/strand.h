@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file strand.h
+ * A file providing Strand, a serial executor on top of a ThreadPool.  Functors scheduled to a
+ * strand run one at a time, in the order they were scheduled, on whichever pool thread is free,
+ * without dedicating or blocking a thread.
+ **/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+#include <dispenso/detail/math.h>
+#include <dispenso/once_function.h>
+#include <dispenso/small_buffer_allocator.h>
+#include <dispenso/thread_pool.h>
+
+namespace dispenso {
+
+/**
+ * A serial executor, e.g. for actor-style objects whose methods must not run concurrently.
+ * Functors are pushed onto a lock-free multi-producer, single-consumer mailbox, and at most one
+ * drain task for the strand is scheduled to the pool at a time.  A drain task runs up to
+ * <code>maxPerTurn</code> functors, and then, if more are waiting, schedules a fresh drain task and
+ * returns its thread to the pool, so that a busy strand cannot starve other work.
+ *
+ * Functors run in the order their <code>schedule</code> calls completed, and each one's effects
+ * are visible to the next.  A Strand fulfills the Schedulable concept, so it may be passed to
+ * <code>Future::then</code> or the <code>Future</code> constructors.  Note that waiting on such a
+ * Future before its functor has started may run the functor on the waiting thread, outside of the
+ * strand, so serialized state should be reached only from the strand's own functors.
+ *
+ * A Strand must be destroyed before its pool.
+ **/
+class Strand {
+ public:
+  /**
+   * The default number of functors a drain task runs before yielding its thread.
+   **/
+  static constexpr size_t kDefaultMaxPerTurn = 64;
+
+  /**
+   * Construct a Strand.
+   *
+   * @param pool The pool whose threads will run this strand's functors.
+   * @param maxPerTurn The most functors a drain task runs before rescheduling itself.  Must be at
+   * least 1.  Ignored if the pool has no threads, as functors then run on scheduling threads.
+   **/
+  DISPENSO_DLL_ACCESS explicit Strand(ThreadPool& pool, size_t maxPerTurn = kDefaultMaxPerTurn);
+
+  Strand(const Strand&) = delete;
+  Strand& operator=(const Strand&) = delete;
+
+  /**
+   * Schedule a functor to run on the strand.  If this starts a drain, the drain is scheduled as
+   * with <code>ThreadPool::schedule</code>, and so may run on the calling thread if the pool is
+   * heavily loaded.
+   *
+   * @param f A functor matching signature <code>void()</code>.
+   **/
+  template <typename F>
+  void schedule(F&& f) {
+    if (push(std::forward<F>(f))) {
+      pool_.schedule([this]() { drain(); });
+    }
+  }
+
+  /**
+   * Schedule a functor to run on the strand.  A drain started by this call is always queued to
+   * the pool, unless the pool has no threads.
+   *
+   * @param f A functor matching signature <code>void()</code>.
+   **/
+  template <typename F>
+  void schedule(F&& f, ForceQueuingTag) {
+    if (push(std::forward<F>(f))) {
+      pool_.schedule([this]() { drain(); }, ForceQueuingTag());
+    }
+  }
+
+  /**
+   * Get the pool backing the strand.
+   *
+   * @return The pool whose threads run this strand's functors.
+   **/
+  ThreadPool& pool() const {
+    return pool_;
+  }
+
+  size_t maxPerTurn() const {
+    return maxPerTurn_;
+  }
+
+  /**
+   * Get the number of functors scheduled and not yet finished.  Only a snapshot under
+   * concurrency.
+   *
+   * @return The number of pending functors, including one that may be running.
+   **/
+  size_t numPending() const {
+    return pending_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Destroy the Strand, first waiting for all scheduled functors to run.  Must not be called from
+   * a functor running on the strand.
+   **/
+  DISPENSO_DLL_ACCESS ~Strand();
+
+ private:
+  struct Node {
+    std::atomic<Node*> next{nullptr};
+    OnceFunction f;
+  };
+
+  static constexpr size_t kNodeSize = detail::nextPow2(sizeof(Node));
+
+  // Appends f to the mailbox, and returns true if the strand was idle, in which case the caller
+  // must schedule a drain.
+  template <typename F>
+  bool push(F&& f) {
+    Node* node = new (allocSmallBuffer<kNodeSize>()) Node();
+    node->f = OnceFunction(std::forward<F>(f));
+    Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+    return pending_.fetch_add(1, std::memory_order_acq_rel) == 0;
+  }
+
+  // Unlinks and runs the next functor.  Only called by the drain task.
+  DISPENSO_DLL_ACCESS void runNext();
+  DISPENSO_DLL_ACCESS void drain();
+  void freeNode(Node* node);
+
+  ThreadPool& pool_;
+  const size_t maxPerTurn_;
+  // The consumer's position: the node whose functor ran last, or stub_ before any ran.  Its next
+  // is the next functor to run.
+  Node stub_;
+  Node* tail_;
+  // The most recently pushed node.
+  alignas(kCacheLineSize) std::atomic<Node*> head_;
+  // Functors pushed and not yet finished.  The strand has a drain task exactly while this is
+  // nonzero.
+  alignas(kCacheLineSize) std::atomic<size_t> pending_{0};
+};
+
+} // namespace dispenso
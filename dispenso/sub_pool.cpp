@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/sub_pool.h>
+
+namespace dispenso {
+
+SubPool::SubPool(ThreadPool& pool, ssize_t reservedConcurrency, ssize_t maxConcurrency)
+    : pool_(pool), reserved_(reservedConcurrency), max_(maxConcurrency) {
+  assert(maxConcurrency >= 1);
+  assert(reservedConcurrency >= 0 && reservedConcurrency <= maxConcurrency);
+}
+
+SubPool::~SubPool() {
+  while (tryExecuteNext()) {
+  }
+  while (drainers_.load(std::memory_order_acquire)) {
+    if (!tryExecuteNext()) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+bool SubPool::tryDequeue(OnceFunction& next) {
+  if (queued_.load(std::memory_order_acquire) <= 0 || !queue_.try_dequeue(next)) {
+    return false;
+  }
+  queued_.fetch_sub(1, std::memory_order_acq_rel);
+  return true;
+}
+
+bool SubPool::tryExecuteNext() {
+  OnceFunction next;
+  if (!tryDequeue(next)) {
+    return false;
+  }
+  next();
+  return true;
+}
+
+void SubPool::launch(ssize_t count) {
+  for (; count > 0; --count) {
+    ssize_t active = active_.load(std::memory_order_relaxed);
+    do {
+      if (active >= max_ || queued_.load(std::memory_order_seq_cst) <= 0) {
+        return;
+      }
+    } while (!active_.compare_exchange_weak(active, active + 1, std::memory_order_seq_cst));
+
+    bool reserved = active < reserved_;
+    drainers_.fetch_add(1, std::memory_order_relaxed);
+    pool_.schedule(
+        [this, reserved]() { drain(reserved); },
+        reserved ? TaskPriority::kHigh : TaskPriority::kLow,
+        ForceQueuingTag());
+  }
+}
+
+void SubPool::drain(bool reserved) {
+  OnceFunction next;
+  while (tryDequeue(next)) {
+    next();
+    // A borrowed thread goes back to the pool after each task, unless the pool has no threads, as
+    // then the drain runs inline in the scheduling thread.
+    if (!reserved && pool_.numThreads()) {
+      break;
+    }
+  }
+  // Pairs with enqueue: either work queued after our last dequeue attempt is seen here, or the
+  // scheduler sees the freed concurrency and launches a drain itself.
+  active_.fetch_sub(1, std::memory_order_seq_cst);
+  if (queued_.load(std::memory_order_seq_cst) > 0) {
+    launch(1);
+  }
+  drainers_.fetch_sub(1, std::memory_order_release);
+}
+
+} // namespace dispenso
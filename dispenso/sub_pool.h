@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file sub_pool.h
+ * A file providing SubPool, a partition of a ThreadPool with its own guaranteed and maximum
+ * concurrency.  Several sub-pools share one set of pool threads, so tenants are isolated from each
+ * other without oversubscribing the machine with separate pools.
+ **/
+
+#pragma once
+
+#include <dispenso/thread_pool.h>
+
+namespace dispenso {
+
+/**
+ * A partition of a ThreadPool.  Work scheduled to a SubPool runs on the parent pool's threads, but
+ * on at most <code>maxConcurrency</code> of them at once.  Up to <code>reservedConcurrency</code>
+ * threads are requested at high priority, so that they are the next threads to free up elsewhere
+ * in the pool.  Beyond that, the SubPool borrows idle threads at low priority, and a borrowed
+ * thread returns to the pool after every task so that reserved work elsewhere is not held up for
+ * long.  Since pool threads are never preempted, guarantees take effect at task boundaries.
+ *
+ * TaskSet and ConcurrentTaskSet may be constructed on a SubPool to schedule into it.  A SubPool
+ * must be destroyed before its parent pool.
+ **/
+class SubPool {
+ public:
+  /**
+   * Construct a SubPool.
+   *
+   * @param pool The pool whose threads will run this SubPool's work.
+   * @param reservedConcurrency The number of threads requested at high priority while work is
+   * available.  The sum over all sub-pools of a pool should not exceed its thread count.
+   * @param maxConcurrency The maximum number of pool threads to run this SubPool's work at once.
+   * Must be at least 1 and at least reservedConcurrency.
+   **/
+  DISPENSO_DLL_ACCESS
+  SubPool(ThreadPool& pool, ssize_t reservedConcurrency, ssize_t maxConcurrency);
+
+  SubPool(const SubPool&) = delete;
+  SubPool& operator=(const SubPool&) = delete;
+
+  /**
+   * Schedule a functor for execution on the SubPool.
+   *
+   * @param f A functor matching signature <code>void()</code>.
+   **/
+  template <typename F>
+  void schedule(F&& f) {
+    enqueue(OnceFunction(std::forward<F>(f)));
+    launch(1);
+  }
+
+  /**
+   * Schedule a batch of functors for execution on the SubPool.
+   *
+   * @param count The number of functors to schedule.
+   * @param gen A generator with signature <code>F(size_t index)</code>, returning a functor with
+   * signature <code>void()</code>.  It is called exactly once per index, in increasing order, on
+   * the calling thread, before this function returns.
+   **/
+  template <typename Gen>
+  void scheduleBulk(size_t count, Gen&& gen) {
+    for (size_t i = 0; i < count; ++i) {
+      enqueue(OnceFunction(gen(i)));
+    }
+    launch(static_cast<ssize_t>(count));
+  }
+
+  /**
+   * Run one queued functor on the calling thread, if any are queued.  This is how threads waiting
+   * on a TaskSet help with SubPool work.
+   *
+   * @return true if a functor was run.
+   **/
+  DISPENSO_DLL_ACCESS bool tryExecuteNext();
+
+  /**
+   * Get the parent pool.
+   *
+   * @return The pool whose threads run this SubPool's work.
+   **/
+  ThreadPool& pool() const {
+    return pool_;
+  }
+
+  ssize_t reservedConcurrency() const {
+    return reserved_;
+  }
+
+  ssize_t maxConcurrency() const {
+    return max_;
+  }
+
+  /**
+   * Get the number of pool threads currently running this SubPool's work.  Only a snapshot under
+   * concurrency.
+   *
+   * @return The number of active pool threads.
+   **/
+  ssize_t numActive() const {
+    return active_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Destroy the SubPool, first running or waiting for all scheduled functors.
+   **/
+  DISPENSO_DLL_ACCESS ~SubPool();
+
+ private:
+  void enqueue(OnceFunction&& f) {
+    bool enqueued = queue_.enqueue(std::move(f));
+    (void)(enqueued); // unused
+    assert(enqueued);
+    queued_.fetch_add(1, std::memory_order_seq_cst);
+  }
+
+  bool tryDequeue(OnceFunction& next);
+  // Request up to count more pool threads, within maxConcurrency.
+  DISPENSO_DLL_ACCESS void launch(ssize_t count);
+  void drain(bool reserved);
+
+  ThreadPool& pool_;
+  const ssize_t reserved_;
+  const ssize_t max_;
+  moodycamel::ConcurrentQueue<OnceFunction> queue_;
+  alignas(kCacheLineSize) std::atomic<ssize_t> queued_{0};
+  // Pool threads counted against maxConcurrency.
+  alignas(kCacheLineSize) std::atomic<ssize_t> active_{0};
+  // Drain tasks scheduled to the pool and not yet finished touching this object.
+  alignas(kCacheLineSize) std::atomic<ssize_t> drainers_{0};
+};
+
+} // namespace dispenso
@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file submission_batcher.h
+ * A file providing SubmissionBatcher, which coalesces one producer's <code>schedule</code> and
+ * <code>async</code> calls into bulk submissions to a ThreadPool or TaskSet.
+ **/
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <dispenso/future.h>
+#include <dispenso/once_function.h>
+
+namespace dispenso {
+
+/**
+ * A buffer in front of a ThreadPool, TaskSet or ConcurrentTaskSet that collects functors from one
+ * producer thread, and submits them with one <code>scheduleBulk</code> call, i.e. one bulk enqueue
+ * and one wake, instead of an enqueue and a wake per functor.  A batch is flushed once it holds
+ * <code>maxTasks</code> functors, when a submission finds the oldest buffered functor at least
+ * <code>maxDelay</code> old, on <code>flush</code> or <code>wait</code>, and on destruction.
+ *
+ * Nothing flushes behind the producer's back, so a producer that goes quiet must
+ * <code>flush</code> before waiting on anything the buffered functors do.  Waiting on a Future
+ * from <code>async</code> is always safe, as a Future whose functor is still buffered runs it on
+ * the waiting thread.
+ *
+ * A SubmissionBatcher fulfills the Schedulable concept.  It belongs to the thread that constructed
+ * it; functors handed to it from any other thread, e.g. by a <code>Future::then</code> chain, are
+ * scheduled on the target directly.
+ *
+ * @tparam Target ThreadPool, TaskSet or ConcurrentTaskSet.
+ **/
+template <typename Target = ThreadPool>
+class SubmissionBatcher {
+ public:
+  /**
+   * The default number of functors in a full batch.
+   **/
+  static constexpr size_t kDefaultMaxTasks = 64;
+
+  /**
+   * The default age past which the oldest buffered functor forces a flush.
+   **/
+  static constexpr std::chrono::microseconds kDefaultMaxDelay{50};
+
+  /**
+   * Construct a SubmissionBatcher owned by the calling thread.
+   *
+   * @param target The pool or task set to submit batches to.
+   * @param maxTasks The number of functors in a full batch.  Values below 1 are treated as 1.
+   * @param maxDelay The age of the oldest buffered functor past which a submission flushes.
+   **/
+  explicit SubmissionBatcher(
+      Target& target,
+      size_t maxTasks = kDefaultMaxTasks,
+      std::chrono::microseconds maxDelay = kDefaultMaxDelay)
+      : target_(target),
+        maxTasks_(std::max<size_t>(maxTasks, 1)),
+        maxDelay_(maxDelay),
+        owner_(std::this_thread::get_id()) {
+    buffer_.reserve(maxTasks_);
+  }
+
+  SubmissionBatcher(const SubmissionBatcher&) = delete;
+  SubmissionBatcher& operator=(const SubmissionBatcher&) = delete;
+
+  /**
+   * Buffer a functor, to be scheduled as with the target's <code>schedule</code>.
+   *
+   * @param f A functor matching signature <code>void()</code>.
+   **/
+  template <typename F>
+  void schedule(F&& f) {
+    if (std::this_thread::get_id() != owner_) {
+      target_.schedule(std::forward<F>(f));
+      return;
+    }
+    push(std::forward<F>(f));
+  }
+
+  /**
+   * Buffer a functor.  The batch holding it will always be queued.
+   *
+   * @param f A functor matching signature <code>void()</code>.
+   **/
+  template <typename F>
+  void schedule(F&& f, ForceQueuingTag) {
+    if (std::this_thread::get_id() != owner_) {
+      target_.schedule(std::forward<F>(f), ForceQueuingTag());
+      return;
+    }
+    forceQueuing_ = true;
+    push(std::forward<F>(f));
+  }
+
+  /**
+   * Invoke a functor through the batcher, as with <code>dispenso::async</code>.
+   *
+   * @param policy The bitmask policy for when/how the functor can be invoked.
+   * <code>std::launch::async</code> forces the batch to be queued.
+   * <code>std::launch::deferred</code> specifies that <code>Future::wait_for</code> and
+   * <code>Future::wait_until</code> may invoke the functor.
+   * @param f The functor to be passed, or a function to be executed
+   * @param args The remaining arguments that will be passed to <code>f</code>
+   * @return A future that will hold the functor's result.
+   **/
+  template <class F, class... Args>
+  Future<detail::ResultOf<F, Args...>> async(std::launch policy, F&& f, Args&&... args) {
+    return Future<detail::ResultOf<F, Args...>>(
+        std::bind(std::forward<F>(f), std::forward<Args>(args)...), *this, policy);
+  }
+
+  /**
+   * Invoke a functor through the batcher, as with <code>dispenso::async</code>.
+   *
+   * @param f The functor to be passed, or a function to be executed
+   * @param args The remaining arguments that will be passed to <code>f</code>
+   * @return A future that will hold the functor's result.
+   **/
+  template <class F, class... Args>
+  Future<detail::ResultOf<F, Args...>> async(F&& f, Args&&... args) {
+    return async(std::launch::deferred, std::forward<F>(f), std::forward<Args>(args)...);
+  }
+
+  /**
+   * Submit all buffered functors now.  Must be called from the owning thread.
+   **/
+  void flush() {
+    if (buffer_.empty()) {
+      return;
+    }
+    // Functors the target runs inline may submit to this batcher again, so the batch is taken out
+    // of the buffer first.
+    std::vector<OnceFunction> batch(std::move(buffer_));
+    buffer_ = std::move(spare_);
+    buffer_.clear();
+    bool force = forceQueuing_;
+    forceQueuing_ = false;
+    auto gen = [&batch](size_t i) { return std::move(batch[i]); };
+    if (force) {
+      target_.scheduleBulk(batch.size(), gen, ForceQueuingTag());
+    } else {
+      target_.scheduleBulk(batch.size(), gen);
+    }
+    batch.clear();
+    spare_ = std::move(batch);
+  }
+
+  /**
+   * Flush, and then wait on the target task set.  Only available when the target is a task set.
+   *
+   * @return The target's <code>wait</code> result.
+   **/
+  decltype(auto) wait() {
+    flush();
+    return target_.wait();
+  }
+
+  /**
+   * Get the number of buffered functors.
+   *
+   * @return The number of functors waiting for the next flush.
+   **/
+  size_t numBuffered() const {
+    return buffer_.size();
+  }
+
+  /**
+   * Get the target.
+   *
+   * @return The pool or task set batches are submitted to.
+   **/
+  Target& target() const {
+    return target_;
+  }
+
+  /**
+   * Destroy the batcher, flushing first.  Must be destroyed on the owning thread, before the
+   * target.
+   **/
+  ~SubmissionBatcher() {
+    flush();
+  }
+
+ private:
+  template <typename F>
+  void push(F&& f) {
+    auto now = std::chrono::steady_clock::now();
+    if (buffer_.empty()) {
+      oldest_ = now;
+    }
+    buffer_.emplace_back(std::forward<F>(f));
+    if (buffer_.size() >= maxTasks_ || now - oldest_ >= maxDelay_) {
+      flush();
+    }
+  }
+
+  Target& target_;
+  const size_t maxTasks_;
+  const std::chrono::microseconds maxDelay_;
+  const std::thread::id owner_;
+  std::vector<OnceFunction> buffer_;
+  std::vector<OnceFunction> spare_;
+  std::chrono::steady_clock::time_point oldest_;
+  bool forceQueuing_ = false;
+};
+
+template <typename Target>
+constexpr size_t SubmissionBatcher<Target>::kDefaultMaxTasks;
+template <typename Target>
+constexpr std::chrono::microseconds SubmissionBatcher<Target>::kDefaultMaxDelay;
+
+} // namespace dispenso
@@ -7,6 +7,9 @@
 
 #include "task_set.h"
 
+#include <dispenso/detail/fiber_wait.h>
+#include <dispenso/timing.h>
+
 namespace dispenso {
 
 namespace detail {
@@ -23,6 +26,15 @@ void pushThreadTaskSet(TaskSetBase* t) {
 void popThreadTaskSet() {
   --g_taskStackSize;
 }
+size_t threadTaskSetDepth() {
+  return g_taskStackSize;
+}
+
+namespace {
+bool noneOutstanding(const void* count) {
+  return !static_cast<const std::atomic<ssize_t>*>(count)->load(std::memory_order_acquire);
+}
+} // namespace
 } // namespace detail
 
 TaskSetBase* parentTaskSet() {
@@ -36,7 +48,7 @@ void TaskSetBase::trySetCurrentException() {
   if (guardException_.compare_exchange_strong(status, kSetting, std::memory_order_acq_rel)) {
     exception_ = std::current_exception();
     guardException_.store(kSet, std::memory_order_release);
-    canceled_.store(true, std::memory_order_release);
+    cancel();
   }
 #endif // __cpp_exceptions
 }
@@ -60,8 +72,12 @@ bool ConcurrentTaskSet::wait() {
   // The deadlock scenario mentioned goes as follows:  N threads in the
   // ThreadPool.  Each thread is running code that is using TaskSets.  No
   // progress could be made without stealing.
+  if (detail::inFiber() &&
+      detail::suspendFiberUntil(&detail::noneOutstanding, &outstandingTaskCount_)) {
+    return testAndResetException();
+  }
   while (outstandingTaskCount_.load(std::memory_order_acquire)) {
-    if (!pool_.tryExecuteNext()) {
+    if (!tryExecuteNext()) {
       std::this_thread::yield();
     }
   }
@@ -71,7 +87,7 @@ bool ConcurrentTaskSet::wait() {
 
 bool ConcurrentTaskSet::tryWait(size_t maxToExecute) {
   while (outstandingTaskCount_.load(std::memory_order_acquire) && maxToExecute--) {
-    if (!pool_.tryExecuteNext()) {
+    if (!tryExecuteNext()) {
       break;
     }
   }
@@ -86,6 +102,20 @@ bool ConcurrentTaskSet::tryWait(size_t maxToExecute) {
   return !testAndResetException();
 }
 
+bool ConcurrentTaskSet::waitForSeconds(double seconds) {
+  const double deadline = getTime() + seconds;
+  while (outstandingTaskCount_.load(std::memory_order_acquire)) {
+    if (getTime() >= deadline) {
+      return false;
+    }
+    if (!tryExecuteNext()) {
+      std::this_thread::yield();
+    }
+  }
+
+  return !testAndResetException();
+}
+
 bool TaskSet::wait() {
   // Steal work until our set is unblocked.
   // The deadlock scenario mentioned goes as follows:  N threads in the
@@ -94,8 +124,13 @@ bool TaskSet::wait() {
   while (pool_.tryExecuteNextFromProducerToken(token_)) {
   }
 
+  // Inside a fiber, the rest of the set is left to other threads while this thread moves on.
+  if (detail::inFiber() &&
+      detail::suspendFiberUntil(&detail::noneOutstanding, &outstandingTaskCount_)) {
+    return testAndResetException();
+  }
   while (outstandingTaskCount_.load(std::memory_order_acquire)) {
-    if (!pool_.tryExecuteNext()) {
+    if (!tryExecuteOther()) {
       std::this_thread::yield();
     }
   }
@@ -118,7 +153,7 @@ bool TaskSet::tryWait(size_t maxToExecute) {
   maxToExe = std::max<ssize_t>(0, maxToExe);
 
   while (outstandingTaskCount_.load(std::memory_order_acquire) && maxToExe--) {
-    if (!pool_.tryExecuteNext()) {
+    if (!tryExecuteOther()) {
       std::this_thread::yield();
     }
   }
@@ -130,4 +165,18 @@ bool TaskSet::tryWait(size_t maxToExecute) {
   return !testAndResetException();
 }
 
+bool TaskSet::waitForSeconds(double seconds) {
+  const double deadline = getTime() + seconds;
+  while (outstandingTaskCount_.load(std::memory_order_acquire)) {
+    if (getTime() >= deadline) {
+      return false;
+    }
+    if (!pool_.tryExecuteNextFromProducerToken(token_) && !tryExecuteOther()) {
+      std::this_thread::yield();
+    }
+  }
+
+  return !testAndResetException();
+}
+
 } // namespace dispenso
@@ -13,8 +13,23 @@
 
 #pragma once
 
+#include <chrono>
+
 namespace dispenso {
 enum class ParentCascadeCancel { kOff, kOn };
+
+/**
+ * Which tasks a thread waiting on a <code>TaskSet</code> may run while it waits.
+ *
+ * <code>kOwnTasksFirst</code> runs the set's own queued tasks first, and then helps with any work
+ * in the pool until the set completes.  This gives the best throughput, but an unrelated long task
+ * picked up while helping delays the return from <code>wait</code>.
+ *
+ * <code>kOwnTasksOnly</code> runs only the set's own queued tasks, and otherwise waits for the
+ * pool threads to finish the rest.  This bounds wait latency by the set's own work, e.g. for a
+ * nested <code>parallel_for</code> inside a request handler.
+ **/
+enum class WaitPolicy { kOwnTasksFirst, kOwnTasksOnly };
 }
 
 #include <dispenso/detail/task_set_impl.h>
@@ -42,16 +57,38 @@ class TaskSet : public TaskSetBase {
    * @param pool The backing pool for this TaskSet
    * @param stealingLoadMultiplier An over-load factor.  If this factor of load is reached by the
    * underlying pool, scheduled tasks may run immediately in the calling thread.
+   * @param priority The priority at which tasks from this TaskSet are queued in the pool.
    **/
   TaskSet(
       ThreadPool& p,
       ParentCascadeCancel registerForParentCancel,
-      ssize_t stealingLoadMultiplier = kDefaultStealingMultiplier)
-      : TaskSetBase(p, registerForParentCancel, stealingLoadMultiplier), token_(p.work_) {}
+      ssize_t stealingLoadMultiplier = kDefaultStealingMultiplier,
+      TaskPriority priority = TaskPriority::kNormal)
+      : TaskSetBase(p, registerForParentCancel, stealingLoadMultiplier, priority),
+        token_(p.work_) {}
 
   TaskSet(ThreadPool& p) : TaskSet(p, ParentCascadeCancel::kOff, kDefaultStealingMultiplier) {}
   TaskSet(ThreadPool& p, ssize_t stealingLoadMultiplier)
       : TaskSet(p, ParentCascadeCancel::kOff, stealingLoadMultiplier) {}
+  TaskSet(ThreadPool& p, TaskPriority priority)
+      : TaskSet(p, ParentCascadeCancel::kOff, kDefaultStealingMultiplier, priority) {}
+
+  /**
+   * Construct a TaskSet that schedules to a SubPool.  All of the set's tasks are queued to the
+   * SubPool (priorities and NUMA nodes do not apply), and threads waiting on the set help with any
+   * of the SubPool's queued work, whatever the wait policy.
+   *
+   * @param sub The SubPool for this TaskSet
+   * @param stealingLoadMultiplier An over-load factor.  If this factor of the SubPool's maximum
+   * concurrency is reached by outstanding tasks, scheduled tasks may run immediately in the calling
+   * thread.
+   **/
+  TaskSet(
+      SubPool& sub,
+      ParentCascadeCancel registerForParentCancel = ParentCascadeCancel::kOff,
+      ssize_t stealingLoadMultiplier = kDefaultStealingMultiplier)
+      : TaskSetBase(sub, registerForParentCancel, stealingLoadMultiplier),
+        token_(sub.pool().work_) {}
 
   TaskSet(TaskSet&& other) = delete;
   TaskSet& operator=(TaskSet&& other) = delete;
@@ -64,10 +101,10 @@ class TaskSet : public TaskSetBase {
    * passing lambdas, other concrete functors, or <code>OnceFunction</code>, but
    * <code>std::function</code> or similarly type-erased objects will also work.
    *
-   * @note If <code>f</code> can throw exceptions, then <code>schedule</code> may throw if the task
-   * is run inline.  Otherwise, exceptions will be caught on the running thread and best-effort
-   * propagated to the <code>ConcurrentTaskSet</code>, where the first one from the set is rethrown
-   * in <code>wait</code>.
+   * @note If <code>f</code> can throw exceptions, then exceptions will be caught on the running
+   * thread, whether or not the task is run inline, and best-effort propagated to the
+   * <code>TaskSet</code>, where the first one from the set is rethrown in <code>wait</code>.  The
+   * first exception also cancels the rest of the set.
    **/
   template <typename F>
   void schedule(F&& f) {
@@ -75,7 +112,13 @@ class TaskSet : public TaskSetBase {
       return;
     }
     if (outstandingTaskCount_.load(std::memory_order_relaxed) > taskSetLoadFactor_) {
-      f();
+      runInline(f);
+    } else if (DISPENSO_EXPECT(subPool_ != nullptr, false)) {
+      subPool_->schedule(packageTask(std::forward<F>(f)));
+    } else if (DISPENSO_EXPECT(priority_ != TaskPriority::kNormal, false)) {
+      pool_.schedule(packageTask(std::forward<F>(f)), priority_);
+    } else if (DISPENSO_EXPECT(waitPolicy_ == WaitPolicy::kOwnTasksOnly, false)) {
+      pool_.schedule(token_, packageTask(std::forward<F>(f)), ForceQueuingTag(), false);
     } else {
       pool_.schedule(token_, packageTask(std::forward<F>(f)));
     }
@@ -94,7 +137,80 @@ class TaskSet : public TaskSetBase {
    **/
   template <typename F>
   void schedule(F&& f, ForceQueuingTag fq) {
-    pool_.schedule(token_, packageTask(std::forward<F>(f)), fq);
+    if (DISPENSO_EXPECT(subPool_ != nullptr, false)) {
+      subPool_->schedule(packageTask(std::forward<F>(f)));
+    } else if (DISPENSO_EXPECT(priority_ != TaskPriority::kNormal, false)) {
+      pool_.schedule(packageTask(std::forward<F>(f)), priority_, fq);
+    } else {
+      pool_.schedule(
+          token_, packageTask(std::forward<F>(f)), fq, waitPolicy_ != WaitPolicy::kOwnTasksOnly);
+    }
+  }
+
+  /**
+   * Schedule a functor for execution on the underlying pool, preferably by a thread on the given
+   * NUMA node.  See <code>ThreadPool::scheduleOnNode</code>.
+   *
+   * @param f A functor matching signature <code>void()</code>.
+   * @param node The NUMA node index, in the range [0, pool().numNumaNodes()).
+   **/
+  template <typename F>
+  void scheduleOnNode(F&& f, size_t node) {
+    if (DISPENSO_EXPECT(subPool_ != nullptr, false)) {
+      subPool_->schedule(packageTask(std::forward<F>(f)));
+    } else {
+      pool_.scheduleOnNode(packageTask(std::forward<F>(f)), node);
+    }
+  }
+
+  /**
+   * Schedule a batch of functors for execution on the underlying pool.  This is cheaper than
+   * calling <code>schedule</code> repeatedly; see <code>ThreadPool::scheduleBulk</code>.  If the
+   * load on the underlying pool is high, the batch may be executed inline on the current thread.
+   *
+   * @param count The number of functors to schedule.
+   * @param gen A generator with signature <code>F(size_t index)</code>, returning a functor with
+   * signature <code>void()</code>.  It is called exactly once per index, in increasing order, on
+   * the calling thread, before this function returns.
+   **/
+  template <typename Gen>
+  void scheduleBulk(size_t count, Gen&& gen) {
+    if (DISPENSO_EXPECT(canceled(), false)) {
+      return;
+    }
+    if (outstandingTaskCount_.load(std::memory_order_relaxed) > taskSetLoadFactor_) {
+      for (size_t i = 0; i < count; ++i) {
+        runInline(gen(i));
+      }
+    } else if (DISPENSO_EXPECT(subPool_ != nullptr, false)) {
+      subPool_->scheduleBulk(count, wrapTaskGenerator(gen, count));
+    } else if (DISPENSO_EXPECT(priority_ != TaskPriority::kNormal, false)) {
+      for (size_t i = 0; i < count; ++i) {
+        pool_.schedule(packageTask(gen(i)), priority_);
+      }
+    } else {
+      pool_.scheduleBulk(&token_, count, wrapTaskGenerator(gen, count));
+    }
+  }
+
+  /**
+   * Schedule a batch of functors for execution on the underlying pool.  The functors will always
+   * be queued.
+   *
+   * @param count The number of functors to schedule.
+   * @param gen A generator as for the two-argument overload.
+   **/
+  template <typename Gen>
+  void scheduleBulk(size_t count, Gen&& gen, ForceQueuingTag fq) {
+    if (DISPENSO_EXPECT(subPool_ != nullptr, false)) {
+      subPool_->scheduleBulk(count, wrapTaskGenerator(gen, count));
+    } else if (DISPENSO_EXPECT(priority_ != TaskPriority::kNormal, false)) {
+      for (size_t i = 0; i < count; ++i) {
+        pool_.schedule(packageTask(gen(i)), priority_, fq);
+      }
+    } else {
+      pool_.scheduleBulk(&token_, count, wrapTaskGenerator(gen, count), fq);
+    }
   }
 
   /**
@@ -121,6 +237,58 @@ class TaskSet : public TaskSetBase {
    **/
   DISPENSO_DLL_ACCESS bool tryWait(size_t maxToExecute);
 
+  /**
+   * Wait for all currently scheduled functors to finish execution, but for no longer than the
+   * given duration.  Like <code>wait</code>, the calling thread helps run work while waiting, so a
+   * long running functor may delay the return past the timeout.  If all functors complete and
+   * exceptions have been propagated, the first of them is rethrown.
+   *
+   * @param timeout The maximum duration to wait.
+   *
+   * @return <code>true</code> if all currently scheduled functors have been completed prior to
+   * returning, and <code>false</code> otherwise (including cancelled cases).
+   **/
+  template <class Rep, class Period>
+  bool waitFor(const std::chrono::duration<Rep, Period>& timeout) {
+    return waitForSeconds(std::chrono::duration<double>(timeout).count());
+  }
+
+  /**
+   * Wait for all currently scheduled functors to finish execution, but no later than the given
+   * time.  See <code>waitFor</code> for details.
+   *
+   * @param deadline The latest time to wait until.
+   *
+   * @return <code>true</code> if all currently scheduled functors have been completed prior to
+   * returning, and <code>false</code> otherwise (including cancelled cases).
+   **/
+  template <class Clock, class Duration>
+  bool waitUntil(const std::chrono::time_point<Clock, Duration>& deadline) {
+    return waitFor(deadline - Clock::now());
+  }
+
+  /**
+   * Set which tasks threads waiting on this TaskSet may run; see <code>WaitPolicy</code>.  This
+   * should be set before scheduling, since with <code>kOwnTasksOnly</code> tasks are always queued
+   * to the set's own queue, where the waiting thread can find them.  Tasks scheduled with a
+   * non-normal priority or to a NUMA node are not in that queue, and are left to the pool threads.
+   *
+   * @param policy The policy to use in <code>wait</code>, <code>tryWait</code>, and
+   * <code>waitFor</code>.
+   **/
+  void setWaitPolicy(WaitPolicy policy) {
+    waitPolicy_ = policy;
+  }
+
+  /**
+   * Get the current wait policy.
+   *
+   * @return The policy set via <code>setWaitPolicy</code>, <code>kOwnTasksFirst</code> by default.
+   **/
+  WaitPolicy waitPolicy() const {
+    return waitPolicy_;
+  }
+
   /**
    * Set the TaskSet to canceled state.  No unexecuted tasks will execute once this is set.
    * Already executing tasks may check canceled() status to exit early.
@@ -148,7 +316,16 @@ class TaskSet : public TaskSetBase {
   }
 
  private:
+  DISPENSO_DLL_ACCESS bool waitForSeconds(double seconds);
+
+  // Help with pool work outside this set, if the policy allows it.
+  bool tryExecuteOther() {
+    return tryExecuteSubPool() ||
+        (waitPolicy_ == WaitPolicy::kOwnTasksFirst && pool_.tryExecuteNext());
+  }
+
   moodycamel::ProducerToken token_;
+  WaitPolicy waitPolicy_ = WaitPolicy::kOwnTasksFirst;
 
   template <typename Result>
   friend class detail::FutureBase;
@@ -174,17 +351,36 @@ class ConcurrentTaskSet : public TaskSetBase {
    * @param pool The backing pool for this ConcurrentTaskSet
    * @param stealingLoadMultiplier An over-load factor.  If this factor of load is reached by the
    * underlying pool, scheduled tasks may run immediately in the calling thread.
+   * @param priority The priority at which tasks from this ConcurrentTaskSet are queued in the pool.
    **/
   ConcurrentTaskSet(
       ThreadPool& pool,
       ParentCascadeCancel registerForParentCancel,
-      ssize_t stealingLoadMultiplier = kDefaultStealingMultiplier)
-      : TaskSetBase(pool, registerForParentCancel, stealingLoadMultiplier) {}
+      ssize_t stealingLoadMultiplier = kDefaultStealingMultiplier,
+      TaskPriority priority = TaskPriority::kNormal)
+      : TaskSetBase(pool, registerForParentCancel, stealingLoadMultiplier, priority) {}
 
   ConcurrentTaskSet(ThreadPool& p)
       : ConcurrentTaskSet(p, ParentCascadeCancel::kOff, kDefaultStealingMultiplier) {}
   ConcurrentTaskSet(ThreadPool& p, ssize_t stealingLoadMultiplier)
       : ConcurrentTaskSet(p, ParentCascadeCancel::kOff, stealingLoadMultiplier) {}
+  ConcurrentTaskSet(ThreadPool& p, TaskPriority priority)
+      : ConcurrentTaskSet(p, ParentCascadeCancel::kOff, kDefaultStealingMultiplier, priority) {}
+
+  /**
+   * Construct a ConcurrentTaskSet that schedules to a SubPool.  See the corresponding
+   * <code>TaskSet</code> constructor.
+   *
+   * @param sub The SubPool for this ConcurrentTaskSet
+   * @param stealingLoadMultiplier An over-load factor.  If this factor of the SubPool's maximum
+   * concurrency is reached by outstanding tasks, scheduled tasks may run immediately in the calling
+   * thread.
+   **/
+  ConcurrentTaskSet(
+      SubPool& sub,
+      ParentCascadeCancel registerForParentCancel = ParentCascadeCancel::kOff,
+      ssize_t stealingLoadMultiplier = kDefaultStealingMultiplier)
+      : TaskSetBase(sub, registerForParentCancel, stealingLoadMultiplier) {}
 
   ConcurrentTaskSet(ConcurrentTaskSet&& other) = delete;
   ConcurrentTaskSet& operator=(ConcurrentTaskSet&& other) = delete;
@@ -200,20 +396,22 @@ class ConcurrentTaskSet : public TaskSetBase {
    * @param skipRecheck A poweruser knob that says that if we don't have enough outstanding tasks to
    * immediately work steal, we should bypass the similar check in the ThreadPool.
    *
-   * @note If <code>f</code> can throw exceptions, then <code>schedule</code> may throw if the task
-   * is run inline.  Otherwise, exceptions will be caught on the running thread and best-effort
-   * propagated to the <code>ConcurrentTaskSet</code>, where the first one from the set is rethrown
-   * in <code>wait</code>.
+   * @note If <code>f</code> can throw exceptions, then exceptions will be caught on the running
+   * thread, whether or not the task is run inline, and best-effort propagated to the
+   * <code>ConcurrentTaskSet</code>, where the first one from the set is rethrown in
+   * <code>wait</code>.  The first exception also cancels the rest of the set.
    **/
   template <typename F>
   void schedule(F&& f, bool skipRecheck = false) {
     if (outstandingTaskCount_.load(std::memory_order_relaxed) > taskSetLoadFactor_ &&
         DISPENSO_EXPECT(!canceled(), true)) {
-      f();
+      runInline(f);
+    } else if (DISPENSO_EXPECT(subPool_ != nullptr, false)) {
+      subPool_->schedule(packageTask(std::forward<F>(f)));
     } else if (skipRecheck) {
-      pool_.schedule(packageTask(std::forward<F>(f)), ForceQueuingTag());
+      pool_.schedule(packageTask(std::forward<F>(f)), priority_, ForceQueuingTag());
     } else {
-      pool_.schedule(packageTask(std::forward<F>(f)));
+      pool_.schedule(packageTask(std::forward<F>(f)), priority_);
     }
   }
 
@@ -230,7 +428,75 @@ class ConcurrentTaskSet : public TaskSetBase {
    **/
   template <typename F>
   void schedule(F&& f, ForceQueuingTag fq) {
-    pool_.schedule(packageTask(std::forward<F>(f)), fq);
+    if (DISPENSO_EXPECT(subPool_ != nullptr, false)) {
+      subPool_->schedule(packageTask(std::forward<F>(f)));
+    } else {
+      pool_.schedule(packageTask(std::forward<F>(f)), priority_, fq);
+    }
+  }
+
+  /**
+   * Schedule a functor for execution on the underlying pool, preferably by a thread on the given
+   * NUMA node.  See <code>ThreadPool::scheduleOnNode</code>.
+   *
+   * @param f A functor matching signature <code>void()</code>.
+   * @param node The NUMA node index, in the range [0, pool().numNumaNodes()).
+   **/
+  template <typename F>
+  void scheduleOnNode(F&& f, size_t node) {
+    if (DISPENSO_EXPECT(subPool_ != nullptr, false)) {
+      subPool_->schedule(packageTask(std::forward<F>(f)));
+    } else {
+      pool_.scheduleOnNode(packageTask(std::forward<F>(f)), node);
+    }
+  }
+
+  /**
+   * Schedule a batch of functors for execution on the underlying pool.  This is cheaper than
+   * calling <code>schedule</code> repeatedly; see <code>ThreadPool::scheduleBulk</code>.  If the
+   * load on the underlying pool is high, the batch may be executed inline on the current thread.
+   *
+   * @param count The number of functors to schedule.
+   * @param gen A generator with signature <code>F(size_t index)</code>, returning a functor with
+   * signature <code>void()</code>.  It is called exactly once per index, in increasing order, on
+   * the calling thread, before this function returns.
+   **/
+  template <typename Gen>
+  void scheduleBulk(size_t count, Gen&& gen) {
+    if (outstandingTaskCount_.load(std::memory_order_relaxed) > taskSetLoadFactor_ &&
+        DISPENSO_EXPECT(!canceled(), true)) {
+      for (size_t i = 0; i < count; ++i) {
+        runInline(gen(i));
+      }
+    } else if (DISPENSO_EXPECT(subPool_ != nullptr, false)) {
+      subPool_->scheduleBulk(count, wrapTaskGenerator(gen, count));
+    } else if (DISPENSO_EXPECT(priority_ != TaskPriority::kNormal, false)) {
+      for (size_t i = 0; i < count; ++i) {
+        pool_.schedule(packageTask(gen(i)), priority_);
+      }
+    } else {
+      pool_.scheduleBulk(count, wrapTaskGenerator(gen, count));
+    }
+  }
+
+  /**
+   * Schedule a batch of functors for execution on the underlying pool.  The functors will always
+   * be queued.
+   *
+   * @param count The number of functors to schedule.
+   * @param gen A generator as for the two-argument overload.
+   **/
+  template <typename Gen>
+  void scheduleBulk(size_t count, Gen&& gen, ForceQueuingTag fq) {
+    if (DISPENSO_EXPECT(subPool_ != nullptr, false)) {
+      subPool_->scheduleBulk(count, wrapTaskGenerator(gen, count));
+    } else if (DISPENSO_EXPECT(priority_ != TaskPriority::kNormal, false)) {
+      for (size_t i = 0; i < count; ++i) {
+        pool_.schedule(packageTask(gen(i)), priority_, fq);
+      }
+    } else {
+      pool_.scheduleBulk(count, wrapTaskGenerator(gen, count), fq);
+    }
   }
 
   /**
@@ -254,6 +520,36 @@ class ConcurrentTaskSet : public TaskSetBase {
    **/
   DISPENSO_DLL_ACCESS bool tryWait(size_t maxToExecute);
 
+  /**
+   * Wait for all currently scheduled functors to finish execution, but for no longer than the
+   * given duration.  Like <code>wait</code>, the calling thread helps run work while waiting, so a
+   * long running functor may delay the return past the timeout.  If all functors complete and
+   * exceptions have been propagated, the first of them is rethrown.
+   *
+   * @param timeout The maximum duration to wait.
+   *
+   * @return <code>true</code> if all currently scheduled functors have been completed prior to
+   * returning, and <code>false</code> otherwise (including cancelled cases).
+   **/
+  template <class Rep, class Period>
+  bool waitFor(const std::chrono::duration<Rep, Period>& timeout) {
+    return waitForSeconds(std::chrono::duration<double>(timeout).count());
+  }
+
+  /**
+   * Wait for all currently scheduled functors to finish execution, but no later than the given
+   * time.  See <code>waitFor</code> for details.
+   *
+   * @param deadline The latest time to wait until.
+   *
+   * @return <code>true</code> if all currently scheduled functors have been completed prior to
+   * returning, and <code>false</code> otherwise (including cancelled cases).
+   **/
+  template <class Clock, class Duration>
+  bool waitUntil(const std::chrono::time_point<Clock, Duration>& deadline) {
+    return waitFor(deadline - Clock::now());
+  }
+
   /**
    * Set the ConcurrentTaskSet to canceled state.  No unexecuted tasks will execute once this is
    * set.  Already executing tasks may check canceled() status to exit early.
@@ -282,8 +578,10 @@ class ConcurrentTaskSet : public TaskSetBase {
   }
 
  private:
+  DISPENSO_DLL_ACCESS bool waitForSeconds(double seconds);
+
   bool tryExecuteNext() {
-    return pool_.tryExecuteNext();
+    return tryExecuteSubPool() || pool_.tryExecuteNext();
   }
 
   template <typename Result>
@@ -299,4 +597,46 @@ class ConcurrentTaskSet : public TaskSetBase {
  **/
 DISPENSO_DLL_ACCESS TaskSetBase* parentTaskSet();
 
+/**
+ * A lightweight, copyable handle for cooperative cancellation of a (Concurrent)TaskSet.  Long
+ * running task bodies (e.g. within a <code>parallel_for</code>) may poll <code>canceled()</code>
+ * cheaply and return early, and any of them may call <code>cancel()</code>, e.g. once a search
+ * has found a match.  The token must not outlive its task set.
+ **/
+class CancellationToken {
+ public:
+  /**
+   * Construct a token that is never canceled.
+   **/
+  CancellationToken() = default;
+
+  /**
+   * Construct a token for the given task set.
+   *
+   * @param tasks The task set to observe and cancel.
+   **/
+  explicit CancellationToken(TaskSetBase& tasks) : tasks_(&tasks) {}
+
+  /**
+   * Check whether the task set has been canceled.  This is a single atomic load.
+   *
+   * @return true if the task set has been canceled.
+   **/
+  bool canceled() const {
+    return tasks_ && tasks_->canceled();
+  }
+
+  /**
+   * Cancel the task set, as by its <code>cancel()</code> function.
+   **/
+  void cancel() const {
+    if (tasks_) {
+      tasks_->cancel();
+    }
+  }
+
+ private:
+  TaskSetBase* tasks_ = nullptr;
+};
+
 } // namespace dispenso
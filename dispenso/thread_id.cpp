@@ -7,6 +7,12 @@
 
 #include <dispenso/thread_id.h>
 
+#if defined(__linux__) || defined(__APPLE__)
+#include <pthread.h>
+#elif defined(_WIN32)
+#include <Windows.h>
+#endif // PLATFORM
+
 namespace dispenso {
 
 std::atomic<uint64_t> nextThread{0};
@@ -20,4 +26,27 @@ uint64_t threadId() {
   return currentThread;
 }
 
+bool setCurrentThreadName(const std::string& name) {
+#if defined(__linux__)
+  // Linux limits names to 16 bytes including the terminator, and fails on longer names.
+  std::string truncated = name.substr(0, 15);
+  return pthread_setname_np(pthread_self(), truncated.c_str()) == 0;
+#elif defined(__APPLE__)
+  return pthread_setname_np(name.c_str()) == 0;
+#elif defined(_WIN32)
+  // SetThreadDescription is only available on Windows 10 1607 and newer; look it up dynamically.
+  using SetThreadDescriptionFn = HRESULT(WINAPI*)(HANDLE, PCWSTR);
+  static auto setDescription = reinterpret_cast<SetThreadDescriptionFn>(
+      GetProcAddress(GetModuleHandleW(L"kernel32.dll"), "SetThreadDescription"));
+  if (!setDescription) {
+    return false;
+  }
+  std::wstring wide(name.begin(), name.end());
+  return SUCCEEDED(setDescription(GetCurrentThread(), wide.c_str()));
+#else
+  (void)name;
+  return false;
+#endif // PLATFORM
+}
+
 } // namespace dispenso
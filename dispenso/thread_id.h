@@ -11,6 +11,8 @@
 
 #pragma once
 
+#include <string>
+
 #include <dispenso/platform.h>
 
 namespace dispenso {
@@ -29,4 +31,14 @@ namespace dispenso {
  **/
 DISPENSO_DLL_ACCESS uint64_t threadId();
 
+/**
+ * Set the operating system name of the current thread, as seen in debuggers, profilers, and tools
+ * like top and perf.
+ *
+ * @param name The name to use.  Platforms may truncate the name (Linux allows 15 characters).
+ *
+ * @return true if the name was set, false if it failed or is unsupported on this platform.
+ **/
+DISPENSO_DLL_ACCESS bool setCurrentThreadName(const std::string& name);
+
 } // namespace dispenso
@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file thread_local.h
+ * A file providing ThreadLocal, an enumerable per-thread storage container.  Each thread gets its
+ * own lazily created, cache-line-aligned copy of a value, and the copies can be enumerated or
+ * combined afterward, e.g. to finish a reduction computed by arbitrary tasks.
+ **/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <utility>
+
+#include <dispenso/detail/math.h>
+#include <dispenso/platform.h>
+#include <dispenso/thread_id.h>
+
+namespace dispenso {
+
+/**
+ * An enumerable thread-local value, similar to TBB's <code>enumerable_thread_specific</code>.  A
+ * thread's slot is created by its first call to <code>local()</code> and lives until the
+ * ThreadLocal is cleared or destroyed, even if the thread exits first, so that its contribution can
+ * still be combined.  Slots are indexed by <code>threadId()</code>, so finding the calling thread's
+ * slot is a couple of dependent loads, and each slot has its own cache lines, so threads updating
+ * their slots do not falsely share.
+ *
+ * @code
+ * dispenso::ThreadLocal<int64_t> sums;
+ * dispenso::TaskSet tasks(pool);
+ * for (auto& item : items) {
+ *   tasks.schedule([&sums, &item]() { sums.local() += cost(item); });
+ * }
+ * tasks.wait();
+ * int64_t total = sums.combine(std::plus<int64_t>());
+ * @endcode
+ *
+ * @tparam T The per-thread value type.  Must be move constructible.
+ **/
+template <typename T>
+class ThreadLocal {
+ public:
+  /**
+   * Construct a ThreadLocal whose slots are value-initialized.
+   **/
+  ThreadLocal() : init_([]() { return T(); }) {}
+
+  /**
+   * Construct a ThreadLocal whose slots are initialized by a function.
+   *
+   * @param init A functor with signature <code>T()</code>, called on each thread's first access.
+   * To copy an exemplar, capture it by value.
+   **/
+  explicit ThreadLocal(std::function<T()> init) : init_(std::move(init)) {}
+
+  ThreadLocal(const ThreadLocal&) = delete;
+  ThreadLocal& operator=(const ThreadLocal&) = delete;
+
+  /**
+   * Get the calling thread's slot, creating it on first use.  Concurrency safe.
+   *
+   * @return A reference to the calling thread's value.  It remains valid until the ThreadLocal is
+   * cleared or destroyed.
+   **/
+  T& local() {
+    bool exists;
+    return local(exists);
+  }
+
+  /**
+   * Get the calling thread's slot, creating it on first use.  Concurrency safe.
+   *
+   * @param exists Set to true if the slot already existed, false if it was just created.
+   * @return A reference to the calling thread's value.
+   **/
+  T& local(bool& exists) {
+    const uint64_t id = threadId();
+    const size_t level = static_cast<size_t>(detail::log2(id + 1));
+    const size_t offset = static_cast<size_t>(id + 1 - (uint64_t{1} << level));
+    std::atomic<Slot*>* table = levels_[level].load(std::memory_order_acquire);
+    if (table) {
+      if (Slot* slot = table[offset].load(std::memory_order_acquire)) {
+        exists = true;
+        return slot->value;
+      }
+    }
+    exists = false;
+    return createSlot(level, offset)->value;
+  }
+
+  /**
+   * Get the number of slots created so far.  Concurrency safe.
+   *
+   * @return The number of threads that have called <code>local()</code> since construction or the
+   * last <code>clear()</code>.
+   **/
+  size_t size() const {
+    return size_.load(std::memory_order_acquire);
+  }
+
+  /**
+   * Check whether any slots have been created.  Concurrency safe.
+   *
+   * @return true if there are no slots.
+   **/
+  bool empty() const {
+    return size() == 0;
+  }
+
+  /**
+   * Call a functor on every slot.  Slots created concurrently may or may not be visited, and it is
+   * the user's responsibility not to race with threads updating their slots.
+   *
+   * @param f A functor with signature <code>void(T&)</code>.
+   **/
+  template <typename F>
+  void enumerate(F&& f) {
+    forEachSlot([&f](Slot* slot) { f(slot->value); });
+  }
+
+  /**
+   * Call a functor on every slot.  See the non-const overload.
+   *
+   * @param f A functor with signature <code>void(const T&)</code>.
+   **/
+  template <typename F>
+  void enumerate(F&& f) const {
+    const_cast<ThreadLocal*>(this)->forEachSlot([&f](const Slot* slot) { f(slot->value); });
+  }
+
+  /**
+   * Combine all slots with a binary operation, in no particular order.  Subject to the same
+   * restrictions as <code>enumerate</code>.
+   *
+   * @param op A functor with signature <code>T(const T&, const T&)</code>, which should be
+   * associative and commutative.
+   * @return The combined value, or a freshly initialized value if there are no slots.
+   **/
+  template <typename BinaryOp>
+  T combine(BinaryOp op) const {
+    bool first = true;
+    T result = init_();
+    enumerate([&](const T& value) {
+      if (first) {
+        result = value;
+        first = false;
+      } else {
+        result = op(result, value);
+      }
+    });
+    return result;
+  }
+
+  /**
+   * Call a functor on every slot, passing each value once and leaving the slots in a valid but
+   * unspecified state.  Subject to the same restrictions as <code>enumerate</code>.  Useful for
+   * merging per-thread containers without copying them.
+   *
+   * @param f A functor with signature <code>void(T&&)</code>.
+   **/
+  template <typename F>
+  void combineEach(F&& f) {
+    enumerate([&f](T& value) { f(std::move(value)); });
+  }
+
+  /**
+   * Destroy every slot.  This is not concurrency safe.  Threads get fresh slots on their next
+   * access.
+   **/
+  void clear() {
+    for (size_t level = 0; level < kMaxLevels; ++level) {
+      std::atomic<Slot*>* table = levels_[level].load(std::memory_order_relaxed);
+      if (!table) {
+        continue;
+      }
+      for (size_t i = 0; i < (size_t{1} << level); ++i) {
+        if (Slot* slot = table[i].exchange(nullptr, std::memory_order_relaxed)) {
+          slot->~Slot();
+          detail::alignedFree(slot);
+        }
+      }
+    }
+    size_.store(0, std::memory_order_release);
+  }
+
+  ~ThreadLocal() {
+    clear();
+    for (size_t level = 0; level < kMaxLevels; ++level) {
+      delete[] levels_[level].load(std::memory_order_relaxed);
+    }
+  }
+
+ private:
+  struct alignas(kCacheLineSize) Slot {
+    explicit Slot(T&& v) : value(std::move(v)) {}
+    T value;
+  };
+
+  static constexpr size_t kMaxLevels = 64;
+
+  Slot* createSlot(size_t level, size_t offset) {
+    std::atomic<Slot*>* table = levels_[level].load(std::memory_order_acquire);
+    if (!table) {
+      // As in ConcurrentObjectArena, level k holds 2^k slot pointers, and tables are never moved.
+      std::atomic<Slot*>* fresh = new std::atomic<Slot*>[size_t{1} << level]();
+      if (levels_[level].compare_exchange_strong(
+              table, fresh, std::memory_order_acq_rel, std::memory_order_acquire)) {
+        table = fresh;
+      } else {
+        delete[] fresh;
+      }
+    }
+    void* mem = detail::alignedMalloc(sizeof(Slot), alignof(Slot));
+#if defined(__cpp_exceptions)
+    if (mem == nullptr) {
+      throw std::bad_alloc();
+    }
+#endif // __cpp_exceptions
+    Slot* slot = new (mem) Slot(init_());
+    table[offset].store(slot, std::memory_order_release);
+    size_.fetch_add(1, std::memory_order_acq_rel);
+    return slot;
+  }
+
+  template <typename F>
+  void forEachSlot(F&& f) {
+    for (size_t level = 0; level < kMaxLevels; ++level) {
+      std::atomic<Slot*>* table = levels_[level].load(std::memory_order_acquire);
+      if (!table) {
+        continue;
+      }
+      for (size_t i = 0; i < (size_t{1} << level); ++i) {
+        if (Slot* slot = table[i].load(std::memory_order_acquire)) {
+          f(slot);
+        }
+      }
+    }
+  }
+
+  std::function<T()> init_;
+  std::atomic<size_t> size_{0};
+  std::atomic<std::atomic<Slot*>*> levels_[kMaxLevels] = {};
+};
+
+template <typename T>
+constexpr size_t ThreadLocal<T>::kMaxLevels;
+
+} // namespace dispenso
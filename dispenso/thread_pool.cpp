@@ -7,6 +7,13 @@
 
 #include "thread_pool.h"
 
+#include <algorithm>
+#include <deque>
+
+#include <dispenso/thread_id.h>
+#include <dispenso/timing.h>
+#include <dispenso/topology.h>
+
 #ifdef _WIN32
 #include <Windows.h>
 #include <timeapi.h>
@@ -29,6 +36,210 @@ struct OsQuantaSetter {};
 #endif // _WIN32
 
 namespace dispenso {
+namespace detail {
+
+// The producer tokens that threads outside a pool have created on it.  Shared between the pool and
+// those threads' caches, so that whichever goes away first releases the tokens.
+struct ExternalProducers {
+  std::mutex mutex;
+  bool alive = true;
+  std::vector<moodycamel::ProducerToken*> tokens;
+};
+
+} // namespace detail
+
+namespace {
+std::atomic<uint64_t> g_nextPoolId{1};
+
+// How many pools a thread keeps tokens for.  The least recently added is released beyond this.
+constexpr size_t kMaxExternalProducers = 8;
+
+void releaseExternalProducer(
+    detail::ExternalProducers& producers,
+    moodycamel::ProducerToken* token) {
+  std::lock_guard<std::mutex> lk(producers.mutex);
+  if (!producers.alive) {
+    // The pool already released it.
+    return;
+  }
+  auto& tokens = producers.tokens;
+  tokens.erase(std::find(tokens.begin(), tokens.end(), token));
+  // The queue keeps the token's producer, and hands it to a later token once it is drained.
+  delete token;
+}
+
+// A thread's tokens on pools it isn't part of.  Without these, every thread that schedules
+// creates an implicit producer which the queue never frees, and which is looked up through a hash
+// table on each enqueue.
+class ExternalProducerCache {
+ public:
+  struct Entry {
+    uint64_t poolId;
+    moodycamel::ProducerToken* token;
+    std::shared_ptr<detail::ExternalProducers> producers;
+  };
+
+  ~ExternalProducerCache() {
+    detail::PerPoolPerThreadInfo::setExternalProducer(0, nullptr);
+    for (Entry& e : entries_) {
+      releaseExternalProducer(*e.producers, e.token);
+    }
+    entries_.clear();
+    destroyed() = true;
+  }
+
+  // Flags that the cache is gone, so that scheduling from later thread-exit destructors uses the
+  // implicit producers instead.
+  static bool& destroyed() {
+    static DISPENSO_THREAD_LOCAL bool gone = false;
+    return gone;
+  }
+
+  Entry* find(uint64_t poolId) {
+    for (Entry& e : entries_) {
+      if (e.poolId == poolId) {
+        return &e;
+      }
+    }
+    return nullptr;
+  }
+
+  void add(Entry entry) {
+    // Dead pools' tokens are already released.
+    entries_.erase(
+        std::remove_if(
+            entries_.begin(),
+            entries_.end(),
+            [](const Entry& e) {
+              std::lock_guard<std::mutex> lk(e.producers->mutex);
+              return !e.producers->alive;
+            }),
+        entries_.end());
+    if (entries_.size() >= kMaxExternalProducers) {
+      releaseExternalProducer(*entries_.front().producers, entries_.front().token);
+      entries_.pop_front();
+    }
+    entries_.push_back(std::move(entry));
+  }
+
+ private:
+  std::deque<Entry> entries_;
+};
+
+} // namespace
+
+constexpr size_t ThreadPool::kNoWorkerIndex;
+
+namespace {
+// Counters that are only ever written by one thread don't need atomic read-modify-write.
+void singleWriterAdd(std::atomic<uint64_t>& counter, uint64_t value) {
+  counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+uint64_t toNs(double seconds) {
+  return static_cast<uint64_t>(seconds * 1e9);
+}
+
+double toSeconds(const std::atomic<uint64_t>& ns) {
+  return static_cast<double>(ns.load(std::memory_order_relaxed)) * 1e-9;
+}
+
+// Attributes the time between successive marks to the given counter, while stats are enabled.
+class PhaseTimer {
+ public:
+  explicit PhaseTimer(const std::atomic<bool>& enabled) : enabled_(enabled) {}
+
+  void mark(std::atomic<uint64_t>& counterNs) {
+    if (DISPENSO_EXPECT(!enabled_.load(std::memory_order_relaxed), true)) {
+      last_ = 0.0;
+      return;
+    }
+    double now = getTime();
+    if (last_ > 0.0) {
+      singleWriterAdd(counterNs, toNs(now - last_));
+    }
+    last_ = now;
+  }
+
+  void count(std::atomic<uint64_t>& counter) {
+    if (DISPENSO_EXPECT(enabled_.load(std::memory_order_relaxed), false)) {
+      singleWriterAdd(counter, 1);
+    }
+  }
+
+ private:
+  const std::atomic<bool>& enabled_;
+  double last_ = 0.0;
+};
+
+// Tracks which phase of the idle backoff a thread is in, given the number of consecutive failed
+// polls and, for time-based policies, how long ago the thread ran out of work.
+class IdleBackoff {
+ public:
+  enum Phase { kSpin, kYield, kSleep };
+
+  explicit IdleBackoff(const BackoffPolicy& policy)
+      : spinIters_(policy.spinIterations),
+        yieldIters_(uint64_t{policy.spinIterations} + policy.yieldIterations),
+        spinSeconds_(static_cast<double>(policy.spinUs) * 1e-6),
+        yieldSeconds_((static_cast<double>(policy.spinUs) + policy.yieldUs) * 1e-6),
+        timed_(policy.spinUs != 0 || policy.yieldUs != 0) {}
+
+  void reset() {
+    failCount_ = 0;
+  }
+
+  Phase next() {
+    ++failCount_;
+    if (!timed_) {
+      return phaseFor(failCount_ <= spinIters_, failCount_ <= yieldIters_);
+    }
+    double now = getTime();
+    if (failCount_ == 1) {
+      idleStart_ = now;
+    }
+    double elapsed = now - idleStart_;
+    return phaseFor(
+        failCount_ <= spinIters_ || elapsed < spinSeconds_,
+        failCount_ <= yieldIters_ || elapsed < yieldSeconds_);
+  }
+
+ private:
+  static Phase phaseFor(bool spin, bool yield) {
+    return spin ? kSpin : (yield ? kYield : kSleep);
+  }
+
+  const uint64_t spinIters_;
+  const uint64_t yieldIters_;
+  const double spinSeconds_;
+  const double yieldSeconds_;
+  const bool timed_;
+  uint64_t failCount_ = 0;
+  double idleStart_ = 0.0;
+};
+
+// The order in which thread self visits the other deques when stealing in deterministic mode: a
+// shuffle drawn from a splitmix64 stream keyed on seed and self, so that it is the same on every
+// platform and every run.
+std::vector<size_t> seededStealOrder(size_t self, size_t numDeques, uint64_t seed) {
+  std::vector<size_t> order;
+  for (size_t i = 0; i < numDeques; ++i) {
+    if (i != self) {
+      order.push_back(i);
+    }
+  }
+  uint64_t state = seed ^ (0x9e3779b97f4a7c15ULL * (self + 1));
+  for (size_t i = order.size(); i > 1; --i) {
+    uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= z >> 31;
+    std::swap(order[i - 1], order[static_cast<size_t>(z % i)]);
+  }
+  return order;
+}
+} // namespace
+
 void ThreadPool::PerThreadData::setThread(std::thread&& t) {
   thread_ = std::move(t);
 }
@@ -38,12 +249,26 @@ void ThreadPool::PerThreadData::stop() {
 }
 
 uint32_t ThreadPool::wait(uint32_t currentEpoch) {
-  return epochWaiter_.waitFor(currentEpoch, sleepLengthUs_.load(std::memory_order_acquire));
+  DISPENSO_TRACE_SCOPE("sleep");
+  uint32_t sleepUs = sleepLengthUs_.load(std::memory_order_acquire);
+  if (timers_.pending()) {
+    // Wake in time for the next timer.
+    double untilDeadlineUs = (timers_.nextDeadline() - getTime()) * 1e6;
+    sleepUs = static_cast<uint32_t>(
+        std::max(1.0, std::min(static_cast<double>(sleepUs), untilDeadlineUs)));
+  }
+  return epochWaiter_.waitFor(currentEpoch, sleepUs);
 }
 void ThreadPool::wake() {
+  DISPENSO_TRACE_INSTANT("wake");
   epochWaiter_.bumpAndWake();
 }
 
+void ThreadPool::wake(ssize_t count) {
+  DISPENSO_TRACE_INSTANT("wake");
+  epochWaiter_.bumpAndWakeN(static_cast<uint32_t>(count));
+}
+
 inline bool ThreadPool::PerThreadData::running() {
   return running_.load(std::memory_order_acquire);
 }
@@ -51,7 +276,9 @@ inline bool ThreadPool::PerThreadData::running() {
 ThreadPool::ThreadPool(size_t n, size_t poolLoadMultiplier)
     : poolLoadMultiplier_(poolLoadMultiplier),
       poolLoadFactor_(static_cast<ssize_t>(n * poolLoadMultiplier)),
-      numThreads_(static_cast<ssize_t>(n)) {
+      numThreads_(static_cast<ssize_t>(n)),
+      id_(g_nextPoolId.fetch_add(1, std::memory_order_relaxed)),
+      externalProducers_(std::make_shared<detail::ExternalProducers>()) {
   static OsQuantaSetter quantaSetter;
   (void)quantaSetter;
 #if defined DISPENSO_DEBUG
@@ -59,23 +286,164 @@ ThreadPool::ThreadPool(size_t n, size_t poolLoadMultiplier)
 #endif // DISPENSO_DEBUG
   for (size_t i = 0; i < n; ++i) {
     threads_.emplace_back();
-    threads_.back().setThread(std::thread([this, &back = threads_.back()]() { threadLoop(back); }));
+    threads_.back().setThread(
+        std::thread([this, &back = threads_.back(), i]() { threadLoop(back, i); }));
+  }
+}
+
+ThreadPool::ThreadPool(size_t n, BackgroundStartTag, size_t poolLoadMultiplier)
+    : ThreadPool(0, poolLoadMultiplier) {
+  if (n) {
+    backgroundTarget_ = n;
+    backgroundStarter_ = std::thread([this]() { backgroundStartLoop(); });
+  }
+}
+
+void ThreadPool::backgroundStartLoop() {
+  {
+    std::lock_guard<std::mutex> lk(threadsMutex_);
+    if (enableWorkStealing_.load(std::memory_order_acquire) &&
+        stealDeques_.size() < backgroundTarget_) {
+      // Size the steal deques for the full pool up front, so that adding each thread does not need
+      // to stop every thread started before it.
+      growStealDequesLocked(backgroundTarget_);
+      resizeLocked(numThreads());
+    }
+  }
+  // The lock is retaken per thread, so that other pool operations need not wait for all threads.
+  while (true) {
+    std::lock_guard<std::mutex> lk(threadsMutex_);
+    size_t cur = static_cast<size_t>(numThreads_.load(std::memory_order_relaxed));
+    if (cur >= backgroundTarget_) {
+      backgroundTarget_ = 0;
+      return;
+    }
+    resizeLocked(static_cast<ssize_t>(cur + 1));
   }
 }
 
 ThreadPool::PerThreadData::~PerThreadData() {}
 
-void ThreadPool::threadLoop(PerThreadData& data) {
-  constexpr int kBackoffYield = 50;
-  constexpr int kBackoffSleep = kBackoffYield + 5;
+moodycamel::ProducerToken* ThreadPool::externalProducerSlow() {
+  if (ExternalProducerCache::destroyed()) {
+    return nullptr;
+  }
+  static thread_local ExternalProducerCache cache;
+  moodycamel::ProducerToken* token;
+  if (auto* entry = cache.find(id_)) {
+    token = entry->token;
+  } else {
+    token = new moodycamel::ProducerToken(work_);
+    {
+      std::lock_guard<std::mutex> lk(externalProducers_->mutex);
+      externalProducers_->tokens.push_back(token);
+    }
+    cache.add({id_, token, externalProducers_});
+  }
+  detail::PerPoolPerThreadInfo::setExternalProducer(id_, token);
+  return token;
+}
+
+bool ThreadPool::trySteal(WorkerContext& worker, OnceFunction& next) {
+  auto stealFrom = [&next](StealDeque* deque) {
+    if (detail::OnceCallable* callable = deque->steal()) {
+      DISPENSO_TRACE_INSTANT("steal");
+      next = OnceFunction(callable, true);
+      return true;
+    }
+    return false;
+  };
+
+  if (!worker.stealOrder.empty()) {
+    for (size_t victim : worker.stealOrder) {
+      if (stealFrom(stealDeques_[victim].get())) {
+        return true;
+      }
+    }
+    return false;
+  }
 
+  // Rotate the starting victim per thread so that thieves spread out across the deques.
+  static DISPENSO_THREAD_LOCAL size_t victim = 0;
+  const size_t numDeques = stealDeques_.size();
+  for (size_t i = 0; i < numDeques; ++i) {
+    if (++victim >= numDeques) {
+      victim = 0;
+    }
+    StealDeque* deque = stealDeques_[victim].get();
+    if (deque != worker.stealDeque && stealFrom(deque)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::startThread(size_t index, WorkerContext& worker) {
+  const bool deterministic = enableDeterministic_.load(std::memory_order_acquire);
+  if (enableWorkStealing_.load(std::memory_order_acquire)) {
+    worker.stealDeque = stealDeques_[index].get();
+    if (deterministic) {
+      worker.stealOrder = seededStealOrder(index, stealDeques_.size(), deterministicSeed_);
+    }
+  }
+
+  std::vector<int> cpus = affinity_;
+  if (deterministic) {
+    if (cpus.empty()) {
+      for (const NumaNode& node : numaTopology()) {
+        cpus.insert(cpus.end(), node.cpus.begin(), node.cpus.end());
+      }
+    }
+    cpus = {cpus[index % cpus.size()]};
+  }
+  if (enableNuma_.load(std::memory_order_acquire)) {
+    // Distribute threads round-robin over nodes, and over allowed cores within each node.
+    const size_t numNodes = nodeWork_.size();
+    size_t node = index % numNodes;
+    std::vector<int> nodeCpus;
+    for (int c : numaTopology()[node].cpus) {
+      bool allowed = affinity_.empty() ||
+          std::find(affinity_.begin(), affinity_.end(), c) != affinity_.end();
+      if (allowed) {
+        nodeCpus.push_back(c);
+      }
+    }
+    if (!nodeCpus.empty()) {
+      cpus = {nodeCpus[(index / numNodes) % nodeCpus.size()]};
+    }
+    worker.nodeWork = nodeWork_[node].get();
+  }
+  pinCurrentThread(cpus);
+
+  if (!threadNamePrefix_.empty()) {
+    setCurrentThreadName(threadNamePrefix_ + std::to_string(index));
+  }
+#if defined(DISPENSO_TRACING)
+  setTraceThreadName(
+      (threadNamePrefix_.empty() ? std::string("dispenso worker ") : threadNamePrefix_) +
+      std::to_string(index));
+#endif // DISPENSO_TRACING
+  if (threadStartHook_) {
+    threadStartHook_(index);
+  }
+}
+
+void ThreadPool::threadLoop(PerThreadData& data, size_t index) {
   moodycamel::ConsumerToken ctoken(work_);
   moodycamel::ProducerToken ptoken(work_);
 
   OnceFunction next;
 
-  int failCount = 0;
-  detail::PerPoolPerThreadInfo::registerPool(this, &ptoken);
+  WorkerContext worker;
+  worker.stats = &data.stats_;
+  startThread(index, worker);
+
+  WorkerStats& stats = data.stats_;
+  PhaseTimer timer(statsEnabled_);
+
+  IdleBackoff backoff(backoff_);
+  detail::PerPoolPerThreadInfo::registerPool(this, &ptoken, &worker, index);
+  notifyObserver([index](ThreadPoolObserver& o) { o.onWorkerStart(index); });
   uint32_t epoch = epochWaiter_.current();
 
   if (enableEpochWaiter_) {
@@ -83,72 +451,321 @@ void ThreadPool::threadLoop(PerThreadData& data) {
     idleButAwake_.fetch_add(1, std::memory_order_acq_rel);
 
     while (data.running()) {
-      while (work_.try_dequeue(ctoken, next)) {
+      while (tryDequeueWork(ctoken, worker, next)) {
         queuedWork_.fetch_sub(1, std::memory_order_acq_rel);
         if (idle) {
           idle = false;
           idleButAwake_.fetch_sub(1, std::memory_order_acq_rel);
         }
         executeNext(std::move(next));
-        failCount = 0;
+        backoff.reset();
       }
 
       if (!idle) {
         idle = true;
         idleButAwake_.fetch_add(1, std::memory_order_acq_rel);
+        timer.mark(stats.busyNs);
       }
 
-      ++failCount;
-
       detail::cpuRelax();
-      if (failCount > kBackoffSleep) {
+      IdleBackoff::Phase phase = backoff.next();
+      if (phase == IdleBackoff::kSleep) {
         idleButAwake_.fetch_sub(1, std::memory_order_acq_rel);
+        notifyObserver([index](ThreadPoolObserver& o) { o.onIdle(index); });
         epoch = wait(epoch);
+        notifyObserver([index](ThreadPoolObserver& o) { o.onWake(index); });
         idleButAwake_.fetch_add(1, std::memory_order_acq_rel);
-      } else if (failCount > kBackoffYield) {
+        timer.mark(stats.sleepNs);
+        timer.count(stats.sleeps);
+      } else if (phase == IdleBackoff::kYield) {
         std::this_thread::yield();
+        timer.mark(stats.yieldNs);
+      } else {
+        timer.mark(stats.spinNs);
       }
     }
     idleButAwake_.fetch_sub(1, std::memory_order_acq_rel);
   } else {
     while (data.running()) {
-      while (work_.try_dequeue(ctoken, next)) {
-        executeNext(std::move(next));
-        failCount = 0;
+      if (tryDequeueWork(ctoken, worker, next)) {
+        do {
+          executeNext(std::move(next));
+        } while (tryDequeueWork(ctoken, worker, next));
+        backoff.reset();
+        timer.mark(stats.busyNs);
       }
 
-      ++failCount;
-
       detail::cpuRelax();
-      if (failCount > kBackoffSleep) {
+      IdleBackoff::Phase phase = backoff.next();
+      if (phase == IdleBackoff::kSleep) {
+        notifyObserver([index](ThreadPoolObserver& o) { o.onIdle(index); });
         epoch = wait(epoch);
-      } else if (failCount > kBackoffYield) {
+        notifyObserver([index](ThreadPoolObserver& o) { o.onWake(index); });
+        timer.mark(stats.sleepNs);
+        timer.count(stats.sleeps);
+      } else if (phase == IdleBackoff::kYield) {
         std::this_thread::yield();
+        timer.mark(stats.yieldNs);
+      } else {
+        timer.mark(stats.spinNs);
+      }
+    }
+  }
+
+  if (worker.stealDeque) {
+    // Nobody else pushes to our deque, so once it is drained here it stays empty until a new
+    // thread takes ownership of it.
+    bool epochEnabled = enableEpochWaiter_.load(std::memory_order_acquire);
+    while (detail::OnceCallable* callable = worker.stealDeque->pop()) {
+      if (epochEnabled) {
+        queuedWork_.fetch_sub(1, std::memory_order_acq_rel);
       }
+      executeNext(OnceFunction(callable, true));
     }
   }
+
+  retireStats(stats);
+  notifyObserver([index](ThreadPoolObserver& o) { o.onWorkerStop(index); });
 }
 
-void ThreadPool::resizeLocked(ssize_t sn) {
-  assert(sn >= 0);
-  size_t n = static_cast<size_t>(sn);
+void ThreadPool::scheduleAfterSeconds(double delay, OnceFunction f) {
+  if (timers_.add(getTime() + delay, std::move(f))) {
+    // A sleeping thread may be due to wake after this deadline; have one recompute its sleep.
+    wake();
+  }
+}
 
-  if (n < threads_.size()) {
-    for (size_t i = n; i < threads_.size(); ++i) {
-      threads_[i].stop();
+void ThreadPool::pollTimersSlow() {
+  double now = getTime();
+  if (now < timers_.nextDeadline()) {
+    return;
+  }
+  std::vector<OnceFunction> due;
+  if (!timers_.collectExpired(now, due)) {
+    return;
+  }
+  for (auto& f : due) {
+    schedule(std::move(f), ForceQueuingTag());
+  }
+}
+
+void ThreadPool::retireStats(const WorkerStats& stats) {
+  SharedStats* shared = sharedStats_.load(std::memory_order_acquire);
+  if (!shared) {
+    return;
+  }
+  auto fold = [](std::atomic<uint64_t>& to, const std::atomic<uint64_t>& from) {
+    to.fetch_add(from.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  };
+  fold(shared->retired.tasksExecuted, stats.tasksExecuted);
+  fold(shared->retired.busyNs, stats.busyNs);
+  fold(shared->retired.spinNs, stats.spinNs);
+  fold(shared->retired.yieldNs, stats.yieldNs);
+  fold(shared->retired.sleepNs, stats.sleepNs);
+  fold(shared->retired.sleeps, stats.sleeps);
+  stats.scheduleLatency.addTo(shared->retired.scheduleLatency);
+}
+
+ThreadPool::StatsStripe* ThreadPool::statsStripe() {
+  SharedStats* shared = sharedStats_.load(std::memory_order_acquire);
+  return shared ? &shared->stripes[threadId() & (SharedStats::kNumStripes - 1)] : nullptr;
+}
+
+void ThreadPool::recordExecuted() {
+  WorkerContext* worker = localWorker(this);
+  if (worker) {
+    singleWriterAdd(worker->stats->tasksExecuted, 1);
+  } else if (StatsStripe* stripe = statsStripe()) {
+    stripe->externalTasksExecuted.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void ThreadPool::recordScheduleLatency(double scheduledAt) {
+  const double waited = getTime() - scheduledAt;
+  const uint64_t ns = waited > 0.0 ? toNs(waited) : 0;
+  WorkerContext* worker = localWorker(this);
+  if (worker) {
+    worker->stats->scheduleLatency.record(ns);
+  } else if (StatsStripe* stripe = statsStripe()) {
+    stripe->scheduleLatency.record(ns);
+  }
+}
+
+void ThreadPool::recordWake(uint64_t count) {
+  if (StatsStripe* stripe = statsStripe()) {
+    stripe->wakes.fetch_add(count, std::memory_order_relaxed);
+  }
+}
+
+void ThreadPool::recordQueueDepth(ssize_t depth) {
+  SharedStats* shared = sharedStats_.load(std::memory_order_acquire);
+  if (!shared) {
+    return;
+  }
+  ssize_t cur = shared->queueHighWater.load(std::memory_order_relaxed);
+  while (depth > cur &&
+         !shared->queueHighWater.compare_exchange_weak(cur, depth, std::memory_order_relaxed)) {
+  }
+}
+
+void ThreadPool::setBackoffPolicy(const BackoffPolicy& backoff) {
+  restartThreads([&]() {
+    backoff_ = backoff;
+  });
+}
+
+BackoffPolicy ThreadPool::backoffPolicy() const {
+  std::lock_guard<std::mutex> lk(threadsMutex_);
+  return backoff_;
+}
+
+void ThreadPool::setStatsEnabled(bool enable) {
+  std::lock_guard<std::mutex> lk(threadsMutex_);
+  if (enable && !sharedStats_.load(std::memory_order_relaxed)) {
+    sharedStats_.store(new SharedStats(), std::memory_order_release);
+  }
+  statsEnabled_.store(enable, std::memory_order_release);
+}
+
+void ThreadPool::setScheduleLatencyEnabled(bool enable) {
+  std::lock_guard<std::mutex> lk(threadsMutex_);
+  if (enable && !sharedStats_.load(std::memory_order_relaxed)) {
+    sharedStats_.store(new SharedStats(), std::memory_order_release);
+  }
+  latencyEnabled_.store(enable, std::memory_order_release);
+}
+
+ThreadPoolStats ThreadPool::stats() const {
+  auto convert = [](const WorkerStats& from) {
+    ThreadPoolStats::Thread to;
+    to.tasksExecuted = from.tasksExecuted.load(std::memory_order_relaxed);
+    to.busySeconds = toSeconds(from.busyNs);
+    to.spinSeconds = toSeconds(from.spinNs);
+    to.yieldSeconds = toSeconds(from.yieldNs);
+    to.sleepSeconds = toSeconds(from.sleepNs);
+    to.sleeps = from.sleeps.load(std::memory_order_relaxed);
+    from.scheduleLatency.addTo(to.scheduleLatency);
+    return to;
+  };
+
+  ThreadPoolStats result;
+  std::lock_guard<std::mutex> lk(threadsMutex_);
+  for (const auto& t : threads_) {
+    result.threads.push_back(convert(t.stats_));
+    result.scheduleLatency.merge(result.threads.back().scheduleLatency);
+  }
+  SharedStats* shared = sharedStats_.load(std::memory_order_acquire);
+  if (shared) {
+    result.retired = convert(shared->retired);
+    result.scheduleLatency.merge(result.retired.scheduleLatency);
+    for (const auto& stripe : shared->stripes) {
+      stripe.scheduleLatency.addTo(result.scheduleLatency);
+      result.externalTasksExecuted +=
+          stripe.externalTasksExecuted.load(std::memory_order_relaxed);
+      result.inlineTasks += stripe.inlineTasks.load(std::memory_order_relaxed);
+      result.wakes += stripe.wakes.load(std::memory_order_relaxed);
+    }
+    result.queueHighWater = shared->queueHighWater.load(std::memory_order_relaxed);
+  }
+  return result;
+}
+
+void ThreadPool::stopThreadsLocked(size_t n) {
+  for (size_t i = n; i < threads_.size(); ++i) {
+    threads_[i].stop();
+  }
+
+  while (threads_.size() > n) {
+    wake();
+    threads_.back().thread_.join();
+    threads_.pop_back();
+  }
+}
+
+bool ThreadPool::tryDequeueAnyNode(OnceFunction& next) {
+  if (nodeQueued_.load(std::memory_order_acquire) <= 0) {
+    return false;
+  }
+  for (auto& queue : nodeWork_) {
+    if (tryDequeueCounted(*queue, nodeQueued_, next)) {
+      return true;
     }
+  }
+  return false;
+}
 
-    while (threads_.size() > n) {
-      wake();
-      threads_.back().thread_.join();
-      threads_.pop_back();
+void ThreadPool::setNumaAware(bool enable) {
+  restartThreads([&]() {
+    if (enable && nodeWork_.empty()) {
+      for (size_t i = 0; i < numaTopology().size(); ++i) {
+        nodeWork_.emplace_back(std::make_unique<WorkQueue>());
+      }
     }
+    enableNuma_.store(enable, std::memory_order_release);
+  });
+}
 
+void ThreadPool::setAffinity(std::vector<int> cpus) {
+  restartThreads([&]() {
+    affinity_ = std::move(cpus);
+  });
+}
+
+void ThreadPool::setDeterministic(bool enable, uint64_t seed) {
+  restartThreads([&]() {
+    deterministicSeed_ = seed;
+    enableDeterministic_.store(enable, std::memory_order_release);
+  });
+}
+
+void ThreadPool::setThreadNamePrefix(std::string prefix) {
+  restartThreads([&]() {
+    threadNamePrefix_ = std::move(prefix);
+  });
+}
+
+void ThreadPool::setThreadStartHook(std::function<void(size_t)> hook) {
+  restartThreads([&]() {
+    threadStartHook_ = std::move(hook);
+  });
+}
+
+void ThreadPool::setObserver(ThreadPoolObserver* observer) {
+  restartThreads([&]() {
+    observer_.store(observer, std::memory_order_release);
+  });
+}
+
+void ThreadPool::setWorkStealing(bool enable) {
+  restartThreads([&]() {
+    enableWorkStealing_.store(enable, std::memory_order_release);
+  });
+}
+
+void ThreadPool::growStealDequesLocked(size_t n) {
+  // Thieves walk stealDeques_ without synchronization, so it may only grow while no pool threads
+  // are running.  The stopped threads are restarted by the next resizeLocked.
+  stopThreadsLocked(0);
+  while (stealDeques_.size() < n) {
+    stealDeques_.emplace_back(std::make_unique<StealDeque>());
+  }
+}
+
+void ThreadPool::resizeLocked(ssize_t sn) {
+  assert(sn >= 0);
+  size_t n = static_cast<size_t>(sn);
+
+  if (enableWorkStealing_.load(std::memory_order_acquire) && n > stealDeques_.size()) {
+    growStealDequesLocked(n);
+  }
+
+  if (n < threads_.size()) {
+    stopThreadsLocked(n);
   } else if (n > threads_.size()) {
     for (size_t i = threads_.size(); i < n; ++i) {
       threads_.emplace_back();
       threads_.back().setThread(
-          std::thread([this, &back = threads_.back()]() { threadLoop(back); }));
+          std::thread([this, &back = threads_.back(), i]() { threadLoop(back, i); }));
     }
   }
   poolLoadFactor_.store(static_cast<ssize_t>(n * poolLoadMultiplier_), std::memory_order_relaxed);
@@ -162,15 +779,188 @@ void ThreadPool::resizeLocked(ssize_t sn) {
   }
 }
 
+void ThreadPool::setElastic(const ElasticPolicy& policy) {
+  assert(policy.minThreads >= 1 && "Elastic pools need a thread to observe load with");
+  assert(policy.minThreads <= policy.maxThreads);
+  std::lock_guard<std::mutex> elk(elasticMutex_);
+  if (elasticThread_.joinable()) {
+    elasticRunning_.store(false, std::memory_order_release);
+    elasticThread_.join();
+  }
+  {
+    std::lock_guard<std::mutex> lk(threadsMutex_);
+    backgroundTarget_ = 0;
+    ssize_t currentPoolSize = numThreads();
+    size_t maxThreads = static_cast<size_t>(policy.maxThreads);
+    if (enableWorkStealing_.load(std::memory_order_acquire) && stealDeques_.size() < maxThreads) {
+      // Size the steal deques for the largest pool up front, so that growing does not need to stop
+      // every thread.  Only the deques are created; resizeLocked below restarts the threads.
+      growStealDequesLocked(maxThreads);
+    }
+    resizeLocked(std::min(policy.maxThreads, std::max(policy.minThreads, currentPoolSize)));
+  }
+  elasticRunning_.store(true, std::memory_order_release);
+  elasticThread_ = std::thread([this, policy]() { elasticLoop(policy); });
+}
+
+void ThreadPool::disableElastic() {
+  std::lock_guard<std::mutex> elk(elasticMutex_);
+  if (elasticThread_.joinable()) {
+    elasticRunning_.store(false, std::memory_order_release);
+    elasticThread_.join();
+  }
+}
+
+void ThreadPool::elasticLoop(ElasticPolicy policy) {
+  uint32_t saturated = 0;
+  uint32_t underused = 0;
+  while (elasticRunning_.load(std::memory_order_acquire)) {
+    std::this_thread::sleep_for(std::chrono::microseconds(policy.sampleUs));
+
+    ssize_t n = numThreads();
+    ssize_t work = workRemaining_.load(std::memory_order_relaxed);
+    if (work > n) {
+      ++saturated;
+      underused = 0;
+    } else if (2 * work < n) {
+      ++underused;
+      saturated = 0;
+    } else {
+      saturated = 0;
+      underused = 0;
+    }
+
+    ssize_t target = n;
+    if (saturated >= policy.growSamples && n < policy.maxThreads) {
+      // Grow toward the amount of outstanding work, but by at most half again per step.
+      target = std::min(policy.maxThreads, std::max(n + 1, std::min(work, n + n / 2)));
+      saturated = 0;
+    } else if (underused >= policy.shrinkSamples && n > policy.minThreads) {
+      target = n - 1;
+      underused = 0;
+    }
+
+    if (target != n) {
+      // Never block here: whoever holds the lock may be waiting for this thread to exit.
+      std::unique_lock<std::mutex> lk(threadsMutex_, std::try_to_lock);
+      if (lk.owns_lock()) {
+        resizeLocked(target);
+      }
+    }
+  }
+}
+
+bool ThreadPool::enterBlocking() {
+  if (!detail::PerPoolPerThreadInfo::isPoolRecursive(this)) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lk(spareMutex_);
+  if (stopSpares_.load(std::memory_order_relaxed)) {
+    return false;
+  }
+  if (blockedTasks_.fetch_add(1, std::memory_order_acq_rel) + 1 >
+      activeSpares_.load(std::memory_order_relaxed)) {
+    ssize_t active = activeSpares_.fetch_add(1, std::memory_order_relaxed) + 1;
+    ++spareTickets_;
+    if (static_cast<ssize_t>(spares_.size()) < active) {
+      spares_.emplace_back([this]() { spareLoop(); });
+    } else {
+      spareCv_.notify_one();
+    }
+  }
+  return true;
+}
+
+void ThreadPool::exitBlocking() {
+  // Spares notice on their own that they are no longer needed, so this need not lock.
+  ssize_t blocked = blockedTasks_.fetch_sub(1, std::memory_order_acq_rel);
+  assert(blocked > 0 && "exitBlocking called without a matching enterBlocking");
+  (void)blocked;
+}
+
+bool ThreadPool::spareRetiring() {
+  if (sparesUnneeded()) {
+    activeSpares_.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
+  return false;
+}
+
+void ThreadPool::spareLoop() {
+  // Spares help the way external threads do, but count as pool threads so that their tasks may
+  // block with compensation too.
+  moodycamel::ProducerToken ptoken(work_);
+  detail::PerPoolPerThreadInfo::registerPool(this, &ptoken);
+  IdleBackoff backoff{BackoffPolicy()};
+  uint32_t epoch = epochWaiter_.current();
+  std::unique_lock<std::mutex> lk(spareMutex_);
+  while (true) {
+    spareCv_.wait(lk, [this]() { return stopSpares_ || spareTickets_ > 0; });
+    if (!spareTickets_) {
+      return;
+    }
+    --spareTickets_;
+    lk.unlock();
+    while (true) {
+      if (tryExecuteNext()) {
+        backoff.reset();
+      } else {
+        detail::cpuRelax();
+        IdleBackoff::Phase phase = backoff.next();
+        if (phase == IdleBackoff::kSleep) {
+          epoch = wait(epoch);
+        } else if (phase == IdleBackoff::kYield) {
+          std::this_thread::yield();
+        }
+      }
+      if (sparesUnneeded()) {
+        lk.lock();
+        if (spareRetiring()) {
+          break;
+        }
+        lk.unlock();
+      }
+    }
+  }
+}
+
 ThreadPool::~ThreadPool() {
 #if defined DISPENSO_DEBUG
   assert(outstandingTaskSets_.load(std::memory_order_acquire) == 0);
 #endif // DISPENSO_DEBUG
 
+  if (backgroundStarter_.joinable()) {
+    {
+      std::lock_guard<std::mutex> tlk(threadsMutex_);
+      backgroundTarget_ = 0;
+    }
+    backgroundStarter_.join();
+  }
+
+  disableElastic();
+
+  {
+    std::lock_guard<std::mutex> slk(spareMutex_);
+    stopSpares_.store(true, std::memory_order_release);
+    spareCv_.notify_all();
+  }
+  wake(static_cast<ssize_t>(spares_.size()));
+  for (auto& t : spares_) {
+    t.join();
+  }
+
   // Strictly speaking, it is unnecessary to lock this in the destructor; however, it could be a
   // useful diagnostic to learn that the mutex is already locked when we reach this point.
   std::unique_lock<std::mutex> lk(threadsMutex_, std::try_to_lock);
   assert(lk.owns_lock());
+
+  // Pending timers still hold work that must run; it becomes ordinary queued work once due.
+  while (timers_.pending()) {
+    if (!tryExecuteNext()) {
+      std::this_thread::yield();
+    }
+  }
+
   for (auto& t : threads_) {
     t.stop();
     wake();
@@ -184,14 +974,47 @@ ThreadPool::~ThreadPool() {
     threads_.back().thread_.join();
     threads_.pop_back();
   }
+
+  {
+    // Threads that scheduled here may outlive the pool; their tokens must go before the queue.
+    std::lock_guard<std::mutex> plk(externalProducers_->mutex);
+    externalProducers_->alive = false;
+    for (moodycamel::ProducerToken* token : externalProducers_->tokens) {
+      delete token;
+    }
+    externalProducers_->tokens.clear();
+  }
+
+  delete sharedStats_.load(std::memory_order_acquire);
 }
-ThreadPool& globalThreadPool() {
-  // It should be illegal to access globalThreadPool after exiting main.
+namespace {
+std::atomic<bool> g_globalPoolBackgroundStart{false};
+std::atomic<bool> g_globalPoolCreated{false};
+
+ThreadPool& createGlobalThreadPool() {
+  g_globalPoolCreated.store(true, std::memory_order_release);
   // We default to hardware threads minus one because the calling thread usually is involved in
   // computation.
-  static ThreadPool pool(std::thread::hardware_concurrency() - 1);
+  const size_t numThreads = std::thread::hardware_concurrency() - 1;
+  if (g_globalPoolBackgroundStart.load(std::memory_order_acquire)) {
+    static ThreadPool pool(numThreads, BackgroundStartTag());
+    return pool;
+  }
+  static ThreadPool pool(numThreads);
   return pool;
 }
+} // namespace
+
+ThreadPool& globalThreadPool() {
+  // It should be illegal to access globalThreadPool after exiting main.
+  static ThreadPool& pool = createGlobalThreadPool();
+  return pool;
+}
+
+bool setGlobalThreadPoolBackgroundStart(bool enable) {
+  g_globalPoolBackgroundStart.store(enable, std::memory_order_release);
+  return !g_globalPoolCreated.load(std::memory_order_acquire);
+}
 
 void resizeGlobalThreadPool(size_t numThreads) {
   globalThreadPool().resize(static_cast<ssize_t>(numThreads));
@@ -13,20 +13,32 @@
 
 #pragma once
 
+#include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <chrono>
 #include <condition_variable>
 #include <cstdlib>
 #include <deque>
+#include <functional>
+#include <iterator>
+#include <memory>
 #include <mutex>
+#include <string>
 #include <thread>
+#include <vector>
 
 #include <concurrentqueue.h>
 
 #include <dispenso/detail/epoch_waiter.h>
 #include <dispenso/detail/per_thread_info.h>
+#include <dispenso/detail/timer_wheel.h>
+#include <dispenso/detail/work_stealing_deque.h>
+#include <dispenso/latency_histogram.h>
 #include <dispenso/once_function.h>
 #include <dispenso/platform.h>
+#include <dispenso/timing.h>
+#include <dispenso/trace.h>
 #include <dispenso/tsan_annotations.h>
 
 namespace dispenso {
@@ -41,6 +53,11 @@ namespace dispenso {
 
 constexpr uint32_t kDefaultSleepLenUs = DISPENSO_POLL_PERIOD_US;
 
+namespace detail {
+struct ForkJoinAccess;
+struct ExternalProducers;
+} // namespace detail
+
 #if defined(__WIN32)
 constexpr bool kDefaultWakeupEnable = true;
 #else
@@ -54,6 +71,197 @@ constexpr bool kDefaultWakeupEnable = false;
  **/
 struct ForceQueuingTag {};
 
+/**
+ * A tag specifier for the ThreadPool constructor, denoting that the pool's threads should be
+ * started on a background thread instead of by the constructor.
+ **/
+struct BackgroundStartTag {};
+
+/**
+ * Priority levels for scheduled work.  Pool threads always drain <code>kHigh</code> work before
+ * <code>kNormal</code> work, and <code>kNormal</code> work before <code>kLow</code> work.  Priority
+ * only affects ordering of queued work; it does not preempt running work.
+ **/
+enum class TaskPriority { kHigh, kNormal, kLow };
+
+/**
+ * A snapshot of ThreadPool statistics, as returned by <code>ThreadPool::stats()</code>.  All
+ * counters are cumulative from the time statistics were first enabled.  Times are in seconds,
+ * except that latency histograms are in nanoseconds.
+ **/
+struct ThreadPoolStats {
+  /**
+   * Statistics for a single pool thread.
+   **/
+  struct Thread {
+    /** The number of tasks run by this thread. **/
+    uint64_t tasksExecuted = 0;
+    /** Time spent finding and running work. **/
+    double busySeconds = 0.0;
+    /** Time spent polling for work in a busy loop. **/
+    double spinSeconds = 0.0;
+    /** Time spent polling for work while yielding the CPU between polls. **/
+    double yieldSeconds = 0.0;
+    /** Time spent sleeping while waiting for work. **/
+    double sleepSeconds = 0.0;
+    /** The number of times this thread went to sleep. **/
+    uint64_t sleeps = 0;
+    /**
+     * The time queued tasks run by this thread waited between being scheduled and starting (see
+     * <code>ThreadPool::setScheduleLatencyEnabled</code>).
+     **/
+    LatencyHistogram scheduleLatency;
+  };
+
+  /** Per-thread statistics, indexed by pool thread index. **/
+  std::vector<Thread> threads;
+  /** Accumulated statistics of threads that have since exited (e.g. due to resize). **/
+  Thread retired;
+  /** The number of pool tasks run by threads outside the pool, e.g. inside TaskSet::wait. **/
+  uint64_t externalTasksExecuted = 0;
+  /** The number of tasks run inline by the scheduling thread instead of being queued. **/
+  uint64_t inlineTasks = 0;
+  /** The number of wakeups issued to sleeping threads. **/
+  uint64_t wakes = 0;
+  /** The largest number of outstanding (queued or running) tasks seen while enqueuing. **/
+  ssize_t queueHighWater = 0;
+  /**
+   * The time queued tasks waited between being scheduled and starting, merged over pool threads,
+   * retired threads, and threads outside the pool.
+   **/
+  LatencyHistogram scheduleLatency;
+};
+
+/**
+ * Whether ThreadPoolObserver callbacks are compiled in (the DISPENSO_OBSERVERS CMake option).
+ **/
+#if defined(DISPENSO_OBSERVERS)
+constexpr bool kObserversCompiledIn = true;
+#else
+constexpr bool kObserversCompiledIn = false;
+#endif // DISPENSO_OBSERVERS
+
+/**
+ * An interface for following the life of a ThreadPool's threads and tasks, e.g. to forward them
+ * to an external profiler such as Tracy or VTune's ITT API.  Install one with
+ * <code>ThreadPool::setObserver</code>.  Callbacks are made only when dispenso is built with
+ * DISPENSO_OBSERVERS defined; otherwise the hooks compile to nothing.  Every callback has an empty
+ * default implementation, and may be called concurrently from multiple threads.
+ **/
+class ThreadPoolObserver {
+ public:
+  virtual ~ThreadPoolObserver() = default;
+
+  /**
+   * Called on a pool thread when it starts, before it runs any work.
+   *
+   * @param index The thread's index within the pool.
+   **/
+  virtual void onWorkerStart(size_t /*index*/) {}
+
+  /**
+   * Called on a pool thread just before it exits.
+   *
+   * @param index The thread's index within the pool.
+   **/
+  virtual void onWorkerStop(size_t /*index*/) {}
+
+  /**
+   * Called on the running thread just before a queued pool task runs.  This may be a pool thread
+   * or a thread helping while it waits, e.g. in <code>TaskSet::wait</code>.  Tasks run inline by
+   * the scheduling thread are not reported.
+   **/
+  virtual void onTaskBegin() {}
+
+  /**
+   * Called on the running thread just after a queued pool task finishes.
+   **/
+  virtual void onTaskEnd() {}
+
+  /**
+   * Called on a pool thread when it runs out of work and goes to sleep.
+   *
+   * @param index The thread's index within the pool.
+   **/
+  virtual void onIdle(size_t /*index*/) {}
+
+  /**
+   * Called on a pool thread when it wakes from sleep, whether it was signaled or timed out.
+   *
+   * @param index The thread's index within the pool.
+   **/
+  virtual void onWake(size_t /*index*/) {}
+};
+
+/**
+ * Controls how idle pool threads back off before going to sleep.  An idle thread first spins
+ * (polling in a busy loop), then polls while yielding the CPU, and finally sleeps (see
+ * <code>ThreadPool::setSignalingWake</code>).  Each phase lasts for its iteration count, or, if its
+ * time budget is nonzero, until that much time has elapsed since the thread ran out of work,
+ * whichever is longer.
+ **/
+struct BackoffPolicy {
+  /** The number of polls in the spin phase. **/
+  uint32_t spinIterations = 50;
+  /** The number of polls in the yield phase. **/
+  uint32_t yieldIterations = 5;
+  /** If nonzero, the minimum wall-clock duration of the spin phase, in microseconds. **/
+  uint32_t spinUs = 0;
+  /** If nonzero, the minimum wall-clock duration of the yield phase, in microseconds. **/
+  uint32_t yieldUs = 0;
+
+  /**
+   * A policy favoring wake-up latency: threads spin for a fixed time budget before yielding and
+   * sleeping.
+   *
+   * @param spinBudget The length of time to spin.
+   * @return The policy.
+   **/
+  template <class Rep, class Period>
+  static BackoffPolicy lowLatency(const std::chrono::duration<Rep, Period>& spinBudget) {
+    BackoffPolicy policy;
+    policy.spinUs = static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(spinBudget).count());
+    return policy;
+  }
+
+  /**
+   * A policy favoring CPU efficiency: threads go to sleep almost immediately after running out of
+   * work.  Suitable for batch jobs on shared machines.
+   *
+   * @return The policy.
+   **/
+  static BackoffPolicy efficient() {
+    BackoffPolicy policy;
+    policy.spinIterations = 1;
+    policy.yieldIterations = 1;
+    return policy;
+  }
+};
+
+/**
+ * Settings for a pool's elastic mode, in which a monitor thread periodically samples the amount of
+ * outstanding work and resizes the pool between <code>minThreads</code> and
+ * <code>maxThreads</code>.  The pool grows quickly when work outnumbers threads and shrinks one
+ * thread at a time after a long run of light load, so that bursty workloads do not cause the pool
+ * to oscillate.
+ **/
+struct ElasticPolicy {
+  /** The fewest threads the pool shrinks to.  Must be at least 1. **/
+  ssize_t minThreads = 1;
+  /** The most threads the pool grows to. **/
+  ssize_t maxThreads = static_cast<ssize_t>(std::thread::hardware_concurrency());
+  /** The interval between load samples, in microseconds. **/
+  uint32_t sampleUs = 1000;
+  /** The number of consecutive samples with more outstanding tasks than threads before growing. **/
+  uint32_t growSamples = 2;
+  /**
+   * The number of consecutive samples with fewer outstanding tasks than half the threads before
+   * shrinking by one thread.
+   **/
+  uint32_t shrinkSamples = 1000;
+};
+
 /**
  * The basic executor for dispenso.  It provides typical thread pool functionality, plus allows work
  * stealing by related types (e.g. TaskSet, Future, etc...), which prevents deadlock when waiting
@@ -70,6 +278,21 @@ class alignas(kCacheLineSize) ThreadPool {
    **/
   DISPENSO_DLL_ACCESS ThreadPool(size_t n, size_t poolLoadMultiplier = 32);
 
+  /**
+   * Construct a thread pool whose threads are started one at a time on a background thread, so
+   * that construction is cheap even for very large pools.  The pool starts out with no threads,
+   * running functors inline like any pool without threads, and <code>numThreads</code> grows
+   * toward <code>n</code> as threads come up.  A call to <code>resize</code>,
+   * <code>setElastic</code>, or a setter that restarts the pool's threads (such as
+   * <code>setWorkStealing</code>, <code>setObserver</code>, or <code>setNumaAware</code>) before
+   * all threads are up stops the background start.
+   *
+   * @param n The number of threads to start in the background.
+   * @param poolLoadMultiplier A parameter that specifies how overloaded the pool should be before
+   * allowing the current thread to self-steal work.
+   **/
+  DISPENSO_DLL_ACCESS ThreadPool(size_t n, BackgroundStartTag, size_t poolLoadMultiplier = 32);
+
   /**
    * Enable or disable signaling wake functionality.  If enabled, this will try to ensure that
    * threads are woken up proactively when work has not been available and it becomes available.
@@ -99,6 +322,203 @@ class alignas(kCacheLineSize) ThreadPool {
             std::chrono::duration_cast<std::chrono::microseconds>(sleepDuration).count()));
   }
 
+  /**
+   * Enable or disable signaling wake functionality, and set the idle backoff policy at the same
+   * time, restarting threads only once.  This function is blocking and potentially very slow.
+   * Repeated use is discouraged.
+   *
+   * @param enable If set true, turns on signaling wake.  If false, turns it off.
+   * @param sleepDuration As for the two-argument overload.
+   * @param backoff How idle threads spin and yield before sleeping.
+   **/
+  template <class Rep, class Period>
+  void setSignalingWake(
+      bool enable,
+      const std::chrono::duration<Rep, Period>& sleepDuration,
+      const BackoffPolicy& backoff) {
+    setSignalingWake(
+        enable,
+        static_cast<uint32_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(sleepDuration).count()),
+        &backoff);
+  }
+
+  /**
+   * Set the policy idle threads use to back off before sleeping.  The default spins for 50 polls
+   * and yields for 5 before sleeping.  This function is blocking and potentially very slow.
+   * Repeated use is discouraged.
+   *
+   * @param backoff The new policy.
+   **/
+  DISPENSO_DLL_ACCESS void setBackoffPolicy(const BackoffPolicy& backoff);
+
+  /**
+   * Get the current idle backoff policy.
+   *
+   * @return The policy.
+   **/
+  DISPENSO_DLL_ACCESS BackoffPolicy backoffPolicy() const;
+
+  /**
+   * Enable or disable work-stealing mode.  When enabled, each pool thread owns a deque; work
+   * scheduled from a pool thread is pushed onto that thread's own deque and popped LIFO, and idle
+   * threads steal FIFO from the deques of other threads.  Work scheduled from threads outside the
+   * pool continues to go through the shared queue.  Only pool threads steal: a thread outside the
+   * pool that waits on a TaskSet helps with work from the shared queues, but leaves work in the
+   * deques to the pool threads that own them.  This tends to help recursive, fork-join style
+   * workloads (e.g. nested TaskSets) through better locality and less contention on the shared
+   * queue.  This function is blocking and potentially very slow.  Repeated use is discouraged.
+   *
+   * @param enable If set true, turns on work-stealing.  If false, turns it off.
+   **/
+  DISPENSO_DLL_ACCESS void setWorkStealing(bool enable);
+
+  /**
+   * Query whether work-stealing mode is enabled.
+   *
+   * @return true if work-stealing is enabled, false otherwise.
+   **/
+  bool workStealing() const {
+    return enableWorkStealing_.load(std::memory_order_acquire);
+  }
+
+  /**
+   * Enable or disable NUMA-aware mode.  When enabled, pool threads are assigned round-robin to the
+   * machine's NUMA nodes (see <code>numaTopology()</code>) and pinned to a core within their node.
+   * Each node gets its own queue; work scheduled from a pool thread goes to its node's queue, and
+   * threads only take work from other nodes' queues once their own node's queue and the shared
+   * queue are empty.  Use <code>scheduleOnNode</code> to place work on a particular node.  This
+   * function is blocking and potentially very slow.  Repeated use is discouraged.
+   *
+   * @param enable If set true, turns on NUMA-aware mode.  If false, turns it off.
+   **/
+  DISPENSO_DLL_ACCESS void setNumaAware(bool enable);
+
+  /**
+   * Query whether NUMA-aware mode is enabled.
+   *
+   * @return true if NUMA-aware mode is enabled, false otherwise.
+   **/
+  bool numaAware() const {
+    return enableNuma_.load(std::memory_order_acquire);
+  }
+
+  /**
+   * Get the number of NUMA nodes work can be placed on via <code>scheduleOnNode</code>.
+   *
+   * @return The number of NUMA nodes if NUMA-aware mode is enabled, or 1 otherwise.
+   **/
+  size_t numNumaNodes() const {
+    return numaAware() ? nodeWork_.size() : 1;
+  }
+
+  /**
+   * Restrict pool threads to run only on the given logical CPUs, e.g. to keep them off of cores
+   * reserved for other work.  If NUMA-aware mode is also enabled, each thread is pinned to a core
+   * of its node that is also in <code>cpus</code> (or to all of <code>cpus</code> if the node has
+   * none of them).  This function is blocking and potentially very slow.  Repeated use is
+   * discouraged.
+   *
+   * @param cpus The logical CPUs pool threads may run on.  An empty list removes the restriction
+   * for subsequently started threads.
+   *
+   * @note Pinning is not supported on all platforms (e.g. MacOs), in which case this is a no-op.
+   **/
+  DISPENSO_DLL_ACCESS void setAffinity(std::vector<int> cpus);
+
+  /**
+   * Enable or disable deterministic mode, for benchmarks and performance investigations that need
+   * runs to be repeatable.  When enabled, each pool thread is pinned to a single CPU: thread i gets
+   * the i-th CPU of <code>setAffinity</code>'s list, or of the machine's CPUs if there is none,
+   * wrapping around, or its usual core of its node in NUMA-aware mode.  With work-stealing, each
+   * thread visits the other threads' deques in a fixed order drawn from <code>seed</code> and the
+   * thread's index, rather than a rotating one.  And <code>parallel_for</code> loops that wait,
+   * and do not bring their own AffinityPartitioner, hand out chunks as one would that starts from
+   * an even split, so that each thread runs the same share of the range every time, and only
+   * steals chunks whose thread is late.  Scheduling still depends on timing, so runs repeat
+   * closely rather than exactly.  This function is blocking and potentially very slow.  Repeated
+   * use is discouraged.
+   *
+   * @param enable If set true, turns on deterministic mode.  If false, turns it off.
+   * @param seed The seed of the threads' steal orders.
+   *
+   * @note Pinning is not supported on all platforms (e.g. MacOs), in which case threads are not
+   * pinned.
+   **/
+  DISPENSO_DLL_ACCESS void setDeterministic(bool enable, uint64_t seed = 0);
+
+  /**
+   * Query whether deterministic mode is enabled.
+   *
+   * @return true if deterministic mode is enabled, false otherwise.
+   **/
+  bool deterministic() const {
+    return enableDeterministic_.load(std::memory_order_acquire);
+  }
+
+  /**
+   * Name pool threads <code>prefix</code> followed by their index in the pool, so that they are
+   * identifiable in debuggers, profilers, and tools like top and perf.  This function is blocking
+   * and potentially very slow.  Repeated use is discouraged.
+   *
+   * @param prefix The name prefix.  Platforms may truncate names (Linux allows 15 characters).
+   **/
+  DISPENSO_DLL_ACCESS void setThreadNamePrefix(std::string prefix);
+
+  /**
+   * Set a hook to be run inside each pool thread when it starts, before it begins to run work.
+   * The hook receives the index of the thread within the pool.  Affinity and naming (see
+   * <code>setAffinity</code> and <code>setThreadNamePrefix</code>) are applied before the hook
+   * runs, so the hook may override them.  Current threads are restarted so that the hook runs on
+   * every pool thread.  This function is blocking and potentially very slow.  Repeated use is
+   * discouraged.
+   *
+   * @param hook The function to run.  It is called concurrently from multiple pool threads, and
+   * must not call functions on this pool that restart threads (e.g. <code>resize</code>).
+   **/
+  DISPENSO_DLL_ACCESS void setThreadStartHook(std::function<void(size_t)> hook);
+
+  /**
+   * Install an observer whose callbacks follow the pool's threads and tasks (see
+   * ThreadPoolObserver).  Current threads are restarted so that the observer sees every pool
+   * thread start.  This function is blocking and potentially very slow.  Repeated use is
+   * discouraged.  Without DISPENSO_OBSERVERS, the observer is stored but never called.
+   *
+   * @param observer The observer, or nullptr to remove it.  It must outlive the pool, or its
+   * removal, and must not be replaced while threads outside the pool may be running pool tasks.
+   **/
+  DISPENSO_DLL_ACCESS void setObserver(ThreadPoolObserver* observer);
+
+  /**
+   * Enable or disable collection of statistics.  Statistics are off by default; when off, the
+   * cost is a single predictable branch in the scheduling and execution paths.  Counters are kept
+   * per-thread (or striped across cache lines for scheduling threads) to avoid adding contention.
+   *
+   * @param enable If set true, statistics are collected.  If false, collection stops, but existing
+   * counts are retained.
+   **/
+  DISPENSO_DLL_ACCESS void setStatsEnabled(bool enable);
+
+  /**
+   * Enable or disable measuring schedule-to-start latency.  While enabled, each queued task is
+   * stamped with the time it was scheduled, and the thread that runs it records how long it waited
+   * into a per-thread histogram, reported by <code>stats()</code>.  Tasks run inline by the
+   * scheduling thread are not measured.  This costs two timestamps per task, and is independent
+   * of <code>setStatsEnabled</code>.
+   *
+   * @param enable If set true, latencies are recorded.  If false, tasks scheduled from then on are
+   * no longer stamped, but existing histograms are retained.
+   **/
+  DISPENSO_DLL_ACCESS void setScheduleLatencyEnabled(bool enable);
+
+  /**
+   * Get a snapshot of pool statistics.  Counters are read without stopping the pool, and so are
+   * only approximately consistent with one another.
+   *
+   * @return The current statistics.
+   **/
+  DISPENSO_DLL_ACCESS ThreadPoolStats stats() const;
+
   /**
    * Change the number of threads backing the thread pool.  This is a blocking and potentially
    * slow operation, and repeatedly resizing is discouraged.
@@ -107,6 +527,7 @@ class alignas(kCacheLineSize) ThreadPool {
    **/
   DISPENSO_DLL_ACCESS void resize(ssize_t n) {
     std::lock_guard<std::mutex> lk(threadsMutex_);
+    backgroundTarget_ = 0;
     resizeLocked(n);
   }
 
@@ -120,6 +541,70 @@ class alignas(kCacheLineSize) ThreadPool {
     return numThreads_.load(std::memory_order_relaxed);
   }
 
+  /**
+   * The value <code>currentWorkerIndex</code> returns on threads that are not workers of the pool.
+   **/
+  static constexpr size_t kNoWorkerIndex = detail::kNoWorkerIndex;
+
+  /**
+   * Get the calling thread's dense index among the pool's threads, e.g. to index an array of
+   * per-worker scratch space.  Cheap enough for hot paths; it reads a thread-local.
+   *
+   * @return An index in [0, numThreads()) if the calling thread is one of the pool's threads, or
+   * <code>kNoWorkerIndex</code> otherwise, including for threads helping while waiting on a
+   * TaskSet and for spare threads started for a BlockingRegion.  While the pool
+   * shrinks, a thread being stopped may briefly report an index at or above the new size, so size
+   * such arrays for the largest the pool will be.
+   **/
+  size_t currentWorkerIndex() const {
+    return detail::PerPoolPerThreadInfo::workerIndex(this);
+  }
+
+  /**
+   * Turn on elastic mode, in which the pool resizes itself between the policy's minimum and maximum
+   * number of threads based on load.  The pool is immediately resized into that range if
+   * necessary.  If elastic mode is already on, the new policy replaces the old one.  Explicit calls
+   * to <code>resize</code> remain legal, though the monitor may later undo them.
+   *
+   * @param policy The elastic settings.
+   **/
+  DISPENSO_DLL_ACCESS void setElastic(const ElasticPolicy& policy);
+
+  /**
+   * Turn off elastic mode, leaving the pool at its current size.  Does nothing if elastic mode is
+   * off.
+   **/
+  DISPENSO_DLL_ACCESS void disableElastic();
+
+  /**
+   * Check whether elastic mode is on.
+   *
+   * @return true if the pool is resizing itself.
+   **/
+  bool elastic() const {
+    return elasticRunning_.load(std::memory_order_acquire);
+  }
+
+  /**
+   * Tell the pool that the calling task is about to block (e.g. on file I/O), so that the pool
+   * can activate a spare thread to keep its effective parallelism up meanwhile.  Spare threads
+   * are created on demand and parked, rather than destroyed, once no longer needed.  Prefer the
+   * scoped BlockingRegion to calling this directly.
+   *
+   * @return true if the calling task was counted as blocked, in which case
+   * <code>exitBlocking</code> must be called once the blocking call returns.  A spare thread is
+   * activated only if blocked tasks outnumber the active spares.  Only this pool's own threads
+   * are compensated for, so this returns false when called from any other thread, or while the
+   * pool is being destroyed.
+   **/
+  DISPENSO_DLL_ACCESS bool enterBlocking();
+
+  /**
+   * Tell the pool that a task which called <code>enterBlocking</code> has stopped blocking.  A
+   * spare thread returns to its parked state once it finishes the task it is running, if any.
+   **/
+  DISPENSO_DLL_ACCESS void exitBlocking();
+
   /**
    * Schedule a functor to be executed.  If the pool's load factor is high, execution may happen
    * inline by the calling thread.
@@ -143,13 +628,135 @@ class alignas(kCacheLineSize) ThreadPool {
   void schedule(F&& f, ForceQueuingTag);
 
   /**
-   * Destruct the pool.  This destructor is blocking until all queued work is completed.  It is
-   * illegal to call the destructor while any other thread makes calls to the pool (as is generally
-   * the case with C++ classes).
+   * Schedule a functor to be executed at the given priority.  If the pool's load factor is high,
+   * execution may happen inline by the calling thread.
+   *
+   * @param f The functor to be executed.  <code>f</code>'s signature must match void().
+   * @param priority The priority at which <code>f</code> should be queued.
+   **/
+  template <typename F>
+  void schedule(F&& f, TaskPriority priority);
+
+  /**
+   * Schedule a functor to be executed at the given priority.  The functor will always be queued
+   * and executed by pool threads.
+   *
+   * @param f The functor to be executed.  <code>f</code>'s signature must match void().
+   * @param priority The priority at which <code>f</code> should be queued.
+   **/
+  template <typename F>
+  void schedule(F&& f, TaskPriority priority, ForceQueuingTag);
+
+  /**
+   * Schedule a functor to be executed, preferably by a thread on the given NUMA node.  The functor
+   * will always be queued.  Threads on other nodes may still run the functor if their own node runs
+   * out of work.  If NUMA-aware mode is disabled, this is equivalent to
+   * <code>schedule(f, ForceQueuingTag())</code>.
+   *
+   * @param f The functor to be executed.  <code>f</code>'s signature must match void().
+   * @param node The NUMA node index, in the range [0, numNumaNodes()).  Values out of range wrap.
+   **/
+  template <typename F>
+  void scheduleOnNode(F&& f, size_t node);
+
+  /**
+   * Schedule a batch of functors to be executed.  This is cheaper than calling
+   * <code>schedule</code> <code>count</code> times: bookkeeping counters are updated once, the
+   * functors are enqueued in bulk, and at most <code>count</code> sleeping threads are woken.  If
+   * the pool is already sufficiently loaded, the whole batch is executed inline instead.
+   *
+   * @param count The number of functors to schedule.
+   * @param gen A generator with signature <code>F(size_t index)</code>, returning a functor with
+   * signature void().  It is called exactly once per index, in increasing order, on the calling
+   * thread, before this function returns.
+   **/
+  template <typename Gen>
+  void scheduleBulk(size_t count, Gen&& gen);
+
+  /**
+   * Schedule a batch of functors to be executed.  The functors will always be queued and executed
+   * by pool threads.
+   *
+   * @param count The number of functors to schedule.
+   * @param gen A generator as for the two-argument overload.
+   **/
+  template <typename Gen>
+  void scheduleBulk(size_t count, Gen&& gen, ForceQueuingTag);
+
+  /**
+   * Schedule a functor to be executed once the given time has been reached.  Timers are kept in a
+   * timer wheel serviced by the pool threads themselves as they look for work, and sleeping
+   * threads bound their sleep by the earliest deadline, so no separate timer thread is involved.
+   * Once due, the functor is queued like any other work, and so may run later than the deadline
+   * when the pool is busy.  If the pool has no threads, due timers run whenever the pool is polled
+   * for work, e.g. from <code>TaskSet::wait</code>.
+   *
+   * @param timePoint The earliest time at which to run <code>f</code>.  Times in the past make
+   * <code>f</code> due immediately.
+   * @param f The functor to be executed.  <code>f</code>'s signature must match void().
+   **/
+  template <typename Clock, typename Duration, typename F>
+  void scheduleAt(const std::chrono::time_point<Clock, Duration>& timePoint, F&& f) {
+    scheduleAfter(timePoint - Clock::now(), std::forward<F>(f));
+  }
+
+  /**
+   * Schedule a functor to be executed once the given delay has elapsed.  See
+   * <code>scheduleAt</code> for details.
+   *
+   * @param delay The minimum delay before running <code>f</code>.
+   * @param f The functor to be executed.  <code>f</code>'s signature must match void().
+   **/
+  template <typename Rep, typename Period, typename F>
+  void scheduleAfter(const std::chrono::duration<Rep, Period>& delay, F&& f) {
+    scheduleAfterSeconds(
+        std::chrono::duration<double>(delay).count(), OnceFunction(std::forward<F>(f)));
+  }
+
+  /**
+   * Destruct the pool.  This destructor is blocking until all queued work is completed, including
+   * work scheduled with <code>scheduleAt</code>, whose deadlines are waited for.  It is illegal to
+   * call the destructor while any other thread makes calls to the pool (as is generally the case
+   * with C++ classes).
    **/
   DISPENSO_DLL_ACCESS ~ThreadPool();
 
  private:
+  // Written only by the owning thread; read by stats().
+  struct alignas(kCacheLineSize) WorkerStats {
+    std::atomic<uint64_t> tasksExecuted{0};
+    std::atomic<uint64_t> busyNs{0};
+    std::atomic<uint64_t> spinNs{0};
+    std::atomic<uint64_t> yieldNs{0};
+    std::atomic<uint64_t> sleepNs{0};
+    std::atomic<uint64_t> sleeps{0};
+    detail::AtomicLatencyHistogram scheduleLatency;
+  };
+
+  // Counters updated from arbitrary threads, striped by thread to avoid contention.
+  struct alignas(kCacheLineSize) StatsStripe {
+    std::atomic<uint64_t> externalTasksExecuted{0};
+    std::atomic<uint64_t> inlineTasks{0};
+    std::atomic<uint64_t> wakes{0};
+    detail::AtomicLatencyHistogram scheduleLatency;
+  };
+
+  struct SharedStats {
+    static constexpr size_t kNumStripes = 16;
+    StatsStripe stripes[kNumStripes];
+    alignas(kCacheLineSize) std::atomic<ssize_t> queueHighWater{0};
+    WorkerStats retired;
+
+#if __cplusplus < 201703L
+    static void* operator new(size_t sz) {
+      return detail::alignedMalloc(sz);
+    }
+    static void operator delete(void* ptr) {
+      return detail::alignedFree(ptr);
+    }
+#endif // __cplusplus
+  };
+
   class PerThreadData {
    public:
     void setThread(std::thread&& t);
@@ -163,42 +770,213 @@ class alignas(kCacheLineSize) ThreadPool {
    public:
     alignas(kCacheLineSize) std::thread thread_;
     std::atomic<bool> running_{true};
+    alignas(kCacheLineSize) WorkerStats stats_;
   };
 
   DISPENSO_DLL_ACCESS uint32_t wait(uint32_t priorEpoch);
   DISPENSO_DLL_ACCESS void wake();
+  // Wake up to count sleeping threads with a single system call.
+  DISPENSO_DLL_ACCESS void wake(ssize_t count);
 
-  void setSignalingWake(bool enable, uint32_t sleepDurationUs) {
+  void setSignalingWake(
+      bool enable,
+      uint32_t sleepDurationUs,
+      const BackoffPolicy* backoff = nullptr) {
+    restartThreads([&]() {
+      enableEpochWaiter_.store(enable, std::memory_order_release);
+      sleepLengthUs_.store(sleepDurationUs, std::memory_order_release);
+      if (backoff) {
+        backoff_ = *backoff;
+      }
+    });
+  }
+
+  // Stop the pool's threads, apply change, and restart as many threads as were running.  This
+  // also stops a background start, which would otherwise keep growing the restarted pool.
+  template <typename F>
+  void restartThreads(F&& change) {
     std::lock_guard<std::mutex> lk(threadsMutex_);
+    backgroundTarget_ = 0;
     ssize_t currentPoolSize = numThreads();
     resizeLocked(0);
-    enableEpochWaiter_.store(enable, std::memory_order_release);
-    sleepLengthUs_.store(sleepDurationUs, std::memory_order_release);
+    change();
     resizeLocked(currentPoolSize);
   }
 
   DISPENSO_DLL_ACCESS void resizeLocked(ssize_t n);
 
+  void elasticLoop(ElasticPolicy policy);
+  void backgroundStartLoop();
+
+  void spareLoop();
+  // True if some active spare is no longer needed.  Checked without spareMutex_, so that busy
+  // spares need not take it.
+  bool sparesUnneeded() const {
+    return stopSpares_.load(std::memory_order_acquire) ||
+        activeSpares_.load(std::memory_order_relaxed) >
+        blockedTasks_.load(std::memory_order_acquire);
+  }
+  // Must be called with spareMutex_ held.  True if this spare thread should park or exit.
+  bool spareRetiring();
+
+  void stopThreadsLocked(size_t n);
+  void growStealDequesLocked(size_t n);
+
   void executeNext(OnceFunction work);
 
-  DISPENSO_DLL_ACCESS void threadLoop(PerThreadData& threadData);
+  DISPENSO_DLL_ACCESS void threadLoop(PerThreadData& threadData, size_t index);
+
+  using StealDeque = detail::WorkStealingDeque<detail::OnceCallable>;
+  using WorkQueue = moodycamel::ConcurrentQueue<OnceFunction>;
+
+  // Per-worker scheduling state, living on the worker's stack and reachable through thread-local
+  // PerThreadInfo while the worker runs.
+  struct WorkerContext {
+    StealDeque* stealDeque = nullptr;
+    WorkQueue* nodeWork = nullptr;
+    WorkerStats* stats = nullptr;
+    // In deterministic mode, the indices of the deques to steal from, in order.
+    std::vector<size_t> stealOrder;
+  };
+
+  static WorkerContext* localWorker(ThreadPool* pool) {
+    return static_cast<WorkerContext*>(detail::PerPoolPerThreadInfo::worker(pool));
+  }
+
+  template <typename F>
+  bool tryPushLocal(F&& f);
+
+  void startThread(size_t index, WorkerContext& worker);
+
+  // Invoke f on the observer, if observers are compiled in and one is installed.
+  template <typename F>
+  void notifyObserver(F&& f) {
+#if defined(DISPENSO_OBSERVERS)
+    if (ThreadPoolObserver* observer = observer_.load(std::memory_order_acquire)) {
+      f(*observer);
+    }
+#else
+    (void)f;
+#endif // DISPENSO_OBSERVERS
+  }
+
+  DISPENSO_DLL_ACCESS StatsStripe* statsStripe();
+  void retireStats(const WorkerStats& stats);
+  DISPENSO_DLL_ACCESS void recordExecuted();
+  DISPENSO_DLL_ACCESS void recordWake(uint64_t count = 1);
+  DISPENSO_DLL_ACCESS void recordQueueDepth(ssize_t depth);
+
+  DISPENSO_DLL_ACCESS void recordScheduleLatency(double scheduledAt);
+
+  // A queued task stamped with its scheduling time.
+  template <typename F>
+  struct LatencyStamped {
+    void operator()() {
+      pool->recordScheduleLatency(scheduledAt);
+      f();
+    }
+    ThreadPool* pool;
+    double scheduledAt;
+    F f;
+  };
+
+  // Convert a functor to the OnceFunction that is queued for it.
+  template <typename F>
+  OnceFunction queued(F&& f) {
+    if (DISPENSO_EXPECT(latencyEnabled_.load(std::memory_order_relaxed), false)) {
+      return OnceFunction(LatencyStamped<std::decay_t<F>>{this, getTime(), std::forward<F>(f)});
+    }
+    return OnceFunction(std::forward<F>(f));
+  }
+
+  void recordInline() {
+    if (DISPENSO_EXPECT(statsEnabled_.load(std::memory_order_relaxed), false)) {
+      if (StatsStripe* stripe = statsStripe()) {
+        stripe->inlineTasks.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  void recordEnqueue(ssize_t depth) {
+    DISPENSO_TRACE_INSTANT("schedule");
+    if (DISPENSO_EXPECT(statsEnabled_.load(std::memory_order_relaxed), false)) {
+      recordQueueDepth(depth);
+    }
+  }
+
+  bool tryDequeueCounted(
+      WorkQueue& queue,
+      std::atomic<ssize_t>& queued,
+      OnceFunction& next) {
+    // The counter lets us skip the (comparatively expensive) empty-queue dequeue attempt in the
+    // common case where no prioritized work is in flight.
+    if (queued.load(std::memory_order_acquire) <= 0 || !queue.try_dequeue(next)) {
+      return false;
+    }
+    queued.fetch_sub(1, std::memory_order_acq_rel);
+    return true;
+  }
+
+  bool tryDequeueWork(
+      moodycamel::ConsumerToken& ctoken,
+      WorkerContext& worker,
+      OnceFunction& next);
+
+  DISPENSO_DLL_ACCESS bool trySteal(WorkerContext& worker, OnceFunction& next);
+  DISPENSO_DLL_ACCESS bool tryDequeueAnyNode(OnceFunction& next);
 
   bool tryExecuteNext();
   bool tryExecuteNextFromProducerToken(moodycamel::ProducerToken& token);
 
+  DISPENSO_DLL_ACCESS void scheduleAfterSeconds(double delay, OnceFunction f);
+
+  // Queue any due timers.  This is a single load unless timers are pending.
+  void pollTimers() {
+    if (DISPENSO_EXPECT(timers_.pending() != 0, false)) {
+      pollTimersSlow();
+    }
+  }
+  DISPENSO_DLL_ACCESS void pollTimersSlow();
+
+  // The calling thread's producer token for this pool, if it is not one of the pool's threads.
+  // Tokens are created on a thread's first submission to a pool, and released when the thread
+  // exits or the pool is destroyed, whichever comes first.  Returns null if the calling thread's
+  // tokens were already released at thread exit.
+  moodycamel::ProducerToken* externalProducer() {
+    void* token = detail::PerPoolPerThreadInfo::externalProducer(id_);
+    return token ? static_cast<moodycamel::ProducerToken*>(token) : externalProducerSlow();
+  }
+  DISPENSO_DLL_ACCESS moodycamel::ProducerToken* externalProducerSlow();
+
   template <typename F>
   void schedule(moodycamel::ProducerToken& token, F&& f);
 
+  // With allowLocal false, the functor is always queued through token, rather than possibly to the
+  // calling pool thread's local queue, so that it can be found again via the token.
   template <typename F>
-  void schedule(moodycamel::ProducerToken& token, F&& f, ForceQueuingTag);
+  void schedule(
+      moodycamel::ProducerToken& token,
+      F&& f,
+      ForceQueuingTag,
+      bool allowLocal = true);
+
+  template <typename Gen>
+  void scheduleBulk(moodycamel::ProducerToken* token, size_t count, Gen&& gen);
 
-  void conditionallyWake() {
+  template <typename Gen>
+  void scheduleBulk(moodycamel::ProducerToken* token, size_t count, Gen&& gen, ForceQueuingTag);
+
+  void conditionallyWake(ssize_t count = 1) {
     if (enableEpochWaiter_.load(std::memory_order_acquire)) {
       // A rare race to overwake is preferable to a race that underwakes.
-      auto queuedWork = queuedWork_.fetch_add(1, std::memory_order_acq_rel) + 1;
+      auto queuedWork = queuedWork_.fetch_add(count, std::memory_order_acq_rel) + count;
       auto idle = idleButAwake_.load(std::memory_order_acquire);
-      if (idle < queuedWork) {
-        wake();
+      ssize_t toWake = std::min(count, queuedWork - idle);
+      if (toWake > 0) {
+        if (DISPENSO_EXPECT(statsEnabled_.load(std::memory_order_relaxed), false)) {
+          recordWake(static_cast<uint64_t>(toWake));
+        }
+        wake(toWake);
       }
     }
   }
@@ -221,7 +999,38 @@ class alignas(kCacheLineSize) ThreadPool {
   std::atomic<ssize_t> poolLoadFactor_;
   std::atomic<ssize_t> numThreads_;
 
-  moodycamel::ConcurrentQueue<OnceFunction> work_;
+  WorkQueue work_;
+  // Never reused, unlike the pool's address, so that threads' cached tokens can't be mistaken for
+  // those of a later pool.
+  const uint64_t id_;
+  std::shared_ptr<detail::ExternalProducers> externalProducers_;
+
+  // Only resized while no pool threads are running, since thieves index it without locking.
+  std::vector<std::unique_ptr<StealDeque>> stealDeques_;
+  std::atomic<bool> enableWorkStealing_{false};
+
+  WorkQueue highWork_;
+  WorkQueue lowWork_;
+  alignas(kCacheLineSize) std::atomic<ssize_t> highQueued_{0};
+  alignas(kCacheLineSize) std::atomic<ssize_t> lowQueued_{0};
+
+  // Allocated once, the first time NUMA-aware mode is enabled, and never resized afterward.
+  std::vector<std::unique_ptr<WorkQueue>> nodeWork_;
+  std::atomic<bool> enableNuma_{false};
+
+  // Allocated once, the first time statistics are enabled.
+  std::atomic<SharedStats*> sharedStats_{nullptr};
+  std::atomic<bool> statsEnabled_{false};
+  std::atomic<bool> latencyEnabled_{false};
+
+  // Thread start settings.  Only modified under threadsMutex_ while no pool threads are running.
+  std::vector<int> affinity_;
+  std::atomic<bool> enableDeterministic_{false};
+  uint64_t deterministicSeed_ = 0;
+  std::string threadNamePrefix_;
+  std::function<void(size_t)> threadStartHook_;
+  std::atomic<ThreadPoolObserver*> observer_{nullptr};
+  alignas(kCacheLineSize) std::atomic<ssize_t> nodeQueued_{0};
 
   alignas(kCacheLineSize) std::atomic<ssize_t> queuedWork_{0};
   alignas(kCacheLineSize) std::atomic<ssize_t> idleButAwake_{0};
@@ -231,13 +1040,40 @@ class alignas(kCacheLineSize) ThreadPool {
   alignas(kCacheLineSize) detail::EpochWaiter epochWaiter_;
   alignas(kCacheLineSize) std::atomic<bool> enableEpochWaiter_{kDefaultWakeupEnable};
   std::atomic<uint32_t> sleepLengthUs_{kDefaultSleepLenUs};
+  // Only modified while no threads are running, like the other thread-start settings.
+  BackoffPolicy backoff_;
+
+  detail::TimerWheel timers_;
+
+  // Serializes turning elastic mode on and off; the monitor itself resizes under threadsMutex_.
+  std::mutex elasticMutex_;
+  std::thread elasticThread_;
+  std::atomic<bool> elasticRunning_{false};
+
+  // The size a background start is growing the pool to, or 0 once it is done or cancelled.
+  // Guarded by threadsMutex_.
+  size_t backgroundTarget_ = 0;
+  std::thread backgroundStarter_;
+
+  // Spare threads that stand in for pool threads blocked in enterBlocking/exitBlocking.  Spares
+  // are active while blocked tasks outnumber them, and otherwise parked on spareCv_.
+  std::mutex spareMutex_;
+  std::condition_variable spareCv_;
+  std::vector<std::thread> spares_;
+  // Only modified under spareMutex_, except that exitBlocking decrements blockedTasks_.
+  std::atomic<ssize_t> blockedTasks_{0};
+  std::atomic<ssize_t> activeSpares_{0};
+  ssize_t spareTickets_ = 0;
+  std::atomic<bool> stopSpares_{false};
 
 #if defined DISPENSO_DEBUG
   alignas(kCacheLineSize) std::atomic<ssize_t> outstandingTaskSets_{0};
 #endif // NDEBUG
 
   friend class ConcurrentTaskSet;
+  friend class FiberTaskSet;
   friend class TaskSet;
+  friend struct detail::ForkJoinAccess;
 };
 
 /**
@@ -254,6 +1090,18 @@ DISPENSO_DLL_ACCESS ThreadPool& globalThreadPool();
  **/
 DISPENSO_DLL_ACCESS void resizeGlobalThreadPool(size_t numThreads);
 
+/**
+ * Choose whether the global thread pool starts its threads on a background thread, as with
+ * <code>BackgroundStartTag</code>, instead of all at once on first use.  Short-lived processes on
+ * large machines then only pay for the threads they get to use.  Must be called before the global
+ * pool is first used, e.g. at the top of main, and not concurrently with that first use.
+ *
+ * @param enable Whether to start the global pool's threads in the background.
+ *
+ * @return true if the setting will apply, or false if the global pool already exists.
+ **/
+DISPENSO_DLL_ACCESS bool setGlobalThreadPoolBackgroundStart(bool enable);
+
 // ----------------------------- Implementation details -------------------------------------
 
 template <typename F>
@@ -263,6 +1111,7 @@ inline void ThreadPool::schedule(F&& f) {
   quickLoadFactor += quickLoadFactor / 2;
   if ((detail::PerPoolPerThreadInfo::isPoolRecursive(this) && curWork > quickLoadFactor) ||
       (curWork > poolLoadFactor_.load(std::memory_order_relaxed))) {
+    recordInline();
     f();
   } else {
     schedule(std::forward<F>(f), ForceQueuingTag());
@@ -278,12 +1127,17 @@ inline void ThreadPool::schedule(F&& f, ForceQueuingTag) {
   }
 
   if (!numThreads_.load(std::memory_order_relaxed)) {
+    recordInline();
     f();
     return;
   }
-  workRemaining_.fetch_add(1, std::memory_order_release);
+  if (auto* token = externalProducer()) {
+    schedule(*token, std::forward<F>(f), ForceQueuingTag(), false);
+    return;
+  }
+  recordEnqueue(workRemaining_.fetch_add(1, std::memory_order_release) + 1);
   DISPENSO_TSAN_ANNOTATE_IGNORE_WRITES_BEGIN();
-  bool enqueued = work_.enqueue({std::forward<F>(f)});
+  bool enqueued = work_.enqueue(queued(std::forward<F>(f)));
   DISPENSO_TSAN_ANNOTATE_IGNORE_WRITES_END();
   (void)(enqueued); // unused
   assert(enqueued);
@@ -291,6 +1145,165 @@ inline void ThreadPool::schedule(F&& f, ForceQueuingTag) {
   conditionallyWake();
 }
 
+template <typename F>
+inline void ThreadPool::schedule(F&& f, TaskPriority priority) {
+  if (priority == TaskPriority::kNormal) {
+    schedule(std::forward<F>(f));
+    return;
+  }
+  ssize_t curWork = workRemaining_.load(std::memory_order_relaxed);
+  ssize_t quickLoadFactor = numThreads_.load(std::memory_order_relaxed);
+  quickLoadFactor += quickLoadFactor / 2;
+  if ((detail::PerPoolPerThreadInfo::isPoolRecursive(this) && curWork > quickLoadFactor) ||
+      (curWork > poolLoadFactor_.load(std::memory_order_relaxed))) {
+    recordInline();
+    f();
+  } else {
+    schedule(std::forward<F>(f), priority, ForceQueuingTag());
+  }
+}
+
+template <typename F>
+inline void ThreadPool::schedule(F&& f, TaskPriority priority, ForceQueuingTag) {
+  if (priority == TaskPriority::kNormal) {
+    schedule(std::forward<F>(f), ForceQueuingTag());
+    return;
+  }
+  if (!numThreads_.load(std::memory_order_relaxed)) {
+    recordInline();
+    f();
+    return;
+  }
+  bool high = priority == TaskPriority::kHigh;
+  recordEnqueue(workRemaining_.fetch_add(1, std::memory_order_release) + 1);
+  (high ? highQueued_ : lowQueued_).fetch_add(1, std::memory_order_release);
+  DISPENSO_TSAN_ANNOTATE_IGNORE_WRITES_BEGIN();
+  bool enqueued = (high ? highWork_ : lowWork_).enqueue(queued(std::forward<F>(f)));
+  DISPENSO_TSAN_ANNOTATE_IGNORE_WRITES_END();
+  (void)(enqueued); // unused
+  assert(enqueued);
+
+  conditionallyWake();
+}
+
+template <typename F>
+inline void ThreadPool::scheduleOnNode(F&& f, size_t node) {
+  if (!enableNuma_.load(std::memory_order_acquire)) {
+    schedule(std::forward<F>(f), ForceQueuingTag());
+    return;
+  }
+  if (!numThreads_.load(std::memory_order_relaxed)) {
+    recordInline();
+    f();
+    return;
+  }
+  recordEnqueue(workRemaining_.fetch_add(1, std::memory_order_release) + 1);
+  nodeQueued_.fetch_add(1, std::memory_order_release);
+  DISPENSO_TSAN_ANNOTATE_IGNORE_WRITES_BEGIN();
+  bool enqueued = nodeWork_[node % nodeWork_.size()]->enqueue(queued(std::forward<F>(f)));
+  DISPENSO_TSAN_ANNOTATE_IGNORE_WRITES_END();
+  (void)(enqueued); // unused
+  assert(enqueued);
+
+  conditionallyWake();
+}
+
+template <typename Gen>
+inline void ThreadPool::scheduleBulk(size_t count, Gen&& gen) {
+  scheduleBulk(
+      static_cast<moodycamel::ProducerToken*>(detail::PerPoolPerThreadInfo::producer(this)),
+      count,
+      std::forward<Gen>(gen));
+}
+
+template <typename Gen>
+inline void ThreadPool::scheduleBulk(size_t count, Gen&& gen, ForceQueuingTag) {
+  auto* token =
+      static_cast<moodycamel::ProducerToken*>(detail::PerPoolPerThreadInfo::producer(this));
+  if (!token && numThreads_.load(std::memory_order_relaxed)) {
+    token = externalProducer();
+  }
+  scheduleBulk(token, count, std::forward<Gen>(gen), ForceQueuingTag());
+}
+
+template <typename Gen>
+inline void
+ThreadPool::scheduleBulk(moodycamel::ProducerToken* token, size_t count, Gen&& gen) {
+  ssize_t curWork = workRemaining_.load(std::memory_order_relaxed);
+  ssize_t quickLoadFactor = numThreads_.load(std::memory_order_relaxed);
+  quickLoadFactor += quickLoadFactor / 2;
+  if ((detail::PerPoolPerThreadInfo::isPoolRecursive(this) && curWork > quickLoadFactor) ||
+      (curWork > poolLoadFactor_.load(std::memory_order_relaxed))) {
+    for (size_t i = 0; i < count; ++i) {
+      recordInline();
+      gen(i)();
+    }
+  } else {
+    scheduleBulk(token, count, std::forward<Gen>(gen), ForceQueuingTag());
+  }
+}
+
+template <typename Gen>
+inline void ThreadPool::scheduleBulk(
+    moodycamel::ProducerToken* token,
+    size_t count,
+    Gen&& gen,
+    ForceQueuingTag) {
+  if (!numThreads_.load(std::memory_order_relaxed)) {
+    for (size_t i = 0; i < count; ++i) {
+      recordInline();
+      gen(i)();
+    }
+    return;
+  }
+  if (!count) {
+    return;
+  }
+  ssize_t n = static_cast<ssize_t>(count);
+  recordEnqueue(workRemaining_.fetch_add(n, std::memory_order_release) + n);
+
+  constexpr size_t kBatchSize = 64;
+  OnceFunction batch[kBatchSize];
+  for (size_t i = 0; i < count;) {
+    size_t batchSize = std::min(kBatchSize, count - i);
+    for (size_t j = 0; j < batchSize; ++j, ++i) {
+      batch[j] = queued(gen(i));
+    }
+    DISPENSO_TSAN_ANNOTATE_IGNORE_WRITES_BEGIN();
+    bool enqueued = token
+        ? work_.enqueue_bulk(*token, std::make_move_iterator(batch), batchSize)
+        : work_.enqueue_bulk(std::make_move_iterator(batch), batchSize);
+    DISPENSO_TSAN_ANNOTATE_IGNORE_WRITES_END();
+    (void)(enqueued); // unused
+    assert(enqueued);
+  }
+
+  conditionallyWake(n);
+}
+
+template <typename F>
+inline bool ThreadPool::tryPushLocal(F&& f) {
+  WorkerContext* worker = localWorker(this);
+  if (!worker) {
+    return false;
+  }
+  if (worker->stealDeque) {
+    OnceFunction func = queued(std::forward<F>(f));
+    worker->stealDeque->push(func.onceCallable_);
+    return true;
+  }
+  if (worker->nodeWork) {
+    nodeQueued_.fetch_add(1, std::memory_order_release);
+    DISPENSO_TSAN_ANNOTATE_IGNORE_WRITES_BEGIN();
+    bool enqueued = worker->nodeWork->enqueue(queued(std::forward<F>(f)));
+    DISPENSO_TSAN_ANNOTATE_IGNORE_WRITES_END();
+    (void)(enqueued); // unused
+    assert(enqueued);
+    return true;
+  }
+  return false;
+}
+
 template <typename F>
 inline void ThreadPool::schedule(moodycamel::ProducerToken& token, F&& f) {
   ssize_t curWork = workRemaining_.load(std::memory_order_relaxed);
@@ -298,6 +1311,7 @@ inline void ThreadPool::schedule(moodycamel::ProducerToken& token, F&& f) {
   quickLoadFactor += quickLoadFactor / 2;
   if ((detail::PerPoolPerThreadInfo::isPoolRecursive(this) && curWork > quickLoadFactor) ||
       (curWork > poolLoadFactor_.load(std::memory_order_relaxed))) {
+    recordInline();
     f();
   } else {
     schedule(token, std::forward<F>(f), ForceQueuingTag());
@@ -305,14 +1319,23 @@ inline void ThreadPool::schedule(moodycamel::ProducerToken& token, F&& f) {
 }
 
 template <typename F>
-inline void ThreadPool::schedule(moodycamel::ProducerToken& token, F&& f, ForceQueuingTag) {
+inline void ThreadPool::schedule(
+    moodycamel::ProducerToken& token,
+    F&& f,
+    ForceQueuingTag,
+    bool allowLocal) {
   if (!numThreads_.load(std::memory_order_relaxed)) {
+    recordInline();
     f();
     return;
   }
-  workRemaining_.fetch_add(1, std::memory_order_release);
+  recordEnqueue(workRemaining_.fetch_add(1, std::memory_order_release) + 1);
+  if (allowLocal && tryPushLocal(std::forward<F>(f))) {
+    conditionallyWake();
+    return;
+  }
   DISPENSO_TSAN_ANNOTATE_IGNORE_WRITES_BEGIN();
-  bool enqueued = work_.enqueue(token, {std::forward<F>(f)});
+  bool enqueued = work_.enqueue(token, queued(std::forward<F>(f)));
   DISPENSO_TSAN_ANNOTATE_IGNORE_WRITES_END();
   (void)(enqueued); // unused
   assert(enqueued);
@@ -321,14 +1344,51 @@ inline void ThreadPool::schedule(moodycamel::ProducerToken& token, F&& f, ForceQ
 }
 
 inline bool ThreadPool::tryExecuteNext() {
+  pollTimers();
   OnceFunction next;
-  if (work_.try_dequeue(next)) {
+  if (tryDequeueCounted(highWork_, highQueued_, next)) {
+    executeNext(std::move(next));
+    return true;
+  }
+  WorkerContext* worker = localWorker(this);
+  StealDeque* stealDeque = worker ? worker->stealDeque : nullptr;
+  if (stealDeque) {
+    if (detail::OnceCallable* callable = stealDeque->pop()) {
+      executeNext(OnceFunction(callable, true));
+      return true;
+    }
+  }
+  if ((worker && worker->nodeWork && tryDequeueCounted(*worker->nodeWork, nodeQueued_, next)) ||
+      work_.try_dequeue(next) || tryDequeueAnyNode(next) ||
+      // Only pool threads steal; stealDeques_ may be resized while external threads call in.
+      (stealDeque && trySteal(*worker, next)) ||
+      tryDequeueCounted(lowWork_, lowQueued_, next)) {
     executeNext(std::move(next));
     return true;
   }
   return false;
 }
 
+inline bool ThreadPool::tryDequeueWork(
+    moodycamel::ConsumerToken& ctoken,
+    WorkerContext& worker,
+    OnceFunction& next) {
+  pollTimers();
+  if (tryDequeueCounted(highWork_, highQueued_, next)) {
+    return true;
+  }
+  if (worker.stealDeque) {
+    if (detail::OnceCallable* callable = worker.stealDeque->pop()) {
+      next = OnceFunction(callable, true);
+      return true;
+    }
+  }
+  return (worker.nodeWork && tryDequeueCounted(*worker.nodeWork, nodeQueued_, next)) ||
+      work_.try_dequeue(ctoken, next) || tryDequeueAnyNode(next) ||
+      (worker.stealDeque && trySteal(worker, next)) ||
+      tryDequeueCounted(lowWork_, lowQueued_, next);
+}
+
 inline bool ThreadPool::tryExecuteNextFromProducerToken(moodycamel::ProducerToken& token) {
   OnceFunction next;
   if (work_.try_dequeue_from_producer(token, next)) {
@@ -339,8 +1399,16 @@ inline bool ThreadPool::tryExecuteNextFromProducerToken(moodycamel::ProducerToke
 }
 
 inline void ThreadPool::executeNext(OnceFunction next) {
-  next();
+  notifyObserver([](ThreadPoolObserver& o) { o.onTaskBegin(); });
+  {
+    DISPENSO_TRACE_SCOPE("task");
+    next();
+  }
+  notifyObserver([](ThreadPoolObserver& o) { o.onTaskEnd(); });
   workRemaining_.fetch_add(-1, std::memory_order_relaxed);
+  if (DISPENSO_EXPECT(statsEnabled_.load(std::memory_order_relaxed), false)) {
+    recordExecuted();
+  }
 }
 
 } // namespace dispenso
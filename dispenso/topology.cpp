@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/topology.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#include <Windows.h>
+#endif // PLATFORM
+
+namespace dispenso {
+
+namespace {
+
+#if defined(__linux__)
+// Parse the kernel's list format, e.g. "0-3,8-11,16".
+std::vector<int> parseList(const std::string& list) {
+  std::vector<int> values;
+  const char* cur = list.c_str();
+  while (*cur) {
+    char* end;
+    long first = std::strtol(cur, &end, 10);
+    if (end == cur) {
+      break;
+    }
+    long last = first;
+    cur = end;
+    if (*cur == '-') {
+      last = std::strtol(cur + 1, &end, 10);
+      cur = end;
+    }
+    for (long v = first; v <= last; ++v) {
+      values.push_back(static_cast<int>(v));
+    }
+    if (*cur != ',') {
+      break;
+    }
+    ++cur;
+  }
+  return values;
+}
+
+// Index of the calling thread's node in numaTopology(), or -1 if not yet looked up.
+DISPENSO_THREAD_LOCAL int g_currentNode = -1;
+
+std::vector<NumaNode> detectTopology() {
+  std::vector<NumaNode> nodes;
+  std::ifstream online("/sys/devices/system/node/online");
+  if (!online) {
+    return nodes;
+  }
+  std::string nodeList;
+  std::getline(online, nodeList);
+  for (int id : parseList(nodeList)) {
+    std::ifstream in("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+    std::string cpuList;
+    if (!in || !std::getline(in, cpuList)) {
+      continue;
+    }
+    auto cpus = parseList(cpuList);
+    // Memory-only nodes have no CPUs to run pool threads on.
+    if (!cpus.empty()) {
+      nodes.push_back({id, std::move(cpus)});
+    }
+  }
+  return nodes;
+}
+#else
+std::vector<NumaNode> detectTopology() {
+  return {};
+}
+#endif // PLATFORM
+
+std::vector<NumaNode> computeTopology() {
+  auto nodes = detectTopology();
+  if (nodes.empty()) {
+    NumaNode node{0, {}};
+    int numCpus = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    for (int c = 0; c < numCpus; ++c) {
+      node.cpus.push_back(c);
+    }
+    nodes.push_back(std::move(node));
+  }
+  return nodes;
+}
+
+} // namespace
+
+const std::vector<NumaNode>& numaTopology() {
+  static const std::vector<NumaNode> topology = computeTopology();
+  return topology;
+}
+
+size_t currentNumaNode() {
+  const auto& nodes = numaTopology();
+  if (nodes.size() == 1) {
+    return 0;
+  }
+#if defined(__linux__)
+  if (g_currentNode < 0) {
+    int cpu = sched_getcpu();
+    g_currentNode = 0;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      const auto& cpus = nodes[i].cpus;
+      if (std::find(cpus.begin(), cpus.end(), cpu) != cpus.end()) {
+        g_currentNode = static_cast<int>(i);
+        break;
+      }
+    }
+  }
+  return static_cast<size_t>(g_currentNode);
+#else
+  return 0;
+#endif // PLATFORM
+}
+
+bool pinCurrentThread(const std::vector<int>& cpus) {
+  if (cpus.empty()) {
+    return true;
+  }
+#if defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int c : cpus) {
+    if (c >= 0 && c < CPU_SETSIZE) {
+      CPU_SET(c, &set);
+    }
+  }
+  if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+    return false;
+  }
+  g_currentNode = -1;
+  return true;
+#elif defined(_WIN32)
+  DWORD_PTR mask = 0;
+  for (int c : cpus) {
+    if (c >= 0 && c < static_cast<int>(sizeof(DWORD_PTR) * 8)) {
+      mask |= DWORD_PTR{1} << c;
+    }
+  }
+  return mask && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#else
+  // Other platforms, e.g. MacOs, have no hard pinning, so threads are left unpinned.
+  return false;
+#endif // PLATFORM
+}
+
+} // namespace dispenso
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file topology.h
+ * Utilities for querying machine topology (NUMA nodes and their CPUs) and for pinning threads to
+ * CPUs.
+ **/
+
+#pragma once
+
+#include <vector>
+
+#include <dispenso/platform.h>
+
+namespace dispenso {
+
+/**
+ * A description of a single NUMA node.
+ **/
+struct NumaNode {
+  /**
+   * The operating system's identifier for the node.
+   **/
+  int id;
+  /**
+   * The logical CPUs belonging to this node.
+   **/
+  std::vector<int> cpus;
+};
+
+/**
+ * Get the NUMA topology of the machine.  The result is computed once and cached.
+ *
+ * @return A list of NUMA nodes with at least one CPU each.  On platforms where topology cannot
+ * be determined, a single node containing all hardware threads is returned.
+ **/
+DISPENSO_DLL_ACCESS const std::vector<NumaNode>& numaTopology();
+
+/**
+ * Get the NUMA node the calling thread runs on.  The node is looked up once per thread and cached,
+ * and looked up again after the thread is pinned with <code>pinCurrentThread</code>, so it is cheap
+ * but may be stale for unpinned threads that migrate between nodes.
+ *
+ * @return An index into <code>numaTopology()</code>.  Always 0 on single-node machines and on
+ * platforms where the current CPU cannot be determined.
+ **/
+DISPENSO_DLL_ACCESS size_t currentNumaNode();
+
+/**
+ * Restrict the calling thread to run only on the given set of logical CPUs.
+ *
+ * @param cpus The logical CPUs the calling thread may run on.  An empty list is a no-op.
+ *
+ * @return true if the affinity was applied, false if it failed or is unsupported on this platform.
+ *
+ * @note Pinning is only implemented on Linux and Windows.  Elsewhere, e.g. on MacOs, which only
+ * offers affinity hints, this is a no-op that returns false.
+ **/
+DISPENSO_DLL_ACCESS bool pinCurrentThread(const std::vector<int>& cpus);
+
+} // namespace dispenso
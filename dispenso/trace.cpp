@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/trace.h>
+
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+#include <ios>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <dispenso/detail/math.h>
+#include <dispenso/thread_id.h>
+#include <dispenso/timing.h>
+
+namespace dispenso {
+namespace detail {
+
+std::atomic<bool> g_traceActive{false};
+
+namespace {
+
+struct TraceRecord {
+  double time;
+  const char* name;
+  TraceEventType type;
+};
+
+// A single-producer ring buffer, written only by its thread.  The writer publishes each record by
+// advancing count, so a reader that loads count sees every record before it, save those that the
+// writer has since overwritten.
+struct TraceBuffer {
+  TraceBuffer(size_t cap, uint64_t tidIn, std::string nameIn)
+      : records(new TraceRecord[cap]), mask(cap - 1), tid(tidIn), threadName(std::move(nameIn)) {}
+
+  std::unique_ptr<TraceRecord[]> records;
+  const size_t mask;
+  std::atomic<size_t> count{0};
+  const uint64_t tid;
+  std::string threadName;
+  std::atomic<bool> exited{false};
+};
+
+struct TraceRegistry {
+  std::mutex mtx;
+  std::vector<std::unique_ptr<TraceBuffer>> buffers;
+  std::atomic<size_t> capacity{kDefaultTraceEventsPerThread};
+};
+
+TraceRegistry& registry() {
+  // Leaked, since threads may record events or exit during static destruction.
+  static TraceRegistry* reg = new TraceRegistry();
+  return *reg;
+}
+
+struct ThreadTrace {
+  ~ThreadTrace() {
+    if (buffer) {
+      buffer->exited.store(true, std::memory_order_release);
+    }
+  }
+  TraceBuffer* buffer = nullptr;
+  std::string name;
+};
+
+ThreadTrace& threadTrace() {
+  static thread_local ThreadTrace trace;
+  return trace;
+}
+
+TraceBuffer& localBuffer() {
+  ThreadTrace& trace = threadTrace();
+  if (DISPENSO_EXPECT(trace.buffer == nullptr, false)) {
+    TraceRegistry& reg = registry();
+    std::string name =
+        trace.name.empty() ? "thread " + std::to_string(threadId()) : std::move(trace.name);
+    auto buffer = std::make_unique<TraceBuffer>(
+        reg.capacity.load(std::memory_order_relaxed), threadId(), std::move(name));
+    trace.buffer = buffer.get();
+    std::lock_guard<std::mutex> lk(reg.mtx);
+    reg.buffers.push_back(std::move(buffer));
+  }
+  return *trace.buffer;
+}
+
+void writeEscaped(std::ostream& out, const char* s) {
+  out << '"';
+  for (; *s; ++s) {
+    const unsigned char c = static_cast<unsigned char>(*s);
+    if (c == '"' || c == '\\') {
+      out << '\\' << *s;
+    } else if (c < 0x20) {
+      static const char kHex[] = "0123456789abcdef";
+      out << "\\u00" << kHex[c >> 4] << kHex[c & 0xf];
+    } else {
+      out << *s;
+    }
+  }
+  out << '"';
+}
+
+} // namespace
+
+void recordTraceEvent(TraceEventType type, const char* name) {
+  TraceBuffer& buffer = localBuffer();
+  const size_t n = buffer.count.load(std::memory_order_relaxed);
+  TraceRecord& record = buffer.records[n & buffer.mask];
+  record.time = getTime();
+  record.name = name;
+  record.type = type;
+  buffer.count.store(n + 1, std::memory_order_release);
+}
+
+} // namespace detail
+
+void startTracing(size_t eventsPerThread) {
+  // getTime calibrates itself on first use, which should not land in the middle of a trace.
+  (void)getTime();
+  detail::registry().capacity.store(
+      static_cast<size_t>(detail::nextPow2(std::max<uint64_t>(eventsPerThread, 2))),
+      std::memory_order_relaxed);
+  detail::g_traceActive.store(true, std::memory_order_release);
+}
+
+void stopTracing() {
+  detail::g_traceActive.store(false, std::memory_order_release);
+}
+
+bool tracingActive() {
+  return detail::g_traceActive.load(std::memory_order_acquire);
+}
+
+void clearTrace() {
+  assert(!tracingActive() && "clearTrace requires tracing to be stopped");
+  detail::TraceRegistry& reg = detail::registry();
+  std::lock_guard<std::mutex> lk(reg.mtx);
+  auto& buffers = reg.buffers;
+  buffers.erase(
+      std::remove_if(
+          buffers.begin(),
+          buffers.end(),
+          [](const std::unique_ptr<detail::TraceBuffer>& b) {
+            return b->exited.load(std::memory_order_acquire);
+          }),
+      buffers.end());
+  for (auto& b : buffers) {
+    b->count.store(0, std::memory_order_relaxed);
+  }
+}
+
+void writeChromeTrace(std::ostream& out) {
+  assert(!tracingActive() && "writeChromeTrace requires tracing to be stopped");
+  detail::TraceRegistry& reg = detail::registry();
+  std::lock_guard<std::mutex> lk(reg.mtx);
+  const std::ios_base::fmtflags flags = out.flags();
+  const std::streamsize precision = out.precision();
+  // Chrome trace timestamps are in microseconds; keep nanosecond resolution.
+  out << std::fixed;
+  out.precision(3);
+  out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  bool first = true;
+  auto separate = [&out, &first]() {
+    if (!first) {
+      out << ',';
+    }
+    first = false;
+    out << '\n';
+  };
+  for (auto& b : reg.buffers) {
+    separate();
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << b->tid
+        << ",\"args\":{\"name\":";
+    detail::writeEscaped(out, b->threadName.c_str());
+    out << "}}";
+
+    const size_t count = b->count.load(std::memory_order_acquire);
+    const size_t capacity = b->mask + 1;
+    // Skip a slot beyond the oldest surviving record, which a writer that began an event just as
+    // tracing stopped may be reusing.
+    const size_t begin = count > capacity ? count - capacity + 1 : 0;
+    for (size_t i = begin; i < count; ++i) {
+      const detail::TraceRecord& r = b->records[i & b->mask];
+      separate();
+      out << "{\"name\":";
+      detail::writeEscaped(out, r.name);
+      switch (r.type) {
+        case detail::TraceEventType::kBegin:
+          out << ",\"ph\":\"B\"";
+          break;
+        case detail::TraceEventType::kEnd:
+          out << ",\"ph\":\"E\"";
+          break;
+        case detail::TraceEventType::kInstant:
+          out << ",\"ph\":\"i\",\"s\":\"t\"";
+          break;
+      }
+      out << ",\"pid\":0,\"tid\":" << b->tid << ",\"ts\":" << r.time * 1e6 << '}';
+    }
+  }
+  out << "\n]}\n";
+  out.flags(flags);
+  out.precision(precision);
+}
+
+bool writeChromeTrace(const std::string& path) {
+  std::ofstream out(path);
+  if (!out) {
+    return false;
+  }
+  writeChromeTrace(out);
+  out.close();
+  return !out.fail();
+}
+
+void setTraceThreadName(std::string name) {
+  detail::ThreadTrace& trace = detail::threadTrace();
+  if (trace.buffer) {
+    std::lock_guard<std::mutex> lk(detail::registry().mtx);
+    trace.buffer->threadName = std::move(name);
+  } else {
+    trace.name = std::move(name);
+  }
+}
+
+} // namespace dispenso
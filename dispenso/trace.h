@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file trace.h
+ * A file providing a task timeline tracer.  When dispenso is built with DISPENSO_TRACING defined
+ * (the DISPENSO_TRACING CMake option), thread pools record task begin/end, schedule, steal, and
+ * sleep/wake events, along with the names of named TaskSets and pipeline stages, into per-thread
+ * ring buffers.  The recorded timeline can be written as a Chrome trace, which can be viewed in
+ * chrome://tracing or https://ui.perfetto.dev.  Without DISPENSO_TRACING, the hooks compile to
+ * nothing, and traces are empty.
+ **/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include <dispenso/platform.h>
+
+namespace dispenso {
+
+/**
+ * Whether tracing hooks are compiled in.
+ **/
+#if defined(DISPENSO_TRACING)
+constexpr bool kTracingCompiledIn = true;
+#else
+constexpr bool kTracingCompiledIn = false;
+#endif // DISPENSO_TRACING
+
+/**
+ * The default number of events each thread's ring buffer holds.
+ **/
+constexpr size_t kDefaultTraceEventsPerThread = size_t{1} << 16;
+
+/**
+ * Start recording events.  Threads get a ring buffer on their first event; once a thread's buffer
+ * is full, its oldest events are overwritten.
+ *
+ * @param eventsPerThread The number of events each new buffer holds, rounded up to a power of two.
+ * Buffers that already exist keep their size.
+ **/
+DISPENSO_DLL_ACCESS void startTracing(size_t eventsPerThread = kDefaultTraceEventsPerThread);
+
+/**
+ * Stop recording events.  Recorded events are kept until <code>clearTrace()</code>.
+ **/
+DISPENSO_DLL_ACCESS void stopTracing();
+
+/**
+ * Check whether events are being recorded.
+ *
+ * @return true between <code>startTracing()</code> and <code>stopTracing()</code>.
+ **/
+DISPENSO_DLL_ACCESS bool tracingActive();
+
+/**
+ * Discard all recorded events, and the buffers of threads that have exited.  Tracing must be
+ * stopped, and traced work finished, first: buffers are reset without synchronizing with threads
+ * that may still be recording into them.
+ **/
+DISPENSO_DLL_ACCESS void clearTrace();
+
+/**
+ * Write the recorded events in Chrome trace event (JSON) format.  Tracing must be stopped, and
+ * traced work finished, first: events are read without synchronizing with threads that may still be
+ * recording, so a concurrent writer could overwrite an event as it is written out.
+ *
+ * @param out The stream to write to.
+ **/
+DISPENSO_DLL_ACCESS void writeChromeTrace(std::ostream& out);
+
+/**
+ * Write the recorded events in Chrome trace event (JSON) format to a file.  See the stream
+ * overload.
+ *
+ * @param path The file to write.
+ * @return true if the file was written successfully.
+ **/
+DISPENSO_DLL_ACCESS bool writeChromeTrace(const std::string& path);
+
+/**
+ * Name the calling thread in traces.  Pool threads are named automatically.
+ *
+ * @param name The thread's name.
+ **/
+DISPENSO_DLL_ACCESS void setTraceThreadName(std::string name);
+
+namespace detail {
+
+enum class TraceEventType : uint8_t { kBegin, kEnd, kInstant };
+
+DISPENSO_DLL_ACCESS extern std::atomic<bool> g_traceActive;
+
+DISPENSO_DLL_ACCESS void recordTraceEvent(TraceEventType type, const char* name);
+
+inline void traceEvent(TraceEventType type, const char* name) {
+  if (DISPENSO_EXPECT(g_traceActive.load(std::memory_order_relaxed), false)) {
+    recordTraceEvent(type, name);
+  }
+}
+
+// Records a slice covering its lifetime, if name is non-null.
+class TraceScope {
+ public:
+  explicit TraceScope(const char* name)
+      : name_(name && g_traceActive.load(std::memory_order_relaxed) ? name : nullptr) {
+    if (name_) {
+      recordTraceEvent(TraceEventType::kBegin, name_);
+    }
+  }
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+  ~TraceScope() {
+    // Close the slice even if tracing stopped in the meantime, so that the trace stays balanced.
+    if (name_) {
+      recordTraceEvent(TraceEventType::kEnd, name_);
+    }
+  }
+
+ private:
+  const char* name_;
+};
+
+} // namespace detail
+} // namespace dispenso
+
+#define DISPENSO_TRACE_CONCAT_IMPL(a, b) a##b
+#define DISPENSO_TRACE_CONCAT(a, b) DISPENSO_TRACE_CONCAT_IMPL(a, b)
+
+#if defined(DISPENSO_TRACING)
+
+/**
+ * Record a slice named <code>name</code> covering the rest of the enclosing scope.  The name must
+ * remain valid until the trace is written, e.g. a string literal, and may be nullptr to record
+ * nothing.
+ **/
+#define DISPENSO_TRACE_SCOPE(name) \
+  ::dispenso::detail::TraceScope DISPENSO_TRACE_CONCAT(dispensoTraceScope, __LINE__)(name)
+/**
+ * Record an instantaneous event named <code>name</code>.
+ **/
+#define DISPENSO_TRACE_INSTANT(name) \
+  ::dispenso::detail::traceEvent(::dispenso::detail::TraceEventType::kInstant, name)
+
+#else
+
+#define DISPENSO_TRACE_SCOPE(name)
+#define DISPENSO_TRACE_INSTANT(name)
+
+#endif // DISPENSO_TRACING
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file unique_function.h
+ * A file providing UniqueFunction, a move-only type-erased functor of any signature, which may be
+ * called any number of times.  Like OnceFunction, it is built to be cheap to create and move.
+ **/
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include <dispenso/detail/unique_callable_impl.h>
+
+namespace dispenso {
+
+template <typename Signature>
+class UniqueFunction;
+
+/**
+ * A move-only replacement for <code>std::function<R(Args...)></code>.  Being move-only, it can
+ * wrap move-only functors (e.g. lambdas capturing <code>std::unique_ptr</code>).  The wrapped
+ * functor lives in a buffer from the small buffer allocator, so creation is cheap as long as the
+ * functor is below <code>kMaxSmallBufferSize</code> (less a pointer), and moves only copy a
+ * pointer.  Unlike <code>OnceFunction</code>, the functor is destroyed along with the
+ * <code>UniqueFunction</code>, not on call.
+ **/
+template <typename R, typename... Args>
+class UniqueFunction<R(Args...)> {
+ public:
+  /**
+   * Construct an empty <code>UniqueFunction</code>.
+   **/
+  UniqueFunction() noexcept = default;
+  UniqueFunction(std::nullptr_t) noexcept {}
+
+  /**
+   * Construct a <code>UniqueFunction</code> with a valid functor.
+   *
+   * @param f A functor callable with <code>Args...</code>, returning something convertible to
+   * <code>R</code>.  Ideally this should be a concrete functor (e.g. from lambda).
+   **/
+  template <
+      typename F,
+      typename = std::enable_if_t<!std::is_same<std::decay_t<F>, UniqueFunction>::value>>
+  UniqueFunction(F&& f)
+      : callable_(detail::createUniqueCallable<R, Args...>(std::forward<F>(f))) {}
+
+  UniqueFunction(const UniqueFunction& other) = delete;
+  UniqueFunction& operator=(const UniqueFunction& other) = delete;
+
+  UniqueFunction(UniqueFunction&& other) noexcept : callable_(other.callable_) {
+    other.callable_ = nullptr;
+  }
+
+  UniqueFunction& operator=(UniqueFunction&& other) noexcept {
+    if (&other != this) {
+      reset();
+      callable_ = other.callable_;
+      other.callable_ = nullptr;
+    }
+    return *this;
+  }
+
+  UniqueFunction& operator=(std::nullptr_t) noexcept {
+    reset();
+    return *this;
+  }
+
+  ~UniqueFunction() {
+    reset();
+  }
+
+  /**
+   * Check whether this holds a functor.
+   *
+   * @return <code>true</code> if a functor is held, <code>false</code> if empty.
+   **/
+  explicit operator bool() const noexcept {
+    return callable_ != nullptr;
+  }
+
+  /**
+   * Invoke the type-erased functor.  Must not be called on an empty <code>UniqueFunction</code>.
+   *
+   * @param args The arguments to forward to the functor.
+   * @return The result of the functor.
+   **/
+  R operator()(Args... args) const {
+    assert(callable_ != nullptr && "Must not call an empty UniqueFunction!");
+    return callable_->call(std::forward<Args>(args)...);
+  }
+
+  /**
+   * Swap functors with another <code>UniqueFunction</code>.
+   *
+   * @param other The <code>UniqueFunction</code> to swap with.
+   **/
+  void swap(UniqueFunction& other) noexcept {
+    std::swap(callable_, other.callable_);
+  }
+
+ private:
+  void reset() {
+    if (callable_) {
+      callable_->destroy();
+      callable_ = nullptr;
+    }
+  }
+
+  detail::UniqueCallable<R, Args...>* callable_ = nullptr;
+};
+
+} // namespace dispenso
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/arena.h>
+
+#include <cstring>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <dispenso/parallel_for.h>
+
+#include <gtest/gtest.h>
+
+namespace {
+struct Tracked {
+  size_t live = 0;
+  size_t calls = 0;
+
+  std::function<void*(size_t)> allocFunc() {
+    return [this](size_t len) {
+      ++live;
+      ++calls;
+      return ::malloc(len);
+    };
+  }
+  std::function<void(void*)> deallocFunc() {
+    return [this](void* ptr) {
+      --live;
+      ::free(ptr);
+    };
+  }
+};
+} // namespace
+
+TEST(Arena, AlignedDistinctAllocations) {
+  dispenso::Arena arena(4096);
+  std::vector<char*> ptrs;
+  for (size_t i = 0; i < 1000; ++i) {
+    size_t alignment = size_t{1} << (i % 7);
+    char* p = reinterpret_cast<char*>(arena.allocate(i % 100 + 1, alignment));
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % alignment, 0);
+    memset(p, static_cast<int>(i), i % 100 + 1);
+    ptrs.push_back(p);
+  }
+  for (size_t i = 0; i < ptrs.size(); ++i) {
+    for (size_t j = 0; j < i % 100 + 1; ++j) {
+      EXPECT_EQ(ptrs[i][j], static_cast<char>(i));
+    }
+  }
+}
+
+TEST(Arena, ResetReusesSlabs) {
+  Tracked tracked;
+  {
+    dispenso::Arena arena(1024, tracked.allocFunc(), tracked.deallocFunc());
+    for (size_t i = 0; i < 100; ++i) {
+      arena.allocate(100);
+    }
+    size_t slabs = tracked.calls;
+    EXPECT_GT(slabs, 1);
+    EXPECT_EQ(arena.bytesReserved(), slabs * 1024);
+
+    for (int round = 0; round < 10; ++round) {
+      arena.reset();
+      for (size_t i = 0; i < 100; ++i) {
+        arena.allocate(100);
+      }
+    }
+    EXPECT_EQ(tracked.calls, slabs);
+  }
+  EXPECT_EQ(tracked.live, 0);
+}
+
+TEST(Arena, OversizedAllocations) {
+  Tracked tracked;
+  {
+    dispenso::Arena arena(1024, tracked.allocFunc(), tracked.deallocFunc());
+    char* small = reinterpret_cast<char*>(arena.allocate(16));
+    char* big = reinterpret_cast<char*>(arena.allocate(10000, 256));
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(big) % 256, 0);
+    memset(big, 1, 10000);
+    // The oversized allocation doesn't disturb the current slab.
+    char* small2 = reinterpret_cast<char*>(arena.allocate(16));
+    EXPECT_EQ(small2, small + 16);
+    EXPECT_EQ(tracked.live, 2);
+    arena.reset();
+    EXPECT_EQ(tracked.live, 1);
+  }
+  EXPECT_EQ(tracked.live, 0);
+}
+
+TEST(Arena, Create) {
+  dispenso::Arena arena;
+  struct Point {
+    Point(int xIn, int yIn) : x(xIn), y(yIn) {}
+    int x;
+    int y;
+  };
+  Point* p = arena.create<Point>(3, 4);
+  double* d = arena.create<double>(2.5);
+  EXPECT_EQ(p->x, 3);
+  EXPECT_EQ(p->y, 4);
+  EXPECT_EQ(*d, 2.5);
+}
+
+TEST(ConcurrentArena, ParallelAllocations) {
+  Tracked tracked;
+  std::mutex mtx;
+  auto allocFunc = tracked.allocFunc();
+  auto deallocFunc = tracked.deallocFunc();
+  {
+    dispenso::ConcurrentArena arena(
+        4096,
+        [&](size_t len) {
+          std::lock_guard<std::mutex> lk(mtx);
+          return allocFunc(len);
+        },
+        [&](void* ptr) {
+          std::lock_guard<std::mutex> lk(mtx);
+          deallocFunc(ptr);
+        });
+
+    constexpr size_t kNum = 100000;
+    std::vector<size_t*> ptrs(kNum);
+    for (int round = 0; round < 3; ++round) {
+      dispenso::parallel_for(size_t{0}, kNum, [&arena, &ptrs](size_t i) {
+        ptrs[i] = arena.create<size_t>(i);
+      });
+      std::set<size_t*> unique(ptrs.begin(), ptrs.end());
+      EXPECT_EQ(unique.size(), kNum);
+      for (size_t i = 0; i < kNum; ++i) {
+        EXPECT_EQ(*ptrs[i], i);
+      }
+      EXPECT_GE(arena.bytesReserved(), kNum * sizeof(size_t));
+      arena.reset();
+    }
+  }
+  EXPECT_EQ(tracked.live, 0);
+}
+
+#if defined(DISPENSO_HAS_MEMORY_RESOURCE)
+TEST(ArenaResource, PmrContainers) {
+  dispenso::Arena arena(4096);
+  dispenso::ArenaResource<dispenso::Arena> resource(arena);
+  std::pmr::vector<std::pmr::string> strings(&resource);
+  for (int i = 0; i < 1000; ++i) {
+    strings.emplace_back(std::to_string(i) + " is a string long enough to avoid SSO");
+  }
+  for (int i = 0; i < 1000; ++i) {
+    std::string prefix = std::to_string(i);
+    EXPECT_EQ(std::string(strings[static_cast<size_t>(i)].data(), prefix.size()), prefix);
+  }
+  EXPECT_GT(arena.bytesReserved(), 0);
+}
+#endif // DISPENSO_HAS_MEMORY_RESOURCE
@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/async_io.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif // !_WIN32
+
+#include <gtest/gtest.h>
+
+#if !defined(_WIN32)
+
+namespace {
+// A temporary file, removed when closed.
+struct TempFile {
+  TempFile() : file(std::tmpfile()), fd(fileno(file)) {}
+  ~TempFile() {
+    std::fclose(file);
+  }
+  FILE* file;
+  int fd;
+};
+
+std::string pattern(size_t size, size_t seed) {
+  std::string s(size, '\0');
+  for (size_t i = 0; i < size; ++i) {
+    s[i] = static_cast<char>('a' + (i * 7 + seed) % 26);
+  }
+  return s;
+}
+} // namespace
+
+TEST(AsyncIo, WriteThenRead) {
+  dispenso::ThreadPool pool(2);
+  dispenso::AsyncIo io(pool);
+  TempFile f;
+  std::string contents = pattern(10000, 3);
+  EXPECT_EQ(io.write(f.fd, 0, contents.data(), contents.size()).get(), 10000);
+
+  auto read = io.read(f.fd, 0, contents.size());
+  const auto& buffer = read.get();
+  EXPECT_EQ(buffer.error(), 0);
+  ASSERT_EQ(buffer.size(), contents.size());
+  EXPECT_EQ(std::string(buffer.data(), buffer.size()), contents);
+}
+
+TEST(AsyncIo, ShortReadAtEnd) {
+  dispenso::AsyncIo io;
+  TempFile f;
+  std::string contents = pattern(100, 1);
+  EXPECT_EQ(io.write(f.fd, 0, contents.data(), contents.size()).get(), 100);
+
+  auto tailRead = io.read(f.fd, 60, 100);
+  const auto& tail = tailRead.get();
+  EXPECT_EQ(tail.error(), 0);
+  EXPECT_EQ(std::string(tail.data(), tail.size()), contents.substr(60));
+
+  auto pastRead = io.read(f.fd, 1000, 100);
+  const auto& past = pastRead.get();
+  EXPECT_EQ(past.error(), 0);
+  EXPECT_EQ(past.size(), 0u);
+}
+
+TEST(AsyncIo, ErrorsAreReported) {
+  dispenso::AsyncIo io;
+  TempFile f;
+  int fd = dup(f.fd);
+  close(fd);
+  auto read = io.read(fd, 0, 16);
+  const auto& buffer = read.get();
+  EXPECT_EQ(buffer.error(), EBADF);
+  EXPECT_EQ(buffer.size(), 0u);
+  char byte = 0;
+  EXPECT_EQ(io.write(fd, 0, &byte, 1).get(), -EBADF);
+}
+
+TEST(AsyncIo, LargeReadBeyondPooledBuffers) {
+  dispenso::AsyncIo io(dispenso::globalThreadPool(), 4096);
+  TempFile f;
+  std::string contents = pattern(100000, 5);
+  EXPECT_EQ(io.write(f.fd, 0, contents.data(), contents.size()).get(), 100000);
+  auto read = io.read(f.fd, 0, contents.size());
+  const auto& buffer = read.get();
+  EXPECT_GE(buffer.capacity(), contents.size());
+  EXPECT_EQ(std::string(buffer.data(), buffer.size()), contents);
+}
+
+TEST(AsyncIo, ManyReadsWithContinuations) {
+  constexpr size_t kBlock = 512;
+  constexpr size_t kBlocks = 200;
+  dispenso::ThreadPool pool(4);
+  TempFile f;
+  std::string contents = pattern(kBlock * kBlocks, 11);
+  ASSERT_EQ(
+      static_cast<size_t>(pwrite(f.fd, contents.data(), contents.size(), 0)), contents.size());
+
+  std::vector<dispenso::Future<bool>> checks;
+  {
+    // A shallow queue forces submitters to wait for completions.
+    dispenso::AsyncIo io(pool, kBlock, 4);
+    for (size_t b = 0; b < kBlocks; ++b) {
+      checks.push_back(io.read(f.fd, b * kBlock, kBlock)
+                           .then(
+                               [&contents, b](dispenso::Future<dispenso::IoBuffer>&& r) {
+                                 const auto& buffer = r.get();
+                                 return std::string(buffer.data(), buffer.size()) ==
+                                     contents.substr(b * kBlock, kBlock);
+                               },
+                               pool));
+    }
+    for (auto& c : checks) {
+      EXPECT_TRUE(c.get());
+    }
+  }
+}
+
+TEST(AsyncIo, DestructionWaitsForOutstanding) {
+  TempFile f;
+  std::string contents = pattern(4096, 2);
+  std::vector<dispenso::Future<ssize_t>> writes;
+  {
+    dispenso::AsyncIo io;
+    for (size_t i = 0; i < 64; ++i) {
+      writes.push_back(io.write(f.fd, i * contents.size(), contents.data(), contents.size()));
+    }
+  }
+  for (auto& w : writes) {
+    EXPECT_TRUE(w.is_ready());
+    EXPECT_EQ(w.get(), static_cast<ssize_t>(contents.size()));
+  }
+}
+
+#endif // !_WIN32
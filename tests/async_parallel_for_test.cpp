@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/async_parallel_for.h>
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+TEST(AsyncParallelFor, Ranges) {
+  dispenso::ThreadPool pool(4);
+  for (auto chunking :
+       {dispenso::ParForChunking::kStatic,
+        dispenso::ParForChunking::kAuto,
+        dispenso::ParForChunking::kGuided,
+        dispenso::ParForChunking::kAdaptive}) {
+    std::vector<std::atomic<int>> visits(10000);
+    auto done = dispenso::async_parallel_for(
+        pool, dispenso::makeChunkedRange(0, 10000, chunking), [&visits](int b, int e) {
+          for (int i = b; i < e; ++i) {
+            visits[static_cast<size_t>(i)].fetch_add(1, std::memory_order_relaxed);
+          }
+        });
+    done.get();
+    for (auto& v : visits) {
+      ASSERT_EQ(v.load(), 1);
+    }
+  }
+}
+
+TEST(AsyncParallelFor, Indices) {
+  std::vector<int> values(5000, 0);
+  dispenso::async_parallel_for(0, 5000, [&values](int i) { values[static_cast<size_t>(i)] = i; })
+      .get();
+  for (int i = 0; i < 5000; ++i) {
+    EXPECT_EQ(values[static_cast<size_t>(i)], i);
+  }
+}
+
+TEST(AsyncParallelFor, EmptyAndInline) {
+  dispenso::ThreadPool pool(0);
+  int calls = 0;
+  auto empty = dispenso::async_parallel_for(pool, 5, 5, [&calls](int) { ++calls; });
+  EXPECT_TRUE(empty.is_ready());
+  auto inlined = dispenso::async_parallel_for(pool, 0, 100, [&calls](int) { ++calls; });
+  EXPECT_TRUE(inlined.is_ready());
+  EXPECT_EQ(calls, 100);
+}
+
+TEST(AsyncParallelFor, ThenChains) {
+  dispenso::ThreadPool pool(4);
+  std::vector<int> a(4096, 0);
+  std::vector<int> b(4096, 0);
+  auto result =
+      dispenso::async_parallel_for(pool, size_t{0}, a.size(), [&a](size_t i) {
+        a[i] = static_cast<int>(i);
+      }).then([&](dispenso::Future<void>&&) {
+          // The second loop reads the first loop's output.
+          dispenso::async_parallel_for(pool, size_t{0}, b.size(), [&](size_t i) {
+            b[i] = 2 * a[i];
+          }).get();
+          return 7;
+        },
+        pool);
+  EXPECT_EQ(result.get(), 7);
+  for (size_t i = 0; i < b.size(); ++i) {
+    EXPECT_EQ(b[i], 2 * static_cast<int>(i));
+  }
+}
+
+TEST(AsyncParallelFor, WhenAll) {
+  dispenso::ThreadPool pool(3);
+  std::vector<std::atomic<int>> visits(3000);
+  std::vector<dispenso::Future<void>> loops;
+  for (int l = 0; l < 3; ++l) {
+    loops.push_back(dispenso::async_parallel_for(pool, l * 1000, (l + 1) * 1000, [&visits](int i) {
+      visits[static_cast<size_t>(i)].fetch_add(1, std::memory_order_relaxed);
+    }));
+  }
+  auto all = dispenso::when_all(loops.begin(), loops.end());
+  all.wait();
+  for (auto& v : visits) {
+    ASSERT_EQ(v.load(), 1);
+  }
+}
+
+TEST(AsyncParallelFor, MaxThreads) {
+  dispenso::ThreadPool pool(6);
+  std::atomic<int> sum(0);
+  dispenso::ParForOptions options;
+  options.maxThreads = 2;
+  dispenso::async_parallel_for(
+      pool,
+      dispenso::makeChunkedRange(0, 1000, dispenso::ParForChunking::kAuto),
+      [&sum](int b, int e) { sum.fetch_add(e - b, std::memory_order_relaxed); },
+      options)
+      .get();
+  EXPECT_EQ(sum.load(), 1000);
+}
+
+#if defined(__cpp_exceptions)
+TEST(AsyncParallelFor, Exception) {
+  dispenso::ThreadPool pool(4);
+  auto done = dispenso::async_parallel_for(pool, 0, 10000, [](int i) {
+    if (i == 777) {
+      throw std::runtime_error("boom");
+    }
+  });
+  EXPECT_THROW(done.get(), std::runtime_error);
+}
+#endif // __cpp_exceptions
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/barrier.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+TEST(Barrier, SingleParticipant) {
+  int phases = 0;
+  dispenso::Barrier barrier(1, [&phases]() { ++phases; });
+  for (int i = 0; i < 10; ++i) {
+    barrier.arriveAndWait();
+  }
+  EXPECT_EQ(phases, 10);
+}
+
+TEST(Barrier, PhasesStayInLockstep) {
+  constexpr int kThreads = 6;
+  constexpr int kPhases = 2000;
+  std::atomic<int> arrivals(0);
+  int completions = 0;
+  std::atomic<int> errors(0);
+  dispenso::Barrier barrier(kThreads, [&]() {
+    // All participants of this phase have arrived, and none of the next.
+    if (arrivals.load(std::memory_order_relaxed) != (completions + 1) * kThreads) {
+      errors.fetch_add(1);
+    }
+    ++completions;
+  });
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&]() {
+      for (int p = 0; p < kPhases; ++p) {
+        arrivals.fetch_add(1, std::memory_order_relaxed);
+        barrier.arriveAndWait();
+        // The completion for this phase has run before anyone is released.
+        if (completions < p + 1) {
+          errors.fetch_add(1);
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  EXPECT_EQ(completions, kPhases);
+  EXPECT_EQ(errors.load(), 0);
+}
+
+TEST(Barrier, ArriveAndDrop) {
+  constexpr int kPhases = 100;
+  std::atomic<int> completions(0);
+  dispenso::Barrier barrier(3, [&completions]() { completions.fetch_add(1); });
+  std::thread dropper([&]() {
+    barrier.arriveAndWait();
+    barrier.arriveAndDrop();
+  });
+  std::thread stayer([&]() {
+    for (int p = 0; p < kPhases; ++p) {
+      barrier.arriveAndWait();
+    }
+  });
+  for (int p = 0; p < kPhases; ++p) {
+    barrier.arriveAndWait();
+  }
+  dropper.join();
+  stayer.join();
+  EXPECT_EQ(completions.load(), kPhases);
+}
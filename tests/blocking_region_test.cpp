@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/blocking_region.h>
+#include <dispenso/latch.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+static void waitFor(const std::atomic<int>& count, int target) {
+  while (count.load(std::memory_order_acquire) < target) {
+    std::this_thread::yield();
+  }
+}
+
+TEST(BlockingRegion, ExternalThreadNotCompensated) {
+  dispenso::ThreadPool pool(1);
+  dispenso::BlockingRegion blocking(pool);
+  EXPECT_FALSE(blocking.compensated());
+}
+
+TEST(BlockingRegion, SpareRunsQueuedWork) {
+  dispenso::ThreadPool pool(1);
+  dispenso::Latch released(1);
+  std::atomic<int> done(0);
+
+  dispenso::Latch blockingStarted(1);
+  pool.schedule([&]() {
+    dispenso::BlockingRegion blocking(pool);
+    EXPECT_TRUE(blocking.compensated());
+    blockingStarted.countDown();
+    // Only a spare thread can run the task that releases us.
+    EXPECT_TRUE(released.waitFor(std::chrono::seconds(10)));
+    done.fetch_add(1, std::memory_order_release);
+  });
+  blockingStarted.wait();
+  pool.schedule([&]() {
+    released.countDown();
+    done.fetch_add(1, std::memory_order_release);
+  });
+  waitFor(done, 2);
+}
+
+TEST(BlockingRegion, NestedOnSpares) {
+  constexpr int kTasks = 8;
+  dispenso::ThreadPool pool(2);
+  for (int round = 0; round < 3; ++round) {
+    dispenso::Latch allBlocked(kTasks);
+    std::atomic<int> done(0);
+    for (int i = 0; i < kTasks; ++i) {
+      pool.schedule(
+          [&]() {
+            dispenso::BlockingRegion blocking(pool);
+            EXPECT_TRUE(blocking.compensated());
+            allBlocked.countDown();
+            EXPECT_TRUE(allBlocked.waitFor(std::chrono::seconds(10)));
+            done.fetch_add(1, std::memory_order_release);
+          },
+          dispenso::ForceQueuingTag());
+    }
+    waitFor(done, kTasks);
+  }
+
+  // Spares park once blocking ends, and the pool keeps working normally.
+  std::atomic<int> count(0);
+  for (int i = 0; i < 1000; ++i) {
+    pool.schedule([&count]() { count.fetch_add(1, std::memory_order_release); });
+  }
+  waitFor(count, 1000);
+}
+
+TEST(BlockingRegion, GlobalPoolDefault) {
+  std::atomic<int> done(0);
+  dispenso::globalThreadPool().schedule(
+      [&]() {
+        dispenso::BlockingRegion blocking;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        done.fetch_add(1, std::memory_order_release);
+      },
+      dispenso::ForceQueuingTag());
+  waitFor(done, 1);
+}
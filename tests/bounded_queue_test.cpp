@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/bounded_queue.h>
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+TEST(BoundedQueue, CapacityRoundsUp) {
+  EXPECT_EQ(dispenso::BoundedQueue<int>(0).capacity(), 2);
+  EXPECT_EQ(dispenso::BoundedQueue<int>(5).capacity(), 8);
+  EXPECT_EQ(dispenso::BoundedQueue<int>(64).capacity(), 64);
+}
+
+TEST(BoundedQueue, FifoAndFull) {
+  dispenso::BoundedQueue<int> queue(8);
+  EXPECT_TRUE(queue.empty());
+  for (int round = 0; round < 3; ++round) {
+    for (int i = 0; i < 8; ++i) {
+      EXPECT_TRUE(queue.tryPush(i));
+    }
+    EXPECT_FALSE(queue.tryPush(8));
+    EXPECT_EQ(queue.size(), 8);
+    int value;
+    for (int i = 0; i < 8; ++i) {
+      ASSERT_TRUE(queue.tryPop(value));
+      EXPECT_EQ(value, i);
+    }
+    EXPECT_FALSE(queue.tryPop(value));
+    EXPECT_TRUE(queue.empty());
+  }
+}
+
+TEST(BoundedQueue, MoveOnlyAndDestruction) {
+  auto counter = std::make_shared<int>(0);
+  {
+    dispenso::BoundedQueue<std::shared_ptr<int>> queue(4);
+    EXPECT_TRUE(queue.tryPush(counter));
+    EXPECT_TRUE(queue.tryEmplace(counter));
+    EXPECT_EQ(counter.use_count(), 3);
+    std::shared_ptr<int> out;
+    EXPECT_TRUE(queue.tryPop(out));
+    EXPECT_EQ(counter.use_count(), 3);
+    out.reset();
+    EXPECT_EQ(counter.use_count(), 2);
+  }
+  // The element still in the queue is destroyed along with it.
+  EXPECT_EQ(counter.use_count(), 1);
+
+  dispenso::BoundedQueue<std::unique_ptr<int>> queue(2);
+  EXPECT_TRUE(queue.tryPush(std::make_unique<int>(3)));
+  std::unique_ptr<int> out;
+  EXPECT_TRUE(queue.pop(out));
+  EXPECT_EQ(*out, 3);
+}
+
+TEST(BoundedQueue, Close) {
+  dispenso::BoundedQueue<int> queue(4);
+  EXPECT_TRUE(queue.push(1));
+  EXPECT_TRUE(queue.push(2));
+  queue.close();
+  EXPECT_TRUE(queue.closed());
+  EXPECT_FALSE(queue.push(3));
+  EXPECT_FALSE(queue.tryPush(3));
+  int value;
+  EXPECT_TRUE(queue.pop(value));
+  EXPECT_EQ(value, 1);
+  EXPECT_TRUE(queue.pop(value));
+  EXPECT_EQ(value, 2);
+  EXPECT_FALSE(queue.pop(value));
+}
+
+TEST(BoundedQueue, CloseWakesBlockedConsumers) {
+  dispenso::BoundedQueue<int> queue(4);
+  std::vector<std::thread> consumers;
+  std::atomic<int> finished(0);
+  for (int i = 0; i < 4; ++i) {
+    consumers.emplace_back([&queue, &finished]() {
+      int value;
+      while (queue.pop(value)) {
+      }
+      finished.fetch_add(1);
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  queue.close();
+  for (auto& t : consumers) {
+    t.join();
+  }
+  EXPECT_EQ(finished.load(), 4);
+}
+
+TEST(BoundedQueue, BlockingProducersAndConsumers) {
+  // A small capacity keeps both sides frequently blocked.
+  dispenso::BoundedQueue<int64_t> queue(4);
+  constexpr int kProducers = 4;
+  constexpr int kConsumers = 3;
+  constexpr int64_t kPerProducer = 50000;
+
+  std::vector<std::thread> threads;
+  for (int p = 0; p < kProducers; ++p) {
+    threads.emplace_back([&queue, p]() {
+      for (int64_t i = 0; i < kPerProducer; ++i) {
+        EXPECT_TRUE(queue.push(p * kPerProducer + i));
+      }
+    });
+  }
+  std::vector<int64_t> sums(kConsumers, 0);
+  std::vector<int64_t> counts(kConsumers, 0);
+  std::vector<std::thread> consumers;
+  for (int c = 0; c < kConsumers; ++c) {
+    consumers.emplace_back([&queue, &sums, &counts, c]() {
+      int64_t value;
+      // Values from any one producer must arrive in order.
+      std::vector<int64_t> last(kProducers, -1);
+      while (queue.pop(value)) {
+        int64_t producer = value / kPerProducer;
+        EXPECT_GT(value, last[producer]);
+        last[producer] = value;
+        sums[c] += value;
+        ++counts[c];
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  queue.close();
+  for (auto& t : consumers) {
+    t.join();
+  }
+
+  constexpr int64_t kTotal = kProducers * kPerProducer;
+  int64_t sum = 0;
+  int64_t count = 0;
+  for (int c = 0; c < kConsumers; ++c) {
+    sum += sums[c];
+    count += counts[c];
+  }
+  EXPECT_EQ(count, kTotal);
+  EXPECT_EQ(sum, kTotal * (kTotal - 1) / 2);
+}
+
+TEST(BoundedQueue, NonBlockingStress) {
+  dispenso::BoundedQueue<int> queue(64);
+  constexpr int kPerThread = 100000;
+  std::atomic<int64_t> popped(0);
+  std::atomic<int64_t> sum(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&]() {
+      for (int i = 0; i < kPerThread; ++i) {
+        while (!queue.tryPush(i)) {
+          int value;
+          if (queue.tryPop(value)) {
+            popped.fetch_add(1, std::memory_order_relaxed);
+            sum.fetch_add(value, std::memory_order_relaxed);
+          }
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  int value;
+  while (queue.tryPop(value)) {
+    popped.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(value, std::memory_order_relaxed);
+  }
+  EXPECT_EQ(popped.load(), 4 * kPerThread);
+  EXPECT_EQ(sum.load(), 4 * (int64_t{kPerThread} * (kPerThread - 1) / 2));
+}
@@ -5,7 +5,13 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <list>
+#include <mutex>
+#include <numeric>
+#include <thread>
 #include <vector>
 
 #include <dispenso/parallel_for.h>
@@ -74,6 +80,41 @@ TEST(ChunkedFor, SimpleLoopStatic) {
       static_cast<int>(std::thread::hardware_concurrency()));
 }
 
+TEST(ChunkedFor, SimpleLoopStaticNumaPlacement) {
+  int w = 1024;
+  int h = 1024;
+  std::vector<int> image(static_cast<size_t>(w * h), 7);
+
+  dispenso::ThreadPool pool(4);
+  pool.setNumaAware(true);
+
+  dispenso::ParForOptions options;
+  options.numaPlacement = true;
+
+  for (bool wait : {true, false}) {
+    std::atomic<int64_t> sum(0);
+    options.wait = wait;
+    dispenso::TaskSet tasks(pool);
+    dispenso::parallel_for(
+        tasks,
+        dispenso::makeChunkedRange(0, h, dispenso::ParForChunking::kStatic),
+        [w, &image, &sum](int ystart, int yend) {
+          int64_t s = 0;
+          for (int y = ystart; y < yend; ++y) {
+            int* row = image.data() + y * w;
+            for (int i = 0; i < w; ++i) {
+              s += row[i];
+            }
+          }
+          sum.fetch_add(s, std::memory_order_relaxed);
+        },
+        options);
+    tasks.wait();
+
+    EXPECT_EQ(sum.load(std::memory_order_relaxed), w * h * 7);
+  }
+}
+
 TEST(ChunkedFor, SimpleLoopAuto) {
   int w = 1024;
   int h = 1024;
@@ -102,6 +143,282 @@ TEST(ChunkedFor, SimpleLoopAuto) {
   EXPECT_LE(numCalls.load(std::memory_order_relaxed), 1024);
 }
 
+static void checkDynamicChunking(dispenso::ParForChunking chunking) {
+  constexpr int kN = 100000;
+  dispenso::ThreadPool pool(6);
+  for (bool wait : {true, false}) {
+    std::vector<std::atomic<int>> visits(kN);
+    std::atomic<int> numCalls(0);
+    dispenso::TaskSet tasks(pool);
+    dispenso::ParForOptions options;
+    options.wait = wait;
+    dispenso::parallel_for(
+        tasks,
+        dispenso::makeChunkedRange(0, kN, chunking),
+        [&](int start, int end) {
+          EXPECT_LT(start, end);
+          numCalls.fetch_add(1, std::memory_order_relaxed);
+          for (int i = start; i < end; ++i) {
+            // Irregular cost per index.
+            if (i % 1000 == 0) {
+              std::this_thread::sleep_for(std::chrono::microseconds(20));
+            }
+            visits[i].fetch_add(1, std::memory_order_relaxed);
+          }
+        },
+        options);
+    tasks.wait();
+    for (auto& v : visits) {
+      ASSERT_EQ(v.load(), 1);
+    }
+    EXPECT_GT(numCalls.load(), 1);
+    EXPECT_LT(numCalls.load(), kN);
+  }
+
+  std::vector<int64_t> states;
+  dispenso::TaskSet tasks(pool);
+  dispenso::parallel_for(
+      tasks,
+      states,
+      []() { return int64_t{0}; },
+      dispenso::makeChunkedRange(0, kN, chunking),
+      [](int64_t& sum, int start, int end) {
+        for (int i = start; i < end; ++i) {
+          sum += i;
+        }
+      });
+  int64_t sum = 0;
+  for (int64_t s : states) {
+    sum += s;
+  }
+  EXPECT_EQ(sum, int64_t{kN} * (kN - 1) / 2);
+}
+
+TEST(ChunkedFor, LoopGuided) {
+  checkDynamicChunking(dispenso::ParForChunking::kGuided);
+}
+
+TEST(ChunkedFor, LoopAdaptive) {
+  checkDynamicChunking(dispenso::ParForChunking::kAdaptive);
+}
+
+void checkStopOnCancel(dispenso::ParForChunking chunking) {
+  dispenso::ThreadPool pool(4);
+  dispenso::TaskSet tasks(pool);
+  dispenso::CancellationToken token(tasks);
+  constexpr int kNumItems = 1 << 20;
+  constexpr int kTarget = 1000;
+  std::atomic<int> found(-1);
+  std::atomic<int> itemsRun(0);
+
+  dispenso::ParForOptions options;
+  options.stopOnCancel = true;
+  options.defaultChunking = chunking;
+  dispenso::parallel_for(
+      tasks,
+      0,
+      kNumItems,
+      [&](int i) {
+        itemsRun.fetch_add(1, std::memory_order_relaxed);
+        if (i == kTarget) {
+          found.store(i, std::memory_order_relaxed);
+          token.cancel();
+        }
+      },
+      options);
+
+  EXPECT_TRUE(token.canceled());
+  EXPECT_EQ(found.load(), kTarget);
+  EXPECT_LT(itemsRun.load(), kNumItems);
+}
+
+TEST(ChunkedFor, StopOnCancelAuto) {
+  checkStopOnCancel(dispenso::ParForChunking::kAuto);
+}
+
+TEST(ChunkedFor, StopOnCancelGuided) {
+  checkStopOnCancel(dispenso::ParForChunking::kGuided);
+}
+
+TEST(ChunkedFor, NoStopOnCancelByDefault) {
+  dispenso::ThreadPool pool(4);
+  dispenso::TaskSet tasks(pool);
+  dispenso::CancellationToken token(tasks);
+  std::atomic<int> itemsRun(0);
+
+  dispenso::ParForOptions options;
+  options.defaultChunking = dispenso::ParForChunking::kAuto;
+  dispenso::parallel_for(
+      tasks,
+      0,
+      10000,
+      [&](int i) {
+        if (i == 0) {
+          token.cancel();
+        }
+        itemsRun.fetch_add(1, std::memory_order_relaxed);
+      },
+      options);
+
+  // Without stopOnCancel, the calling thread keeps claiming chunks until the range is exhausted.
+  EXPECT_TRUE(token.canceled());
+  EXPECT_EQ(itemsRun.load(), 10000);
+}
+
+TEST(ChunkedFor, MinItemsPerChunkRunsSmallLoopsInline) {
+  dispenso::ThreadPool pool(4);
+  dispenso::TaskSet tasks(pool);
+  const std::thread::id caller = std::this_thread::get_id();
+  std::atomic<int> calls(0);
+
+  dispenso::ParForOptions options;
+  options.minItemsPerChunk = 100;
+  for (auto chunking : {dispenso::ParForChunking::kStatic, dispenso::ParForChunking::kAuto}) {
+    dispenso::parallel_for(
+        tasks,
+        dispenso::makeChunkedRange(0, 150, chunking),
+        [&](int b, int e) {
+          EXPECT_EQ(std::this_thread::get_id(), caller);
+          EXPECT_EQ(b, 0);
+          EXPECT_EQ(e, 150);
+          calls.fetch_add(1, std::memory_order_relaxed);
+        },
+        options);
+  }
+  EXPECT_EQ(calls.load(), 2);
+}
+
+void checkMinItemsPerChunk(dispenso::ParForChunking chunking) {
+  dispenso::ThreadPool pool(8);
+  dispenso::TaskSet tasks(pool);
+  constexpr int kNumItems = 1000;
+  std::atomic<int> chunks(0);
+  std::atomic<int> small(0);
+  std::atomic<int> itemsRun(0);
+
+  dispenso::ParForOptions options;
+  options.minItemsPerChunk = 300;
+  dispenso::parallel_for(
+      tasks,
+      dispenso::makeChunkedRange(0, kNumItems, chunking),
+      [&](int b, int e) {
+        chunks.fetch_add(1, std::memory_order_relaxed);
+        // Only the tail of a dynamically chunked range may come up short.
+        small.fetch_add(e - b < 300 && e != kNumItems, std::memory_order_relaxed);
+        itemsRun.fetch_add(e - b, std::memory_order_relaxed);
+      },
+      options);
+
+  EXPECT_EQ(itemsRun.load(), kNumItems);
+  EXPECT_EQ(small.load(), 0);
+  EXPECT_LE(chunks.load(), 4);
+}
+
+TEST(ChunkedFor, MinItemsPerChunkStatic) {
+  checkMinItemsPerChunk(dispenso::ParForChunking::kStatic);
+}
+
+TEST(ChunkedFor, MinItemsPerChunkAuto) {
+  checkMinItemsPerChunk(dispenso::ParForChunking::kAuto);
+}
+
+TEST(ChunkedFor, MinItemsPerChunkGuided) {
+  checkMinItemsPerChunk(dispenso::ParForChunking::kGuided);
+}
+
+TEST(ChunkedFor, CostHintCapsThreads) {
+  dispenso::ThreadPool pool(8);
+  dispenso::TaskSet tasks(pool);
+  const std::thread::id caller = std::this_thread::get_id();
+
+  // 1000 items at 1ns each are far below the cost of a chunk; run inline.
+  dispenso::ParForOptions options;
+  options.costPerItemNs = 1.0;
+  std::atomic<int> offCaller(0);
+  dispenso::parallel_for(
+      tasks,
+      0,
+      1000,
+      [&](int) {
+        offCaller.fetch_add(std::this_thread::get_id() != caller, std::memory_order_relaxed);
+      },
+      options);
+  EXPECT_EQ(offCaller.load(), 0);
+
+  // At 10ns each, 3000 items make three worthwhile chunks, so at most two pool threads help.
+  options.costPerItemNs = 10.0;
+  std::atomic<int> chunks(0);
+  std::atomic<int> itemsRun(0);
+  dispenso::parallel_for(
+      tasks,
+      dispenso::makeChunkedRange(0, 3000),
+      [&](int b, int e) {
+        chunks.fetch_add(1, std::memory_order_relaxed);
+        EXPECT_GE(e - b, 1000);
+        itemsRun.fetch_add(e - b, std::memory_order_relaxed);
+      },
+      options);
+  EXPECT_EQ(chunks.load(), 3);
+  EXPECT_EQ(itemsRun.load(), 3000);
+}
+
+TEST(ChunkedFor, AlignedStaticChunks) {
+  dispenso::ThreadPool pool(5);
+  dispenso::TaskSet tasks(pool);
+  constexpr uint32_t kAlign = dispenso::elementsPerCacheLine<float>();
+  static_assert(kAlign == dispenso::kCacheLineSize / sizeof(float), "");
+
+  for (int start : {0, 3, -37}) {
+    for (int end : {start + 1, start + 40, start + 1000, start + 12345}) {
+      std::vector<int> hits(static_cast<size_t>(end - start), 0);
+      std::atomic<int> chunks(0);
+      dispenso::ParForOptions options;
+      options.chunkAlignment = kAlign;
+      dispenso::parallel_for(
+          tasks,
+          dispenso::makeChunkedRange(start, end, dispenso::ParForChunking::kStatic),
+          [&](int b, int e) {
+            chunks.fetch_add(1, std::memory_order_relaxed);
+            EXPECT_LT(b, e);
+            // Interior boundaries fall on multiples of the alignment.
+            EXPECT_TRUE(b == start || ((b % static_cast<int>(kAlign)) + kAlign) % kAlign == 0);
+            EXPECT_TRUE(e == end || ((e % static_cast<int>(kAlign)) + kAlign) % kAlign == 0);
+            for (int i = b; i < e; ++i) {
+              ++hits[static_cast<size_t>(i - start)];
+            }
+          },
+          options);
+      EXPECT_EQ(std::count(hits.begin(), hits.end(), 1), end - start);
+      EXPECT_GE(chunks.load(), 1);
+      EXPECT_LE(chunks.load(), 6);
+    }
+  }
+}
+
+TEST(ChunkedFor, AlignedStaticChunksWithState) {
+  dispenso::ThreadPool pool(3);
+  dispenso::TaskSet tasks(pool);
+  std::vector<int64_t> sums;
+  dispenso::ParForOptions options;
+  options.chunkAlignment = 64;
+  dispenso::parallel_for(
+      tasks,
+      sums,
+      []() { return int64_t{0}; },
+      dispenso::makeChunkedRange(0, 200, dispenso::ParForChunking::kStatic),
+      [](int64_t& sum, int b, int e) {
+        EXPECT_TRUE(b == 0 || b % 64 == 0);
+        EXPECT_TRUE(e == 200 || e % 64 == 0);
+        for (int i = b; i < e; ++i) {
+          sum += i;
+        }
+      },
+      options);
+  // 200 indices make at most three chunks of at least 64.
+  EXPECT_EQ(sums.size(), 3u);
+  EXPECT_EQ(std::accumulate(sums.begin(), sums.end(), int64_t{0}), 199 * 200 / 2);
+}
+
 template <typename StateContainer>
 void loopWithStateImpl() {
   int w = 1024;
@@ -142,3 +459,246 @@ TEST(ChunkedFor, LoopWithVectorState) {
 TEST(ChunkedFor, LoopWithListState) {
   loopWithStateImpl<std::list<int64_t>>();
 }
+
+TEST(ChunkedFor, Loop2D) {
+  dispenso::ThreadPool pool(6);
+  for (auto chunking : {dispenso::ParForChunking::kStatic, dispenso::ParForChunking::kAuto}) {
+    for (int h : {1, 3, 100, 257}) {
+      for (int w : {1, 7, 100, 300}) {
+        std::vector<std::atomic<int>> visits(h * w);
+        dispenso::TaskSet tasks(pool);
+        dispenso::parallel_for(
+            tasks,
+            dispenso::makeChunkedRange2D(0, h, 0, w, chunking),
+            [&](int yb, int ye, int xb, int xe) {
+              EXPECT_LT(yb, ye);
+              EXPECT_LT(xb, xe);
+              for (int y = yb; y < ye; ++y) {
+                for (int x = xb; x < xe; ++x) {
+                  visits[y * w + x].fetch_add(1, std::memory_order_relaxed);
+                }
+              }
+            });
+        for (auto& v : visits) {
+          ASSERT_EQ(v.load(), 1);
+        }
+      }
+    }
+  }
+}
+
+TEST(ChunkedFor, Loop2DExplicitTiles) {
+  dispenso::ThreadPool pool(4);
+  dispenso::TaskSet tasks(pool);
+  std::atomic<int> tiles(0);
+  std::atomic<int64_t> area(0);
+  dispenso::parallel_for(
+      tasks,
+      dispenso::ChunkedRange2D<int>(10, 50, -20, 20, dispenso::ParForChunking::kAuto, 8, 16),
+      [&](int yb, int ye, int xb, int xe) {
+        EXPECT_LE(ye - yb, 8);
+        EXPECT_LE(xe - xb, 16);
+        EXPECT_EQ((yb - 10) % 8, 0);
+        EXPECT_EQ((xb + 20) % 16, 0);
+        ++tiles;
+        area += (ye - yb) * (xe - xb);
+      });
+  // 5 tile rows by 3 tile columns.
+  EXPECT_EQ(tiles.load(), 15);
+  EXPECT_EQ(area.load(), 40 * 40);
+}
+
+TEST(ChunkedFor, Loop3D) {
+  constexpr int kD = 13;
+  constexpr int kH = 40;
+  constexpr int kW = 70;
+  std::vector<std::atomic<int>> visits(kD * kH * kW);
+  dispenso::ThreadPool pool(5);
+  dispenso::TaskSet tasks(pool);
+  dispenso::parallel_for(
+      tasks,
+      dispenso::makeChunkedRange3D(0, kD, 0, kH, 0, kW, dispenso::ParForChunking::kAuto),
+      [&](int zb, int ze, int yb, int ye, int xb, int xe) {
+        for (int z = zb; z < ze; ++z) {
+          for (int y = yb; y < ye; ++y) {
+            for (int x = xb; x < xe; ++x) {
+              visits[(z * kH + y) * kW + x].fetch_add(1, std::memory_order_relaxed);
+            }
+          }
+        }
+      });
+  for (auto& v : visits) {
+    ASSERT_EQ(v.load(), 1);
+  }
+}
+
+TEST(ChunkedFor, Loop2DEmpty) {
+  dispenso::TaskSet tasks(dispenso::globalThreadPool());
+  dispenso::parallel_for(tasks, dispenso::makeChunkedRange2D(0, 10, 5, 5), [](int, int, int, int) {
+    EXPECT_TRUE(false);
+  });
+}
+
+TEST(ChunkedFor, AffinityPartitionerCoversRange) {
+  constexpr int kSize = 10000;
+  constexpr int kIters = 20;
+  std::vector<std::atomic<int>> visits(kSize);
+  dispenso::ThreadPool pool(4);
+  for (auto chunking : {dispenso::ParForChunking::kStatic, dispenso::ParForChunking::kAuto}) {
+    for (auto& v : visits) {
+      v.store(0);
+    }
+    dispenso::AffinityPartitioner partitioner;
+    dispenso::ParForOptions options;
+    options.affinity = &partitioner;
+    for (int iter = 0; iter < kIters; ++iter) {
+      dispenso::TaskSet tasks(pool);
+      dispenso::parallel_for(
+          tasks,
+          dispenso::makeChunkedRange(0, kSize, chunking),
+          [&visits](int b, int e) {
+            for (int i = b; i < e; ++i) {
+              visits[i].fetch_add(1, std::memory_order_relaxed);
+            }
+          },
+          options);
+      EXPECT_GT(partitioner.numChunks(), 0u);
+      EXPECT_LE(partitioner.lastAffinityHits(), partitioner.numChunks());
+    }
+    for (auto& v : visits) {
+      ASSERT_EQ(v.load(), kIters);
+    }
+  }
+}
+
+TEST(ChunkedFor, AffinityPartitionerChangingRanges) {
+  dispenso::ThreadPool pool(3);
+  dispenso::AffinityPartitioner partitioner;
+  dispenso::ParForOptions options;
+  options.affinity = &partitioner;
+  for (int size : {1000, 37, 1000, 5000, 2, 5000}) {
+    std::vector<std::atomic<int>> visits(static_cast<size_t>(size));
+    dispenso::TaskSet tasks(pool);
+    dispenso::parallel_for(
+        tasks,
+        dispenso::ChunkedRange<int>(0, size, 16),
+        [&visits](int b, int e) {
+          EXPECT_LE(e - b, 16);
+          for (int i = b; i < e; ++i) {
+            visits[static_cast<size_t>(i)].fetch_add(1, std::memory_order_relaxed);
+          }
+        },
+        options);
+    for (auto& v : visits) {
+      ASSERT_EQ(v.load(), 1);
+    }
+  }
+  partitioner.reset();
+  EXPECT_EQ(partitioner.numChunks(), 0u);
+}
+
+TEST(ChunkedFor, AffinityPartitionerNoWait) {
+  constexpr int kSize = 4096;
+  std::vector<int> values(kSize, 0);
+  dispenso::ThreadPool pool(4);
+  dispenso::AffinityPartitioner partitioner;
+  dispenso::ParForOptions options;
+  options.affinity = &partitioner;
+  options.wait = false;
+  dispenso::TaskSet tasks(pool);
+  for (int iter = 0; iter < 10; ++iter) {
+    dispenso::parallel_for(
+        tasks,
+        dispenso::makeChunkedRange(0, kSize, dispenso::ParForChunking::kAuto),
+        [&values](int b, int e) {
+          for (int i = b; i < e; ++i) {
+            ++values[static_cast<size_t>(i)];
+          }
+        },
+        options);
+    tasks.wait();
+  }
+  for (int v : values) {
+    ASSERT_EQ(v, 10);
+  }
+}
+
+// While the pool's only thread is busy elsewhere, the calling thread runs every chunk, and so owns
+// them all; the next loop then runs each chunk on the thread it was assigned to.
+TEST(ChunkedFor, AffinityPartitionerReproducesPlacement) {
+  dispenso::ThreadPool pool(1);
+  std::atomic<bool> blocked(false);
+  std::atomic<bool> release(false);
+  pool.schedule(
+      [&]() {
+        blocked.store(true);
+        while (!release.load()) {
+          std::this_thread::yield();
+        }
+      },
+      dispenso::ForceQueuingTag());
+  while (!blocked.load()) {
+    std::this_thread::yield();
+  }
+
+  dispenso::AffinityPartitioner partitioner;
+  dispenso::ParForOptions options;
+  options.affinity = &partitioner;
+  std::atomic<int64_t> sum(0);
+  for (int iter = 0; iter < 2; ++iter) {
+    dispenso::TaskSet tasks(pool);
+    dispenso::parallel_for(
+        tasks,
+        dispenso::ChunkedRange<int>(0, 1000, 10),
+        [&sum](int b, int e) {
+          for (int i = b; i < e; ++i) {
+            sum.fetch_add(i, std::memory_order_relaxed);
+          }
+        },
+        options);
+  }
+  release.store(true);
+  EXPECT_EQ(sum.load(), 2 * 999 * 1000 / 2);
+  EXPECT_EQ(partitioner.numChunks(), 100u);
+  EXPECT_EQ(partitioner.lastAffinityHits(), 100u);
+}
+
+// Loops on a deterministic pool use the same chunks every time, and still cover the range.
+TEST(ChunkedFor, DeterministicPool) {
+  constexpr int kSize = 10000;
+  constexpr int kIters = 10;
+  dispenso::ThreadPool pool(4);
+  pool.setDeterministic(true, 7);
+  EXPECT_TRUE(pool.deterministic());
+  for (auto chunking : {dispenso::ParForChunking::kStatic, dispenso::ParForChunking::kAuto}) {
+    std::vector<std::atomic<int>> visits(kSize);
+    std::vector<int> firstStarts;
+    for (int iter = 0; iter < kIters; ++iter) {
+      std::mutex mtx;
+      std::vector<int> starts;
+      dispenso::TaskSet tasks(pool);
+      dispenso::parallel_for(
+          tasks,
+          dispenso::makeChunkedRange(0, kSize, chunking),
+          [&](int b, int e) {
+            for (int i = b; i < e; ++i) {
+              visits[static_cast<size_t>(i)].fetch_add(1, std::memory_order_relaxed);
+            }
+            std::lock_guard<std::mutex> lk(mtx);
+            starts.push_back(b);
+          });
+      std::sort(starts.begin(), starts.end());
+      if (iter == 0) {
+        firstStarts = starts;
+        EXPECT_GT(firstStarts.size(), 1u);
+      } else {
+        EXPECT_EQ(starts, firstStarts);
+      }
+    }
+    for (auto& v : visits) {
+      ASSERT_EQ(v.load(), kIters);
+    }
+  }
+  pool.setDeterministic(false);
+  EXPECT_FALSE(pool.deterministic());
+}
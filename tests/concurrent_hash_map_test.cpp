@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/concurrent_hash_map.h>
+
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <dispenso/parallel_for.h>
+
+#include <gtest/gtest.h>
+
+TEST(ConcurrentHashMap, InsertFind) {
+  dispenso::ConcurrentHashMap<int, int> map;
+  EXPECT_TRUE(map.empty());
+  EXPECT_EQ(map.find(5), nullptr);
+
+  auto result = map.insert({5, 50});
+  EXPECT_TRUE(result.second);
+  EXPECT_EQ(result.first->first, 5);
+  EXPECT_EQ(result.first->second, 50);
+
+  result = map.insert({5, 51});
+  EXPECT_FALSE(result.second);
+  EXPECT_EQ(result.first->second, 50);
+
+  EXPECT_TRUE(map.emplace(6, 60).second);
+  EXPECT_FALSE(map.emplace(6, 61).second);
+  EXPECT_TRUE(map.try_emplace(7, 70).second);
+  EXPECT_FALSE(map.try_emplace(7, 71).second);
+
+  EXPECT_EQ(map.size(), 3);
+  EXPECT_EQ(map.find(6)->second, 60);
+  EXPECT_EQ(map.count(7), 1);
+  EXPECT_EQ(map.count(8), 0);
+  EXPECT_TRUE(map.contains(5));
+  EXPECT_FALSE(map.contains(8));
+
+  map[8] += 3;
+  map[8] += 4;
+  EXPECT_EQ(map[8], 7);
+  EXPECT_EQ(map.size(), 4);
+}
+
+TEST(ConcurrentHashMap, StringKeys) {
+  dispenso::ConcurrentHashMap<std::string, std::string> map;
+  for (int i = 0; i < 1000; ++i) {
+    map.emplace(std::to_string(i), std::string(static_cast<size_t>(i % 17), 'x'));
+  }
+  EXPECT_EQ(map.size(), 1000);
+  for (int i = 0; i < 1000; ++i) {
+    auto* kv = map.find(std::to_string(i));
+    ASSERT_NE(kv, nullptr);
+    EXPECT_EQ(kv->second.size(), static_cast<size_t>(i % 17));
+  }
+  EXPECT_EQ(map.find("1000"), nullptr);
+}
+
+TEST(ConcurrentHashMap, PointersStableAcrossGrowth) {
+  dispenso::ConcurrentHashMap<int, int> map(0, 1);
+  auto* first = map.insert({-1, -1}).first;
+  for (int i = 0; i < 100000; ++i) {
+    map.insert({i, i});
+  }
+  EXPECT_EQ(map.find(-1), first);
+  EXPECT_EQ(first->second, -1);
+}
+
+TEST(ConcurrentHashMap, EraseMatchesReference) {
+  // A single shard and small key range to exercise long probe runs and wrap around.
+  dispenso::ConcurrentHashMap<int, int> map(0, 1);
+  std::unordered_map<int, int> reference;
+  std::mt19937 rng(13);
+  std::uniform_int_distribution<int> keyDist(0, 500);
+  for (int i = 0; i < 100000; ++i) {
+    int key = keyDist(rng);
+    if (rng() & 1) {
+      EXPECT_EQ(map.insert({key, i}).second, reference.insert({key, i}).second);
+    } else {
+      EXPECT_EQ(map.erase(key), reference.erase(key));
+    }
+  }
+  EXPECT_EQ(map.size(), reference.size());
+  for (int key = 0; key <= 500; ++key) {
+    auto it = reference.find(key);
+    auto* kv = map.find(key);
+    if (it == reference.end()) {
+      EXPECT_EQ(kv, nullptr);
+    } else {
+      ASSERT_NE(kv, nullptr);
+      EXPECT_EQ(kv->second, it->second);
+    }
+  }
+}
+
+namespace {
+struct Counted {
+  Counted(int v) : value(v) {
+    live().fetch_add(1, std::memory_order_relaxed);
+  }
+  Counted(const Counted& other) : value(other.value) {
+    live().fetch_add(1, std::memory_order_relaxed);
+  }
+  ~Counted() {
+    live().fetch_sub(1, std::memory_order_relaxed);
+  }
+  Counted& operator=(const Counted&) = delete;
+
+  static std::atomic<int>& live() {
+    static std::atomic<int> count(0);
+    return count;
+  }
+
+  int value;
+};
+} // namespace
+
+TEST(ConcurrentHashMap, DestroysElements) {
+  {
+    dispenso::ConcurrentHashMap<int, Counted> map;
+    for (int i = 0; i < 1000; ++i) {
+      map.try_emplace(i, i);
+    }
+    // Losing emplace constructs and then destroys its element.
+    map.emplace(std::piecewise_construct, std::forward_as_tuple(5), std::forward_as_tuple(0));
+    EXPECT_EQ(Counted::live().load(), 1000);
+    map.erase(3);
+    EXPECT_EQ(Counted::live().load(), 999);
+    map.clear();
+    EXPECT_EQ(Counted::live().load(), 0);
+    EXPECT_TRUE(map.empty());
+    map.try_emplace(1, 1);
+  }
+  EXPECT_EQ(Counted::live().load(), 0);
+}
+
+TEST(ConcurrentHashMap, ForEachAndReserve) {
+  dispenso::ConcurrentHashMap<int, int> map(10000);
+  for (int i = 0; i < 10000; ++i) {
+    map.insert({i, 2 * i});
+  }
+  map.reserve(100000);
+  int64_t sum = 0;
+  size_t count = 0;
+  map.for_each([&sum, &count](std::pair<const int, int>& kv) {
+    sum += kv.second;
+    ++count;
+    kv.second = 0;
+  });
+  EXPECT_EQ(count, 10000);
+  EXPECT_EQ(sum, int64_t{9999} * 10000);
+  const auto& cmap = map;
+  cmap.for_each([](const std::pair<const int, int>& kv) { EXPECT_EQ(kv.second, 0); });
+}
+
+TEST(ConcurrentHashMap, ConcurrentInsert) {
+  dispenso::ConcurrentHashMap<int, int> map;
+  constexpr int kNum = 200000;
+  // Every key is inserted twice, from different chunks, and only one insert may win.
+  std::atomic<int> wins(0);
+  dispenso::parallel_for(0, 2 * kNum, [&map, &wins](int i) {
+    if (map.insert({i % kNum, i % kNum}).second) {
+      wins.fetch_add(1, std::memory_order_relaxed);
+    }
+  });
+  EXPECT_EQ(wins.load(), kNum);
+  EXPECT_EQ(map.size(), static_cast<size_t>(kNum));
+  for (int i = 0; i < kNum; ++i) {
+    auto* kv = map.find(i);
+    ASSERT_NE(kv, nullptr);
+    EXPECT_EQ(kv->second, i);
+  }
+}
+
+TEST(ConcurrentHashMap, ConcurrentInsertFindWhileGrowing) {
+  dispenso::ThreadPool pool(4);
+  dispenso::ConcurrentHashMap<int, int> map(0, 4);
+  constexpr int kNum = 100000;
+  std::atomic<int> inserted(0);
+  std::atomic<int> failures(0);
+
+  dispenso::TaskSet tasks(pool);
+  tasks.schedule([&]() {
+    for (int i = 0; i < kNum; ++i) {
+      map.insert({i, i});
+      inserted.store(i + 1, std::memory_order_release);
+    }
+  });
+  for (int r = 0; r < 3; ++r) {
+    tasks.schedule([&]() {
+      while (inserted.load(std::memory_order_acquire) < kNum) {
+        int upTo = inserted.load(std::memory_order_acquire);
+        for (int i = std::max(0, upTo - 100); i < upTo; ++i) {
+          auto* kv = map.find(i);
+          if (!kv || kv->second != i) {
+            failures.fetch_add(1, std::memory_order_relaxed);
+          }
+        }
+      }
+    });
+  }
+  tasks.wait();
+  EXPECT_EQ(failures.load(), 0);
+  EXPECT_EQ(map.size(), static_cast<size_t>(kNum));
+}
+
+TEST(ConcurrentHashMap, ConcurrentCounting) {
+  dispenso::ConcurrentHashMap<int, std::atomic<int>> map;
+  dispenso::parallel_for(0, 100000, [&map](int i) {
+    map[i % 100].fetch_add(1, std::memory_order_relaxed);
+  });
+  EXPECT_EQ(map.size(), 100);
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(map.find(i)->second.load(), 1000);
+  }
+}
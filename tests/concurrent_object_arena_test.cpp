@@ -8,6 +8,10 @@
 #include <dispenso/concurrent_object_arena.h>
 #include <dispenso/task_set.h>
 
+#include <atomic>
+#include <thread>
+#include <vector>
+
 #include <gtest/gtest.h>
 
 TEST(ConcurrentObjectArena, ParallelGrowBy) {
@@ -102,3 +106,179 @@ TEST(ConcurrentObjectArena, ObjectsConstuction) {
     EXPECT_EQ(moveArena.getBuffer(i), bufferPtrs[i]);
   }
 }
+
+TEST(ConcurrentObjectArena, ReservationParallel) {
+  constexpr size_t numTasks = 16;
+  constexpr size_t numLoops = 500;
+  constexpr size_t delta = 3;
+
+  dispenso::ConcurrentObjectArena<size_t, uint32_t> arena(64);
+  std::vector<std::vector<uint32_t>> claimed(numTasks);
+
+  dispenso::TaskSet taskSet(dispenso::globalThreadPool());
+  for (size_t ti = 0; ti < numTasks; ++ti) {
+    taskSet.schedule([ti, &arena, &claimed]() {
+      dispenso::ConcurrentObjectArena<size_t, uint32_t>::Reservation reservation(arena, 40);
+      for (size_t i = 0; i < numLoops; ++i) {
+        const uint32_t p = reservation.grow_by(delta);
+        for (uint32_t j = 0; j < delta; ++j) {
+          arena[p + j] = ti + 1;
+        }
+        claimed[ti].push_back(p);
+      }
+      EXPECT_LT(reservation.remaining(), 40u);
+    });
+  }
+  taskSet.wait();
+
+  // Each task's indices hold only its own values, and no index was handed out twice.
+  std::vector<bool> seen(arena.size(), false);
+  for (size_t ti = 0; ti < numTasks; ++ti) {
+    for (uint32_t p : claimed[ti]) {
+      for (uint32_t j = 0; j < delta; ++j) {
+        EXPECT_FALSE(seen[p + j]);
+        seen[p + j] = true;
+        EXPECT_EQ(arena[p + j], ti + 1);
+      }
+    }
+  }
+  EXPECT_GE(arena.size(), numTasks * numLoops * delta);
+  // Each block loses at most delta - 1 elements at its end, plus the unused tail of the last.
+  constexpr size_t blocksPerTask = numLoops * delta / (40 - delta + 1) + 1;
+  EXPECT_LE(arena.size(), numTasks * (numLoops * delta + blocksPerTask * (delta - 1) + 40));
+}
+
+TEST(ConcurrentObjectArena, ReadWhileGrowing) {
+  constexpr size_t kWriters = 4;
+  constexpr size_t kPerWriter = 20000;
+  dispenso::ConcurrentObjectArena<std::atomic<size_t>> arena(8);
+
+  std::atomic<bool> done(false);
+  std::thread reader([&]() {
+    const std::atomic<size_t>* first = &arena[0];
+    while (!done.load(std::memory_order_acquire)) {
+      // Elements near the end may still be under construction, so only look them up.
+      size_t size = arena.size();
+      for (size_t i = size > 64 ? size - 64 : 0; i < size; ++i) {
+        const std::atomic<size_t>* element = &arena[i];
+        EXPECT_EQ(element - arena.getBuffer(i / 8), static_cast<ptrdiff_t>(i % 8));
+      }
+      EXPECT_EQ(&arena[0], first);
+    }
+  });
+
+  dispenso::ThreadPool pool(kWriters);
+  dispenso::TaskSet taskSet(pool);
+  for (size_t w = 0; w < kWriters; ++w) {
+    taskSet.schedule([&arena, w]() {
+      for (size_t i = 0; i < kPerWriter; ++i) {
+        arena[arena.grow_by(1)].store(w * kPerWriter + i + 1, std::memory_order_relaxed);
+      }
+    });
+  }
+  taskSet.wait();
+  done.store(true, std::memory_order_release);
+  reader.join();
+
+  EXPECT_EQ(arena.size(), kWriters * kPerWriter);
+  std::vector<bool> seen(kWriters * kPerWriter + 1, false);
+  for (size_t i = 0; i < arena.size(); ++i) {
+    size_t v = arena[i].load(std::memory_order_relaxed);
+    ASSERT_GT(v, 0u);
+    EXPECT_FALSE(seen[v]);
+    seen[v] = true;
+  }
+}
+
+namespace {
+struct Counted {
+  Counted() : value(7) {
+    live.fetch_add(1, std::memory_order_relaxed);
+  }
+  Counted(const Counted& other) : value(other.value) {
+    live.fetch_add(1, std::memory_order_relaxed);
+  }
+  ~Counted() {
+    live.fetch_sub(1, std::memory_order_relaxed);
+  }
+  size_t value;
+  static std::atomic<int> live;
+};
+std::atomic<int> Counted::live{0};
+} // namespace
+
+TEST(ConcurrentObjectArena, DestroysObjects) {
+  {
+    dispenso::ConcurrentObjectArena<Counted> arena(16);
+    arena.grow_by(5);
+    arena.grow_by(40);
+    EXPECT_EQ(Counted::live.load(), 45);
+
+    dispenso::ConcurrentObjectArena<Counted> copy(arena);
+    EXPECT_EQ(Counted::live.load(), 90);
+    for (size_t i = 0; i < copy.size(); ++i) {
+      EXPECT_EQ(copy[i].value, 7u);
+    }
+
+    arena.clear();
+    EXPECT_EQ(Counted::live.load(), 45);
+    EXPECT_EQ(arena.size(), 0u);
+    arena.grow_by(3);
+    EXPECT_EQ(Counted::live.load(), 48);
+  }
+  EXPECT_EQ(Counted::live.load(), 0);
+}
+
+TEST(ConcurrentObjectArena, ParallelConstructAndClear) {
+  constexpr size_t kNum = 100000;
+  dispenso::TaskSet taskSet(dispenso::globalThreadPool());
+  {
+    dispenso::ConcurrentObjectArena<Counted> arena(64);
+    arena.grow_by(3);
+    EXPECT_EQ(arena.grow_by(taskSet, kNum), 3u);
+    EXPECT_EQ(arena.size(), kNum + 3);
+    EXPECT_EQ(Counted::live.load(), static_cast<int>(kNum + 3));
+    for (size_t i = 0; i < arena.size(); ++i) {
+      ASSERT_EQ(arena[i].value, 7u);
+    }
+
+    arena.clear(taskSet);
+    EXPECT_EQ(Counted::live.load(), 0);
+    EXPECT_EQ(arena.size(), 0u);
+
+    arena.grow_by(taskSet, kNum);
+    EXPECT_EQ(Counted::live.load(), static_cast<int>(kNum));
+  }
+  EXPECT_EQ(Counted::live.load(), 0);
+}
+
+TEST(ConcurrentObjectArena, BufferSpansAndParallelForEach) {
+  constexpr size_t kNum = 50000;
+  dispenso::ConcurrentObjectArena<size_t> arena(128);
+  const size_t start = arena.grow_by(kNum);
+  for (size_t i = 0; i < kNum; ++i) {
+    arena[start + i] = i;
+  }
+
+  dispenso::TaskSet taskSet(dispenso::globalThreadPool());
+  arena.parallelForEach(taskSet, [](size_t& v) { v *= 2; });
+
+  std::atomic<size_t> sum(0);
+  std::atomic<size_t> count(0);
+  for (size_t b = 0; b < arena.numBuffers(); ++b) {
+    taskSet.schedule([&arena, &sum, &count, b]() {
+      size_t local = 0;
+      auto span = arena.bufferSpan(b);
+      EXPECT_EQ(span.size, arena.getBufferSize(b));
+      for (size_t v : span) {
+        local += v;
+      }
+      sum.fetch_add(local, std::memory_order_relaxed);
+      count.fetch_add(span.size, std::memory_order_relaxed);
+    });
+  }
+  taskSet.wait();
+
+  EXPECT_EQ(count.load(), kNum);
+  EXPECT_EQ(sum.load(), kNum * (kNum - 1));
+}
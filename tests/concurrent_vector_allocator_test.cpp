@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/concurrent_vector.h>
+
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+#include <dispenso/parallel_for.h>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+std::atomic<int64_t> g_allocs{0};
+std::atomic<int64_t> g_deallocs{0};
+std::atomic<int64_t> g_bytes{0};
+
+// Counts calls and bytes.  The size is kept in front of each allocation, since dealloc isn't given
+// it.
+struct CountingAllocator {
+  static constexpr size_t kHeader = 64;
+
+  static void* alloc(size_t bytes, size_t alignment) {
+    EXPECT_LE(alignment, kHeader);
+    g_allocs.fetch_add(1);
+    g_bytes.fetch_add(static_cast<int64_t>(bytes));
+    char* base = static_cast<char*>(dispenso::detail::alignedMalloc(bytes + kHeader, kHeader));
+    *reinterpret_cast<size_t*>(base) = bytes;
+    return base + kHeader;
+  }
+
+  static void dealloc(void* ptr) {
+    if (!ptr) {
+      return;
+    }
+    char* base = static_cast<char*>(ptr) - kHeader;
+    g_deallocs.fetch_add(1);
+    g_bytes.fetch_sub(static_cast<int64_t>(*reinterpret_cast<size_t*>(base)));
+    dispenso::detail::alignedFree(base);
+  }
+};
+
+struct CountingTraits : dispenso::DefaultConcurrentVectorTraits {
+  using Allocator = CountingAllocator;
+};
+
+struct CountingHugeTraits : dispenso::DefaultConcurrentVectorTraits {
+  static constexpr bool kUseHugePages = true;
+  using Allocator = CountingAllocator;
+};
+
+struct HugeTraits : dispenso::DefaultConcurrentVectorTraits {
+  static constexpr bool kUseHugePages = true;
+};
+
+} // namespace
+
+static_assert(
+    std::is_same<
+        dispenso::cv::BucketAllocatorFor<dispenso::DefaultConcurrentVectorTraits>::type,
+        dispenso::DefaultConcurrentVectorAllocator>::value,
+    "Default traits use the default allocator");
+static_assert(
+    std::is_same<
+        dispenso::cv::BucketAllocatorFor<HugeTraits>::type,
+        dispenso::HugePageConcurrentVectorAllocator>::value,
+    "kUseHugePages selects the huge page allocator");
+static_assert(
+    std::is_same<dispenso::cv::BucketAllocatorFor<CountingHugeTraits>::type, CountingAllocator>::
+        value,
+    "Allocator takes precedence over kUseHugePages");
+
+TEST(ConcurrentVectorAllocator, CountsBuckets) {
+  constexpr int kCount = 100000;
+  g_allocs.store(0);
+  g_deallocs.store(0);
+  {
+    dispenso::ConcurrentVector<int64_t, CountingTraits> vec;
+    EXPECT_EQ(g_allocs.load(), 1);
+    dispenso::parallel_for(0, kCount, [&vec](int i) { vec.push_back(i); });
+    EXPECT_GT(g_allocs.load(), 1);
+    EXPECT_GE(g_bytes.load(), static_cast<int64_t>(kCount * sizeof(int64_t)));
+    int64_t sum = 0;
+    for (int64_t v : vec) {
+      sum += v;
+    }
+    EXPECT_EQ(sum, int64_t{kCount} * (kCount - 1) / 2);
+
+    vec.clear();
+    vec.shrink_to_fit();
+    EXPECT_EQ(g_allocs.load() - g_deallocs.load(), 1);
+  }
+  EXPECT_EQ(g_allocs.load(), g_deallocs.load());
+  EXPECT_EQ(g_bytes.load(), 0);
+}
+
+TEST(ConcurrentVectorAllocator, MoveAndGrowBy) {
+  g_allocs.store(0);
+  g_deallocs.store(0);
+  {
+    dispenso::ConcurrentVector<int, CountingHugeTraits> vec;
+    vec.grow_by(5000, 7);
+    dispenso::ConcurrentVector<int, CountingHugeTraits> moved(std::move(vec));
+    EXPECT_EQ(moved.size(), 5000u);
+    EXPECT_EQ(moved[4999], 7);
+    vec.push_back(1);
+    EXPECT_EQ(vec[0], 1);
+  }
+  EXPECT_GT(g_allocs.load(), 2);
+  EXPECT_EQ(g_allocs.load(), g_deallocs.load());
+  EXPECT_EQ(g_bytes.load(), 0);
+}
@@ -1456,3 +1456,251 @@ TYPED_TEST(ConcurrentVectorTest, OtherConstructorsTest) {
     EXPECT_EQ(cv, v++);
   }
 }
+
+// Counts live instances, to check that parallel construction and destruction cover every element.
+struct LiveCounted {
+  static std::atomic<int64_t>& live() {
+    static std::atomic<int64_t> count(0);
+    return count;
+  }
+  LiveCounted() : value(-1) {
+    live().fetch_add(1, std::memory_order_relaxed);
+  }
+  explicit LiveCounted(int64_t v) : value(v) {
+    live().fetch_add(1, std::memory_order_relaxed);
+  }
+  LiveCounted(const LiveCounted& other) : value(other.value) {
+    live().fetch_add(1, std::memory_order_relaxed);
+  }
+  ~LiveCounted() {
+    live().fetch_sub(1, std::memory_order_relaxed);
+  }
+  int64_t value;
+};
+
+TYPED_TEST(ConcurrentVectorTest, ParallelConstructAndClear) {
+  dispenso::ThreadPool pool(4);
+  dispenso::TaskSet tasks(pool);
+  constexpr size_t kLen = (1 << 17) + 13;
+  {
+    dispenso::ConcurrentVector<LiveCounted, TypeParam> vec(kLen, tasks);
+    EXPECT_EQ(vec.size(), kLen);
+    EXPECT_EQ(LiveCounted::live().load(), static_cast<int64_t>(kLen));
+    for (auto& v : vec) {
+      EXPECT_EQ(v.value, -1);
+    }
+    vec.clear(tasks);
+    EXPECT_TRUE(vec.empty());
+    EXPECT_EQ(LiveCounted::live().load(), 0);
+  }
+  {
+    dispenso::ConcurrentVector<LiveCounted, TypeParam> vec(kLen, LiveCounted(5), tasks);
+    for (auto& v : vec) {
+      EXPECT_EQ(v.value, 5);
+    }
+  }
+  EXPECT_EQ(LiveCounted::live().load(), 0);
+}
+
+TYPED_TEST(ConcurrentVectorTest, ParallelGrowBy) {
+  dispenso::ThreadPool pool(4);
+  dispenso::TaskSet tasks(pool);
+  dispenso::ConcurrentVector<LiveCounted, TypeParam> vec;
+  vec.push_back(LiveCounted(100));
+
+  constexpr size_t kLen = 300000;
+  auto it = vec.grow_by_generator(
+      kLen, [](size_t i) { return LiveCounted(static_cast<int64_t>(i)); }, tasks);
+  EXPECT_EQ(it, vec.begin() + 1);
+  it = vec.grow_by(kLen, LiveCounted(7), tasks);
+  EXPECT_EQ(it, vec.begin() + 1 + kLen);
+  it = vec.grow_by(kLen, tasks);
+  EXPECT_EQ(it, vec.begin() + 1 + 2 * kLen);
+
+  ASSERT_EQ(vec.size(), 1 + 3 * kLen);
+  EXPECT_EQ(vec[0].value, 100);
+  for (size_t i = 0; i < kLen; ++i) {
+    ASSERT_EQ(vec[1 + i].value, static_cast<int64_t>(i));
+    ASSERT_EQ(vec[1 + kLen + i].value, 7);
+    ASSERT_EQ(vec[1 + 2 * kLen + i].value, -1);
+  }
+  EXPECT_EQ(LiveCounted::live().load(), static_cast<int64_t>(vec.size()));
+  vec.clear(tasks);
+  EXPECT_EQ(LiveCounted::live().load(), 0);
+}
+
+TYPED_TEST(ConcurrentVectorTest, ParallelResize) {
+  dispenso::ThreadPool pool(4);
+  dispenso::TaskSet tasks(pool);
+  {
+    dispenso::ConcurrentVector<LiveCounted, TypeParam> vec;
+    vec.resize(100000, LiveCounted(3), tasks);
+    EXPECT_EQ(vec.size(), 100000);
+    vec.resize(250000, tasks);
+    EXPECT_EQ(vec.size(), 250000);
+    EXPECT_EQ(vec[99999].value, 3);
+    EXPECT_EQ(vec[100000].value, -1);
+    EXPECT_EQ(LiveCounted::live().load(), 250000);
+    vec.resize(1000, tasks);
+    EXPECT_EQ(vec.size(), 1000);
+    EXPECT_EQ(LiveCounted::live().load(), 1000);
+    vec.resize(10, LiveCounted(0), tasks);
+    EXPECT_EQ(LiveCounted::live().load(), 10);
+    vec.push_back(LiveCounted(11));
+    EXPECT_EQ(vec.back().value, 11);
+  }
+  EXPECT_EQ(LiveCounted::live().load(), 0);
+}
+
+TYPED_TEST(ConcurrentVectorTest, ParallelGrowByConcurrent) {
+  // Several threads growing in parallel, each constructing its range with its own TaskSet.
+  dispenso::ThreadPool pool(4);
+  dispenso::ConcurrentVector<int64_t, TypeParam> vec;
+  constexpr int64_t kPerGrow = 5000;
+  dispenso::parallel_for(0, 40, [&pool, &vec](int g) {
+    dispenso::TaskSet tasks(pool);
+    vec.grow_by_generator(
+        kPerGrow, [g](size_t i) { return g * kPerGrow + static_cast<int64_t>(i); }, tasks);
+  });
+  ASSERT_EQ(vec.size(), static_cast<size_t>(40 * kPerGrow));
+  std::vector<int64_t> sorted(vec.begin(), vec.end());
+  std::sort(sorted.begin(), sorted.end());
+  for (size_t i = 0; i < sorted.size(); ++i) {
+    ASSERT_EQ(sorted[i], static_cast<int64_t>(i));
+  }
+}
+
+TYPED_TEST(ConcurrentVectorTest, SegmentsCoverElementsInOrder) {
+  dispenso::ConcurrentVector<int, TypeParam> vec;
+  EXPECT_TRUE(vec.segments().empty());
+  EXPECT_EQ(vec.segments().begin(), vec.segments().end());
+
+  for (int len : {1, 7, 8, 33, 1000, 100000}) {
+    while (vec.size() < static_cast<size_t>(len)) {
+      vec.push_back(static_cast<int>(vec.size()));
+    }
+    auto segments = vec.segments();
+    EXPECT_EQ(segments.numElements(), vec.size());
+    size_t index = 0;
+    size_t numSegments = 0;
+    for (auto seg : segments) {
+      EXPECT_FALSE(seg.empty());
+      EXPECT_EQ(seg.data(), &vec[index]);
+      for (int v : seg) {
+        ASSERT_EQ(v, static_cast<int>(index++));
+      }
+      EXPECT_EQ(segments[numSegments].data(), seg.data());
+      EXPECT_EQ(segments[numSegments].size(), seg.size());
+      ++numSegments;
+    }
+    EXPECT_EQ(index, vec.size());
+    EXPECT_EQ(numSegments, segments.size());
+  }
+
+  const auto& cvec = vec;
+  int64_t sum = 0;
+  for (auto seg : cvec.segments()) {
+    for (size_t i = 0; i < seg.size(); ++i) {
+      sum += seg[i];
+    }
+  }
+  EXPECT_EQ(sum, int64_t{99999} * 100000 / 2);
+}
+
+TYPED_TEST(ConcurrentVectorTest, SegmentsSnapshotSize) {
+  dispenso::ConcurrentVector<int, TypeParam> vec(size_t{100}, 1);
+  auto segments = vec.segments();
+  vec.grow_by(100000, 2);
+  size_t total = 0;
+  for (auto seg : segments) {
+    for (int v : seg) {
+      EXPECT_EQ(v, 1);
+    }
+    total += seg.size();
+  }
+  EXPECT_EQ(total, 100);
+}
+
+TYPED_TEST(ConcurrentVectorTest, ParallelForSegments) {
+  dispenso::ThreadPool pool(4);
+  dispenso::ConcurrentVector<int64_t, TypeParam> vec;
+  constexpr int64_t kLen = 250000;
+  for (int64_t i = 0; i < kLen; ++i) {
+    vec.push_back(i);
+  }
+
+  dispenso::TaskSet tasks(pool);
+  dispenso::parallel_for(tasks, vec.segments(), [](dispenso::cv::Segment<int64_t> seg) {
+    for (auto& v : seg) {
+      v *= 2;
+    }
+  });
+  for (int64_t i = 0; i < kLen; ++i) {
+    ASSERT_EQ(vec[static_cast<size_t>(i)], 2 * i);
+  }
+
+  std::atomic<int64_t> sum(0);
+  std::atomic<size_t> count(0);
+  const auto& cvec = vec;
+  dispenso::parallel_for(cvec.segments(), [&sum, &count](dispenso::cv::Segment<const int64_t> seg) {
+    int64_t local = 0;
+    for (int64_t v : seg) {
+      local += v;
+    }
+    sum.fetch_add(local, std::memory_order_relaxed);
+    count.fetch_add(seg.size(), std::memory_order_relaxed);
+  });
+  EXPECT_EQ(count.load(), static_cast<size_t>(kLen));
+  EXPECT_EQ(sum.load(), kLen * (kLen - 1));
+}
+
+TYPED_TEST(ConcurrentVectorTest, CopyToContiguous) {
+  dispenso::ThreadPool pool(4);
+  dispenso::TaskSet tasks(pool);
+  for (int64_t len : {0, 1, 100, 1000, 250000}) {
+    dispenso::ConcurrentVector<int64_t, TypeParam> vec;
+    for (int64_t i = 0; i < len; ++i) {
+      vec.push_back(i);
+    }
+    std::vector<int64_t> out(static_cast<size_t>(len) + 1, -1);
+    vec.copyToContiguous(out.data(), tasks);
+    for (int64_t i = 0; i < len; ++i) {
+      ASSERT_EQ(out[static_cast<size_t>(i)], i);
+    }
+    EXPECT_EQ(out.back(), -1);
+
+    std::vector<int64_t> copy = vec.toVector(tasks);
+    ASSERT_EQ(copy.size(), static_cast<size_t>(len));
+    EXPECT_TRUE(std::equal(copy.begin(), copy.end(), out.begin()));
+    EXPECT_EQ(vec.toVector(), copy);
+  }
+}
+
+TYPED_TEST(ConcurrentVectorTest, MoveToContiguous) {
+  constexpr int kLen = 50000;
+  dispenso::ThreadPool pool(4);
+  dispenso::TaskSet tasks(pool);
+  dispenso::ConcurrentVector<std::unique_ptr<int>, TypeParam> vec;
+  for (int i = 0; i < kLen; ++i) {
+    vec.push_back(std::make_unique<int>(i));
+  }
+  std::vector<std::unique_ptr<int>> out(kLen);
+  vec.moveToContiguous(out.data(), tasks);
+  EXPECT_EQ(vec.size(), static_cast<size_t>(kLen));
+  for (int i = 0; i < kLen; ++i) {
+    ASSERT_TRUE(out[i]);
+    ASSERT_EQ(*out[i], i);
+    ASSERT_FALSE(vec[i]);
+  }
+
+  dispenso::ConcurrentVector<std::string, TypeParam> strings;
+  for (int i = 0; i < 1000; ++i) {
+    strings.push_back(std::to_string(i));
+  }
+  std::vector<std::string> copied = strings.toVector();
+  ASSERT_EQ(copied.size(), strings.size());
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_EQ(copied[i], std::to_string(i));
+    EXPECT_EQ(strings[i], copied[i]);
+  }
+}
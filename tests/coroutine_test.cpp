@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/coroutine.h>
+
+#include <gtest/gtest.h>
+
+#if defined(DISPENSO_HAS_COROUTINES)
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <dispenso/completion_event.h>
+#include <dispenso/task_set.h>
+
+namespace {
+
+dispenso::Task<int> answer() {
+  co_return 42;
+}
+
+dispenso::Task<int> addAnswers() {
+  int a = co_await answer();
+  int b = co_await answer();
+  co_return a + b;
+}
+
+dispenso::Task<std::thread::id> threadOf(dispenso::ThreadPool& pool) {
+  co_await dispenso::scheduleOn(pool);
+  co_return std::this_thread::get_id();
+}
+
+} // namespace
+
+TEST(Coroutine, SyncWait) {
+  EXPECT_EQ(dispenso::syncWait(answer()), 42);
+  EXPECT_EQ(dispenso::syncWait(addAnswers()), 84);
+}
+
+TEST(Coroutine, MoveOnlyResult) {
+  auto makePtr = []() -> dispenso::Task<std::unique_ptr<std::string>> {
+    co_return std::make_unique<std::string>("dispenso");
+  };
+  auto ptr = dispenso::syncWait(makePtr());
+  ASSERT_TRUE(ptr);
+  EXPECT_EQ(*ptr, "dispenso");
+}
+
+TEST(Coroutine, ScheduleOnPool) {
+  dispenso::ThreadPool pool(2);
+  EXPECT_NE(dispenso::syncWait(threadOf(pool)), std::this_thread::get_id());
+}
+
+TEST(Coroutine, AwaitFuture) {
+  dispenso::ThreadPool pool(2);
+  auto waitForValue = [&pool]() -> dispenso::Task<int> {
+    dispenso::Future<int> slow = dispenso::async(pool, []() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      return 7;
+    });
+    int fromGlobal = co_await slow;
+    int fromPool = co_await dispenso::resumeOn(dispenso::async(pool, []() { return 5; }), pool);
+    co_return fromGlobal * fromPool;
+  };
+  EXPECT_EQ(dispenso::syncWait(waitForValue()), 35);
+}
+
+TEST(Coroutine, AwaitReadyVoidFuture) {
+  auto task = []() -> dispenso::Task<> {
+    co_await dispenso::make_ready_future();
+  };
+  dispenso::syncWait(task());
+}
+
+TEST(Coroutine, ManyDetached) {
+  constexpr int kNumHandlers = 5000;
+  dispenso::ThreadPool pool(4);
+  std::atomic<int> remaining(kNumHandlers);
+  std::atomic<int> sum(0);
+  dispenso::CompletionEvent allDone;
+
+  auto handler = [&](int i) -> dispenso::Task<> {
+    co_await dispenso::scheduleOn(pool);
+    int doubled = co_await dispenso::resumeOn(dispenso::async(pool, [i]() { return 2 * i; }), pool);
+    sum.fetch_add(doubled, std::memory_order_relaxed);
+    if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      allDone.notify();
+    }
+  };
+  for (int i = 0; i < kNumHandlers; ++i) {
+    dispenso::startDetached(handler(i));
+  }
+  allDone.wait();
+  EXPECT_EQ(sum.load(), kNumHandlers * (kNumHandlers - 1));
+}
+
+TEST(Coroutine, ScheduleOnTaskSet) {
+  dispenso::ThreadPool pool(3);
+  dispenso::TaskSet tasks(pool);
+  std::atomic<int> count(0);
+  auto work = [&]() -> dispenso::Task<> {
+    co_await dispenso::scheduleOn(tasks);
+    count.fetch_add(1, std::memory_order_relaxed);
+  };
+  for (int i = 0; i < 100; ++i) {
+    dispenso::startDetached(work());
+  }
+  tasks.wait();
+  EXPECT_EQ(count.load(), 100);
+}
+
+#if defined(__cpp_exceptions)
+TEST(Coroutine, Exception) {
+  auto thrower = []() -> dispenso::Task<int> {
+    throw std::runtime_error("oops");
+    co_return 1;
+  };
+  auto outer = [&thrower]() -> dispenso::Task<int> { co_return co_await thrower() + 1; };
+  EXPECT_THROW(dispenso::syncWait(outer()), std::runtime_error);
+}
+#endif // __cpp_exceptions
+
+#endif // DISPENSO_HAS_COROUTINES
@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/epoch_domain.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+struct Node {
+  Node(int v, std::atomic<int>& live) : value(v), live(live) {
+    live.fetch_add(1);
+  }
+  ~Node() {
+    // Poison the value so that use after destruction is likely to be noticed.
+    value = -1;
+    live.fetch_sub(1);
+  }
+  int value;
+  std::atomic<int>& live;
+};
+} // namespace
+
+TEST(EpochDomain, RetireAndSynchronize) {
+  std::atomic<int> live(0);
+  dispenso::EpochDomain domain;
+  for (int i = 0; i < 10; ++i) {
+    domain.retire(new Node(i, live));
+  }
+  EXPECT_EQ(domain.retiredCount(), 10u);
+  domain.synchronize();
+  EXPECT_EQ(domain.retiredCount(), 0u);
+  EXPECT_EQ(live.load(), 0);
+}
+
+TEST(EpochDomain, GuardDelaysReclamation) {
+  std::atomic<int> live(0);
+  dispenso::ThreadPool pool(2);
+  dispenso::EpochDomain domain(pool, 1);
+  std::atomic<Node*> shared(new Node(1, live));
+
+  {
+    auto guard = domain.enter();
+    Node* seen = shared.load();
+
+    std::thread writer([&]() {
+      Node* old = shared.exchange(new Node(2, live));
+      domain.retire(old);
+      // Batches of one hand each object straight to a reclamation task.
+      for (int i = 0; i < 10; ++i) {
+        domain.retire(new Node(3, live));
+      }
+    });
+    writer.join();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    // Objects retired while this guard is held, including the one it can see, survive.
+    EXPECT_EQ(seen->value, 1);
+    EXPECT_EQ(domain.retiredCount(), 11u);
+  }
+  domain.synchronize();
+  EXPECT_EQ(domain.retiredCount(), 0u);
+  EXPECT_EQ(live.load(), 1);
+  delete shared.load();
+}
+
+TEST(EpochDomain, NestedGuards) {
+  std::atomic<int> live(0);
+  dispenso::EpochDomain domain;
+  std::atomic<bool> synchronized(false);
+  std::thread syncer;
+  {
+    auto outer = domain.enter();
+    {
+      auto inner = domain.enter();
+    }
+    domain.retire(new Node(1, live));
+    syncer = std::thread([&]() {
+      domain.synchronize();
+      synchronized.store(true);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    // The outer guard still holds the thread in the domain.
+    EXPECT_FALSE(synchronized.load());
+    EXPECT_EQ(live.load(), 1);
+  }
+  syncer.join();
+  EXPECT_TRUE(synchronized.load());
+  EXPECT_EQ(live.load(), 0);
+}
+
+TEST(EpochDomain, ExitedThreadBatchesAreReclaimed) {
+  std::atomic<int> live(0);
+  dispenso::EpochDomain domain;
+  std::thread t([&]() {
+    for (int i = 0; i < 3; ++i) {
+      domain.retire(new Node(i, live));
+    }
+  });
+  t.join();
+  EXPECT_EQ(live.load(), 3);
+  domain.synchronize();
+  EXPECT_EQ(live.load(), 0);
+}
+
+TEST(EpochDomain, DestructionFreesRetired) {
+  std::atomic<int> live(0);
+  {
+    dispenso::EpochDomain domain;
+    for (int i = 0; i < 100; ++i) {
+      domain.retire(new Node(i, live));
+    }
+  }
+  EXPECT_EQ(live.load(), 0);
+}
+
+TEST(EpochDomain, ManyDomainsPerThread) {
+  std::atomic<int> live(0);
+  std::vector<std::unique_ptr<dispenso::EpochDomain>> domains;
+  for (int i = 0; i < 4; ++i) {
+    domains.emplace_back(std::make_unique<dispenso::EpochDomain>());
+  }
+  {
+    auto a = domains[0]->enter();
+    auto b = domains[1]->enter();
+    domains[2]->retire(new Node(1, live));
+    // Guards on other domains do not hold back reclamation.
+    domains[2]->synchronize();
+    EXPECT_EQ(live.load(), 0);
+  }
+  domains.clear();
+  // Records for destroyed domains are dropped, and new domains work as before.
+  dispenso::EpochDomain domain;
+  auto guard = domain.enter();
+  domain.retire(new Node(2, live));
+  EXPECT_EQ(domain.retiredCount(), 1u);
+}
+
+TEST(EpochDomain, ConcurrentReadersAndWriters) {
+  constexpr int kReaders = 4;
+  constexpr int kWriters = 2;
+  constexpr int kUpdates = 2000;
+  std::atomic<int> live(0);
+  {
+    dispenso::ThreadPool pool(2);
+    dispenso::EpochDomain domain(pool, 16);
+    std::atomic<Node*> shared(new Node(1, live));
+    std::atomic<int> writersDone(0);
+
+    std::vector<std::thread> threads;
+    for (int r = 0; r < kReaders; ++r) {
+      threads.emplace_back([&]() {
+        while (writersDone.load(std::memory_order_acquire) < kWriters) {
+          auto guard = domain.enter();
+          EXPECT_GT(shared.load(std::memory_order_acquire)->value, 0);
+        }
+      });
+    }
+    for (int w = 0; w < kWriters; ++w) {
+      threads.emplace_back([&]() {
+        for (int i = 0; i < kUpdates; ++i) {
+          Node* old = shared.exchange(new Node(i + 1, live), std::memory_order_acq_rel);
+          domain.retire(old);
+        }
+        writersDone.fetch_add(1, std::memory_order_release);
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    // Garbage stays bounded by the batches still held by threads and awaiting a pass.
+    domain.synchronize();
+    EXPECT_EQ(domain.retiredCount(), 0u);
+    EXPECT_EQ(live.load(), 1);
+    delete shared.load();
+  }
+  EXPECT_EQ(live.load(), 0);
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/fiber.h>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <dispenso/future.h>
+#include <dispenso/task_set.h>
+#include <gtest/gtest.h>
+
+TEST(FiberTaskSet, RunsAll) {
+  dispenso::ThreadPool pool(4);
+  std::atomic<int> count(0);
+  dispenso::FiberTaskSet fibers(pool);
+  for (int i = 0; i < 1000; ++i) {
+    fibers.schedule([&count]() { count.fetch_add(1, std::memory_order_relaxed); });
+  }
+  fibers.wait();
+  EXPECT_EQ(count.load(), 1000);
+  EXPECT_EQ(fibers.numPending(), 0u);
+}
+
+TEST(FiberTaskSet, BlockedWaitFreesThread) {
+  // The only pool thread runs the first fiber, which waits on a Future that the second fiber
+  // unblocks.  Without suspension, the second fiber could never start.
+  dispenso::ThreadPool pool(1);
+  dispenso::ThreadPool other(1);
+  std::atomic<bool> started(false);
+  std::atomic<bool> release(false);
+  dispenso::Future<int> value(
+      [&started, &release]() {
+        started.store(true, std::memory_order_release);
+        while (!release.load(std::memory_order_acquire)) {
+          std::this_thread::yield();
+        }
+        return 7;
+      },
+      other,
+      std::launch::async);
+  while (!started.load(std::memory_order_acquire)) {
+    std::this_thread::yield();
+  }
+
+  int got = 0;
+  dispenso::FiberTaskSet fibers(pool);
+  fibers.schedule([&value, &got]() { got = value.get(); });
+  fibers.schedule([&release]() { release.store(true, std::memory_order_release); });
+  fibers.wait();
+  EXPECT_EQ(got, 7);
+}
+
+TEST(FiberTaskSet, SuspendedFiberIsNotPolled) {
+  // The waiting fiber is resumed by the Future's completion, rather than by tasks that keep
+  // checking on it in the meantime.
+  dispenso::ThreadPool pool(1);
+  dispenso::ThreadPool other(1);
+  pool.setStatsEnabled(true);
+  dispenso::Future<int> value(
+      []() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        return 7;
+      },
+      other,
+      std::launch::async);
+
+  int got = 0;
+  dispenso::FiberTaskSet fibers(pool);
+  fibers.schedule([&value, &got]() { got = value.get(); });
+  fibers.wait();
+  EXPECT_EQ(got, 7);
+
+  dispenso::ThreadPoolStats stats = pool.stats();
+  uint64_t executed = stats.retired.tasksExecuted + stats.externalTasksExecuted + stats.inlineTasks;
+  for (auto& t : stats.threads) {
+    executed += t.tasksExecuted;
+  }
+  // Starting the fiber, and resuming it once.
+  EXPECT_LE(executed, 2u);
+}
+
+TEST(FiberTaskSet, TaskSetWaitInFibers) {
+  dispenso::ThreadPool pool(2);
+  constexpr int kFibers = 64;
+  constexpr int kTasks = 32;
+  std::vector<int> sums(kFibers, 0);
+  dispenso::FiberTaskSet fibers(pool);
+  for (int i = 0; i < kFibers; ++i) {
+    fibers.schedule([&pool, &sums, i]() {
+      std::atomic<int> sum(0);
+      dispenso::TaskSet tasks(pool);
+      for (int j = 0; j < kTasks; ++j) {
+        tasks.schedule([&sum, j]() { sum.fetch_add(j, std::memory_order_relaxed); });
+      }
+      tasks.wait();
+      sums[static_cast<size_t>(i)] = sum.load(std::memory_order_relaxed);
+    });
+  }
+  fibers.wait();
+  for (int sum : sums) {
+    EXPECT_EQ(sum, kTasks * (kTasks - 1) / 2);
+  }
+}
+
+namespace {
+void nest(dispenso::ThreadPool& pool, int depth, std::atomic<int>& reached) {
+  reached.fetch_add(1, std::memory_order_relaxed);
+  if (depth == 0) {
+    return;
+  }
+  dispenso::FiberTaskSet inner(pool, 32 * 1024);
+  inner.schedule([&pool, depth, &reached]() { nest(pool, depth - 1, reached); });
+  inner.wait();
+}
+} // namespace
+
+TEST(FiberTaskSet, DeepDependencyChain) {
+  // Every level waits on the next, so a thousand fibers are suspended at once on two threads.
+  dispenso::ThreadPool pool(2);
+  std::atomic<int> reached(0);
+  dispenso::FiberTaskSet fibers(pool);
+  fibers.schedule([&pool, &reached]() { nest(pool, 1000, reached); });
+  fibers.wait();
+  EXPECT_EQ(reached.load(), 1001);
+}
+
+TEST(FiberTaskSet, ZeroThreadPool) {
+  dispenso::ThreadPool pool(0);
+  std::atomic<int> reached(0);
+  dispenso::FiberTaskSet fibers(pool);
+  fibers.schedule([&pool, &reached]() { nest(pool, 10, reached); });
+  fibers.wait();
+  EXPECT_EQ(reached.load(), 11);
+}
+
+#if defined(__cpp_exceptions)
+TEST(FiberTaskSet, Exception) {
+  dispenso::ThreadPool pool(2);
+  std::atomic<int> count(0);
+  dispenso::FiberTaskSet fibers(pool);
+  for (int i = 0; i < 100; ++i) {
+    fibers.schedule([&count, i]() {
+      if (i == 50) {
+        throw std::runtime_error("fiber");
+      }
+      count.fetch_add(1, std::memory_order_relaxed);
+    });
+  }
+  EXPECT_THROW(fibers.wait(), std::runtime_error);
+  EXPECT_EQ(count.load(), 99);
+  EXPECT_NO_THROW(fibers.wait());
+}
+#endif // __cpp_exceptions
@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/file_chunks.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+// A file in the test temp directory, removed on destruction.
+struct TempFile {
+  TempFile(const std::string& name, const std::string& contents)
+      : path(::testing::TempDir() + name) {
+    std::ofstream out(path, std::ios::binary);
+    out << contents;
+  }
+  ~TempFile() {
+    std::remove(path.c_str());
+  }
+  std::string path;
+};
+
+// Lines of varying length, some longer than the chunks used below.
+std::string makeLines(size_t count, bool trailingNewline = true) {
+  std::string s;
+  for (size_t i = 0; i < count; ++i) {
+    s.append(i % 37 == 0 ? 300 : (i * 13) % 50, static_cast<char>('a' + i % 26));
+    if (i + 1 < count || trailingNewline) {
+      s.push_back('\n');
+    }
+  }
+  return s;
+}
+
+// Checks that the chunks tile the file exactly and break only on record boundaries.
+void checkChunks(std::vector<std::pair<size_t, std::string>> chunks, const std::string& contents) {
+  std::sort(chunks.begin(), chunks.end());
+  std::string joined;
+  for (auto& c : chunks) {
+    EXPECT_EQ(c.first, joined.size());
+    EXPECT_FALSE(c.second.empty());
+    EXPECT_TRUE(c.first == 0 || contents[c.first - 1] == '\n');
+    joined += c.second;
+  }
+  EXPECT_EQ(joined, contents);
+}
+} // namespace
+
+TEST(FileChunks, ChunksTileFile) {
+  std::string contents = makeLines(1000);
+  TempFile file("file_chunks_tile.txt", contents);
+
+  dispenso::ThreadPool pool(4);
+  dispenso::TaskSet tasks(pool);
+  dispenso::MappedFile mapped(file.path);
+  ASSERT_TRUE(mapped.valid());
+  EXPECT_EQ(mapped.size(), contents.size());
+
+  std::mutex mtx;
+  std::vector<std::pair<size_t, std::string>> chunks;
+  dispenso::FileChunkOptions options;
+  options.chunkBytes = 128;
+  dispenso::parallel_for_file_chunks(
+      tasks,
+      mapped,
+      '\n',
+      [&](const dispenso::FileChunk& chunk) {
+        EXPECT_EQ(chunk.data[chunk.size - 1], '\n');
+        std::lock_guard<std::mutex> lk(mtx);
+        chunks.emplace_back(chunk.offset, std::string(chunk.data, chunk.size));
+      },
+      options);
+  checkChunks(chunks, contents);
+}
+
+TEST(FileChunks, NoTrailingDelimiter) {
+  std::string contents = makeLines(200, false);
+  TempFile file("file_chunks_no_trailing.txt", contents);
+
+  std::mutex mtx;
+  std::vector<std::pair<size_t, std::string>> chunks;
+  dispenso::FileChunkOptions options;
+  options.chunkBytes = 100;
+  EXPECT_TRUE(dispenso::parallel_for_file_chunks(
+      file.path,
+      '\n',
+      [&](const dispenso::FileChunk& chunk) {
+        std::lock_guard<std::mutex> lk(mtx);
+        chunks.emplace_back(chunk.offset, std::string(chunk.data, chunk.size));
+      },
+      options));
+  checkChunks(chunks, contents);
+}
+
+TEST(FileChunks, CountRecords) {
+  std::string contents = makeLines(5000);
+  TempFile file("file_chunks_count.txt", contents);
+  std::atomic<size_t> lines(0);
+  dispenso::FileChunkOptions options;
+  options.chunkBytes = 1000;
+  options.prefetchChunks = 3;
+  EXPECT_TRUE(dispenso::parallel_for_file_chunks(
+      file.path,
+      '\n',
+      [&lines](const dispenso::FileChunk& chunk) {
+        lines.fetch_add(
+            static_cast<size_t>(std::count(chunk.data, chunk.data + chunk.size, '\n')),
+            std::memory_order_relaxed);
+      },
+      options));
+  EXPECT_EQ(lines.load(), 5000u);
+}
+
+TEST(FileChunks, SingleChunk) {
+  std::string contents = makeLines(10);
+  TempFile file("file_chunks_single.txt", contents);
+  int calls = 0;
+  EXPECT_TRUE(dispenso::parallel_for_file_chunks(
+      file.path, '\n', [&](const dispenso::FileChunk& chunk) {
+        ++calls;
+        EXPECT_EQ(chunk.offset, 0u);
+        EXPECT_EQ(std::string(chunk.data, chunk.size), contents);
+      }));
+  EXPECT_EQ(calls, 1);
+}
+
+TEST(FileChunks, EmptyFile) {
+  TempFile file("file_chunks_empty.txt", "");
+  bool called = false;
+  EXPECT_TRUE(dispenso::parallel_for_file_chunks(
+      file.path, '\n', [&called](const dispenso::FileChunk&) { called = true; }));
+  EXPECT_FALSE(called);
+}
+
+TEST(FileChunks, MissingFile) {
+  dispenso::MappedFile mapped(::testing::TempDir() + "file_chunks_does_not_exist.txt");
+  EXPECT_FALSE(mapped.valid());
+  EXPECT_FALSE(dispenso::parallel_for_file_chunks(
+      ::testing::TempDir() + "file_chunks_does_not_exist.txt",
+      '\n',
+      [](const dispenso::FileChunk&) {}));
+}
+
+#if __cplusplus >= 201703L
+TEST(FileChunks, StringView) {
+  std::string contents = "alpha\nbeta\ngamma\n";
+  TempFile file("file_chunks_view.txt", contents);
+  EXPECT_TRUE(dispenso::parallel_for_file_chunks(
+      file.path, '\n', [&](const dispenso::FileChunk& chunk) {
+        EXPECT_EQ(chunk.view(), std::string_view(contents));
+      }));
+}
+#endif // C++17
@@ -5,9 +5,12 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <algorithm>
+#include <atomic>
 #include <deque>
 #include <list>
 #include <set>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -290,3 +293,84 @@ TEST(ForEach, Cascade) {
     EXPECT_EQ(values[i], -i);
   }
 }
+
+TEST(ForEach, DynamicChunking) {
+  dispenso::ThreadPool pool(4);
+  dispenso::TaskSet taskSet(pool);
+  for (auto chunking :
+       {dispenso::ParForChunking::kAuto,
+        dispenso::ParForChunking::kGuided,
+        dispenso::ParForChunking::kAdaptive}) {
+    std::vector<int> values(10000, 1);
+    dispenso::ForEachOptions options;
+    options.chunking = chunking;
+    dispenso::for_each(
+        taskSet, std::begin(values), std::end(values), [](int& v) { v += 1; }, options);
+    EXPECT_EQ(std::count(values.begin(), values.end(), 2), 10000);
+
+    // Non-random-access iterators fall back to static blocks.
+    std::list<int> list(1000, 1);
+    dispenso::for_each(taskSet, std::begin(list), std::end(list), [](int& v) { v = 3; }, options);
+    EXPECT_EQ(std::count(list.begin(), list.end(), 3), 1000);
+  }
+}
+
+TEST(ForEach, MinItemsPerChunk) {
+  dispenso::ThreadPool pool(4);
+  dispenso::TaskSet taskSet(pool);
+  const std::thread::id caller = std::this_thread::get_id();
+  for (auto chunking : {dispenso::ParForChunking::kStatic, dispenso::ParForChunking::kAuto}) {
+    dispenso::ForEachOptions options;
+    options.chunking = chunking;
+    options.minItemsPerChunk = 1000;
+    std::atomic<int> offCaller(0);
+    std::vector<int> values(1500, 1);
+    std::list<int> list(1500, 1);
+    auto body = [&offCaller, caller](int& v) {
+      offCaller.fetch_add(std::this_thread::get_id() != caller, std::memory_order_relaxed);
+      v = 2;
+    };
+    dispenso::for_each(taskSet, std::begin(values), std::end(values), body, options);
+    dispenso::for_each(taskSet, std::begin(list), std::end(list), body, options);
+    EXPECT_EQ(offCaller.load(), 0);
+    EXPECT_EQ(std::count(values.begin(), values.end(), 2), 1500);
+    EXPECT_EQ(std::count(list.begin(), list.end(), 2), 1500);
+  }
+}
+
+TEST(ForEach, Chunked) {
+  dispenso::ThreadPool pool(3);
+  dispenso::TaskSet taskSet(pool);
+  for (auto chunking : {dispenso::ParForChunking::kStatic, dispenso::ParForChunking::kAuto}) {
+    std::vector<int> values(100000);
+    std::atomic<size_t> total(0);
+    dispenso::ForEachOptions options;
+    options.chunking = chunking;
+    dispenso::for_each_chunked(
+        taskSet,
+        values.begin(),
+        values.end(),
+        [&values, &total](std::vector<int>::iterator b, std::vector<int>::iterator e) {
+          EXPECT_LT(b, e);
+          for (auto it = b; it != e; ++it) {
+            *it = static_cast<int>(it - values.begin());
+          }
+          total.fetch_add(static_cast<size_t>(e - b));
+        },
+        options);
+    EXPECT_EQ(total.load(), values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+      EXPECT_EQ(values[i], static_cast<int>(i));
+    }
+  }
+}
+
+TEST(ForEach, ChunkedPointers) {
+  std::vector<double> values(5000, 1.0);
+  dispenso::for_each_n_chunked(values.data(), values.size(), [](double* b, double* e) {
+    for (; b != e; ++b) {
+      *b *= 2.0;
+    }
+  });
+  EXPECT_EQ(std::count(values.begin(), values.end(), 2.0), 5000);
+}
@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/fork_join.h>
+
+#include <atomic>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+int serialFib(int n) {
+  return n < 2 ? n : serialFib(n - 1) + serialFib(n - 2);
+}
+
+int fib(dispenso::ThreadPool& pool, int n) {
+  if (n < 2) {
+    return n;
+  }
+  int a;
+  int b;
+  dispenso::forkJoin(pool, [&]() { a = fib(pool, n - 1); }, [&]() { b = fib(pool, n - 2); });
+  return a + b;
+}
+} // namespace
+
+TEST(ForkJoin, Fib) {
+  dispenso::ThreadPool pool(8);
+  EXPECT_EQ(fib(pool, 22), serialFib(22));
+}
+
+TEST(ForkJoin, FibZeroThreads) {
+  dispenso::ThreadPool pool(0);
+  EXPECT_EQ(fib(pool, 18), serialFib(18));
+}
+
+TEST(ForkJoin, GlobalPool) {
+  int a = 0;
+  int b = 0;
+  dispenso::forkJoin([&a]() { a = 1; }, [&b]() { b = 2; });
+  EXPECT_EQ(a + b, 3);
+}
+
+TEST(ForkJoin, Variadic) {
+  dispenso::ThreadPool pool(4);
+  std::vector<int> values(5, 0);
+  dispenso::forkJoin(
+      pool,
+      [&values]() { values[0] = 1; },
+      [&values]() { values[1] = 2; },
+      [&values]() { values[2] = 3; },
+      [&values]() { values[3] = 4; },
+      [&values]() { values[4] = 5; });
+  EXPECT_EQ(values, std::vector<int>({1, 2, 3, 4, 5}));
+}
+
+TEST(ForkJoin, Recursive) {
+  // Sum a range by recursive halving, checking the forks from an external thread and pool threads.
+  dispenso::ThreadPool pool(4);
+  std::vector<int> values(1 << 16);
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = static_cast<int>(i % 7);
+  }
+  std::function<int64_t(size_t, size_t)> sum = [&](size_t b, size_t e) -> int64_t {
+    if (e - b <= 64) {
+      int64_t s = 0;
+      for (size_t i = b; i < e; ++i) {
+        s += values[i];
+      }
+      return s;
+    }
+    size_t mid = b + (e - b) / 2;
+    int64_t left;
+    int64_t right;
+    dispenso::forkJoin(pool, [&]() { left = sum(b, mid); }, [&]() { right = sum(mid, e); });
+    return left + right;
+  };
+  int64_t expected = 0;
+  for (int v : values) {
+    expected += v;
+  }
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(sum(0, values.size()), expected);
+  }
+}
+
+TEST(ParallelInvoke, Variadic) {
+  dispenso::ThreadPool pool(4);
+  std::vector<int> values(5, 0);
+  dispenso::parallel_invoke(
+      pool,
+      [&values]() { values[0] = 1; },
+      [&values]() { values[1] = 2; },
+      [&values]() { values[2] = 3; },
+      [&values]() { values[3] = 4; },
+      [&values]() { values[4] = 5; });
+  EXPECT_EQ(values, std::vector<int>({1, 2, 3, 4, 5}));
+}
+
+TEST(ParallelInvoke, LastRunsOnCaller) {
+  dispenso::ThreadPool pool(2);
+  std::thread::id lastThread;
+  int first = 0;
+  dispenso::parallel_invoke(
+      pool,
+      [&first]() { first = 1; },
+      [&lastThread]() { lastThread = std::this_thread::get_id(); });
+  EXPECT_EQ(first, 1);
+  EXPECT_EQ(lastThread, std::this_thread::get_id());
+}
+
+TEST(ParallelInvoke, GlobalPool) {
+  int a = 0;
+  int b = 0;
+  int c = 0;
+  dispenso::parallel_invoke([&a]() { a = 1; }, [&b]() { b = 2; }, [&c]() { c = 3; });
+  EXPECT_EQ(a + b + c, 6);
+}
+
+TEST(ParallelInvoke, Recursive) {
+  // Sum a range by recursive three-way splits, with a pool that has no threads as well.
+  std::vector<int> values(1 << 15);
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = static_cast<int>(i % 11);
+  }
+  int64_t expected = 0;
+  for (int v : values) {
+    expected += v;
+  }
+  for (int numThreads : {0, 4}) {
+    dispenso::ThreadPool pool(numThreads);
+    std::function<int64_t(size_t, size_t)> sum = [&](size_t b, size_t e) -> int64_t {
+      if (e - b <= 64) {
+        int64_t s = 0;
+        for (size_t i = b; i < e; ++i) {
+          s += values[i];
+        }
+        return s;
+      }
+      size_t third = (e - b) / 3;
+      int64_t parts[3];
+      dispenso::parallel_invoke(
+          pool,
+          [&]() { parts[0] = sum(b, b + third); },
+          [&]() { parts[1] = sum(b + third, b + 2 * third); },
+          [&]() { parts[2] = sum(b + 2 * third, e); });
+      return parts[0] + parts[1] + parts[2];
+    };
+    EXPECT_EQ(sum(0, values.size()), expected);
+  }
+}
+
+#if defined(__cpp_exceptions)
+TEST(ForkJoin, ExceptionInForked) {
+  dispenso::ThreadPool pool(2);
+  bool ranFirst = false;
+  EXPECT_THROW(
+      dispenso::forkJoin(
+          pool, [&ranFirst]() { ranFirst = true; }, []() { throw std::runtime_error("f2"); }),
+      std::runtime_error);
+  EXPECT_TRUE(ranFirst);
+}
+
+TEST(ForkJoin, ExceptionInBoth) {
+  dispenso::ThreadPool pool(2);
+  try {
+    dispenso::forkJoin(
+        pool, []() { throw std::logic_error("f1"); }, []() { throw std::runtime_error("f2"); });
+    FAIL() << "Expected an exception";
+  } catch (const std::logic_error&) {
+  }
+}
+
+TEST(ParallelInvoke, ExceptionInScheduled) {
+  dispenso::ThreadPool pool(2);
+  std::atomic<int> ran(0);
+  EXPECT_THROW(
+      dispenso::parallel_invoke(
+          pool,
+          []() { throw std::runtime_error("f1"); },
+          [&ran]() { ++ran; },
+          [&ran]() { ++ran; }),
+      std::runtime_error);
+  EXPECT_EQ(ran.load(), 2);
+}
+
+TEST(ParallelInvoke, ExceptionInLast) {
+  dispenso::ThreadPool pool(2);
+  try {
+    dispenso::parallel_invoke(
+        pool, []() { throw std::runtime_error("f1"); }, []() { throw std::logic_error("f2"); });
+    FAIL() << "Expected an exception";
+  } catch (const std::logic_error&) {
+  }
+}
+#endif // __cpp_exceptions
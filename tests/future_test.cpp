@@ -7,6 +7,9 @@
 
 #include <dispenso/future.h>
 
+#include <memory>
+#include <string>
+
 #include <gtest/gtest.h>
 
 TEST(Future, Invalid) {
@@ -35,6 +38,68 @@ TEST(Future, MakeReady) {
   EXPECT_EQ(&valueA, &intRefFuture.get());
 }
 
+TEST(Future, MakeReadyInline) {
+  struct Pair {
+    int a;
+    double b;
+  };
+  auto pairFuture = dispenso::make_ready_future(Pair{3, 4.5});
+  EXPECT_TRUE(pairFuture.valid());
+  EXPECT_TRUE(pairFuture.is_ready());
+  EXPECT_EQ(pairFuture.wait_for(std::chrono::milliseconds(0)), std::future_status::ready);
+
+  auto copy = pairFuture;
+  EXPECT_EQ(copy.get().a, 3);
+  EXPECT_EQ(pairFuture.get().b, 4.5);
+
+  auto shared = std::move(pairFuture).share();
+  EXPECT_FALSE(pairFuture.valid());
+  EXPECT_TRUE(shared.is_ready());
+  EXPECT_EQ(shared.get().a, 3);
+
+  dispenso::Future<Pair> assigned;
+  assigned = shared;
+  EXPECT_EQ(assigned.get().a, 3);
+  assigned = std::move(assigned);
+  EXPECT_TRUE(assigned.valid());
+  assigned = dispenso::Future<Pair>([]() { return Pair{5, 6.0}; }, dispenso::kImmediateInvoker);
+  EXPECT_EQ(assigned.get().a, 5);
+  assigned = std::move(shared);
+  EXPECT_FALSE(shared.valid());
+  EXPECT_EQ(assigned.get().a, 3);
+}
+
+TEST(Future, MakeReadyInlineThen) {
+  auto intFuture = dispenso::make_ready_future(20);
+  auto doubled = intFuture.then([](dispenso::Future<int>&& prev) { return 2 * prev.get(); });
+  auto async = intFuture.then(
+      [](dispenso::Future<int>&& prev) { return prev.get() + 1; },
+      dispenso::globalThreadPool(),
+      std::launch::async);
+  EXPECT_EQ(doubled.get(), 40);
+  EXPECT_EQ(async.get(), 21);
+  EXPECT_EQ(intFuture.get(), 20);
+
+  int calls = 0;
+  auto voidFuture = dispenso::make_ready_future();
+  voidFuture.then([&calls](dispenso::Future<void>&&) { ++calls; }, dispenso::kImmediateInvoker)
+      .get();
+  EXPECT_EQ(calls, 1);
+
+  std::vector<dispenso::Future<int>> items;
+  for (int i = 0; i < 8; ++i) {
+    items.push_back(dispenso::make_ready_future(i));
+  }
+  auto all = dispenso::when_all(items.begin(), items.end()).then([](auto&& ready) {
+    int sum = 0;
+    for (auto& item : ready.get()) {
+      sum += item.get();
+    }
+    return sum;
+  });
+  EXPECT_EQ(all.get(), 28);
+}
+
 TEST(Future, ThreadPool) {
   int foo = 10;
   dispenso::Future<void> voidFuture([&foo]() { foo = 7; }, dispenso::globalThreadPool());
@@ -643,6 +708,41 @@ TEST(Future, MultiThenReadyDelayedOriginTightLoop) {
   }
 }
 
+TEST(Future, ConcurrentThenRegistration) {
+  constexpr int kThreads = 4;
+  constexpr int kPerThread = 50;
+  dispenso::CompletionEvent release;
+  dispenso::Future<int> intFuture(
+      [&release]() {
+        release.wait();
+        return 7;
+      },
+      dispenso::kNewThreadInvoker);
+
+  // Threads race to register continuations, including the first one, which is stored inline.
+  std::vector<std::vector<dispenso::Future<int>>> results(kThreads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&intFuture, &results, t]() {
+      for (int i = 0; i < kPerThread; ++i) {
+        results[t].push_back(intFuture.then(
+            [i](dispenso::Future<int>&& parent) { return parent.get() + i; },
+            dispenso::kImmediateInvoker));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  release.notify();
+
+  for (auto& perThread : results) {
+    for (int i = 0; i < kPerThread; ++i) {
+      EXPECT_EQ(perThread[i].get(), 7 + i);
+    }
+  }
+}
+
 TEST(Future, ImmediateInvoker) {
   // Don't write code like this in real life.  It is (much) cheaper to use make_ready_future.
   dispenso::Future<int> future([]() { return 333; }, dispenso::kImmediateInvoker);
@@ -931,6 +1031,102 @@ TEST(Future, WhenAllTreeBuildIters) {
 }
 
 // Pretty convoluted, but there was a bug where taskset wait does not imply the future is finished.
+TEST(Future, WhenAnyEmptyVector) {
+  std::vector<dispenso::Future<int>> items;
+  auto any = dispenso::when_any(items.begin(), items.end());
+  ASSERT_TRUE(any.is_ready());
+  EXPECT_EQ(any.get().index, std::numeric_limits<size_t>::max());
+  EXPECT_TRUE(any.get().futures.empty());
+}
+
+TEST(Future, WhenAnyVectorFirstWins) {
+  dispenso::ThreadPool pool(2);
+  std::atomic<bool> release(false);
+  std::vector<dispenso::Future<int>> items;
+  for (int i = 0; i < 8; ++i) {
+    if (i == 5) {
+      items.emplace_back([]() { return 5; }, pool);
+    } else {
+      items.emplace_back(
+          [&release, i]() {
+            while (!release.load(std::memory_order_acquire)) {
+              std::this_thread::yield();
+            }
+            return i;
+          },
+          dispenso::kNewThreadInvoker);
+    }
+  }
+
+  auto any = dispenso::when_any(items.begin(), items.end());
+  auto& result = any.get();
+  EXPECT_EQ(result.index, 5);
+  ASSERT_EQ(result.futures.size(), 8);
+  EXPECT_TRUE(result.futures[5].is_ready());
+  EXPECT_EQ(result.futures[5].get(), 5);
+  release.store(true, std::memory_order_release);
+  for (auto& f : items) {
+    f.wait();
+  }
+}
+
+TEST(Future, WhenAnyTuple) {
+  std::atomic<bool> release(false);
+  dispenso::Future<int> slow(
+      [&release]() {
+        while (!release.load(std::memory_order_acquire)) {
+          std::this_thread::yield();
+        }
+        return 1;
+      },
+      dispenso::kNewThreadInvoker);
+  auto ready = dispenso::make_ready_future(std::string("ready"));
+
+  auto any = dispenso::when_any(slow, ready).then([](auto&& anyFuture) {
+    auto& result = anyFuture.get();
+    EXPECT_EQ(result.index, 1);
+    return std::get<1>(result.futures).get();
+  });
+  EXPECT_EQ(any.get(), "ready");
+  release.store(true, std::memory_order_release);
+  slow.wait();
+}
+
+TEST(Future, WhenAnyAllReady) {
+  std::vector<dispenso::Future<int>> items;
+  for (int i = 0; i < 4; ++i) {
+    items.push_back(dispenso::make_ready_future(i));
+  }
+  auto any = dispenso::when_any(items.begin(), items.end());
+  EXPECT_EQ(any.get().index, 0);
+}
+
+TEST(Future, WhenAnyRace) {
+  dispenso::ThreadPool pool(6);
+  for (int iter = 0; iter < 500; ++iter) {
+    std::vector<dispenso::Future<int>> items;
+    for (int i = 0; i < 6; ++i) {
+      items.emplace_back([i]() { return i; }, pool, std::launch::async);
+    }
+    auto any = dispenso::when_any(items.begin(), items.end());
+    auto& result = any.get();
+    ASSERT_LT(result.index, 6);
+    EXPECT_TRUE(result.futures[result.index].is_ready());
+    EXPECT_EQ(result.futures[result.index].get(), static_cast<int>(result.index));
+  }
+}
+
+TEST(Future, TaskSetWaitImpliesWhenAnyFinished) {
+  dispenso::ConcurrentTaskSet tasks(dispenso::globalThreadPool());
+  std::vector<dispenso::Future<int>> items;
+  for (int i = 0; i < 10; ++i) {
+    items.emplace_back([i]() { return i; }, tasks);
+  }
+  auto any = dispenso::when_any(tasks, items.begin(), items.end());
+  tasks.wait();
+  EXPECT_TRUE(any.is_ready());
+}
+
 TEST(Future, TaskSetWaitImpliesFinished) {
   std::atomic<int> status(0);
   std::atomic<int> sidelineResult(0);
@@ -1086,6 +1282,20 @@ TEST(Future, Move) {
   EXPECT_EQ(sp.use_count(), 1);
 }
 
+TEST(Future, MoveAssignSharedState) {
+  std::weak_ptr<int> weak;
+  {
+    auto fut = dispenso::make_ready_future(std::make_shared<int>(5));
+    weak = fut.get();
+    auto copy = fut;
+    // Both futures refer to the same shared state, so the copy's reference must be released.
+    fut = std::move(copy);
+    EXPECT_FALSE(copy.valid());
+    EXPECT_EQ(*fut.get(), 5);
+  }
+  EXPECT_TRUE(weak.expired());
+}
+
 TEST(Future, ThenRefCountImmediate) {
   std::shared_ptr<int> sp = std::make_shared<int>(5);
 
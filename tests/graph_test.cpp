@@ -0,0 +1,261 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/graph.h>
+
+#include <algorithm>
+#include <random>
+
+#include <gtest/gtest.h>
+
+namespace {
+// A random DAG in which every node checks that all of its predecessors ran before it, during the
+// current execution.
+struct CheckedDag {
+  CheckedDag(size_t numNodes, size_t maxPreds, uint32_t seed) : stamps(numNodes), preds(numNodes) {
+    std::mt19937 rng(seed);
+    for (size_t i = 0; i < numNodes; ++i) {
+      graph.addNode([this, i]() {
+        int expected = execution.load(std::memory_order_relaxed);
+        for (size_t p : preds[i]) {
+          if (stamps[p].load(std::memory_order_acquire) != expected) {
+            failures.fetch_add(1, std::memory_order_relaxed);
+          }
+        }
+        stamps[i].store(expected, std::memory_order_release);
+      });
+      if (i) {
+        std::uniform_int_distribution<size_t> dist(0, i - 1);
+        size_t numPreds = std::min(i, maxPreds);
+        for (size_t j = 0; j < numPreds; ++j) {
+          size_t p = dist(rng);
+          preds[i].push_back(p);
+          graph.addEdge(p, i);
+        }
+      }
+    }
+  }
+
+  void execute(dispenso::ThreadPool& pool) {
+    execution.fetch_add(1, std::memory_order_relaxed);
+    graph.execute(pool);
+    for (auto& s : stamps) {
+      if (s.load(std::memory_order_relaxed) != execution.load(std::memory_order_relaxed)) {
+        failures.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  dispenso::Graph graph;
+  std::vector<std::atomic<int>> stamps;
+  std::vector<std::vector<size_t>> preds;
+  std::atomic<int> execution{0};
+  std::atomic<int> failures{0};
+};
+} // namespace
+
+TEST(Graph, Empty) {
+  dispenso::Graph graph;
+  graph.execute();
+  EXPECT_EQ(graph.numNodes(), 0);
+}
+
+TEST(Graph, Chain) {
+  dispenso::Graph graph;
+  std::vector<int> order;
+  for (int i = 0; i < 10; ++i) {
+    size_t node = graph.addNode([&order, i]() { order.push_back(i); });
+    if (i) {
+      graph.addEdge(node - 1, node);
+    }
+  }
+  graph.execute();
+  ASSERT_EQ(order.size(), 10);
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(order[i], i);
+  }
+}
+
+TEST(Graph, Diamond) {
+  dispenso::Graph graph;
+  std::atomic<int> a(0);
+  std::atomic<int> b(0);
+  std::atomic<int> c(0);
+  int d = 0;
+  size_t top = graph.addNode([&a]() { a = 1; });
+  size_t left = graph.addNode([&a, &b]() { b = a + 1; });
+  size_t right = graph.addNode([&a, &c]() { c = a + 2; });
+  size_t bottom = graph.addNode([&b, &c, &d]() { d = b + c; });
+  graph.addEdge(top, left);
+  graph.addEdge(top, right);
+  graph.addEdge(left, bottom);
+  graph.addEdge(right, bottom);
+  EXPECT_EQ(graph.numEdges(), 4);
+  graph.execute();
+  EXPECT_EQ(d, 5);
+}
+
+TEST(Graph, RepeatedExecution) {
+  dispenso::ThreadPool pool(8);
+  CheckedDag dag(500, 3, 17);
+  for (int i = 0; i < 100; ++i) {
+    dag.execute(pool);
+  }
+  EXPECT_EQ(dag.failures.load(), 0);
+}
+
+TEST(Graph, WideFanOutFanIn) {
+  dispenso::ThreadPool pool(4);
+  dispenso::Graph graph;
+  std::atomic<int> count(0);
+  int seen = -1;
+  size_t source = graph.addNode([]() {});
+  size_t sink = graph.addNode([&count, &seen]() { seen = count.load(); });
+  for (int i = 0; i < 1000; ++i) {
+    size_t node = graph.addNode([&count]() { count.fetch_add(1, std::memory_order_relaxed); });
+    graph.addEdge(source, node);
+    graph.addEdge(node, sink);
+  }
+  for (int i = 1; i <= 10; ++i) {
+    graph.execute(pool);
+    EXPECT_EQ(seen, 1000 * i);
+  }
+}
+
+TEST(Graph, ModifyBetweenExecutions) {
+  dispenso::ThreadPool pool(4);
+  CheckedDag dag(100, 2, 3);
+  dag.execute(pool);
+  size_t last = dag.graph.numNodes() - 1;
+  std::atomic<int> extra(0);
+  size_t node = dag.graph.addNode([&extra]() { extra.fetch_add(1); });
+  dag.graph.addEdge(last, node);
+  dag.execute(pool);
+  dag.execute(pool);
+  EXPECT_EQ(extra.load(), 2);
+  EXPECT_EQ(dag.failures.load(), 0);
+}
+
+TEST(Graph, ZeroThreadPool) {
+  dispenso::ThreadPool pool(0);
+  CheckedDag dag(200, 3, 5);
+  for (int i = 0; i < 10; ++i) {
+    dag.execute(pool);
+  }
+  EXPECT_EQ(dag.failures.load(), 0);
+}
+
+TEST(Graph, NewNodesStartDirty) {
+  dispenso::Graph graph;
+  int runs = 0;
+  size_t node = graph.addNode([&runs]() { ++runs; });
+  EXPECT_TRUE(graph.isDirty(node));
+  graph.executeDirty();
+  EXPECT_EQ(runs, 1);
+  EXPECT_FALSE(graph.isDirty(node));
+  graph.executeDirty();
+  EXPECT_EQ(runs, 1);
+  graph.execute();
+  EXPECT_EQ(runs, 2);
+}
+
+TEST(Graph, DirtySubgraph) {
+  // a -> b -> d, a -> c -> d, e -> f
+  dispenso::Graph graph;
+  std::vector<std::atomic<int>> runs(6);
+  for (size_t i = 0; i < 6; ++i) {
+    graph.addNode([&runs, i]() { runs[i].fetch_add(1, std::memory_order_relaxed); });
+  }
+  graph.addEdge(0, 1);
+  graph.addEdge(0, 2);
+  graph.addEdge(1, 3);
+  graph.addEdge(2, 3);
+  graph.addEdge(4, 5);
+  graph.execute();
+
+  graph.markDirty(2);
+  graph.executeDirty();
+  std::vector<int> expected = {1, 1, 2, 2, 1, 1};
+  for (size_t i = 0; i < 6; ++i) {
+    EXPECT_EQ(runs[i].load(), expected[i]) << "node " << i;
+  }
+
+  graph.markDirty(4);
+  graph.markDirty(1);
+  graph.markDirty(4);
+  graph.executeDirty();
+  expected = {1, 2, 2, 3, 2, 2};
+  for (size_t i = 0; i < 6; ++i) {
+    EXPECT_EQ(runs[i].load(), expected[i]) << "node " << i;
+  }
+}
+
+TEST(Graph, DirtySubgraphOrdering) {
+  dispenso::ThreadPool pool(8);
+  dispenso::Graph graph;
+  constexpr size_t kNumNodes = 400;
+  std::vector<std::atomic<int>> stamps(kNumNodes);
+  std::vector<std::vector<size_t>> preds(kNumNodes);
+  std::atomic<int> execution(0);
+  std::atomic<int> failures(0);
+  std::vector<char> expectRun(kNumNodes, 1);
+  std::mt19937 rng(11);
+  for (size_t i = 0; i < kNumNodes; ++i) {
+    graph.addNode([&, i]() {
+      int current = execution.load(std::memory_order_relaxed);
+      // Any predecessor that runs in this execution must already be done.
+      for (size_t p : preds[i]) {
+        if (expectRun[p] && stamps[p].load(std::memory_order_acquire) != current) {
+          failures.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+      stamps[i].store(current, std::memory_order_release);
+    });
+    if (i) {
+      std::uniform_int_distribution<size_t> dist(0, i - 1);
+      for (size_t j = 0; j < std::min<size_t>(i, 2); ++j) {
+        size_t p = dist(rng);
+        preds[i].push_back(p);
+        graph.addEdge(p, i);
+      }
+    }
+  }
+  graph.execute(pool);
+
+  for (int e = 1; e <= 50; ++e) {
+    execution.store(e, std::memory_order_relaxed);
+    std::fill(expectRun.begin(), expectRun.end(), 0);
+    for (int d = 0; d < 3; ++d) {
+      size_t node = std::uniform_int_distribution<size_t>(0, kNumNodes - 1)(rng);
+      graph.markDirty(node);
+      expectRun[node] = 1;
+    }
+    // Edges always point to higher indices, so one forward pass finds the closure.
+    for (size_t i = 0; i < kNumNodes; ++i) {
+      for (size_t p : preds[i]) {
+        expectRun[i] |= expectRun[p];
+      }
+    }
+    graph.executeDirty(pool);
+    for (size_t i = 0; i < kNumNodes; ++i) {
+      EXPECT_EQ(stamps[i].load() == e, static_cast<bool>(expectRun[i])) << "node " << i;
+    }
+  }
+  EXPECT_EQ(failures.load(), 0);
+}
+
+#if defined(__cpp_exceptions)
+TEST(Graph, Exception) {
+  dispenso::Graph graph;
+  bool ranAfter = false;
+  size_t thrower = graph.addNode([]() { throw std::runtime_error("node failed"); });
+  size_t after = graph.addNode([&ranAfter]() { ranAfter = true; });
+  graph.addEdge(thrower, after);
+  EXPECT_THROW(graph.execute(), std::runtime_error);
+  EXPECT_FALSE(ranAfter);
+}
+#endif // __cpp_exceptions
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/huge_pages.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <dispenso/concurrent_vector.h>
+#include <dispenso/parallel_for.h>
+#include <dispenso/pool_allocator.h>
+
+#include <gtest/gtest.h>
+
+namespace {
+bool isAligned(const void* ptr, size_t alignment) {
+  return reinterpret_cast<uintptr_t>(ptr) % alignment == 0;
+}
+
+struct HugePageTraits : dispenso::DefaultConcurrentVectorTraits {
+  static constexpr bool kUseHugePages = true;
+};
+} // namespace
+
+TEST(HugePages, SmallAlloc) {
+  for (size_t bytes : {0, 1, 100, 4096, 5000}) {
+    char* ptr = static_cast<char*>(dispenso::hugePageAlloc(bytes));
+    ASSERT_NE(ptr, nullptr);
+    EXPECT_TRUE(isAligned(ptr, dispenso::kHugePageMinAlignment));
+    std::memset(ptr, 0xab, bytes);
+    dispenso::hugePageFree(ptr);
+  }
+}
+
+TEST(HugePages, LargeAlloc) {
+  const size_t huge = dispenso::hugePageSize();
+  const size_t bytes = 3 * (huge ? huge : size_t{1} << 21) + 17;
+  char* ptr = static_cast<char*>(dispenso::hugePageAlloc(bytes));
+  ASSERT_NE(ptr, nullptr);
+  EXPECT_TRUE(isAligned(ptr, dispenso::kHugePageMinAlignment));
+#if defined(__linux__)
+  EXPECT_TRUE(isAligned(ptr, huge));
+#endif // __linux__
+  std::memset(ptr, 0xcd, bytes);
+  EXPECT_EQ(ptr[bytes - 1], static_cast<char>(0xcd));
+  dispenso::hugePageFree(ptr);
+}
+
+TEST(HugePages, FreeNull) {
+  dispenso::hugePageFree(nullptr);
+}
+
+TEST(HugePages, PoolAllocatorBacking) {
+  dispenso::PoolAllocator allocator(
+      256, size_t{4} << 20, dispenso::hugePageAlloc, dispenso::hugePageFree);
+  std::vector<char*> chunks;
+  for (int i = 0; i < 20000; ++i) {
+    chunks.push_back(allocator.alloc());
+    std::memset(chunks.back(), i & 0xff, 256);
+  }
+  for (int i = 0; i < 20000; ++i) {
+    EXPECT_EQ(chunks[i][255], static_cast<char>(i & 0xff));
+    allocator.dealloc(chunks[i]);
+  }
+}
+
+TEST(HugePages, ConcurrentVectorBuckets) {
+  constexpr int kCount = 1 << 20;
+  dispenso::ConcurrentVector<int, HugePageTraits> vec;
+  dispenso::parallel_for(0, kCount, [&vec](int i) { vec.push_back(i); });
+  ASSERT_EQ(vec.size(), static_cast<size_t>(kCount));
+  std::vector<int> seen(kCount, 0);
+  for (int v : vec) {
+    ++seen[v];
+  }
+  for (int s : seen) {
+    ASSERT_EQ(s, 1);
+  }
+
+  dispenso::ConcurrentVector<int, HugePageTraits> moved(std::move(vec));
+  EXPECT_EQ(moved.size(), static_cast<size_t>(kCount));
+  vec.push_back(1);
+  EXPECT_EQ(vec.size(), 1u);
+  moved.shrink_to_fit();
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/latch.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+TEST(Latch, ZeroIsReleased) {
+  dispenso::Latch latch(0);
+  EXPECT_TRUE(latch.tryWait());
+  latch.wait();
+}
+
+TEST(Latch, CountDown) {
+  dispenso::Latch latch(3);
+  latch.countDown();
+  EXPECT_FALSE(latch.tryWait());
+  latch.countDown(2);
+  EXPECT_TRUE(latch.tryWait());
+  latch.wait();
+}
+
+TEST(Latch, WaitFor) {
+  dispenso::Latch latch(1);
+  EXPECT_FALSE(latch.waitFor(std::chrono::milliseconds(1)));
+  latch.countDown();
+  EXPECT_TRUE(latch.waitFor(std::chrono::milliseconds(1)));
+}
+
+TEST(Latch, ReleasesAllWaiters) {
+  constexpr int kThreads = 8;
+  dispenso::Latch start(kThreads);
+  dispenso::Latch done(kThreads);
+  std::atomic<int> arrived(0);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreads; ++i) {
+    threads.emplace_back([&]() {
+      arrived.fetch_add(1, std::memory_order_relaxed);
+      start.arriveAndWait();
+      // Every thread has arrived before any is released.
+      EXPECT_EQ(arrived.load(std::memory_order_relaxed), kThreads);
+      done.countDown();
+    });
+  }
+  done.wait();
+  for (auto& t : threads) {
+    t.join();
+  }
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/latency_histogram.h>
+
+#include <gtest/gtest.h>
+
+using dispenso::LatencyHistogram;
+
+TEST(LatencyHistogram, BucketBounds) {
+  size_t prevIndex = 0;
+  for (uint64_t v = 0; v < 100000; ++v) {
+    size_t index = LatencyHistogram::bucketIndex(v);
+    ASSERT_LT(index, LatencyHistogram::kNumBuckets);
+    ASSERT_GE(index, prevIndex);
+    prevIndex = index;
+    uint64_t lower = LatencyHistogram::bucketLowerBound(index);
+    uint64_t upper = LatencyHistogram::bucketUpperBound(index);
+    ASSERT_LE(lower, v);
+    ASSERT_GE(upper, v);
+    // Buckets are at most an eighth of their lower bound wide.
+    ASSERT_LE(upper - lower, std::max<uint64_t>(1, lower / 8) - 1);
+  }
+  for (uint32_t shift = 17; shift < 64; ++shift) {
+    uint64_t v = uint64_t{1} << shift;
+    EXPECT_EQ(LatencyHistogram::bucketLowerBound(LatencyHistogram::bucketIndex(v)), v);
+    EXPECT_EQ(LatencyHistogram::bucketUpperBound(LatencyHistogram::bucketIndex(v - 1)), v - 1);
+  }
+  EXPECT_EQ(LatencyHistogram::bucketIndex(UINT64_MAX), LatencyHistogram::kNumBuckets - 1);
+  EXPECT_EQ(LatencyHistogram::bucketUpperBound(LatencyHistogram::kNumBuckets - 1), UINT64_MAX);
+}
+
+TEST(LatencyHistogram, Empty) {
+  LatencyHistogram h;
+  EXPECT_EQ(h.count(), 0u);
+  EXPECT_EQ(h.max(), 0u);
+  EXPECT_EQ(h.mean(), 0.0);
+  EXPECT_EQ(h.percentile(99.0), 0u);
+  EXPECT_TRUE(h.buckets().empty());
+}
+
+TEST(LatencyHistogram, Percentiles) {
+  LatencyHistogram h;
+  for (uint64_t v = 1; v <= 1000; ++v) {
+    h.record(v);
+  }
+  EXPECT_EQ(h.count(), 1000u);
+  EXPECT_EQ(h.max(), 1000u);
+  EXPECT_DOUBLE_EQ(h.mean(), 500.5);
+  EXPECT_GE(h.percentile(50.0), 500u);
+  EXPECT_LE(h.percentile(50.0), 500u + 500u / 8);
+  EXPECT_GE(h.percentile(99.0), 990u);
+  EXPECT_LE(h.percentile(99.0), 1000u);
+  EXPECT_EQ(h.percentile(100.0), 1000u);
+  EXPECT_EQ(h.percentile(0.0), 1u);
+}
+
+TEST(LatencyHistogram, Merge) {
+  LatencyHistogram a;
+  LatencyHistogram b;
+  a.record(10, 3);
+  b.record(1000000);
+  a.merge(b);
+  a.merge(LatencyHistogram());
+  EXPECT_EQ(a.count(), 4u);
+  EXPECT_EQ(a.max(), 1000000u);
+  EXPECT_DOUBLE_EQ(a.mean(), (30.0 + 1000000.0) / 4.0);
+  EXPECT_EQ(a.percentile(75.0), 10u);
+  EXPECT_EQ(a.percentile(76.0), 1000000u);
+}
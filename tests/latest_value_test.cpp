@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <dispenso/latest_value.h>
+
+#include <gtest/gtest.h>
+
+TEST(LatestValue, SequentialAsExpected) {
+  dispenso::LatestValue<int> latest;
+
+  EXPECT_FALSE(latest.hasUpdate());
+  EXPECT_EQ(latest.getLatest(), nullptr);
+
+  latest.publish(1);
+  EXPECT_TRUE(latest.hasUpdate());
+  ASSERT_NE(latest.getLatest(), nullptr);
+  EXPECT_FALSE(latest.hasUpdate());
+  EXPECT_EQ(*latest.getLatest(), 1);
+
+  // Only the newest of several updates is seen.
+  latest.publish(2);
+  latest.publish(3);
+  latest.publish(4);
+  EXPECT_EQ(*latest.getLatest(), 4);
+  EXPECT_EQ(*latest.getLatest(), 4);
+}
+
+TEST(LatestValue, PublishInPlaceReusesBuffers) {
+  dispenso::LatestValue<std::vector<int>> latest;
+  for (int i = 0; i < 10; ++i) {
+    latest.publishInPlace([i](std::vector<int>& v) {
+      v.assign(100, i);
+    });
+    std::vector<int>* v = latest.getLatest();
+    ASSERT_NE(v, nullptr);
+    EXPECT_EQ(v->size(), 100);
+    EXPECT_EQ(v->front(), i);
+  }
+
+  // Every buffer has been used, so republishing in place needs no new allocation.
+  for (int i = 0; i < 3; ++i) {
+    latest.publishInPlace([](std::vector<int>& v) { EXPECT_GE(v.capacity(), 100); });
+    latest.getLatest();
+  }
+}
+
+TEST(LatestValue, AsyncMonotonic) {
+  struct Pair {
+    int64_t a;
+    int64_t b;
+  };
+  constexpr int64_t kUpdates = 200000;
+  dispenso::LatestValue<Pair> latest;
+  std::thread producer([&latest]() {
+    for (int64_t i = 1; i <= kUpdates; ++i) {
+      latest.publish(Pair{i, -i});
+    }
+  });
+
+  int64_t last = 0;
+  while (last < kUpdates) {
+    Pair* p = latest.getLatest();
+    if (!p) {
+      continue;
+    }
+    // Values are never torn, and never go backwards.
+    EXPECT_EQ(p->a, -p->b);
+    EXPECT_GE(p->a, last);
+    last = p->a;
+  }
+  producer.join();
+  EXPECT_FALSE(latest.hasUpdate());
+}
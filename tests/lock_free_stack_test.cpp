@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/lock_free_stack.h>
+
+#include <atomic>
+#include <deque>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+struct Node {
+  std::atomic<Node*> next{nullptr};
+  size_t value = 0;
+  std::atomic<bool> owned{false};
+};
+} // namespace
+
+TEST(LockFreeStack, PushPop) {
+  dispenso::LockFreeStack<Node> stack;
+  EXPECT_TRUE(stack.empty());
+  EXPECT_EQ(stack.pop(), nullptr);
+
+  std::vector<Node> nodes(3);
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    nodes[i].value = i;
+    stack.push(&nodes[i]);
+  }
+  EXPECT_FALSE(stack.empty());
+  EXPECT_EQ(stack.pop(), &nodes[2]);
+  EXPECT_EQ(stack.pop(), &nodes[1]);
+  EXPECT_EQ(stack.pop(), &nodes[0]);
+  EXPECT_EQ(stack.pop(), nullptr);
+  EXPECT_TRUE(stack.empty());
+}
+
+TEST(LockFreeStack, Batches) {
+  dispenso::LockFreeStack<Node> stack;
+  std::vector<Node> nodes(10);
+  for (size_t i = 0; i + 1 < nodes.size(); ++i) {
+    nodes[i].next.store(&nodes[i + 1]);
+  }
+  stack.pushBatch(&nodes[0], &nodes[4]);
+  stack.pushBatch(&nodes[5], &nodes[9]);
+
+  size_t count;
+  Node* first = stack.popBatch(3, count);
+  EXPECT_EQ(count, 3u);
+  EXPECT_EQ(first, &nodes[5]);
+  EXPECT_EQ(nodes[7].next.load(), nullptr);
+
+  first = stack.popBatch(5, count);
+  EXPECT_EQ(count, 5u);
+  EXPECT_EQ(first, &nodes[8]);
+  EXPECT_EQ(nodes[9].next.load(), &nodes[0]);
+  EXPECT_EQ(nodes[2].next.load(), nullptr);
+
+  first = stack.popBatch(100, count);
+  EXPECT_EQ(count, 2u);
+  EXPECT_EQ(first, &nodes[3]);
+  EXPECT_EQ(stack.popBatch(1, count), nullptr);
+  EXPECT_EQ(count, 0u);
+}
+
+TEST(LockFreeStack, PopAll) {
+  dispenso::LockFreeStack<Node> stack;
+  EXPECT_EQ(stack.popAll(), nullptr);
+  std::vector<Node> nodes(4);
+  for (Node& node : nodes) {
+    stack.push(&node);
+  }
+  size_t count = 0;
+  for (Node* node = stack.popAll(); node; node = node->next.load()) {
+    EXPECT_EQ(node, &nodes[nodes.size() - 1 - count]);
+    ++count;
+  }
+  EXPECT_EQ(count, nodes.size());
+  EXPECT_TRUE(stack.empty());
+}
+
+TEST(LockFreeStack, ConcurrentRecycling) {
+  constexpr size_t kNumNodes = 64;
+  constexpr size_t kNumThreads = 8;
+  constexpr size_t kIters = 20000;
+
+  dispenso::LockFreeStack<Node> stack;
+  std::vector<Node> nodes(kNumNodes);
+  for (Node& node : nodes) {
+    stack.push(&node);
+  }
+
+  std::deque<std::thread> threads;
+  for (size_t t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&stack, t]() {
+      for (size_t i = 0; i < kIters; ++i) {
+        if ((i + t) % 4 == 0) {
+          size_t count;
+          Node* first = stack.popBatch(3, count);
+          Node* last = first;
+          for (Node* node = first; node; node = node->next.load(std::memory_order_relaxed)) {
+            EXPECT_FALSE(node->owned.exchange(true));
+            last = node;
+          }
+          for (Node* node = first; node; node = node->next.load(std::memory_order_relaxed)) {
+            node->owned.store(false);
+          }
+          if (first) {
+            stack.pushBatch(first, last);
+          }
+        } else if (Node* node = stack.pop()) {
+          // Each node must be owned by at most one thread at a time.
+          EXPECT_FALSE(node->owned.exchange(true));
+          node->value += 1;
+          node->owned.store(false);
+          stack.push(node);
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  size_t count = 0;
+  for (Node* node = stack.popAll(); node; node = node->next.load()) {
+    ++count;
+  }
+  EXPECT_EQ(count, kNumNodes);
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <algorithm>
+#include <list>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+#include <dispenso/parallel_algorithm.h>
+
+#include <gtest/gtest.h>
+
+static bool isOdd(int v) {
+  return v & 1;
+}
+
+TEST(ParallelTransform, Vector) {
+  dispenso::ThreadPool pool(4);
+  dispenso::TaskSet tasks(pool);
+  for (int n : {0, 1, 3, 1000, 100000}) {
+    std::vector<int> input(n);
+    std::iota(input.begin(), input.end(), 0);
+    std::vector<int64_t> output(n);
+    auto end = dispenso::parallel_transform(
+        tasks, input.begin(), input.end(), output.begin(), [](int v) { return int64_t{v} * v; });
+    EXPECT_EQ(end, output.end());
+    for (int i = 0; i < n; ++i) {
+      EXPECT_EQ(output[i], int64_t{i} * i);
+    }
+  }
+}
+
+TEST(ParallelTransform, InPlaceNoWait) {
+  dispenso::ThreadPool pool(3);
+  dispenso::TaskSet tasks(pool);
+  std::vector<int> values(10000, 2);
+  dispenso::ForEachOptions options;
+  options.wait = false;
+  dispenso::parallel_transform(
+      tasks, values.begin(), values.end(), values.begin(), [](int v) { return v * 3; }, options);
+  tasks.wait();
+  EXPECT_EQ(std::count(values.begin(), values.end(), 6), 10000);
+}
+
+TEST(ParallelTransform, List) {
+  std::list<int> input(5000, 7);
+  std::list<int> output(5000);
+  dispenso::parallel_transform(
+      input.begin(), input.end(), output.begin(), [](int v) { return v + 1; });
+  EXPECT_EQ(std::count(output.begin(), output.end(), 8), 5000);
+}
+
+TEST(ParallelCopyIf, PreservesOrder) {
+  dispenso::ThreadPool pool(5);
+  dispenso::TaskSet tasks(pool);
+  for (int n : {0, 1, 2, 17, 1000, 100001}) {
+    std::vector<int> input(n);
+    std::iota(input.begin(), input.end(), 0);
+    std::vector<int> expected;
+    std::copy_if(input.begin(), input.end(), std::back_inserter(expected), isOdd);
+    std::vector<int> output(n, -1);
+    auto end = dispenso::parallel_copy_if(tasks, input.begin(), input.end(), output.begin(), isOdd);
+    ASSERT_EQ(end - output.begin(), static_cast<ptrdiff_t>(expected.size()));
+    output.resize(expected.size());
+    EXPECT_EQ(output, expected);
+  }
+}
+
+TEST(ParallelCopyIf, NoneAndAll) {
+  std::vector<int> input(20000, 1);
+  std::vector<int> output(input.size(), 0);
+  auto end = dispenso::parallel_copy_if(
+      input.begin(), input.end(), output.begin(), [](int v) { return v == 2; });
+  EXPECT_EQ(end, output.begin());
+  end = dispenso::parallel_copy_if(
+      input.begin(), input.end(), output.begin(), [](int v) { return v == 1; });
+  EXPECT_EQ(end, output.end());
+  EXPECT_EQ(output, input);
+}
+
+TEST(ParallelCopyIf, MaxThreadsZero) {
+  dispenso::ThreadPool pool(4);
+  dispenso::TaskSet tasks(pool);
+  std::vector<int> input(1000);
+  std::iota(input.begin(), input.end(), 0);
+  std::vector<int> output(input.size());
+  dispenso::ForEachOptions options;
+  options.maxThreads = 0;
+  auto end =
+      dispenso::parallel_copy_if(tasks, input.begin(), input.end(), output.begin(), isOdd, options);
+  EXPECT_EQ(end - output.begin(), 500);
+  EXPECT_EQ(output[0], 1);
+  EXPECT_EQ(output[499], 999);
+}
+
+TEST(ParallelPartition, Stable) {
+  dispenso::ThreadPool pool(6);
+  dispenso::TaskSet tasks(pool);
+  for (int n : {0, 1, 2, 17, 1000, 100001}) {
+    std::vector<int> values(n);
+    for (int i = 0; i < n; ++i) {
+      values[i] = (i * 7919) % 10007;
+    }
+    auto expected = values;
+    auto expectedMid = std::stable_partition(expected.begin(), expected.end(), isOdd);
+    auto mid = dispenso::parallel_partition(tasks, values.begin(), values.end(), isOdd);
+    EXPECT_EQ(mid - values.begin(), expectedMid - expected.begin());
+    EXPECT_EQ(values, expected);
+  }
+}
+
+TEST(ParallelPartition, MoveOnly) {
+  std::vector<std::unique_ptr<int>> values;
+  for (int i = 0; i < 10000; ++i) {
+    values.push_back(std::make_unique<int>(i));
+  }
+  auto mid = dispenso::parallel_partition(
+      values.begin(), values.end(), [](const std::unique_ptr<int>& p) { return *p % 3 == 0; });
+  ASSERT_EQ(mid - values.begin(), 3334);
+  for (int i = 0; i < 3334; ++i) {
+    EXPECT_EQ(*values[i], 3 * i);
+  }
+  int prev = -1;
+  for (auto it = mid; it != values.end(); ++it) {
+    EXPECT_NE(**it % 3, 0);
+    EXPECT_GT(**it, prev);
+    prev = **it;
+  }
+}
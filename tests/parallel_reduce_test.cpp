@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+#include <dispenso/parallel_reduce.h>
+
+#include <gtest/gtest.h>
+
+static int64_t plus(int64_t a, int64_t b) {
+  return a + b;
+}
+
+TEST(ParallelReduce, SimpleSum) {
+  dispenso::ThreadPool pool(4);
+  dispenso::TaskSet tasks(pool);
+  for (auto chunking : {dispenso::ParForChunking::kStatic, dispenso::ParForChunking::kAuto}) {
+    for (int n : {1, 2, 3, 17, 1000, 100000}) {
+      int64_t sum = dispenso::parallel_reduce(
+          tasks,
+          dispenso::makeChunkedRange(0, n, chunking),
+          int64_t{0},
+          [](int64_t& acc, int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+              acc += i;
+            }
+          },
+          plus);
+      EXPECT_EQ(sum, int64_t{n} * (n - 1) / 2);
+    }
+  }
+}
+
+TEST(ParallelReduce, EmptyRange) {
+  dispenso::ThreadPool pool(4);
+  dispenso::TaskSet tasks(pool);
+  int64_t sum = dispenso::parallel_reduce(
+      tasks, 10, 10, int64_t{5}, [](int64_t& acc, int i) { acc += i; }, plus);
+  EXPECT_EQ(sum, 5);
+}
+
+TEST(ParallelReduce, IndexMax) {
+  std::vector<int> values(10000);
+  std::iota(values.begin(), values.end(), 0);
+  std::reverse(values.begin(), values.begin() + 5000);
+  int best = dispenso::parallel_reduce(
+      size_t{0},
+      values.size(),
+      std::numeric_limits<int>::min(),
+      [&values](int& acc, size_t i) { acc = std::max(acc, values[i]); },
+      [](int a, int b) { return std::max(a, b); });
+  EXPECT_EQ(best, 9999);
+}
+
+TEST(ParallelReduce, TreeCombineMergesVectors) {
+  dispenso::ThreadPool pool(7);
+  dispenso::TaskSet tasks(pool);
+  dispenso::ParForOptions options;
+  // Statically chunked partials correspond to contiguous subranges, so an order-dependent
+  // combine yields the values back in order.
+  std::vector<int> result = dispenso::parallel_reduce(
+      tasks,
+      dispenso::makeChunkedRange(0, 5000, dispenso::ParForChunking::kStatic),
+      std::vector<int>(),
+      [](std::vector<int>& acc, int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+          acc.push_back(i);
+        }
+      },
+      [](std::vector<int> a, std::vector<int> b) {
+        a.insert(a.end(), b.begin(), b.end());
+        return a;
+      },
+      options,
+      dispenso::ReduceCombine::kTree);
+  std::vector<int> expected(5000);
+  std::iota(expected.begin(), expected.end(), 0);
+  EXPECT_EQ(result, expected);
+}
+
+TEST(ParallelReduce, TreeCombineAuto) {
+  dispenso::ThreadPool pool(5);
+  dispenso::TaskSet tasks(pool);
+  int64_t sum = dispenso::parallel_reduce(
+      tasks,
+      dispenso::makeChunkedRange(0, 100000, dispenso::ParForChunking::kAuto),
+      int64_t{0},
+      [](int64_t& acc, int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+          acc += i;
+        }
+      },
+      plus,
+      dispenso::ParForOptions(),
+      dispenso::ReduceCombine::kTree);
+  EXPECT_EQ(sum, int64_t{100000} * 99999 / 2);
+}
+
+TEST(ParallelReduce, NoThreads) {
+  dispenso::ThreadPool pool(0);
+  dispenso::TaskSet tasks(pool);
+  int64_t sum = dispenso::parallel_reduce(
+      tasks, 0, 100, int64_t{0}, [](int64_t& acc, int i) { acc += i; }, plus);
+  EXPECT_EQ(sum, 4950);
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <algorithm>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include <dispenso/parallel_scan.h>
+
+#include <gtest/gtest.h>
+
+TEST(ParallelScan, InclusiveSum) {
+  dispenso::ThreadPool pool(4);
+  dispenso::TaskSet tasks(pool);
+  for (size_t n : {0, 1, 2, 3, 5, 17, 1000, 100001}) {
+    std::vector<int64_t> input(n);
+    std::iota(input.begin(), input.end(), int64_t{1});
+    std::vector<int64_t> expected(n);
+    std::partial_sum(input.begin(), input.end(), expected.begin());
+    std::vector<int64_t> output(n);
+    auto end = dispenso::parallel_inclusive_scan(tasks, input.begin(), input.end(), output.begin());
+    EXPECT_EQ(end, output.end());
+    EXPECT_EQ(output, expected);
+  }
+}
+
+TEST(ParallelScan, ExclusiveSum) {
+  dispenso::ThreadPool pool(5);
+  dispenso::TaskSet tasks(pool);
+  for (size_t n : {0, 1, 2, 6, 17, 1000, 100001}) {
+    std::vector<int64_t> input(n);
+    std::iota(input.begin(), input.end(), int64_t{1});
+    std::vector<int64_t> expected(n);
+    int64_t running = 100;
+    for (size_t i = 0; i < n; ++i) {
+      expected[i] = running;
+      running += input[i];
+    }
+    std::vector<int64_t> output(n);
+    dispenso::parallel_exclusive_scan(
+        tasks, input.begin(), input.end(), output.begin(), int64_t{100});
+    EXPECT_EQ(output, expected);
+  }
+}
+
+TEST(ParallelScan, InPlace) {
+  dispenso::ThreadPool pool(3);
+  dispenso::TaskSet tasks(pool);
+  std::vector<int> values(10000, 1);
+  dispenso::parallel_inclusive_scan(tasks, values.begin(), values.end(), values.begin());
+  for (size_t i = 0; i < values.size(); ++i) {
+    EXPECT_EQ(values[i], static_cast<int>(i + 1));
+  }
+  std::fill(values.begin(), values.end(), 1);
+  dispenso::parallel_exclusive_scan(tasks, values.begin(), values.end(), values.begin(), 0);
+  for (size_t i = 0; i < values.size(); ++i) {
+    EXPECT_EQ(values[i], static_cast<int>(i));
+  }
+}
+
+TEST(ParallelScan, CustomOpMax) {
+  std::vector<int> input(50000);
+  for (size_t i = 0; i < input.size(); ++i) {
+    input[i] = static_cast<int>((i * 7919) % 10007);
+  }
+  auto maxOp = [](int a, int b) { return std::max(a, b); };
+  std::vector<int> expected(input.size());
+  std::partial_sum(input.begin(), input.end(), expected.begin(), maxOp);
+  std::vector<int> output(input.size());
+  dispenso::TaskSet tasks(dispenso::globalThreadPool());
+  dispenso::parallel_inclusive_scan(tasks, input.begin(), input.end(), output.begin(), maxOp);
+  EXPECT_EQ(output, expected);
+}
+
+TEST(ParallelScan, NonCommutative) {
+  dispenso::ThreadPool pool(6);
+  dispenso::TaskSet tasks(pool);
+  std::vector<std::string> input(500);
+  for (size_t i = 0; i < input.size(); ++i) {
+    input[i] = std::string(1, static_cast<char>('a' + i % 26));
+  }
+  auto concat = [](std::string a, const std::string& b) { return a + b; };
+  std::vector<std::string> expected(input.size());
+  std::partial_sum(input.begin(), input.end(), expected.begin(), concat);
+  std::vector<std::string> output(input.size());
+  dispenso::parallel_inclusive_scan(tasks, input.begin(), input.end(), output.begin(), concat);
+  EXPECT_EQ(output, expected);
+
+  std::vector<std::string> exclusive(input.size());
+  dispenso::parallel_exclusive_scan(
+      tasks, input.begin(), input.end(), exclusive.begin(), std::string(">"), concat);
+  EXPECT_EQ(exclusive[0], ">");
+  for (size_t i = 1; i < input.size(); ++i) {
+    EXPECT_EQ(exclusive[i], ">" + expected[i - 1]);
+  }
+}
+
+TEST(ParallelScan, NoThreads) {
+  dispenso::ThreadPool pool(0);
+  dispenso::TaskSet tasks(pool);
+  std::vector<int> input(1000, 2);
+  std::vector<int> output(input.size());
+  dispenso::parallel_inclusive_scan(tasks, input.begin(), input.end(), output.begin());
+  EXPECT_EQ(output.back(), 2000);
+}
+
+TEST(ParallelScan, MaxThreads) {
+  dispenso::ThreadPool pool(8);
+  dispenso::TaskSet tasks(pool);
+  std::vector<int> input(1000, 1);
+  std::vector<int> output(input.size());
+  dispenso::ParForOptions options;
+  options.maxThreads = 1;
+  dispenso::parallel_inclusive_scan(
+      tasks, input.begin(), input.end(), output.begin(), std::plus<>(), options);
+  for (size_t i = 0; i < output.size(); ++i) {
+    EXPECT_EQ(output[i], static_cast<int>(i + 1));
+  }
+}
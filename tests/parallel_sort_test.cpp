@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <dispenso/parallel_sort.h>
+
+#include <gtest/gtest.h>
+
+template <typename T>
+std::vector<T> randomValues(size_t n, uint32_t seed) {
+  std::mt19937_64 rng(seed);
+  std::vector<T> values(n);
+  for (auto& v : values) {
+    v = static_cast<T>(rng());
+  }
+  return values;
+}
+
+template <typename T>
+void checkRadix(dispenso::TaskSet& tasks) {
+  for (size_t n : {0, 1, 100, 5000, 100000, 1000003}) {
+    auto values = randomValues<T>(n, static_cast<uint32_t>(n));
+    auto expected = values;
+    std::sort(expected.begin(), expected.end());
+    dispenso::parallel_sort(tasks, values.begin(), values.end());
+    EXPECT_EQ(values, expected) << "n = " << n;
+  }
+}
+
+TEST(ParallelSort, RadixUnsigned) {
+  dispenso::ThreadPool pool(4);
+  dispenso::TaskSet tasks(pool);
+  checkRadix<uint32_t>(tasks);
+  checkRadix<uint64_t>(tasks);
+  checkRadix<uint8_t>(tasks);
+}
+
+TEST(ParallelSort, RadixSigned) {
+  dispenso::ThreadPool pool(5);
+  dispenso::TaskSet tasks(pool);
+  checkRadix<int32_t>(tasks);
+  checkRadix<int64_t>(tasks);
+  checkRadix<int16_t>(tasks);
+}
+
+TEST(ParallelSort, RadixFewDistinct) {
+  dispenso::ThreadPool pool(3);
+  dispenso::TaskSet tasks(pool);
+  std::vector<int> values(100000);
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = static_cast<int>(i % 3) - 1;
+  }
+  dispenso::parallel_sort(tasks, values.begin(), values.end());
+  EXPECT_TRUE(std::is_sorted(values.begin(), values.end()));
+  EXPECT_EQ(std::count(values.begin(), values.end(), 0), 33333);
+}
+
+TEST(ParallelSort, Comparator) {
+  for (size_t threads : {1, 2, 3, 7}) {
+    dispenso::ThreadPool pool(threads);
+    dispenso::TaskSet tasks(pool);
+    for (size_t n : {0, 10, 5000, 100000, 300007}) {
+      auto values = randomValues<int64_t>(n, 7);
+      auto expected = values;
+      std::sort(expected.begin(), expected.end(), std::greater<>());
+      dispenso::parallel_sort(tasks, values.begin(), values.end(), std::greater<>());
+      EXPECT_EQ(values, expected) << "threads = " << threads << " n = " << n;
+    }
+  }
+}
+
+TEST(ParallelSort, Strings) {
+  dispenso::ThreadPool pool(4);
+  dispenso::TaskSet tasks(pool);
+  auto keys = randomValues<uint32_t>(50000, 3);
+  std::vector<std::string> values;
+  for (auto k : keys) {
+    values.push_back(std::to_string(k % 1000));
+  }
+  auto expected = values;
+  std::sort(expected.begin(), expected.end());
+  dispenso::parallel_sort(tasks, values.begin(), values.end());
+  EXPECT_EQ(values, expected);
+}
+
+TEST(ParallelSort, MoveOnly) {
+  dispenso::ThreadPool pool(6);
+  dispenso::TaskSet tasks(pool);
+  auto keys = randomValues<int>(20000, 11);
+  std::vector<std::unique_ptr<int>> values;
+  for (auto k : keys) {
+    values.push_back(std::make_unique<int>(k));
+  }
+  dispenso::parallel_sort(
+      tasks, values.begin(), values.end(), [](const auto& a, const auto& b) { return *a < *b; });
+  std::sort(keys.begin(), keys.end());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    ASSERT_TRUE(values[i]);
+    EXPECT_EQ(*values[i], keys[i]);
+  }
+}
+
+TEST(ParallelSort, GlobalPool) {
+  auto values = randomValues<float>(100000, 5);
+  auto expected = values;
+  std::sort(expected.begin(), expected.end());
+  dispenso::parallel_sort(values.begin(), values.end());
+  EXPECT_EQ(values, expected);
+}
@@ -8,6 +8,7 @@
 #include <dispenso/pipeline.h>
 
 #include <numeric>
+#include <thread>
 
 #include <gtest/gtest.h>
 
@@ -111,6 +112,42 @@ TEST(Pipeline, MultiStageSerialOpResult) {
 }
 #endif // C++17
 
+// With a serial generator, serial stages hand items to one another in generation order.
+TEST(Pipeline, MultiStageSerialKeepsOrder) {
+  constexpr int kNum = 100000;
+  int next = 0;
+  int expectedMid = 0;
+  std::vector<int> outputs;
+  bool midInOrder = true;
+  dispenso::pipeline(
+      [&next]() -> TestOptional<int> {
+        if (next < kNum) {
+          return next++;
+        }
+        return {};
+      },
+      [&expectedMid, &midInOrder](int num) {
+        midInOrder = midInOrder && num == expectedMid++;
+        return num * 2;
+      },
+      [](int num) -> TestOptional<int> {
+        if (num % 3 == 0) {
+          return {};
+        }
+        return num;
+      },
+      [&outputs](int num) { outputs.push_back(num); });
+
+  EXPECT_TRUE(midInOrder);
+  std::vector<int> expected;
+  for (int i = 0; i < kNum; ++i) {
+    if ((i * 2) % 3 != 0) {
+      expected.push_back(i * 2);
+    }
+  }
+  EXPECT_EQ(outputs, expected);
+}
+
 TEST(Pipeline, SingleStageParallel) {
   std::atomic<int> counter(0);
 
@@ -319,6 +356,59 @@ TEST(Pipeline, MultiStageCarryPointersMultiFilterUnlimitedParallel) {
   }
 }
 
+// Adjacent unlimited stages run fused, on the thread that ran the first of them, while a limited
+// stage still gets its own task.
+TEST(Pipeline, UnlimitedStagesRunFused) {
+  constexpr size_t kNumInputs = 10000;
+  std::atomic<size_t> counter(0);
+  std::atomic<size_t> unfused(0);
+  std::atomic<size_t> sum(0);
+  using Item = std::pair<size_t, std::thread::id>;
+
+  dispenso::pipeline(
+      dispenso::stage(
+          [&counter]() -> TestOptional<size_t> {
+            size_t i = counter.fetch_add(1, std::memory_order_relaxed);
+            if (i < kNumInputs) {
+              return i;
+            }
+            return {};
+          },
+          dispenso::kStageNoLimit),
+      dispenso::stage(
+          [](size_t i) { return Item(i, std::this_thread::get_id()); }, dispenso::kStageNoLimit),
+      dispenso::stage(
+          [&unfused](Item item) -> TestOptional<Item> {
+            if (item.second != std::this_thread::get_id()) {
+              unfused.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (item.first % 7 == 0) {
+              return {};
+            }
+            return item;
+          },
+          dispenso::kStageNoLimit),
+      dispenso::stage(
+          [&unfused](Item item) {
+            if (item.second != std::this_thread::get_id()) {
+              unfused.fetch_add(1, std::memory_order_relaxed);
+            }
+            return item.first;
+          },
+          dispenso::kStageNoLimit),
+      dispenso::stage(
+          [&sum](size_t i) { sum.fetch_add(i, std::memory_order_relaxed); }, 2));
+
+  EXPECT_EQ(unfused.load(), 0);
+  size_t expected = 0;
+  for (size_t i = 0; i < kNumInputs; ++i) {
+    if (i % 7 != 0) {
+      expected += i;
+    }
+  }
+  EXPECT_EQ(sum.load(), expected);
+}
+
 static size_t g_count = 0;
 
 TestOptional<size_t> funkGen() {
@@ -393,3 +483,615 @@ TEST(Pipeline, ZeroSizeThreadPool) {
 
   EXPECT_EQ(45, g_sum.load(std::memory_order_acquire));
 }
+
+static TestOptional<size_t> countTo(size_t& counter, size_t n) {
+  if (counter < n) {
+    return counter++;
+  }
+  return {};
+}
+
+TEST(Pipeline, OrderedSinkAfterParallelStage) {
+  constexpr size_t kNumInputs = 2000;
+  dispenso::ThreadPool pool(6);
+  std::vector<size_t> results;
+  size_t counter = 0;
+
+  dispenso::pipeline(
+      pool,
+      [&counter]() { return countTo(counter, kNumInputs); },
+      dispenso::stage(
+          [](size_t in) {
+            if (in % 7 == 0) {
+              std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+            return in * 2;
+          },
+          dispenso::kStageNoLimit),
+      dispenso::orderedStage([&results](size_t in) { results.push_back(in); }));
+
+  ASSERT_EQ(results.size(), kNumInputs);
+  for (size_t i = 0; i < kNumInputs; ++i) {
+    EXPECT_EQ(results[i], i * 2);
+  }
+}
+
+TEST(Pipeline, OrderedWithFiltering) {
+  constexpr size_t kNumInputs = 3000;
+  dispenso::ThreadPool pool(4);
+  std::vector<size_t> results;
+  size_t counter = 0;
+
+  dispenso::pipeline(
+      pool,
+      [&counter]() { return countTo(counter, kNumInputs); },
+      dispenso::stage(
+          [](size_t in) -> TestOptional<size_t> {
+            if (in % 3 == 0) {
+              return {};
+            }
+            return in;
+          },
+          4),
+      dispenso::orderedStage([&results](size_t in) { results.push_back(in); }, 8));
+
+  std::vector<size_t> expected;
+  for (size_t i = 0; i < kNumInputs; ++i) {
+    if (i % 3) {
+      expected.push_back(i);
+    }
+  }
+  EXPECT_EQ(results, expected);
+}
+
+TEST(Pipeline, OrderedChain) {
+  constexpr size_t kNumInputs = 1000;
+  dispenso::ThreadPool pool(5);
+  std::vector<size_t> seen;
+  std::vector<size_t> results;
+  size_t counter = 0;
+
+  // An ordered filtering stage, more parallel work, then another ordered stage with a tiny window.
+  dispenso::pipeline(
+      pool,
+      [&counter]() { return countTo(counter, kNumInputs); },
+      dispenso::stage([](size_t in) { return in + 1; }, dispenso::kStageNoLimit),
+      dispenso::orderedStage([&seen](size_t in) -> TestOptional<size_t> {
+        seen.push_back(in);
+        if (in % 10 == 0) {
+          return {};
+        }
+        return in;
+      }),
+      dispenso::stage([](size_t in) { return in * 3; }, dispenso::kStageNoLimit),
+      dispenso::orderedStage([&results](size_t in) { results.push_back(in); }, 2));
+
+  ASSERT_EQ(seen.size(), kNumInputs);
+  for (size_t i = 0; i < kNumInputs; ++i) {
+    EXPECT_EQ(seen[i], i + 1);
+  }
+  std::vector<size_t> expected;
+  for (size_t i = 1; i <= kNumInputs; ++i) {
+    if (i % 10) {
+      expected.push_back(i * 3);
+    }
+  }
+  EXPECT_EQ(results, expected);
+}
+
+TEST(Pipeline, OrderedMoveOnlyZeroSizeThreadPool) {
+  dispenso::ThreadPool pool(0);
+  std::vector<size_t> results;
+  size_t counter = 0;
+
+  dispenso::pipeline(
+      pool,
+      [&counter]() -> TestOptional<std::unique_ptr<size_t>> {
+        if (counter < 100) {
+          return std::make_unique<size_t>(counter++);
+        }
+        return {};
+      },
+      dispenso::orderedStage([](std::unique_ptr<size_t> val) {
+        *val += 1;
+        return val;
+      }),
+      dispenso::orderedStage([&results](std::unique_ptr<size_t> val) { results.push_back(*val); }));
+
+  ASSERT_EQ(results.size(), 100);
+  for (size_t i = 0; i < 100; ++i) {
+    EXPECT_EQ(results[i], i + 1);
+  }
+}
+
+TEST(Pipeline, BatchedStages) {
+  constexpr size_t kNumInputs = 10007;
+  dispenso::ThreadPool pool(4);
+  std::atomic<size_t> sum(0);
+  std::atomic<size_t> numBatches(0);
+  size_t counter = 0;
+
+  dispenso::pipeline(
+      pool,
+      dispenso::batchGenerator([&counter]() { return countTo(counter, kNumInputs); }, 64),
+      dispenso::stage(
+          dispenso::batched([](size_t in) { return in * 2; }), dispenso::kStageNoLimit),
+      dispenso::stage(
+          dispenso::batched([](size_t in) { return static_cast<double>(in); }), 2),
+      [&sum, &numBatches](std::vector<double> batch) {
+        EXPECT_LE(batch.size(), 64);
+        numBatches.fetch_add(1, std::memory_order_relaxed);
+        for (double d : batch) {
+          sum.fetch_add(static_cast<size_t>(d), std::memory_order_relaxed);
+        }
+      });
+
+  EXPECT_EQ(sum.load(), kNumInputs * (kNumInputs - 1));
+  EXPECT_EQ(numBatches.load(), (kNumInputs + 63) / 64);
+}
+
+TEST(Pipeline, BatchedFilteringOrdered) {
+  constexpr size_t kNumInputs = 5000;
+  dispenso::ThreadPool pool(6);
+  std::vector<size_t> results;
+  size_t counter = 0;
+
+  dispenso::pipeline(
+      pool,
+      dispenso::batchGenerator([&counter]() { return countTo(counter, kNumInputs); }, 10),
+      dispenso::stage(
+          dispenso::batched([](size_t in) -> TestOptional<size_t> {
+            // Every input of some batches is filtered out.
+            if (in % 3 == 0 || (in / 10) % 7 == 0) {
+              return {};
+            }
+            return in;
+          }),
+          dispenso::kStageNoLimit),
+      dispenso::orderedStage(
+          dispenso::batched([&results](size_t in) { results.push_back(in); })));
+
+  std::vector<size_t> expected;
+  for (size_t i = 0; i < kNumInputs; ++i) {
+    if (i % 3 != 0 && (i / 10) % 7 != 0) {
+      expected.push_back(i);
+    }
+  }
+  EXPECT_EQ(results, expected);
+}
+
+TEST(Pipeline, BatchedTimeBound) {
+  dispenso::ThreadPool pool(2);
+  std::vector<size_t> batchSizes;
+  size_t counter = 0;
+
+  dispenso::pipeline(
+      pool,
+      dispenso::batchGenerator(
+          [&counter]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            return countTo(counter, 20);
+          },
+          1000,
+          0.001),
+      [&batchSizes](std::vector<size_t> batch) { batchSizes.push_back(batch.size()); });
+
+  // Each item takes longer to generate than the time bound, so can share a batch with at most one
+  // other.
+  size_t total = 0;
+  for (size_t s : batchSizes) {
+    EXPECT_LE(s, 2);
+    total += s;
+  }
+  EXPECT_EQ(total, 20);
+}
+
+TEST(Pipeline, MaxInFlight) {
+  constexpr size_t kNumInputs = 2000;
+  constexpr size_t kMaxInFlight = 8;
+  dispenso::ThreadPool pool(6);
+  std::atomic<size_t> inFlight(0);
+  std::atomic<size_t> peak(0);
+  std::atomic<size_t> counter(0);
+  std::atomic<size_t> sum(0);
+
+  dispenso::PipelineOptions options;
+  options.maxInFlight = kMaxInFlight;
+  dispenso::pipeline(
+      pool,
+      options,
+      dispenso::stage(
+          [&]() -> TestOptional<size_t> {
+            size_t cur = counter.fetch_add(1, std::memory_order_relaxed);
+            if (cur >= kNumInputs) {
+              return {};
+            }
+            size_t now = inFlight.fetch_add(1, std::memory_order_acq_rel) + 1;
+            size_t prev = peak.load(std::memory_order_relaxed);
+            while (now > prev && !peak.compare_exchange_weak(prev, now)) {
+            }
+            return cur;
+          },
+          2),
+      dispenso::stage(
+          [&inFlight](size_t in) -> TestOptional<size_t> {
+            if (in % 5 == 0) {
+              inFlight.fetch_sub(1, std::memory_order_acq_rel);
+              return {};
+            }
+            return in;
+          },
+          dispenso::kStageNoLimit),
+      [&](size_t in) {
+        // The generator runs far ahead of this slow, serial sink unless held back.
+        std::this_thread::sleep_for(std::chrono::microseconds(20));
+        sum.fetch_add(in, std::memory_order_relaxed);
+        inFlight.fetch_sub(1, std::memory_order_acq_rel);
+      });
+
+  size_t expected = 0;
+  for (size_t i = 0; i < kNumInputs; ++i) {
+    if (i % 5) {
+      expected += i;
+    }
+  }
+  EXPECT_EQ(sum.load(), expected);
+  EXPECT_LE(peak.load(), kMaxInFlight);
+}
+
+TEST(Pipeline, MaxInFlightOrdered) {
+  constexpr size_t kNumInputs = 1000;
+  dispenso::ThreadPool pool(4);
+  std::vector<size_t> results;
+  size_t counter = 0;
+
+  dispenso::PipelineOptions options;
+  options.maxInFlight = 3;
+  dispenso::pipeline(
+      pool,
+      options,
+      [&counter]() { return countTo(counter, kNumInputs); },
+      dispenso::stage([](size_t in) { return in + 1; }, dispenso::kStageNoLimit),
+      dispenso::orderedStage([&results](size_t in) { results.push_back(in); }));
+
+  ASSERT_EQ(results.size(), kNumInputs);
+  for (size_t i = 0; i < kNumInputs; ++i) {
+    EXPECT_EQ(results[i], i + 1);
+  }
+}
+
+TEST(Pipeline, StageCapacity) {
+  constexpr size_t kNumInputs = 1000;
+  constexpr size_t kCapacity = 4;
+  dispenso::ThreadPool pool(4);
+  std::atomic<size_t> generated(0);
+  std::atomic<size_t> consumed(0);
+  std::atomic<size_t> maxBacklog(0);
+  size_t counter = 0;
+
+  dispenso::pipeline(
+      pool,
+      [&]() {
+        auto result = countTo(counter, kNumInputs);
+        if (result) {
+          size_t backlog = generated.fetch_add(1) + 1 - consumed.load();
+          if (backlog > maxBacklog.load()) {
+            maxBacklog.store(backlog);
+          }
+        }
+        return result;
+      },
+      dispenso::stage(
+          [&consumed](size_t) {
+            std::this_thread::sleep_for(std::chrono::microseconds(20));
+            consumed.fetch_add(1);
+          },
+          1,
+          kCapacity));
+
+  EXPECT_EQ(consumed.load(), kNumInputs);
+  // The generator is serial and waits while the sink holds kCapacity items, so at most one more is
+  // generated.
+  EXPECT_LE(maxBacklog.load(), kCapacity + 1);
+}
+
+TEST(Pipeline, MaxInFlightZeroSizeThreadPool) {
+  dispenso::ThreadPool pool(0);
+  size_t counter = 0;
+  size_t sum = 0;
+  dispenso::PipelineOptions options;
+  options.maxInFlight = 1;
+  dispenso::pipeline(
+      pool,
+      options,
+      [&counter]() { return countTo(counter, 10); },
+      [](size_t in) { return in * 2; },
+      [&sum](size_t in) { sum += in; });
+  EXPECT_EQ(sum, 90);
+}
+
+TEST(Pipeline, AsyncPipelines) {
+  constexpr size_t kNumInputs = 3000;
+  dispenso::ThreadPool pool(4);
+  dispenso::ConcurrentTaskSet tasks(pool);
+  size_t counterA = 0;
+  size_t counterB = 0;
+  std::atomic<size_t> sumA(0);
+  std::vector<size_t> resultsB;
+
+  dispenso::Future<void> a = dispenso::asyncPipeline(
+      tasks,
+      [&counterA]() { return countTo(counterA, kNumInputs); },
+      dispenso::stage([](size_t in) { return in * 2; }, dispenso::kStageNoLimit),
+      dispenso::stage(
+          [&sumA](size_t in) { sumA.fetch_add(in, std::memory_order_relaxed); },
+          dispenso::kStageNoLimit));
+
+  dispenso::PipelineOptions options;
+  options.maxInFlight = 16;
+  dispenso::Future<void> b = dispenso::asyncPipeline(
+      tasks,
+      options,
+      [&counterB]() { return countTo(counterB, kNumInputs); },
+      dispenso::stage([](size_t in) { return in + 1; }, dispenso::kStageNoLimit),
+      dispenso::orderedStage([&resultsB](size_t in) { resultsB.push_back(in); }));
+
+  a.get();
+  EXPECT_EQ(sumA.load(), kNumInputs * (kNumInputs - 1));
+  b.get();
+  ASSERT_EQ(resultsB.size(), kNumInputs);
+  for (size_t i = 0; i < kNumInputs; ++i) {
+    EXPECT_EQ(resultsB[i], i + 1);
+  }
+}
+
+TEST(Pipeline, AsyncPipelineWaitOnTaskSet) {
+  dispenso::ThreadPool pool(3);
+  std::atomic<size_t> sum(0);
+  size_t counter = 0;
+  {
+    dispenso::ConcurrentTaskSet tasks(pool);
+    dispenso::asyncPipeline(
+        tasks,
+        [&counter]() { return countTo(counter, 1000); },
+        [](size_t in) -> TestOptional<size_t> {
+          if (in & 1) {
+            return {};
+          }
+          return in;
+        },
+        [&sum](size_t in) { sum.fetch_add(in, std::memory_order_relaxed); });
+    tasks.wait();
+    EXPECT_EQ(sum.load(), 249500);
+  }
+}
+
+TEST(Pipeline, AsyncSingleStage) {
+  dispenso::ThreadPool pool(2);
+  dispenso::ConcurrentTaskSet tasks(pool);
+  std::atomic<size_t> count(0);
+  auto done = dispenso::asyncPipeline(
+      tasks,
+      dispenso::stage(
+          [&count]() { return count.fetch_add(1, std::memory_order_relaxed) < 100; },
+          dispenso::kStageNoLimit));
+  done.wait();
+  EXPECT_GE(count.load(), 101);
+}
+
+TEST(Pipeline, AsyncZeroSizeThreadPool) {
+  dispenso::ThreadPool pool(0);
+  dispenso::ConcurrentTaskSet tasks(pool);
+  size_t counter = 0;
+  size_t sum = 0;
+  auto done = dispenso::asyncPipeline(
+      tasks,
+      [&counter]() { return countTo(counter, 10); },
+      dispenso::orderedStage([](size_t in) { return in * 2; }),
+      [&sum](size_t in) { sum += in; });
+  done.get();
+  EXPECT_EQ(sum, 90);
+}
+
+TEST(Pipeline, AutoStages) {
+  dispenso::ThreadPool pool(4);
+  std::atomic<size_t> sum(0);
+  size_t counter = 0;
+  dispenso::pipeline(
+      pool,
+      [&counter]() { return countTo(counter, 10000); },
+      dispenso::stage([](size_t in) { return in * 2; }, dispenso::kStageAuto),
+      dispenso::stage(
+          [](size_t in) -> TestOptional<size_t> {
+            if (in % 3 == 0) {
+              return {};
+            }
+            return in;
+          },
+          dispenso::kStageAuto),
+      dispenso::stage(
+          [&sum](size_t in) { sum.fetch_add(in, std::memory_order_relaxed); },
+          dispenso::kStageAuto));
+
+  size_t expected = 0;
+  for (size_t i = 0; i < 10000; ++i) {
+    if ((i * 2) % 3) {
+      expected += i * 2;
+    }
+  }
+  EXPECT_EQ(sum.load(), expected);
+}
+
+TEST(Pipeline, AutoStagesFavorSlowStage) {
+  // Sleeping items leave the threads free to run the fast stage, so the slow stage should be
+  // given most of the budget once the tuner has seen some items.
+  dispenso::ThreadPool pool(4);
+  std::atomic<int> running(0);
+  std::atomic<int> maxRunning(0);
+  size_t counter = 0;
+  dispenso::pipeline(
+      pool,
+      [&counter]() { return countTo(counter, 2000); },
+      dispenso::stage([](size_t in) { return in + 1; }, dispenso::kStageAuto),
+      dispenso::stage(
+          [&running, &maxRunning](size_t in) {
+            int now = running.fetch_add(1, std::memory_order_acq_rel) + 1;
+            int prev = maxRunning.load(std::memory_order_relaxed);
+            while (now > prev && !maxRunning.compare_exchange_weak(prev, now)) {
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            running.fetch_sub(1, std::memory_order_acq_rel);
+            return in;
+          },
+          dispenso::kStageAuto),
+      [](size_t) {});
+  EXPECT_GE(maxRunning.load(), 3);
+}
+
+TEST(Pipeline, AsyncAutoStagesZeroSizeThreadPool) {
+  dispenso::ThreadPool pool(0);
+  dispenso::ConcurrentTaskSet tasks(pool);
+  size_t counter = 0;
+  size_t sum = 0;
+  auto done = dispenso::asyncPipeline(
+      tasks,
+      [&counter]() { return countTo(counter, 10); },
+      dispenso::stage([](size_t in) { return in * 2; }, dispenso::kStageAuto),
+      dispenso::stage([&sum](size_t in) { sum += in; }, dispenso::kStageAuto));
+  done.get();
+  EXPECT_EQ(sum, 90);
+}
+
+TEST(Pipeline, FanOutJoin) {
+  dispenso::ThreadPool pool(4);
+  std::atomic<size_t> sum(0);
+  size_t counter = 0;
+  dispenso::pipeline(
+      pool,
+      [&counter]() { return countTo(counter, 1000); },
+      dispenso::fanOut(
+          dispenso::stage([](const size_t& in) { return in * in; }, dispenso::kStageNoLimit),
+          dispenso::stage([](const size_t& in) { return in + 1; }, 2),
+          [](const size_t& in) { return in % 2 == 0; })
+          .join([](size_t in, size_t square, size_t next, bool even) {
+            EXPECT_EQ(square, in * in);
+            EXPECT_EQ(next, in + 1);
+            EXPECT_EQ(even, in % 2 == 0);
+            return square + next;
+          }),
+      [&sum](size_t in) { sum.fetch_add(in, std::memory_order_relaxed); });
+
+  size_t expected = 0;
+  for (size_t i = 0; i < 1000; ++i) {
+    expected += i * i + i + 1;
+  }
+  EXPECT_EQ(sum.load(), expected);
+}
+
+TEST(Pipeline, FanOutSharesItem) {
+  // Branches see the very item the merge later gets, so move-only items work without copies.
+  dispenso::ThreadPool pool(4);
+  std::atomic<size_t> sum(0);
+  std::atomic<size_t> mismatches(0);
+  size_t counter = 0;
+  dispenso::pipeline(
+      pool,
+      [&counter]() -> TestOptional<std::unique_ptr<size_t>> {
+        if (counter < 500) {
+          return std::make_unique<size_t>(counter++);
+        }
+        return {};
+      },
+      dispenso::fanOut(
+          dispenso::stage(
+              [](const std::unique_ptr<size_t>& in) { return in.get(); }, dispenso::kStageNoLimit),
+          dispenso::stage(
+              [](const std::unique_ptr<size_t>& in) { return in.get(); }, dispenso::kStageNoLimit))
+          .join([&mismatches](std::unique_ptr<size_t> in, size_t* seenA, size_t* seenB) {
+            if (seenA != in.get() || seenB != in.get()) {
+              mismatches.fetch_add(1, std::memory_order_relaxed);
+            }
+            return in;
+          }),
+      [&sum](std::unique_ptr<size_t> in) { sum.fetch_add(*in, std::memory_order_relaxed); });
+
+  EXPECT_EQ(mismatches.load(), 0u);
+  EXPECT_EQ(sum.load(), 499u * 500u / 2);
+}
+
+TEST(Pipeline, FanOutFilterAndSink) {
+  dispenso::ThreadPool pool(3);
+  std::atomic<size_t> sum(0);
+  std::atomic<size_t> sinkSum(0);
+  size_t counter = 0;
+  dispenso::pipeline(
+      pool,
+      [&counter]() { return countTo(counter, 1000); },
+      dispenso::fanOut([](const size_t& in) { return in * 2; }, [](const size_t& in) {
+        return in % 3 == 0;
+      }).join([](size_t /*in*/, size_t twice, bool keep) -> TestOptional<size_t> {
+          if (!keep) {
+            return {};
+          }
+          return twice;
+        }),
+      dispenso::fanOut(dispenso::stage(
+                           [&sum](const size_t& in) {
+                             sum.fetch_add(in, std::memory_order_relaxed);
+                             return in;
+                           },
+                           dispenso::kStageNoLimit))
+          .join([&sinkSum](size_t in, size_t) { sinkSum.fetch_add(in, std::memory_order_relaxed); }));
+
+  size_t expected = 0;
+  for (size_t i = 0; i < 1000; i += 3) {
+    expected += i * 2;
+  }
+  EXPECT_EQ(sum.load(), expected);
+  EXPECT_EQ(sinkSum.load(), expected);
+}
+
+TEST(Pipeline, FanOutCapacityBoundsJoins) {
+  constexpr size_t kCapacity = 8;
+  dispenso::ThreadPool pool(4);
+  std::atomic<size_t> merged(0);
+  std::atomic<bool> overflowed(false);
+  size_t generated = 0;
+  dispenso::pipeline(
+      pool,
+      [&generated, &merged, &overflowed]() -> TestOptional<size_t> {
+        if (generated - merged.load(std::memory_order_acquire) > kCapacity) {
+          overflowed.store(true, std::memory_order_relaxed);
+        }
+        if (generated < 2000) {
+          return generated++;
+        }
+        return {};
+      },
+      dispenso::fanOut(
+          dispenso::stage([](const size_t& in) { return in; }, dispenso::kStageNoLimit),
+          dispenso::stage([](const size_t& in) { return in; }, dispenso::kStageNoLimit))
+          .join(
+              [&merged](size_t in, size_t, size_t) {
+                merged.fetch_add(1, std::memory_order_release);
+                return in;
+              },
+              kCapacity),
+      [](size_t) {});
+  EXPECT_FALSE(overflowed.load());
+  EXPECT_EQ(merged.load(), 2000u);
+}
+
+TEST(Pipeline, FanOutZeroSizeThreadPool) {
+  dispenso::ThreadPool pool(0);
+  size_t counter = 0;
+  size_t sum = 0;
+  dispenso::pipeline(
+      pool,
+      [&counter]() { return countTo(counter, 10); },
+      dispenso::fanOut([](const size_t& in) { return in * 2; }, [](const size_t& in) {
+        return in * 3;
+      }).join([](size_t, size_t twice, size_t thrice) { return twice + thrice; }),
+      [&sum](size_t in) { sum += in; });
+  EXPECT_EQ(sum, 225u);
+}
@@ -7,7 +7,12 @@
 
 #include <dispenso/pool_allocator.h>
 
+#include <atomic>
 #include <deque>
+#include <map>
+#include <set>
+#include <thread>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -115,3 +120,287 @@ TEST(PoolAllocator, SimpleThreaded) {
     t.join();
   }
 }
+
+TEST(PoolAllocator, BatchAllocDealloc) {
+  dispenso::PoolAllocator allocator(64, 256, ::malloc, ::free);
+
+  char* bufs[10];
+  allocator.allocBatch(bufs, 10);
+  std::set<char*> unique(bufs, bufs + 10);
+  EXPECT_EQ(unique.size(), 10);
+  allocator.deallocBatch(bufs, 10);
+
+  // The freed chunks are reused before any new slab is allocated.
+  char* again[10];
+  allocator.allocBatch(again, 10);
+  for (char* buf : again) {
+    EXPECT_EQ(unique.count(buf), 1);
+  }
+  allocator.deallocBatch(again, 10);
+}
+
+TEST(CachingPoolAllocator, SimpleThreaded) {
+  constexpr size_t kNumThreads = 8;
+
+  size_t slabs = 0;
+  {
+    dispenso::CachingPoolAllocator allocator(
+        64,
+        4096,
+        [&slabs](size_t len) {
+          ++slabs;
+          return ::malloc(len);
+        },
+        [&slabs](void* ptr) {
+          --slabs;
+          ::free(ptr);
+        });
+
+    std::deque<std::thread> threads;
+
+    for (size_t i = 0; i < kNumThreads; ++i) {
+      threads.emplace_back([&allocator, tid = i]() {
+        constexpr size_t kNumBufs = 100;
+        char* bufs[kNumBufs];
+
+        for (size_t i = 0; i < 1000; ++i) {
+          for (size_t j = 0; j < kNumBufs; ++j) {
+            bufs[j] = allocator.alloc();
+            *bufs[j] = static_cast<char>(tid);
+          }
+          for (size_t j = 0; j < kNumBufs; ++j) {
+            EXPECT_EQ(*bufs[j], tid);
+            allocator.dealloc(bufs[j]);
+          }
+        }
+      });
+    }
+
+    for (auto& t : threads) {
+      t.join();
+    }
+  }
+  EXPECT_EQ(slabs, 0);
+}
+
+TEST(CachingPoolAllocator, DeallocOnOtherThread) {
+  dispenso::CachingPoolAllocator allocator(64, 4096, ::malloc, ::free);
+  constexpr size_t kNumBufs = 1000;
+  std::vector<char*> bufs(kNumBufs);
+
+  for (int round = 0; round < 10; ++round) {
+    std::thread producer([&]() {
+      for (size_t i = 0; i < kNumBufs; ++i) {
+        bufs[i] = allocator.alloc();
+        *bufs[i] = static_cast<char>(i);
+      }
+    });
+    producer.join();
+    std::set<char*> unique(bufs.begin(), bufs.end());
+    EXPECT_EQ(unique.size(), kNumBufs);
+    std::thread consumer([&]() {
+      for (size_t i = 0; i < kNumBufs; ++i) {
+        EXPECT_EQ(*bufs[i], static_cast<char>(i));
+        allocator.dealloc(bufs[i]);
+      }
+    });
+    consumer.join();
+  }
+}
+
+TEST(PoolAllocator, Trim) {
+  size_t live = 0;
+  auto allocFunc = [&live](size_t len) {
+    ++live;
+    return ::malloc(len);
+  };
+  auto deallocFunc = [&live](void* ptr) {
+    --live;
+    ::free(ptr);
+  };
+  {
+    dispenso::PoolAllocator allocator(64, 256, allocFunc, deallocFunc);
+    std::vector<char*> bufs(100);
+    for (char*& buf : bufs) {
+      buf = allocator.alloc();
+    }
+    EXPECT_EQ(live, 25);
+    EXPECT_EQ(allocator.trim(), 0);
+
+    // Keep one chunk, so its slab must survive.
+    for (size_t i = 1; i < bufs.size(); ++i) {
+      allocator.dealloc(bufs[i]);
+    }
+    EXPECT_EQ(allocator.trim(), 24 * 256);
+    EXPECT_EQ(live, 1);
+
+    *bufs[0] = 'a';
+    for (size_t i = 1; i < bufs.size(); ++i) {
+      bufs[i] = allocator.alloc();
+      *bufs[i] = 'b';
+    }
+    EXPECT_EQ(*bufs[0], 'a');
+    EXPECT_EQ(live, 25);
+    for (char* buf : bufs) {
+      allocator.dealloc(buf);
+    }
+    EXPECT_EQ(allocator.trim(), 25 * 256);
+    EXPECT_EQ(live, 0);
+  }
+  EXPECT_EQ(live, 0);
+}
+
+TEST(CachingPoolAllocator, Trim) {
+  std::atomic<size_t> live(0);
+  dispenso::CachingPoolAllocator allocator(
+      64,
+      4096,
+      [&live](size_t len) {
+        live.fetch_add(1);
+        return ::malloc(len);
+      },
+      [&live](void* ptr) {
+        live.fetch_sub(1);
+        ::free(ptr);
+      });
+
+  std::deque<std::thread> threads;
+  for (size_t t = 0; t < 4; ++t) {
+    threads.emplace_back([&allocator]() {
+      std::vector<char*> bufs(10000);
+      for (char*& buf : bufs) {
+        buf = allocator.alloc();
+      }
+      for (char* buf : bufs) {
+        allocator.dealloc(buf);
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  size_t slabs = live.load();
+  EXPECT_GT(slabs, 0);
+  // Every chunk is free, including those cached in magazines, so every slab goes.
+  EXPECT_EQ(allocator.trim(), slabs * 4096);
+  EXPECT_EQ(live.load(), 0);
+}
+
+TEST(PoolAllocator, Stats) {
+  dispenso::PoolAllocator allocator(64, 256, ::malloc, ::free);
+  dispenso::PoolAllocatorStats stats = allocator.stats();
+  EXPECT_EQ(stats.bytesReserved, 0);
+  EXPECT_EQ(stats.bytesInUse, 0);
+
+  std::vector<char*> bufs(10);
+  for (char*& buf : bufs) {
+    buf = allocator.alloc();
+  }
+  stats = allocator.stats();
+  EXPECT_EQ(stats.bytesReserved, 3 * 256);
+  EXPECT_EQ(stats.bytesInUse, 10 * 64);
+  EXPECT_EQ(stats.bytesFree, 2 * 64);
+  EXPECT_EQ(stats.bytesCached, 0);
+
+  for (size_t i = 0; i < 5; ++i) {
+    allocator.dealloc(bufs[i]);
+  }
+  stats = allocator.stats();
+  EXPECT_EQ(stats.bytesInUse, 5 * 64);
+  EXPECT_EQ(stats.peakBytesInUse, 10 * 64);
+  EXPECT_EQ(stats.bytesFree, 7 * 64);
+  for (size_t i = 5; i < bufs.size(); ++i) {
+    allocator.dealloc(bufs[i]);
+  }
+  allocator.trim();
+  stats = allocator.stats();
+  EXPECT_EQ(stats.bytesReserved, 0);
+  EXPECT_EQ(stats.peakBytesReserved, 3 * 256);
+  EXPECT_EQ(stats.peakBytesInUse, 10 * 64);
+}
+
+TEST(CachingPoolAllocator, Stats) {
+  dispenso::CachingPoolAllocator allocator(64, 4096, ::malloc, ::free);
+  std::vector<char*> bufs(1000);
+  for (char*& buf : bufs) {
+    buf = allocator.alloc();
+  }
+  dispenso::PoolAllocatorStats stats = allocator.stats();
+  EXPECT_GE(stats.bytesInUse, 1000 * 64);
+  EXPECT_EQ(stats.bytesInUse + stats.bytesCached + stats.bytesFree, stats.bytesReserved);
+
+  for (char* buf : bufs) {
+    allocator.dealloc(buf);
+  }
+  stats = allocator.stats();
+  EXPECT_EQ(stats.bytesInUse, 0);
+  EXPECT_GT(stats.bytesCached, 0);
+  EXPECT_EQ(stats.bytesCached + stats.bytesFree, stats.bytesReserved);
+  EXPECT_GE(stats.peakBytesInUse, 1000 * 64);
+}
+
+TEST(PoolAllocator, ConcurrentWithTrim) {
+  std::atomic<size_t> live(0);
+  {
+    dispenso::PoolAllocator allocator(
+        64,
+        1024,
+        [&live](size_t len) {
+          live.fetch_add(1);
+          return ::malloc(len);
+        },
+        [&live](void* ptr) {
+          live.fetch_sub(1);
+          ::free(ptr);
+        });
+
+    std::atomic<bool> done(false);
+    std::thread trimmer([&]() {
+      while (!done.load()) {
+        allocator.trim();
+        std::this_thread::yield();
+      }
+    });
+
+    std::deque<std::thread> threads;
+    for (size_t t = 0; t < 4; ++t) {
+      threads.emplace_back([&allocator, t]() {
+        std::vector<char*> bufs(200);
+        for (size_t i = 0; i < 200; ++i) {
+          if (i % 2) {
+            allocator.allocBatch(bufs.data(), bufs.size());
+          } else {
+            for (char*& buf : bufs) {
+              buf = allocator.alloc();
+            }
+          }
+          for (char* buf : bufs) {
+            *buf = static_cast<char>(t);
+          }
+          for (char* buf : bufs) {
+            EXPECT_EQ(*buf, static_cast<char>(t));
+          }
+          if (i % 3) {
+            allocator.deallocBatch(bufs.data(), bufs.size());
+          } else {
+            for (char* buf : bufs) {
+              allocator.dealloc(buf);
+            }
+          }
+        }
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    done.store(true);
+    trimmer.join();
+
+    dispenso::PoolAllocatorStats stats = allocator.stats();
+    EXPECT_EQ(stats.bytesInUse, 0);
+    EXPECT_EQ(stats.bytesFree, stats.bytesReserved);
+    EXPECT_EQ(allocator.trim(), stats.bytesReserved);
+    EXPECT_EQ(live.load(), 0);
+  }
+  EXPECT_EQ(live.load(), 0);
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/rcu.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+struct Table {
+  Table(int v, std::atomic<int>& live) : value(v), live(live) {
+    live.fetch_add(1);
+  }
+  ~Table() {
+    // Poison the value so that use after destruction is likely to be noticed.
+    value = -1;
+    live.fetch_sub(1);
+  }
+  int value;
+  std::atomic<int>& live;
+};
+} // namespace
+
+TEST(RcuPtr, ReadAndUpdate) {
+  std::atomic<int> live(0);
+  {
+    dispenso::RcuPtr<Table> ptr(std::make_unique<Table>(1, live));
+    {
+      auto guard = ptr.read();
+      ASSERT_TRUE(guard);
+      EXPECT_EQ(guard->value, 1);
+
+      ptr.update(std::make_unique<Table>(2, live));
+      // The old version stays alive while it is being read.
+      EXPECT_EQ(guard->value, 1);
+      EXPECT_EQ(ptr.read()->value, 2);
+      EXPECT_EQ(live.load(), 2);
+    }
+    dispenso::rcuSynchronize();
+    EXPECT_EQ(live.load(), 1);
+
+    ptr.update(nullptr);
+    EXPECT_FALSE(ptr.read());
+    dispenso::rcuSynchronize();
+    EXPECT_EQ(live.load(), 0);
+  }
+  EXPECT_EQ(live.load(), 0);
+}
+
+TEST(RcuPtr, NestedReads) {
+  std::atomic<int> live(0);
+  dispenso::RcuPtr<Table> a(std::make_unique<Table>(1, live));
+  dispenso::RcuPtr<Table> b(std::make_unique<Table>(2, live));
+  {
+    auto ga = a.read();
+    {
+      auto gb = b.read();
+      EXPECT_EQ(ga->value + gb->value, 3);
+    }
+    a.update(std::make_unique<Table>(3, live));
+    EXPECT_EQ(ga->value, 1);
+  }
+  dispenso::rcuSynchronize();
+  EXPECT_EQ(live.load(), 2);
+}
+
+TEST(RcuPtr, ConcurrentReadersAndWriter) {
+  std::atomic<int> live(0);
+  {
+    dispenso::RcuPtr<Table> ptr(std::make_unique<Table>(0, live));
+    std::atomic<bool> done(false);
+    std::atomic<int> bad(0);
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 3; ++t) {
+      readers.emplace_back([&]() {
+        while (!done.load(std::memory_order_acquire)) {
+          auto guard = ptr.read();
+          int v = guard->value;
+          std::this_thread::yield();
+          if (guard->value != v || v < 0) {
+            bad.fetch_add(1);
+          }
+        }
+      });
+    }
+    for (int i = 1; i <= 2000; ++i) {
+      ptr.update(std::make_unique<Table>(i, live));
+    }
+    done.store(true, std::memory_order_release);
+    for (auto& r : readers) {
+      r.join();
+    }
+    EXPECT_EQ(bad.load(), 0);
+    dispenso::rcuSynchronize();
+    EXPECT_EQ(live.load(), 1);
+    EXPECT_EQ(ptr.read()->value, 2000);
+  }
+  EXPECT_EQ(live.load(), 0);
+}
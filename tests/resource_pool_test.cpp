@@ -7,7 +7,13 @@
 
 #include <gtest/gtest.h>
 
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
 #include <dispenso/resource_pool.h>
+#include <dispenso/task_set.h>
 #include <dispenso/thread_pool.h>
 
 namespace {
@@ -26,14 +32,15 @@ struct Buffer {
   int count;
 };
 
-void BuffersTest(const int num_threads, const int num_buffers) {
+void BuffersTest(const int num_threads, const int num_buffers, size_t thread_cache_size = 0) {
   constexpr int kNumTasks = 100000;
   std::atomic_int total_count(0);
   std::atomic_int num_buffers_created(0);
   {
-    dispenso::ResourcePool<Buffer> buffer_pool(num_buffers, [&total_count, &num_buffers_created]() {
-      return Buffer(total_count, num_buffers_created);
-    });
+    dispenso::ResourcePool<Buffer> buffer_pool(
+        num_buffers,
+        [&total_count, &num_buffers_created]() { return Buffer(total_count, num_buffers_created); },
+        thread_cache_size);
     dispenso::ThreadPool thread_pool(num_threads);
     for (int i = 0; i < kNumTasks; ++i) {
       thread_pool.schedule([&]() {
@@ -67,3 +74,185 @@ TEST(ResourcePool, MoreBuffersThanThreadsTest) {
   constexpr int kNumThreads = 1;
   BuffersTest(kNumBuffers, kNumThreads);
 }
+
+TEST(ResourcePool, ThreadCacheFewerBuffersThanThreadsTest) {
+  BuffersTest(4, 1, 1);
+}
+
+TEST(ResourcePool, ThreadCacheMoreBuffersThanThreadsTest) {
+  BuffersTest(2, 8, 4);
+}
+
+TEST(ResourcePool, TryAcquire) {
+  dispenso::ResourcePool<int> pool(1, []() { return 5; }, 1);
+  {
+    auto res = pool.tryAcquire();
+    ASSERT_TRUE(res.valid());
+    EXPECT_EQ(res.get(), 5);
+    EXPECT_FALSE(pool.tryAcquire().valid());
+  }
+  // The released resource is cached for this thread, but other threads can still take it.
+  std::thread t([&pool]() { EXPECT_TRUE(pool.tryAcquire().valid()); });
+  t.join();
+  EXPECT_TRUE(pool.tryAcquire().valid());
+}
+
+TEST(ResourcePool, AcquireFor) {
+  dispenso::ResourcePool<int> pool(1, []() { return 5; });
+  auto res = pool.acquireFor(std::chrono::milliseconds(1));
+  ASSERT_TRUE(res.valid());
+  EXPECT_FALSE(pool.acquireFor(std::chrono::milliseconds(1)).valid());
+
+  std::thread t([&pool]() {
+    auto other = pool.acquireFor(std::chrono::seconds(30));
+    EXPECT_TRUE(other.valid());
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  res = pool.tryAcquire();
+  t.join();
+}
+
+TEST(ResourcePool, CachedResourceWakesWaiter) {
+  dispenso::ResourcePool<int> pool(1, []() { return 0; }, 1);
+  for (int i = 0; i < 1000; ++i) {
+    auto res = pool.acquire();
+    std::thread t([&pool]() { ++pool.acquire().get(); });
+    res = pool.tryAcquire();
+    t.join();
+  }
+  EXPECT_EQ(pool.acquire().get(), 1000);
+}
+
+TEST(ResourcePool, LazyGrowsOnDemand) {
+  std::atomic<int> created(0);
+  dispenso::ResourcePoolOptions options;
+  options.lazy = true;
+  dispenso::ResourcePool<int> pool(
+      3, [&created]() { return created.fetch_add(1); }, options);
+  EXPECT_EQ(created.load(), 0);
+  EXPECT_EQ(pool.numLive(), 0);
+  {
+    auto a = pool.acquire();
+    EXPECT_EQ(created.load(), 1);
+  }
+  {
+    // The released resource is reused rather than creating another.
+    auto a = pool.acquire();
+    auto b = pool.acquire();
+    auto c = pool.tryAcquire();
+    EXPECT_TRUE(c.valid());
+    EXPECT_EQ(created.load(), 3);
+    EXPECT_FALSE(pool.tryAcquire().valid());
+    EXPECT_FALSE(pool.acquireFor(std::chrono::milliseconds(1)).valid());
+  }
+  EXPECT_EQ(pool.numLive(), 3);
+}
+
+TEST(ResourcePool, LazyEvictsIdle) {
+  std::atomic<int> live(0);
+  struct Counted {
+    explicit Counted(std::atomic<int>& l) : live(&l) {
+      ++*live;
+    }
+    Counted(Counted&& other) : live(other.live) {
+      other.live = nullptr;
+    }
+    ~Counted() {
+      if (live) {
+        --*live;
+      }
+    }
+    std::atomic<int>* live;
+  };
+  dispenso::ResourcePoolOptions options;
+  options.lazy = true;
+  options.idleTimeout = std::chrono::milliseconds(20);
+  {
+    dispenso::ResourcePool<Counted> pool(4, [&live]() { return Counted(live); }, options);
+    {
+      auto a = pool.acquire();
+      auto b = pool.acquire();
+    }
+    EXPECT_EQ(live.load(), 2);
+    EXPECT_EQ(pool.evictIdle(), 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    EXPECT_EQ(pool.evictIdle(), 2);
+    EXPECT_EQ(live.load(), 0);
+    EXPECT_EQ(pool.numLive(), 0);
+
+    // Resources are recreated when demand returns, and eviction also happens on release.
+    {
+      auto a = pool.acquire();
+      auto b = pool.acquire();
+      EXPECT_EQ(live.load(), 2);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    pool.acquire();
+    EXPECT_EQ(live.load(), 1);
+  }
+  EXPECT_EQ(live.load(), 0);
+}
+
+TEST(ResourcePool, LazyThreaded) {
+  constexpr int kNumTasks = 100000;
+  std::atomic<int> created(0);
+  std::atomic<int> total(0);
+  dispenso::ResourcePoolOptions options;
+  options.lazy = true;
+  options.threadCacheSize = 1;
+  options.idleTimeout = std::chrono::milliseconds(1);
+  {
+    dispenso::ResourcePool<int> pool(
+        2,
+        [&created]() {
+          ++created;
+          return 0;
+        },
+        options);
+    dispenso::ThreadPool threadPool(4);
+    dispenso::TaskSet tasks(threadPool);
+    for (int i = 0; i < kNumTasks; ++i) {
+      tasks.schedule([&]() {
+        auto res = pool.acquire();
+        ++res.get();
+        ++total;
+      });
+    }
+    tasks.wait();
+    EXPECT_LE(pool.numLive(), 2);
+  }
+  EXPECT_EQ(total.load(), kNumTasks);
+  EXPECT_GE(created.load(), 1);
+}
+
+TEST(ResourcePool, MoveOnlyInit) {
+  auto value = std::make_unique<int>(7);
+  auto init = [value = std::move(value)]() { return *value; };
+  dispenso::ResourcePool<int> pool(2, init);
+  EXPECT_EQ(pool.acquire().get(), 7);
+  dispenso::ResourcePool<int> cached(2, init, 1);
+  EXPECT_EQ(cached.acquire().get(), 7);
+}
+
+#if defined(__cpp_exceptions)
+TEST(ResourcePool, LazyInitThrows) {
+  bool fail = true;
+  dispenso::ResourcePoolOptions options;
+  options.lazy = true;
+  dispenso::ResourcePool<int> pool(
+      1,
+      [&fail]() {
+        if (fail) {
+          throw std::runtime_error("init failed");
+        }
+        return 3;
+      },
+      options);
+  EXPECT_THROW(pool.acquire(), std::runtime_error);
+  EXPECT_EQ(pool.numLive(), 0u);
+  // The failed creation gave its slot back.
+  fail = false;
+  EXPECT_EQ(pool.acquire().get(), 3);
+  EXPECT_EQ(pool.numLive(), 1u);
+}
+#endif // __cpp_exceptions
@@ -7,6 +7,7 @@
 
 #include <dispenso/rw_lock.h>
 
+#include <atomic>
 #include <chrono>
 #include <mutex>
 #include <shared_mutex>
@@ -122,3 +123,85 @@ TEST(RWLock, TestAlignment) {
       alignof(dispenso::UnalignedRWLock) < dispenso::kCacheLineSize,
       "UnalignedRWLock is overaligned");
 }
+
+TEST(DistributedRWLock, TryLock) {
+  dispenso::DistributedRWLock mtx;
+  EXPECT_TRUE(mtx.try_lock_shared());
+  EXPECT_FALSE(mtx.try_lock());
+  EXPECT_TRUE(mtx.try_lock_shared());
+  mtx.unlock_shared();
+  mtx.unlock_shared();
+  EXPECT_TRUE(mtx.try_lock());
+  EXPECT_FALSE(mtx.try_lock());
+  EXPECT_FALSE(mtx.try_lock_shared());
+  mtx.unlock();
+
+  mtx.lock_shared();
+  mtx.lock_upgrade();
+  EXPECT_FALSE(mtx.try_lock_shared());
+  mtx.lock_downgrade();
+  EXPECT_TRUE(mtx.try_lock_shared());
+  mtx.unlock_shared();
+  mtx.unlock_shared();
+  EXPECT_TRUE(mtx.try_lock());
+  mtx.unlock();
+}
+
+TEST(DistributedRWLock, BasicWriterTest) {
+  int count = 0;
+  dispenso::DistributedRWLock mtx;
+  constexpr int kPerThreadTotal = 100000;
+
+  auto toRun = [&]() {
+    for (int i = 0; i < kPerThreadTotal; ++i) {
+      std::unique_lock<dispenso::DistributedRWLock> lk(mtx);
+      ++count;
+    }
+  };
+
+  std::thread thread0(toRun);
+  std::thread thread1(toRun);
+
+  thread0.join();
+  thread1.join();
+
+  EXPECT_EQ(count, 2 * kPerThreadTotal);
+}
+
+TEST(DistributedRWLock, ReaderWriterTest) {
+  // Two counters only ever updated together, so readers must always see them equal.
+  int64_t a = 0;
+  int64_t b = 0;
+  dispenso::DistributedRWLock mtx;
+  constexpr int kWriterTotal = 1000;
+  constexpr int kReaderTotal = 100000;
+
+  auto toRunWriter = [&]() {
+    for (int i = 0; i < kWriterTotal; ++i) {
+      std::unique_lock<dispenso::DistributedRWLock> lk(mtx);
+      ++a;
+      ++b;
+    }
+  };
+
+  std::atomic<int> mismatches(0);
+  auto toRunReader = [&]() {
+    for (int i = 0; i < kReaderTotal; ++i) {
+      std::shared_lock<dispenso::DistributedRWLock> lk(mtx);
+      if (a != b) {
+        mismatches.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+  };
+
+  std::thread writer(toRunWriter);
+  std::thread reader0(toRunReader);
+  std::thread reader1(toRunReader);
+
+  writer.join();
+  reader0.join();
+  reader1.join();
+
+  EXPECT_EQ(a, kWriterTotal);
+  EXPECT_EQ(mismatches.load(), 0);
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/semaphore.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+TEST(Semaphore, TryAcquire) {
+  dispenso::Semaphore sem(2);
+  EXPECT_TRUE(sem.tryAcquire());
+  EXPECT_TRUE(sem.tryAcquire());
+  EXPECT_FALSE(sem.tryAcquire());
+  sem.release(3);
+  EXPECT_EQ(sem.available(), 3);
+  sem.acquire();
+  EXPECT_EQ(sem.available(), 2);
+}
+
+TEST(Semaphore, TryAcquireFor) {
+  dispenso::Semaphore sem;
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_FALSE(sem.tryAcquireFor(std::chrono::milliseconds(20)));
+  EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(20));
+
+  std::thread releaser([&sem]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    sem.release();
+  });
+  EXPECT_TRUE(sem.tryAcquireFor(std::chrono::seconds(10)));
+  releaser.join();
+  EXPECT_EQ(sem.available(), 0);
+}
+
+TEST(Semaphore, ReleaseManyWakesMany) {
+  constexpr int kThreads = 8;
+  dispenso::Semaphore sem;
+  std::atomic<int> acquired(0);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreads; ++i) {
+    threads.emplace_back([&]() {
+      sem.acquire();
+      acquired.fetch_add(1, std::memory_order_relaxed);
+    });
+  }
+  // Give the threads a chance to fall asleep.
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  sem.release(kThreads);
+  for (auto& t : threads) {
+    t.join();
+  }
+  EXPECT_EQ(acquired.load(), kThreads);
+  EXPECT_EQ(sem.available(), 0);
+}
+
+TEST(Semaphore, BoundsConcurrency) {
+  constexpr int kThreads = 8;
+  constexpr int kPermits = 3;
+  constexpr int kIters = 2000;
+  dispenso::Semaphore sem(kPermits);
+  std::atomic<int> inside(0);
+  std::atomic<int> maxInside(0);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreads; ++i) {
+    threads.emplace_back([&]() {
+      for (int j = 0; j < kIters; ++j) {
+        sem.acquire();
+        int now = inside.fetch_add(1, std::memory_order_relaxed) + 1;
+        int prev = maxInside.load(std::memory_order_relaxed);
+        while (now > prev && !maxInside.compare_exchange_weak(prev, now)) {
+        }
+        inside.fetch_sub(1, std::memory_order_relaxed);
+        sem.release();
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  EXPECT_LE(maxInside.load(), kPermits);
+  EXPECT_EQ(sem.available(), kPermits);
+}
+
+TEST(Semaphore, ProducerConsumer) {
+  constexpr int kItems = 100000;
+  dispenso::Semaphore items;
+  int64_t consumed = 0;
+  std::thread consumer([&]() {
+    for (int i = 0; i < kItems; ++i) {
+      items.acquire();
+      ++consumed;
+    }
+  });
+  for (int i = 0; i < kItems; ++i) {
+    items.release();
+  }
+  consumer.join();
+  EXPECT_EQ(consumed, kItems);
+  EXPECT_EQ(items.available(), 0);
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/seq_lock.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+// Every field is always the same value, so a torn read is easy to detect.
+struct Route {
+  int64_t values[9];
+};
+
+Route makeRoute(int64_t v) {
+  Route r;
+  for (auto& value : r.values) {
+    value = v;
+  }
+  return r;
+}
+} // namespace
+
+TEST(SeqLock, LoadStore) {
+  dispenso::SeqLock<int> lock(3);
+  EXPECT_EQ(lock.load(), 3);
+  lock.store(5);
+  EXPECT_EQ(lock.load(), 5);
+  lock.update([](int& v) { v *= 2; });
+  EXPECT_EQ(lock.load(), 10);
+}
+
+TEST(SeqLock, OddSize) {
+  struct Small {
+    char c[3];
+  };
+  dispenso::SeqLock<Small> lock(Small{{'a', 'b', 'c'}});
+  Small s = lock.load();
+  EXPECT_EQ(s.c[0], 'a');
+  EXPECT_EQ(s.c[2], 'c');
+}
+
+TEST(SeqLock, ConcurrentReadersNeverTear) {
+  dispenso::SeqLock<Route> lock(makeRoute(0));
+  constexpr int64_t kNumWrites = 20000;
+  std::atomic<bool> done(false);
+  std::atomic<int> torn(0);
+
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 3; ++t) {
+    readers.emplace_back([&]() {
+      int64_t last = 0;
+      while (!done.load(std::memory_order_acquire)) {
+        Route r = lock.load();
+        for (int64_t v : r.values) {
+          if (v != r.values[0]) {
+            torn.fetch_add(1, std::memory_order_relaxed);
+          }
+        }
+        // Values only grow, so a reader never sees an older value after a newer one.
+        EXPECT_GE(r.values[0], last);
+        last = r.values[0];
+      }
+    });
+  }
+
+  std::vector<std::thread> writers;
+  for (int t = 0; t < 2; ++t) {
+    writers.emplace_back([&]() {
+      for (int64_t i = 0; i < kNumWrites; ++i) {
+        lock.update([](Route& r) {
+          for (auto& v : r.values) {
+            ++v;
+          }
+        });
+      }
+    });
+  }
+  for (auto& w : writers) {
+    w.join();
+  }
+  done.store(true, std::memory_order_release);
+  for (auto& r : readers) {
+    r.join();
+  }
+  EXPECT_EQ(torn.load(), 0);
+  EXPECT_EQ(lock.load().values[8], 2 * kNumWrites);
+}
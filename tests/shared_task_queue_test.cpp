@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/shared_task_queue.h>
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/wait.h>
+#include <unistd.h>
+#endif // __linux__
+
+#include <gtest/gtest.h>
+
+namespace {
+std::string queuePath() {
+  std::string path = ::testing::TempDir() + "dispenso_shared_task_queue_" +
+      ::testing::UnitTest::GetInstance()->current_test_info()->name();
+  dispenso::SharedTaskQueue::remove(path);
+  return path;
+}
+
+struct Args {
+  int64_t value;
+  int32_t weight;
+};
+
+std::atomic<int64_t> gSum(0);
+
+void addWeighted(const void* args, size_t size) {
+  EXPECT_EQ(size, sizeof(Args));
+  const Args* a = static_cast<const Args*>(args);
+  gSum.fetch_add(a->value * a->weight, std::memory_order_relaxed);
+}
+} // namespace
+
+TEST(SharedTaskQueue, PushPop) {
+  std::string path = queuePath();
+  dispenso::SharedTaskQueue queue(path, 6);
+  ASSERT_TRUE(queue.valid());
+  EXPECT_EQ(queue.capacity(), 8u);
+
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_TRUE(queue.tryPush(static_cast<uint32_t>(i), Args{i, 2}));
+  }
+  EXPECT_FALSE(queue.tryPush(8, Args{8, 2}));
+  EXPECT_EQ(queue.approxSize(), 8u);
+
+  dispenso::SharedTask task;
+  for (int i = 0; i < 8; ++i) {
+    ASSERT_TRUE(queue.tryPop(task));
+    EXPECT_EQ(task.functionId, static_cast<uint32_t>(i));
+    EXPECT_EQ(task.argsSize, sizeof(Args));
+    EXPECT_EQ(reinterpret_cast<const Args*>(task.args)->value, i);
+  }
+  EXPECT_FALSE(queue.tryPop(task));
+  EXPECT_EQ(queue.approxSize(), 0u);
+
+  EXPECT_TRUE(dispenso::SharedTaskQueue::remove(path));
+}
+
+TEST(SharedTaskQueue, OpenExisting) {
+  std::string path = queuePath();
+  dispenso::SharedTaskQueue creator(path, 16);
+  dispenso::SharedTaskQueue opener(path, 1024);
+  ASSERT_TRUE(creator.valid());
+  ASSERT_TRUE(opener.valid());
+  EXPECT_EQ(opener.capacity(), 16u);
+
+  EXPECT_TRUE(creator.tryPush(3, nullptr, 0));
+  dispenso::SharedTask task;
+  ASSERT_TRUE(opener.tryPop(task));
+  EXPECT_EQ(task.functionId, 3u);
+  EXPECT_EQ(task.argsSize, 0u);
+  EXPECT_FALSE(creator.tryPop(task));
+
+  dispenso::SharedTaskQueue::remove(path);
+}
+
+TEST(SharedTaskQueue, RejectsForeignFile) {
+  std::string path = queuePath();
+  FILE* file = fopen(path.c_str(), "wb");
+  ASSERT_NE(file, nullptr);
+  fputs("not a queue", file);
+  fclose(file);
+  dispenso::SharedTaskQueue queue(path);
+  EXPECT_FALSE(queue.valid());
+  dispenso::SharedTaskQueue::remove(path);
+}
+
+TEST(SharedTaskQueue, PopForTimeout) {
+  std::string path = queuePath();
+  dispenso::SharedTaskQueue queue(path);
+  dispenso::SharedTask task;
+  EXPECT_FALSE(queue.popFor(task, std::chrono::milliseconds(5)));
+
+  std::thread producer([&path]() {
+    dispenso::SharedTaskQueue other(path);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    EXPECT_TRUE(other.tryPush(1, Args{5, 1}));
+  });
+  EXPECT_TRUE(queue.popFor(task, std::chrono::seconds(30)));
+  EXPECT_EQ(task.functionId, 1u);
+  producer.join();
+  dispenso::SharedTaskQueue::remove(path);
+}
+
+TEST(SharedTaskQueue, ConcurrentHandles) {
+  constexpr int kProducers = 4;
+  constexpr int kConsumers = 4;
+  constexpr int kPerProducer = 20000;
+  std::string path = queuePath();
+  dispenso::SharedTaskQueue init(path, 256);
+  ASSERT_TRUE(init.valid());
+
+  // Each thread maps the queue separately, as a separate process would.
+  std::atomic<int64_t> sum(0);
+  std::atomic<int> popped(0);
+  std::vector<std::thread> threads;
+  for (int p = 0; p < kProducers; ++p) {
+    threads.emplace_back([&path, p]() {
+      dispenso::SharedTaskQueue queue(path);
+      for (int i = 0; i < kPerProducer; ++i) {
+        while (!queue.tryPush(0, Args{p * kPerProducer + i, 1})) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (int c = 0; c < kConsumers; ++c) {
+    threads.emplace_back([&path, &sum, &popped]() {
+      dispenso::SharedTaskQueue queue(path);
+      dispenso::SharedTask task;
+      while (popped.load(std::memory_order_relaxed) < kProducers * kPerProducer) {
+        if (queue.popFor(task, std::chrono::milliseconds(1))) {
+          sum.fetch_add(reinterpret_cast<const Args*>(task.args)->value);
+          popped.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  constexpr int64_t kTotal = kProducers * kPerProducer;
+  EXPECT_EQ(popped.load(), kTotal);
+  EXPECT_EQ(sum.load(), kTotal * (kTotal - 1) / 2);
+  dispenso::SharedTaskQueue::remove(path);
+}
+
+TEST(SharedTaskWorker, RunsRegisteredTasks) {
+  std::string path = queuePath();
+  dispenso::SharedTaskQueue queue(path);
+  dispenso::SharedTaskRegistry registry;
+  registry.add(2, &addWeighted);
+  EXPECT_EQ(registry.find(1), nullptr);
+
+  gSum.store(0);
+  dispenso::ThreadPool pool(2);
+  {
+    dispenso::SharedTaskWorker worker(queue, registry, pool, 2);
+    for (int i = 0; i < 1000; ++i) {
+      while (!queue.tryPush(2, Args{i, 3})) {
+        std::this_thread::yield();
+      }
+    }
+    EXPECT_TRUE(queue.tryPush(7, Args{1, 1}));
+    while (worker.numExecuted() + worker.numDropped() < 1001) {
+      std::this_thread::yield();
+    }
+    EXPECT_EQ(worker.numExecuted(), 1000u);
+    EXPECT_EQ(worker.numDropped(), 1u);
+  }
+  EXPECT_EQ(gSum.load(), 3 * 1000 * 999 / 2);
+  dispenso::SharedTaskQueue::remove(path);
+}
+
+TEST(SharedTaskWorker, ZeroThreadPool) {
+  std::string path = queuePath();
+  dispenso::SharedTaskQueue queue(path);
+  dispenso::SharedTaskRegistry registry;
+  dispenso::ThreadPool pool(0);
+  EXPECT_TRUE(queue.tryPush(0, nullptr, 0));
+  {
+    dispenso::SharedTaskWorker worker(queue, registry, pool);
+    EXPECT_EQ(worker.numExecuted() + worker.numDropped(), 0u);
+  }
+  EXPECT_EQ(queue.approxSize(), 1u);
+  dispenso::SharedTaskQueue::remove(path);
+}
+
+#if defined(__linux__)
+TEST(SharedTaskWorker, CrossProcess) {
+  std::string path = queuePath();
+  dispenso::SharedTaskQueue queue(path);
+  ASSERT_TRUE(queue.valid());
+  dispenso::SharedTaskRegistry registry;
+  registry.add(0, &addWeighted);
+  gSum.store(0);
+
+  constexpr int kTasks = 5000;
+  pid_t child = fork();
+  ASSERT_GE(child, 0);
+  if (child == 0) {
+    // Only the forking thread exists in the child, so it sticks to the queue.
+    dispenso::SharedTaskQueue childQueue(path);
+    for (int i = 0; i < kTasks && childQueue.valid(); ++i) {
+      while (!childQueue.tryPush(0, Args{i, 1})) {
+        std::this_thread::yield();
+      }
+    }
+    _exit(childQueue.valid() ? 0 : 1);
+  }
+
+  dispenso::ThreadPool pool(2);
+  int status = 0;
+  {
+    // The child may fill the queue, so the worker drains while we wait for it.
+    dispenso::SharedTaskWorker worker(queue, registry, pool);
+    ASSERT_EQ(waitpid(child, &status, 0), child);
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(WEXITSTATUS(status), 0);
+    while (worker.numExecuted() < static_cast<size_t>(kTasks)) {
+      std::this_thread::yield();
+    }
+  }
+  EXPECT_EQ(gSum.load(), int64_t{kTasks} * (kTasks - 1) / 2);
+  dispenso::SharedTaskQueue::remove(path);
+}
+#endif // __linux__
@@ -215,3 +215,59 @@ TEST(SmallBufferAllocator, ThreadsHandoffMedium) {
 TEST(SmallBufferAllocator, ThreadsHandoffLarge) {
   testThreadsHandoff<kLarge>();
 }
+
+TEST(SmallBufferAllocator, Trim) {
+  constexpr size_t kSize = 64;
+  std::vector<char*> buffers(kSimpleNumBuffers);
+  for (char*& b : buffers) {
+    b = allocSmallBuffer<kSize>();
+  }
+  size_t peak = approxBytesAllocatedSmallBuffer<kSize>();
+  for (char* b : buffers) {
+    deallocSmallBuffer<kSize>(b);
+  }
+  size_t released = dispenso::trimSmallBuffer<kSize>();
+  EXPECT_GE(released, peak / 2);
+  EXPECT_EQ(approxBytesAllocatedSmallBuffer<kSize>(), peak - released);
+
+  // The pool keeps working after being trimmed.
+  for (char*& b : buffers) {
+    b = allocSmallBuffer<kSize>();
+    *b = 'a';
+  }
+  for (char* b : buffers) {
+    EXPECT_EQ(*b, 'a');
+    deallocSmallBuffer<kSize>(b);
+  }
+  dispenso::trimSmallBufferAllocators();
+  EXPECT_LT(approxBytesAllocatedSmallBuffer<kSize>(), peak);
+}
+
+TEST(SmallBufferAllocator, Stats) {
+  constexpr size_t kSize = 128;
+  std::vector<char*> buffers(kSimpleNumBuffers);
+  for (char*& b : buffers) {
+    b = allocSmallBuffer<kSize>();
+  }
+  dispenso::SmallBufferStats stats = dispenso::smallBufferStats<kSize>();
+  EXPECT_EQ(stats.chunkSize, kSize);
+  EXPECT_EQ(stats.bytesReserved, approxBytesAllocatedSmallBuffer<kSize>());
+  EXPECT_GE(stats.peakBytesReserved, stats.bytesReserved);
+  EXPECT_GE(stats.bytesHeldByThreads, kSimpleNumBuffers * kSize);
+  EXPECT_EQ(stats.bytesInCentralStore + stats.bytesHeldByThreads, stats.bytesReserved);
+  EXPECT_GE(stats.numThreadCaches, 1u);
+  EXPECT_GT(stats.maxBytesPerThreadCache, 0u);
+
+  for (char* b : buffers) {
+    deallocSmallBuffer<kSize>(b);
+  }
+  dispenso::SmallBufferStats after = dispenso::smallBufferStats<kSize>();
+  EXPECT_LE(after.bytesHeldByThreads, after.maxBytesPerThreadCache * after.numThreadCaches);
+  EXPECT_GE(after.peakBytesReserved, stats.peakBytesReserved);
+
+  auto all = dispenso::smallBufferAllocatorStats();
+  ASSERT_FALSE(all.empty());
+  EXPECT_EQ(all.front().chunkSize, 8u);
+  EXPECT_EQ(all.back().chunkSize, dispenso::kMaxSmallBufferSize);
+  EXPECT_EQ(all[4].chunkSize, kSize);
+}
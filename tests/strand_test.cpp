@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/strand.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <dispenso/future.h>
+#include <gtest/gtest.h>
+
+TEST(Strand, RunsInOrder) {
+  dispenso::ThreadPool pool(4);
+  std::vector<int> order;
+  {
+    dispenso::Strand strand(pool);
+    for (int i = 0; i < 10000; ++i) {
+      // Unsynchronized on purpose: the strand runs one functor at a time.
+      strand.schedule([&order, i]() { order.push_back(i); });
+    }
+  }
+  ASSERT_EQ(order.size(), 10000u);
+  for (int i = 0; i < 10000; ++i) {
+    EXPECT_EQ(order[static_cast<size_t>(i)], i);
+  }
+}
+
+TEST(Strand, ManyProducersNeverOverlap) {
+  constexpr int kProducers = 4;
+  constexpr int kPerProducer = 5000;
+  dispenso::ThreadPool pool(4);
+  std::atomic<int> running(0);
+  std::atomic<bool> overlapped(false);
+  std::vector<std::vector<int>> seen(kProducers);
+  {
+    dispenso::Strand strand(pool, 8);
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; ++p) {
+      producers.emplace_back([&, p]() {
+        for (int i = 0; i < kPerProducer; ++i) {
+          strand.schedule([&, p, i]() {
+            if (running.fetch_add(1) != 0) {
+              overlapped.store(true);
+            }
+            seen[static_cast<size_t>(p)].push_back(i);
+            running.fetch_sub(1);
+          });
+        }
+      });
+    }
+    for (auto& t : producers) {
+      t.join();
+    }
+  }
+  EXPECT_FALSE(overlapped.load());
+  // Each producer's functors run in the order that producer scheduled them.
+  for (auto& s : seen) {
+    ASSERT_EQ(s.size(), static_cast<size_t>(kPerProducer));
+    for (int i = 0; i < kPerProducer; ++i) {
+      EXPECT_EQ(s[static_cast<size_t>(i)], i);
+    }
+  }
+}
+
+TEST(Strand, YieldsBetweenTurns) {
+  // With one pool thread, a task scheduled to the pool behind the first drain gets to run before
+  // the strand finishes, since each drain runs at most maxPerTurn functors.
+  dispenso::ThreadPool pool(1);
+  std::atomic<bool> release(false);
+  pool.schedule(
+      [&release]() {
+        while (!release.load()) {
+          std::this_thread::yield();
+        }
+      },
+      dispenso::ForceQueuingTag());
+  std::atomic<int> ran(0);
+  std::atomic<int> ranWhenOther(-1);
+  {
+    dispenso::Strand strand(pool, 4);
+    for (int i = 0; i < 100; ++i) {
+      strand.schedule([&ran]() { ran.fetch_add(1); }, dispenso::ForceQueuingTag());
+    }
+    pool.schedule([&]() { ranWhenOther.store(ran.load()); }, dispenso::ForceQueuingTag());
+    release.store(true);
+  }
+  EXPECT_EQ(ran.load(), 100);
+  EXPECT_GE(ranWhenOther.load(), 4);
+  EXPECT_LT(ranWhenOther.load(), 100);
+}
+
+TEST(Strand, ScheduleFromStrand) {
+  dispenso::ThreadPool pool(2);
+  std::vector<int> order;
+  {
+    dispenso::Strand strand(pool);
+    strand.schedule([&]() {
+      order.push_back(0);
+      strand.schedule([&]() { order.push_back(2); });
+      order.push_back(1);
+    });
+  }
+  EXPECT_EQ(order, std::vector<int>({0, 1, 2}));
+}
+
+TEST(Strand, NoThreads) {
+  dispenso::ThreadPool pool(0);
+  dispenso::Strand strand(pool, 2);
+  int count = 0;
+  for (int i = 0; i < 10; ++i) {
+    strand.schedule([&count]() { ++count; });
+  }
+  EXPECT_EQ(count, 10);
+  EXPECT_EQ(strand.numPending(), 0u);
+}
+
+TEST(Strand, FutureThen) {
+  dispenso::ThreadPool pool(3);
+  dispenso::Strand strand(pool);
+  int state = 0;
+  std::atomic<int> done(0);
+  std::vector<dispenso::Future<void>> futures;
+  for (int i = 0; i < 100; ++i) {
+    futures.push_back(dispenso::async(pool, [i]() { return i; })
+                          .then(
+                              [&state, &done](dispenso::Future<int>&& f) {
+                                // Continuations on the strand update shared state without locks.
+                                state += f.get();
+                                done.fetch_add(1, std::memory_order_release);
+                              },
+                              strand));
+  }
+  // Waiting on the futures themselves could run continuations here, off the strand.
+  while (done.load(std::memory_order_acquire) < 100) {
+    std::this_thread::yield();
+  }
+  EXPECT_EQ(state, 99 * 100 / 2);
+}
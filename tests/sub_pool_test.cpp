@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/sub_pool.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <dispenso/parallel_for.h>
+#include <dispenso/task_set.h>
+
+#include <gtest/gtest.h>
+
+TEST(SubPool, RunsAllWork) {
+  dispenso::ThreadPool pool(4);
+  std::atomic<int> count(0);
+  {
+    dispenso::SubPool sub(pool, 1, 2);
+    EXPECT_EQ(sub.reservedConcurrency(), 1);
+    EXPECT_EQ(sub.maxConcurrency(), 2);
+    for (int i = 0; i < 1000; ++i) {
+      sub.schedule([&count]() { count.fetch_add(1, std::memory_order_relaxed); });
+    }
+    sub.scheduleBulk(1000, [&count](size_t) {
+      return [&count]() { count.fetch_add(1, std::memory_order_relaxed); };
+    });
+  }
+  EXPECT_EQ(count.load(), 2000);
+}
+
+TEST(SubPool, BoundsConcurrency) {
+  constexpr int kTasks = 200;
+  dispenso::ThreadPool pool(8);
+  dispenso::SubPool sub(pool, 0, 2);
+  std::atomic<int> inside(0);
+  std::atomic<int> maxInside(0);
+  std::atomic<int> done(0);
+  for (int i = 0; i < kTasks; ++i) {
+    sub.schedule([&]() {
+      int now = inside.fetch_add(1, std::memory_order_relaxed) + 1;
+      int prev = maxInside.load(std::memory_order_relaxed);
+      while (now > prev && !maxInside.compare_exchange_weak(prev, now)) {
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+      inside.fetch_sub(1, std::memory_order_relaxed);
+      done.fetch_add(1, std::memory_order_release);
+    });
+  }
+  // Poll rather than help, so that only pool threads run the work.
+  while (done.load(std::memory_order_acquire) < kTasks) {
+    EXPECT_LE(sub.numActive(), 2);
+    std::this_thread::yield();
+  }
+  EXPECT_LE(maxInside.load(), 2);
+  EXPECT_GE(maxInside.load(), 1);
+}
+
+TEST(SubPool, SharedPoolTenants) {
+  dispenso::ThreadPool pool(4);
+  dispenso::SubPool a(pool, 3, 4);
+  dispenso::SubPool b(pool, 1, 4);
+  std::atomic<int> countA(0);
+  std::atomic<int> countB(0);
+  dispenso::ConcurrentTaskSet tasksA(a);
+  dispenso::ConcurrentTaskSet tasksB(b);
+  EXPECT_EQ(tasksA.subPool(), &a);
+  for (int i = 0; i < 500; ++i) {
+    tasksA.schedule([&countA]() { countA.fetch_add(1, std::memory_order_relaxed); });
+    tasksB.schedule([&countB]() { countB.fetch_add(1, std::memory_order_relaxed); });
+  }
+  tasksA.wait();
+  tasksB.wait();
+  EXPECT_EQ(countA.load(), 500);
+  EXPECT_EQ(countB.load(), 500);
+}
+
+TEST(SubPool, NestedWaitsDoNotDeadlock) {
+  dispenso::ThreadPool pool(4);
+  // With a single thread of concurrency, nested waits can only complete if waiters help.
+  dispenso::SubPool sub(pool, 1, 1);
+  std::atomic<int> count(0);
+  dispenso::TaskSet outer(sub);
+  for (int i = 0; i < 8; ++i) {
+    outer.schedule([&sub, &count]() {
+      dispenso::TaskSet inner(sub);
+      for (int j = 0; j < 8; ++j) {
+        inner.schedule([&count]() { count.fetch_add(1, std::memory_order_relaxed); });
+      }
+      inner.wait();
+    });
+  }
+  outer.wait();
+  EXPECT_EQ(count.load(), 64);
+}
+
+TEST(SubPool, ParallelFor) {
+  dispenso::ThreadPool pool(4);
+  dispenso::SubPool sub(pool, 2, 2);
+  std::vector<int> values(10000, 0);
+  dispenso::TaskSet tasks(sub);
+  dispenso::parallel_for(tasks, 0, 10000, [&values](int i) { values[i] = i; });
+  for (int i = 0; i < 10000; ++i) {
+    EXPECT_EQ(values[i], i);
+  }
+}
+
+TEST(SubPool, NoPoolThreads) {
+  dispenso::ThreadPool pool(0);
+  dispenso::SubPool sub(pool, 0, 1);
+  int count = 0;
+  for (int i = 0; i < 100; ++i) {
+    sub.schedule([&count]() { ++count; });
+  }
+  EXPECT_EQ(count, 100);
+}
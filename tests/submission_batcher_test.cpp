@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/submission_batcher.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+TEST(SubmissionBatcher, FlushOnCount) {
+  dispenso::ThreadPool pool(2);
+  std::atomic<int> count(0);
+  {
+    dispenso::SubmissionBatcher<> batcher(pool, 4, std::chrono::seconds(100));
+    for (int i = 0; i < 3; ++i) {
+      batcher.schedule([&count]() { count.fetch_add(1, std::memory_order_relaxed); });
+    }
+    EXPECT_EQ(batcher.numBuffered(), 3u);
+    batcher.schedule([&count]() { count.fetch_add(1, std::memory_order_relaxed); });
+    EXPECT_EQ(batcher.numBuffered(), 0u);
+    batcher.schedule([&count]() { count.fetch_add(1, std::memory_order_relaxed); });
+    EXPECT_EQ(batcher.numBuffered(), 1u);
+  }
+  // Destruction flushed the last functor.
+  while (count.load(std::memory_order_relaxed) < 5) {
+    std::this_thread::yield();
+  }
+}
+
+TEST(SubmissionBatcher, FlushOnDelay) {
+  dispenso::ThreadPool pool(1);
+  dispenso::TaskSet tasks(pool);
+  dispenso::SubmissionBatcher<dispenso::TaskSet> batcher(tasks, 1000, std::chrono::milliseconds(1));
+  std::atomic<int> count(0);
+  batcher.schedule([&count]() { count.fetch_add(1, std::memory_order_relaxed); });
+  EXPECT_EQ(batcher.numBuffered(), 1u);
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  batcher.schedule([&count]() { count.fetch_add(1, std::memory_order_relaxed); });
+  EXPECT_EQ(batcher.numBuffered(), 0u);
+  batcher.wait();
+  EXPECT_EQ(count.load(), 2);
+}
+
+TEST(SubmissionBatcher, TaskSetWait) {
+  dispenso::ThreadPool pool(4);
+  dispenso::ConcurrentTaskSet tasks(pool);
+  dispenso::SubmissionBatcher<dispenso::ConcurrentTaskSet> batcher(tasks, 16);
+  std::vector<int> values(1000, 0);
+  for (size_t i = 0; i < values.size(); ++i) {
+    batcher.schedule([&values, i]() { values[i] = static_cast<int>(i); });
+  }
+  batcher.wait();
+  EXPECT_EQ(batcher.numBuffered(), 0u);
+  for (size_t i = 0; i < values.size(); ++i) {
+    EXPECT_EQ(values[i], static_cast<int>(i));
+  }
+}
+
+TEST(SubmissionBatcher, AsyncBeforeFlush) {
+  dispenso::ThreadPool pool(2);
+  dispenso::SubmissionBatcher<> batcher(pool, 100, std::chrono::seconds(100));
+  auto a = batcher.async([]() { return 3; });
+  auto b = batcher.async([](int x, int y) { return x * y; }, 4, 5);
+  auto c = batcher.async(std::launch::async, []() { return 6; });
+  EXPECT_EQ(batcher.numBuffered(), 3u);
+  // Waiting on a buffered future runs it here.
+  EXPECT_EQ(b.get(), 20);
+  batcher.flush();
+  EXPECT_EQ(a.get(), 3);
+  EXPECT_EQ(c.get(), 6);
+}
+
+TEST(SubmissionBatcher, OtherThreadsBypass) {
+  dispenso::ThreadPool pool(2);
+  dispenso::SubmissionBatcher<> batcher(pool, 100, std::chrono::seconds(100));
+  std::atomic<int> count(0);
+  std::thread other([&batcher, &count]() {
+    batcher.schedule([&count]() { count.fetch_add(1, std::memory_order_relaxed); });
+  });
+  other.join();
+  EXPECT_EQ(batcher.numBuffered(), 0u);
+
+  // Continuations are scheduled by whichever thread completes the future.
+  dispenso::Future<int> start([]() { return 1; }, pool, std::launch::async);
+  auto next = start.then([](dispenso::Future<int>&& f) { return f.get() + 1; }, batcher);
+  batcher.flush();
+  EXPECT_EQ(next.get(), 2);
+  while (count.load(std::memory_order_relaxed) < 1) {
+    std::this_thread::yield();
+  }
+}
+
+TEST(SubmissionBatcher, ReentrantInline) {
+  // With no pool threads, flushed functors run inline, and may submit again.
+  dispenso::ThreadPool pool(0);
+  dispenso::SubmissionBatcher<> batcher(pool, 2);
+  int count = 0;
+  for (int i = 0; i < 10; ++i) {
+    batcher.schedule([&batcher, &count]() {
+      ++count;
+      batcher.schedule([&count]() { ++count; });
+    });
+  }
+  batcher.flush();
+  EXPECT_EQ(batcher.numBuffered(), 0u);
+  EXPECT_EQ(count, 20);
+}
@@ -5,6 +5,10 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
 #include <dispenso/task_set.h>
 
 #include <gtest/gtest.h>
@@ -217,6 +221,85 @@ TEST(TaskSet, Recursive) {
   recursiveFunc(pool, 20);
 }
 
+TEST(TaskSet, RecursiveWorkStealing) {
+  dispenso::ThreadPool pool(10);
+  pool.setWorkStealing(true);
+  recursiveFunc(pool, 20);
+}
+
+TEST(TaskSet, Priority) {
+  dispenso::ThreadPool pool(4);
+  for (auto p :
+       {dispenso::TaskPriority::kHigh,
+        dispenso::TaskPriority::kNormal,
+        dispenso::TaskPriority::kLow}) {
+    std::atomic<int> value(0);
+    dispenso::TaskSet tasks(pool, p);
+    EXPECT_EQ(tasks.priority(), p);
+    for (int i = 0; i < 1000; ++i) {
+      tasks.schedule([&value]() { ++value; });
+      tasks.schedule([&value]() { ++value; }, dispenso::ForceQueuingTag());
+    }
+    tasks.wait();
+    EXPECT_EQ(value.load(), 2000);
+  }
+}
+
+TEST(ConcurrentTaskSet, Priority) {
+  dispenso::ThreadPool pool(4);
+  for (auto p :
+       {dispenso::TaskPriority::kHigh,
+        dispenso::TaskPriority::kNormal,
+        dispenso::TaskPriority::kLow}) {
+    std::atomic<int> value(0);
+    dispenso::ConcurrentTaskSet tasks(pool, p);
+    EXPECT_EQ(tasks.priority(), p);
+    for (int i = 0; i < 1000; ++i) {
+      tasks.schedule([&value]() { ++value; });
+      tasks.schedule([&value]() { ++value; }, dispenso::ForceQueuingTag());
+    }
+    tasks.wait();
+    EXPECT_EQ(value.load(), 2000);
+  }
+}
+
+template <typename TaskSetT>
+void checkBulk() {
+  dispenso::ThreadPool pool(4);
+  for (auto p :
+       {dispenso::TaskPriority::kHigh,
+        dispenso::TaskPriority::kNormal,
+        dispenso::TaskPriority::kLow}) {
+    std::vector<int> values(1000, 0);
+    TaskSetT tasks(pool, p);
+    // The generator is called once per index, in order, on this thread.
+    size_t nextIndex = 0;
+    auto gen = [&](size_t i) {
+      EXPECT_EQ(i, nextIndex++);
+      return [&values, i]() { ++values[i]; };
+    };
+    tasks.scheduleBulk(500, gen);
+    nextIndex = 0;
+    tasks.scheduleBulk(
+        500,
+        [&](size_t i) {
+          EXPECT_EQ(i, nextIndex++);
+          return [&values, i]() { ++values[i + 500]; };
+        },
+        dispenso::ForceQueuingTag());
+    tasks.wait();
+    EXPECT_EQ(std::count(values.begin(), values.end(), 1), 1000);
+  }
+}
+
+TEST(TaskSet, ScheduleBulk) {
+  checkBulk<dispenso::TaskSet>();
+}
+
+TEST(ConcurrentTaskSet, ScheduleBulk) {
+  checkBulk<dispenso::ConcurrentTaskSet>();
+}
+
 struct Node {
   int val;
   std::unique_ptr<Node> left, right;
@@ -248,6 +331,16 @@ TEST(ConcurrentTaskSet, DoTree) {
   verifyTree(root, 20);
 }
 
+TEST(ConcurrentTaskSet, DoTreeWorkStealing) {
+  std::unique_ptr<Node> root;
+  dispenso::ThreadPool pool(10);
+  pool.setWorkStealing(true);
+  dispenso::ConcurrentTaskSet tasks(pool);
+  buildTree(tasks, root, 20);
+  tasks.wait();
+  verifyTree(root, 20);
+}
+
 TEST(TaskSet, OneChildCancels) {
   dispenso::ThreadPool pool(10);
   dispenso::TaskSet tasks(pool);
@@ -278,6 +371,30 @@ TEST(TaskSet, ParentThreadCancels) {
   EXPECT_TRUE(tasks.wait());
 }
 
+TEST(TaskSet, CancellationToken) {
+  dispenso::ThreadPool pool(4);
+  dispenso::ConcurrentTaskSet tasks(pool);
+  dispenso::CancellationToken token(tasks);
+  EXPECT_FALSE(token.canceled());
+
+  for (int i = 0; i < 4; ++i) {
+    tasks.schedule(
+        [token]() {
+          while (!token.canceled()) {
+            std::this_thread::yield();
+          }
+        },
+        dispenso::ForceQueuingTag());
+  }
+  tasks.schedule([token]() { token.cancel(); }, dispenso::ForceQueuingTag());
+  EXPECT_TRUE(tasks.wait());
+  EXPECT_TRUE(tasks.canceled());
+
+  dispenso::CancellationToken never;
+  never.cancel();
+  EXPECT_FALSE(never.canceled());
+}
+
 TEST(TaskSet, CascadingCancelOne) {
   dispenso::ThreadPool pool(10);
   dispenso::TaskSet tasks(pool);
@@ -370,6 +487,120 @@ TEST(TaskSet, CascadingMany) {
   }
 }
 
+template <typename TaskSetT>
+void checkWaitFor() {
+  dispenso::ThreadPool pool(2);
+  TaskSetT tasks(pool);
+  std::atomic<bool> started(false);
+  std::atomic<bool> release(false);
+  tasks.schedule(
+      [&started, &release]() {
+        started.store(true, std::memory_order_release);
+        while (!release.load(std::memory_order_acquire)) {
+          std::this_thread::yield();
+        }
+      },
+      dispenso::ForceQueuingTag());
+  // Make sure a pool thread owns the blocking task, rather than this thread picking it up.
+  while (!started.load(std::memory_order_acquire)) {
+    std::this_thread::yield();
+  }
+
+  EXPECT_FALSE(tasks.waitFor(std::chrono::milliseconds(5)));
+  EXPECT_FALSE(tasks.waitUntil(std::chrono::steady_clock::now() + std::chrono::milliseconds(5)));
+  release.store(true, std::memory_order_release);
+  EXPECT_TRUE(tasks.waitFor(std::chrono::seconds(30)));
+  // Nothing outstanding, so even a zero timeout succeeds.
+  EXPECT_TRUE(tasks.waitFor(std::chrono::seconds(0)));
+}
+
+TEST(TaskSet, WaitFor) {
+  checkWaitFor<dispenso::TaskSet>();
+}
+
+TEST(ConcurrentTaskSet, WaitFor) {
+  checkWaitFor<dispenso::ConcurrentTaskSet>();
+}
+
+TEST(TaskSet, WaitForHelpsRunTasks) {
+  dispenso::ThreadPool pool(0);
+  dispenso::TaskSet tasks(pool);
+  std::atomic<int> count(0);
+  for (int i = 0; i < 100; ++i) {
+    tasks.schedule([&count]() { count.fetch_add(1); }, dispenso::ForceQueuingTag());
+  }
+  EXPECT_TRUE(tasks.waitFor(std::chrono::seconds(30)));
+  EXPECT_EQ(count.load(), 100);
+}
+
+TEST(TaskSet, WaitPolicyOwnTasksOnly) {
+  dispenso::ThreadPool pool(1);
+  std::atomic<bool> started(false);
+  std::atomic<bool> release(false);
+  // Occupy the only pool thread, and queue an unrelated task that blocks until after our wait.
+  pool.schedule(
+      [&started, &release]() {
+        started.store(true, std::memory_order_release);
+        while (!release.load(std::memory_order_acquire)) {
+          std::this_thread::yield();
+        }
+      },
+      dispenso::ForceQueuingTag());
+  while (!started.load(std::memory_order_acquire)) {
+    std::this_thread::yield();
+  }
+  std::atomic<bool> unrelatedRan(false);
+  pool.schedule(
+      [&unrelatedRan, &release]() {
+        unrelatedRan.store(true, std::memory_order_release);
+        while (!release.load(std::memory_order_acquire)) {
+          std::this_thread::yield();
+        }
+      },
+      dispenso::ForceQueuingTag());
+
+  dispenso::TaskSet tasks(pool);
+  tasks.setWaitPolicy(dispenso::WaitPolicy::kOwnTasksOnly);
+  EXPECT_EQ(tasks.waitPolicy(), dispenso::WaitPolicy::kOwnTasksOnly);
+  std::vector<int> values(1000, 0);
+  for (size_t i = 0; i < values.size(); ++i) {
+    tasks.schedule([&values, i]() { values[i] = static_cast<int>(i); });
+  }
+  tasks.scheduleBulk(
+      10,
+      [&values](size_t i) { return [&values, i]() { values[i] += 1; }; },
+      dispenso::ForceQueuingTag());
+  EXPECT_FALSE(tasks.wait());
+  EXPECT_FALSE(unrelatedRan.load(std::memory_order_acquire));
+  for (size_t i = 0; i < values.size(); ++i) {
+    EXPECT_EQ(values[i], static_cast<int>(i) + (i < 10)) << i;
+  }
+  release.store(true, std::memory_order_release);
+}
+
+TEST(TaskSet, WaitPolicyOwnTasksOnlyNested) {
+  dispenso::ThreadPool pool(4);
+  dispenso::TaskSet outer(pool);
+  std::vector<std::atomic<int>> sums(16);
+  for (size_t i = 0; i < sums.size(); ++i) {
+    outer.schedule(
+        [&pool, &sums, i]() {
+          // On a pool thread, these must not go to the local queue, where wait can't find them.
+          dispenso::TaskSet inner(pool);
+          inner.setWaitPolicy(dispenso::WaitPolicy::kOwnTasksOnly);
+          for (int j = 0; j < 100; ++j) {
+            inner.schedule(
+                [&sums, i, j]() { sums[i].fetch_add(j, std::memory_order_relaxed); },
+                dispenso::ForceQueuingTag());
+          }
+          inner.wait();
+          EXPECT_EQ(sums[i].load(std::memory_order_relaxed), 4950);
+        },
+        dispenso::ForceQueuingTag());
+  }
+  outer.wait();
+}
+
 #if defined(__cpp_exceptions)
 TEST(TaskSet, Exception) {
   dispenso::ThreadPool pool(10);
@@ -553,4 +784,69 @@ TEST(TaskSet, ExceptionCancels) {
   EXPECT_TRUE(caught);
 }
 
+template <typename TaskSetT>
+void checkExceptionInline() {
+  dispenso::ThreadPool pool(1);
+  // A load multiplier of 1 means more than one outstanding task forces inline execution.
+  TaskSetT tasks(pool, 1);
+  std::atomic<bool> release(false);
+  for (int i = 0; i < 3; ++i) {
+    tasks.schedule(
+        [&release]() {
+          while (!release.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+          }
+        },
+        dispenso::ForceQueuingTag());
+  }
+
+  bool ranInline = false;
+  EXPECT_NO_THROW(tasks.schedule([&ranInline]() {
+    ranInline = true;
+    throw std::logic_error("oops");
+  }));
+  EXPECT_TRUE(ranInline);
+  EXPECT_TRUE(tasks.canceled());
+  release.store(true, std::memory_order_release);
+  EXPECT_THROW(tasks.wait(), std::logic_error);
+}
+
+TEST(TaskSet, ExceptionInline) {
+  checkExceptionInline<dispenso::TaskSet>();
+}
+
+TEST(ConcurrentTaskSet, ExceptionInline) {
+  checkExceptionInline<dispenso::ConcurrentTaskSet>();
+}
+
+TEST(TaskSet, ExceptionCancelsChildren) {
+  dispenso::ThreadPool pool(4);
+  dispenso::TaskSet tasks(pool);
+  std::atomic<bool> childStarted(false);
+  std::atomic<bool> childCanceled(false);
+
+  tasks.schedule(
+      [&pool, &childStarted, &childCanceled]() {
+        dispenso::TaskSet child(pool, dispenso::ParentCascadeCancel::kOn);
+        child.schedule(
+            [&childStarted, &childCanceled]() {
+              childStarted.store(true, std::memory_order_release);
+              while (!dispenso::parentTaskSet()->canceled()) {
+                std::this_thread::yield();
+              }
+              childCanceled.store(true, std::memory_order_release);
+            },
+            dispenso::ForceQueuingTag());
+        child.wait();
+      },
+      dispenso::ForceQueuingTag());
+  while (!childStarted.load(std::memory_order_acquire)) {
+    std::this_thread::yield();
+  }
+  tasks.schedule([]() { throw std::logic_error("oops"); }, dispenso::ForceQueuingTag());
+
+  EXPECT_THROW(tasks.wait(), std::logic_error);
+  EXPECT_TRUE(childCanceled.load(std::memory_order_acquire));
+}
+
 #endif // __cpp_exceptions
@@ -60,3 +60,14 @@ TEST(ThreadId, Unique) {
     EXPECT_TRUE(uniquenessSet.insert(id).second);
   }
 }
+
+TEST(ThreadId, SetName) {
+  std::thread t([]() {
+#if defined(__linux__) || defined(__APPLE__) || defined(_WIN32)
+    EXPECT_TRUE(dispenso::setCurrentThreadName("a-thread-name-longer-than-fifteen"));
+#else
+    dispenso::setCurrentThreadName("a-thread-name");
+#endif // PLATFORM
+  });
+  t.join();
+}
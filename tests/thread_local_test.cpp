@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/task_set.h>
+#include <dispenso/thread_local.h>
+
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+TEST(ThreadLocal, LocalIsStablePerThread) {
+  dispenso::ThreadLocal<int> tl;
+  EXPECT_TRUE(tl.empty());
+  bool exists = true;
+  int& mine = tl.local(exists);
+  EXPECT_FALSE(exists);
+  EXPECT_EQ(mine, 0);
+  mine = 5;
+  EXPECT_EQ(&tl.local(exists), &mine);
+  EXPECT_TRUE(exists);
+  EXPECT_EQ(tl.size(), 1u);
+
+  int* other = nullptr;
+  std::thread t([&]() {
+    other = &tl.local();
+    *other = 7;
+  });
+  t.join();
+  EXPECT_NE(other, &mine);
+  // The exited thread's slot survives for combining.
+  EXPECT_EQ(tl.size(), 2u);
+  EXPECT_EQ(tl.combine(std::plus<int>()), 12);
+}
+
+TEST(ThreadLocal, SlotsAreCacheLineAligned) {
+  dispenso::ThreadLocal<char> tl;
+  std::vector<std::thread> threads;
+  std::vector<char*> slots(4);
+  for (size_t i = 0; i < slots.size(); ++i) {
+    threads.emplace_back([&tl, &slots, i]() { slots[i] = &tl.local(); });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  for (char* slot : slots) {
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(slot) % dispenso::kCacheLineSize, 0u);
+  }
+}
+
+TEST(ThreadLocal, ReductionAcrossTasks) {
+  constexpr int64_t kNum = 100000;
+  dispenso::ThreadLocal<int64_t> sums;
+  dispenso::ThreadPool pool(4);
+  dispenso::TaskSet tasks(pool);
+  for (int64_t i = 0; i < kNum; ++i) {
+    tasks.schedule([&sums, i]() { sums.local() += i; });
+  }
+  tasks.wait();
+  EXPECT_GE(sums.size(), 1u);
+  EXPECT_EQ(sums.combine(std::plus<int64_t>()), kNum * (kNum - 1) / 2);
+
+  size_t visited = 0;
+  sums.enumerate([&visited](const int64_t&) { ++visited; });
+  EXPECT_EQ(visited, sums.size());
+}
+
+TEST(ThreadLocal, InitFunctionAndEmptyCombine) {
+  dispenso::ThreadLocal<std::vector<int>> tl([]() { return std::vector<int>(3, 1); });
+  std::vector<int> empty = tl.combine([](const std::vector<int>& a, const std::vector<int>&) {
+    return a;
+  });
+  EXPECT_EQ(empty.size(), 3u);
+
+  tl.local().push_back(2);
+  std::thread t([&tl]() { tl.local().push_back(3); });
+  t.join();
+
+  std::vector<int> merged;
+  tl.combineEach([&merged](std::vector<int>&& v) {
+    merged.insert(merged.end(), v.begin(), v.end());
+  });
+  EXPECT_EQ(merged.size(), 8u);
+}
+
+TEST(ThreadLocal, Clear) {
+  dispenso::ThreadLocal<int> tl([]() { return 10; });
+  tl.local() = 3;
+  tl.clear();
+  EXPECT_TRUE(tl.empty());
+  EXPECT_EQ(tl.local(), 10);
+  EXPECT_EQ(tl.size(), 1u);
+}
@@ -6,6 +6,21 @@
  */
 
 #include <dispenso/thread_pool.h>
+#include <dispenso/latch.h>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif // __linux__
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
@@ -308,3 +323,960 @@ TEST_P(ThreadPoolTest, CrossPoolTest) {
     ++i;
   }
 }
+
+TEST(ThreadPool, WorkStealingSimpleWork) {
+  constexpr int kWorkItems = 10000;
+  std::vector<int> outputs(kWorkItems, 0);
+  {
+    dispenso::ThreadPool pool(10);
+    pool.setWorkStealing(true);
+    EXPECT_TRUE(pool.workStealing());
+    EXPECT_EQ(10, pool.numThreads());
+    int i = 0;
+    for (int& o : outputs) {
+      pool.schedule([i, &o]() { o = i * i; });
+      ++i;
+    }
+  }
+
+  int i = 0;
+  for (int o : outputs) {
+    EXPECT_EQ(o, i * i);
+    ++i;
+  }
+}
+
+TEST(ThreadPool, WorkStealingRecursiveWork) {
+  constexpr int kOuter = 100;
+  constexpr int kInner = 100;
+  std::vector<int> outputs(kOuter * kInner, 0);
+  std::atomic<int> completed(0);
+  {
+    dispenso::ThreadPool pool(8);
+    pool.setWorkStealing(true);
+    for (int i = 0; i < kOuter; ++i) {
+      pool.schedule(
+          [i, &pool, &outputs, &completed]() {
+            // Scheduled from a pool thread, so this lands in that thread's deque.
+            for (int j = 0; j < kInner; ++j) {
+              int idx = i * kInner + j;
+              pool.schedule(
+                  [idx, &outputs, &completed]() {
+                    outputs[static_cast<size_t>(idx)] = idx;
+                    completed.fetch_add(1, std::memory_order_relaxed);
+                  },
+                  dispenso::ForceQueuingTag());
+            }
+          },
+          dispenso::ForceQueuingTag());
+    }
+  }
+
+  EXPECT_EQ(completed.load(), kOuter * kInner);
+  for (int i = 0; i < kOuter * kInner; ++i) {
+    EXPECT_EQ(outputs[static_cast<size_t>(i)], i);
+  }
+}
+
+TEST(ThreadPool, WorkStealingResizeAndToggleConcurrent) {
+  constexpr int kWorkItems = 100000;
+  std::vector<int64_t> outputs(kWorkItems, 0);
+  {
+    dispenso::ThreadPool pool(4);
+
+    std::thread toggler([&pool]() {
+      for (int i = 0; i < 50; ++i) {
+        pool.setWorkStealing(i & 1);
+        pool.resize(2 + (i % 7));
+      }
+      pool.setWorkStealing(true);
+    });
+
+    int64_t i = 0;
+    for (int64_t& o : outputs) {
+      pool.schedule([i, &o, &pool]() {
+        pool.schedule([i, &o]() { o = i * i; });
+      });
+      ++i;
+    }
+    toggler.join();
+    EXPECT_TRUE(pool.workStealing());
+  }
+
+  int64_t i = 0;
+  for (int64_t o : outputs) {
+    EXPECT_EQ(o, i * i);
+    ++i;
+  }
+}
+
+TEST(ThreadPool, PriorityOrdering) {
+  constexpr int kPerLevel = 100;
+  std::mutex mtx;
+  std::vector<dispenso::TaskPriority> order;
+  std::atomic<bool> started(false);
+  std::atomic<bool> release(false);
+  std::atomic<int> completed(0);
+
+  dispenso::ThreadPool pool(1);
+  pool.schedule(
+      [&]() {
+        started.store(true, std::memory_order_release);
+        while (!release.load(std::memory_order_acquire)) {
+          std::this_thread::yield();
+        }
+      },
+      dispenso::ForceQueuingTag());
+  while (!started.load(std::memory_order_acquire)) {
+    std::this_thread::yield();
+  }
+
+  auto record = [&](dispenso::TaskPriority p) {
+    return [&, p]() {
+      {
+        std::lock_guard<std::mutex> lk(mtx);
+        order.push_back(p);
+      }
+      completed.fetch_add(1, std::memory_order_release);
+    };
+  };
+
+  for (auto p :
+       {dispenso::TaskPriority::kLow,
+        dispenso::TaskPriority::kNormal,
+        dispenso::TaskPriority::kHigh}) {
+    for (int i = 0; i < kPerLevel; ++i) {
+      pool.schedule(record(p), p, dispenso::ForceQueuingTag());
+    }
+  }
+
+  release.store(true, std::memory_order_release);
+  while (completed.load(std::memory_order_acquire) < 3 * kPerLevel) {
+    std::this_thread::yield();
+  }
+
+  ASSERT_EQ(order.size(), 3 * kPerLevel);
+  EXPECT_TRUE(std::is_sorted(order.begin(), order.end()));
+  EXPECT_EQ(order.front(), dispenso::TaskPriority::kHigh);
+  EXPECT_EQ(order.back(), dispenso::TaskPriority::kLow);
+}
+
+TEST(ThreadPool, PriorityWork) {
+  constexpr int kWorkItems = 10000;
+  std::vector<int> outputs(kWorkItems, 0);
+  {
+    dispenso::ThreadPool pool(10);
+    int i = 0;
+    for (int& o : outputs) {
+      auto p = static_cast<dispenso::TaskPriority>(i % 3);
+      pool.schedule([i, &o]() { o = i * i; }, p);
+      ++i;
+    }
+  }
+
+  int i = 0;
+  for (int o : outputs) {
+    EXPECT_EQ(o, i * i);
+    ++i;
+  }
+}
+
+TEST(ThreadPool, NumaAwareWork) {
+  constexpr int kWorkItems = 10000;
+  std::vector<int> outputs(kWorkItems, 0);
+  {
+    dispenso::ThreadPool pool(6);
+    pool.setNumaAware(true);
+    EXPECT_TRUE(pool.numaAware());
+    EXPECT_GE(pool.numNumaNodes(), 1);
+    EXPECT_EQ(6, pool.numThreads());
+    int i = 0;
+    for (int& o : outputs) {
+      if (i & 1) {
+        pool.scheduleOnNode([i, &o]() { o = i * i; }, static_cast<size_t>(i));
+      } else {
+        // Schedule from within the pool so that the nested work goes to the node-local queue.
+        pool.schedule([i, &o, &pool]() { pool.schedule([i, &o]() { o = i * i; }); });
+      }
+      ++i;
+    }
+  }
+
+  int i = 0;
+  for (int o : outputs) {
+    EXPECT_EQ(o, i * i);
+    ++i;
+  }
+}
+
+TEST(ThreadPool, NumaAwareToggle) {
+  dispenso::ThreadPool pool(4);
+  EXPECT_FALSE(pool.numaAware());
+  EXPECT_EQ(1, pool.numNumaNodes());
+  std::atomic<int> count(0);
+  for (int round = 0; round < 10; ++round) {
+    pool.setNumaAware(round & 1);
+    pool.setWorkStealing(round & 2);
+    for (int i = 0; i < 1000; ++i) {
+      pool.scheduleOnNode([&count]() { ++count; }, static_cast<size_t>(i));
+    }
+  }
+  pool.resize(0);
+  EXPECT_EQ(count.load(), 10000);
+}
+
+TEST(ThreadPool, ThreadStartHook) {
+  std::mutex mtx;
+  std::multiset<size_t> indices;
+  dispenso::ThreadPool pool(4);
+  pool.setThreadStartHook([&](size_t index) {
+    std::lock_guard<std::mutex> lk(mtx);
+    indices.insert(index);
+  });
+
+  // Threads are restarted synchronously, but hooks run asynchronously at thread start.
+  std::atomic<int> count(0);
+  for (int i = 0; i < 100; ++i) {
+    pool.schedule([&count]() { ++count; });
+  }
+  pool.resize(6);
+  pool.resize(0);
+  EXPECT_EQ(count.load(), 100);
+
+  std::multiset<size_t> expected = {0, 1, 2, 3, 4, 5};
+  EXPECT_EQ(indices, expected);
+}
+
+#if defined(__linux__)
+TEST(ThreadPool, AffinityAndNames) {
+  int cpu = sched_getcpu();
+  std::mutex mtx;
+  std::vector<std::string> names;
+  std::vector<int> cpuCounts;
+
+  dispenso::ThreadPool pool(3);
+  pool.setAffinity({cpu});
+  pool.setThreadNamePrefix("dispenso-");
+  pool.setThreadStartHook([&](size_t) {
+    char name[16];
+    pthread_getname_np(pthread_self(), name, sizeof(name));
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    sched_getaffinity(0, sizeof(set), &set);
+    std::lock_guard<std::mutex> lk(mtx);
+    names.emplace_back(name);
+    cpuCounts.push_back(CPU_COUNT(&set));
+  });
+  pool.resize(0);
+
+  std::sort(names.begin(), names.end());
+  EXPECT_THAT(names, testing::ElementsAre("dispenso-0", "dispenso-1", "dispenso-2"));
+  EXPECT_THAT(cpuCounts, testing::Each(1));
+}
+
+TEST(ThreadPool, DeterministicPinsThreads) {
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  sched_getaffinity(0, sizeof(allowed), &allowed);
+  std::vector<int> cpus;
+  for (int c = 0; c < CPU_SETSIZE; ++c) {
+    if (CPU_ISSET(c, &allowed)) {
+      cpus.push_back(c);
+    }
+  }
+
+  std::mutex mtx;
+  std::vector<std::vector<int>> pinned(5);
+  dispenso::ThreadPool pool(5);
+  pool.setAffinity(cpus);
+  pool.setDeterministic(true);
+  pool.setThreadStartHook([&](size_t index) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    sched_getaffinity(0, sizeof(set), &set);
+    std::lock_guard<std::mutex> lk(mtx);
+    for (int c = 0; c < CPU_SETSIZE; ++c) {
+      if (CPU_ISSET(c, &set)) {
+        pinned[index].push_back(c);
+      }
+    }
+  });
+  pool.resize(0);
+
+  for (size_t i = 0; i < pinned.size(); ++i) {
+    EXPECT_THAT(pinned[i], testing::ElementsAre(cpus[i % cpus.size()]));
+  }
+}
+#endif // __linux__
+
+TEST(ThreadPool, DeterministicWorkStealing) {
+  constexpr int kOuter = 50;
+  constexpr int kInner = 100;
+  std::vector<int> outputs(kOuter * kInner, 0);
+  std::atomic<int> completed(0);
+  {
+    dispenso::ThreadPool pool(6);
+    pool.setWorkStealing(true);
+    pool.setDeterministic(true, 12345);
+    EXPECT_TRUE(pool.deterministic());
+    for (int i = 0; i < kOuter; ++i) {
+      pool.schedule(
+          [i, &pool, &outputs, &completed]() {
+            for (int j = 0; j < kInner; ++j) {
+              int idx = i * kInner + j;
+              pool.schedule(
+                  [idx, &outputs, &completed]() {
+                    outputs[static_cast<size_t>(idx)] = idx;
+                    completed.fetch_add(1, std::memory_order_relaxed);
+                  },
+                  dispenso::ForceQueuingTag());
+            }
+          },
+          dispenso::ForceQueuingTag());
+    }
+  }
+
+  EXPECT_EQ(completed.load(), kOuter * kInner);
+  for (int i = 0; i < kOuter * kInner; ++i) {
+    EXPECT_EQ(outputs[static_cast<size_t>(i)], i);
+  }
+}
+
+static uint64_t totalExecuted(const dispenso::ThreadPoolStats& stats) {
+  uint64_t total = stats.retired.tasksExecuted + stats.externalTasksExecuted + stats.inlineTasks;
+  for (auto& t : stats.threads) {
+    total += t.tasksExecuted;
+  }
+  return total;
+}
+
+TEST(ThreadPool, StatsDisabled) {
+  dispenso::ThreadPool pool(4);
+  std::atomic<int> count(0);
+  for (int i = 0; i < 1000; ++i) {
+    pool.schedule([&count]() { ++count; });
+  }
+  pool.resize(0);
+  EXPECT_EQ(count.load(), 1000);
+
+  auto stats = pool.stats();
+  EXPECT_EQ(totalExecuted(stats), 0);
+  EXPECT_EQ(stats.queueHighWater, 0);
+  EXPECT_EQ(stats.wakes, 0);
+}
+
+TEST(ThreadPool, StatsCountAllWork) {
+  constexpr int kWork = 10000;
+  dispenso::ThreadPool pool(4);
+  pool.setStatsEnabled(true);
+  std::atomic<int> count(0);
+  for (int i = 0; i < kWork; ++i) {
+    pool.schedule([&count]() { ++count; });
+  }
+  while (count.load(std::memory_order_acquire) < kWork) {
+    std::this_thread::yield();
+  }
+
+  auto live = pool.stats();
+  EXPECT_EQ(live.threads.size(), 4);
+  EXPECT_GT(live.queueHighWater, 0);
+
+  // Once threads exit, their counts are folded into retired.
+  pool.resize(0);
+  auto stats = pool.stats();
+  EXPECT_TRUE(stats.threads.empty());
+  EXPECT_EQ(totalExecuted(stats), kWork);
+  EXPECT_GE(stats.retired.busySeconds, 0.0);
+}
+
+TEST(ThreadPool, StatsInline) {
+  dispenso::ThreadPool pool(0);
+  pool.setStatsEnabled(true);
+  int count = 0;
+  for (int i = 0; i < 100; ++i) {
+    pool.schedule([&count]() { ++count; });
+  }
+  EXPECT_EQ(count, 100);
+  EXPECT_EQ(pool.stats().inlineTasks, 100);
+}
+
+static void runBackoffWork(dispenso::ThreadPool& pool) {
+  for (int round = 0; round < 10; ++round) {
+    std::atomic<int> count(0);
+    for (int i = 0; i < 1000; ++i) {
+      pool.schedule([&count]() { ++count; });
+    }
+    while (count.load(std::memory_order_acquire) < 1000) {
+      std::this_thread::yield();
+    }
+    // Give threads time to go idle so that later rounds exercise waking.
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+  }
+}
+
+TEST(ThreadPool, BackoffPolicyLowLatency) {
+  dispenso::ThreadPool pool(4);
+  pool.setBackoffPolicy(dispenso::BackoffPolicy::lowLatency(std::chrono::microseconds(50)));
+  EXPECT_EQ(pool.backoffPolicy().spinUs, 50);
+  runBackoffWork(pool);
+}
+
+TEST(ThreadPool, BackoffPolicyEfficient) {
+  dispenso::ThreadPool pool(4);
+  pool.setStatsEnabled(true);
+  pool.setSignalingWake(true, std::chrono::milliseconds(1), dispenso::BackoffPolicy::efficient());
+  EXPECT_EQ(pool.backoffPolicy().spinIterations, 1);
+  runBackoffWork(pool);
+  pool.resize(0);
+  EXPECT_GT(pool.stats().retired.sleeps, 0);
+}
+
+TEST(ThreadPool, BackoffPolicyPolling) {
+  dispenso::ThreadPool pool(4);
+  dispenso::BackoffPolicy backoff;
+  backoff.spinIterations = 10;
+  backoff.yieldUs = 20;
+  pool.setSignalingWake(false, std::chrono::microseconds(100), backoff);
+  runBackoffWork(pool);
+}
+
+TEST(ThreadPool, ScheduleBulk) {
+  for (bool stealing : {false, true}) {
+    dispenso::ThreadPool pool(4);
+    pool.setWorkStealing(stealing);
+    std::atomic<int> count(0);
+    std::vector<int> values(1000, 0);
+    pool.scheduleBulk(500, [&](size_t i) {
+      return [&, i]() {
+        ++values[i];
+        ++count;
+      };
+    });
+    pool.scheduleBulk(
+        500,
+        [&](size_t i) {
+          return [&, i]() {
+            ++values[i + 500];
+            ++count;
+          };
+        },
+        dispenso::ForceQueuingTag());
+    while (count.load(std::memory_order_acquire) < 1000) {
+      std::this_thread::yield();
+    }
+    EXPECT_THAT(values, testing::Each(1));
+  }
+}
+
+TEST(ThreadPool, ScheduleBulkWakesSleepers) {
+  constexpr int kThreads = 4;
+  dispenso::ThreadPool pool(kThreads);
+  // Sleep for long enough that tasks could only start promptly if sleeping threads are woken.
+  pool.setSignalingWake(true, std::chrono::seconds(30), dispenso::BackoffPolicy::efficient());
+  for (int round = 0; round < 3; ++round) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    dispenso::Latch allRunning(kThreads);
+    std::atomic<int> running(0);
+    pool.scheduleBulk(kThreads, [&](size_t) {
+      return [&]() {
+        allRunning.countDown();
+        EXPECT_TRUE(allRunning.waitFor(std::chrono::seconds(10)));
+        running.fetch_add(1, std::memory_order_release);
+      };
+    });
+    while (running.load(std::memory_order_acquire) < kThreads) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+TEST(ThreadPool, ElasticGrowsUnderLoad) {
+  constexpr int kTasks = 4;
+  dispenso::ThreadPool pool(1);
+  dispenso::ElasticPolicy policy;
+  policy.minThreads = 1;
+  policy.maxThreads = kTasks;
+  policy.sampleUs = 200;
+  policy.shrinkSamples = 1000000;
+  pool.setElastic(policy);
+  EXPECT_TRUE(pool.elastic());
+
+  // Every task waits for all of them to be running, which needs the pool to grow.
+  dispenso::Latch allRunning(kTasks);
+  std::atomic<int> done(0);
+  for (int i = 0; i < kTasks; ++i) {
+    pool.schedule(
+        [&]() {
+          allRunning.countDown();
+          EXPECT_TRUE(allRunning.waitFor(std::chrono::seconds(10)));
+          done.fetch_add(1, std::memory_order_release);
+        },
+        dispenso::ForceQueuingTag());
+  }
+  while (done.load(std::memory_order_acquire) < kTasks) {
+    std::this_thread::yield();
+  }
+  EXPECT_EQ(pool.numThreads(), kTasks);
+}
+
+TEST(ThreadPool, ElasticShrinksWhenIdle) {
+  dispenso::ThreadPool pool(4);
+  dispenso::ElasticPolicy policy;
+  policy.minThreads = 2;
+  policy.maxThreads = 4;
+  policy.sampleUs = 100;
+  policy.shrinkSamples = 5;
+  pool.setElastic(policy);
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (pool.numThreads() > 2 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_EQ(pool.numThreads(), 2);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_EQ(pool.numThreads(), 2);
+
+  pool.disableElastic();
+  EXPECT_FALSE(pool.elastic());
+  std::atomic<int> count(0);
+  for (int i = 0; i < 100; ++i) {
+    pool.schedule([&count]() { count.fetch_add(1, std::memory_order_relaxed); });
+  }
+  while (count.load(std::memory_order_relaxed) < 100) {
+    std::this_thread::yield();
+  }
+}
+
+TEST(ThreadPool, ElasticClampsToRange) {
+  dispenso::ElasticPolicy policy;
+  policy.minThreads = 3;
+  policy.maxThreads = 5;
+  policy.shrinkSamples = 1000000;
+
+  dispenso::ThreadPool small(1);
+  small.setElastic(policy);
+  EXPECT_EQ(small.numThreads(), 3);
+
+  dispenso::ThreadPool large(8);
+  large.setWorkStealing(true);
+  large.setElastic(policy);
+  EXPECT_EQ(large.numThreads(), 5);
+}
+
+TEST(ThreadPool, ElasticWorkStealingStartsOnlyNeededThreads) {
+  dispenso::ElasticPolicy policy;
+  policy.minThreads = 3;
+  policy.maxThreads = 16;
+  policy.shrinkSamples = 1000000;
+
+  dispenso::ThreadPool pool(1);
+  pool.setWorkStealing(true);
+  std::atomic<int> starts(0);
+  pool.setThreadStartHook([&starts](size_t) { starts.fetch_add(1, std::memory_order_relaxed); });
+  while (starts.load(std::memory_order_relaxed) < 1) {
+    std::this_thread::yield();
+  }
+  starts.store(0, std::memory_order_relaxed);
+  // The steal deques are sized for maxThreads, without starting that many threads.
+  pool.setElastic(policy);
+  EXPECT_EQ(pool.numThreads(), 3);
+  while (starts.load(std::memory_order_relaxed) < 3) {
+    std::this_thread::yield();
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_EQ(starts.load(std::memory_order_relaxed), 3);
+  pool.disableElastic();
+}
+
+TEST(ThreadPool, ScheduleBulkNoThreads) {
+  dispenso::ThreadPool pool(0);
+  std::vector<int> values(100, 0);
+  pool.scheduleBulk(100, [&values](size_t i) { return [&values, i]() { ++values[i]; }; });
+  EXPECT_THAT(values, testing::Each(1));
+}
+
+TEST(ThreadPool, ScheduleAfter) {
+  dispenso::ThreadPool pool(2);
+  std::atomic<bool> fired(false);
+  auto start = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point firedAt;
+  pool.scheduleAfter(std::chrono::milliseconds(20), [&fired, &firedAt]() {
+    firedAt = std::chrono::steady_clock::now();
+    fired.store(true, std::memory_order_release);
+  });
+  while (!fired.load(std::memory_order_acquire)) {
+    std::this_thread::yield();
+  }
+  EXPECT_GE(firedAt - start, std::chrono::milliseconds(20));
+}
+
+TEST(ThreadPool, ScheduleAtOrdering) {
+  dispenso::ThreadPool pool(1);
+  constexpr int kNumTimers = 200;
+  std::mutex mtx;
+  std::vector<int> order;
+  auto start = std::chrono::steady_clock::now();
+  // Insert out of order, and spread the deadlines past one rotation of the timer wheel.
+  for (int i = kNumTimers - 1; i >= 0; --i) {
+    pool.scheduleAt(start + std::chrono::microseconds(200 * i), [&mtx, &order, i]() {
+      std::lock_guard<std::mutex> lk(mtx);
+      order.push_back(i);
+    });
+  }
+  while (true) {
+    std::lock_guard<std::mutex> lk(mtx);
+    if (order.size() == kNumTimers) {
+      break;
+    }
+  }
+  // With a single thread, timers several ticks apart must run in deadline order.
+  for (size_t i = 1; i < order.size(); ++i) {
+    EXPECT_LT(order[i - 1] - 2, order[i]);
+  }
+}
+
+TEST(ThreadPool, ScheduleAtPast) {
+  dispenso::ThreadPool pool(1);
+  std::atomic<bool> fired(false);
+  pool.scheduleAt(std::chrono::steady_clock::now() - std::chrono::seconds(1), [&fired]() {
+    fired.store(true, std::memory_order_release);
+  });
+  while (!fired.load(std::memory_order_acquire)) {
+    std::this_thread::yield();
+  }
+}
+
+TEST(ThreadPool, ScheduleAfterDestructorWaits) {
+  std::atomic<int> count(0);
+  {
+    dispenso::ThreadPool pool(2);
+    for (int i = 0; i < 10; ++i) {
+      pool.scheduleAfter(std::chrono::milliseconds(i), [&count]() { count.fetch_add(1); });
+    }
+  }
+  EXPECT_EQ(count.load(), 10);
+}
+
+TEST(ThreadPool, ScheduleAfterNoThreads) {
+  std::atomic<bool> fired(false);
+  {
+    dispenso::ThreadPool pool(0);
+    pool.scheduleAfter(std::chrono::milliseconds(2), [&fired]() {
+      fired.store(true, std::memory_order_release);
+    });
+    // Without pool threads, the destructor services the remaining timers.
+  }
+  EXPECT_TRUE(fired.load(std::memory_order_acquire));
+}
+
+TEST(ThreadPool, CurrentWorkerIndex) {
+  dispenso::ThreadPool pool(4);
+  dispenso::ThreadPool other(1);
+  EXPECT_EQ(pool.currentWorkerIndex(), dispenso::ThreadPool::kNoWorkerIndex);
+
+  auto collect = [&pool](size_t n) {
+    std::mutex mtx;
+    std::set<size_t> indices;
+    // Every task waits for the others, so that each runs on a different thread.
+    dispenso::Latch latch(static_cast<ptrdiff_t>(n));
+    std::atomic<size_t> finished(0);
+    for (size_t i = 0; i < n; ++i) {
+      pool.schedule([&]() {
+        size_t index = pool.currentWorkerIndex();
+        {
+          std::lock_guard<std::mutex> lk(mtx);
+          indices.insert(index);
+        }
+        latch.arriveAndWait();
+        finished.fetch_add(1, std::memory_order_release);
+      });
+    }
+    // Wait for the tasks to finish with the latch before it goes away.
+    while (finished.load(std::memory_order_acquire) < n) {
+      std::this_thread::yield();
+    }
+    std::lock_guard<std::mutex> lk(mtx);
+    return indices;
+  };
+
+  EXPECT_EQ(collect(4), (std::set<size_t>{0, 1, 2, 3}));
+  pool.resize(6);
+  EXPECT_EQ(collect(6), (std::set<size_t>{0, 1, 2, 3, 4, 5}));
+
+  // Indices are per pool.
+  size_t inOther = 1;
+  size_t inPool = 0;
+  dispenso::Latch done(1);
+  other.schedule([&]() {
+    inOther = other.currentWorkerIndex();
+    inPool = pool.currentWorkerIndex();
+    done.countDown();
+  });
+  done.wait();
+  EXPECT_EQ(inOther, 0u);
+  EXPECT_EQ(inPool, dispenso::ThreadPool::kNoWorkerIndex);
+}
+
+TEST(ThreadPool, Observer) {
+  struct CountingObserver : dispenso::ThreadPoolObserver {
+    void onWorkerStart(size_t index) override {
+      starts.fetch_add(1);
+      indexSum.fetch_add(index);
+    }
+    void onWorkerStop(size_t /*index*/) override {
+      stops.fetch_add(1);
+    }
+    void onTaskBegin() override {
+      begins.fetch_add(1);
+    }
+    void onTaskEnd() override {
+      ends.fetch_add(1);
+    }
+    void onIdle(size_t /*index*/) override {
+      idles.fetch_add(1);
+    }
+    void onWake(size_t /*index*/) override {
+      wakes.fetch_add(1);
+    }
+
+    std::atomic<int> starts{0};
+    std::atomic<int> stops{0};
+    std::atomic<size_t> indexSum{0};
+    std::atomic<int> begins{0};
+    std::atomic<int> ends{0};
+    std::atomic<int> idles{0};
+    std::atomic<int> wakes{0};
+  };
+
+  constexpr int kTasks = 100;
+  CountingObserver observer;
+  {
+    dispenso::ThreadPool pool(3);
+    pool.setObserver(&observer);
+    std::atomic<int> ran(0);
+    for (int i = 0; i < kTasks; ++i) {
+      pool.schedule([&ran]() { ran.fetch_add(1); }, dispenso::ForceQueuingTag());
+    }
+    if (!dispenso::kObserversCompiledIn) {
+      while (ran.load() < kTasks) {
+        std::this_thread::yield();
+      }
+      EXPECT_EQ(observer.starts.load(), 0);
+      return;
+    }
+    while (observer.ends.load() < kTasks || observer.starts.load() < 3) {
+      std::this_thread::yield();
+    }
+    EXPECT_EQ(ran.load(), kTasks);
+    EXPECT_EQ(observer.begins.load(), kTasks);
+    EXPECT_EQ(observer.starts.load(), 3);
+    EXPECT_EQ(observer.indexSum.load(), 0u + 1u + 2u);
+
+    // Out of work, the threads soon go to sleep.
+    while (observer.idles.load() == 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  EXPECT_EQ(observer.stops.load(), 3);
+  EXPECT_GE(observer.wakes.load(), 1);
+  EXPECT_LE(observer.wakes.load(), observer.idles.load());
+}
+
+TEST(ThreadPool, ScheduleLatency) {
+  constexpr int kTasks = 1000;
+  dispenso::ThreadPool pool(2);
+  std::atomic<int> ran(0);
+  auto runTasks = [&]() {
+    ran.store(0);
+    for (int i = 0; i < kTasks; ++i) {
+      pool.schedule([&ran]() { ran.fetch_add(1); }, dispenso::ForceQueuingTag());
+    }
+    while (ran.load() < kTasks) {
+      std::this_thread::yield();
+    }
+  };
+
+  runTasks();
+  EXPECT_EQ(pool.stats().scheduleLatency.count(), 0u);
+
+  pool.setScheduleLatencyEnabled(true);
+  runTasks();
+  dispenso::ThreadPoolStats stats = pool.stats();
+  EXPECT_EQ(stats.scheduleLatency.count(), static_cast<uint64_t>(kTasks));
+  uint64_t perThread = 0;
+  for (const auto& t : stats.threads) {
+    perThread += t.scheduleLatency.count();
+  }
+  EXPECT_EQ(perThread, static_cast<uint64_t>(kTasks));
+  EXPECT_LE(stats.scheduleLatency.percentile(50.0), stats.scheduleLatency.percentile(99.0));
+  EXPECT_LE(stats.scheduleLatency.percentile(99.0), stats.scheduleLatency.max());
+
+  // Histograms of threads that exit are kept.
+  pool.resize(1);
+  EXPECT_EQ(pool.stats().scheduleLatency.count(), static_cast<uint64_t>(kTasks));
+
+  pool.setScheduleLatencyEnabled(false);
+  runTasks();
+  EXPECT_EQ(pool.stats().scheduleLatency.count(), static_cast<uint64_t>(kTasks));
+}
+
+TEST(ThreadPool, ExternalThreadsSchedule) {
+  constexpr int kThreads = 32;
+  constexpr int kTasks = 200;
+  std::atomic<int> ran(0);
+  {
+    dispenso::ThreadPool pool(2);
+    // Each wave of short-lived threads reuses the producers released by the previous one.
+    for (int wave = 0; wave < 4; ++wave) {
+      std::vector<std::thread> threads;
+      for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&pool, &ran]() {
+          for (int i = 0; i < kTasks; ++i) {
+            pool.schedule([&ran]() { ran.fetch_add(1); }, dispenso::ForceQueuingTag());
+          }
+          pool.scheduleBulk(
+              kTasks,
+              [&ran](size_t) { return [&ran]() { ran.fetch_add(1); }; },
+              dispenso::ForceQueuingTag());
+        });
+      }
+      for (auto& t : threads) {
+        t.join();
+      }
+    }
+  }
+  EXPECT_EQ(ran.load(), 4 * kThreads * 2 * kTasks);
+}
+
+TEST(ThreadPool, ExternalThreadOutlivesPool) {
+  std::atomic<int> ran(0);
+  std::atomic<int> phase(0);
+  std::thread external([&]() {
+    {
+      dispenso::ThreadPool pool(1);
+      pool.schedule([&ran]() { ran.fetch_add(1); }, dispenso::ForceQueuingTag());
+    }
+    // A pool at the same address must not pick up the dead pool's token.
+    dispenso::ThreadPool pool(1);
+    pool.schedule([&ran]() { ran.fetch_add(1); }, dispenso::ForceQueuingTag());
+    phase.store(1);
+    while (phase.load() != 2) {
+      std::this_thread::yield();
+    }
+  });
+  while (phase.load() != 1) {
+    std::this_thread::yield();
+  }
+  phase.store(2);
+  external.join();
+  EXPECT_EQ(ran.load(), 2);
+}
+
+TEST(ThreadPool, ExternalThreadManyPools) {
+  // More pools than a thread keeps tokens for, so that tokens are released and recreated.
+  constexpr int kPools = 12;
+  constexpr int kRounds = 20;
+  std::vector<std::unique_ptr<dispenso::ThreadPool>> pools;
+  for (int p = 0; p < kPools; ++p) {
+    pools.push_back(std::make_unique<dispenso::ThreadPool>(1));
+  }
+  std::atomic<int> ran(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&pools, &ran]() {
+      for (int r = 0; r < kRounds; ++r) {
+        for (auto& pool : pools) {
+          pool->schedule([&ran]() { ran.fetch_add(1); }, dispenso::ForceQueuingTag());
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  // Destroy half the pools while the main thread still holds tokens on all of them.
+  for (auto& pool : pools) {
+    pool->schedule([&ran]() { ran.fetch_add(1); }, dispenso::ForceQueuingTag());
+  }
+  pools.resize(kPools / 2);
+  for (auto& pool : pools) {
+    pool->schedule([&ran]() { ran.fetch_add(1); }, dispenso::ForceQueuingTag());
+  }
+  pools.clear();
+  EXPECT_EQ(ran.load(), 4 * kRounds * kPools + kPools + kPools / 2);
+}
+
+TEST(ThreadPool, BackgroundStart) {
+  constexpr int kTasks = 1000;
+  std::atomic<int> ran(0);
+  {
+    dispenso::ThreadPool pool(4, dispenso::BackgroundStartTag());
+    EXPECT_LE(pool.numThreads(), 4);
+    // Tasks scheduled before threads are up run inline.
+    for (int i = 0; i < kTasks; ++i) {
+      pool.schedule([&ran]() { ran.fetch_add(1); });
+    }
+    while (pool.numThreads() < 4) {
+      std::this_thread::yield();
+    }
+    for (int i = 0; i < kTasks; ++i) {
+      pool.schedule([&ran]() { ran.fetch_add(1); }, dispenso::ForceQueuingTag());
+    }
+  }
+  EXPECT_EQ(ran.load(), 2 * kTasks);
+}
+
+TEST(ThreadPool, ResizeStopsBackgroundStart) {
+  dispenso::ThreadPool pool(16, dispenso::BackgroundStartTag());
+  pool.resize(2);
+  EXPECT_EQ(pool.numThreads(), 2);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_EQ(pool.numThreads(), 2);
+}
+
+TEST(ThreadPool, SetWorkStealingStopsBackgroundStart) {
+  dispenso::ThreadPool pool(16, dispenso::BackgroundStartTag());
+  pool.setWorkStealing(true);
+  const ssize_t n = pool.numThreads();
+  EXPECT_LE(n, 16);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_EQ(pool.numThreads(), n);
+}
+
+TEST(ThreadPool, SetThreadNamePrefixStopsBackgroundStart) {
+  dispenso::ThreadPool pool(16, dispenso::BackgroundStartTag());
+  pool.setThreadNamePrefix("bg");
+  const ssize_t n = pool.numThreads();
+  EXPECT_LE(n, 16);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_EQ(pool.numThreads(), n);
+}
+
+TEST(ThreadPool, DestroyDuringBackgroundStart) {
+  for (int i = 0; i < 20; ++i) {
+    std::atomic<int> ran(0);
+    {
+      dispenso::ThreadPool pool(8, dispenso::BackgroundStartTag());
+      pool.schedule([&ran]() { ran.fetch_add(1); }, dispenso::ForceQueuingTag());
+    }
+    EXPECT_EQ(ran.load(), 1);
+  }
+}
+
+TEST(ThreadPool, GlobalBackgroundStart) {
+  // Other tests in the same process may have already created the global pool.
+  const bool applied = dispenso::setGlobalThreadPoolBackgroundStart(true);
+  std::atomic<int> ran(0);
+  dispenso::globalThreadPool().schedule([&ran]() { ran.fetch_add(1); });
+  EXPECT_FALSE(dispenso::setGlobalThreadPoolBackgroundStart(false));
+  const ssize_t expected = static_cast<ssize_t>(std::thread::hardware_concurrency()) - 1;
+  if (applied) {
+    while (dispenso::globalThreadPool().numThreads() < expected) {
+      std::this_thread::yield();
+    }
+  }
+  while (ran.load() < 1) {
+    std::this_thread::yield();
+  }
+  EXPECT_EQ(dispenso::globalThreadPool().numThreads(), expected);
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/topology.h>
+
+#include <set>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+TEST(Topology, NonEmpty) {
+  const auto& nodes = dispenso::numaTopology();
+  ASSERT_FALSE(nodes.empty());
+  std::set<int> allCpus;
+  for (const auto& node : nodes) {
+    EXPECT_FALSE(node.cpus.empty());
+    for (int c : node.cpus) {
+      EXPECT_GE(c, 0);
+      EXPECT_TRUE(allCpus.insert(c).second) << "cpu " << c << " appears in more than one node";
+    }
+  }
+}
+
+TEST(Topology, Cached) {
+  EXPECT_EQ(&dispenso::numaTopology(), &dispenso::numaTopology());
+}
+
+TEST(Topology, PinCurrentThread) {
+  EXPECT_TRUE(dispenso::pinCurrentThread({}));
+#if defined(__linux__) || defined(_WIN32)
+  std::thread t([]() {
+    int cpu = dispenso::numaTopology().front().cpus.front();
+    EXPECT_TRUE(dispenso::pinCurrentThread({cpu}));
+  });
+  t.join();
+#endif // PLATFORM
+}
+
+TEST(Topology, CurrentNumaNode) {
+  EXPECT_LT(dispenso::currentNumaNode(), dispenso::numaTopology().size());
+  std::thread t([]() {
+    const auto& nodes = dispenso::numaTopology();
+    if (dispenso::pinCurrentThread(nodes.back().cpus)) {
+      EXPECT_EQ(dispenso::currentNumaNode(), nodes.size() - 1);
+    }
+  });
+  t.join();
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/trace.h>
+
+#include <atomic>
+#include <sstream>
+#include <string>
+
+#include <dispenso/pipeline.h>
+#include <dispenso/task_set.h>
+
+#include <gtest/gtest.h>
+
+namespace {
+size_t countOf(const std::string& haystack, const std::string& needle) {
+  size_t count = 0;
+  for (size_t pos = haystack.find(needle); pos != std::string::npos;
+       pos = haystack.find(needle, pos + needle.size())) {
+    ++count;
+  }
+  return count;
+}
+
+std::string writeTrace() {
+  std::ostringstream out;
+  dispenso::writeChromeTrace(out);
+  return out.str();
+}
+} // namespace
+
+TEST(Trace, EmptyTrace) {
+  dispenso::clearTrace();
+  std::string trace = writeTrace();
+  EXPECT_EQ(trace.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["), 0u);
+  EXPECT_EQ(countOf(trace, "\"ph\":\"B\""), 0u);
+  EXPECT_NE(trace.find("]}"), std::string::npos);
+}
+
+TEST(Trace, StartStop) {
+  EXPECT_FALSE(dispenso::tracingActive());
+  dispenso::startTracing();
+  EXPECT_TRUE(dispenso::tracingActive());
+  dispenso::stopTracing();
+  EXPECT_FALSE(dispenso::tracingActive());
+}
+
+TEST(Trace, NamedTaskSet) {
+  dispenso::clearTrace();
+  {
+    dispenso::ThreadPool pool(2);
+    dispenso::startTracing();
+    dispenso::TaskSet tasks(pool);
+    tasks.setName("namedTasks");
+    EXPECT_STREQ(tasks.name(), "namedTasks");
+    std::atomic<int> sum(0);
+    for (int i = 0; i < 100; ++i) {
+      tasks.schedule([&sum, i]() { sum.fetch_add(i); });
+    }
+    tasks.wait();
+    dispenso::stopTracing();
+    EXPECT_EQ(sum.load(), 4950);
+  }
+  std::string trace = writeTrace();
+  if (dispenso::kTracingCompiledIn) {
+    // Every task shows up as a balanced slice, whether it ran on a pool thread or inline.
+    EXPECT_EQ(countOf(trace, "{\"name\":\"namedTasks\",\"ph\":\"B\""), 100u);
+    EXPECT_EQ(countOf(trace, "{\"name\":\"namedTasks\",\"ph\":\"E\""), 100u);
+    EXPECT_NE(trace.find("\"name\":\"dispenso worker "), std::string::npos);
+  } else {
+    EXPECT_EQ(trace.find("namedTasks"), std::string::npos);
+  }
+}
+
+TEST(Trace, NamedPipelineStages) {
+  dispenso::clearTrace();
+  {
+    dispenso::ThreadPool pool(2);
+    dispenso::startTracing();
+    int next = 0;
+    std::atomic<int> sum(0);
+    dispenso::pipeline(
+        pool,
+        dispenso::stage(
+            [&next]() -> dispenso::OpResult<int> {
+              if (next == 10) {
+                return {};
+              }
+              return next++;
+            },
+            1)
+            .named("generate"),
+        dispenso::stage([](int i) { return i * 2; }, dispenso::kStageNoLimit).named("double"),
+        dispenso::stage([&sum](int i) { sum.fetch_add(i); }, 1).named("sum"));
+    dispenso::stopTracing();
+    EXPECT_EQ(sum.load(), 90);
+  }
+  std::string trace = writeTrace();
+  if (dispenso::kTracingCompiledIn) {
+    // The generator is called once more to find that it is done.
+    EXPECT_EQ(countOf(trace, "{\"name\":\"generate\",\"ph\":\"B\""), 11u);
+    EXPECT_EQ(countOf(trace, "{\"name\":\"double\",\"ph\":\"B\""), 10u);
+    EXPECT_EQ(countOf(trace, "{\"name\":\"sum\",\"ph\":\"E\""), 10u);
+  } else {
+    EXPECT_EQ(trace.find("double"), std::string::npos);
+  }
+}
+
+TEST(Trace, RingBufferKeepsNewestEvents) {
+  dispenso::clearTrace();
+  std::thread t([]() {
+    dispenso::setTraceThreadName("ring \"buffer\"");
+    dispenso::startTracing(16);
+    for (int i = 0; i < 100; ++i) {
+      DISPENSO_TRACE_INSTANT("tick");
+    }
+    dispenso::stopTracing();
+  });
+  t.join();
+  std::string trace = writeTrace();
+  if (dispenso::kTracingCompiledIn) {
+    // The oldest surviving slot is skipped, in case a writer were reusing it.
+    EXPECT_EQ(countOf(trace, "{\"name\":\"tick\",\"ph\":\"i\""), 15u);
+    EXPECT_NE(trace.find("\"name\":\"ring \\\"buffer\\\"\""), std::string::npos);
+  }
+  dispenso::startTracing();
+  dispenso::stopTracing();
+  dispenso::clearTrace();
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/unique_function.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using dispenso::UniqueFunction;
+
+TEST(UniqueFunction, Empty) {
+  UniqueFunction<void()> f;
+  EXPECT_FALSE(f);
+  UniqueFunction<void()> g(nullptr);
+  EXPECT_FALSE(g);
+}
+
+TEST(UniqueFunction, ArgsAndResult) {
+  UniqueFunction<int(int, int)> add([](int a, int b) { return a + b; });
+  EXPECT_TRUE(add);
+  EXPECT_EQ(add(2, 3), 5);
+  EXPECT_EQ(add(-2, 3), 1);
+}
+
+TEST(UniqueFunction, CalledManyTimes) {
+  int count = 0;
+  UniqueFunction<void()> f([&count]() { ++count; });
+  for (int i = 0; i < 100; ++i) {
+    f();
+  }
+  EXPECT_EQ(count, 100);
+}
+
+TEST(UniqueFunction, StatefulFunctor) {
+  UniqueFunction<int()> counter([n = 0]() mutable { return ++n; });
+  EXPECT_EQ(counter(), 1);
+  EXPECT_EQ(counter(), 2);
+  EXPECT_EQ(counter(), 3);
+}
+
+TEST(UniqueFunction, MoveOnlyCapture) {
+  auto ptr = std::make_unique<int>(7);
+  UniqueFunction<int()> f([p = std::move(ptr)]() { return *p; });
+  EXPECT_EQ(f(), 7);
+  UniqueFunction<int()> g(std::move(f));
+  EXPECT_FALSE(f);
+  EXPECT_EQ(g(), 7);
+}
+
+TEST(UniqueFunction, ReferenceArgs) {
+  UniqueFunction<void(std::string&, const std::string&)> append(
+      [](std::string& out, const std::string& in) { out += in; });
+  std::string s = "a";
+  append(s, "b");
+  append(s, "c");
+  EXPECT_EQ(s, "abc");
+}
+
+TEST(UniqueFunction, MoveOnlyArgs) {
+  UniqueFunction<int(std::unique_ptr<int>)> take([](std::unique_ptr<int> p) { return *p; });
+  EXPECT_EQ(take(std::make_unique<int>(11)), 11);
+}
+
+TEST(UniqueFunction, DiscardsResultForVoid) {
+  int calls = 0;
+  UniqueFunction<void()> f([&calls]() { return ++calls; });
+  f();
+  EXPECT_EQ(calls, 1);
+}
+
+TEST(UniqueFunction, DestroysFunctor) {
+  auto shared = std::make_shared<int>(0);
+  {
+    UniqueFunction<void()> f([shared]() {});
+    EXPECT_EQ(shared.use_count(), 2);
+    f();
+    EXPECT_EQ(shared.use_count(), 2);
+  }
+  EXPECT_EQ(shared.use_count(), 1);
+
+  UniqueFunction<void()> g([shared]() {});
+  UniqueFunction<void()> h([shared]() {});
+  EXPECT_EQ(shared.use_count(), 3);
+  g = std::move(h);
+  EXPECT_EQ(shared.use_count(), 2);
+  g = nullptr;
+  EXPECT_EQ(shared.use_count(), 1);
+}
+
+TEST(UniqueFunction, Swap) {
+  UniqueFunction<int()> a([]() { return 1; });
+  UniqueFunction<int()> b([]() { return 2; });
+  a.swap(b);
+  EXPECT_EQ(a(), 2);
+  EXPECT_EQ(b(), 1);
+}
+
+template <size_t kSize>
+void testSize() {
+  struct Big {
+    int operator()(int i) const {
+      return buf[i % kSize] + i;
+    }
+    uint8_t buf[kSize];
+  } big;
+  for (size_t i = 0; i < kSize; ++i) {
+    big.buf[i] = static_cast<uint8_t>(i);
+  }
+  std::vector<UniqueFunction<int(int)>> funcs;
+  for (int i = 0; i < 10; ++i) {
+    funcs.emplace_back(big);
+  }
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(funcs[i](i), 2 * i);
+  }
+}
+
+TEST(UniqueFunction, Sizes) {
+  testSize<16>();
+  testSize<120>();
+  testSize<248>();
+  testSize<10000>();
+}